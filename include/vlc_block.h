@@ -139,6 +139,20 @@ VLC_API void block_Init( block_t *, void *, size_t );
 VLC_API block_t *block_Alloc( size_t ) VLC_USED VLC_MALLOC;
 VLC_API block_t *block_Realloc( block_t *, ssize_t i_pre, size_t i_body ) VLC_USED;
 
+/**
+ * Statistics of the block_Alloc() buffer cache
+ */
+typedef struct
+{
+    uint64_t i_hits;      /**< Allocations served from the cache */
+    uint64_t i_misses;    /**< Allocations that fell back to malloc() */
+    uint64_t i_overflows; /**< Releases freed because the cache was full */
+    size_t   i_resident;  /**< Bytes held by idle cached buffers */
+    size_t   i_limit;     /**< Maximum bytes in the shared part of the cache */
+} block_cache_stats_t;
+
+VLC_API void block_CacheStats( block_cache_stats_t * );
+
 static inline void block_CopyProperties( block_t *dst, block_t *src )
 {
     dst->i_flags   = src->i_flags;
@@ -294,6 +308,8 @@ static inline block_t *block_ChainGather( block_t *p_list )
  * Fifos of blocks.
  ****************************************************************************
  * - block_FifoNew : create and init a new fifo
+ * - block_FifoNewSPSC : create and init a new lock-free fifo, for one
+ *      producer thread and one consumer thread only
  * - block_FifoRelease : destroy a fifo and free all blocks in it.
  * - block_FifoPace : wait for a fifo to drain to a specified number of packets or total data size
  * - block_FifoEmpty : free all blocks in a fifo
@@ -308,6 +324,7 @@ static inline block_t *block_ChainGather( block_t *p_list )
  ****************************************************************************/
 
 VLC_API block_fifo_t *block_FifoNew( void ) VLC_USED VLC_MALLOC;
+VLC_API block_fifo_t *block_FifoNewSPSC( void ) VLC_USED VLC_MALLOC;
 VLC_API void block_FifoRelease( block_fifo_t * );
 VLC_API void block_FifoPace( block_fifo_t *fifo, size_t max_depth, size_t max_size );
 VLC_API void block_FifoEmpty( block_fifo_t * );
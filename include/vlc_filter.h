@@ -250,6 +250,115 @@ VLC_API int filter_Blend( filter_t *, picture_t *p_dst, int i_dst_x, int i_dst_y
  */
 VLC_API void filter_DeleteBlend( filter_t * );
 
+/**
+ * Slice threading.
+ *
+ * A filter_slices_t is a pool of threads running a function on several
+ * horizontal bands of a picture at the same time. The calling thread
+ * processes one of the slices too. The number of threads is set by the
+ * "filter-threads" option, which disables slice threading by default.
+ */
+typedef struct filter_slices_t filter_slices_t;
+
+/**
+ * Function processing the slice i_slice out of i_slices.
+ */
+typedef void (*filter_slice_cb_t)( void *p_data,
+                                   unsigned i_slice, unsigned i_slices );
+
+/**
+ * It creates a pool of slice threads.
+ *
+ * It returns NULL if slice threading is disabled or on error. The other
+ * functions accept a NULL pool, then everything runs on the calling thread
+ * as a single slice.
+ */
+VLC_API filter_slices_t * filter_NewSlices( vlc_object_t * ) VLC_USED;
+#define filter_NewSlices( a ) filter_NewSlices( VLC_OBJECT( a ) )
+
+/**
+ * It returns the number of slices filter_RunSlices will run, for instance
+ * to allocate per slice buffers.
+ */
+VLC_API unsigned filter_CountSlices( const filter_slices_t * );
+
+/**
+ * It calls pf_slice once for each slice and waits for all of them to
+ * complete. The slices must write to disjoint parts of the output.
+ */
+VLC_API void filter_RunSlices( filter_slices_t *, filter_slice_cb_t pf_slice,
+                               void *p_data );
+
+/**
+ * It destroys a pool created by filter_NewSlices.
+ */
+VLC_API void filter_DeleteSlices( filter_slices_t * );
+
+/**
+ * Lines of a plane handled by a slice.
+ */
+typedef struct
+{
+    int i_first; /**< First line written by the slice */
+    int i_end;   /**< Line after the last line written by the slice */
+    int i_start; /**< First line read by the slice, overlap included */
+    int i_stop;  /**< Line after the last line read, overlap included */
+} filter_slice_t;
+
+/**
+ * It splits i_lines lines into i_slices bands and returns the band of slice
+ * i_slice. The bands start on multiples of i_align lines. i_overlap lines
+ * are added on both sides of the band to the lines which are read, for
+ * filters depending on the lines around the ones they write.
+ */
+static inline void filter_GetSlice( filter_slice_t *p_slice, int i_lines,
+                                    unsigned i_slice, unsigned i_slices,
+                                    int i_align, int i_overlap )
+{
+    p_slice->i_first = (int64_t)i_lines * i_slice / i_slices
+                       / i_align * i_align;
+    if( i_slice + 1 < i_slices )
+        p_slice->i_end = (int64_t)i_lines * ( i_slice + 1 ) / i_slices
+                         / i_align * i_align;
+    else
+        p_slice->i_end = i_lines;
+
+    p_slice->i_start = __MAX( p_slice->i_first - i_overlap, 0 );
+    p_slice->i_stop = __MIN( p_slice->i_end + i_overlap, i_lines );
+}
+
+/**
+ * It fills p_view with a picture restricted to the band of slice i_slice.
+ *
+ * The bands are computed on the first plane and scaled to the other ones,
+ * so i_align must be a multiple of the vertical chroma subsampling. The
+ * view shares the pixels of p_pic and must not be held nor released.
+ */
+static inline void filter_SlicePicture( picture_t *p_view,
+                                        const picture_t *p_pic,
+                                        unsigned i_slice, unsigned i_slices,
+                                        int i_align )
+{
+    filter_slice_t slice;
+    const int i_lines = p_pic->p[0].i_visible_lines;
+
+    filter_GetSlice( &slice, i_lines, i_slice, i_slices, i_align, 0 );
+
+    *p_view = *p_pic;
+    for( int i = 0; i < p_pic->i_planes; i++ )
+    {
+        const plane_t *p_plane = &p_pic->p[i];
+        const int i_first = slice.i_first * p_plane->i_visible_lines / i_lines;
+        const int i_end = slice.i_end * p_plane->i_visible_lines / i_lines;
+
+        p_view->p[i].p_pixels = &p_plane->p_pixels[i_first * p_plane->i_pitch];
+        p_view->p[i].i_lines =
+        p_view->p[i].i_visible_lines = i_end - i_first;
+    }
+    p_view->format.i_height =
+    p_view->format.i_visible_height = slice.i_end - slice.i_first;
+}
+
 /**
  * Create a picture_t *(*)( filter_t *, picture_t * ) compatible wrapper
  * using a void (*)( filter_t *, picture_t *, picture_t * ) function
@@ -0,0 +1,759 @@
+/*****************************************************************************
+ * shmring.c: shared memory ring input and output
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*
+ * A producer process (the sout access) creates a file, typically on tmpfs,
+ * and maps it with a header, a ring of block descriptors and a data area.
+ * It copies every output block into the data area once, and publishes its
+ * offset, size and timestamps in the next descriptor.
+ *
+ * The consumer process (the access) maps the same file and hands out blocks
+ * pointing straight into the data area. When such a block is released, its
+ * descriptor is flagged, and the producer may then reuse its slot and data.
+ * The producer never waits for the consumer: if the ring is full, it drops
+ * the new block.
+ *
+ * A single consumer may be attached at a time. It requests attachment by
+ * storing its process ID, then bumps the attach generation, so that a
+ * process attaching again is told apart from its previous attachment. The
+ * producer acknowledges the generation on its next write and tells from
+ * which descriptor on it has to wait for releases.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <semaphore.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <vlc_common.h>
+#include <vlc_plugin.h>
+#include <vlc_access.h>
+#include <vlc_sout.h>
+#include <vlc_block.h>
+#include <vlc_fs.h>
+#include <vlc_atomic.h>
+
+/*****************************************************************************
+ * Module descriptor
+ *****************************************************************************/
+static int  InOpen ( vlc_object_t * );
+static void InClose( vlc_object_t * );
+#ifdef ENABLE_SOUT
+static int  OutOpen ( vlc_object_t * );
+static void OutClose( vlc_object_t * );
+#endif
+
+#define SOUT_CFG_PREFIX "sout-shmring-"
+
+#define SIZE_TEXT N_("Ring size (MiB)")
+#define SIZE_LONGTEXT N_("Size of the shared data area. Blocks that do " \
+    "not fit because the consumer has not released enough data yet are " \
+    "dropped.")
+#define SLOTS_TEXT N_("Ring slots")
+#define SLOTS_LONGTEXT N_("Maximum number of blocks in the ring (rounded " \
+    "up to a power of two).")
+
+vlc_module_begin ()
+    set_shortname( N_("Shared ring") )
+    set_description( N_("Shared memory ring input") )
+    set_capability( "access", 0 )
+    set_category( CAT_INPUT )
+    set_subcategory( SUBCAT_INPUT_ACCESS )
+    add_shortcut( "shmring" )
+    set_callbacks( InOpen, InClose )
+
+#ifdef ENABLE_SOUT
+    add_submodule ()
+        set_shortname( N_("Shared ring") )
+        set_description( N_("Shared memory ring output") )
+        set_capability( "sout access", 0 )
+        set_category( CAT_SOUT )
+        set_subcategory( SUBCAT_SOUT_ACO )
+        add_integer( SOUT_CFG_PREFIX "size", 16, SIZE_TEXT, SIZE_LONGTEXT,
+                     true )
+            change_integer_range( 1, 4096 )
+        add_integer( SOUT_CFG_PREFIX "slots", 1024, SLOTS_TEXT,
+                     SLOTS_LONGTEXT, true )
+            change_integer_range( 16, 1 << 20 )
+        add_shortcut( "shmring" )
+        set_callbacks( OutOpen, OutClose )
+#endif
+vlc_module_end ()
+
+/*****************************************************************************
+ * Shared layout
+ *****************************************************************************/
+#define SHMRING_MAGIC   UINT32_C(0x524d4853) /* "SHMR" */
+#define SHMRING_VERSION 3
+#define SHMRING_ALIGN   32
+
+typedef struct
+{
+    uint64_t     i_offset;   /**< Payload offset in the data area */
+    uint32_t     i_size;     /**< Payload size */
+    uint32_t     i_flags;
+    int64_t      i_pts;
+    int64_t      i_dts;
+    int64_t      i_length;
+    atomic_uint  released;   /**< Set by the consumer when done with it */
+} shmring_desc_t;
+
+typedef struct
+{
+    uint32_t     i_magic;         /**< Written last by the producer */
+    uint32_t     i_version;
+    uint32_t     i_header_size;
+    uint32_t     i_desc_size;
+    uint32_t     i_slots;         /**< Descriptors, a power of two */
+    uint32_t     i_producer;      /**< Producer process ID */
+    uint64_t     i_desc_offset;
+    uint64_t     i_data_offset;
+    uint64_t     i_data_size;     /**< A multiple of SHMRING_ALIGN */
+    atomic_uint  i_written;       /**< Published descriptors */
+    atomic_uint  i_consumer;      /**< Consumer process ID requested, or 0 */
+    atomic_uint  i_generation;    /**< Attachments requested so far */
+    atomic_uint  i_acked;         /**< Generation acknowledged by the
+                                       producer, or 0 if no consumer */
+    atomic_uint  i_attach;        /**< First descriptor of that consumer */
+    atomic_uint  b_closed;
+    atomic_uint  b_waiting;       /**< Set by the consumer before it waits */
+    sem_t        data;            /**< Posted once per wait of the consumer */
+} shmring_header_t;
+
+static size_t Align( size_t size )
+{
+    return (size + SHMRING_ALIGN - 1) & ~(size_t)(SHMRING_ALIGN - 1);
+}
+
+static bool ProcessGone( unsigned pid )
+{
+    return kill( (pid_t)pid, 0 ) == -1 && errno == ESRCH;
+}
+
+/*****************************************************************************
+ * Input
+ *****************************************************************************/
+typedef struct
+{
+    atomic_uint       refs;
+    shmring_header_t *hdr;
+    size_t            i_length;
+    unsigned          i_pid;
+} shmring_map_t;
+
+typedef struct
+{
+    block_t         self;
+    shmring_map_t  *map;
+    shmring_desc_t *desc;
+} shmring_block_t;
+
+struct access_sys_t
+{
+    shmring_map_t  *map;
+    shmring_desc_t *descs;
+    uint8_t        *data;
+    uint64_t        i_data_size;  /**< Checked copies of the header fields */
+    unsigned        i_mask;
+    unsigned        i_generation;
+    unsigned        i_read;
+    bool            b_attached;
+};
+
+static void MapRelease( shmring_map_t *map )
+{
+    if( atomic_fetch_sub( &map->refs, 1 ) != 1 )
+        return;
+
+    /* Nothing refers to the ring anymore: let the producer reclaim it all */
+    unsigned pid = map->i_pid;
+    atomic_compare_exchange_strong( &map->hdr->i_consumer, &pid, 0 );
+    munmap( map->hdr, map->i_length );
+    free( map );
+}
+
+static void BlockRelease( block_t *block )
+{
+    shmring_block_t *sb = (shmring_block_t *)block;
+
+    atomic_store( &sb->desc->released, 1 );
+    MapRelease( sb->map );
+    free( sb );
+}
+
+/* Whether Block() can make progress without waiting */
+static bool HasData( const access_sys_t *sys )
+{
+    shmring_header_t *hdr = sys->map->hdr;
+
+    if( !sys->b_attached )
+        return atomic_load( &hdr->i_acked ) == sys->i_generation;
+    return sys->i_read != atomic_load( &hdr->i_written );
+}
+
+/* Waits for a descriptor for at most 100 ms, returns false on timeout */
+static bool WaitData( const access_sys_t *sys )
+{
+    shmring_header_t *hdr = sys->map->hdr;
+    struct timespec ts;
+    bool ret = true;
+
+    /* The producer only posts when it sees the flag. Check again after
+     * setting it, in case a descriptor was published just before. */
+    atomic_store( &hdr->b_waiting, 1 );
+    if( HasData( sys ) || atomic_load( &hdr->b_closed ) )
+        goto out;
+
+    clock_gettime( CLOCK_REALTIME, &ts );
+    ts.tv_nsec += 100000000;
+    if( ts.tv_nsec >= 1000000000 )
+    {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+    }
+
+    while( sem_timedwait( &hdr->data, &ts ) )
+        if( errno != EINTR )
+        {
+            ret = false;
+            break;
+        }
+out:
+    /* If the producer took the flag on a timeout, at most one post is left
+     * over, and it only costs a single early return of the next wait. */
+    atomic_store( &hdr->b_waiting, 0 );
+    return ret;
+}
+
+static block_t *Block( access_t *p_access )
+{
+    access_sys_t *sys = p_access->p_sys;
+    shmring_header_t *hdr = sys->map->hdr;
+
+    if( p_access->info.b_eof )
+        return NULL;
+
+    if( !sys->b_attached )
+    {
+        if( atomic_load( &hdr->i_acked ) != sys->i_generation )
+            goto wait;
+        sys->i_read = atomic_load( &hdr->i_attach );
+        sys->b_attached = true;
+        msg_Dbg( p_access, "attached at block %u", sys->i_read );
+    }
+
+    if( sys->i_read == atomic_load( &hdr->i_written ) )
+        goto wait;
+
+    /* The producer may rewrite the descriptor at any time: read each field
+     * exactly once, then check and use only the copies */
+    shmring_desc_t *desc = &sys->descs[sys->i_read & sys->i_mask];
+    const volatile shmring_desc_t *shared = desc;
+    const uint64_t i_offset = shared->i_offset;
+    const uint32_t i_size = shared->i_size;
+    const uint32_t i_flags = shared->i_flags;
+    const int64_t i_pts = shared->i_pts;
+    const int64_t i_dts = shared->i_dts;
+    const int64_t i_length = shared->i_length;
+
+    if( i_offset > sys->i_data_size || i_size > sys->i_data_size - i_offset )
+    {
+        msg_Err( p_access, "corrupt ring descriptor" );
+        p_access->info.b_eof = true;
+        return NULL;
+    }
+
+    shmring_block_t *sb = malloc( sizeof( *sb ) );
+    if( unlikely(sb == NULL) )
+        return NULL;
+
+    block_t *block = &sb->self;
+    block_Init( block, sys->data + i_offset, i_size );
+    block->i_flags = i_flags;
+    block->i_pts = i_pts;
+    block->i_dts = i_dts;
+    block->i_length = i_length;
+    block->pf_release = BlockRelease;
+    sb->map = sys->map;
+    sb->desc = desc;
+    atomic_fetch_add( &sys->map->refs, 1 );
+
+    sys->i_read++;
+    return block;
+
+wait:
+    if( atomic_load( &hdr->b_closed ) )
+    {
+        msg_Dbg( p_access, "producer closed the ring" );
+        p_access->info.b_eof = true;
+    }
+    else if( !WaitData( sys ) && ProcessGone( hdr->i_producer ) )
+    {
+        msg_Err( p_access, "producer process %"PRIu32" is gone",
+                 hdr->i_producer );
+        p_access->info.b_eof = true;
+    }
+    return NULL;
+}
+
+static int Control( access_t *p_access, int i_query, va_list args )
+{
+    switch( i_query )
+    {
+        case ACCESS_CAN_SEEK:
+        case ACCESS_CAN_FASTSEEK:
+        case ACCESS_CAN_PAUSE:
+        case ACCESS_CAN_CONTROL_PACE:
+            *va_arg( args, bool * ) = false;
+            break;
+
+        case ACCESS_GET_PTS_DELAY:
+            *va_arg( args, int64_t * ) = INT64_C(1000)
+                * var_InheritInteger( p_access, "live-caching" );
+            break;
+
+        default:
+            return VLC_EGENERIC;
+    }
+    return VLC_SUCCESS;
+}
+
+static int InOpen( vlc_object_t *p_this )
+{
+    access_t *p_access = (access_t *)p_this;
+    struct stat st;
+
+    int fd = vlc_open( p_access->psz_location, O_RDWR );
+    if( fd == -1 )
+    {
+        msg_Err( p_access, "cannot open %s: %s", p_access->psz_location,
+                 vlc_strerror_c(errno) );
+        return VLC_EGENERIC;
+    }
+
+    if( fstat( fd, &st ) || (uintmax_t)st.st_size < sizeof( shmring_header_t )
+     || (uintmax_t)st.st_size >= SIZE_MAX )
+    {
+        msg_Err( p_access, "%s is not a shared ring", p_access->psz_location );
+        close( fd );
+        return VLC_EGENERIC;
+    }
+
+    size_t length = st.st_size;
+    shmring_header_t *hdr = mmap( NULL, length, PROT_READ|PROT_WRITE,
+                                  MAP_SHARED, fd, 0 );
+    close( fd );
+    if( hdr == MAP_FAILED )
+    {
+        msg_Err( p_access, "cannot map %s: %s", p_access->psz_location,
+                 vlc_strerror_c(errno) );
+        return VLC_EGENERIC;
+    }
+
+    /* Never trust the other process with our address space: check a copy
+     * of the layout, and never read it from the shared header again */
+    const volatile shmring_header_t *shared = hdr;
+    const uint32_t magic = shared->i_magic;
+    const uint32_t version = shared->i_version;
+    const uint32_t header_size = shared->i_header_size;
+    const uint32_t desc_size = shared->i_desc_size;
+    const uint32_t slots = shared->i_slots;
+    const uint64_t desc_offset = shared->i_desc_offset;
+    const uint64_t data_offset = shared->i_data_offset;
+    const uint64_t data_size = shared->i_data_size;
+
+    if( magic != SHMRING_MAGIC || version != SHMRING_VERSION
+     || header_size != sizeof( *hdr )
+     || desc_size != sizeof( shmring_desc_t )
+     || slots == 0 || (slots & (slots - 1))
+     || desc_offset < sizeof( *hdr ) || desc_offset > length
+     || (length - desc_offset) / sizeof( shmring_desc_t ) < slots
+     || data_offset > length || data_size > length - data_offset )
+    {
+        msg_Err( p_access, "%s is not a compatible shared ring",
+                 p_access->psz_location );
+        munmap( hdr, length );
+        return VLC_EGENERIC;
+    }
+
+    /* Request attachment, taking over from a dead consumer if needed */
+    unsigned pid = getpid(), other = 0;
+    while( !atomic_compare_exchange_strong( &hdr->i_consumer, &other, pid ) )
+    {
+        if( !ProcessGone( other ) )
+        {
+            msg_Err( p_access, "ring already has a consumer (process %u)",
+                     other );
+            munmap( hdr, length );
+            return VLC_EGENERIC;
+        }
+    }
+
+    access_sys_t *sys = malloc( sizeof( *sys ) );
+    shmring_map_t *map = malloc( sizeof( *map ) );
+    if( unlikely(sys == NULL || map == NULL) )
+    {
+        free( map );
+        free( sys );
+        atomic_store( &hdr->i_consumer, 0 );
+        munmap( hdr, length );
+        return VLC_ENOMEM;
+    }
+
+    atomic_init( &map->refs, 1 );
+    map->hdr = hdr;
+    map->i_length = length;
+    map->i_pid = pid;
+    sys->map = map;
+    sys->descs = (shmring_desc_t *)((uint8_t *)hdr + desc_offset);
+    sys->data = (uint8_t *)hdr + data_offset;
+    sys->i_data_size = data_size;
+    sys->i_mask = slots - 1;
+    sys->i_read = 0;
+    sys->b_attached = false;
+    /* Published once the process ID is, see OutAck(); 0 means no consumer */
+    do
+        sys->i_generation = atomic_fetch_add( &hdr->i_generation, 1 ) + 1;
+    while( unlikely(sys->i_generation == 0) );
+
+    msg_Dbg( p_access, "ring of %u blocks and %"PRIu64" bytes from process "
+             "%"PRIu32, slots, data_size, hdr->i_producer );
+
+    ACCESS_SET_CALLBACKS( NULL, Block, Control, NULL );
+    p_access->p_sys = sys;
+    return VLC_SUCCESS;
+}
+
+static void InClose( vlc_object_t *p_this )
+{
+    access_t *p_access = (access_t *)p_this;
+    access_sys_t *sys = p_access->p_sys;
+
+    /* The mapping lives on until the last block is released */
+    MapRelease( sys->map );
+    free( sys );
+}
+
+#ifdef ENABLE_SOUT
+/*****************************************************************************
+ * Output
+ *****************************************************************************/
+static const char *const ppsz_sout_options[] = {
+    "size",
+    "slots",
+    NULL
+};
+
+struct sout_access_out_sys_t
+{
+    shmring_header_t *hdr;
+    size_t            i_length;
+    char             *psz_path;
+    shmring_desc_t   *descs;
+    uint8_t          *data;
+    uint64_t         *ends;       /**< Data position after each descriptor */
+    uint64_t          i_head;     /**< Next data position */
+    uint64_t          i_tail;     /**< Oldest data position in use */
+    unsigned          i_written;
+    unsigned          i_reclaimed;
+    unsigned          i_acked;      /**< Consumer process ID, or 0 */
+    unsigned          i_generation; /**< Attach generation of that consumer */
+    unsigned          i_attach;
+    uint64_t          i_dropped;
+};
+
+/* Acknowledges a new (or no more) consumer */
+static void OutAck( sout_access_out_t *p_access )
+{
+    sout_access_out_sys_t *sys = p_access->p_sys;
+    /* The generation is bumped after the process ID is stored: load it
+     * first, so that a new generation always comes with its consumer */
+    unsigned generation = atomic_load( &sys->hdr->i_generation );
+    unsigned consumer = atomic_load( &sys->hdr->i_consumer );
+
+    if( consumer == sys->i_acked
+     && (consumer == 0 || generation == sys->i_generation) )
+        return;
+
+    sys->i_acked = consumer;
+    sys->i_generation = generation;
+    sys->i_attach = sys->i_written;
+    atomic_store( &sys->hdr->i_attach, sys->i_attach );
+    atomic_store( &sys->hdr->i_acked, consumer != 0 ? generation : 0 );
+    if( consumer != 0 )
+        msg_Dbg( p_access, "consumer process %u attached", consumer );
+    else
+        msg_Dbg( p_access, "consumer detached" );
+}
+
+/* Frees the slots and data of released descriptors, in order */
+static void OutReclaim( sout_access_out_sys_t *sys )
+{
+    const unsigned mask = sys->hdr->i_slots - 1;
+
+    while( sys->i_reclaimed != sys->i_written )
+    {
+        unsigned i = sys->i_reclaimed;
+
+        if( sys->i_acked != 0 && (int)(i - sys->i_attach) >= 0
+         && !atomic_load( &sys->descs[i & mask].released ) )
+            break;
+        sys->i_tail = sys->ends[i & mask];
+        sys->i_reclaimed++;
+    }
+}
+
+static bool OutHasRoom( sout_access_out_sys_t *sys, uint64_t end )
+{
+    return end - sys->i_tail <= sys->hdr->i_data_size
+        && sys->i_written - sys->i_reclaimed < sys->hdr->i_slots;
+}
+
+static void OutPush( sout_access_out_t *p_access, const block_t *block )
+{
+    sout_access_out_sys_t *sys = p_access->p_sys;
+    shmring_header_t *hdr = sys->hdr;
+    const size_t span = Align( block->i_buffer );
+
+    if( span > hdr->i_data_size )
+        goto drop;
+
+    OutAck( p_access );
+    OutReclaim( sys );
+
+    /* Payloads are contiguous: skip the end of the data area if needed */
+    uint64_t pos = sys->i_head;
+    uint64_t offset = pos % hdr->i_data_size;
+    if( offset + span > hdr->i_data_size )
+    {
+        pos += hdr->i_data_size - offset;
+        offset = 0;
+    }
+
+    if( !OutHasRoom( sys, pos + span ) )
+    {
+        unsigned consumer = sys->i_acked;
+
+        if( consumer == 0 || !ProcessGone( consumer ) )
+            goto drop;
+
+        msg_Warn( p_access, "consumer process %u is gone", consumer );
+        atomic_compare_exchange_strong( &hdr->i_consumer, &consumer, 0 );
+        OutAck( p_access );
+        OutReclaim( sys );
+        if( !OutHasRoom( sys, pos + span ) )
+            goto drop;
+    }
+
+    const unsigned i = sys->i_written & (hdr->i_slots - 1);
+    shmring_desc_t *desc = &sys->descs[i];
+
+    memcpy( sys->data + offset, block->p_buffer, block->i_buffer );
+    desc->i_offset = offset;
+    desc->i_size = block->i_buffer;
+    desc->i_flags = block->i_flags;
+    desc->i_pts = block->i_pts;
+    desc->i_dts = block->i_dts;
+    desc->i_length = block->i_length;
+    atomic_store( &desc->released, 0 );
+    sys->ends[i] = pos + span;
+    sys->i_head = pos + span;
+
+    atomic_store( &hdr->i_written, ++sys->i_written );
+    /* Only wake a waiting consumer: posts must not pile up while it lags */
+    if( atomic_exchange( &hdr->b_waiting, 0 ) )
+        sem_post( &hdr->data );
+    return;
+
+drop:
+    if( sys->i_dropped++ == 0 )
+        msg_Warn( p_access, "ring full, dropping data" );
+}
+
+static ssize_t Write( sout_access_out_t *p_access, block_t *p_buffer )
+{
+    ssize_t i_len = 0;
+
+    while( p_buffer != NULL )
+    {
+        block_t *p_next = p_buffer->p_next;
+
+        OutPush( p_access, p_buffer );
+        i_len += p_buffer->i_buffer;
+        block_Release( p_buffer );
+        p_buffer = p_next;
+    }
+    return i_len;
+}
+
+static int Seek( sout_access_out_t *p_access, off_t i_pos )
+{
+    (void) i_pos;
+    msg_Err( p_access, "shared ring output cannot seek" );
+    return -1;
+}
+
+static int OutControl( sout_access_out_t *p_access, int i_query, va_list args )
+{
+    (void) p_access;
+
+    switch( i_query )
+    {
+        case ACCESS_OUT_CONTROLS_PACE:
+            *va_arg( args, bool * ) = false;
+            break;
+
+        default:
+            return VLC_EGENERIC;
+    }
+    return VLC_SUCCESS;
+}
+
+static int OutOpen( vlc_object_t *p_this )
+{
+    sout_access_out_t *p_access = (sout_access_out_t *)p_this;
+
+    config_ChainParse( p_access, SOUT_CFG_PREFIX, ppsz_sout_options,
+                       p_access->p_cfg );
+
+    unsigned slots = var_GetInteger( p_access, SOUT_CFG_PREFIX "slots" );
+    uint64_t data_size = (uint64_t)var_GetInteger( p_access,
+                                          SOUT_CFG_PREFIX "size" ) << 20;
+    if( slots & (slots - 1) )
+        slots = 1u << (32 - clz( slots ));
+
+    const size_t desc_offset = Align( sizeof( shmring_header_t ) );
+    const size_t data_offset = Align( desc_offset
+                                      + slots * sizeof( shmring_desc_t ) );
+    const size_t length = data_offset + data_size;
+
+    sout_access_out_sys_t *sys = malloc( sizeof( *sys ) );
+    if( unlikely(sys == NULL) )
+        return VLC_ENOMEM;
+    sys->ends = calloc( slots, sizeof( *sys->ends ) );
+    sys->psz_path = strdup( p_access->psz_path );
+    if( unlikely(sys->ends == NULL || sys->psz_path == NULL) )
+        goto error;
+
+    /* Start afresh: a consumer of a previous ring keeps its own copy */
+    vlc_unlink( sys->psz_path );
+    int fd = vlc_open( sys->psz_path, O_RDWR|O_CREAT|O_EXCL, 0600 );
+    if( fd == -1 )
+    {
+        msg_Err( p_access, "cannot create %s: %s", sys->psz_path,
+                 vlc_strerror_c(errno) );
+        goto error;
+    }
+    if( ftruncate( fd, length ) )
+    {
+        msg_Err( p_access, "cannot allocate %zu bytes: %s", length,
+                 vlc_strerror_c(errno) );
+        close( fd );
+        goto error_unlink;
+    }
+
+    shmring_header_t *hdr = mmap( NULL, length, PROT_READ|PROT_WRITE,
+                                  MAP_SHARED, fd, 0 );
+    close( fd );
+    if( hdr == MAP_FAILED )
+    {
+        msg_Err( p_access, "cannot map %s: %s", sys->psz_path,
+                 vlc_strerror_c(errno) );
+        goto error_unlink;
+    }
+
+    hdr->i_version = SHMRING_VERSION;
+    hdr->i_header_size = sizeof( *hdr );
+    hdr->i_desc_size = sizeof( shmring_desc_t );
+    hdr->i_slots = slots;
+    hdr->i_producer = getpid();
+    hdr->i_desc_offset = desc_offset;
+    hdr->i_data_offset = data_offset;
+    hdr->i_data_size = data_size;
+    atomic_init( &hdr->i_written, 0 );
+    atomic_init( &hdr->i_consumer, 0 );
+    atomic_init( &hdr->i_generation, 0 );
+    atomic_init( &hdr->i_acked, 0 );
+    atomic_init( &hdr->i_attach, 0 );
+    atomic_init( &hdr->b_closed, 0 );
+    atomic_init( &hdr->b_waiting, 0 );
+    if( sem_init( &hdr->data, 1, 0 ) )
+    {
+        msg_Err( p_access, "cannot create semaphore: %s",
+                 vlc_strerror_c(errno) );
+        munmap( hdr, length );
+        goto error_unlink;
+    }
+    atomic_thread_fence( memory_order_release );
+    hdr->i_magic = SHMRING_MAGIC;
+
+    sys->hdr = hdr;
+    sys->i_length = length;
+    sys->descs = (shmring_desc_t *)((uint8_t *)hdr + desc_offset);
+    sys->data = (uint8_t *)hdr + data_offset;
+    sys->i_head = sys->i_tail = 0;
+    sys->i_written = sys->i_reclaimed = 0;
+    sys->i_acked = sys->i_generation = sys->i_attach = 0;
+    sys->i_dropped = 0;
+
+    msg_Dbg( p_access, "ring %s of %u blocks and %"PRIu64" bytes",
+             sys->psz_path, slots, data_size );
+
+    p_access->p_sys = sys;
+    p_access->pf_write = Write;
+    p_access->pf_seek = Seek;
+    p_access->pf_control = OutControl;
+    return VLC_SUCCESS;
+
+error_unlink:
+    vlc_unlink( sys->psz_path );
+error:
+    free( sys->psz_path );
+    free( sys->ends );
+    free( sys );
+    return VLC_EGENERIC;
+}
+
+static void OutClose( vlc_object_t *p_this )
+{
+    sout_access_out_t *p_access = (sout_access_out_t *)p_this;
+    sout_access_out_sys_t *sys = p_access->p_sys;
+
+    /* Wake the consumer up so that it sees the end of the stream */
+    atomic_store( &sys->hdr->b_closed, 1 );
+    sem_post( &sys->hdr->data );
+
+    if( sys->i_dropped > 0 )
+        msg_Warn( p_access, "dropped %"PRIu64" blocks", sys->i_dropped );
+    munmap( sys->hdr, sys->i_length );
+    vlc_unlink( sys->psz_path );
+    free( sys->psz_path );
+    free( sys->ends );
+    free( sys );
+}
+#endif
@@ -42,6 +42,10 @@
 #include <vlc_access.h>
 #include <vlc_network.h>
 #include <vlc_block.h>
+#ifdef HAVE_RECVMMSG
+# include <sys/socket.h>
+# include <poll.h>
+#endif
 
 #define MTU 65535
 
@@ -50,10 +54,31 @@
  *****************************************************************************/
 static int  Open( vlc_object_t * );
 static void Close( vlc_object_t * );
-static void *Threadsendkeep_alive(void *data);
 
 #define BUFFER_TEXT N_("Receive buffer")
 #define BUFFER_LONGTEXT N_("UDP receive buffer size (bytes)" )
+#define BATCH_TEXT N_("Receive batch size")
+#define BATCH_LONGTEXT N_("Maximum number of datagrams fetched from the " \
+    "socket with a single system call. 1 disables batching. Datagrams " \
+    "larger than the maximum datagram size are then dropped.")
+#define PKTSIZE_TEXT N_("Maximum datagram size")
+#define PKTSIZE_LONGTEXT N_("Size (bytes) of the recycled packet buffers " \
+    "used for batched reception. Larger datagrams are discarded and " \
+    "counted as dropped.")
+#define PUNCH_TEXT N_("NAT hole punching destination")
+#define PUNCH_LONGTEXT N_("Address and port (host:port or [IPv6]:port) " \
+    "to send one datagram to from the receiving socket when opening, " \
+    "so that a NAT lets the stream in.")
+#define KEEPALIVE_TEXT N_("NAT keep-alive destination")
+#define KEEPALIVE_LONGTEXT N_("Address and port (host:port or " \
+    "[IPv6]:port) to send datagrams to periodically from the receiving " \
+    "socket, to keep the NAT binding open.")
+#define KEEPALIVE_INTERVAL_TEXT N_("NAT keep-alive interval")
+#define KEEPALIVE_INTERVAL_LONGTEXT N_("Time (ms) between two keep-alive " \
+    "datagrams.")
+#define KEEPALIVE_PAYLOAD_TEXT N_("NAT keep-alive payload")
+#define KEEPALIVE_PAYLOAD_LONGTEXT N_("Text sent in the hole punching and " \
+    "keep-alive datagrams, followed by a nul byte.")
 
 vlc_module_begin ()
     set_shortname( N_("UDP" ) )
@@ -63,6 +88,18 @@ vlc_module_begin ()
 
     add_obsolete_integer( "server-port" ) /* since 2.0.0 */
     add_integer( "udp-buffer", 0x400000, BUFFER_TEXT, BUFFER_LONGTEXT, true )
+    add_integer( "udp-batch", 1, BATCH_TEXT, BATCH_LONGTEXT, true )
+        change_integer_range( 1, 1024 )
+    add_integer( "udp-packet-size", 1500, PKTSIZE_TEXT, PKTSIZE_LONGTEXT, true )
+        change_integer_range( 188, MTU )
+    add_string( "udp-punch", NULL, PUNCH_TEXT, PUNCH_LONGTEXT, true )
+    add_string( "udp-keepalive", NULL, KEEPALIVE_TEXT, KEEPALIVE_LONGTEXT,
+                true )
+    add_integer( "udp-keepalive-interval", 3000, KEEPALIVE_INTERVAL_TEXT,
+                 KEEPALIVE_INTERVAL_LONGTEXT, true )
+        change_integer_range( 100, 3600000 )
+    add_string( "udp-keepalive-payload", "helloword",
+                KEEPALIVE_PAYLOAD_TEXT, KEEPALIVE_PAYLOAD_LONGTEXT, true )
 
     set_capability( "access", 0 )
     add_shortcut( "udp", "udpstream", "udp4", "udp6" )
@@ -70,14 +107,42 @@ vlc_module_begin ()
     set_callbacks( Open, Close )
 vlc_module_end ()
 
+typedef struct udp_keepalive_t udp_keepalive_t;
+
+#ifdef HAVE_RECVMMSG
+typedef struct udp_pool_t udp_pool_t;
+
+typedef union
+{
+    struct cmsghdr hdr;
+    char buf[CMSG_SPACE(sizeof (uint32_t))];
+} udp_cmsg_t;
+#endif
+
 struct access_sys_t
 {
     int fd;
     size_t fifo_size;
     block_fifo_t *fifo;
     vlc_thread_t thread;
-	vlc_thread_t kplv_thread;
-	int kplv_flag;
+    udp_keepalive_t *keepalive;
+#ifdef HAVE_RECVMMSG
+    /* Batched reception (udp-batch > 1) */
+    unsigned batch;
+    udp_pool_t *pool;
+    block_t **slots; /**< packets armed for the next recvmmsg() */
+    struct mmsghdr *msgs;
+    struct iovec *iov;
+    udp_cmsg_t *cmsg;
+
+    /* Statistics, only written by the reception thread */
+    uint64_t calls;
+    uint64_t packets;
+    uint64_t truncated;
+    uint64_t nomem;
+    uint32_t overflows; /**< kernel drops reported by SO_RXQ_OVFL */
+    mtime_t last_stats;
+#endif
 };
 
 /*****************************************************************************
@@ -86,6 +151,14 @@ struct access_sys_t
 static block_t *BlockUDP( access_t * );
 static int Control( access_t *, int, va_list );
 static void* ThreadRead( void *data );
+static void NatPunch( access_t * );
+static udp_keepalive_t *KeepAliveStart( access_t * );
+static void KeepAliveStop( udp_keepalive_t * );
+#ifdef HAVE_RECVMMSG
+static int  BatchInit( access_t * );
+static void BatchClean( access_t * );
+static void* ThreadReadBatch( void *data );
+#endif
 
 /*****************************************************************************
  * Open: open the socket
@@ -106,13 +179,6 @@ static int Open( vlc_object_t *p_this )
     char *psz_name = strdup( p_access->psz_location );
     char *psz_parser;
 
-    // vvv wenfeng
-    char *psz_parser_nat;
-	char *psz_parser_kplv;
-	char nat_ip[20];
-	int nat_port;
-    // ^^^ wenfeng
-
     const char *psz_server_addr, *psz_bind_addr = "";
     int  i_bind_port = 1234, i_server_port = 0;
 
@@ -163,161 +229,49 @@ static int Open( vlc_object_t *p_this )
 
     sys->fd = net_OpenDgram( p_access, psz_bind_addr, i_bind_port,
                              psz_server_addr, i_server_port, IPPROTO_UDP );
-  
-	free( psz_name );
+    free( psz_name );
     if( sys->fd == -1 )
     {
         msg_Err( p_access, "cannot open socket" );
         goto error;
     }
 
-    sys->fifo = block_FifoNew();
+    sys->fifo = block_FifoNewSPSC();
     if( unlikely( sys->fifo == NULL ) )
     {
         net_Close( sys->fd );
         goto error;
     }
-    // vvv wenfeng
-	psz_parser_nat = strstr(p_access->psz_location, "nat=");
-	msg_Dbg(p_access , "psz_name = %s psz_parser_nat = %s\n", p_access->psz_location, psz_parser_nat);
-
-	memset(nat_ip,0,20);
-	if(psz_parser_nat != NULL)
-	{
-		psz_parser_nat +=4;
-
-		int i=0;	
-		for(i=0; i< 20; i++)
-		{
-			nat_ip[i] = *(psz_parser_nat++);
-			msg_Dbg("nat_ip=[%d]%d \n", i, nat_ip[i]);
-			if(*psz_parser_nat == ':')
-			{	
-				break;
-			}
-		}
-		psz_parser_nat++;
-		msg_Dbg(p_access , "psz_parser_nat--- = %s \n", psz_parser_nat);
-
-		nat_port = atoi(psz_parser_nat);
-
-		msg_Dbg(p_access , "nat_ip = %s nat_port = %d\n", nat_ip, nat_port);
-
-		struct sockaddr_in RecvAddr;
-	 	int iResult;
-	 	RecvAddr.sin_family = AF_INET;
-		RecvAddr.sin_port = htons(nat_port);
-		RecvAddr.sin_addr.s_addr = inet_addr(nat_ip);
-
-	  
-	   iResult = sendto(sys->fd,
-		                 "helloword", 10, 0, (SOCKADDR *) &RecvAddr, sizeof (RecvAddr));
-		if (iResult == -1) {
-		    msg_Dbg( p_access, "sendto failed with error: %d\n", WSAGetLastError());
-		 
-		}
-		 
-	} 
-
- 
-    // ^^^ wenfeng
+
+    NatPunch( p_access );
 
     sys->fifo_size = var_InheritInteger( p_access, "udp-buffer");
 
-    if( vlc_clone( &sys->thread, ThreadRead, p_access,
+    void *(*reader)( void * ) = ThreadRead;
+#ifdef HAVE_RECVMMSG
+    sys->batch = var_InheritInteger( p_access, "udp-batch" );
+    sys->pool = NULL;
+    if( sys->batch > 1 && BatchInit( p_access ) == VLC_SUCCESS )
+        reader = ThreadReadBatch;
+#endif
+
+    if( vlc_clone( &sys->thread, reader, p_access,
                    VLC_THREAD_PRIORITY_INPUT ) )
     {
+#ifdef HAVE_RECVMMSG
+        BatchClean( p_access );
+#endif
         block_FifoRelease( sys->fifo );
         net_Close( sys->fd );
 error:
         free( sys );
         return VLC_EGENERIC;
     }
-	
-	// vvv wenfeng
-	psz_parser_kplv = strstr( p_access->psz_location, "kplv=");
-	if(psz_parser_kplv !=  NULL)
-	{
- 	    vlc_clone( &sys->kplv_thread, Threadsendkeep_alive, p_access,
-                   VLC_THREAD_PRIORITY_INPUT ) ;
-	    sys->kplv_flag = 1;
-	}
-	else
-	{
-		 sys->kplv_flag = 0;
-	}
-    // ^^^ wenfeng
-	 
 
+    sys->keepalive = KeepAliveStart( p_access );
     return VLC_SUCCESS;
 }
 
-
-// vvv wenfeng
-static void *Threadsendkeep_alive(void *data)
-{
-    access_t *access = data;
-    access_sys_t *sys = access->p_sys;
- 	struct sockaddr_in RecvAddr;
-
-  char *psz_name = strdup( access->psz_location );
-  char *psz_parser;
-	char kplv_ip[20];
-	int kplv_port;	
-	psz_parser = strstr(psz_name, "kplv=");
-
-	memset(kplv_ip, 0 ,20);
-
-	if(psz_parser != NULL)
-	{
-		psz_parser +=5;
-
-		int i=0;	
-		for(i=0; i< 20; i++)
-		{
-			kplv_ip[i] = *(psz_parser++);
-
-			if(*psz_parser == ':')
-			{	
-				break;
-			}
-		}
-
-	}
-	psz_parser++;
-	kplv_port = atoi(psz_parser);
-	msg_Dbg(access , "keep_ip = %s keep_port = %d\n", kplv_ip, kplv_port);
- 
-
- 	RecvAddr.sin_family = AF_INET;
-    RecvAddr.sin_port = htons(kplv_port);
-    RecvAddr.sin_addr.s_addr = inet_addr(kplv_ip);
-
-   int iResult;
-  
-
-   for(;;)
-   	{
-  
-	   iResult = sendto(sys->fd,
-		                 "helloword", 10, 0, (SOCKADDR *) & RecvAddr, sizeof (RecvAddr));
-		if (iResult == -1) {
-		    msg_Dbg( access, "sendto failed with error: %d\n", WSAGetLastError());
-
-		}
-		msleep(3000000);
-
-	  
-	  
-		//  msg_Dbg( access, "hello word length = %d	\n", bytesSent);
-		
-		if( errno == EINTR )
-		   break;
-
-   	}
-  
-}
-// ^^^ wenfeng
 /*****************************************************************************
  * Close: free unused data structures
  *****************************************************************************/
@@ -326,14 +280,14 @@ static void Close( vlc_object_t *p_this )
     access_t     *p_access = (access_t*)p_this;
     access_sys_t *sys = p_access->p_sys;
 
-	if(sys->kplv_flag == 1)
-	{
-    	vlc_cancel( sys->kplv_thread );
-    	vlc_join( sys->kplv_thread, NULL );
-	}
+    if( sys->keepalive != NULL )
+        KeepAliveStop( sys->keepalive );
 
     vlc_cancel( sys->thread );
     vlc_join( sys->thread, NULL );
+#ifdef HAVE_RECVMMSG
+    BatchClean( p_access );
+#endif
     block_FifoRelease( sys->fifo );
     net_Close( sys->fd );
     free( sys );
@@ -424,3 +378,670 @@ static void* ThreadRead( void *data )
     block_FifoWake( sys->fifo );
     return NULL;
 }
+
+/*****************************************************************************
+ * NAT traversal: datagrams sent from the receiving socket, once when opening
+ * (hole punching) and periodically (keep-alive) so that the NAT binding
+ * through which the stream arrives does not expire.
+ *
+ * The keep-alive datagrams of all inputs are sent by a single thread, from a
+ * timer wheel of KEEPALIVE_SLOTS slots of KEEPALIVE_TICK each. Entries due
+ * further than one turn away wait for the needed number of turns.
+ *****************************************************************************/
+#define KEEPALIVE_TICK  (CLOCK_FREQ / 10)
+#define KEEPALIVE_SLOTS 64
+
+struct udp_keepalive_t
+{
+    udp_keepalive_t *next;      /**< in its wheel slot */
+    vlc_object_t    *obj;
+    int              fd;
+    unsigned         ticks;     /**< interval */
+    unsigned         slot;
+    unsigned         rounds;    /**< wheel turns left before sending */
+    bool             failing;   /**< last send failed (logged once) */
+    socklen_t        addrlen;
+    struct sockaddr_storage addr;
+    size_t           length;
+    char             payload[];
+};
+
+static struct
+{
+    vlc_mutex_t      lock;      /**< protects the wheel */
+    vlc_mutex_t      users_lock; /**< protects users and the thread */
+    vlc_thread_t     thread;
+    unsigned         users;
+    unsigned         slot;      /**< current slot */
+    udp_keepalive_t *wheel[KEEPALIVE_SLOTS];
+} keepalive = {
+    .lock = VLC_STATIC_MUTEX,
+    .users_lock = VLC_STATIC_MUTEX,
+};
+
+/**
+ * Resolves a host:port or [IPv6]:port destination, in the address family of
+ * the socket it will be sent from.
+ */
+static int NatResolve( access_t *access, int fd, const char *dest,
+                       struct sockaddr_storage *addr, socklen_t *addrlen )
+{
+    char *host = strdup( dest );
+    if( unlikely(host == NULL) )
+        return VLC_ENOMEM;
+
+    char *port = host;
+    if( host[0] == '[' )
+    {
+        /* skips bracket'd IPv6 address */
+        port = strchr( host, ']' );
+        if( port != NULL )
+        {
+            memmove( host, host + 1, port - host - 1 );
+            port[-1] = '\0';
+        }
+    }
+    if( port != NULL )
+        port = strrchr( port, ':' );
+    if( port == NULL || atoi( port + 1 ) <= 0 )
+    {
+        msg_Err( access, "invalid NAT destination %s (expected host:port)",
+                 dest );
+        free( host );
+        return VLC_EGENERIC;
+    }
+    *port++ = '\0';
+
+    struct sockaddr_storage local;
+    socklen_t locallen = sizeof( local );
+    struct addrinfo hints = {
+        .ai_socktype = SOCK_DGRAM,
+        .ai_protocol = IPPROTO_UDP,
+    }, *res;
+
+    if( getsockname( fd, (struct sockaddr *)&local, &locallen ) == 0 )
+        hints.ai_family = local.ss_family;
+
+    int val = vlc_getaddrinfo( host, atoi( port ), &hints, &res );
+    if( val )
+    {
+        msg_Err( access, "cannot resolve NAT destination %s: %s", dest,
+                 gai_strerror( val ) );
+        free( host );
+        return VLC_EGENERIC;
+    }
+
+    memcpy( addr, res->ai_addr, res->ai_addrlen );
+    *addrlen = res->ai_addrlen;
+    freeaddrinfo( res );
+    free( host );
+    return VLC_SUCCESS;
+}
+
+/**
+ * Gets a NAT destination from its option, or from the former location
+ * syntax (udp://@:port...nat=ip:port...kplv=ip:port), IPv4 only.
+ */
+static char *NatDestination( access_t *access, const char *option,
+                             const char *legacy )
+{
+    char *dest = var_InheritString( access, option );
+    if( dest != NULL )
+        return dest;
+
+    const char *str = strstr( access->psz_location, legacy );
+    if( str == NULL )
+        return NULL;
+    str += strlen( legacy );
+
+    size_t hostlen = strspn( str, "0123456789." );
+    if( hostlen == 0 || str[hostlen] != ':' )
+        return NULL;
+    if( asprintf( &dest, "%.*s:%d", (int)hostlen, str,
+                  atoi( str + hostlen + 1 ) ) == -1 )
+        dest = NULL;
+    return dest;
+}
+
+static void NatSend( vlc_object_t *obj, int fd, const void *payload,
+                     size_t length, const struct sockaddr_storage *addr,
+                     socklen_t addrlen, bool *failing )
+{
+    if( sendto( fd, payload, length, MSG_DONTWAIT,
+                (const struct sockaddr *)addr, addrlen ) == -1 )
+    {
+        if( !*failing )
+            msg_Warn( obj, "cannot send NAT keep-alive: %s",
+                      vlc_strerror_c(errno) );
+        *failing = true;
+    }
+    else
+        *failing = false;
+}
+
+static void NatPunch( access_t *access )
+{
+    access_sys_t *sys = access->p_sys;
+    char *dest = NatDestination( access, "udp-punch", "nat=" );
+    if( dest == NULL )
+        return;
+
+    struct sockaddr_storage addr;
+    socklen_t addrlen;
+
+    if( NatResolve( access, sys->fd, dest, &addr, &addrlen ) == VLC_SUCCESS )
+    {
+        char *payload = var_InheritString( access, "udp-keepalive-payload" );
+        bool failing = false;
+
+        msg_Dbg( access, "punching NAT towards %s", dest );
+        NatSend( VLC_OBJECT(access), sys->fd, payload ? payload : "",
+                 payload ? strlen( payload ) + 1 : 0, &addr, addrlen,
+                 &failing );
+        free( payload );
+    }
+    free( dest );
+}
+
+/* Must be called with the wheel lock held */
+static void KeepAliveSchedule( udp_keepalive_t *ka )
+{
+    ka->slot = (keepalive.slot + ka->ticks) % KEEPALIVE_SLOTS;
+    ka->rounds = (ka->ticks - 1) / KEEPALIVE_SLOTS;
+    ka->next = keepalive.wheel[ka->slot];
+    keepalive.wheel[ka->slot] = ka;
+}
+
+static void *KeepAliveThread( void *data )
+{
+    mtime_t deadline = mdate();
+
+    (void) data;
+    for( ;; )
+    {
+        deadline += KEEPALIVE_TICK;
+        mwait( deadline );
+
+        int canc = vlc_savecancel();
+        vlc_mutex_lock( &keepalive.lock );
+        keepalive.slot = (keepalive.slot + 1) % KEEPALIVE_SLOTS;
+
+        /* Unlink the entries due at this tick */
+        udp_keepalive_t **pp = &keepalive.wheel[keepalive.slot], *due = NULL;
+        while( *pp != NULL )
+        {
+            udp_keepalive_t *ka = *pp;
+
+            if( ka->rounds > 0 )
+            {
+                ka->rounds--;
+                pp = &ka->next;
+                continue;
+            }
+            *pp = ka->next;
+            ka->next = due;
+            due = ka;
+        }
+
+        while( due != NULL )
+        {
+            udp_keepalive_t *ka = due;
+
+            due = ka->next;
+            NatSend( ka->obj, ka->fd, ka->payload, ka->length, &ka->addr,
+                     ka->addrlen, &ka->failing );
+            KeepAliveSchedule( ka );
+        }
+        vlc_mutex_unlock( &keepalive.lock );
+        vlc_restorecancel( canc );
+
+        /* Do not try to catch up after a suspension */
+        if( deadline < mdate() - KEEPALIVE_TICK )
+            deadline = mdate();
+    }
+    return NULL;
+}
+
+static udp_keepalive_t *KeepAliveStart( access_t *access )
+{
+    access_sys_t *sys = access->p_sys;
+    char *dest = NatDestination( access, "udp-keepalive", "kplv=" );
+    if( dest == NULL )
+        return NULL;
+
+    char *payload = var_InheritString( access, "udp-keepalive-payload" );
+    size_t length = payload ? strlen( payload ) + 1 : 0;
+    mtime_t interval = var_InheritInteger( access, "udp-keepalive-interval" )
+                     * (CLOCK_FREQ / 1000);
+    udp_keepalive_t *ka = malloc( sizeof( *ka ) + length );
+
+    if( unlikely(ka == NULL) )
+        goto error;
+    if( NatResolve( access, sys->fd, dest, &ka->addr, &ka->addrlen ) )
+    {
+        free( ka );
+        ka = NULL;
+        goto error;
+    }
+
+    ka->obj = VLC_OBJECT(access);
+    ka->fd = sys->fd;
+    ka->ticks = __MAX( interval / KEEPALIVE_TICK, 1 );
+    ka->failing = false;
+    ka->length = length;
+    if( length > 0 )
+        memcpy( ka->payload, payload, length );
+
+    msg_Dbg( access, "sending NAT keep-alive to %s every %"PRId64" ms",
+             dest, interval / (CLOCK_FREQ / 1000) );
+    NatSend( ka->obj, ka->fd, ka->payload, ka->length, &ka->addr,
+             ka->addrlen, &ka->failing );
+
+    vlc_mutex_lock( &keepalive.users_lock );
+    if( keepalive.users == 0
+     && vlc_clone( &keepalive.thread, KeepAliveThread, NULL,
+                   VLC_THREAD_PRIORITY_LOW ) )
+    {
+        vlc_mutex_unlock( &keepalive.users_lock );
+        free( ka );
+        ka = NULL;
+        goto error;
+    }
+    keepalive.users++;
+
+    vlc_mutex_lock( &keepalive.lock );
+    KeepAliveSchedule( ka );
+    vlc_mutex_unlock( &keepalive.lock );
+    vlc_mutex_unlock( &keepalive.users_lock );
+error:
+    free( payload );
+    free( dest );
+    return ka;
+}
+
+static void KeepAliveStop( udp_keepalive_t *ka )
+{
+    vlc_mutex_lock( &keepalive.users_lock );
+    vlc_mutex_lock( &keepalive.lock );
+    for( udp_keepalive_t **pp = &keepalive.wheel[ka->slot]; *pp != NULL;
+         pp = &(*pp)->next )
+    {
+        if( *pp == ka )
+        {
+            *pp = ka->next;
+            break;
+        }
+    }
+    vlc_mutex_unlock( &keepalive.lock );
+
+    /* The thread only takes the wheel lock, so it can be joined here */
+    if( --keepalive.users == 0 )
+    {
+        vlc_cancel( keepalive.thread );
+        vlc_join( keepalive.thread, NULL );
+    }
+    vlc_mutex_unlock( &keepalive.users_lock );
+    free( ka );
+}
+
+#ifdef HAVE_RECVMMSG
+/*****************************************************************************
+ * Packet pool: datagrams are received straight into fixed-size blocks which
+ * are recycled when the demuxer releases them, instead of one block_Alloc()
+ * and block_Realloc() per datagram.
+ *
+ * The pool is reference counted by the access and by every packet in flight,
+ * so that packets still owned by the input can be released after Close().
+ *****************************************************************************/
+struct udp_pool_t
+{
+    vlc_mutex_t lock;
+    block_t    *free;       /**< recycled packets, linked through p_next */
+    unsigned    free_count;
+    unsigned    free_max;   /**< maximum number of recycled packets kept */
+    unsigned    refs;       /**< access + packets in flight */
+    size_t      size;       /**< buffer size of each packet */
+};
+
+typedef struct
+{
+    block_t     self;
+    udp_pool_t *pool;
+} udp_packet_t;
+
+static void PoolDestroy( udp_pool_t *pool )
+{
+    block_t *block = pool->free;
+
+    while( block != NULL )
+    {
+        block_t *next = block->p_next;
+        free( block );
+        block = next;
+    }
+    vlc_mutex_destroy( &pool->lock );
+    free( pool );
+}
+
+static void PacketRelease( block_t *block )
+{
+    udp_pool_t *pool = ((udp_packet_t *)block)->pool;
+    bool last;
+
+    vlc_mutex_lock( &pool->lock );
+    if( pool->free_count < pool->free_max )
+    {
+        block->p_next = pool->free;
+        pool->free = block;
+        pool->free_count++;
+        block = NULL;
+    }
+    last = --pool->refs == 0;
+    vlc_mutex_unlock( &pool->lock );
+
+    free( block );
+    if( last )
+        PoolDestroy( pool );
+}
+
+static udp_pool_t *PoolNew( size_t size, unsigned free_max )
+{
+    udp_pool_t *pool = malloc( sizeof( *pool ) );
+    if( unlikely(pool == NULL) )
+        return NULL;
+
+    vlc_mutex_init( &pool->lock );
+    pool->free = NULL;
+    pool->free_count = 0;
+    pool->free_max = free_max;
+    pool->refs = 1;
+    pool->size = size;
+    return pool;
+}
+
+static void PoolRelease( udp_pool_t *pool )
+{
+    bool last;
+
+    vlc_mutex_lock( &pool->lock );
+    pool->free_max = 0; /* stop recycling late packets */
+    last = --pool->refs == 0;
+    vlc_mutex_unlock( &pool->lock );
+
+    if( last )
+        PoolDestroy( pool );
+}
+
+/**
+ * Fills the empty entries of a packet array, taking the pool lock only once.
+ * @return the number of entries which could not be filled (out of memory)
+ */
+static unsigned PoolRefill( udp_pool_t *pool, block_t **tab, unsigned count )
+{
+    unsigned missing = 0;
+
+    vlc_mutex_lock( &pool->lock );
+    for( unsigned i = 0; i < count; i++ )
+    {
+        if( tab[i] != NULL )
+            continue;
+        tab[i] = pool->free;
+        if( tab[i] != NULL )
+        {
+            pool->free = tab[i]->p_next;
+            pool->free_count--;
+        }
+        else
+            missing++;
+        pool->refs++;
+    }
+    vlc_mutex_unlock( &pool->lock );
+
+    for( unsigned i = 0; i < count && missing > 0; i++ )
+    {
+        if( tab[i] != NULL )
+            continue;
+
+        udp_packet_t *pkt = malloc( sizeof( *pkt ) + pool->size );
+        if( unlikely(pkt == NULL) )
+            break;
+        pkt->pool = pool;
+        tab[i] = &pkt->self;
+        missing--;
+    }
+
+    if( unlikely(missing > 0) )
+    {
+        vlc_mutex_lock( &pool->lock );
+        pool->refs -= missing;
+        vlc_mutex_unlock( &pool->lock );
+    }
+    return missing;
+}
+
+static int BatchInit( access_t *p_access )
+{
+    access_sys_t *sys = p_access->p_sys;
+    unsigned n = sys->batch;
+    size_t size = var_InheritInteger( p_access, "udp-packet-size" );
+
+    sys->calls = sys->packets = sys->truncated = sys->nomem = 0;
+    sys->overflows = 0;
+    sys->last_stats = mdate();
+
+    /* Keep enough recycled packets for a few batches in flight */
+    sys->pool = PoolNew( size, 4 * n );
+    if( unlikely(sys->pool == NULL) )
+        return VLC_ENOMEM;
+
+    /* Destroyed by BatchClean(), once the pool exists */
+    var_Create( p_access, "udp-batch-average", VLC_VAR_FLOAT );
+    var_Create( p_access, "udp-drops", VLC_VAR_INTEGER );
+
+    sys->slots = calloc( n, sizeof( *sys->slots ) );
+    sys->msgs = calloc( n, sizeof( *sys->msgs ) );
+    sys->iov = calloc( n, sizeof( *sys->iov ) );
+    sys->cmsg = calloc( n, sizeof( *sys->cmsg ) );
+    if( unlikely(sys->slots == NULL || sys->msgs == NULL
+              || sys->iov == NULL || sys->cmsg == NULL) )
+    {
+        BatchClean( p_access );
+        return VLC_ENOMEM;
+    }
+
+    for( unsigned i = 0; i < n; i++ )
+    {
+        struct msghdr *hdr = &sys->msgs[i].msg_hdr;
+
+        hdr->msg_iov = &sys->iov[i];
+        hdr->msg_iovlen = 1;
+    }
+
+#ifdef SO_RXQ_OVFL
+    /* Have the kernel report the number of datagrams it had to drop */
+    setsockopt( sys->fd, SOL_SOCKET, SO_RXQ_OVFL, &(int){ 1 }, sizeof (int) );
+#endif
+
+    msg_Dbg( p_access, "receiving up to %u datagrams of %zu bytes per call",
+             n, size );
+    return VLC_SUCCESS;
+}
+
+static void BatchClean( access_t *p_access )
+{
+    access_sys_t *sys = p_access->p_sys;
+
+    if( sys->pool == NULL )
+        return;
+
+    if( sys->slots != NULL )
+        for( unsigned i = 0; i < sys->batch; i++ )
+            if( sys->slots[i] != NULL )
+                PacketRelease( sys->slots[i] );
+
+    if( sys->calls > 0 )
+        msg_Dbg( p_access, "received %"PRIu64" datagrams in %"PRIu64
+                 " calls, %"PRIu64" truncated, %"PRIu64" lost (memory), "
+                 "%"PRIu32" dropped by the kernel", sys->packets,
+                 sys->calls, sys->truncated, sys->nomem, sys->overflows );
+    var_Destroy( p_access, "udp-drops" );
+    var_Destroy( p_access, "udp-batch-average" );
+
+    free( sys->cmsg );
+    free( sys->iov );
+    free( sys->msgs );
+    free( sys->slots );
+    PoolRelease( sys->pool );
+    sys->pool = NULL;
+}
+
+static void BatchStats( access_t *access )
+{
+    access_sys_t *sys = access->p_sys;
+    mtime_t now = mdate();
+
+    if( now - sys->last_stats < CLOCK_FREQ )
+        return;
+    sys->last_stats = now;
+
+    var_SetFloat( access, "udp-batch-average",
+                  (float)sys->packets / (float)sys->calls );
+    var_SetInteger( access, "udp-drops",
+                    sys->truncated + sys->nomem + sys->overflows );
+}
+
+/**
+ * Waits for datagrams and receives as many of them as there are armed
+ * packets (count).
+ * This is a cancellation point.
+ * @return the number of datagrams, or -1 on a fatal error
+ */
+static int RecvBatch( access_t *access, unsigned count )
+{
+    access_sys_t *sys = access->p_sys;
+    struct pollfd ufd = { .fd = sys->fd, .events = POLLIN };
+
+    for( ;; )
+    {
+        int val = recvmmsg( sys->fd, sys->msgs, count, MSG_DONTWAIT, NULL );
+        if( val >= 0 )
+            return val;
+
+        switch( errno )
+        {
+            case EAGAIN:
+#if (EAGAIN != EWOULDBLOCK)
+            case EWOULDBLOCK:
+#endif
+                break;
+            case EINTR:
+                continue;
+            case ECONNREFUSED:
+                /* ICMP error from the connected source, reported once */
+                msg_Warn( access, "receive error: %s", vlc_strerror_c(errno) );
+                return 0;
+            default:
+                msg_Err( access, "receive error: %s", vlc_strerror_c(errno) );
+                return -1;
+        }
+
+        /* Wait for data, Close() cancels the thread while it waits */
+        val = poll( &ufd, 1, -1 );
+        if( val < 0 && errno != EINTR )
+        {
+            msg_Err( access, "poll error: %s", vlc_strerror_c(errno) );
+            return -1;
+        }
+    }
+}
+
+/*****************************************************************************
+ * ThreadReadBatch: Pull packets from socket as soon as possible, several
+ * datagrams at a time, into recycled buffers.
+ *****************************************************************************/
+static void* ThreadReadBatch( void *data )
+{
+    access_t *access = data;
+    access_sys_t *sys = access->p_sys;
+    udp_pool_t *pool = sys->pool;
+
+    for( ;; )
+    {
+        unsigned n = sys->batch;
+        ssize_t val;
+
+        block_FifoPace( sys->fifo, SIZE_MAX, sys->fifo_size );
+
+        if( PoolRefill( pool, sys->slots, n ) > 0 )
+        {
+            /* Receive into the leading armed packets only */
+            sys->nomem++;
+            for( n = 0; n < sys->batch && sys->slots[n] != NULL; n++ );
+            if( n == 0 )
+                break;
+        }
+
+        for( unsigned i = 0; i < n; i++ )
+        {
+            block_t *pkt = sys->slots[i];
+            struct msghdr *hdr = &sys->msgs[i].msg_hdr;
+
+            block_Init( pkt, ((udp_packet_t *)pkt) + 1, pool->size );
+            pkt->pf_release = PacketRelease;
+            sys->iov[i].iov_base = pkt->p_buffer;
+            sys->iov[i].iov_len = pkt->i_buffer;
+            hdr->msg_control = sys->cmsg[i].buf;
+            hdr->msg_controllen = sizeof( sys->cmsg[i].buf );
+            hdr->msg_flags = 0;
+        }
+
+        val = RecvBatch( access, n );
+        if( val < 0 )
+            break; /* end of stream */
+        if( val == 0 )
+            continue;
+
+        block_t *chain = NULL, **pp = &chain;
+        unsigned received = 0;
+
+        for( ssize_t i = 0; i < val; i++ )
+        {
+            struct msghdr *hdr = &sys->msgs[i].msg_hdr;
+
+#ifdef SO_RXQ_OVFL
+            for( struct cmsghdr *c = CMSG_FIRSTHDR( hdr ); c != NULL;
+                 c = CMSG_NXTHDR( hdr, c ) )
+                if( c->cmsg_level == SOL_SOCKET && c->cmsg_type == SO_RXQ_OVFL )
+                    memcpy( &sys->overflows, CMSG_DATA( c ),
+                            sizeof( sys->overflows ) );
+#endif
+            if( hdr->msg_flags & MSG_TRUNC )
+            {   /* Keep the packet armed for the next call */
+                if( sys->truncated++ == 0 )
+                    msg_Warn( access, "datagram larger than %zu bytes "
+                              "dropped (see udp-packet-size)", pool->size );
+                continue;
+            }
+
+            block_t *pkt = sys->slots[i];
+
+            pkt->i_buffer = sys->msgs[i].msg_len;
+            *pp = pkt;
+            pp = &pkt->p_next;
+            sys->slots[i] = NULL;
+            received++;
+        }
+
+        /* Queue the whole batch at once */
+        if( chain != NULL )
+            block_FifoPut( sys->fifo, chain );
+
+        sys->calls++;
+        sys->packets += received;
+        BatchStats( access );
+    }
+
+    block_FifoWake( sys->fifo );
+    return NULL;
+}
+#endif
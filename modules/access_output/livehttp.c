@@ -43,6 +43,7 @@
 #include <vlc_fs.h>
 #include <vlc_strings.h>
 #include <vlc_charset.h>
+#include <vlc_httpd.h>
 
 #include <gcrypt.h>
 #include <vlc_gcrypt.h>
@@ -105,6 +106,17 @@ static void Close( vlc_object_t * );
 #define INTITIAL_SEG_TEXT N_("Number of first segment")
 #define INITIAL_SEG_LONGTEXT N_("The number of the first segment generated")
 
+#define QUEUE_TEXT N_("Writer queue size (MiB)")
+#define QUEUE_LONGTEXT N_("Segments are encrypted and written by a " \
+                          "background thread. The stream is held up when " \
+                          "this much data is waiting to be written.")
+
+#define MEMORY_TEXT N_("Serve segments from memory")
+#define MEMORY_LONGTEXT N_("Keep the index and the segments still in the " \
+                           "index in memory, and serve them with the " \
+                           "built-in HTTP server instead of writing files. " \
+                           "The index and segment paths are then URL paths.")
+
 vlc_module_begin ()
     set_description( N_("HTTP Live streaming output") )
     set_shortname( N_("LiveHTTP" ))
@@ -135,6 +147,10 @@ vlc_module_begin ()
                 KEYFILE_TEXT, KEYFILE_LONGTEXT, true )
     add_loadfile( SOUT_CFG_PREFIX "key-loadfile", NULL,
                 KEYLOADFILE_TEXT, KEYLOADFILE_LONGTEXT, true )
+    add_integer( SOUT_CFG_PREFIX "queue", 32, QUEUE_TEXT, QUEUE_LONGTEXT, true )
+        change_integer_range( 1, 1024 )
+    add_bool( SOUT_CFG_PREFIX "memory", false,
+              MEMORY_TEXT, MEMORY_LONGTEXT, true )
     set_callbacks( Open, Close )
 vlc_module_end ()
 
@@ -156,6 +172,8 @@ static const char *const ppsz_sout_options[] = {
     "key-loadfile",
     "generate-iv",
     "initial-segment-number",
+    "queue",
+    "memory",
     NULL
 };
 
@@ -172,6 +190,10 @@ typedef struct output_segment
     float f_seglength;
     uint32_t i_segment_number;
     uint8_t aes_ivs[16];
+    /* in-memory mode */
+    block_t *p_data;
+    block_t **pp_data_last;
+    httpd_file_t *p_file;
 } output_segment_t;
 
 struct sout_access_out_sys_t
@@ -204,6 +226,20 @@ struct sout_access_out_sys_t
     uint8_t stuffing_bytes[16];
     ssize_t stuffing_size;
     vlc_array_t *segments_t;
+    bool b_segment_open;
+
+    /* Write() queues the blocks, everything else runs on WriterThread() */
+    block_fifo_t *p_fifo;
+    vlc_thread_t thread;
+    size_t i_queue_max;
+
+    /* in-memory origin */
+    bool b_memory;
+    httpd_host_t *p_httpd_host;
+    httpd_file_t *p_index_file;
+    vlc_mutex_t index_lock;
+    char *psz_index_data;
+    size_t i_index_data;
 };
 
 static int LoadCryptFile( sout_access_out_t *p_access);
@@ -211,6 +247,11 @@ static int CryptSetup( sout_access_out_t *p_access, char *keyfile );
 static int CheckSegmentChange( sout_access_out_t *p_access, block_t *p_buffer );
 static ssize_t writeSegment( sout_access_out_t *p_access );
 static ssize_t openNextFile( sout_access_out_t *p_access, sout_access_out_sys_t *p_sys );
+static ssize_t WriteBlocks( sout_access_out_t *p_access, block_t *p_buffer );
+static void *WriterThread( void * );
+static int OpenOrigin( sout_access_out_t *p_access );
+static int IndexFill( httpd_file_sys_t *, httpd_file_t *, uint8_t *,
+                      uint8_t **, int * );
 /*****************************************************************************
  * Open: open the file
  *****************************************************************************/
@@ -245,6 +286,9 @@ static int Open( vlc_object_t *p_this )
     p_sys->b_caching = var_GetBool( p_access, SOUT_CFG_PREFIX "caching") ;
     p_sys->b_generate_iv = var_GetBool( p_access, SOUT_CFG_PREFIX "generate-iv") ;
     p_sys->b_segment_has_data = false;
+    p_sys->b_segment_open = false;
+    p_sys->i_queue_max = var_GetInteger( p_access, SOUT_CFG_PREFIX "queue" ) << 20;
+    p_sys->b_memory = var_GetBool( p_access, SOUT_CFG_PREFIX "memory" );
 
     p_sys->segments_t = vlc_array_new();
 
@@ -264,9 +308,12 @@ static int Open( vlc_object_t *p_this )
             free( p_sys );
             return VLC_ENOMEM;
         }
-        path_sanitize( psz_tmp );
         p_sys->psz_indexPath = psz_tmp;
-        vlc_unlink( p_sys->psz_indexPath );
+        if( !p_sys->b_memory )
+        {
+            path_sanitize( psz_tmp );
+            vlc_unlink( p_sys->psz_indexPath );
+        }
     }
 
     p_sys->psz_indexUrl = var_GetNonEmptyString( p_access, SOUT_CFG_PREFIX "index-url" );
@@ -296,11 +343,134 @@ static int Open( vlc_object_t *p_this )
     p_sys->i_segment = p_sys->i_initial_segment > 0 ? p_sys->i_initial_segment -1 : 0;
     p_sys->psz_cursegPath = NULL;
 
+    vlc_mutex_init( &p_sys->index_lock );
+    p_sys->psz_index_data = NULL;
+    p_sys->i_index_data = 0;
+    p_sys->p_httpd_host = NULL;
+    p_sys->p_index_file = NULL;
+
+    if( p_sys->b_memory && OpenOrigin( p_access ) != VLC_SUCCESS )
+        goto error;
+
+    p_sys->p_fifo = block_FifoNewSPSC();
+    if( unlikely(p_sys->p_fifo == NULL) )
+        goto error;
+
+    if( vlc_clone( &p_sys->thread, WriterThread, p_access,
+                   VLC_THREAD_PRIORITY_OUTPUT ) )
+    {
+        msg_Err( p_access, "cannot spawn segment writer thread" );
+        block_FifoRelease( p_sys->p_fifo );
+        goto error;
+    }
+
     p_access->pf_write = Write;
     p_access->pf_seek  = Seek;
     p_access->pf_control = Control;
 
     return VLC_SUCCESS;
+
+error:
+    if( p_sys->p_index_file )
+        httpd_FileDelete( p_sys->p_index_file );
+    if( p_sys->p_httpd_host )
+        httpd_HostDelete( p_sys->p_httpd_host );
+    vlc_mutex_destroy( &p_sys->index_lock );
+    if( p_sys->key_uri )
+    {
+        gcry_cipher_close( p_sys->aes_ctx );
+        free( p_sys->key_uri );
+    }
+    vlc_array_destroy( p_sys->segments_t );
+    free( p_sys->psz_keyfile );
+    free( p_sys->psz_indexUrl );
+    free( p_sys->psz_indexPath );
+    free( p_sys );
+    return VLC_EGENERIC;
+}
+
+/************************************************************************
+ * OpenOrigin: serve the index and the segments with the HTTP server
+ ************************************************************************/
+static int OpenOrigin( sout_access_out_t *p_access )
+{
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+
+#ifdef HAVE_OPEN_MEMSTREAM
+    if( !p_sys->psz_indexPath || p_sys->psz_indexPath[0] != '/' ||
+        p_access->psz_path[0] != '/' )
+    {
+        msg_Err( p_access, "in-memory mode needs absolute URL paths "
+                 "for the index and the segments" );
+        return VLC_EGENERIC;
+    }
+    if( p_sys->i_numsegs == 0 )
+        msg_Warn( p_access, "no number of segments, "
+                  "keeping all segments in memory" );
+
+    p_sys->p_httpd_host = vlc_http_HostNew( VLC_OBJECT(p_access) );
+    if( p_sys->p_httpd_host == NULL )
+    {
+        msg_Err( p_access, "cannot start HTTP server" );
+        return VLC_EGENERIC;
+    }
+
+    p_sys->p_index_file = httpd_FileNew( p_sys->p_httpd_host,
+                                         p_sys->psz_indexPath,
+                                         "application/vnd.apple.mpegurl",
+                                         NULL, NULL, IndexFill,
+                                         (httpd_file_sys_t *)p_sys );
+    if( p_sys->p_index_file == NULL )
+    {
+        msg_Err( p_access, "cannot serve index %s", p_sys->psz_indexPath );
+        return VLC_EGENERIC;
+    }
+    msg_Dbg( p_access, "serving index %s from memory", p_sys->psz_indexPath );
+    return VLC_SUCCESS;
+#else
+    msg_Err( p_access, "in-memory mode is not supported" );
+    return VLC_EGENERIC;
+#endif
+}
+
+static int IndexFill( httpd_file_sys_t *data, httpd_file_t *file,
+                      uint8_t *psz_request, uint8_t **pp_data, int *pi_data )
+{
+    sout_access_out_sys_t *p_sys = (sout_access_out_sys_t *)data;
+    (void) file; (void) psz_request;
+
+    vlc_mutex_lock( &p_sys->index_lock );
+    *pp_data = malloc( p_sys->i_index_data );
+    if( *pp_data != NULL )
+    {
+        memcpy( *pp_data, p_sys->psz_index_data, p_sys->i_index_data );
+        *pi_data = p_sys->i_index_data;
+    }
+    else
+        *pi_data = 0;
+    vlc_mutex_unlock( &p_sys->index_lock );
+    return VLC_SUCCESS;
+}
+
+static int SegmentFill( httpd_file_sys_t *data, httpd_file_t *file,
+                        uint8_t *psz_request, uint8_t **pp_data, int *pi_data )
+{
+    /* the data does not change once the segment is served */
+    const block_t *p_data = ((output_segment_t *)data)->p_data;
+    (void) file; (void) psz_request;
+
+    *pi_data = 0;
+    *pp_data = NULL;
+    if( p_data == NULL )
+        return VLC_SUCCESS;
+
+    *pp_data = malloc( p_data->i_buffer );
+    if( *pp_data != NULL )
+    {
+        memcpy( *pp_data, p_data->p_buffer, p_data->i_buffer );
+        *pi_data = p_data->i_buffer;
+    }
+    return VLC_SUCCESS;
 }
 
 /************************************************************************
@@ -505,6 +675,9 @@ static char *formatSegmentPath( char *psz_path, uint32_t i_seg, bool b_sanitize
 
 static void destroySegment( output_segment_t *segment )
 {
+    if( segment->p_file )
+        httpd_FileDelete( segment->p_file );
+    block_ChainRelease( segment->p_data );
     free( segment->psz_filename );
     free( segment->psz_duration );
     free( segment->psz_uri );
@@ -554,6 +727,72 @@ static bool isFirstItemRemovable( sout_access_out_sys_t *p_sys, uint32_t i_first
     return duration >= (first->f_seglength + (float)(p_sys->i_numsegs * p_sys->i_seglen));
 }
 
+/************************************************************************
+ * writeIndex: print the index of segments i_firstseg..p_sys->i_segment
+ ************************************************************************/
+static int writeIndex( FILE *fp, sout_access_out_sys_t *p_sys,
+                       uint32_t i_firstseg, unsigned i_index_offset,
+                       bool b_isend )
+{
+    if ( fprintf( fp, "#EXTM3U\n#EXT-X-TARGETDURATION:%zu\n#EXT-X-VERSION:3\n#EXT-X-ALLOW-CACHE:%s"
+                      "%s\n#EXT-X-MEDIA-SEQUENCE:%"PRIu32"\n", p_sys->i_seglen,
+                      p_sys->b_caching ? "YES" : "NO",
+                      p_sys->i_numsegs > 0 ? "" : b_isend ? "\n#EXT-X-PLAYLIST-TYPE:VOD" : "\n#EXT-X-PLAYLIST-TYPE:EVENT",
+                      i_firstseg ) < 0 )
+        return -1;
+
+    char *psz_current_uri=NULL;
+
+    for ( uint32_t i = i_firstseg; i <= p_sys->i_segment; i++ )
+    {
+        //scale to i_index_offset..numsegs + i_index_offset
+        uint32_t index = i - i_firstseg + i_index_offset;
+
+        output_segment_t *segment = (output_segment_t *)vlc_array_item_at_index( p_sys->segments_t, index );
+        if( p_sys->key_uri &&
+            ( !psz_current_uri ||  strcmp( psz_current_uri, segment->psz_key_uri ) )
+          )
+        {
+            int ret = 0;
+            free( psz_current_uri );
+            psz_current_uri = strdup( segment->psz_key_uri );
+            if( p_sys->b_generate_iv )
+            {
+                unsigned long long iv_hi = segment->aes_ivs[0];
+                unsigned long long iv_lo = segment->aes_ivs[8];
+                for( unsigned short i = 1; i < 8; i++ )
+                {
+                    iv_hi <<= 8;
+                    iv_hi |= segment->aes_ivs[i] & 0xff;
+                    iv_lo <<= 8;
+                    iv_lo |= segment->aes_ivs[8+i] & 0xff;
+                }
+                ret = fprintf( fp, "#EXT-X-KEY:METHOD=AES-128,URI=\"%s\",IV=0X%16.16llx%16.16llx\n",
+                               segment->psz_key_uri, iv_hi, iv_lo );
+
+            } else {
+                ret = fprintf( fp, "#EXT-X-KEY:METHOD=AES-128,URI=\"%s\"\n", segment->psz_key_uri );
+            }
+            if( ret < 0 )
+            {
+                free( psz_current_uri );
+                return -1;
+            }
+        }
+
+        if ( fprintf( fp, "#EXTINF:%s,\n%s\n", segment->psz_duration, segment->psz_uri) < 0 )
+        {
+            free( psz_current_uri );
+            return -1;
+        }
+    }
+    free( psz_current_uri );
+
+    if ( b_isend && fputs ( STR_ENDLIST, fp ) < 0 )
+        return -1;
+    return 0;
+}
+
 /************************************************************************
  * updateIndexAndDel: If necessary, update index file & delete old segments
  ************************************************************************/
@@ -576,7 +815,31 @@ static int updateIndexAndDel( sout_access_out_t *p_access, sout_access_out_sys_t
     }
 
     // First update index
-    if ( p_sys->psz_indexPath )
+    if ( p_sys->psz_indexPath && p_sys->b_memory )
+    {
+#ifdef HAVE_OPEN_MEMSTREAM
+        char *psz_index;
+        size_t i_index;
+        FILE *fp = open_memstream( &psz_index, &i_index );
+        if ( !fp )
+            return -1;
+
+        int val = writeIndex( fp, p_sys, i_firstseg, i_index_offset, b_isend );
+        if ( fclose( fp ) || val < 0 )
+        {
+            free( psz_index );
+            msg_Err( p_access, "cannot update LiveHttp index" );
+            return -1;
+        }
+
+        vlc_mutex_lock( &p_sys->index_lock );
+        free( p_sys->psz_index_data );
+        p_sys->psz_index_data = psz_index;
+        p_sys->i_index_data = i_index;
+        vlc_mutex_unlock( &p_sys->index_lock );
+#endif
+    }
+    else if ( p_sys->psz_indexPath )
     {
         int val;
         FILE *fp;
@@ -592,79 +855,12 @@ static int updateIndexAndDel( sout_access_out_t *p_access, sout_access_out_sys_t
             return -1;
         }
 
-        if ( fprintf( fp, "#EXTM3U\n#EXT-X-TARGETDURATION:%zu\n#EXT-X-VERSION:3\n#EXT-X-ALLOW-CACHE:%s"
-                          "%s\n#EXT-X-MEDIA-SEQUENCE:%"PRIu32"\n", p_sys->i_seglen,
-                          p_sys->b_caching ? "YES" : "NO",
-                          p_sys->i_numsegs > 0 ? "" : b_isend ? "\n#EXT-X-PLAYLIST-TYPE:VOD" : "\n#EXT-X-PLAYLIST-TYPE:EVENT",
-                          i_firstseg ) < 0 )
+        if ( writeIndex( fp, p_sys, i_firstseg, i_index_offset, b_isend ) < 0 )
         {
             free( psz_idxTmp );
             fclose( fp );
             return -1;
         }
-        char *psz_current_uri=NULL;
-
-
-        for ( uint32_t i = i_firstseg; i <= p_sys->i_segment; i++ )
-        {
-            //scale to i_index_offset..numsegs + i_index_offset
-            uint32_t index = i - i_firstseg + i_index_offset;
-
-            output_segment_t *segment = (output_segment_t *)vlc_array_item_at_index( p_sys->segments_t, index );
-            if( p_sys->key_uri &&
-                ( !psz_current_uri ||  strcmp( psz_current_uri, segment->psz_key_uri ) )
-              )
-            {
-                int ret = 0;
-                free( psz_current_uri );
-                psz_current_uri = strdup( segment->psz_key_uri );
-                if( p_sys->b_generate_iv )
-                {
-                    unsigned long long iv_hi = segment->aes_ivs[0];
-                    unsigned long long iv_lo = segment->aes_ivs[8];
-                    for( unsigned short i = 1; i < 8; i++ )
-                    {
-                        iv_hi <<= 8;
-                        iv_hi |= segment->aes_ivs[i] & 0xff;
-                        iv_lo <<= 8;
-                        iv_lo |= segment->aes_ivs[8+i] & 0xff;
-                    }
-                    ret = fprintf( fp, "#EXT-X-KEY:METHOD=AES-128,URI=\"%s\",IV=0X%16.16llx%16.16llx\n",
-                                   segment->psz_key_uri, iv_hi, iv_lo );
-
-                } else {
-                    ret = fprintf( fp, "#EXT-X-KEY:METHOD=AES-128,URI=\"%s\"\n", segment->psz_key_uri );
-                }
-                if( ret < 0 )
-                {
-                    free( psz_current_uri );
-                    free( psz_idxTmp );
-                    fclose( fp );
-                    return -1;
-                }
-            }
-
-            val = fprintf( fp, "#EXTINF:%s,\n%s\n", segment->psz_duration, segment->psz_uri);
-            if ( val < 0 )
-            {
-                free( psz_current_uri );
-                free( psz_idxTmp );
-                fclose( fp );
-                return -1;
-            }
-        }
-        free( psz_current_uri );
-
-        if ( b_isend )
-        {
-            if ( fputs ( STR_ENDLIST, fp ) < 0)
-            {
-                free( psz_idxTmp );
-                fclose( fp ) ;
-                return -1;
-            }
-
-        }
         fclose( fp );
 
         val = vlc_rename ( psz_idxTmp, p_sys->psz_indexPath);
@@ -682,7 +878,7 @@ static int updateIndexAndDel( sout_access_out_t *p_access, sout_access_out_sys_t
 
     // Then take care of deletion
     // Try to follow pantos draft 11 section 6.2.2
-    while( p_sys->b_delsegs && p_sys->i_numsegs &&
+    while( ( p_sys->b_delsegs || p_sys->b_memory ) && p_sys->i_numsegs &&
            isFirstItemRemovable( p_sys, i_firstseg, i_index_offset )
          )
     {
@@ -690,7 +886,7 @@ static int updateIndexAndDel( sout_access_out_t *p_access, sout_access_out_sys_t
          msg_Dbg( p_access, "Removing segment number %d", segment->i_segment_number );
          vlc_array_remove( p_sys->segments_t, 0 );
 
-         if ( segment->psz_filename )
+         if ( segment->psz_filename && !p_sys->b_memory )
          {
              vlc_unlink( segment->psz_filename );
          }
@@ -708,7 +904,7 @@ static int updateIndexAndDel( sout_access_out_t *p_access, sout_access_out_sys_t
  *****************************************************************************/
 static void closeCurrentSegment( sout_access_out_t *p_access, sout_access_out_sys_t *p_sys, bool b_isend )
 {
-    if ( p_sys->i_handle >= 0 )
+    if ( p_sys->b_segment_open )
     {
         output_segment_t *segment = (output_segment_t *)vlc_array_item_at_index( p_sys->segments_t, vlc_array_count( p_sys->segments_t ) - 1 );
 
@@ -720,6 +916,13 @@ static void closeCurrentSegment( sout_access_out_t *p_access, sout_access_out_sy
 
             if( err ) {
                msg_Err( p_access, "Couldn't encrypt 16 bytes: %s", gpg_strerror(err) );
+            } else if( p_sys->b_memory ) {
+                block_t *p_stuffing = block_Alloc( 16 );
+                if( likely(p_stuffing != NULL) )
+                {
+                    memcpy( p_stuffing->p_buffer, p_sys->stuffing_bytes, 16 );
+                    block_ChainLastAppend( &segment->pp_data_last, p_stuffing );
+                }
             } else {
             int ret = write( p_sys->i_handle, p_sys->stuffing_bytes, 16 );
             if( ret != 16 )
@@ -729,8 +932,25 @@ static void closeCurrentSegment( sout_access_out_t *p_access, sout_access_out_sy
         }
 
 
-        close( p_sys->i_handle );
+        if( p_sys->i_handle >= 0 )
+            close( p_sys->i_handle );
         p_sys->i_handle = -1;
+        p_sys->b_segment_open = false;
+
+        if( p_sys->b_memory )
+        {
+            /* publish the complete segment, it is never modified again */
+            segment->p_data = block_ChainGather( segment->p_data );
+            segment->pp_data_last = NULL;
+            segment->p_file = httpd_FileNew( p_sys->p_httpd_host,
+                                             segment->psz_filename,
+                                             "video/MP2T", NULL, NULL,
+                                             SegmentFill,
+                                             (httpd_file_sys_t *)segment );
+            if( segment->p_file == NULL )
+                msg_Err( p_access, "cannot serve segment %s",
+                         segment->psz_filename );
+        }
 
         if( ! ( us_asprintf( &segment->psz_duration, "%.2f", p_sys->f_seglen ) ) )
         {
@@ -758,6 +978,13 @@ static void Close( vlc_object_t * p_this )
 {
     sout_access_out_t *p_access = (sout_access_out_t*)p_this;
     sout_access_out_sys_t *p_sys = p_access->p_sys;
+
+    /* let the writer thread catch up, then take over */
+    block_FifoPace( p_sys->p_fifo, 0, 0 );
+    vlc_cancel( p_sys->thread );
+    vlc_join( p_sys->thread, NULL );
+    block_FifoRelease( p_sys->p_fifo );
+
     block_t *output_block = p_sys->block_buffer;
     p_sys->block_buffer = NULL;
     p_sys->last_block_buffer = &p_sys->block_buffer;
@@ -785,7 +1012,7 @@ static void Close( vlc_object_t * p_this )
             }
             p_sys->i_opendts = p_sys->block_buffer ? p_sys->block_buffer->i_dts : output_block->i_dts;
         }
-        Write( p_access, output_block );
+        WriteBlocks( p_access, output_block );
         output_block = p_next;
     }
 
@@ -810,7 +1037,8 @@ static void Close( vlc_object_t * p_this )
     {
         output_segment_t *segment = vlc_array_item_at_index( p_sys->segments_t, 0 );
         vlc_array_remove( p_sys->segments_t, 0 );
-        if( p_sys->b_delsegs && p_sys->i_numsegs && segment->psz_filename )
+        if( p_sys->b_delsegs && p_sys->i_numsegs && segment->psz_filename &&
+            !p_sys->b_memory )
         {
             msg_Dbg( p_access, "Removing segment number %d name %s", segment->i_segment_number, segment->psz_filename );
             vlc_unlink( segment->psz_filename );
@@ -820,6 +1048,14 @@ static void Close( vlc_object_t * p_this )
     }
     vlc_array_destroy( p_sys->segments_t );
 
+    if( p_sys->p_index_file )
+        httpd_FileDelete( p_sys->p_index_file );
+    if( p_sys->p_httpd_host )
+        httpd_HostDelete( p_sys->p_httpd_host );
+    vlc_mutex_destroy( &p_sys->index_lock );
+    free( p_sys->psz_index_data );
+
+    free( p_sys->psz_keyfile );
     free( p_sys->psz_indexUrl );
     free( p_sys->psz_indexPath );
     free( p_sys );
@@ -862,7 +1098,8 @@ static ssize_t openNextFile( sout_access_out_t *p_access, sout_access_out_sys_t
         return -1;
 
     segment->i_segment_number = i_newseg;
-    segment->psz_filename = formatSegmentPath( p_access->psz_path, i_newseg, true );
+    segment->psz_filename = formatSegmentPath( p_access->psz_path, i_newseg, !p_sys->b_memory );
+    segment->pp_data_last = &segment->p_data;
     char *psz_idxFormat = p_sys->psz_indexUrl ? p_sys->psz_indexUrl : p_access->psz_path;
     segment->psz_uri = formatSegmentPath( psz_idxFormat , i_newseg, false );
 
@@ -873,9 +1110,10 @@ static ssize_t openNextFile( sout_access_out_t *p_access, sout_access_out_sys_t
         return -1;
     }
 
-    fd = vlc_open( segment->psz_filename, O_WRONLY | O_CREAT | O_LARGEFILE |
-                     O_TRUNC, 0666 );
-    if ( fd == -1 )
+    if ( p_sys->b_memory )
+        fd = -1;
+    else if ( ( fd = vlc_open( segment->psz_filename, O_WRONLY | O_CREAT |
+                               O_LARGEFILE | O_TRUNC, 0666 ) ) == -1 )
     {
         msg_Err( p_access, "cannot open `%s' (%s)", segment->psz_filename,
                  vlc_strerror_c(errno) );
@@ -903,7 +1141,8 @@ static ssize_t openNextFile( sout_access_out_t *p_access, sout_access_out_sys_t
     p_sys->i_handle = fd;
     p_sys->i_segment = i_newseg;
     p_sys->b_segment_has_data = false;
-    return fd;
+    p_sys->b_segment_open = true;
+    return VLC_SUCCESS;
 }
 /*****************************************************************************
  * CheckSegmentChange: Check if segment needs to be closed and new opened
@@ -925,14 +1164,14 @@ static int CheckSegmentChange( sout_access_out_t *p_access, block_t *p_buffer )
         msg_Dbg( p_access, "dts offset %"PRId64, p_sys->i_dts_offset );
     }
 
-    if( p_sys->i_handle > 0 && p_sys->b_segment_has_data &&
+    if( p_sys->b_segment_open && p_sys->b_segment_has_data &&
        (( p_buffer->i_length + p_buffer->i_dts - p_sys->i_opendts +
           p_sys->i_dts_offset ) >= p_sys->i_seglenm ) )
     {
         closeCurrentSegment( p_access, p_sys, false );
     }
 
-    if ( unlikely( p_sys->i_handle < 0 ) )
+    if ( unlikely( !p_sys->b_segment_open ) )
     {
         p_sys->i_dts_offset = 0;
         p_sys->i_opendts = output ? output->i_dts : p_buffer->i_dts;
@@ -987,6 +1226,26 @@ static ssize_t writeSegment( sout_access_out_t *p_access )
             crypted=true;
 
         }
+
+        p_sys->f_seglen =
+            (float)(output->i_length +
+                    output->i_dts - p_sys->i_opendts + p_sys->i_dts_offset) / CLOCK_FREQ;
+
+        if ( p_sys->b_memory )
+        {
+            /* keep the (encrypted) block as is */
+            output_segment_t *segment = vlc_array_item_at_index( p_sys->segments_t,
+                                        vlc_array_count( p_sys->segments_t ) - 1 );
+            block_t *p_next = output->p_next;
+
+            output->p_next = NULL;
+            i_write += output->i_buffer;
+            block_ChainLastAppend( &segment->pp_data_last, output );
+            output = p_next;
+            crypted = false;
+            continue;
+        }
+
         ssize_t val = write( p_sys->i_handle, output->p_buffer, output->i_buffer );
         if ( val == -1 )
         {
@@ -995,10 +1254,6 @@ static ssize_t writeSegment( sout_access_out_t *p_access )
            return -1;
         }
 
-        p_sys->f_seglen =
-            (float)(output->i_length +
-                    output->i_dts - p_sys->i_opendts + p_sys->i_dts_offset) / CLOCK_FREQ;
-
         if ( (size_t)val >= output->i_buffer )
         {
            block_t *p_next = output->p_next;
@@ -1017,9 +1272,53 @@ static ssize_t writeSegment( sout_access_out_t *p_access )
 }
 
 /*****************************************************************************
- * Write: standard write on a file descriptor.
+ * Write: queue the blocks for the writer thread
  *****************************************************************************/
 static ssize_t Write( sout_access_out_t *p_access, block_t *p_buffer )
+{
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+    size_t i_write = 0;
+
+    while( p_buffer )
+    {
+        block_t *p_next = p_buffer->p_next;
+
+        p_buffer->p_next = NULL;
+        i_write += p_buffer->i_buffer;
+
+        /* hold the stream up rather than queueing without bounds */
+        block_FifoPace( p_sys->p_fifo, SIZE_MAX, p_sys->i_queue_max );
+        block_FifoPut( p_sys->p_fifo, p_buffer );
+        p_buffer = p_next;
+    }
+    return i_write;
+}
+
+/*****************************************************************************
+ * WriterThread: segment, encrypt and write the queued blocks
+ *****************************************************************************/
+static void *WriterThread( void *data )
+{
+    sout_access_out_t *p_access = data;
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+
+    for( ;; )
+    {
+        block_t *p_buffer = block_FifoGet( p_sys->p_fifo );
+        if( p_buffer == NULL )
+            continue;
+
+        int canc = vlc_savecancel();
+        WriteBlocks( p_access, p_buffer );
+        vlc_restorecancel( canc );
+    }
+    return NULL;
+}
+
+/*****************************************************************************
+ * WriteBlocks: cut, encrypt and write segments (from the writer thread)
+ *****************************************************************************/
+static ssize_t WriteBlocks( sout_access_out_t *p_access, block_t *p_buffer )
 {
     size_t i_write = 0;
     sout_access_out_sys_t *p_sys = p_access->p_sys;
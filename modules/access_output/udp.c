@@ -46,11 +46,19 @@
 #else
 #   include <sys/socket.h>
 #endif
+#ifdef HAVE_SENDMMSG
+#   include <netinet/udp.h>
+#   include <linux/net_tstamp.h>
+#endif
 
 #include <vlc_network.h>
 
 #define MAX_EMPTY_BLOCKS 200
 
+/* Limits of a single UDP segmentation offload send */
+#define MAX_GSO_SEGMENTS 64
+#define MAX_GSO_SIZE     65000
+
 /*****************************************************************************
  * Module descriptor
  *****************************************************************************/
@@ -71,6 +79,21 @@ static void Close( vlc_object_t * );
                           "helps reducing the scheduling load on " \
                           "heavily-loaded systems." )
 
+#define BATCH_TEXT N_("Send batch size")
+#define BATCH_LONGTEXT N_("Maximum number of datagrams handed to the " \
+    "kernel with a single system call. 1 disables batching.")
+#define WINDOW_TEXT N_("Batching window (ms)")
+#define WINDOW_LONGTEXT N_("Datagrams due within this delay after the " \
+    "first one of a batch are sent along with it. 0 only batches the " \
+    "datagrams that are already late.")
+#define TXTIME_TEXT N_("Kernel pacing")
+#define TXTIME_LONGTEXT N_("Hand the datagrams to the kernel ahead of " \
+    "time with their departure date (SO_TXTIME), so that a pacing " \
+    "queueing discipline such as fq or etf sends them on time.")
+#define GSO_TEXT N_("Segmentation offload")
+#define GSO_LONGTEXT N_("Let the kernel or the network card split runs " \
+    "of equally-sized datagrams (UDP GSO).")
+
 vlc_module_begin ()
     set_description( N_("UDP stream output") )
     set_shortname( "UDP" )
@@ -79,6 +102,15 @@ vlc_module_begin ()
     add_integer( SOUT_CFG_PREFIX "caching", DEFAULT_PTS_DELAY / 1000, CACHING_TEXT, CACHING_LONGTEXT, true )
     add_integer( SOUT_CFG_PREFIX "group", 1, GROUP_TEXT, GROUP_LONGTEXT,
                                  true )
+    add_integer( SOUT_CFG_PREFIX "batch", 32, BATCH_TEXT, BATCH_LONGTEXT,
+                 true )
+        change_integer_range( 1, 1024 )
+    add_integer( SOUT_CFG_PREFIX "window", 0, WINDOW_TEXT, WINDOW_LONGTEXT,
+                 true )
+        change_integer_range( 0, 1000 )
+    add_bool( SOUT_CFG_PREFIX "txtime", false, TXTIME_TEXT, TXTIME_LONGTEXT,
+              true )
+    add_bool( SOUT_CFG_PREFIX "gso", false, GSO_TEXT, GSO_LONGTEXT, true )
 
     set_capability( "sout access", 0 )
     add_shortcut( "udp" )
@@ -92,6 +124,10 @@ vlc_module_end ()
 static const char *const ppsz_sout_options[] = {
     "caching",
     "group",
+    "batch",
+    "window",
+    "txtime",
+    "gso",
     NULL
 };
 
@@ -108,7 +144,19 @@ static int  Seek    ( sout_access_out_t *, off_t  );
 static int Control( sout_access_out_t *, int, va_list );
 
 static void* ThreadWrite( void * );
+static int  BatchInit( sout_access_out_t * );
+static void BatchClean( sout_access_out_t * );
 static block_t *NewUDPPacket( sout_access_out_t *, mtime_t );
+static void ReleaseUDPPackets( sout_access_out_sys_t *, block_t **,
+                               unsigned );
+
+#ifdef HAVE_SENDMMSG
+typedef union
+{
+    char buf[CMSG_SPACE(sizeof (uint16_t)) + CMSG_SPACE(sizeof (uint64_t))];
+    struct cmsghdr align;
+} udp_cmsg_t;
+#endif
 
 struct sout_access_out_sys_t
 {
@@ -118,9 +166,28 @@ struct sout_access_out_sys_t
     size_t        i_mtu;
 
     block_fifo_t *p_fifo;
-    block_fifo_t *p_empty_blocks;
     block_t      *p_buffer;
 
+    /* Recycled packets, shared by Write() and ThreadWrite() */
+    vlc_mutex_t   pool_lock;
+    block_t      *p_pool;
+    unsigned      i_pool;
+
+    /* Datagrams owned by ThreadWrite() until they are sent */
+    block_t     **pp_batch;
+    unsigned      i_batch;
+    unsigned      i_batch_max;
+    mtime_t       i_window;
+    bool          b_txtime;
+    bool          b_gso;
+#ifdef HAVE_SENDMMSG
+    struct mmsghdr *p_msgs;
+    struct iovec   *p_iov;
+    udp_cmsg_t     *p_cmsg;
+#endif
+    uint64_t      i_calls;
+    uint64_t      i_packets;
+
     vlc_thread_t  thread;
 };
 
@@ -210,19 +277,31 @@ static int Open( vlc_object_t *p_this )
     p_sys->i_handle = i_handle;
     p_sys->i_mtu = var_CreateGetInteger( p_this, "mtu" );
     p_sys->b_mtu_warning = false;
-    p_sys->p_fifo = block_FifoNew();
-    p_sys->p_empty_blocks = block_FifoNew();
+    /* Write() is the only producer and ThreadWrite() the only consumer */
+    p_sys->p_fifo = block_FifoNewSPSC();
+    if( unlikely(p_sys->p_fifo == NULL) )
+    {
+        net_Close (i_handle);
+        free (p_sys);
+        return VLC_ENOMEM;
+    }
     p_sys->p_buffer = NULL;
+    vlc_mutex_init( &p_sys->pool_lock );
+    p_sys->p_pool = NULL;
+    p_sys->i_pool = 0;
+
+    if( BatchInit( p_access ) != VLC_SUCCESS )
+    {
+        BatchClean( p_access );
+        goto error;
+    }
 
     if( vlc_clone( &p_sys->thread, ThreadWrite, p_access,
                            VLC_THREAD_PRIORITY_HIGHEST ) )
     {
         msg_Err( p_access, "cannot spawn sout access thread" );
-        block_FifoRelease( p_sys->p_fifo );
-        block_FifoRelease( p_sys->p_empty_blocks );
-        net_Close (i_handle);
-        free (p_sys);
-        return VLC_EGENERIC;
+        BatchClean( p_access );
+        goto error;
     }
 
     p_access->pf_write = Write;
@@ -230,6 +309,13 @@ static int Open( vlc_object_t *p_this )
     p_access->pf_control = Control;
 
     return VLC_SUCCESS;
+
+error:
+    vlc_mutex_destroy( &p_sys->pool_lock );
+    block_FifoRelease( p_sys->p_fifo );
+    net_Close (i_handle);
+    free (p_sys);
+    return VLC_EGENERIC;
 }
 
 /*****************************************************************************
@@ -243,10 +329,16 @@ static void Close( vlc_object_t * p_this )
     vlc_cancel( p_sys->thread );
     vlc_join( p_sys->thread, NULL );
     block_FifoRelease( p_sys->p_fifo );
-    block_FifoRelease( p_sys->p_empty_blocks );
 
     if( p_sys->p_buffer ) block_Release( p_sys->p_buffer );
 
+    if( p_sys->i_calls > 0 )
+        msg_Dbg( p_access, "sent %"PRIu64" datagrams in %"PRIu64" calls",
+                 p_sys->i_packets, p_sys->i_calls );
+    BatchClean( p_access );
+    block_ChainRelease( p_sys->p_pool );
+    vlc_mutex_destroy( &p_sys->pool_lock );
+
     net_Close( p_sys->i_handle );
     free( p_sys );
 }
@@ -362,28 +454,33 @@ static int Seek( sout_access_out_t *p_access, off_t i_pos )
 }
 
 /*****************************************************************************
- * NewUDPPacket: allocate a new UDP packet of size p_sys->i_mtu
+ * NewUDPPacket: get an empty UDP packet of size p_sys->i_mtu
  *****************************************************************************/
 static block_t *NewUDPPacket( sout_access_out_t *p_access, mtime_t i_dts)
 {
     sout_access_out_sys_t *p_sys = p_access->p_sys;
     block_t *p_buffer;
 
-    while ( block_FifoCount( p_sys->p_empty_blocks ) > MAX_EMPTY_BLOCKS )
+    vlc_mutex_lock( &p_sys->pool_lock );
+    p_buffer = p_sys->p_pool;
+    if( p_buffer != NULL )
     {
-        p_buffer = block_FifoGet( p_sys->p_empty_blocks );
-        block_Release( p_buffer );
+        p_sys->p_pool = p_buffer->p_next;
+        p_sys->i_pool--;
     }
+    vlc_mutex_unlock( &p_sys->pool_lock );
 
-    if( block_FifoCount( p_sys->p_empty_blocks ) == 0 )
+    if( p_buffer == NULL )
     {
         p_buffer = block_Alloc( p_sys->i_mtu );
+        if( unlikely(p_buffer == NULL) )
+            return NULL;
     }
     else
     {
-        p_buffer = block_FifoGet(p_sys->p_empty_blocks );
+        /* Recycled packets are never resized nor moved */
+        p_buffer->p_next = NULL;
         p_buffer->i_flags = 0;
-        p_buffer = block_Realloc( p_buffer, 0, p_sys->i_mtu );
     }
 
     p_buffer->i_dts = i_dts;
@@ -392,6 +489,226 @@ static block_t *NewUDPPacket( sout_access_out_t *p_access, mtime_t i_dts)
     return p_buffer;
 }
 
+/*****************************************************************************
+ * ReleaseUDPPackets: give sent packets back to NewUDPPacket
+ *****************************************************************************/
+static void ReleaseUDPPackets( sout_access_out_sys_t *p_sys,
+                               block_t **pp_packets, unsigned i_count )
+{
+    block_t *p_extra = NULL;
+
+    vlc_mutex_lock( &p_sys->pool_lock );
+    for( unsigned i = 0; i < i_count; i++ )
+    {
+        block_t *p_pk = pp_packets[i];
+
+        if( p_sys->i_pool < MAX_EMPTY_BLOCKS )
+        {
+            p_pk->p_next = p_sys->p_pool;
+            p_sys->p_pool = p_pk;
+            p_sys->i_pool++;
+        }
+        else
+        {
+            p_pk->p_next = p_extra;
+            p_extra = p_pk;
+        }
+    }
+    vlc_mutex_unlock( &p_sys->pool_lock );
+
+    block_ChainRelease( p_extra );
+}
+
+/*****************************************************************************
+ * BatchInit: allocate the send batch and probe the socket options
+ *****************************************************************************/
+static int BatchInit( sout_access_out_t *p_access )
+{
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+    unsigned n = var_GetInteger( p_access, SOUT_CFG_PREFIX "batch" );
+
+    p_sys->i_batch = 0;
+    p_sys->i_batch_max = n > 0 ? n : 1;
+    p_sys->i_window = INT64_C(1000)
+                    * var_GetInteger( p_access, SOUT_CFG_PREFIX "window" );
+    p_sys->b_txtime = var_GetBool( p_access, SOUT_CFG_PREFIX "txtime" );
+    p_sys->b_gso = var_GetBool( p_access, SOUT_CFG_PREFIX "gso" );
+    p_sys->i_calls = p_sys->i_packets = 0;
+
+    p_sys->pp_batch = calloc( p_sys->i_batch_max, sizeof( *p_sys->pp_batch ) );
+#ifdef HAVE_SENDMMSG
+    p_sys->p_msgs = calloc( p_sys->i_batch_max, sizeof( *p_sys->p_msgs ) );
+    p_sys->p_iov = calloc( p_sys->i_batch_max, sizeof( *p_sys->p_iov ) );
+    p_sys->p_cmsg = calloc( p_sys->i_batch_max, sizeof( *p_sys->p_cmsg ) );
+    if( unlikely(p_sys->p_msgs == NULL || p_sys->p_iov == NULL
+              || p_sys->p_cmsg == NULL) )
+        return VLC_ENOMEM;
+
+# ifdef UDP_SEGMENT
+    if( p_sys->b_gso
+     && setsockopt( p_sys->i_handle, SOL_UDP, UDP_SEGMENT, &(int){ 0 },
+                    sizeof (int) ) )
+    {
+        msg_Warn( p_access, "UDP segmentation offload not available: %s",
+                  vlc_strerror_c(errno) );
+        p_sys->b_gso = false;
+    }
+# else
+    p_sys->b_gso = false;
+# endif
+# ifdef SCM_TXTIME
+    struct sock_txtime txtime = { .clockid = CLOCK_MONOTONIC, .flags = 0 };
+
+    if( p_sys->b_txtime
+     && setsockopt( p_sys->i_handle, SOL_SOCKET, SO_TXTIME, &txtime,
+                    sizeof (txtime) ) )
+    {
+        msg_Warn( p_access, "kernel pacing not available: %s",
+                  vlc_strerror_c(errno) );
+        p_sys->b_txtime = false;
+    }
+# else
+    p_sys->b_txtime = false;
+# endif
+#else
+    if( p_sys->b_txtime || p_sys->b_gso )
+        msg_Warn( p_access, "kernel pacing and segmentation offload are "
+                  "not supported on this system" );
+    p_sys->b_txtime = p_sys->b_gso = false;
+#endif
+    if( unlikely(p_sys->pp_batch == NULL) )
+        return VLC_ENOMEM;
+
+    msg_Dbg( p_access, "sending up to %u datagrams per call within %"PRId64
+             " ms%s%s", p_sys->i_batch_max, p_sys->i_window / 1000,
+             p_sys->b_txtime ? ", paced by the kernel" : "",
+             p_sys->b_gso ? ", with segmentation offload" : "" );
+    return VLC_SUCCESS;
+}
+
+static void BatchClean( sout_access_out_t *p_access )
+{
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+
+    /* ThreadWrite() may have been cancelled before sending its batch */
+    if( p_sys->i_batch > 0 )
+        ReleaseUDPPackets( p_sys, p_sys->pp_batch, p_sys->i_batch );
+#ifdef HAVE_SENDMMSG
+    free( p_sys->p_cmsg );
+    free( p_sys->p_iov );
+    free( p_sys->p_msgs );
+#endif
+    free( p_sys->pp_batch );
+}
+
+/*****************************************************************************
+ * SendBatch: send a batch of datagrams with as few system calls as possible
+ *****************************************************************************/
+static void SendBatch( sout_access_out_t *p_access, block_t **pp_batch,
+                       unsigned i_count )
+{
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+
+#ifdef HAVE_SENDMMSG
+    unsigned i_msgs = 0;
+
+    for( unsigned i = 0; i < i_count; )
+    {
+        struct msghdr *hdr = &p_sys->p_msgs[i_msgs].msg_hdr;
+        struct iovec *iov = &p_sys->p_iov[i];
+        char *control = p_sys->p_cmsg[i_msgs].buf;
+        size_t i_segment = pp_batch[i]->i_buffer;
+        size_t i_total = 0, i_control = 0;
+        unsigned j = i;
+
+        /* With segmentation offload, a run of datagrams of the same size
+         * (only the last one may be shorter) is sent as one message */
+        do
+        {
+            iov[j - i].iov_base = pp_batch[j]->p_buffer;
+            iov[j - i].iov_len = pp_batch[j]->i_buffer;
+            i_total += pp_batch[j]->i_buffer;
+            j++;
+        }
+        while( p_sys->b_gso && j < i_count && j - i < MAX_GSO_SEGMENTS
+            && pp_batch[j - 1]->i_buffer == i_segment
+            && pp_batch[j]->i_buffer <= i_segment
+            && i_total + pp_batch[j]->i_buffer <= MAX_GSO_SIZE );
+
+        memset( hdr, 0, sizeof (*hdr) );
+        hdr->msg_iov = iov;
+        hdr->msg_iovlen = j - i;
+
+# ifdef UDP_SEGMENT
+        if( j - i > 1 )
+        {
+            struct cmsghdr *cmsg = (struct cmsghdr *)(control + i_control);
+            uint16_t i_size = i_segment;
+
+            cmsg->cmsg_level = SOL_UDP;
+            cmsg->cmsg_type = UDP_SEGMENT;
+            cmsg->cmsg_len = CMSG_LEN(sizeof (i_size));
+            memcpy( CMSG_DATA(cmsg), &i_size, sizeof (i_size) );
+            i_control += CMSG_SPACE(sizeof (i_size));
+        }
+# endif
+# ifdef SCM_TXTIME
+        if( p_sys->b_txtime )
+        {
+            struct cmsghdr *cmsg = (struct cmsghdr *)(control + i_control);
+            uint64_t i_txtime = UINT64_C(1000)
+                              * (pp_batch[i]->i_dts + p_sys->i_caching);
+
+            cmsg->cmsg_level = SOL_SOCKET;
+            cmsg->cmsg_type = SCM_TXTIME;
+            cmsg->cmsg_len = CMSG_LEN(sizeof (i_txtime));
+            memcpy( CMSG_DATA(cmsg), &i_txtime, sizeof (i_txtime) );
+            i_control += CMSG_SPACE(sizeof (i_txtime));
+        }
+# endif
+        if( i_control > 0 )
+        {
+            hdr->msg_control = control;
+            hdr->msg_controllen = i_control;
+        }
+
+        i_msgs++;
+        i = j;
+    }
+
+    for( unsigned i = 0; i < i_msgs; )
+    {
+        int val = sendmmsg( p_sys->i_handle, &p_sys->p_msgs[i], i_msgs - i,
+                            0 );
+        if( val == -1 )
+        {
+            if( errno == EINTR )
+                continue;
+            msg_Warn( p_access, "send error: %s", vlc_strerror_c(errno) );
+            if( errno == EIO && p_sys->b_gso )
+            {   /* No checksum offload on the outgoing interface */
+                msg_Warn( p_access, "disabling segmentation offload" );
+                p_sys->b_gso = false;
+            }
+            /* Skip the failed message */
+            val = 1;
+        }
+        i += val;
+        p_sys->i_calls++;
+    }
+#else
+    for( unsigned i = 0; i < i_count; i++ )
+    {
+        block_t *p_pk = pp_batch[i];
+
+        if ( send( p_sys->i_handle, p_pk->p_buffer, p_pk->i_buffer, 0 ) == -1 )
+            msg_Warn( p_access, "send error: %s", vlc_strerror_c(errno) );
+        p_sys->i_calls++;
+    }
+#endif
+    p_sys->i_packets += i_count;
+}
+
 /*****************************************************************************
  * ThreadWrite: Write a packet on the network at the good time.
  *****************************************************************************/
@@ -399,6 +716,7 @@ static void* ThreadWrite( void *data )
 {
     sout_access_out_t *p_access = data;
     sout_access_out_sys_t *p_sys = p_access->p_sys;
+    block_t **pp_batch = p_sys->pp_batch;
     mtime_t i_date_last = -1;
     const unsigned i_group = var_GetInteger( p_access,
                                              SOUT_CFG_PREFIX "group" );
@@ -419,7 +737,7 @@ static void* ThreadWrite( void *data )
                     msg_Dbg( p_access, "mmh, hole (%"PRId64" > 2s) -> drop",
                              i_date - i_date_last );
 
-                block_FifoPut( p_sys->p_empty_blocks, p_pk );
+                ReleaseUDPPackets( p_sys, &p_pk, 1 );
 
                 i_date_last = i_date;
                 i_dropped_packets++;
@@ -433,16 +751,41 @@ static void* ThreadWrite( void *data )
             }
         }
 
-        block_cleanup_push( p_pk );
+        /* From now on, Close() releases the batch if we are cancelled */
+        pp_batch[0] = p_pk;
+        p_sys->i_batch = 1;
+
         i_to_send--;
         if( !i_to_send || (p_pk->i_flags & BLOCK_FLAG_CLOCK) )
         {
-            mwait( i_date );
+            /* When the kernel paces the datagrams, hand them over early */
+            mwait( p_sys->b_txtime ? i_date - p_sys->i_window : i_date );
             i_to_send = i_group;
         }
-        if ( send( p_sys->i_handle, p_pk->p_buffer, p_pk->i_buffer, 0 ) == -1 )
-            msg_Warn( p_access, "send error: %s", vlc_strerror_c(errno) );
-        vlc_cleanup_pop();
+
+        /* Send along the queued datagrams that are due within the window.
+         * This thread is the only reader, so the fifo head cannot go away
+         * and block_FifoGet() will not block. */
+        const mtime_t i_first = i_date;
+        const mtime_t i_limit = __MAX( i_first, mdate() ) + p_sys->i_window;
+
+        while( p_sys->i_batch < p_sys->i_batch_max
+            && block_FifoCount( p_sys->p_fifo ) > 0 )
+        {
+            mtime_t i_next = p_sys->i_caching
+                           + block_FifoShow( p_sys->p_fifo )->i_dts;
+
+            if( i_next > i_limit )
+                break;
+
+            block_t *p_next = block_FifoGet( p_sys->p_fifo );
+            pp_batch[p_sys->i_batch++] = p_next;
+            i_date = i_next;
+            if( i_to_send > 1 )
+                i_to_send--;
+        }
+
+        SendBatch( p_access, pp_batch, p_sys->i_batch );
 
         if( i_dropped_packets )
         {
@@ -452,14 +795,15 @@ static void* ThreadWrite( void *data )
 
 #if 1
         i_sent = mdate();
-        if ( i_sent > i_date + 20000 )
+        if ( i_sent > i_first + 20000 )
         {
             msg_Dbg( p_access, "packet has been sent too late (%"PRId64 ")",
-                     i_sent - i_date );
+                     i_sent - i_first );
         }
 #endif
 
-        block_FifoPut( p_sys->p_empty_blocks, p_pk );
+        ReleaseUDPPackets( p_sys, pp_batch, p_sys->i_batch );
+        p_sys->i_batch = 0;
 
         i_date_last = i_date;
     }
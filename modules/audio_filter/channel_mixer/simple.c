@@ -35,6 +35,8 @@
 #include <vlc_block.h>
 #include <assert.h>
 
+#include "../sample_kernels.h"
+
 /*****************************************************************************
  * Module descriptor
  *****************************************************************************/
@@ -54,7 +56,10 @@ vlc_module_end ()
  *****************************************************************************/
 struct filter_sys_t
 {
-    void (*pf_dowork)(filter_t *, block_t *, block_t * );
+    unsigned i_in;
+    unsigned i_out;
+    /* i_out rows of i_in coefficients, LFE included */
+    float matrix[AOUT_CHAN_MAX * AOUT_CHAN_MAX];
 };
 
 /*****************************************************************************
@@ -111,215 +116,91 @@ static bool IsSupported( const audio_format_t *p_input, const audio_format_t *p_
 
 static block_t *Filter( filter_t *, block_t * );
 
-static void DoWork_7_x_to_2_0( filter_t * p_filter,  block_t * p_in_buf, block_t * p_out_buf ) {
-    float *p_dest = (float *)p_out_buf->p_buffer;
-    const float *p_src = (const float *)p_in_buf->p_buffer;
-    for( int i = p_in_buf->i_nb_samples; i--; )
-    {
-        float ctr = p_src[6] * 0.7071f;
-        *p_dest++ = ctr + p_src[0] + p_src[2] / 4 + p_src[4] / 4;
-        *p_dest++ = ctr + p_src[1] + p_src[3] / 4 + p_src[5] / 4;
-
-        p_src += 7;
-
-        if( p_filter->fmt_in.audio.i_physical_channels & AOUT_CHAN_LFE ) p_src++;
-    }
-}
-
-static void DoWork_6_1_to_2_0( filter_t *p_filter, block_t *p_in_buf,
-                               block_t *p_out_buf )
+/*****************************************************************************
+ * Downmixing matrices, LFE excluded: one row of coefficients per output
+ * channel, one column per input channel
+ *****************************************************************************/
+typedef struct
 {
-    VLC_UNUSED(p_filter);
-    float *p_dest = (float *)p_out_buf->p_buffer;
-    const float *p_src = (const float *)p_in_buf->p_buffer;
-    for( int i = p_in_buf->i_nb_samples; i--; )
-    {
-        float ctr = (p_src[2] + p_src[5]) * 0.7071f;
-        *p_dest++ = p_src[0] + p_src[3] + ctr;
-        *p_dest++ = p_src[1] + p_src[4] + ctr;
-
-        p_src += 6;
-
-        /* We always have LFE here */
-        p_src++;
-    }
-}
-
-static void DoWork_5_x_to_2_0( filter_t * p_filter,  block_t * p_in_buf, block_t * p_out_buf ) {
-    float *p_dest = (float *)p_out_buf->p_buffer;
-    const float *p_src = (const float *)p_in_buf->p_buffer;
-    for( int i = p_in_buf->i_nb_samples; i--; )
-    {
-        *p_dest++ = p_src[0] + 0.7071f * (p_src[4] + p_src[2]);
-        *p_dest++ = p_src[1] + 0.7071f * (p_src[4] + p_src[3]);
-
-        p_src += 5;
-
-        if( p_filter->fmt_in.audio.i_physical_channels & AOUT_CHAN_LFE ) p_src++;
-    }
-}
-
-static void DoWork_4_0_to_2_0( filter_t * p_filter,  block_t * p_in_buf, block_t * p_out_buf ) {
-    VLC_UNUSED(p_filter);
-    float *p_dest = (float *)p_out_buf->p_buffer;
-    const float *p_src = (const float *)p_in_buf->p_buffer;
-    for( int i = p_in_buf->i_nb_samples; i--; )
-    {
-        *p_dest++ = p_src[2] + p_src[3] + 0.5f * p_src[0];
-        *p_dest++ = p_src[2] + p_src[3] + 0.5f * p_src[1];
-        p_src += 4;
-    }
-}
-
-static void DoWork_3_x_to_2_0( filter_t * p_filter,  block_t * p_in_buf, block_t * p_out_buf ) {
-    float *p_dest = (float *)p_out_buf->p_buffer;
-    const float *p_src = (const float *)p_in_buf->p_buffer;
-    for( int i = p_in_buf->i_nb_samples; i--; )
-    {
-        *p_dest++ = p_src[2] + 0.5f * p_src[0];
-        *p_dest++ = p_src[2] + 0.5f * p_src[1];
-
-        p_src += 3;
-
-        if( p_filter->fmt_in.audio.i_physical_channels & AOUT_CHAN_LFE ) p_src++;
-    }
-}
-
-static void DoWork_7_x_to_1_0( filter_t * p_filter,  block_t * p_in_buf, block_t * p_out_buf ) {
-    float *p_dest = (float *)p_out_buf->p_buffer;
-    const float *p_src = (const float *)p_in_buf->p_buffer;
-    for( int i = p_in_buf->i_nb_samples; i--; )
-    {
-        *p_dest++ = p_src[6] + p_src[0] / 4 + p_src[1] / 4 + p_src[2] / 8 + p_src[3] / 8 + p_src[4] / 8 + p_src[5] / 8;
-
-        p_src += 7;
-
-        if( p_filter->fmt_in.audio.i_physical_channels & AOUT_CHAN_LFE ) p_src++;
-    }
-}
-
-static void DoWork_5_x_to_1_0( filter_t * p_filter,  block_t * p_in_buf, block_t * p_out_buf ) {
-    float *p_dest = (float *)p_out_buf->p_buffer;
-    const float *p_src = (const float *)p_in_buf->p_buffer;
-    for( int i = p_in_buf->i_nb_samples; i--; )
-    {
-        *p_dest++ = 0.7071f * (p_src[0] + p_src[1]) + p_src[4]
-                     + 0.5f * (p_src[2] + p_src[3]);
-
-        p_src += 5;
-
-        if( p_filter->fmt_in.audio.i_physical_channels & AOUT_CHAN_LFE ) p_src++;
-    }
-}
-
-static void DoWork_4_0_to_1_0( filter_t * p_filter,  block_t * p_in_buf, block_t * p_out_buf ) {
-    VLC_UNUSED(p_filter);
-    float *p_dest = (float *)p_out_buf->p_buffer;
-    const float *p_src = (const float *)p_in_buf->p_buffer;
-    for( int i = p_in_buf->i_nb_samples; i--; )
-    {
-        *p_dest++ = p_src[2] + p_src[3] + p_src[0] / 4 + p_src[1] / 4;
-        p_src += 4;
-    }
-}
-
-static void DoWork_3_x_to_1_0( filter_t * p_filter,  block_t * p_in_buf, block_t * p_out_buf ) {
-    float *p_dest = (float *)p_out_buf->p_buffer;
-    const float *p_src = (const float *)p_in_buf->p_buffer;
-    for( int i = p_in_buf->i_nb_samples; i--; )
-    {
-        *p_dest++ = p_src[2] + p_src[0] / 4 + p_src[1] / 4;
-
-        p_src += 3;
-
-        if( p_filter->fmt_in.audio.i_physical_channels & AOUT_CHAN_LFE ) p_src++;
-    }
-}
-
-static void DoWork_2_x_to_1_0( filter_t * p_filter,  block_t * p_in_buf, block_t * p_out_buf ) {
-    VLC_UNUSED(p_filter);
-    float *p_dest = (float *)p_out_buf->p_buffer;
-    const float *p_src = (const float *)p_in_buf->p_buffer;
-    for( int i = p_in_buf->i_nb_samples; i--; )
-    {
-        *p_dest++ = p_src[0] / 2 + p_src[1] / 2;
-
-        p_src += 2;
-    }
-}
-
-static void DoWork_7_x_to_4_0( filter_t * p_filter,  block_t * p_in_buf, block_t * p_out_buf ) {
-    float *p_dest = (float *)p_out_buf->p_buffer;
-    const float *p_src = (const float *)p_in_buf->p_buffer;
-    for( int i = p_in_buf->i_nb_samples; i--; )
-    {
-        *p_dest++ = p_src[6] + 0.5f * p_src[0] + p_src[2] / 6;
-        *p_dest++ = p_src[6] + 0.5f * p_src[1] + p_src[3] / 6;
-        *p_dest++ = p_src[2] / 6 +  p_src[4];
-        *p_dest++ = p_src[3] / 6 +  p_src[5];
-
-        p_src += 7;
-
-        if( p_filter->fmt_in.audio.i_physical_channels & AOUT_CHAN_LFE ) p_src++;
-    }
-}
-
-static void DoWork_5_x_to_4_0( filter_t * p_filter,  block_t * p_in_buf, block_t * p_out_buf ) {
-    float *p_dest = (float *)p_out_buf->p_buffer;
-    const float *p_src = (const float *)p_in_buf->p_buffer;
-    for( int i = p_in_buf->i_nb_samples; i--; )
-    {
-        float ctr = p_src[4] * 0.7071f;
-        *p_dest++ = p_src[0] + ctr;
-        *p_dest++ = p_src[1] + ctr;
-        *p_dest++ = p_src[2];
-        *p_dest++ = p_src[3];
-
-        p_src += 5;
-
-        if( p_filter->fmt_in.audio.i_physical_channels & AOUT_CHAN_LFE ) p_src++;
-    }
-}
-
-static void DoWork_7_x_to_5_x( filter_t * p_filter,  block_t * p_in_buf, block_t * p_out_buf ) {
-    float *p_dest = (float *)p_out_buf->p_buffer;
-    const float *p_src = (const float *)p_in_buf->p_buffer;
-    for( int i = p_in_buf->i_nb_samples; i--; )
-    {
-        *p_dest++ = p_src[0];
-        *p_dest++ = p_src[1];
-        *p_dest++ = (p_src[2] + p_src[4]) * 0.5f;
-        *p_dest++ = (p_src[3] + p_src[5]) * 0.5f;
-        *p_dest++ = p_src[6];
-
-        p_src += 7;
-
-        if( p_filter->fmt_in.audio.i_physical_channels & AOUT_CHAN_LFE &&
-            p_filter->fmt_out.audio.i_physical_channels & AOUT_CHAN_LFE )
-            *p_dest++ = *p_src++;
-        else if( p_filter->fmt_in.audio.i_physical_channels & AOUT_CHAN_LFE ) p_src++;
-    }
-}
-
-static void DoWork_6_1_to_5_x( filter_t * p_filter,  block_t * p_in_buf, block_t * p_out_buf ) {
-    VLC_UNUSED(p_filter);
-    float *p_dest = (float *)p_out_buf->p_buffer;
-    const float *p_src = (const float *)p_in_buf->p_buffer;
-    for( int i = p_in_buf->i_nb_samples; i--; )
-    {
-        *p_dest++ = p_src[0];
-        *p_dest++ = p_src[1];
-        *p_dest++ = (p_src[2] + p_src[4]) * 0.5f;
-        *p_dest++ = (p_src[3] + p_src[4]) * 0.5f;
-        *p_dest++ = p_src[5];
-
-        p_src += 6;
-
-        /* We always have LFE here */
-        *p_dest++ = *p_src++;
-    }
-}
-
+    unsigned i_in;
+    unsigned i_out;
+    float coeffs[5][7];
+} downmix_t;
+
+static const downmix_t downmix_7_x_to_2_0 = { 7, 2, {
+    { 1.f, 0.f, .25f, 0.f, .25f, 0.f, .7071f },
+    { 0.f, 1.f, 0.f, .25f, 0.f, .25f, .7071f },
+} };
+
+static const downmix_t downmix_6_1_to_2_0 = { 6, 2, {
+    { 1.f, 0.f, .7071f, 1.f, 0.f, .7071f },
+    { 0.f, 1.f, .7071f, 0.f, 1.f, .7071f },
+} };
+
+static const downmix_t downmix_5_x_to_2_0 = { 5, 2, {
+    { 1.f, 0.f, .7071f, 0.f, .7071f },
+    { 0.f, 1.f, 0.f, .7071f, .7071f },
+} };
+
+static const downmix_t downmix_4_0_to_2_0 = { 4, 2, {
+    { .5f, 0.f, 1.f, 1.f },
+    { 0.f, .5f, 1.f, 1.f },
+} };
+
+static const downmix_t downmix_3_x_to_2_0 = { 3, 2, {
+    { .5f, 0.f, 1.f },
+    { 0.f, .5f, 1.f },
+} };
+
+static const downmix_t downmix_7_x_to_1_0 = { 7, 1, {
+    { .25f, .25f, .125f, .125f, .125f, .125f, 1.f },
+} };
+
+static const downmix_t downmix_5_x_to_1_0 = { 5, 1, {
+    { .7071f, .7071f, .5f, .5f, 1.f },
+} };
+
+static const downmix_t downmix_4_0_to_1_0 = { 4, 1, {
+    { .25f, .25f, 1.f, 1.f },
+} };
+
+static const downmix_t downmix_3_x_to_1_0 = { 3, 1, {
+    { .25f, .25f, 1.f },
+} };
+
+static const downmix_t downmix_2_x_to_1_0 = { 2, 1, {
+    { .5f, .5f },
+} };
+
+static const downmix_t downmix_7_x_to_4_0 = { 7, 4, {
+    { .5f, 0.f, 1.f / 6, 0.f, 0.f, 0.f, 1.f },
+    { 0.f, .5f, 0.f, 1.f / 6, 0.f, 0.f, 1.f },
+    { 0.f, 0.f, 1.f / 6, 0.f, 1.f, 0.f, 0.f },
+    { 0.f, 0.f, 0.f, 1.f / 6, 0.f, 1.f, 0.f },
+} };
+
+static const downmix_t downmix_5_x_to_4_0 = { 5, 4, {
+    { 1.f, 0.f, 0.f, 0.f, .7071f },
+    { 0.f, 1.f, 0.f, 0.f, .7071f },
+    { 0.f, 0.f, 1.f, 0.f, 0.f },
+    { 0.f, 0.f, 0.f, 1.f, 0.f },
+} };
+
+static const downmix_t downmix_7_x_to_5_x = { 7, 5, {
+    { 1.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f },
+    { 0.f, 1.f, 0.f, 0.f, 0.f, 0.f, 0.f },
+    { 0.f, 0.f, .5f, 0.f, .5f, 0.f, 0.f },
+    { 0.f, 0.f, 0.f, .5f, 0.f, .5f, 0.f },
+    { 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 1.f },
+} };
+
+static const downmix_t downmix_6_1_to_5_x = { 6, 5, {
+    { 1.f, 0.f, 0.f, 0.f, 0.f, 0.f },
+    { 0.f, 1.f, 0.f, 0.f, 0.f, 0.f },
+    { 0.f, 0.f, .5f, 0.f, .5f, 0.f },
+    { 0.f, 0.f, 0.f, .5f, .5f, 0.f },
+    { 0.f, 0.f, 0.f, 0.f, 0.f, 1.f },
+} };
 
 /*****************************************************************************
  * OpenFilter:
@@ -338,12 +219,6 @@ static int OpenFilter( vlc_object_t *p_this )
     if( !IsSupported( &fmt_in, &fmt_out ) )
         return VLC_EGENERIC;
 
-    p_filter->p_sys = malloc( sizeof(*p_sys) );
-    if( unlikely(!p_filter->p_sys) )
-        return VLC_ENOMEM;
-
-    p_filter->pf_audio_filter = Filter;
-
     const unsigned i_input_physical = p_filter->fmt_in.audio.i_physical_channels;
     const bool b_input_7_0 = (i_input_physical & ~AOUT_CHAN_LFE) == AOUT_CHANS_7_0;
     const bool b_input_6_1 = !b_input_7_0 &&
@@ -356,48 +231,76 @@ static int OpenFilter( vlc_object_t *p_this )
     const bool b_input_3_0 = !b_input_7_0 && !b_input_5_0 && !b_input_4_center_rear &&
                              (i_input_physical & ~AOUT_CHAN_LFE) == AOUT_CHANS_3_0;
 
+    const downmix_t *p_downmix = NULL;
     if( p_filter->fmt_out.audio.i_physical_channels == AOUT_CHANS_2_0 )
     {
         if( b_input_7_0 )
-            p_filter->p_sys->pf_dowork = DoWork_7_x_to_2_0;
+            p_downmix = &downmix_7_x_to_2_0;
         else if( b_input_6_1 )
-            p_filter->p_sys->pf_dowork = DoWork_6_1_to_2_0;
+            p_downmix = &downmix_6_1_to_2_0;
         else if( b_input_5_0 )
-            p_filter->p_sys->pf_dowork = DoWork_5_x_to_2_0;
+            p_downmix = &downmix_5_x_to_2_0;
         else if( b_input_4_center_rear )
-            p_filter->p_sys->pf_dowork = DoWork_4_0_to_2_0;
+            p_downmix = &downmix_4_0_to_2_0;
         else if( b_input_3_0 )
-            p_filter->p_sys->pf_dowork = DoWork_3_x_to_2_0;
+            p_downmix = &downmix_3_x_to_2_0;
     }
     else if( p_filter->fmt_out.audio.i_physical_channels == AOUT_CHAN_CENTER )
     {
         if( b_input_7_0 )
-            p_filter->p_sys->pf_dowork = DoWork_7_x_to_1_0;
+            p_downmix = &downmix_7_x_to_1_0;
         else if( b_input_5_0 )
-            p_filter->p_sys->pf_dowork = DoWork_5_x_to_1_0;
+            p_downmix = &downmix_5_x_to_1_0;
         else if( b_input_4_center_rear )
-            p_filter->p_sys->pf_dowork = DoWork_4_0_to_1_0;
+            p_downmix = &downmix_4_0_to_1_0;
         else if( b_input_3_0 )
-            p_filter->p_sys->pf_dowork = DoWork_3_x_to_1_0;
+            p_downmix = &downmix_3_x_to_1_0;
         else
-            p_filter->p_sys->pf_dowork = DoWork_2_x_to_1_0;
+            p_downmix = &downmix_2_x_to_1_0;
     }
     else if(p_filter->fmt_out.audio.i_physical_channels == AOUT_CHANS_4_0)
     {
         if( b_input_7_0 )
-            p_filter->p_sys->pf_dowork = DoWork_7_x_to_4_0;
+            p_downmix = &downmix_7_x_to_4_0;
         else
-            p_filter->p_sys->pf_dowork = DoWork_5_x_to_4_0;
+            p_downmix = &downmix_5_x_to_4_0;
     }
     else
     {
         assert( b_input_7_0 || b_input_6_1 );
         if( b_input_7_0 )
-            p_filter->p_sys->pf_dowork = DoWork_7_x_to_5_x;
+            p_downmix = &downmix_7_x_to_5_x;
         else
-            p_filter->p_sys->pf_dowork = DoWork_6_1_to_5_x;
+            p_downmix = &downmix_6_1_to_5_x;
     }
 
+    if( p_downmix == NULL )
+        return VLC_EGENERIC;
+
+    p_sys = p_filter->p_sys = malloc( sizeof(*p_sys) );
+    if( unlikely(!p_sys) )
+        return VLC_ENOMEM;
+
+    /* Expand the matrix to the actual channels: the LFE comes last, it is
+     * either dropped or copied as is */
+    const bool b_lfe_in = i_input_physical & AOUT_CHAN_LFE;
+    const bool b_lfe_out =
+        p_filter->fmt_out.audio.i_physical_channels & AOUT_CHAN_LFE;
+
+    p_sys->i_in = aout_FormatNbChannels( &p_filter->fmt_in.audio );
+    p_sys->i_out = aout_FormatNbChannels( &p_filter->fmt_out.audio );
+    assert( p_sys->i_in >= p_downmix->i_in + b_lfe_in );
+    assert( p_sys->i_out == p_downmix->i_out + b_lfe_out );
+
+    memset( p_sys->matrix, 0, sizeof(p_sys->matrix) );
+    for( unsigned o = 0; o < p_downmix->i_out; o++ )
+        for( unsigned k = 0; k < p_downmix->i_in; k++ )
+            p_sys->matrix[o * p_sys->i_in + k] = p_downmix->coeffs[o][k];
+    if( b_lfe_in && b_lfe_out )
+        p_sys->matrix[p_sys->i_out * p_sys->i_in - 1] = 1.f;
+
+    p_filter->pf_audio_filter = Filter;
+
     return VLC_SUCCESS;
 }
 
@@ -438,12 +341,11 @@ static block_t *Filter( filter_t *p_filter, block_t *p_block )
     p_out->i_pts = p_block->i_pts;
     p_out->i_length = p_block->i_length;
 
-    int i_input_nb = aout_FormatNbChannels( &p_filter->fmt_in.audio );
-    int i_output_nb = aout_FormatNbChannels( &p_filter->fmt_out.audio );
-    p_out->i_nb_samples = p_block->i_nb_samples;
-    p_out->i_buffer = p_block->i_buffer * i_output_nb / i_input_nb;
+    p_out->i_buffer = p_block->i_buffer * p_sys->i_out / p_sys->i_in;
 
-    p_sys->pf_dowork( p_filter, p_block, p_out );
+    SamplesMixFL32( (float *)p_out->p_buffer, p_sys->i_out,
+                    (const float *)p_block->p_buffer, p_sys->i_in,
+                    p_sys->matrix, p_block->i_nb_samples );
 
     block_Release( p_block );
 
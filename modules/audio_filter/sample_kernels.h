@@ -0,0 +1,1250 @@
+/*****************************************************************************
+ * sample_kernels.h: vectorized audio sample kernels
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef VLC_AUDIO_SAMPLE_KERNELS_H
+#define VLC_AUDIO_SAMPLE_KERNELS_H 1
+
+#include <assert.h>
+#include <vlc_cpu.h>
+
+/*
+ * Every kernel comes as a plain C version (suffixed C), vectorized versions
+ * (suffixed SSE2, AVX2 or NEON) and an unsuffixed entry point picking the
+ * best one for the running CPU. All versions produce the same output bit for
+ * bit, except SamplesMixFL32() whose result may differ in the last bit where
+ * the compiler contracts the C loop into fused multiply-adds.
+ * SIMD versions handle as many samples as their vector width allows and hand
+ * the remainder over to the C version.
+ */
+
+#if defined(HAVE_SSE2_INTRINSICS) && (VLC_GCC_VERSION(4, 9) || defined(__clang__))
+# include <immintrin.h>
+# define SAMPLES_SIMD_X86 1
+#endif
+
+#if defined(__ARM_NEON__) || defined(__aarch64__)
+# include <arm_neon.h>
+# define SAMPLES_SIMD_NEON 1
+#endif
+
+/** Maximum number of input channels of SamplesMixFL32() */
+#define SAMPLES_MIX_MAX_IN  9
+/** Maximum number of output channels of SamplesMixFL32() */
+#define SAMPLES_MIX_MAX_OUT 8
+
+/**
+ * Returns the name of the instruction set the kernels will use.
+ */
+static inline const char *SamplesKernelsName( void )
+{
+#ifdef SAMPLES_SIMD_X86
+    if( vlc_CPU_AVX2() )
+        return "avx2";
+    if( vlc_CPU_SSE2() )
+        return "sse2";
+#endif
+#ifdef SAMPLES_SIMD_NEON
+    return "neon";
+#endif
+    return "c";
+}
+
+/*****************************************************************************
+ * C versions
+ *****************************************************************************/
+
+/* Multiplies i_samples float samples in place by f_gain */
+static inline void SamplesGainFL32C( float *p, size_t i_samples, float f_gain )
+{
+    for( size_t i = 0; i < i_samples; i++ )
+        p[i] *= f_gain;
+}
+
+/* Converts signed 16-bits samples to float. This is Walken's trick based on
+ * the IEEE float format, which yields exactly s / 32768. */
+static inline void SamplesS16ToFL32C( float *dst, const int16_t *src,
+                                      size_t i_samples )
+{
+    for( size_t i = 0; i < i_samples; i++ )
+    {
+        union { float f; int32_t i; } u;
+        u.i = src[i] + 0x43c00000;
+        dst[i] = u.f - 384.0;
+    }
+}
+
+/* Converts float samples to signed 16-bits, rounding to nearest even and
+ * clipping. This is Walken's trick too. dst may alias src. */
+static inline void SamplesFL32ToS16C( int16_t *dst, const float *src,
+                                      size_t i_samples )
+{
+    for( size_t i = 0; i < i_samples; i++ )
+    {
+        union { float f; int32_t i; } u;
+        u.f = src[i] + 384.0;
+        if( u.i > 0x43c07fff )
+            dst[i] = 32767;
+        else if( u.i < 0x43bf8000 )
+            dst[i] = -32768;
+        else
+            dst[i] = u.i - 0x43c00000;
+    }
+}
+
+/* Converts signed 32-bits samples to float. dst may alias src. */
+static inline void SamplesS32ToFL32C( float *dst, const int32_t *src,
+                                      size_t i_samples )
+{
+    for( size_t i = 0; i < i_samples; i++ )
+        dst[i] = (float)src[i] / 2147483648.f;
+}
+
+/* Interleaves two planes into a stereo buffer */
+static inline void SamplesInterleave2FL32C( float *dst, const float *l,
+                                            const float *r, size_t i_frames )
+{
+    for( size_t i = 0; i < i_frames; i++ )
+    {
+        dst[2 * i]     = l[i];
+        dst[2 * i + 1] = r[i];
+    }
+}
+
+/* Splits a stereo buffer into two planes */
+static inline void SamplesDeinterleave2FL32C( float *l, float *r,
+                                              const float *src,
+                                              size_t i_frames )
+{
+    for( size_t i = 0; i < i_frames; i++ )
+    {
+        l[i] = src[2 * i];
+        r[i] = src[2 * i + 1];
+    }
+}
+
+/* Mixes i_frames interleaved frames of i_in channels into i_out channels:
+ * dst[o] = sum over k of src[k] * matrix[o * i_in + k]. */
+static inline void SamplesMixFL32C( float *dst, unsigned i_out,
+                                    const float *src, unsigned i_in,
+                                    const float *matrix, size_t i_frames )
+{
+    for( size_t i = 0; i < i_frames; i++ )
+    {
+        for( unsigned o = 0; o < i_out; o++ )
+        {
+            const float *row = &matrix[o * i_in];
+            float f_acc = 0.f;
+            for( unsigned k = 0; k < i_in; k++ )
+                f_acc += src[k] * row[k];
+            dst[o] = f_acc;
+        }
+        src += i_in;
+        dst += i_out;
+    }
+}
+
+/* G.711 A-law and µ-law, computed rather than looked up so that the vector
+ * versions can follow the exact same steps */
+static inline int16_t SamplesAlawDecode( uint8_t b )
+{
+    const unsigned x = b ^ 0x55;
+    const unsigned e = (x >> 4) & 7, m = x & 15;
+    const int mag = e ? ((m << 4) + 0x108) << (e - 1) : (m << 4) + 8;
+    return (x & 0x80) ? mag : -mag;
+}
+
+static inline int16_t SamplesUlawDecode( uint8_t b )
+{
+    const unsigned x = ~b & 0xFF;
+    const unsigned e = (x >> 4) & 7, m = x & 15;
+    const int mag = ((m << 3) + 0x84) << e;
+    return (x & 0x80) ? 0x84 - mag : mag - 0x84;
+}
+
+static inline uint8_t SamplesAlawEncode( int16_t s )
+{
+    unsigned idx = (s >= 0 ? s : -(int)s) >> 4;
+    if( idx > 2047 )
+        idx = 2047;
+
+    unsigned seg = 0;
+    for( unsigned t = 16; t <= 1024 && idx >= t; t <<= 1 )
+        seg++;
+
+    const unsigned code = (seg << 4) | (((idx << 1) >> (seg ? seg : 1)) & 15);
+    return code ^ (s >= 0 ? 0xD5 : 0x55);
+}
+
+static inline uint8_t SamplesUlawEncode( int16_t s )
+{
+    unsigned idx = (s >= 0 ? s : -(int)s) >> 2;
+    if( idx > 8158 )
+        idx = 8158;
+    idx += 33;
+
+    unsigned seg = 0;
+    for( unsigned t = 64; t <= 4096 && idx >= t; t <<= 1 )
+        seg++;
+
+    const unsigned code = (seg << 4) | ((idx >> (seg + 1)) & 15);
+    return code ^ (s >= 0 ? 0xFF : 0x7F);
+}
+
+static inline void SamplesAlawToS16C( int16_t *dst, const uint8_t *src,
+                                      size_t i_samples )
+{
+    for( size_t i = 0; i < i_samples; i++ )
+        dst[i] = SamplesAlawDecode( src[i] );
+}
+
+static inline void SamplesUlawToS16C( int16_t *dst, const uint8_t *src,
+                                      size_t i_samples )
+{
+    for( size_t i = 0; i < i_samples; i++ )
+        dst[i] = SamplesUlawDecode( src[i] );
+}
+
+static inline void SamplesS16ToAlawC( uint8_t *dst, const int16_t *src,
+                                      size_t i_samples )
+{
+    for( size_t i = 0; i < i_samples; i++ )
+        dst[i] = SamplesAlawEncode( src[i] );
+}
+
+static inline void SamplesS16ToUlawC( uint8_t *dst, const int16_t *src,
+                                      size_t i_samples )
+{
+    for( size_t i = 0; i < i_samples; i++ )
+        dst[i] = SamplesUlawEncode( src[i] );
+}
+
+/*****************************************************************************
+ * SSE2 and AVX2 versions
+ *****************************************************************************/
+#ifdef SAMPLES_SIMD_X86
+__attribute__ ((__target__ ("sse2")))
+static inline void SamplesGainFL32SSE2( float *p, size_t i_samples,
+                                        float f_gain )
+{
+    const __m128 gain = _mm_set1_ps( f_gain );
+    size_t i = 0;
+
+    for( ; i + 8 <= i_samples; i += 8 )
+    {
+        _mm_storeu_ps( &p[i], _mm_mul_ps( _mm_loadu_ps( &p[i] ), gain ) );
+        _mm_storeu_ps( &p[i + 4],
+                       _mm_mul_ps( _mm_loadu_ps( &p[i + 4] ), gain ) );
+    }
+    SamplesGainFL32C( &p[i], i_samples - i, f_gain );
+}
+
+__attribute__ ((__target__ ("avx2")))
+static inline void SamplesGainFL32AVX2( float *p, size_t i_samples,
+                                        float f_gain )
+{
+    const __m256 gain = _mm256_set1_ps( f_gain );
+    size_t i = 0;
+
+    for( ; i + 16 <= i_samples; i += 16 )
+    {
+        _mm256_storeu_ps( &p[i],
+                          _mm256_mul_ps( _mm256_loadu_ps( &p[i] ), gain ) );
+        _mm256_storeu_ps( &p[i + 8],
+                          _mm256_mul_ps( _mm256_loadu_ps( &p[i + 8] ), gain ) );
+    }
+    SamplesGainFL32SSE2( &p[i], i_samples - i, f_gain );
+}
+
+__attribute__ ((__target__ ("sse2")))
+static inline void SamplesS16ToFL32SSE2( float *dst, const int16_t *src,
+                                         size_t i_samples )
+{
+    const __m128 scale = _mm_set1_ps( 1.f / 32768.f );
+    size_t i = 0;
+
+    for( ; i + 8 <= i_samples; i += 8 )
+    {
+        const __m128i s = _mm_loadu_si128( (const __m128i *)&src[i] );
+        /* sign extension: the sample lands in the upper half of each lane */
+        const __m128i lo = _mm_srai_epi32( _mm_unpacklo_epi16( s, s ), 16 );
+        const __m128i hi = _mm_srai_epi32( _mm_unpackhi_epi16( s, s ), 16 );
+        _mm_storeu_ps( &dst[i], _mm_mul_ps( _mm_cvtepi32_ps( lo ), scale ) );
+        _mm_storeu_ps( &dst[i + 4],
+                       _mm_mul_ps( _mm_cvtepi32_ps( hi ), scale ) );
+    }
+    SamplesS16ToFL32C( &dst[i], &src[i], i_samples - i );
+}
+
+__attribute__ ((__target__ ("avx2")))
+static inline void SamplesS16ToFL32AVX2( float *dst, const int16_t *src,
+                                         size_t i_samples )
+{
+    const __m256 scale = _mm256_set1_ps( 1.f / 32768.f );
+    size_t i = 0;
+
+    for( ; i + 8 <= i_samples; i += 8 )
+    {
+        const __m256i s = _mm256_cvtepi16_epi32(
+            _mm_loadu_si128( (const __m128i *)&src[i] ) );
+        _mm256_storeu_ps( &dst[i],
+                          _mm256_mul_ps( _mm256_cvtepi32_ps( s ), scale ) );
+    }
+    SamplesS16ToFL32C( &dst[i], &src[i], i_samples - i );
+}
+
+__attribute__ ((__target__ ("sse2")))
+static inline void SamplesFL32ToS16SSE2( int16_t *dst, const float *src,
+                                         size_t i_samples )
+{
+    const __m128 scale = _mm_set1_ps( 32768.f );
+    const __m128 max = _mm_set1_ps( 32767.f );
+    const __m128 min = _mm_set1_ps( -32768.f );
+    size_t i = 0;
+
+    /* Both vectors are loaded before the store, so dst may alias src.
+     * _mm_min_ps() returns its second operand for NaN, like the C version.
+     * The conversion rounds to nearest even under the default MXCSR. */
+    for( ; i + 8 <= i_samples; i += 8 )
+    {
+        __m128 lo = _mm_mul_ps( _mm_loadu_ps( &src[i] ), scale );
+        __m128 hi = _mm_mul_ps( _mm_loadu_ps( &src[i + 4] ), scale );
+        lo = _mm_max_ps( _mm_min_ps( lo, max ), min );
+        hi = _mm_max_ps( _mm_min_ps( hi, max ), min );
+        _mm_storeu_si128( (__m128i *)&dst[i],
+                          _mm_packs_epi32( _mm_cvtps_epi32( lo ),
+                                           _mm_cvtps_epi32( hi ) ) );
+    }
+    SamplesFL32ToS16C( &dst[i], &src[i], i_samples - i );
+}
+
+__attribute__ ((__target__ ("avx2")))
+static inline void SamplesFL32ToS16AVX2( int16_t *dst, const float *src,
+                                         size_t i_samples )
+{
+    const __m256 scale = _mm256_set1_ps( 32768.f );
+    const __m256 max = _mm256_set1_ps( 32767.f );
+    const __m256 min = _mm256_set1_ps( -32768.f );
+    size_t i = 0;
+
+    for( ; i + 16 <= i_samples; i += 16 )
+    {
+        __m256 lo = _mm256_mul_ps( _mm256_loadu_ps( &src[i] ), scale );
+        __m256 hi = _mm256_mul_ps( _mm256_loadu_ps( &src[i + 8] ), scale );
+        lo = _mm256_max_ps( _mm256_min_ps( lo, max ), min );
+        hi = _mm256_max_ps( _mm256_min_ps( hi, max ), min );
+        /* packing works within 128-bits lanes, put the quads back in order */
+        const __m256i s = _mm256_packs_epi32( _mm256_cvtps_epi32( lo ),
+                                              _mm256_cvtps_epi32( hi ) );
+        _mm256_storeu_si256( (__m256i *)&dst[i],
+                             _mm256_permute4x64_epi64( s, 0xD8 ) );
+    }
+    SamplesFL32ToS16SSE2( &dst[i], &src[i], i_samples - i );
+}
+
+__attribute__ ((__target__ ("sse2")))
+static inline void SamplesS32ToFL32SSE2( float *dst, const int32_t *src,
+                                         size_t i_samples )
+{
+    const __m128 scale = _mm_set1_ps( 1.f / 2147483648.f );
+    size_t i = 0;
+
+    for( ; i + 4 <= i_samples; i += 4 )
+    {
+        const __m128i s = _mm_loadu_si128( (const __m128i *)&src[i] );
+        _mm_storeu_ps( &dst[i], _mm_mul_ps( _mm_cvtepi32_ps( s ), scale ) );
+    }
+    SamplesS32ToFL32C( &dst[i], &src[i], i_samples - i );
+}
+
+__attribute__ ((__target__ ("avx2")))
+static inline void SamplesS32ToFL32AVX2( float *dst, const int32_t *src,
+                                         size_t i_samples )
+{
+    const __m256 scale = _mm256_set1_ps( 1.f / 2147483648.f );
+    size_t i = 0;
+
+    for( ; i + 8 <= i_samples; i += 8 )
+    {
+        const __m256i s = _mm256_loadu_si256( (const __m256i *)&src[i] );
+        _mm256_storeu_ps( &dst[i],
+                          _mm256_mul_ps( _mm256_cvtepi32_ps( s ), scale ) );
+    }
+    SamplesS32ToFL32SSE2( &dst[i], &src[i], i_samples - i );
+}
+
+__attribute__ ((__target__ ("sse2")))
+static inline void SamplesInterleave2FL32SSE2( float *dst, const float *l,
+                                               const float *r,
+                                               size_t i_frames )
+{
+    size_t i = 0;
+
+    for( ; i + 4 <= i_frames; i += 4 )
+    {
+        const __m128 vl = _mm_loadu_ps( &l[i] );
+        const __m128 vr = _mm_loadu_ps( &r[i] );
+        _mm_storeu_ps( &dst[2 * i], _mm_unpacklo_ps( vl, vr ) );
+        _mm_storeu_ps( &dst[2 * i + 4], _mm_unpackhi_ps( vl, vr ) );
+    }
+    SamplesInterleave2FL32C( &dst[2 * i], &l[i], &r[i], i_frames - i );
+}
+
+__attribute__ ((__target__ ("avx2")))
+static inline void SamplesInterleave2FL32AVX2( float *dst, const float *l,
+                                               const float *r,
+                                               size_t i_frames )
+{
+    size_t i = 0;
+
+    for( ; i + 8 <= i_frames; i += 8 )
+    {
+        const __m256 vl = _mm256_loadu_ps( &l[i] );
+        const __m256 vr = _mm256_loadu_ps( &r[i] );
+        const __m256 lo = _mm256_unpacklo_ps( vl, vr ); /* frames 0-1, 4-5 */
+        const __m256 hi = _mm256_unpackhi_ps( vl, vr ); /* frames 2-3, 6-7 */
+        _mm256_storeu_ps( &dst[2 * i], _mm256_permute2f128_ps( lo, hi, 0x20 ) );
+        _mm256_storeu_ps( &dst[2 * i + 8],
+                          _mm256_permute2f128_ps( lo, hi, 0x31 ) );
+    }
+    SamplesInterleave2FL32SSE2( &dst[2 * i], &l[i], &r[i], i_frames - i );
+}
+
+__attribute__ ((__target__ ("sse2")))
+static inline void SamplesDeinterleave2FL32SSE2( float *l, float *r,
+                                                 const float *src,
+                                                 size_t i_frames )
+{
+    size_t i = 0;
+
+    for( ; i + 4 <= i_frames; i += 4 )
+    {
+        const __m128 a = _mm_loadu_ps( &src[2 * i] );
+        const __m128 b = _mm_loadu_ps( &src[2 * i + 4] );
+        _mm_storeu_ps( &l[i], _mm_shuffle_ps( a, b, _MM_SHUFFLE(2, 0, 2, 0) ) );
+        _mm_storeu_ps( &r[i], _mm_shuffle_ps( a, b, _MM_SHUFFLE(3, 1, 3, 1) ) );
+    }
+    SamplesDeinterleave2FL32C( &l[i], &r[i], &src[2 * i], i_frames - i );
+}
+
+__attribute__ ((__target__ ("avx2")))
+static inline void SamplesDeinterleave2FL32AVX2( float *l, float *r,
+                                                 const float *src,
+                                                 size_t i_frames )
+{
+    size_t i = 0;
+
+    for( ; i + 8 <= i_frames; i += 8 )
+    {
+        const __m256 a = _mm256_loadu_ps( &src[2 * i] );     /* frames 0-3 */
+        const __m256 b = _mm256_loadu_ps( &src[2 * i + 8] ); /* frames 4-7 */
+        /* shuffling works within 128-bits lanes: frames 0-1 4-5 2-3 6-7 */
+        const __m256 vl = _mm256_shuffle_ps( a, b, _MM_SHUFFLE(2, 0, 2, 0) );
+        const __m256 vr = _mm256_shuffle_ps( a, b, _MM_SHUFFLE(3, 1, 3, 1) );
+        _mm256_storeu_ps( &l[i], _mm256_castpd_ps( _mm256_permute4x64_pd(
+                                 _mm256_castps_pd( vl ), 0xD8 ) ) );
+        _mm256_storeu_ps( &r[i], _mm256_castpd_ps( _mm256_permute4x64_pd(
+                                 _mm256_castps_pd( vr ), 0xD8 ) ) );
+    }
+    SamplesDeinterleave2FL32SSE2( &l[i], &r[i], &src[2 * i], i_frames - i );
+}
+
+/*
+ * The mixing kernels compute one output frame per vector as the sum of the
+ * matrix columns scaled by the input samples. Stores are full vector wide and
+ * spill over the next output frame, which is written right after; the last
+ * frames, where the spill would overflow the buffer, are left to the C code.
+ */
+__attribute__ ((__target__ ("sse2")))
+static inline void SamplesMixFL32SSE2( float *dst, unsigned i_out,
+                                       const float *src, unsigned i_in,
+                                       const float *matrix, size_t i_frames )
+{
+    __m128 cols[2][SAMPLES_MIX_MAX_IN];
+    const unsigned i_vecs = (i_out + 3) / 4;
+    const size_t i_tail = (4 * i_vecs + i_out - 1) / i_out;
+    size_t i = 0;
+
+    assert( i_in <= SAMPLES_MIX_MAX_IN && i_out <= SAMPLES_MIX_MAX_OUT );
+    for( unsigned v = 0; v < i_vecs; v++ )
+        for( unsigned k = 0; k < i_in; k++ )
+        {
+            float col[4];
+            for( unsigned o = 0; o < 4; o++ )
+                col[o] = 4 * v + o < i_out ? matrix[(4 * v + o) * i_in + k]
+                                           : 0.f;
+            cols[v][k] = _mm_loadu_ps( col );
+        }
+
+    for( ; i + i_tail <= i_frames; i++ )
+    {
+        const float *in = &src[i * i_in];
+        for( unsigned v = 0; v < i_vecs; v++ )
+        {
+            __m128 acc = _mm_setzero_ps();
+            for( unsigned k = 0; k < i_in; k++ )
+                acc = _mm_add_ps( acc, _mm_mul_ps( _mm_set1_ps( in[k] ),
+                                                   cols[v][k] ) );
+            _mm_storeu_ps( &dst[i * i_out + 4 * v], acc );
+        }
+    }
+    SamplesMixFL32C( &dst[i * i_out], i_out, &src[i * i_in], i_in, matrix,
+                     i_frames - i );
+}
+
+__attribute__ ((__target__ ("avx2")))
+static inline void SamplesMixFL32AVX2( float *dst, unsigned i_out,
+                                       const float *src, unsigned i_in,
+                                       const float *matrix, size_t i_frames )
+{
+    __m256 cols[SAMPLES_MIX_MAX_IN];
+    /* Up to 4 output channels, two frames share one vector */
+    const unsigned i_width = i_out <= 4 ? 4 : 8;
+    const size_t i_tail = (i_width + i_out - 1) / i_out;
+    size_t i = 0;
+
+    assert( i_in <= SAMPLES_MIX_MAX_IN && i_out <= SAMPLES_MIX_MAX_OUT );
+    for( unsigned k = 0; k < i_in; k++ )
+    {
+        float col[8];
+        for( unsigned o = 0; o < 8; o++ )
+        {
+            const unsigned c = o % i_width;
+            col[o] = c < i_out ? matrix[c * i_in + k] : 0.f;
+        }
+        cols[k] = _mm256_loadu_ps( col );
+    }
+
+    if( i_width == 4 )
+    {
+        for( ; i + 1 + i_tail <= i_frames; i += 2 )
+        {
+            const float *a = &src[i * i_in], *b = a + i_in;
+            __m256 acc = _mm256_setzero_ps();
+            for( unsigned k = 0; k < i_in; k++ )
+            {
+                const __m256 s = _mm256_insertf128_ps(
+                    _mm256_castps128_ps256( _mm_set1_ps( a[k] ) ),
+                    _mm_set1_ps( b[k] ), 1 );
+                acc = _mm256_add_ps( acc, _mm256_mul_ps( s, cols[k] ) );
+            }
+            _mm_storeu_ps( &dst[i * i_out], _mm256_castps256_ps128( acc ) );
+            _mm_storeu_ps( &dst[(i + 1) * i_out],
+                           _mm256_extractf128_ps( acc, 1 ) );
+        }
+    }
+    else
+    {
+        for( ; i + i_tail <= i_frames; i++ )
+        {
+            const float *in = &src[i * i_in];
+            __m256 acc = _mm256_setzero_ps();
+            for( unsigned k = 0; k < i_in; k++ )
+                acc = _mm256_add_ps( acc, _mm256_mul_ps(
+                                     _mm256_set1_ps( in[k] ), cols[k] ) );
+            _mm256_storeu_ps( &dst[i * i_out], acc );
+        }
+    }
+    SamplesMixFL32C( &dst[i * i_out], i_out, &src[i * i_in], i_in, matrix,
+                     i_frames - i );
+}
+
+/* Returns 1 << e for each 16-bits lane, e in [0, 7] */
+__attribute__ ((__target__ ("sse2")))
+static inline __m128i SamplesPow2SSE2( __m128i e )
+{
+    const __m128i one = _mm_set1_epi16( 1 );
+    const __m128i b0 = _mm_and_si128( e, one );
+    const __m128i b1 = _mm_and_si128( _mm_srli_epi16( e, 1 ), one );
+    const __m128i b2 = _mm_and_si128( _mm_srli_epi16( e, 2 ), one );
+    __m128i p = _mm_add_epi16( b0, one );
+    p = _mm_mullo_epi16( p, _mm_add_epi16( _mm_mullo_epi16( b1,
+                                           _mm_set1_epi16( 3 ) ), one ) );
+    return _mm_mullo_epi16( p, _mm_add_epi16( _mm_mullo_epi16( b2,
+                                              _mm_set1_epi16( 15 ) ), one ) );
+}
+
+__attribute__ ((__target__ ("sse2")))
+static inline __m128i SamplesAlawDecodeSSE2( __m128i x )
+{
+    const __m128i m15 = _mm_set1_epi16( 15 );
+    const __m128i e = _mm_and_si128( _mm_srli_epi16( x, 4 ),
+                                     _mm_set1_epi16( 7 ) );
+    const __m128i base = _mm_add_epi16(
+        _mm_slli_epi16( _mm_and_si128( x, m15 ), 4 ),
+        _mm_add_epi16( _mm_set1_epi16( 8 ),
+                       _mm_andnot_si128( _mm_cmpeq_epi16( e,
+                                                    _mm_setzero_si128() ),
+                                         _mm_set1_epi16( 0x100 ) ) ) );
+    const __m128i mag = _mm_mullo_epi16( base, SamplesPow2SSE2(
+                            _mm_subs_epu16( e, _mm_set1_epi16( 1 ) ) ) );
+    /* negative when the sign bit is clear */
+    const __m128i neg = _mm_cmpeq_epi16( _mm_and_si128( x,
+                                             _mm_set1_epi16( 0x80 ) ),
+                                         _mm_setzero_si128() );
+    return _mm_sub_epi16( _mm_xor_si128( mag, neg ), neg );
+}
+
+__attribute__ ((__target__ ("sse2")))
+static inline __m128i SamplesUlawDecodeSSE2( __m128i x )
+{
+    const __m128i bias = _mm_set1_epi16( 0x84 );
+    const __m128i e = _mm_and_si128( _mm_srli_epi16( x, 4 ),
+                                     _mm_set1_epi16( 7 ) );
+    const __m128i base = _mm_add_epi16(
+        _mm_slli_epi16( _mm_and_si128( x, _mm_set1_epi16( 15 ) ), 3 ), bias );
+    const __m128i val = _mm_sub_epi16(
+        _mm_mullo_epi16( base, SamplesPow2SSE2( e ) ), bias );
+    const __m128i neg = _mm_cmpeq_epi16( _mm_and_si128( x,
+                                             _mm_set1_epi16( 0x80 ) ),
+                                         _mm_set1_epi16( 0x80 ) );
+    return _mm_sub_epi16( _mm_xor_si128( val, neg ), neg );
+}
+
+__attribute__ ((__target__ ("sse2")))
+static inline void SamplesAlawToS16SSE2( int16_t *dst, const uint8_t *src,
+                                         size_t i_samples )
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i mask = _mm_set1_epi8( 0x55 );
+    size_t i = 0;
+
+    for( ; i + 16 <= i_samples; i += 16 )
+    {
+        const __m128i x = _mm_xor_si128(
+            _mm_loadu_si128( (const __m128i *)&src[i] ), mask );
+        _mm_storeu_si128( (__m128i *)&dst[i],
+            SamplesAlawDecodeSSE2( _mm_unpacklo_epi8( x, zero ) ) );
+        _mm_storeu_si128( (__m128i *)&dst[i + 8],
+            SamplesAlawDecodeSSE2( _mm_unpackhi_epi8( x, zero ) ) );
+    }
+    SamplesAlawToS16C( &dst[i], &src[i], i_samples - i );
+}
+
+__attribute__ ((__target__ ("sse2")))
+static inline void SamplesUlawToS16SSE2( int16_t *dst, const uint8_t *src,
+                                         size_t i_samples )
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i mask = _mm_set1_epi8( 0xFF );
+    size_t i = 0;
+
+    for( ; i + 16 <= i_samples; i += 16 )
+    {
+        const __m128i x = _mm_xor_si128(
+            _mm_loadu_si128( (const __m128i *)&src[i] ), mask );
+        _mm_storeu_si128( (__m128i *)&dst[i],
+            SamplesUlawDecodeSSE2( _mm_unpacklo_epi8( x, zero ) ) );
+        _mm_storeu_si128( (__m128i *)&dst[i + 8],
+            SamplesUlawDecodeSSE2( _mm_unpackhi_epi8( x, zero ) ) );
+    }
+    SamplesUlawToS16C( &dst[i], &src[i], i_samples - i );
+}
+
+/*
+ * The encoders count the segment with one comparison per threshold. The
+ * mantissa shift grows by one with each segment, so the same comparisons halve
+ * a multiplier whose high product performs the per-lane right shift.
+ */
+__attribute__ ((__target__ ("sse2")))
+static inline __m128i SamplesAlawEncodeSSE2( __m128i s )
+{
+    const __m128i neg = _mm_srai_epi16( s, 15 );
+    /* |s| >> 4, computed unsigned so that -32768 does not overflow */
+    __m128i idx = _mm_srli_epi16( _mm_sub_epi16( _mm_xor_si128( s, neg ),
+                                                 neg ), 4 );
+    idx = _mm_min_epi16( idx, _mm_set1_epi16( 2047 ) );
+
+    __m128i seg = _mm_cmpgt_epi16( idx, _mm_set1_epi16( 15 ) );
+    __m128i mul = _mm_set1_epi16( 0x8000 );
+    for( int t = 32; t <= 1024; t <<= 1 )
+    {
+        const __m128i gt = _mm_cmpgt_epi16( idx, _mm_set1_epi16( t - 1 ) );
+        seg = _mm_add_epi16( seg, gt );
+        mul = _mm_sub_epi16( mul, _mm_and_si128( gt,
+                                                 _mm_srli_epi16( mul, 1 ) ) );
+    }
+    seg = _mm_sub_epi16( _mm_setzero_si128(), seg );
+
+    const __m128i mant = _mm_and_si128( _mm_mulhi_epu16(
+                             _mm_slli_epi16( idx, 1 ), mul ),
+                             _mm_set1_epi16( 15 ) );
+    const __m128i code = _mm_or_si128( _mm_slli_epi16( seg, 4 ), mant );
+    return _mm_xor_si128( code, _mm_xor_si128( _mm_set1_epi16( 0xD5 ),
+                          _mm_and_si128( neg, _mm_set1_epi16( 0x80 ) ) ) );
+}
+
+__attribute__ ((__target__ ("sse2")))
+static inline __m128i SamplesUlawEncodeSSE2( __m128i s )
+{
+    const __m128i neg = _mm_srai_epi16( s, 15 );
+    __m128i idx = _mm_srli_epi16( _mm_sub_epi16( _mm_xor_si128( s, neg ),
+                                                 neg ), 2 );
+    idx = _mm_add_epi16( _mm_min_epi16( idx, _mm_set1_epi16( 8158 ) ),
+                         _mm_set1_epi16( 33 ) );
+
+    __m128i seg = _mm_setzero_si128();
+    __m128i mul = _mm_set1_epi16( 0x8000 );
+    for( int t = 64; t <= 4096; t <<= 1 )
+    {
+        const __m128i gt = _mm_cmpgt_epi16( idx, _mm_set1_epi16( t - 1 ) );
+        seg = _mm_sub_epi16( seg, gt );
+        mul = _mm_sub_epi16( mul, _mm_and_si128( gt,
+                                                 _mm_srli_epi16( mul, 1 ) ) );
+    }
+
+    const __m128i mant = _mm_and_si128( _mm_mulhi_epu16( idx, mul ),
+                                        _mm_set1_epi16( 15 ) );
+    const __m128i code = _mm_or_si128( _mm_slli_epi16( seg, 4 ), mant );
+    return _mm_xor_si128( code, _mm_xor_si128( _mm_set1_epi16( 0xFF ),
+                          _mm_and_si128( neg, _mm_set1_epi16( 0x80 ) ) ) );
+}
+
+__attribute__ ((__target__ ("sse2")))
+static inline void SamplesS16ToAlawSSE2( uint8_t *dst, const int16_t *src,
+                                         size_t i_samples )
+{
+    size_t i = 0;
+
+    for( ; i + 16 <= i_samples; i += 16 )
+    {
+        const __m128i lo = SamplesAlawEncodeSSE2(
+            _mm_loadu_si128( (const __m128i *)&src[i] ) );
+        const __m128i hi = SamplesAlawEncodeSSE2(
+            _mm_loadu_si128( (const __m128i *)&src[i + 8] ) );
+        _mm_storeu_si128( (__m128i *)&dst[i], _mm_packus_epi16( lo, hi ) );
+    }
+    SamplesS16ToAlawC( &dst[i], &src[i], i_samples - i );
+}
+
+__attribute__ ((__target__ ("sse2")))
+static inline void SamplesS16ToUlawSSE2( uint8_t *dst, const int16_t *src,
+                                         size_t i_samples )
+{
+    size_t i = 0;
+
+    for( ; i + 16 <= i_samples; i += 16 )
+    {
+        const __m128i lo = SamplesUlawEncodeSSE2(
+            _mm_loadu_si128( (const __m128i *)&src[i] ) );
+        const __m128i hi = SamplesUlawEncodeSSE2(
+            _mm_loadu_si128( (const __m128i *)&src[i + 8] ) );
+        _mm_storeu_si128( (__m128i *)&dst[i], _mm_packus_epi16( lo, hi ) );
+    }
+    SamplesS16ToUlawC( &dst[i], &src[i], i_samples - i );
+}
+
+/* The AVX2 G.711 kernels follow the SSE2 ones step by step, 16 lanes wide */
+__attribute__ ((__target__ ("avx2")))
+static inline __m256i SamplesPow2AVX2( __m256i e )
+{
+    const __m256i one = _mm256_set1_epi16( 1 );
+    const __m256i b0 = _mm256_and_si256( e, one );
+    const __m256i b1 = _mm256_and_si256( _mm256_srli_epi16( e, 1 ), one );
+    const __m256i b2 = _mm256_and_si256( _mm256_srli_epi16( e, 2 ), one );
+    __m256i p = _mm256_add_epi16( b0, one );
+    p = _mm256_mullo_epi16( p, _mm256_add_epi16( _mm256_mullo_epi16( b1,
+                                 _mm256_set1_epi16( 3 ) ), one ) );
+    return _mm256_mullo_epi16( p, _mm256_add_epi16( _mm256_mullo_epi16( b2,
+                                    _mm256_set1_epi16( 15 ) ), one ) );
+}
+
+__attribute__ ((__target__ ("avx2")))
+static inline void SamplesAlawToS16AVX2( int16_t *dst, const uint8_t *src,
+                                         size_t i_samples )
+{
+    const __m256i zero = _mm256_setzero_si256();
+    size_t i = 0;
+
+    for( ; i + 16 <= i_samples; i += 16 )
+    {
+        const __m256i x = _mm256_xor_si256( _mm256_cvtepu8_epi16(
+            _mm_loadu_si128( (const __m128i *)&src[i] ) ),
+            _mm256_set1_epi16( 0x55 ) );
+        const __m256i e = _mm256_and_si256( _mm256_srli_epi16( x, 4 ),
+                                            _mm256_set1_epi16( 7 ) );
+        const __m256i base = _mm256_add_epi16(
+            _mm256_slli_epi16( _mm256_and_si256( x,
+                                   _mm256_set1_epi16( 15 ) ), 4 ),
+            _mm256_add_epi16( _mm256_set1_epi16( 8 ),
+                _mm256_andnot_si256( _mm256_cmpeq_epi16( e, zero ),
+                                     _mm256_set1_epi16( 0x100 ) ) ) );
+        const __m256i mag = _mm256_mullo_epi16( base, SamplesPow2AVX2(
+                                _mm256_subs_epu16( e,
+                                    _mm256_set1_epi16( 1 ) ) ) );
+        const __m256i neg = _mm256_cmpeq_epi16( _mm256_and_si256( x,
+                                _mm256_set1_epi16( 0x80 ) ), zero );
+        _mm256_storeu_si256( (__m256i *)&dst[i], _mm256_sub_epi16(
+                             _mm256_xor_si256( mag, neg ), neg ) );
+    }
+    SamplesAlawToS16SSE2( &dst[i], &src[i], i_samples - i );
+}
+
+__attribute__ ((__target__ ("avx2")))
+static inline void SamplesUlawToS16AVX2( int16_t *dst, const uint8_t *src,
+                                         size_t i_samples )
+{
+    const __m256i bias = _mm256_set1_epi16( 0x84 );
+    const __m256i sign = _mm256_set1_epi16( 0x80 );
+    size_t i = 0;
+
+    for( ; i + 16 <= i_samples; i += 16 )
+    {
+        const __m256i x = _mm256_xor_si256( _mm256_cvtepu8_epi16(
+            _mm_loadu_si128( (const __m128i *)&src[i] ) ),
+            _mm256_set1_epi16( 0xFF ) );
+        const __m256i e = _mm256_and_si256( _mm256_srli_epi16( x, 4 ),
+                                            _mm256_set1_epi16( 7 ) );
+        const __m256i base = _mm256_add_epi16( _mm256_slli_epi16(
+            _mm256_and_si256( x, _mm256_set1_epi16( 15 ) ), 3 ), bias );
+        const __m256i val = _mm256_sub_epi16(
+            _mm256_mullo_epi16( base, SamplesPow2AVX2( e ) ), bias );
+        const __m256i neg = _mm256_cmpeq_epi16( _mm256_and_si256( x, sign ),
+                                                sign );
+        _mm256_storeu_si256( (__m256i *)&dst[i], _mm256_sub_epi16(
+                             _mm256_xor_si256( val, neg ), neg ) );
+    }
+    SamplesUlawToS16SSE2( &dst[i], &src[i], i_samples - i );
+}
+
+__attribute__ ((__target__ ("avx2")))
+static inline __m256i SamplesAlawEncodeAVX2( __m256i s )
+{
+    const __m256i neg = _mm256_srai_epi16( s, 15 );
+    __m256i idx = _mm256_srli_epi16( _mm256_sub_epi16(
+                      _mm256_xor_si256( s, neg ), neg ), 4 );
+    idx = _mm256_min_epi16( idx, _mm256_set1_epi16( 2047 ) );
+
+    __m256i seg = _mm256_cmpgt_epi16( idx, _mm256_set1_epi16( 15 ) );
+    __m256i mul = _mm256_set1_epi16( 0x8000 );
+    for( int t = 32; t <= 1024; t <<= 1 )
+    {
+        const __m256i gt = _mm256_cmpgt_epi16( idx,
+                                               _mm256_set1_epi16( t - 1 ) );
+        seg = _mm256_add_epi16( seg, gt );
+        mul = _mm256_sub_epi16( mul, _mm256_and_si256( gt,
+                                    _mm256_srli_epi16( mul, 1 ) ) );
+    }
+    seg = _mm256_sub_epi16( _mm256_setzero_si256(), seg );
+
+    const __m256i mant = _mm256_and_si256( _mm256_mulhi_epu16(
+                             _mm256_slli_epi16( idx, 1 ), mul ),
+                             _mm256_set1_epi16( 15 ) );
+    const __m256i code = _mm256_or_si256( _mm256_slli_epi16( seg, 4 ), mant );
+    return _mm256_xor_si256( code, _mm256_xor_si256(
+                             _mm256_set1_epi16( 0xD5 ),
+                             _mm256_and_si256( neg,
+                                               _mm256_set1_epi16( 0x80 ) ) ) );
+}
+
+__attribute__ ((__target__ ("avx2")))
+static inline __m256i SamplesUlawEncodeAVX2( __m256i s )
+{
+    const __m256i neg = _mm256_srai_epi16( s, 15 );
+    __m256i idx = _mm256_srli_epi16( _mm256_sub_epi16(
+                      _mm256_xor_si256( s, neg ), neg ), 2 );
+    idx = _mm256_add_epi16( _mm256_min_epi16( idx,
+                                _mm256_set1_epi16( 8158 ) ),
+                            _mm256_set1_epi16( 33 ) );
+
+    __m256i seg = _mm256_setzero_si256();
+    __m256i mul = _mm256_set1_epi16( 0x8000 );
+    for( int t = 64; t <= 4096; t <<= 1 )
+    {
+        const __m256i gt = _mm256_cmpgt_epi16( idx,
+                                               _mm256_set1_epi16( t - 1 ) );
+        seg = _mm256_sub_epi16( seg, gt );
+        mul = _mm256_sub_epi16( mul, _mm256_and_si256( gt,
+                                    _mm256_srli_epi16( mul, 1 ) ) );
+    }
+
+    const __m256i mant = _mm256_and_si256( _mm256_mulhi_epu16( idx, mul ),
+                                           _mm256_set1_epi16( 15 ) );
+    const __m256i code = _mm256_or_si256( _mm256_slli_epi16( seg, 4 ), mant );
+    return _mm256_xor_si256( code, _mm256_xor_si256(
+                             _mm256_set1_epi16( 0xFF ),
+                             _mm256_and_si256( neg,
+                                               _mm256_set1_epi16( 0x80 ) ) ) );
+}
+
+__attribute__ ((__target__ ("avx2")))
+static inline void SamplesS16ToAlawAVX2( uint8_t *dst, const int16_t *src,
+                                         size_t i_samples )
+{
+    size_t i = 0;
+
+    for( ; i + 32 <= i_samples; i += 32 )
+    {
+        const __m256i lo = SamplesAlawEncodeAVX2(
+            _mm256_loadu_si256( (const __m256i *)&src[i] ) );
+        const __m256i hi = SamplesAlawEncodeAVX2(
+            _mm256_loadu_si256( (const __m256i *)&src[i + 16] ) );
+        _mm256_storeu_si256( (__m256i *)&dst[i], _mm256_permute4x64_epi64(
+                             _mm256_packus_epi16( lo, hi ), 0xD8 ) );
+    }
+    SamplesS16ToAlawSSE2( &dst[i], &src[i], i_samples - i );
+}
+
+__attribute__ ((__target__ ("avx2")))
+static inline void SamplesS16ToUlawAVX2( uint8_t *dst, const int16_t *src,
+                                         size_t i_samples )
+{
+    size_t i = 0;
+
+    for( ; i + 32 <= i_samples; i += 32 )
+    {
+        const __m256i lo = SamplesUlawEncodeAVX2(
+            _mm256_loadu_si256( (const __m256i *)&src[i] ) );
+        const __m256i hi = SamplesUlawEncodeAVX2(
+            _mm256_loadu_si256( (const __m256i *)&src[i + 16] ) );
+        _mm256_storeu_si256( (__m256i *)&dst[i], _mm256_permute4x64_epi64(
+                             _mm256_packus_epi16( lo, hi ), 0xD8 ) );
+    }
+    SamplesS16ToUlawSSE2( &dst[i], &src[i], i_samples - i );
+}
+#endif /* SAMPLES_SIMD_X86 */
+
+/*****************************************************************************
+ * NEON versions
+ *****************************************************************************/
+#ifdef SAMPLES_SIMD_NEON
+static inline void SamplesGainFL32NEON( float *p, size_t i_samples,
+                                        float f_gain )
+{
+    size_t i = 0;
+
+    for( ; i + 8 <= i_samples; i += 8 )
+    {
+        vst1q_f32( &p[i], vmulq_n_f32( vld1q_f32( &p[i] ), f_gain ) );
+        vst1q_f32( &p[i + 4], vmulq_n_f32( vld1q_f32( &p[i + 4] ), f_gain ) );
+    }
+    SamplesGainFL32C( &p[i], i_samples - i, f_gain );
+}
+
+static inline void SamplesS16ToFL32NEON( float *dst, const int16_t *src,
+                                         size_t i_samples )
+{
+    size_t i = 0;
+
+    for( ; i + 8 <= i_samples; i += 8 )
+    {
+        const int16x8_t s = vld1q_s16( &src[i] );
+        vst1q_f32( &dst[i], vmulq_n_f32( vcvtq_f32_s32(
+                   vmovl_s16( vget_low_s16( s ) ) ), 1.f / 32768.f ) );
+        vst1q_f32( &dst[i + 4], vmulq_n_f32( vcvtq_f32_s32(
+                   vmovl_s16( vget_high_s16( s ) ) ), 1.f / 32768.f ) );
+    }
+    SamplesS16ToFL32C( &dst[i], &src[i], i_samples - i );
+}
+
+#ifdef __aarch64__
+/* ARMv7 NEON has no round-to-nearest conversion */
+static inline void SamplesFL32ToS16NEON( int16_t *dst, const float *src,
+                                         size_t i_samples )
+{
+    const float32x4_t max = vdupq_n_f32( 32767.f );
+    const float32x4_t min = vdupq_n_f32( -32768.f );
+    size_t i = 0;
+
+    for( ; i + 8 <= i_samples; i += 8 )
+    {
+        float32x4_t lo = vmulq_n_f32( vld1q_f32( &src[i] ), 32768.f );
+        float32x4_t hi = vmulq_n_f32( vld1q_f32( &src[i + 4] ), 32768.f );
+        /* vminnmq_f32() returns the number for NaN, like the C version */
+        lo = vmaxq_f32( vminnmq_f32( lo, max ), min );
+        hi = vmaxq_f32( vminnmq_f32( hi, max ), min );
+        vst1q_s16( &dst[i], vcombine_s16( vqmovn_s32( vcvtnq_s32_f32( lo ) ),
+                                          vqmovn_s32( vcvtnq_s32_f32( hi ) ) ) );
+    }
+    SamplesFL32ToS16C( &dst[i], &src[i], i_samples - i );
+}
+#endif
+
+static inline void SamplesS32ToFL32NEON( float *dst, const int32_t *src,
+                                         size_t i_samples )
+{
+    size_t i = 0;
+
+    for( ; i + 4 <= i_samples; i += 4 )
+        vst1q_f32( &dst[i], vmulq_n_f32( vcvtq_f32_s32( vld1q_s32( &src[i] ) ),
+                                         1.f / 2147483648.f ) );
+    SamplesS32ToFL32C( &dst[i], &src[i], i_samples - i );
+}
+
+static inline void SamplesInterleave2FL32NEON( float *dst, const float *l,
+                                               const float *r,
+                                               size_t i_frames )
+{
+    size_t i = 0;
+
+    for( ; i + 4 <= i_frames; i += 4 )
+    {
+        const float32x4x2_t v = { { vld1q_f32( &l[i] ), vld1q_f32( &r[i] ) } };
+        vst2q_f32( &dst[2 * i], v );
+    }
+    SamplesInterleave2FL32C( &dst[2 * i], &l[i], &r[i], i_frames - i );
+}
+
+static inline void SamplesDeinterleave2FL32NEON( float *l, float *r,
+                                                 const float *src,
+                                                 size_t i_frames )
+{
+    size_t i = 0;
+
+    for( ; i + 4 <= i_frames; i += 4 )
+    {
+        const float32x4x2_t v = vld2q_f32( &src[2 * i] );
+        vst1q_f32( &l[i], v.val[0] );
+        vst1q_f32( &r[i], v.val[1] );
+    }
+    SamplesDeinterleave2FL32C( &l[i], &r[i], &src[2 * i], i_frames - i );
+}
+
+static inline void SamplesMixFL32NEON( float *dst, unsigned i_out,
+                                       const float *src, unsigned i_in,
+                                       const float *matrix, size_t i_frames )
+{
+    float32x4_t cols[2][SAMPLES_MIX_MAX_IN];
+    const unsigned i_vecs = (i_out + 3) / 4;
+    const size_t i_tail = (4 * i_vecs + i_out - 1) / i_out;
+    size_t i = 0;
+
+    assert( i_in <= SAMPLES_MIX_MAX_IN && i_out <= SAMPLES_MIX_MAX_OUT );
+    for( unsigned v = 0; v < i_vecs; v++ )
+        for( unsigned k = 0; k < i_in; k++ )
+        {
+            float col[4];
+            for( unsigned o = 0; o < 4; o++ )
+                col[o] = 4 * v + o < i_out ? matrix[(4 * v + o) * i_in + k]
+                                           : 0.f;
+            cols[v][k] = vld1q_f32( col );
+        }
+
+    for( ; i + i_tail <= i_frames; i++ )
+    {
+        const float *in = &src[i * i_in];
+        for( unsigned v = 0; v < i_vecs; v++ )
+        {
+            float32x4_t acc = vdupq_n_f32( 0.f );
+            for( unsigned k = 0; k < i_in; k++ )
+                acc = vmlaq_n_f32( acc, cols[v][k], in[k] );
+            vst1q_f32( &dst[i * i_out + 4 * v], acc );
+        }
+    }
+    SamplesMixFL32C( &dst[i * i_out], i_out, &src[i * i_in], i_in, matrix,
+                     i_frames - i );
+}
+
+static inline void SamplesAlawToS16NEON( int16_t *dst, const uint8_t *src,
+                                         size_t i_samples )
+{
+    size_t i = 0;
+
+    for( ; i + 8 <= i_samples; i += 8 )
+    {
+        const uint16x8_t x = vmovl_u8( veor_u8( vld1_u8( &src[i] ),
+                                                vdup_n_u8( 0x55 ) ) );
+        const uint16x8_t e = vandq_u16( vshrq_n_u16( x, 4 ), vdupq_n_u16( 7 ) );
+        const uint16x8_t base = vaddq_u16(
+            vshlq_n_u16( vandq_u16( x, vdupq_n_u16( 15 ) ), 4 ),
+            vaddq_u16( vdupq_n_u16( 8 ),
+                       vbicq_u16( vdupq_n_u16( 0x100 ),
+                                  vceqq_u16( e, vdupq_n_u16( 0 ) ) ) ) );
+        const int16x8_t mag = vreinterpretq_s16_u16( vshlq_u16( base,
+            vreinterpretq_s16_u16( vqsubq_u16( e, vdupq_n_u16( 1 ) ) ) ) );
+        const uint16x8_t pos = vtstq_u16( x, vdupq_n_u16( 0x80 ) );
+        vst1q_s16( &dst[i], vbslq_s16( pos, mag, vnegq_s16( mag ) ) );
+    }
+    SamplesAlawToS16C( &dst[i], &src[i], i_samples - i );
+}
+
+static inline void SamplesUlawToS16NEON( int16_t *dst, const uint8_t *src,
+                                         size_t i_samples )
+{
+    size_t i = 0;
+
+    for( ; i + 8 <= i_samples; i += 8 )
+    {
+        const uint16x8_t x = vmovl_u8( vmvn_u8( vld1_u8( &src[i] ) ) );
+        const uint16x8_t e = vandq_u16( vshrq_n_u16( x, 4 ), vdupq_n_u16( 7 ) );
+        const uint16x8_t base = vaddq_u16(
+            vshlq_n_u16( vandq_u16( x, vdupq_n_u16( 15 ) ), 3 ),
+            vdupq_n_u16( 0x84 ) );
+        const int16x8_t val = vsubq_s16( vreinterpretq_s16_u16(
+            vshlq_u16( base, vreinterpretq_s16_u16( e ) ) ),
+            vdupq_n_s16( 0x84 ) );
+        const uint16x8_t neg = vtstq_u16( x, vdupq_n_u16( 0x80 ) );
+        vst1q_s16( &dst[i], vbslq_s16( neg, vnegq_s16( val ), val ) );
+    }
+    SamplesUlawToS16C( &dst[i], &src[i], i_samples - i );
+}
+
+static inline void SamplesS16ToAlawNEON( uint8_t *dst, const int16_t *src,
+                                         size_t i_samples )
+{
+    size_t i = 0;
+
+    for( ; i + 8 <= i_samples; i += 8 )
+    {
+        const int16x8_t s = vld1q_s16( &src[i] );
+        /* saturated |s| >> 4 gives 2047 for -32768 too */
+        const uint16x8_t idx = vreinterpretq_u16_s16(
+            vshrq_n_s16( vqabsq_s16( s ), 4 ) );
+        /* segment: 0 below 16, position of the leading bit minus 3 above */
+        const int16x8_t seg = vmaxq_s16( vsubq_s16( vdupq_n_s16( 12 ),
+            vreinterpretq_s16_u16( vclzq_u16( idx ) ) ), vdupq_n_s16( 0 ) );
+        const int16x8_t shift = vnegq_s16( vmaxq_s16( seg, vdupq_n_s16( 1 ) ) );
+        const uint16x8_t mant = vandq_u16( vshlq_u16( vshlq_n_u16( idx, 1 ),
+                                                      shift ),
+                                           vdupq_n_u16( 15 ) );
+        uint16x8_t code = vorrq_u16( vshlq_n_u16(
+                              vreinterpretq_u16_s16( seg ), 4 ), mant );
+        code = veorq_u16( code, vbslq_u16( vcltq_s16( s, vdupq_n_s16( 0 ) ),
+                                           vdupq_n_u16( 0x55 ),
+                                           vdupq_n_u16( 0xD5 ) ) );
+        vst1_u8( &dst[i], vmovn_u16( code ) );
+    }
+    SamplesS16ToAlawC( &dst[i], &src[i], i_samples - i );
+}
+
+static inline void SamplesS16ToUlawNEON( uint8_t *dst, const int16_t *src,
+                                         size_t i_samples )
+{
+    size_t i = 0;
+
+    for( ; i + 8 <= i_samples; i += 8 )
+    {
+        const int16x8_t s = vld1q_s16( &src[i] );
+        const uint16x8_t idx = vaddq_u16( vminq_u16( vreinterpretq_u16_s16(
+            vshrq_n_s16( vqabsq_s16( s ), 2 ) ), vdupq_n_u16( 8158 ) ),
+            vdupq_n_u16( 33 ) );
+        /* idx >= 33, so the leading bit is at position 5 or above */
+        const int16x8_t seg = vsubq_s16( vdupq_n_s16( 10 ),
+            vreinterpretq_s16_u16( vclzq_u16( idx ) ) );
+        const uint16x8_t mant = vandq_u16( vshlq_u16( idx, vnegq_s16(
+            vaddq_s16( seg, vdupq_n_s16( 1 ) ) ) ), vdupq_n_u16( 15 ) );
+        uint16x8_t code = vorrq_u16( vshlq_n_u16(
+                              vreinterpretq_u16_s16( seg ), 4 ), mant );
+        code = veorq_u16( code, vbslq_u16( vcltq_s16( s, vdupq_n_s16( 0 ) ),
+                                           vdupq_n_u16( 0x7F ),
+                                           vdupq_n_u16( 0xFF ) ) );
+        vst1_u8( &dst[i], vmovn_u16( code ) );
+    }
+    SamplesS16ToUlawC( &dst[i], &src[i], i_samples - i );
+}
+#endif /* SAMPLES_SIMD_NEON */
+
+/*****************************************************************************
+ * Dispatchers
+ *****************************************************************************/
+#ifdef SAMPLES_SIMD_X86
+# define SAMPLES_DISPATCH_X86(name, ...) \
+    do { \
+        if( vlc_CPU_AVX2() ) { name##AVX2( __VA_ARGS__ ); return; } \
+        if( vlc_CPU_SSE2() ) { name##SSE2( __VA_ARGS__ ); return; } \
+    } while(0)
+#else
+# define SAMPLES_DISPATCH_X86(name, ...) do { } while(0)
+#endif
+#ifdef SAMPLES_SIMD_NEON
+# define SAMPLES_DISPATCH_NEON(name, ...) \
+    do { name##NEON( __VA_ARGS__ ); return; } while(0)
+#else
+# define SAMPLES_DISPATCH_NEON(name, ...) do { } while(0)
+#endif
+#define SAMPLES_DISPATCH(name, ...) \
+    do { \
+        SAMPLES_DISPATCH_X86(name, __VA_ARGS__); \
+        SAMPLES_DISPATCH_NEON(name, __VA_ARGS__); \
+        name##C( __VA_ARGS__ ); \
+    } while(0)
+
+static inline void SamplesGainFL32( float *p, size_t i_samples, float f_gain )
+{
+    SAMPLES_DISPATCH( SamplesGainFL32, p, i_samples, f_gain );
+}
+
+static inline void SamplesS16ToFL32( float *dst, const int16_t *src,
+                                     size_t i_samples )
+{
+    SAMPLES_DISPATCH( SamplesS16ToFL32, dst, src, i_samples );
+}
+
+static inline void SamplesFL32ToS16( int16_t *dst, const float *src,
+                                     size_t i_samples )
+{
+    SAMPLES_DISPATCH_X86( SamplesFL32ToS16, dst, src, i_samples );
+#ifdef __aarch64__
+    SAMPLES_DISPATCH_NEON( SamplesFL32ToS16, dst, src, i_samples );
+#endif
+    SamplesFL32ToS16C( dst, src, i_samples );
+}
+
+static inline void SamplesS32ToFL32( float *dst, const int32_t *src,
+                                     size_t i_samples )
+{
+    SAMPLES_DISPATCH( SamplesS32ToFL32, dst, src, i_samples );
+}
+
+static inline void SamplesInterleave2FL32( float *dst, const float *l,
+                                           const float *r, size_t i_frames )
+{
+    SAMPLES_DISPATCH( SamplesInterleave2FL32, dst, l, r, i_frames );
+}
+
+static inline void SamplesDeinterleave2FL32( float *l, float *r,
+                                             const float *src,
+                                             size_t i_frames )
+{
+    SAMPLES_DISPATCH( SamplesDeinterleave2FL32, l, r, src, i_frames );
+}
+
+static inline void SamplesMixFL32( float *dst, unsigned i_out,
+                                   const float *src, unsigned i_in,
+                                   const float *matrix, size_t i_frames )
+{
+    SAMPLES_DISPATCH( SamplesMixFL32, dst, i_out, src, i_in, matrix,
+                      i_frames );
+}
+
+static inline void SamplesAlawToS16( int16_t *dst, const uint8_t *src,
+                                     size_t i_samples )
+{
+    SAMPLES_DISPATCH( SamplesAlawToS16, dst, src, i_samples );
+}
+
+static inline void SamplesUlawToS16( int16_t *dst, const uint8_t *src,
+                                     size_t i_samples )
+{
+    SAMPLES_DISPATCH( SamplesUlawToS16, dst, src, i_samples );
+}
+
+static inline void SamplesS16ToAlaw( uint8_t *dst, const int16_t *src,
+                                     size_t i_samples )
+{
+    SAMPLES_DISPATCH( SamplesS16ToAlaw, dst, src, i_samples );
+}
+
+static inline void SamplesS16ToUlaw( uint8_t *dst, const int16_t *src,
+                                     size_t i_samples )
+{
+    SAMPLES_DISPATCH( SamplesS16ToUlaw, dst, src, i_samples );
+}
+
+#endif
@@ -0,0 +1,371 @@
+/*****************************************************************************
+ * samplebench.c : audio sample kernels benchmark plugin for vlc
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*****************************************************************************
+ * Preamble
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <math.h>
+
+#include <vlc_common.h>
+#include <vlc_plugin.h>
+#include <vlc_aout.h>
+#include <vlc_filter.h>
+#include <vlc_rand.h>
+
+#include "sample_kernels.h"
+
+/*****************************************************************************
+ * Local prototypes
+ *****************************************************************************/
+static int  Create ( vlc_object_t * );
+static void Destroy( vlc_object_t * );
+
+static block_t *Filter( filter_t *, block_t * );
+
+/*****************************************************************************
+ * Module descriptor
+ *****************************************************************************/
+
+#define LOOPS_TEXT N_("Number of runs of each kernel")
+#define LOOPS_LONGTEXT N_("The number of times each sample kernel is run " \
+                          "on the test buffer")
+
+#define SAMPLES_TEXT N_("Number of samples")
+#define SAMPLES_LONGTEXT N_("The number of samples (or frames for the " \
+                            "channel mixing kernels) in the test buffer")
+
+#define CFG_PREFIX "samplebench-"
+
+vlc_module_begin ()
+    set_description( N_("Audio sample kernels benchmark filter") )
+    set_shortname( N_("Samplebench") )
+    set_category( CAT_AUDIO )
+    set_subcategory( SUBCAT_AUDIO_AFILTER )
+    set_capability( "audio filter", 0 )
+
+    set_section( N_("Benchmarking"), NULL )
+    add_integer( CFG_PREFIX "loops", 1000, LOOPS_TEXT,
+                 LOOPS_LONGTEXT, false )
+    add_integer_with_range( CFG_PREFIX "samples", 65536, 16, 1 << 22,
+                            SAMPLES_TEXT, SAMPLES_LONGTEXT, false )
+
+    set_callbacks( Create, Destroy )
+vlc_module_end ()
+
+static const char *const ppsz_filter_options[] = {
+    "loops", "samples", NULL
+};
+
+/*****************************************************************************
+ * filter_sys_t: filter method descriptor
+ *****************************************************************************/
+typedef struct
+{
+    size_t   i_samples;
+    float   *p_fl32;  /* i_samples * SAMPLES_MIX_MAX_IN */
+    int16_t *p_s16;   /* i_samples */
+    int32_t *p_s32;   /* i_samples */
+    uint8_t *p_u8;    /* i_samples */
+} bench_input_t;
+
+struct filter_sys_t
+{
+    bool b_done;
+    int i_loops;
+    bench_input_t input;
+};
+
+/*****************************************************************************
+ * Kernels under test: each runs either the C or the dispatched version and
+ * returns the number of output bytes
+ *****************************************************************************/
+static const float mix_5_1_to_2_0[2 * 6] = {
+    1.f, 0.f, .7071f, 0.f, .7071f, 0.f,
+    0.f, 1.f, 0.f, .7071f, .7071f, 0.f,
+};
+
+static const float mix_7_1_to_5_1[6 * 8] = {
+    1.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f,
+    0.f, 1.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f,
+    0.f, 0.f, .5f, 0.f, .5f, 0.f, 0.f, 0.f,
+    0.f, 0.f, 0.f, .5f, 0.f, .5f, 0.f, 0.f,
+    0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f,
+    0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 1.f,
+};
+
+static size_t BenchGain( const bench_input_t *in, void *out, bool b_simd )
+{
+    const size_t i_size = in->i_samples * sizeof(float);
+    memcpy( out, in->p_fl32, i_size );
+    (b_simd ? SamplesGainFL32 : SamplesGainFL32C)( out, in->i_samples, .5f );
+    return i_size;
+}
+
+static size_t BenchS16ToFL32( const bench_input_t *in, void *out, bool b_simd )
+{
+    (b_simd ? SamplesS16ToFL32 : SamplesS16ToFL32C)( out, in->p_s16,
+                                                     in->i_samples );
+    return in->i_samples * sizeof(float);
+}
+
+static size_t BenchFL32ToS16( const bench_input_t *in, void *out, bool b_simd )
+{
+    (b_simd ? SamplesFL32ToS16 : SamplesFL32ToS16C)( out, in->p_fl32,
+                                                     in->i_samples );
+    return in->i_samples * sizeof(int16_t);
+}
+
+static size_t BenchS32ToFL32( const bench_input_t *in, void *out, bool b_simd )
+{
+    (b_simd ? SamplesS32ToFL32 : SamplesS32ToFL32C)( out, in->p_s32,
+                                                     in->i_samples );
+    return in->i_samples * sizeof(float);
+}
+
+static size_t BenchInterleave( const bench_input_t *in, void *out,
+                               bool b_simd )
+{
+    (b_simd ? SamplesInterleave2FL32 : SamplesInterleave2FL32C)( out,
+        in->p_fl32, in->p_fl32 + in->i_samples, in->i_samples );
+    return 2 * in->i_samples * sizeof(float);
+}
+
+static size_t BenchDeinterleave( const bench_input_t *in, void *out,
+                                 bool b_simd )
+{
+    float *p_out = out;
+    (b_simd ? SamplesDeinterleave2FL32 : SamplesDeinterleave2FL32C)( p_out,
+        p_out + in->i_samples, in->p_fl32, in->i_samples );
+    return 2 * in->i_samples * sizeof(float);
+}
+
+static size_t BenchMix51To20( const bench_input_t *in, void *out, bool b_simd )
+{
+    (b_simd ? SamplesMixFL32 : SamplesMixFL32C)( out, 2, in->p_fl32, 6,
+                                                 mix_5_1_to_2_0,
+                                                 in->i_samples );
+    return 2 * in->i_samples * sizeof(float);
+}
+
+static size_t BenchMix71To51( const bench_input_t *in, void *out, bool b_simd )
+{
+    (b_simd ? SamplesMixFL32 : SamplesMixFL32C)( out, 6, in->p_fl32, 8,
+                                                 mix_7_1_to_5_1,
+                                                 in->i_samples );
+    return 6 * in->i_samples * sizeof(float);
+}
+
+static size_t BenchAlawDecode( const bench_input_t *in, void *out,
+                               bool b_simd )
+{
+    (b_simd ? SamplesAlawToS16 : SamplesAlawToS16C)( out, in->p_u8,
+                                                     in->i_samples );
+    return in->i_samples * sizeof(int16_t);
+}
+
+static size_t BenchUlawDecode( const bench_input_t *in, void *out,
+                               bool b_simd )
+{
+    (b_simd ? SamplesUlawToS16 : SamplesUlawToS16C)( out, in->p_u8,
+                                                     in->i_samples );
+    return in->i_samples * sizeof(int16_t);
+}
+
+static size_t BenchAlawEncode( const bench_input_t *in, void *out,
+                               bool b_simd )
+{
+    (b_simd ? SamplesS16ToAlaw : SamplesS16ToAlawC)( out, in->p_s16,
+                                                     in->i_samples );
+    return in->i_samples;
+}
+
+static size_t BenchUlawEncode( const bench_input_t *in, void *out,
+                               bool b_simd )
+{
+    (b_simd ? SamplesS16ToUlaw : SamplesS16ToUlawC)( out, in->p_s16,
+                                                     in->i_samples );
+    return in->i_samples;
+}
+
+static const struct
+{
+    const char *psz_name;
+    size_t (*pf_run)( const bench_input_t *, void *, bool );
+    bool b_float; /* compared with a tolerance rather than bit for bit */
+} p_benchs[] = {
+    { "gain fl32",        BenchGain,         false },
+    { "s16 to fl32",      BenchS16ToFL32,    false },
+    { "fl32 to s16",      BenchFL32ToS16,    false },
+    { "s32 to fl32",      BenchS32ToFL32,    false },
+    { "interleave 2.0",   BenchInterleave,   false },
+    { "deinterleave 2.0", BenchDeinterleave, false },
+    { "mix 5.1 to 2.0",   BenchMix51To20,    true  },
+    { "mix 7.1 to 5.1",   BenchMix71To51,    true  },
+    { "a-law decode",     BenchAlawDecode,   false },
+    { "u-law decode",     BenchUlawDecode,   false },
+    { "a-law encode",     BenchAlawEncode,   false },
+    { "u-law encode",     BenchUlawEncode,   false },
+};
+
+static bool Compare( const void *p_ref, const void *p_test, size_t i_size,
+                     bool b_float )
+{
+    if( !b_float )
+        return !memcmp( p_ref, p_test, i_size );
+
+    const float *ref = p_ref, *test = p_test;
+    for( size_t i = 0; i < i_size / sizeof(float); i++ )
+        if( fabsf( ref[i] - test[i] ) > 1e-6f * (1.f + fabsf( ref[i] )) )
+            return false;
+    return true;
+}
+
+static void Benchmark( filter_t *p_filter )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+    const bench_input_t *in = &p_sys->input;
+    const size_t i_out = in->i_samples * SAMPLES_MIX_MAX_OUT * sizeof(float);
+    uint8_t *p_ref = malloc( i_out );
+    uint8_t *p_test = malloc( i_out );
+
+    if( unlikely(p_ref == NULL || p_test == NULL) )
+        goto out;
+
+    msg_Info( p_filter, "Running sample kernels on %zu samples, %d times, "
+              "with %s", in->i_samples, p_sys->i_loops, SamplesKernelsName() );
+
+    for( size_t i = 0; i < sizeof(p_benchs) / sizeof(p_benchs[0]); i++ )
+    {
+        mtime_t pi_time[2];
+
+        for( int j = 0; j < 2; j++ )
+        {
+            pi_time[j] = mdate();
+            for( int k = 0; k < p_sys->i_loops; k++ )
+                p_benchs[i].pf_run( in, j ? p_test : p_ref, j );
+            pi_time[j] = mdate() - pi_time[j];
+        }
+
+        /* Run once more from scratch, the in place kernels overwrote their
+         * output on every loop */
+        const size_t i_size = p_benchs[i].pf_run( in, p_ref, false );
+        p_benchs[i].pf_run( in, p_test, true );
+
+        msg_Info( p_filter, "%s: C %f sec, %s %f sec (%.2fx)",
+                  p_benchs[i].psz_name, (float)pi_time[0] / CLOCK_FREQ,
+                  SamplesKernelsName(), (float)pi_time[1] / CLOCK_FREQ,
+                  pi_time[1] ? (float)pi_time[0] / pi_time[1] : 0.f );
+        if( !Compare( p_ref, p_test, i_size, p_benchs[i].b_float ) )
+            msg_Err( p_filter, "%s: output differs from the C version",
+                     p_benchs[i].psz_name );
+    }
+out:
+    free( p_test );
+    free( p_ref );
+}
+
+/*****************************************************************************
+ * Create: allocates the test buffers
+ *****************************************************************************/
+static int Create( vlc_object_t *p_this )
+{
+    filter_t *p_filter = (filter_t *)p_this;
+    filter_sys_t *p_sys;
+
+    /* Allocate structure */
+    p_filter->p_sys = p_sys = malloc( sizeof(filter_sys_t) );
+    if( p_sys == NULL )
+        return VLC_ENOMEM;
+
+    p_sys->b_done = false;
+
+    /* needed to get options passed in transcode using the
+     * samplebench{name=value} syntax */
+    config_ChainParse( p_filter, CFG_PREFIX, ppsz_filter_options,
+                       p_filter->p_cfg );
+
+    p_sys->i_loops = var_CreateGetIntegerCommand( p_filter,
+                                                  CFG_PREFIX "loops" );
+
+    bench_input_t *in = &p_sys->input;
+    const size_t n = var_CreateGetIntegerCommand( p_filter,
+                                                  CFG_PREFIX "samples" );
+    in->i_samples = n;
+    in->p_fl32 = malloc( n * SAMPLES_MIX_MAX_IN * sizeof(float) );
+    in->p_s16 = malloc( n * sizeof(int16_t) );
+    in->p_s32 = malloc( n * sizeof(int32_t) );
+    in->p_u8 = malloc( n );
+    if( unlikely(in->p_fl32 == NULL || in->p_s16 == NULL ||
+                 in->p_s32 == NULL || in->p_u8 == NULL) )
+    {
+        Destroy( p_this );
+        return VLC_ENOMEM;
+    }
+
+    /* The odd multiplier walks all 16-bits values every 65536 samples, the
+     * float samples overshoot [-1, 1] to exercise clipping */
+    for( size_t i = 0; i < n; i++ )
+    {
+        in->p_s16[i] = (uint16_t)(i * 40503);
+        in->p_s32[i] = vlc_mrand48();
+        in->p_u8[i] = i;
+    }
+    for( size_t i = 0; i < n * SAMPLES_MIX_MAX_IN; i++ )
+        in->p_fl32[i] = (int16_t)(i * 40503) / 29789.f;
+
+    p_filter->pf_audio_filter = Filter;
+
+    return VLC_SUCCESS;
+}
+
+/*****************************************************************************
+ * Destroy: releases the test buffers
+ *****************************************************************************/
+static void Destroy( vlc_object_t *p_this )
+{
+    filter_t *p_filter = (filter_t *)p_this;
+    filter_sys_t *p_sys = p_filter->p_sys;
+
+    free( p_sys->input.p_fl32 );
+    free( p_sys->input.p_s16 );
+    free( p_sys->input.p_s32 );
+    free( p_sys->input.p_u8 );
+    free( p_sys );
+}
+
+/*****************************************************************************
+ * Filter: runs the benchmark once and lets the audio through
+ *****************************************************************************/
+static block_t *Filter( filter_t *p_filter, block_t *p_block )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+
+    if( !p_sys->b_done )
+    {
+        Benchmark( p_filter );
+        p_sys->b_done = true;
+    }
+    return p_block;
+}
@@ -35,6 +35,8 @@
 #include <vlc_aout.h>
 #include <vlc_aout_volume.h>
 
+#include "../audio_filter/sample_kernels.h"
+
 /*****************************************************************************
  * Local prototypes
  *****************************************************************************/
@@ -61,8 +63,7 @@ static void FilterFL32( audio_volume_t *p_volume, block_t *p_buffer,
         return; /* nothing to do */
 
     float *p = (float *)p_buffer->p_buffer;
-    for( size_t i = p_buffer->i_buffer / sizeof(*p); i > 0; i-- )
-        *(p++) *= f_multiplier;
+    SamplesGainFL32( p, p_buffer->i_buffer / sizeof(*p), f_multiplier );
 
     (void) p_volume;
 }
@@ -58,10 +58,22 @@ struct decoder_sys_t
     bool b_hurry_up;
     enum AVDiscard i_skip_frame;
     enum AVDiscard i_skip_idct;
-
-    /* how many decoded frames are late */
-    int     i_late_frames;
-    mtime_t i_late_frames_start;
+    enum AVDiscard i_skip_loop_filter;
+
+    /* adaptive decode skipping, see SkipUpdate() */
+    int     i_skip_level;
+    mtime_t i_skip_date;        /* last level change */
+    bool    b_skip_lowered;     /* the last change lowered the level */
+    mtime_t i_skip_lower_delay; /* comfort needed before skipping less */
+    mtime_t i_late_since;       /* start of the current late run, or 0 */
+    mtime_t i_early_since;      /* start of the current comfortable run, or 0 */
+    bool    b_skip_primed;
+    mtime_t i_decode_time;      /* smoothed decoding time per frame */
+    mtime_t i_last_sample;      /* last call to SkipUpdate() */
+    mtime_t i_busy_start;       /* frame threads: start of the current call */
+    mtime_t i_busy_time;        /* time spent decoding since the last frame */
+    unsigned i_busy_frames;     /* frames fed since the last frame */
+    mtime_t i_slack;            /* smoothed time left before display */
 
     /* for direct rendering */
     bool b_direct_rendering;
@@ -89,6 +101,21 @@ struct decoder_sys_t
     vlc_sem_t sem_mt;
 };
 
+/* Decode skipping levels, each one adds to the previous ones */
+enum
+{
+    SKIP_LEVEL_NONE,
+    SKIP_LEVEL_LOOP_FILTER, /* no deblocking, except on key frames */
+    SKIP_LEVEL_NONREF,      /* drop non-reference frames */
+    SKIP_LEVEL_BIDIR,       /* drop all B-frames */
+    SKIP_LEVEL_NONKEY,      /* drop everything until the next key frame */
+};
+
+#define SKIP_RAISE_DELAY     INT64_C(500000)   /* lateness before skipping more */
+#define SKIP_LOWER_DELAY     INT64_C(2000000)  /* comfort before skipping less */
+#define SKIP_LOWER_DELAY_MAX INT64_C(32000000)
+#define SKIP_MARGIN          INT64_C(40000)
+
 #ifdef HAVE_AVCODEC_MT
 #   define wait_mt(s) vlc_sem_wait( &s->sem_mt )
 #   define post_mt(s) vlc_sem_post( &s->sem_mt )
@@ -264,6 +291,7 @@ int InitVideoDec( decoder_t *p_dec, AVCodecContext *p_context,
     else if( i_val == 3 ) p_sys->p_context->skip_loop_filter = AVDISCARD_NONKEY;
     else if( i_val == 2 ) p_sys->p_context->skip_loop_filter = AVDISCARD_BIDIR;
     else if( i_val == 1 ) p_sys->p_context->skip_loop_filter = AVDISCARD_NONREF;
+    p_sys->i_skip_loop_filter = p_sys->p_context->skip_loop_filter;
 
     if( var_CreateGetBool( p_dec, "avcodec-fast" ) )
         p_sys->p_context->flags2 |= CODEC_FLAG2_FAST;
@@ -386,7 +414,24 @@ int InitVideoDec( decoder_t *p_dec, AVCodecContext *p_context,
     p_sys->b_has_b_frames = false;
     p_sys->b_first_frame = true;
     p_sys->b_flush = false;
-    p_sys->i_late_frames = 0;
+    p_sys->i_skip_level = SKIP_LEVEL_NONE;
+    p_sys->i_skip_date = 0;
+    p_sys->b_skip_lowered = false;
+    p_sys->i_skip_lower_delay = SKIP_LOWER_DELAY;
+    p_sys->i_late_since = 0;
+    p_sys->i_early_since = 0;
+    p_sys->b_skip_primed = false;
+    p_sys->i_decode_time = 0;
+    p_sys->i_last_sample = 0;
+    p_sys->i_busy_start = 0;
+    p_sys->i_busy_time = 0;
+    p_sys->i_busy_frames = 0;
+    p_sys->i_slack = 0;
+
+    /* Controller state, for monitoring */
+    var_Create( p_dec, "avcodec-skip-level", VLC_VAR_INTEGER );
+    var_Create( p_dec, "avcodec-decode-time", VLC_VAR_INTEGER );
+    var_Create( p_dec, "avcodec-display-slack", VLC_VAR_INTEGER );
 
     /* Set output properties */
     p_dec->fmt_out.i_cat = VIDEO_ES;
@@ -458,15 +503,153 @@ int InitVideoDec( decoder_t *p_dec, AVCodecContext *p_context,
     return VLC_SUCCESS;
 }
 
+/*****************************************************************************
+ * SkipSetLevel/SkipUpdate: adaptive decode skipping
+ *****************************************************************************
+ * The time spent decoding each frame is compared with the time left before
+ * it is due for display. With frame threads, avcodec_decode_video2() returns
+ * as soon as the frame is queued, so the time spent in DecodeVideo() between
+ * two output frames, divided by the frames fed meanwhile, is used instead.
+ * When frames come out too close to (or past) their
+ * deadline for a while, the decoder skips more work; when there is ample time
+ * left for a longer while, it skips less. Each time skipping less has to be
+ * undone soon after, the next attempt waits longer, so that an overloaded
+ * decoder settles on one level instead of oscillating.
+ *****************************************************************************/
+static void SkipSetLevel( decoder_t *p_dec, int i_level )
+{
+    decoder_sys_t *p_sys = p_dec->p_sys;
+    AVCodecContext *p_context = p_sys->p_context;
+    const mtime_t i_now = mdate();
+
+    p_context->skip_loop_filter = p_sys->i_skip_loop_filter;
+    p_context->skip_frame = p_sys->i_skip_frame;
+
+    if( i_level >= SKIP_LEVEL_LOOP_FILTER )
+        p_context->skip_loop_filter = __MAX( p_sys->i_skip_loop_filter,
+                                             AVDISCARD_NONKEY );
+    if( i_level >= SKIP_LEVEL_NONREF )
+        p_context->skip_frame = __MAX( p_sys->i_skip_frame, AVDISCARD_NONREF );
+    if( i_level >= SKIP_LEVEL_BIDIR )
+        p_context->skip_frame = __MAX( p_sys->i_skip_frame, AVDISCARD_BIDIR );
+    if( i_level >= SKIP_LEVEL_NONKEY )
+        p_context->skip_frame = __MAX( p_sys->i_skip_frame, AVDISCARD_NONKEY );
+
+    if( i_level > p_sys->i_skip_level )
+    {
+        /* Skipping less did not last: be more patient next time */
+        if( p_sys->b_skip_lowered &&
+            i_now - p_sys->i_skip_date < p_sys->i_skip_lower_delay )
+            p_sys->i_skip_lower_delay = __MIN( 2 * p_sys->i_skip_lower_delay,
+                                               SKIP_LOWER_DELAY_MAX );
+        else
+            p_sys->i_skip_lower_delay = __MAX( p_sys->i_skip_lower_delay / 2,
+                                               SKIP_LOWER_DELAY );
+    }
+
+    msg_Dbg( p_dec, "decode skip level %d -> %d (decoding %"PRId64
+             " us, %"PRId64" us before display)", p_sys->i_skip_level,
+             i_level, p_sys->i_decode_time, p_sys->i_slack );
+
+    p_sys->b_skip_lowered = i_level < p_sys->i_skip_level;
+    p_sys->i_skip_level = i_level;
+    p_sys->i_skip_date = i_now;
+    p_sys->i_late_since = 0;
+    p_sys->i_early_since = 0;
+    var_SetInteger( p_dec, "avcodec-skip-level", i_level );
+}
+
+static void SkipUpdate( decoder_t *p_dec, mtime_t i_display_date,
+                        mtime_t i_decode_time )
+{
+    decoder_sys_t *p_sys = p_dec->p_sys;
+    const mtime_t i_now = mdate();
+    const mtime_t i_slack = i_display_date - i_now;
+
+    if( !p_sys->b_skip_primed )
+    {
+        p_sys->i_decode_time = i_decode_time;
+        p_sys->i_slack = i_slack;
+        p_sys->b_skip_primed = true;
+    }
+    else
+    {
+        p_sys->i_decode_time += (i_decode_time - p_sys->i_decode_time) / 8;
+        p_sys->i_slack += (i_slack - p_sys->i_slack) / 8;
+    }
+    p_sys->i_last_sample = i_now;
+    var_SetInteger( p_dec, "avcodec-decode-time", p_sys->i_decode_time );
+    var_SetInteger( p_dec, "avcodec-display-slack", p_sys->i_slack );
+
+    /* Late: the next frame would not make it in time either */
+    if( p_sys->i_slack < p_sys->i_decode_time )
+    {
+        if( p_sys->i_late_since == 0 )
+            p_sys->i_late_since = i_now;
+    }
+    else
+        p_sys->i_late_since = 0;
+
+    /* Comfortable: a few frames could be decoded in the time left */
+    if( p_sys->i_slack > 4 * p_sys->i_decode_time + SKIP_MARGIN )
+    {
+        if( p_sys->i_early_since == 0 )
+            p_sys->i_early_since = i_now;
+    }
+    else
+        p_sys->i_early_since = 0;
+
+    if( p_sys->i_late_since != 0 &&
+        p_sys->i_skip_level < SKIP_LEVEL_NONKEY &&
+        i_now - p_sys->i_late_since >= SKIP_RAISE_DELAY &&
+        i_now - p_sys->i_skip_date >= SKIP_RAISE_DELAY )
+        SkipSetLevel( p_dec, p_sys->i_skip_level + 1 );
+    else if( p_sys->i_early_since != 0 &&
+             p_sys->i_skip_level > SKIP_LEVEL_NONE &&
+             i_now - p_sys->i_early_since >= p_sys->i_skip_lower_delay )
+        SkipSetLevel( p_dec, p_sys->i_skip_level - 1 );
+}
+
+/* Skips less when no frame came out for a while to measure anything */
+static void SkipCheckIdle( decoder_t *p_dec )
+{
+    decoder_sys_t *p_sys = p_dec->p_sys;
+    const mtime_t i_now = mdate();
+
+    if( p_sys->i_skip_level > SKIP_LEVEL_NONE &&
+        i_now - p_sys->i_last_sample >= p_sys->i_skip_lower_delay &&
+        i_now - p_sys->i_skip_date >= p_sys->i_skip_lower_delay )
+    {
+        p_sys->b_skip_primed = false;
+        SkipSetLevel( p_dec, p_sys->i_skip_level - 1 );
+    }
+}
+
 /*****************************************************************************
  * DecodeVideo: Called to decode one or more frames
  *****************************************************************************/
+static picture_t *DecodeBlock( decoder_t *, block_t ** );
+
 picture_t *DecodeVideo( decoder_t *p_dec, block_t **pp_block )
+{
+    decoder_sys_t *p_sys = p_dec->p_sys;
+
+    if( p_sys->b_hurry_up )
+        SkipCheckIdle( p_dec );
+
+    p_sys->i_busy_start = mdate();
+    picture_t *p_pic = DecodeBlock( p_dec, pp_block );
+    p_sys->i_busy_time += mdate() - p_sys->i_busy_start;
+    return p_pic;
+}
+
+static picture_t *DecodeBlock( decoder_t *p_dec, block_t **pp_block )
 {
     decoder_sys_t *p_sys = p_dec->p_sys;
     AVCodecContext *p_context = p_sys->p_context;
     int b_drawpicture;
     block_t *p_block;
+    mtime_t i_decode_time = 0;
 
     if( !pp_block )
         return NULL;
@@ -498,7 +681,12 @@ picture_t *DecodeVideo( decoder_t *p_dec, block_t **pp_block )
         {
             p_sys->i_pts = VLC_TS_INVALID; /* To make sure we recover properly */
 
-            p_sys->i_late_frames = 0;
+            /* Keep the skip level, but measure again from scratch */
+            p_sys->b_skip_primed = false;
+            p_sys->i_busy_time = 0;
+            p_sys->i_busy_frames = 0;
+            p_sys->i_late_since = 0;
+            p_sys->i_early_since = 0;
 
             post_mt( p_sys );
             if( p_block->i_flags & BLOCK_FLAG_DISCONTINUITY )
@@ -514,62 +702,19 @@ picture_t *DecodeVideo( decoder_t *p_dec, block_t **pp_block )
             /* Do not care about late frames when prerolling
              * TODO avoid decoding of non reference frame
              * (ie all B except for H264 where it depends only on nal_ref_idc) */
-            p_sys->i_late_frames = 0;
+            p_sys->i_late_since = 0;
         }
     }
 
-    if( !p_dec->b_pace_control && (p_sys->i_late_frames > 0) &&
-        (mdate() - p_sys->i_late_frames_start > INT64_C(5000000)) )
-    {
-        if( p_sys->i_pts > VLC_TS_INVALID )
-        {
-            p_sys->i_pts = VLC_TS_INVALID; /* To make sure we recover properly */
-        }
-        if( p_block )
-            block_Release( p_block );
-        p_sys->i_late_frames--;
-        msg_Err( p_dec, "more than 5 seconds of late video -> "
-                 "dropping frame (computer too slow ?)" );
-        return NULL;
-    }
-
-    /* A good idea could be to decode all I pictures and see for the other */
-    if( !p_dec->b_pace_control &&
-        p_sys->b_hurry_up &&
-        (p_sys->i_late_frames > 4) )
-    {
-        b_drawpicture = 0;
-        if( p_sys->i_late_frames < 12 )
-        {
-            p_context->skip_frame =
-                    (p_sys->i_skip_frame <= AVDISCARD_NONREF) ?
-                    AVDISCARD_NONREF : p_sys->i_skip_frame;
-        }
-        else
-        {
-            /* picture too late, won't decode
-             * but break picture until a new I, and for mpeg4 ...*/
-            p_sys->i_late_frames--; /* needed else it will never be decrease */
-            if( p_block )
-                block_Release( p_block );
-            msg_Warn( p_dec, "More than 4 late frames, dropping frame" );
-            return NULL;
-        }
-    }
+    if( !p_block || !(p_block->i_flags & BLOCK_FLAG_PREROLL) )
+        b_drawpicture = 1;
     else
-    {
-        if( p_sys->b_hurry_up )
-            p_context->skip_frame = p_sys->i_skip_frame;
-        if( !p_block || !(p_block->i_flags & BLOCK_FLAG_PREROLL) )
-            b_drawpicture = 1;
-        else
-            b_drawpicture = 0;
-    }
+        b_drawpicture = 0;
 
     if( p_context->width <= 0 || p_context->height <= 0 )
     {
-        if( p_sys->b_hurry_up )
-            p_context->skip_frame = p_sys->i_skip_frame;
+        if( p_sys->b_hurry_up && p_sys->i_skip_level != SKIP_LEVEL_NONE )
+            SkipSetLevel( p_dec, SKIP_LEVEL_NONE );
     }
     else if( !b_drawpicture )
     {
@@ -642,8 +787,12 @@ picture_t *DecodeVideo( decoder_t *p_dec, block_t **pp_block )
             p_block->i_dts = VLC_TS_INVALID;
         }
 
+        if( pkt.size > 0 )
+            p_sys->i_busy_frames++;
+        const mtime_t i_decode_start = mdate();
         i_used = avcodec_decode_video2( p_context, p_sys->p_ff_pic,
                                        &b_gotpicture, &pkt );
+        i_decode_time += mdate() - i_decode_start;
 
         wait_mt( p_sys );
 
@@ -744,21 +893,35 @@ picture_t *DecodeVideo( decoder_t *p_dec, block_t **pp_block )
             }
         }
 
-        /* Update frame late count (except when doing preroll) */
-        mtime_t i_display_date = 0;
-        if( !p_block || !(p_block->i_flags & BLOCK_FLAG_PREROLL) )
-            i_display_date = decoder_GetDisplayDate( p_dec, i_pts );
-
-        if( i_display_date > 0 && i_display_date <= mdate() )
+#ifdef HAVE_AVCODEC_MT
+        if( p_context->thread_type & FF_THREAD_FRAME )
         {
-            p_sys->i_late_frames++;
-            if( p_sys->i_late_frames == 1 )
-                p_sys->i_late_frames_start = mdate();
+            /* Time spent in DecodeVideo() per frame fed since the last
+             * output frame, skipped frames included; waiting for input
+             * happens outside of it and does not count */
+            const mtime_t i_now = mdate();
+
+            p_sys->i_busy_time += i_now - p_sys->i_busy_start;
+            p_sys->i_busy_start = i_now;
+            if( p_sys->i_busy_frames > 0 )
+                i_decode_time = p_sys->i_busy_time / p_sys->i_busy_frames;
+            else
+                i_decode_time = -1;
         }
-        else
+#endif
+        p_sys->i_busy_time = 0;
+        p_sys->i_busy_frames = 0;
+
+        /* Adapt decode skipping to the time left (except when doing
+         * preroll) */
+        if( p_sys->b_hurry_up && !p_dec->b_pace_control && i_decode_time >= 0 &&
+            ( !p_block || !(p_block->i_flags & BLOCK_FLAG_PREROLL) ) )
         {
-            p_sys->i_late_frames = 0;
+            mtime_t i_display_date = decoder_GetDisplayDate( p_dec, i_pts );
+            if( i_display_date > 0 )
+                SkipUpdate( p_dec, i_display_date, i_decode_time );
         }
+        i_decode_time = 0;
 
         if( !b_drawpicture || ( !p_sys->p_va && !p_sys->p_ff_pic->linesize[0] ) )
             continue;
@@ -42,6 +42,7 @@
 #include <vlc_charset.h>   /* FromCharset, for EIT */
 
 #include "../mux/mpeg/csa.h"
+#include "../mux/mpeg/tssync.h"
 
 /* Include dvbpsi headers */
 # include <dvbpsi/dvbpsi.h>
@@ -222,6 +223,7 @@ typedef struct
     /* For PMT */
     int             i_prg;
     ts_prg_psi_t    **prg;
+    bool            b_has_es; /* some ES PID is owned by this PMT */
 
 } ts_psi_t;
 
@@ -244,8 +246,8 @@ typedef struct
     ts_es_data_type_t data_type;
     int         i_data_size;
     int         i_data_gathered;
-    block_t     *p_data;
-    block_t     **pp_last;
+    block_t     *p_data;    /* unit being gathered, in a single block */
+    size_t      i_data_alloc; /* allocation hint for the next unit */
 
     es_mpeg4_descriptor_t *p_mpeg4desc;
 
@@ -259,6 +261,8 @@ typedef struct
     bool        b_valid;
     int         i_cc;   /* countinuity counter */
     bool        b_scrambled;
+    bool        b_pcr;      /* carries the PCR of a program */
+    bool        b_filter;   /* selected in the access PID filter */
 
     /* PSI owner (ie PMT -> PAT, ES -> PMT */
     ts_psi_t   *p_owner;
@@ -287,6 +291,11 @@ struct demux_sys_t
     /* how many TS packet we read at once */
     int         i_ts_read;
 
+    /* Packets read from the stream at once and demuxed in place */
+    block_t     *p_chunk;
+    int64_t     i_chunk_end; /* stream position right after p_chunk */
+    int         i_chunk_packets;
+
     /* to determine length and time */
     int         i_pid_ref_pcr;
     mtime_t     i_first_pcr;
@@ -300,6 +309,10 @@ struct demux_sys_t
     /* All pid */
     ts_pid_t    pid[8192];
 
+    /* What to do with the packets of each pid, see UpdatePIDDispatch() */
+    uint8_t     dispatch[8192];
+    bool        b_dispatch_dirty; /* PAT, PMT or program selection changed */
+
     /* All PMT */
     bool        b_user_pmt;
     int         i_pmt;
@@ -351,19 +364,20 @@ static void PSINewTableCallBack( demux_t *, dvbpsi_handle,
 
 static int ChangeKeyCallback( vlc_object_t *, char const *, vlc_value_t, vlc_value_t, void * );
 
-static inline int PIDGet( block_t *p )
+static inline int PIDGet( const uint8_t *p )
 {
-    return ( (p->p_buffer[1]&0x1f)<<8 )|p->p_buffer[2];
+    return ( (p[1]&0x1f)<<8 )|p[2];
 }
 
-static bool GatherData( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk );
+static bool GatherData( demux_t *p_demux, ts_pid_t *pid, uint8_t *p );
 
 static block_t* ReadTSPacket( demux_t *p_demux );
+static uint8_t* NextTSPacket( demux_t *p_demux );
 static int Seek( demux_t *p_demux, double f_percent );
 static void GetFirstPCR( demux_t *p_demux );
 static void GetLastPCR( demux_t *p_demux );
 static void CheckPCR( demux_t *p_demux );
-static void PCRHandle( demux_t *p_demux, ts_pid_t *, block_t * );
+static void PCRHandle( demux_t *p_demux, ts_pid_t *, const uint8_t * );
 
 static void              IODFree( iod_descriptor_t * );
 
@@ -371,6 +385,8 @@ static void              IODFree( iod_descriptor_t * );
 static int UserPmt( demux_t *p_demux, const char * );
 
 static int  SetPIDFilter( demux_t *, int i_pid, bool b_selected );
+static void UpdatePIDDispatch( demux_t * );
+static bool ProgramIsSelected( demux_t *, uint16_t i_pgrm );
 static void SetPrgFilter( demux_t *, int i_prg, bool b_selected );
 
 #define TS_PACKET_SIZE_188 188
@@ -378,6 +394,22 @@ static void SetPrgFilter( demux_t *, int i_prg, bool b_selected );
 #define TS_PACKET_SIZE_204 204
 #define TS_PACKET_SIZE_MAX 204
 
+/* Per pid handling in the Demux() loop */
+enum
+{
+    TS_PID_DROP = 0,    /* not selected, no PCR */
+    TS_PID_NEW,         /* unknown and never seen */
+    TS_PID_PCR,         /* not selected, only its PCR is used */
+    TS_PID_PSI,         /* PAT and DVB SI tables */
+    TS_PID_PMT,         /* PMT, of one or more programs */
+    TS_PID_ES,          /* elementary stream of a selected program */
+};
+
+/* TS packets read at once from inputs that can be paced (files) */
+#define TS_CHUNK_PACKETS 64
+/* Live inputs deliver 7 packets per datagram: do not wait for more */
+#define TS_CHUNK_PACKETS_LIVE 7
+
 static int DetectPacketSize( demux_t *p_demux, int *pi_header_size )
 {
     const uint8_t *p_peek;
@@ -456,42 +488,32 @@ static int DetectPacketSize( demux_t *p_demux, int *pi_header_size )
         return TS_PACKET_SIZE_188;
     }
 
-    for( int i_sync = 0; i_sync < TS_PACKET_SIZE_MAX; i_sync++ )
-    {
-        if( p_peek[i_sync] != 0x47 )
-            continue;
+    /* Look for 4 sync bytes in a row, at any of the supported strides */
+    const int i_peek = stream_Peek( p_demux->s, &p_peek,
+                                    TS_PACKET_SIZE_MAX * 4 );
 
-        /* Check next 3 sync bytes */
-        int i_peek = TS_PACKET_SIZE_MAX * 3 + i_sync + 1;
-        if( ( stream_Peek( p_demux->s, &p_peek, i_peek ) ) < i_peek )
-        {
-            msg_Err( p_demux, "cannot peek" );
-            return -1;
-        }
-        if( p_peek[i_sync + 1 * TS_PACKET_SIZE_188] == 0x47 &&
-            p_peek[i_sync + 2 * TS_PACKET_SIZE_188] == 0x47 &&
-            p_peek[i_sync + 3 * TS_PACKET_SIZE_188] == 0x47 )
-        {
-            return TS_PACKET_SIZE_188;
-        }
-        else if( p_peek[i_sync + 1 * TS_PACKET_SIZE_192] == 0x47 &&
-                 p_peek[i_sync + 2 * TS_PACKET_SIZE_192] == 0x47 &&
-                 p_peek[i_sync + 3 * TS_PACKET_SIZE_192] == 0x47 )
-        {
-            if( i_sync == 4 )
-            {
-                *pi_header_size = 4; /* BluRay TS packets have 4-byte header */
-            }
-            return TS_PACKET_SIZE_192;
-        }
-        else if( p_peek[i_sync + 1 * TS_PACKET_SIZE_204] == 0x47 &&
-                 p_peek[i_sync + 2 * TS_PACKET_SIZE_204] == 0x47 &&
-                 p_peek[i_sync + 3 * TS_PACKET_SIZE_204] == 0x47 )
+    static const int pi_sizes[] = { TS_PACKET_SIZE_188, TS_PACKET_SIZE_192,
+                                    TS_PACKET_SIZE_204 };
+    int i_size = -1;
+    ssize_t i_sync = TS_PACKET_SIZE_MAX;
+    for( unsigned i = 0; i < sizeof(pi_sizes)/sizeof(*pi_sizes); i++ )
+    {
+        /* Only consider the offsets within the first packet */
+        ssize_t i_found = TsSyncFind( p_peek,
+                        __MIN( i_peek, TS_PACKET_SIZE_MAX + 3 * pi_sizes[i] ),
+                        pi_sizes[i], 4 );
+        if( i_found >= 0 && i_found < i_sync )
         {
-            return TS_PACKET_SIZE_204;
+            i_sync = i_found;
+            i_size = pi_sizes[i];
         }
     }
 
+    if( i_size == TS_PACKET_SIZE_192 && i_sync == 4 )
+        *pi_header_size = 4; /* BluRay TS packets have 4-byte header */
+    if( i_size > 0 )
+        return i_size;
+
     if( p_demux->b_force )
     {
         msg_Warn( p_demux, "this does not look like a TS stream, continuing" );
@@ -592,9 +614,16 @@ static int Open( vlc_object_t *p_this )
     }
     /* PID 8191 is padding */
     p_sys->pid[8191].b_seen = true;
+    p_sys->b_dispatch_dirty = true;
     p_sys->i_packet_size = i_packet_size;
     p_sys->i_packet_header_size = i_packet_header_size;
     p_sys->i_ts_read = 50;
+    p_sys->p_chunk = NULL;
+    bool b_can_pace;
+    if( stream_Control( p_demux->s, STREAM_CAN_CONTROL_PACE, &b_can_pace ) )
+        b_can_pace = false;
+    p_sys->i_chunk_packets = b_can_pace ? TS_CHUNK_PACKETS
+                                        : TS_CHUNK_PACKETS_LIVE;
     p_sys->csa = NULL;
     p_sys->b_start_record = false;
 
@@ -867,6 +896,9 @@ static void Close( vlc_object_t *p_this )
     free( p_sys->p_pcrs );
     free( p_sys->p_pos );
 
+    if( p_sys->p_chunk )
+        block_Release( p_sys->p_chunk );
+
     vlc_mutex_destroy( &p_sys->csa_lock );
     free( p_sys );
 }
@@ -905,8 +937,8 @@ static int Demux( demux_t *p_demux )
     for( int i_pkt = 0; i_pkt < p_sys->i_ts_read; i_pkt++ )
     {
         bool         b_frame = false;
-        block_t     *p_pkt;
-        if( !(p_pkt = ReadTSPacket( p_demux )) )
+        uint8_t     *p_pkt;
+        if( !(p_pkt = NextTSPacket( p_demux )) )
         {
             return 0;
         }
@@ -918,43 +950,49 @@ static int Demux( demux_t *p_demux )
             p_sys->b_start_record = false;
         }
 
+        if( unlikely(p_sys->b_dispatch_dirty) )
+            UpdatePIDDispatch( p_demux );
+
         /* Parse the TS packet */
-        ts_pid_t *p_pid = &p_sys->pid[PIDGet( p_pkt )];
+        const int i_pid = PIDGet( p_pkt );
+        ts_pid_t *p_pid = &p_sys->pid[i_pid];
 
-        if( p_pid->b_valid )
-        {
-            if( p_pid->psi )
-            {
-                if( p_pid->i_pid == 0 || ( p_sys->b_dvb_meta && ( p_pid->i_pid == 0x11 || p_pid->i_pid == 0x12 || p_pid->i_pid == 0x14 ) ) )
-                {
-                    dvbpsi_PushPacket( p_pid->psi->handle, p_pkt->p_buffer );
-                }
-                else
-                {
-                    for( int i_prg = 0; i_prg < p_pid->psi->i_prg; i_prg++ )
-                    {
-                        dvbpsi_PushPacket( p_pid->psi->prg[i_prg]->handle,
-                                           p_pkt->p_buffer );
-                    }
-                }
-                block_Release( p_pkt );
-            }
-            else
-            {
-                b_frame = GatherData( p_demux, p_pid, p_pkt );
-            }
-        }
-        else
+        switch( p_sys->dispatch[i_pid] )
         {
-            if( !p_pid->b_seen )
-            {
-                msg_Dbg( p_demux, "pid[%d] unknown", p_pid->i_pid );
-            }
+        case TS_PID_DROP:
+            break;
+
+        case TS_PID_NEW:
+            msg_Dbg( p_demux, "pid[%d] unknown", i_pid );
+            p_pid->b_seen = true;
+            p_sys->dispatch[i_pid] = p_pid->b_pcr ? TS_PID_PCR : TS_PID_DROP;
             /* We have to handle PCR if present */
             PCRHandle( p_demux, p_pid, p_pkt );
-            block_Release( p_pkt );
+            break;
+
+        case TS_PID_PCR:
+            PCRHandle( p_demux, p_pid, p_pkt );
+            break;
+
+        case TS_PID_PSI:
+            p_pid->b_seen = true;
+            dvbpsi_PushPacket( p_pid->psi->handle, p_pkt );
+            break;
+
+        case TS_PID_PMT:
+            p_pid->b_seen = true;
+            for( int i_prg = 0; i_prg < p_pid->psi->i_prg; i_prg++ )
+            {
+                dvbpsi_PushPacket( p_pid->psi->prg[i_prg]->handle,
+                                   p_pkt );
+            }
+            break;
+
+        case TS_PID_ES:
+            p_pid->b_seen = true;
+            b_frame = GatherData( p_demux, p_pid, p_pkt );
+            break;
         }
-        p_pid->b_seen = true;
 
         if( b_frame || ( b_wait_es && p_sys->i_pmt_es > 0 ) )
             break;
@@ -1093,6 +1131,7 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
 
         if( i_int == 0 && p_sys->i_current_program > 0 )
             i_int = p_sys->i_current_program;
+        p_sys->b_dispatch_dirty = true;
 
         if( p_sys->i_current_program > 0 )
         {
@@ -1321,12 +1360,139 @@ error:
 static int SetPIDFilter( demux_t *p_demux, int i_pid, bool b_selected )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
+    ts_pid_t *pid = &p_sys->pid[i_pid];
 
     if( !p_sys->b_access_control )
         return VLC_EGENERIC;
+    if( pid->b_filter == b_selected )
+        return VLC_SUCCESS;
+
+    if( stream_Control( p_demux->s, STREAM_SET_PRIVATE_ID_STATE,
+                        i_pid, b_selected ) )
+        return VLC_EGENERIC;
+    pid->b_filter = b_selected;
+    return VLC_SUCCESS;
+}
+
+/**
+ * Rebuilds the per pid dispatch table used by Demux(), and pushes the
+ * resulting selection down to the access PID filter.
+ * It must be called whenever the PAT, a PMT or the program selection has
+ * changed, so that the packet loop does not have to look at the PSI.
+ */
+static void UpdatePIDDispatch( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    p_sys->b_dispatch_dirty = false;
+
+    for( int i = 0; i < 8192; i++ )
+        p_sys->pid[i].b_pcr = false;
+    if( p_sys->i_pid_ref_pcr >= 0 && p_sys->i_pid_ref_pcr < 8192 )
+        p_sys->pid[p_sys->i_pid_ref_pcr].b_pcr = true;
+
+    for( int i = 0; i < p_sys->i_pmt; i++ )
+    {
+        ts_psi_t *psi = p_sys->pmt[i]->psi;
+
+        psi->b_has_es = false;
+        for( int i_prg = 0; i_prg < psi->i_prg; i_prg++ )
+        {
+            const int i_pid_pcr = psi->prg[i_prg]->i_pid_pcr;
+            if( i_pid_pcr > 0 && i_pid_pcr < 8192 )
+                p_sys->pid[i_pid_pcr].b_pcr = true;
+        }
+    }
+
+    for( int i = 0; i < 8192; i++ )
+    {
+        ts_pid_t *pid = &p_sys->pid[i];
+        bool b_selected = false;
+        uint8_t i_dispatch;
+
+        if( !pid->b_valid )
+        {
+            if( !pid->b_seen )
+                i_dispatch = TS_PID_NEW;
+            else
+                i_dispatch = pid->b_pcr ? TS_PID_PCR : TS_PID_DROP;
+        }
+        else if( pid->psi )
+        {
+            if( i == 0 || ( p_sys->b_dvb_meta &&
+                            ( i == 0x11 || i == 0x12 || i == 0x14 ) ) )
+                i_dispatch = TS_PID_PSI;
+            else
+                i_dispatch = TS_PID_PMT;
+            b_selected = true;
+        }
+        else if( pid->es )
+        {
+            if( pid->p_owner )
+                pid->p_owner->b_has_es = true;
+
+            if( pid->es->id )
+            {
+                /* Drop whole programs only, the E/S output may switch
+                 * tracks within a program without telling us */
+                for( int i_prg = 0; pid->p_owner && !b_selected &&
+                                    i_prg < pid->p_owner->i_prg; i_prg++ )
+                    b_selected = ProgramIsSelected( p_demux,
+                                        pid->p_owner->prg[i_prg]->i_number );
+                if( !b_selected )
+                    es_out_Control( p_demux->out, ES_OUT_GET_ES_STATE,
+                                    pid->es->id, &b_selected );
+            }
+
+            if( b_selected && p_sys->dispatch[i] != TS_PID_ES )
+            {
+                /* Do not mix data from before the pid was dropped */
+                if( pid->es->p_data )
+                    block_ChainRelease( pid->es->p_data );
+                pid->es->p_data = NULL;
+                pid->es->i_data_size = 0;
+                pid->es->i_data_gathered = 0;
+                pid->i_cc = 0xff;
+            }
+
+            if( b_selected )
+                i_dispatch = TS_PID_ES;
+            else
+                i_dispatch = pid->b_pcr ? TS_PID_PCR : TS_PID_DROP;
+        }
+        else
+            i_dispatch = TS_PID_DROP;
+
+        p_sys->dispatch[i] = i_dispatch;
+    }
+
+    /* Push the selection down to the access: PSI, selected ES and the PCR
+     * of the selected programs */
+    if( !p_sys->b_access_control )
+        return;
+
+    bool pb_filter[8192];
+    for( int i = 0; i < 8192; i++ )
+        pb_filter[i] = p_sys->dispatch[i] == TS_PID_PSI ||
+                       p_sys->dispatch[i] == TS_PID_PMT ||
+                       p_sys->dispatch[i] == TS_PID_ES;
+
+    for( int i = 0; i < p_sys->i_pmt; i++ )
+    {
+        ts_psi_t *psi = p_sys->pmt[i]->psi;
 
-    return stream_Control( p_demux->s, STREAM_SET_PRIVATE_ID_STATE,
-                           i_pid, b_selected );
+        for( int i_prg = 0; i_prg < psi->i_prg; i_prg++ )
+        {
+            const int i_pid_pcr = psi->prg[i_prg]->i_pid_pcr;
+            if( i_pid_pcr > 0 && i_pid_pcr < 8192 &&
+                ProgramIsSelected( p_demux, psi->prg[i_prg]->i_number ) )
+                pb_filter[i_pid_pcr] = true;
+        }
+    }
+
+    /* The PAT is left to the access */
+    for( int i = 1; i < 8192; i++ )
+        SetPIDFilter( p_demux, i, pb_filter[i] );
 }
 
 static void SetPrgFilter( demux_t *p_demux, int i_prg_id, bool b_selected )
@@ -1400,6 +1566,7 @@ static void PIDInit( ts_pid_t *pid, bool b_psi, ts_psi_t *p_owner )
         {
             pid->psi = xmalloc( sizeof( ts_psi_t ) );
             pid->psi->handle = NULL;
+            pid->psi->b_has_es = false;
             TAB_INIT( pid->psi->i_prg, pid->psi->prg );
         }
         assert( pid->psi );
@@ -1432,7 +1599,7 @@ static void PIDInit( ts_pid_t *pid, bool b_psi, ts_psi_t *p_owner )
 
         es_format_Init( &pid->es->fmt, UNKNOWN_ES, 0 );
         pid->es->data_type = TS_ES_DATA_PES;
-        pid->es->pp_last = &pid->es->p_data;
+        pid->es->i_data_alloc = 0;
     }
 }
 
@@ -1788,11 +1955,14 @@ static void ParseData( demux_t *p_demux, ts_pid_t *pid )
 {
     block_t *p_data = pid->es->p_data;
 
+    /* Size the next unit after this one, with some headroom */
+    pid->es->i_data_alloc = pid->es->i_data_gathered
+                          + pid->es->i_data_gathered / 4;
+
     /* remove the pes from pid */
     pid->es->p_data = NULL;
     pid->es->i_data_size = 0;
     pid->es->i_data_gathered = 0;
-    pid->es->pp_last = &pid->es->p_data;
 
     if( pid->es->data_type == TS_ES_DATA_PES )
     {
@@ -1808,6 +1978,41 @@ static void ParseData( demux_t *p_demux, ts_pid_t *pid )
     }
 }
 
+/* Skips garbage until two consecutive sync bytes are found in the stream */
+static int ResyncStream( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    while( vlc_object_alive (p_demux) )
+    {
+        const uint8_t *p_peek;
+        const int i_header = p_sys->i_packet_header_size;
+        int i_peek;
+
+        i_peek = stream_Peek( p_demux->s, &p_peek,
+                p_sys->i_packet_size * 10 );
+        if( i_peek < p_sys->i_packet_size + 1 )
+        {
+            msg_Dbg( p_demux, "eof ?" );
+            return VLC_EGENERIC;
+        }
+
+        ssize_t i_sync = TsSyncFind( &p_peek[i_header], i_peek - i_header,
+                                     p_sys->i_packet_size, 2 );
+        /* Keep the last packet for the next window if nothing was found */
+        int i_skip = i_sync >= 0 ? i_sync : i_peek - p_sys->i_packet_size;
+
+        msg_Dbg( p_demux, "skipping %d bytes of garbage", i_skip );
+        stream_Read( p_demux->s, NULL, i_skip );
+
+        if( i_sync >= 0 )
+        {
+            break;
+        }
+    }
+    return VLC_SUCCESS;
+}
+
 static block_t* ReadTSPacket( demux_t *p_demux )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
@@ -1833,43 +2038,96 @@ static block_t* ReadTSPacket( demux_t *p_demux )
     {
         msg_Warn( p_demux, "lost synchro" );
         block_Release( p_pkt );
-        while( vlc_object_alive (p_demux) )
+        if( ResyncStream( p_demux ) )
+            return NULL;
+        if( !( p_pkt = stream_Block( p_demux->s, p_sys->i_packet_size ) ) )
         {
-            const uint8_t *p_peek;
-            int i_peek, i_skip = 0;
+            msg_Dbg( p_demux, "eof ?" );
+            return NULL;
+        }
+    }
+    return p_pkt;
+}
+
+/**
+ * Returns the next TS packet (starting at the sync byte) for the demux loop.
+ *
+ * Packets are read from the stream i_chunk_packets at a time into a single
+ * block and handed out in place, instead of allocating and copying one
+ * block per packet. The returned packet can be modified (descrambling), and
+ * remains valid until the next call.
+ */
+static uint8_t* NextTSPacket( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    const size_t i_size = p_sys->i_packet_size;
+    const size_t i_header = p_sys->i_packet_header_size;
+    block_t *p_chunk = p_sys->p_chunk;
 
-            i_peek = stream_Peek( p_demux->s, &p_peek,
-                    p_sys->i_packet_size * 10 );
-            if( i_peek < p_sys->i_packet_size + 1 )
+    /* The stream was moved behind our back (seek, PCR probing) */
+    if( p_chunk != NULL && stream_Tell( p_demux->s ) != p_sys->i_chunk_end )
+    {
+        block_Release( p_chunk );
+        p_chunk = p_sys->p_chunk = NULL;
+    }
+
+    for( ;; )
+    {
+        if( p_chunk == NULL || p_chunk->i_buffer < i_size )
+        {
+            /* Keep the head of a packet left over by a resync */
+            const size_t i_left = p_chunk ? p_chunk->i_buffer : 0;
+            const size_t i_want = i_size * p_sys->i_chunk_packets;
+            block_t *p_new = block_Alloc( i_left + i_want );
+
+            if( p_new != NULL && i_left > 0 )
+                memcpy( p_new->p_buffer, p_chunk->p_buffer, i_left );
+            if( p_chunk != NULL )
+                block_Release( p_chunk );
+            p_sys->p_chunk = p_chunk = p_new;
+            if( unlikely(p_chunk == NULL) )
+                return NULL;
+
+            int i_read = stream_Read( p_demux->s, p_chunk->p_buffer + i_left,
+                                      i_want );
+            p_chunk->i_buffer = i_left + __MAX( i_read, 0 );
+            p_sys->i_chunk_end = stream_Tell( p_demux->s );
+            if( p_chunk->i_buffer < i_size )
             {
                 msg_Dbg( p_demux, "eof ?" );
                 return NULL;
             }
+        }
 
-            while( i_skip < i_peek - p_sys->i_packet_size )
-            {
-                if( p_peek[i_skip + p_sys->i_packet_header_size] == 0x47 &&
-                        p_peek[i_skip + p_sys->i_packet_header_size + p_sys->i_packet_size] == 0x47 )
-                {
-                    break;
-                }
-                i_skip++;
-            }
-            msg_Dbg( p_demux, "skipping %d bytes of garbage", i_skip );
-            stream_Read( p_demux->s, NULL, i_skip );
+        if( p_chunk->p_buffer[i_header] == 0x47 )
+            break;
 
-            if( i_skip < i_peek - p_sys->i_packet_size )
-            {
-                break;
-            }
-        }
-        if( !( p_pkt = stream_Block( p_demux->s, p_sys->i_packet_size ) ) )
+        /* Check sync byte and re-sync if needed, within the chunk first */
+        msg_Warn( p_demux, "lost synchro" );
+
+        ssize_t i_skip = -1;
+        if( p_chunk->i_buffer > i_header )
+            i_skip = TsSyncFind( &p_chunk->p_buffer[i_header],
+                                 p_chunk->i_buffer - i_header, i_size, 2 );
+
+        if( i_skip >= 0 )
         {
-            msg_Dbg( p_demux, "eof ?" );
-            return NULL;
+            msg_Dbg( p_demux, "skipping %zd bytes of garbage", i_skip );
+            p_chunk->p_buffer += i_skip;
+            p_chunk->i_buffer -= i_skip;
+            break;
         }
+
+        block_Release( p_chunk );
+        p_sys->p_chunk = p_chunk = NULL;
+        if( ResyncStream( p_demux ) )
+            return NULL;
     }
-    return p_pkt;
+
+    uint8_t *p = p_chunk->p_buffer + i_header;
+    p_chunk->p_buffer += i_size;
+    p_chunk->i_buffer -= i_size;
+    return p;
 }
 
 static mtime_t AdjustPCRWrapAround( demux_t *p_demux, mtime_t i_pcr )
@@ -1893,10 +2151,8 @@ static mtime_t AdjustPCRWrapAround( demux_t *p_demux, mtime_t i_pcr )
     return i_pcr + i_adjust;
 }
 
-static mtime_t GetPCR( block_t *p_pkt )
+static mtime_t GetPCR( const uint8_t *p )
 {
-    const uint8_t *p = p_pkt->p_buffer;
-
     mtime_t i_pcr = -1;
 
     if( ( p[3]&0x20 ) && /* adaptation */
@@ -1938,9 +2194,9 @@ static int SeekToPCR( demux_t *p_demux, int64_t i_pos )
         {
             break;
         }
-        if( PIDGet( p_pkt ) == p_sys->i_pid_ref_pcr )
+        if( PIDGet( p_pkt->p_buffer ) == p_sys->i_pid_ref_pcr )
         {
-            i_pcr = GetPCR( p_pkt );
+            i_pcr = GetPCR( p_pkt->p_buffer );
         }
         block_Release( p_pkt );
         if( i_pcr >= 0 )
@@ -2038,7 +2294,6 @@ static int Seek( demux_t *p_demux, double f_percent )
                 pid->es->p_data = NULL;
                 pid->es->i_data_size = 0;
                 pid->es->i_data_gathered = 0;
-                pid->es->pp_last = &pid->es->p_data;
             }
             block_t *p_reset = block_Alloc(1);
             if( p_reset )
@@ -2070,10 +2325,10 @@ static void GetFirstPCR( demux_t *p_demux )
         {
             break;
         }
-        mtime_t i_pcr = GetPCR( p_pkt );
+        mtime_t i_pcr = GetPCR( p_pkt->p_buffer );
         if( i_pcr >= 0 )
         {
-            p_sys->i_pid_ref_pcr = PIDGet( p_pkt );
+            p_sys->i_pid_ref_pcr = PIDGet( p_pkt->p_buffer );
             p_sys->i_first_pcr = i_pcr;
             p_sys->i_current_pcr = i_pcr;
         }
@@ -2169,14 +2424,14 @@ static void CheckPCR( demux_t *p_demux )
     p_sys->i_current_pcr = i_initial_pcr;
 }
 
-static void PCRHandle( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
+static void PCRHandle( demux_t *p_demux, ts_pid_t *pid, const uint8_t *p )
 {
     demux_sys_t   *p_sys = p_demux->p_sys;
 
     if( p_sys->i_pmt_es <= 0 )
         return;
 
-    mtime_t i_pcr = GetPCR( p_bk );
+    mtime_t i_pcr = GetPCR( p );
     if( i_pcr < 0 )
         return;
 
@@ -2196,15 +2451,7 @@ static void PCRHandle( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
                 /* We've found our target group */
                 p_sys->pmt[i]->psi->prg[i_prg]->i_pcr_value = i_pcr;
                 i_group = p_sys->pmt[i]->psi->prg[i_prg]->i_number;
-                for( int j = 0; j < 8192; j++ )
-                {
-                    const ts_pid_t *pid = &p_sys->pid[j];
-                    if( pid->b_valid && pid->p_owner == p_sys->pmt[i]->psi && pid->es )
-                    {
-                        b_pmt_has_es = true;
-                        break;
-                    }
-                }
+                b_pmt_has_es = p_sys->pmt[i]->psi->b_has_es;
             }
         }
 
@@ -2214,9 +2461,48 @@ static void PCRHandle( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
     }
 }
 
-static bool GatherData( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
+/**
+ * Appends a TS payload to the unit (PES or section) being gathered.
+ * Units are accumulated into a single block, sized after the previous unit,
+ * so that neither a block per TS packet nor a final gathering copy is needed.
+ */
+static void GatherAppend( ts_es_t *es, const uint8_t *p_data, size_t i_data,
+                          size_t i_hint )
+{
+    block_t *p_unit = es->p_data;
+
+    if( p_unit == NULL )
+    {
+        p_unit = block_Alloc( __MAX( __MAX( i_hint, es->i_data_alloc ),
+                                     i_data ) );
+        if( unlikely(p_unit == NULL) )
+            return;
+        p_unit->i_buffer = 0;
+        es->p_data = p_unit;
+    }
+    else if( (size_t)(p_unit->p_start + p_unit->i_size
+                     - p_unit->p_buffer) < p_unit->i_buffer + i_data )
+    {
+        const size_t i_used = p_unit->i_buffer;
+
+        p_unit = block_Realloc( p_unit, 0, 2 * i_used + i_data );
+        es->p_data = p_unit;
+        if( unlikely(p_unit == NULL) )
+        {
+            es->i_data_size = 0;
+            es->i_data_gathered = 0;
+            return;
+        }
+        p_unit->i_buffer = i_used;
+    }
+
+    memcpy( &p_unit->p_buffer[p_unit->i_buffer], p_data, i_data );
+    p_unit->i_buffer += i_data;
+    es->i_data_gathered += i_data;
+}
+
+static bool GatherData( demux_t *p_demux, ts_pid_t *pid, uint8_t *p )
 {
-    const uint8_t *p = p_bk->p_buffer;
     const bool b_unit_start = p[1]&0x40;
     const bool b_scrambled  = p[3]&0x80;
     const bool b_adaptation = p[3]&0x20;
@@ -2236,7 +2522,6 @@ static bool GatherData( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
 
     /* For now, ignore additional error correction
      * TODO: handle Reed-Solomon 204,188 error correction */
-    p_bk->i_buffer = TS_PACKET_SIZE_188;
 
     if( p[1]&0x80 )
     {
@@ -2249,7 +2534,7 @@ static bool GatherData( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
     if( p_demux->p_sys->csa )
     {
         vlc_mutex_lock( &p_demux->p_sys->csa_lock );
-        csa_Decrypt( p_demux->p_sys->csa, p_bk->p_buffer, p_demux->p_sys->i_csa_pkt_size );
+        csa_Decrypt( p_demux->p_sys->csa, p, p_demux->p_sys->i_csa_pkt_size );
         vlc_mutex_unlock( &p_demux->p_sys->csa_lock );
     }
 
@@ -2316,13 +2601,11 @@ static bool GatherData( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
         }
     }
 
-    PCRHandle( p_demux, pid, p_bk );
+    if( pid->b_pcr )
+        PCRHandle( p_demux, pid, p );
 
     if( i_skip >= 188 || pid->es->id == NULL )
-    {
-        block_Release( p_bk );
         return i_ret;
-    }
 
     /* */
     if( !pid->b_scrambled != !b_scrambled )
@@ -2342,23 +2625,17 @@ static bool GatherData( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
     }
 
     /* We have to gather it */
-    p_bk->p_buffer += i_skip;
-    p_bk->i_buffer -= i_skip;
+    const uint8_t *p_payload = &p[i_skip];
+    size_t i_payload = TS_PACKET_SIZE_188 - i_skip;
 
     if( b_unit_start )
     {
-        if( pid->es->data_type == TS_ES_DATA_TABLE_SECTION && p_bk->i_buffer > 0 )
+        if( pid->es->data_type == TS_ES_DATA_TABLE_SECTION && i_payload > 0 )
         {
-            int i_pointer_field = __MIN( p_bk->p_buffer[0], p_bk->i_buffer - 1 );
-            block_t *p = block_Duplicate( p_bk );
-            if( p )
-            {
-                p->i_buffer = i_pointer_field;
-                p->p_buffer++;
-                block_ChainLastAppend( &pid->es->pp_last, p );
-            }
-            p_bk->i_buffer -= 1 + i_pointer_field;
-            p_bk->p_buffer += 1 + i_pointer_field;
+            int i_pointer_field = __MIN( p_payload[0], i_payload - 1 );
+            GatherAppend( pid->es, &p_payload[1], i_pointer_field, 0 );
+            i_payload -= 1 + i_pointer_field;
+            p_payload += 1 + i_pointer_field;
         }
         if( pid->es->p_data )
         {
@@ -2366,12 +2643,11 @@ static bool GatherData( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
             i_ret = true;
         }
 
-        block_ChainLastAppend( &pid->es->pp_last, p_bk );
         if( pid->es->data_type == TS_ES_DATA_PES )
         {
-            if( p_bk->i_buffer > 6 )
+            if( i_payload > 6 )
             {
-                pid->es->i_data_size = GetWBE( &p_bk->p_buffer[4] );
+                pid->es->i_data_size = GetWBE( &p_payload[4] );
                 if( pid->es->i_data_size > 0 )
                 {
                     pid->es->i_data_size += 6;
@@ -2380,12 +2656,12 @@ static bool GatherData( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
         }
         else if( pid->es->data_type == TS_ES_DATA_TABLE_SECTION )
         {
-            if( p_bk->i_buffer > 3 && p_bk->p_buffer[0] != 0xff )
+            if( i_payload > 3 && p_payload[0] != 0xff )
             {
-                pid->es->i_data_size = 3 + (((p_bk->p_buffer[1] & 0xf) << 8) | p_bk->p_buffer[2]);
+                pid->es->i_data_size = 3 + (((p_payload[1] & 0xf) << 8) | p_payload[2]);
             }
         }
-        pid->es->i_data_gathered += p_bk->i_buffer;
+        GatherAppend( pid->es, p_payload, i_payload, pid->es->i_data_size );
         if( pid->es->i_data_size > 0 &&
             pid->es->i_data_gathered >= pid->es->i_data_size )
         {
@@ -2398,12 +2674,10 @@ static bool GatherData( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
         if( pid->es->p_data == NULL )
         {
             /* msg_Dbg( p_demux, "broken packet" ); */
-            block_Release( p_bk );
         }
         else
         {
-            block_ChainLastAppend( &pid->es->pp_last, p_bk );
-            pid->es->i_data_gathered += p_bk->i_buffer;
+            GatherAppend( pid->es, p_payload, i_payload, 0 );
 
             if( pid->es->i_data_size > 0 &&
                 pid->es->i_data_gathered >= pid->es->i_data_size )
@@ -3548,7 +3822,7 @@ static void PMTSetupEsTeletext( demux_t *p_demux, ts_pid_t *pid,
                 p_es->p_data  = NULL;
                 p_es->i_data_size = 0;
                 p_es->i_data_gathered = 0;
-                p_es->pp_last = &p_es->p_data;
+                p_es->i_data_alloc = 0;
                 p_es->data_type = TS_ES_DATA_PES;
                 p_es->p_mpeg4desc = NULL;
 
@@ -3633,7 +3907,7 @@ static void PMTSetupEsDvbSubtitle( demux_t *p_demux, ts_pid_t *pid,
                 p_es->p_data   = NULL;
                 p_es->i_data_size = 0;
                 p_es->i_data_gathered = 0;
-                p_es->pp_last = &p_es->p_data;
+                p_es->i_data_alloc = 0;
                 p_es->data_type = TS_ES_DATA_PES;
                 p_es->p_mpeg4desc = NULL;
 
@@ -4024,6 +4298,7 @@ static void PMTCallBack( void *data, dvbpsi_pmt_t *p_pmt )
     ts_prg_psi_t *prg;
 
     msg_Dbg( p_demux, "PMTCallBack called" );
+    p_sys->b_dispatch_dirty = true;
 
     /* First find this PMT declared in PAT */
     for( int i = 0; !pmt && i < p_sys->i_pmt; i++ )
@@ -4158,6 +4433,8 @@ static void PMTCallBack( void *data, dvbpsi_pmt_t *p_pmt )
         pid->i_owner_number = prg->i_number;
         pid->i_pid          = p_es->i_pid;
         pid->b_seen         = p_sys->pid[p_es->i_pid].b_seen;
+        pid->b_pcr          = p_sys->pid[p_es->i_pid].b_pcr;
+        pid->b_filter       = p_sys->pid[p_es->i_pid].b_filter;
 
 
         bool b_registration_applied = false;
@@ -4321,6 +4598,7 @@ static void PATCallBack( void *data, dvbpsi_pat_t *p_pat )
     ts_pid_t             *pat = &p_sys->pid[0];
 
     msg_Dbg( p_demux, "PATCallBack called" );
+    p_sys->b_dispatch_dirty = true;
 
     if( ( pat->psi->i_pat_version != -1 &&
             ( !p_pat->b_current_next ||
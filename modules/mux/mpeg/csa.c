@@ -39,19 +39,23 @@ struct csa_t
     uint8_t o_kk[57];
     uint8_t e_kk[57];
 
-    /* cypher state */
+    bool    use_odd;
+};
+
+/* Stream cypher state, kept per packet so that several threads can
+ * encrypt or decrypt with the same keys at once */
+typedef struct
+{
     int     A[11];
     int     B[11];
     int     X, Y, Z;
     int     D, E, F;
     int     p, q, r;
-
-    bool    use_odd;
-};
+} csa_state_t;
 
 static void csa_ComputeKey( uint8_t kk[57], uint8_t ck[8] );
 
-static void csa_StreamCypher( csa_t *c, int b_init, uint8_t *ck, uint8_t *sb, uint8_t *cb );
+static void csa_StreamCypher( csa_state_t *c, int b_init, uint8_t *ck, uint8_t *sb, uint8_t *cb );
 
 static void csa_BlockDecypher( uint8_t kk[57], uint8_t ib[8], uint8_t bd[8] );
 static void csa_BlockCypher( uint8_t kk[57], uint8_t bd[8], uint8_t ib[8] );
@@ -144,6 +148,7 @@ void csa_Decrypt( csa_t *c, uint8_t *pkt, int i_pkt_size )
     uint8_t *kk;
 
     uint8_t  ib[8], stream[8], block[8];
+    csa_state_t state;
 
     int     i_hdr, i_residue;
     int     i, j, n;
@@ -179,7 +184,7 @@ void csa_Decrypt( csa_t *c, uint8_t *pkt, int i_pkt_size )
         return;
 
     /* init csa state */
-    csa_StreamCypher( c, 1, ck, &pkt[i_hdr], ib );
+    csa_StreamCypher( &state, 1, ck, &pkt[i_hdr], ib );
 
     /* */
     n = (i_pkt_size - i_hdr) / 8;
@@ -192,7 +197,7 @@ void csa_Decrypt( csa_t *c, uint8_t *pkt, int i_pkt_size )
         csa_BlockDecypher( kk, ib, block );
         if( i != n )
         {
-            csa_StreamCypher( c, 0, ck, NULL, stream );
+            csa_StreamCypher( &state, 0, ck, NULL, stream );
             for( j = 0; j < 8; j++ )
             {
                 /* xor ib with stream */
@@ -216,7 +221,7 @@ void csa_Decrypt( csa_t *c, uint8_t *pkt, int i_pkt_size )
 
     if( i_residue > 0 )
     {
-        csa_StreamCypher( c, 0, ck, NULL, stream );
+        csa_StreamCypher( &state, 0, ck, NULL, stream );
         for( j = 0; j < i_residue; j++ )
         {
             pkt[i_pkt_size - i_residue + j] ^= stream[j];
@@ -235,6 +240,7 @@ void csa_Encrypt( csa_t *c, uint8_t *pkt, int i_pkt_size )
     int i, j;
     int i_hdr = 4; /* hdr len */
     uint8_t  ib[184/8+2][8], stream[8], block[8];
+    csa_state_t state;
     int n, i_residue;
 
     /* set transport scrambling control */
@@ -283,7 +289,7 @@ void csa_Encrypt( csa_t *c, uint8_t *pkt, int i_pkt_size )
     }
 
     /* init csa state */
-    csa_StreamCypher( c, 1, ck, ib[1], stream );
+    csa_StreamCypher( &state, 1, ck, ib[1], stream );
 
     for( i = 0; i < 8; i++ )
     {
@@ -291,7 +297,7 @@ void csa_Encrypt( csa_t *c, uint8_t *pkt, int i_pkt_size )
     }
     for( i = 2; i < n+1; i++ )
     {
-        csa_StreamCypher( c, 0, ck, NULL, stream );
+        csa_StreamCypher( &state, 0, ck, NULL, stream );
         for( j = 0; j < 8; j++ )
         {
             pkt[i_hdr+8*(i-1)+j] = ib[i][j] ^ stream[j];
@@ -299,7 +305,7 @@ void csa_Encrypt( csa_t *c, uint8_t *pkt, int i_pkt_size )
     }
     if( i_residue > 0 )
     {
-        csa_StreamCypher( c, 0, ck, NULL, stream );
+        csa_StreamCypher( &state, 0, ck, NULL, stream );
         for( j = 0; j < i_residue; j++ )
         {
             pkt[i_pkt_size - i_residue + j] ^= stream[j];
@@ -374,7 +380,7 @@ static const int sbox5[0x20] = {2,0,0,1,3,2,3,2, 0,1,3,3,1,0,2,1, 2,3,2,0,0,3,1,
 static const int sbox6[0x20] = {0,1,2,3,1,2,2,0, 0,1,3,0,2,3,1,3, 2,3,0,2,3,0,1,1, 2,1,1,2,0,3,3,0};
 static const int sbox7[0x20] = {0,3,2,2,3,0,0,1, 3,0,1,3,1,2,2,1, 1,0,3,3,0,1,1,2, 2,3,1,0,2,3,0,2};
 
-static void csa_StreamCypher( csa_t *c, int b_init, uint8_t *ck, uint8_t *sb, uint8_t *cb )
+static void csa_StreamCypher( csa_state_t *c, int b_init, uint8_t *ck, uint8_t *sb, uint8_t *cb )
 {
     int i,j, k;
     int extra_B;
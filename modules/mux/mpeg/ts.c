@@ -173,6 +173,11 @@ static void    Close  ( vlc_object_t * );
     "The encryption routines subtract the TS-header from the value before " \
     "encrypting." )
 
+#define THREADS_TEXT N_("Packetization threads")
+#define THREADS_LONGTEXT N_("Number of extra threads building the TS " \
+  "packets of the elementary streams, other than the PCR one, and " \
+  "scrambling them. With 0, everything is done in the muxing thread.")
+
 #define SOUT_CFG_PREFIX "sout-ts-"
 #define MAX_PMT 64       /* Maximum number of programs. FIXME: I just chose an arbitrary number. Where is the maximum in the spec? */
 #define MAX_PMT_PID 64       /* Maximum pids in each pmt.  FIXME: I just chose an arbitrary number. Where is the maximum in the spec? */
@@ -212,6 +217,9 @@ vlc_module_begin ()
     add_string( SOUT_CFG_PREFIX "csa-use", "1",  CU_TEXT,   CU_LONGTEXT,   true)
     add_integer(SOUT_CFG_PREFIX "csa-pkt", 188,  CPKT_TEXT, CPKT_LONGTEXT, true)
 
+    add_integer(SOUT_CFG_PREFIX "threads", 0, THREADS_TEXT, THREADS_LONGTEXT, true)
+        change_integer_range( 0, 64 )
+
     set_callbacks( Open, Close )
 vlc_module_end ()
 
@@ -223,7 +231,7 @@ static const char *const ppsz_sout_options[] = {
     "netid", "sdtdesc",
     "es-id-pid", "shaping", "pcr", "bmin", "bmax", "use-key-frames",
     "dts-delay", "csa-ck", "csa2-ck", "csa-use", "csa-pkt", "crypt-audio", "crypt-video",
-    "muxpmt", "program-pmt", "alignment",
+    "muxpmt", "program-pmt", "alignment", "threads",
     NULL
 };
 
@@ -333,6 +341,9 @@ typedef struct ts_stream_t
     int                 i_pes_used;
     bool                b_key_frame;
 
+    /* TS packets built ahead by a packetization thread */
+    sout_buffer_chain_t chain_ts;
+
 } ts_stream_t;
 
 struct sout_mux_sys_t
@@ -389,6 +400,26 @@ struct sout_mux_sys_t
     int             i_csa_pkt_size;
     bool            b_crypt_audio;
     bool            b_crypt_video;
+
+    /* packetization threads */
+    unsigned        i_threads;
+    vlc_thread_t    *threads;
+    vlc_mutex_t     jobs_lock;
+    vlc_cond_t      jobs_wait;
+    vlc_cond_t      jobs_done;
+    void          (*pf_job)( sout_mux_t *, unsigned );
+    unsigned        i_jobs;
+    unsigned        i_jobs_next;
+    unsigned        i_jobs_pending;
+    bool            b_jobs_exit;
+
+    ts_stream_t     **pp_packetize;
+    unsigned        i_packetize;
+    mtime_t         i_packetize_end;
+
+    block_t         **pp_scramble;
+    unsigned        i_scramble;
+    unsigned        i_scramble_max;
 };
 
 /* Reserve a pid and return it */
@@ -450,6 +481,9 @@ static void GetPMT( sout_mux_t *p_mux, sout_buffer_chain_t *c );
 static block_t *TSNew( sout_mux_t *p_mux, ts_stream_t *p_stream, bool b_pcr );
 static void TSSetPCR( block_t *p_ts, mtime_t i_dts );
 
+static int  ThreadsStart( sout_mux_t *p_mux );
+static void ThreadsStop ( sout_mux_t *p_mux );
+
 static csa_t *csaSetup( vlc_object_t *p_this )
 {
     sout_mux_t *p_mux = (sout_mux_t*)p_this;
@@ -727,6 +761,10 @@ static int Open( vlc_object_t *p_this )
 
     p_sys->csa = csaSetup(p_this);
 
+    p_sys->i_threads = var_GetInteger( p_mux, SOUT_CFG_PREFIX "threads" );
+    if( p_sys->i_threads > 0 && ThreadsStart( p_mux ) )
+        p_sys->i_threads = 0;
+
     p_mux->pf_control   = Control;
     p_mux->pf_addstream = AddStream;
     p_mux->pf_delstream = DelStream;
@@ -748,6 +786,9 @@ static void Close( vlc_object_t * p_this )
         dvbpsi_delete( p_sys->p_dvbpsi );
 #endif
 
+    if( p_sys->i_threads > 0 )
+        ThreadsStop( p_mux );
+
     if( p_sys->csa )
     {
         var_DelCallback( p_mux, SOUT_CFG_PREFIX "csa-ck", ChangeKeyCallback, NULL );
@@ -821,6 +862,120 @@ static int ActiveKeyCallback( vlc_object_t *p_this, char const *psz_cmd,
     return i_res;
 }
 
+/*****************************************************************************
+ * Packetization threads: they run batches of jobs on behalf of MuxStreams(),
+ * which takes part in the work and waits for the whole batch to complete.
+ *****************************************************************************/
+static void *JobThread( void *data )
+{
+    sout_mux_t      *p_mux = data;
+    sout_mux_sys_t  *p_sys = p_mux->p_sys;
+
+    vlc_mutex_lock( &p_sys->jobs_lock );
+    for( ;; )
+    {
+        while( !p_sys->b_jobs_exit && p_sys->i_jobs_next >= p_sys->i_jobs )
+            vlc_cond_wait( &p_sys->jobs_wait, &p_sys->jobs_lock );
+        if( p_sys->b_jobs_exit )
+            break;
+
+        unsigned i_job = p_sys->i_jobs_next++;
+        vlc_mutex_unlock( &p_sys->jobs_lock );
+
+        p_sys->pf_job( p_mux, i_job );
+
+        vlc_mutex_lock( &p_sys->jobs_lock );
+        if( --p_sys->i_jobs_pending == 0 )
+            vlc_cond_signal( &p_sys->jobs_done );
+    }
+    vlc_mutex_unlock( &p_sys->jobs_lock );
+    return NULL;
+}
+
+static void RunJobs( sout_mux_t *p_mux,
+                     void (*pf_job)( sout_mux_t *, unsigned ), unsigned i_jobs )
+{
+    sout_mux_sys_t  *p_sys = p_mux->p_sys;
+    int canc = vlc_savecancel();
+
+    vlc_mutex_lock( &p_sys->jobs_lock );
+    p_sys->pf_job = pf_job;
+    p_sys->i_jobs = i_jobs;
+    p_sys->i_jobs_next = 0;
+    p_sys->i_jobs_pending = i_jobs;
+    vlc_cond_broadcast( &p_sys->jobs_wait );
+
+    while( p_sys->i_jobs_next < p_sys->i_jobs )
+    {
+        unsigned i_job = p_sys->i_jobs_next++;
+        vlc_mutex_unlock( &p_sys->jobs_lock );
+
+        pf_job( p_mux, i_job );
+
+        vlc_mutex_lock( &p_sys->jobs_lock );
+        p_sys->i_jobs_pending--;
+    }
+    while( p_sys->i_jobs_pending > 0 )
+        vlc_cond_wait( &p_sys->jobs_done, &p_sys->jobs_lock );
+    vlc_mutex_unlock( &p_sys->jobs_lock );
+
+    vlc_restorecancel( canc );
+}
+
+static int ThreadsStart( sout_mux_t *p_mux )
+{
+    sout_mux_sys_t  *p_sys = p_mux->p_sys;
+
+    p_sys->threads = malloc( p_sys->i_threads * sizeof( *p_sys->threads ) );
+    if( p_sys->threads == NULL )
+        return VLC_ENOMEM;
+
+    vlc_mutex_init( &p_sys->jobs_lock );
+    vlc_cond_init( &p_sys->jobs_wait );
+    vlc_cond_init( &p_sys->jobs_done );
+
+    for( unsigned i = 0; i < p_sys->i_threads; i++ )
+    {
+        if( vlc_clone( &p_sys->threads[i], JobThread, p_mux,
+                       VLC_THREAD_PRIORITY_OUTPUT ) )
+        {
+            msg_Err( p_mux, "cannot spawn packetization thread" );
+            if( i == 0 )
+            {
+                vlc_cond_destroy( &p_sys->jobs_done );
+                vlc_cond_destroy( &p_sys->jobs_wait );
+                vlc_mutex_destroy( &p_sys->jobs_lock );
+                free( p_sys->threads );
+                return VLC_EGENERIC;
+            }
+            p_sys->i_threads = i;
+            break;
+        }
+    }
+    msg_Dbg( p_mux, "using %u packetization threads", p_sys->i_threads );
+    return VLC_SUCCESS;
+}
+
+static void ThreadsStop( sout_mux_t *p_mux )
+{
+    sout_mux_sys_t  *p_sys = p_mux->p_sys;
+
+    vlc_mutex_lock( &p_sys->jobs_lock );
+    p_sys->b_jobs_exit = true;
+    vlc_cond_broadcast( &p_sys->jobs_wait );
+    vlc_mutex_unlock( &p_sys->jobs_lock );
+
+    for( unsigned i = 0; i < p_sys->i_threads; i++ )
+        vlc_join( p_sys->threads[i], NULL );
+
+    vlc_cond_destroy( &p_sys->jobs_done );
+    vlc_cond_destroy( &p_sys->jobs_wait );
+    vlc_mutex_destroy( &p_sys->jobs_lock );
+    free( p_sys->threads );
+    free( p_sys->pp_packetize );
+    free( p_sys->pp_scramble );
+}
+
 /*****************************************************************************
  * Control:
  *****************************************************************************/
@@ -1091,6 +1246,7 @@ static int AddStream( sout_mux_t *p_mux, sout_input_t *p_input )
 
     /* Init pes chain */
     BufferChainInit( &p_stream->chain_pes );
+    BufferChainInit( &p_stream->chain_ts );
 
     /* We only change PMT version (PAT isn't changed) */
     p_sys->i_pmt_version_number = ( p_sys->i_pmt_version_number + 1 )%32;
@@ -1167,8 +1323,9 @@ static int DelStream( sout_mux_t *p_mux, sout_input_t *p_input )
         msg_Dbg( p_mux, "new PCR PID is %d", p_sys->i_pcr_pid );
     }
 
-    /* Empty all data in chain_pes */
+    /* Empty all data in chain_pes and the packets not muxed yet */
     BufferChainClean( &p_stream->chain_pes );
+    BufferChainClean( &p_stream->chain_ts );
 
     free(p_stream->lang);
     free( p_stream->p_extra );
@@ -1219,6 +1376,101 @@ static void SetHeader( sout_buffer_chain_t *c,
     p_ts->i_flags |= BLOCK_FLAG_HEADER;
 }
 
+/* Builds the TS packets of one stream up to the end of the PCR window.
+ * The selection date of each packet, that is the stream PES date before
+ * it was built, is kept in its PTS for the interleaving in MuxStreams().
+ * No PCR is ever inserted here, so the packets are exactly those the
+ * serial loop would build for the stream. */
+static void PacketizeJob( sout_mux_t *p_mux, unsigned i_job )
+{
+    sout_mux_sys_t  *p_sys = p_mux->p_sys;
+    ts_stream_t     *p_stream = p_sys->pp_packetize[i_job];
+
+    while( p_stream->i_pes_dts != 0 &&
+           p_stream->i_pes_dts <= p_sys->i_packetize_end )
+    {
+        mtime_t i_dts = p_stream->i_pes_dts;
+        block_t *p_ts = TSNew( p_mux, p_stream, false );
+
+        p_ts->i_pts = i_dts;
+        BufferChainAppend( &p_stream->chain_ts, p_ts );
+    }
+}
+
+static bool PacketizeStreams( sout_mux_t *p_mux, mtime_t i_end )
+{
+    sout_mux_sys_t  *p_sys = p_mux->p_sys;
+
+    if( p_sys->i_packetize < (unsigned)p_mux->i_nb_inputs )
+    {
+        ts_stream_t **pp = realloc( p_sys->pp_packetize,
+                                    p_mux->i_nb_inputs * sizeof( *pp ) );
+        if( unlikely(pp == NULL) )
+            return false;
+        p_sys->pp_packetize = pp;
+        p_sys->i_packetize = p_mux->i_nb_inputs;
+    }
+
+    unsigned i_jobs = 0;
+    for (int i = 0; i < p_mux->i_nb_inputs; i++ )
+    {
+        sout_input_t *p_input = p_mux->pp_inputs[i];
+        ts_stream_t *p_stream = (ts_stream_t*)p_input->p_sys;
+
+        if( p_input != p_sys->p_pcr_input && p_stream->i_pes_dts != 0 )
+            p_sys->pp_packetize[i_jobs++] = p_stream;
+    }
+
+    p_sys->i_packetize_end = i_end;
+    RunJobs( p_mux, PacketizeJob, i_jobs );
+    return true;
+}
+
+static void ScrambleJob( sout_mux_t *p_mux, unsigned i_job )
+{
+    sout_mux_sys_t  *p_sys = p_mux->p_sys;
+    const unsigned i_jobs = p_sys->i_threads + 1;
+    const unsigned i_start = p_sys->i_scramble * i_job / i_jobs;
+    const unsigned i_end = p_sys->i_scramble * (i_job + 1) / i_jobs;
+
+    for( unsigned i = i_start; i < i_end; i++ )
+        csa_Encrypt( p_sys->csa, p_sys->pp_scramble[i]->p_buffer,
+                     p_sys->i_csa_pkt_size );
+}
+
+/* Scrambles the packets in parallel, before TSDate() would do it in order.
+ * The PCR written later on lies in the adaptation field which is left in
+ * the clear, so the output is the same. */
+static void ScrambleStreams( sout_mux_t *p_mux, sout_buffer_chain_t *c )
+{
+    sout_mux_sys_t  *p_sys = p_mux->p_sys;
+
+    p_sys->i_scramble = 0;
+    for( block_t *p_ts = c->p_first; p_ts != NULL; p_ts = p_ts->p_next )
+    {
+        if( !(p_ts->i_flags & BLOCK_FLAG_SCRAMBLED) )
+            continue;
+
+        if( p_sys->i_scramble == p_sys->i_scramble_max )
+        {
+            unsigned i_max = __MAX( 2 * p_sys->i_scramble_max, 256 );
+            block_t **pp = realloc( p_sys->pp_scramble, i_max * sizeof( *pp ) );
+            if( unlikely(pp == NULL) )
+                return; /* TSDate() will scramble the packets */
+            p_sys->pp_scramble = pp;
+            p_sys->i_scramble_max = i_max;
+        }
+        p_sys->pp_scramble[p_sys->i_scramble++] = p_ts;
+    }
+
+    vlc_mutex_lock( &p_sys->csa_lock );
+    RunJobs( p_mux, ScrambleJob, p_sys->i_threads + 1 );
+    vlc_mutex_unlock( &p_sys->csa_lock );
+
+    for( unsigned i = 0; i < p_sys->i_scramble; i++ )
+        p_sys->pp_scramble[i]->i_flags &= ~BLOCK_FLAG_SCRAMBLED;
+}
+
 /* returns true if needs more data */
 static bool MuxStreams(sout_mux_t *p_mux )
 {
@@ -1493,6 +1745,8 @@ static bool MuxStreams(sout_mux_t *p_mux )
     /* msg_Dbg( p_mux, "estimated pck=%d", i_packet_count ); */
 
     const mtime_t i_pcr_dts = p_pcr_stream->i_pes_dts;
+    const bool b_threaded = p_sys->i_threads > 0 &&
+        PacketizeStreams( p_mux, i_pcr_dts + i_pcr_length );
     for (;;)
     {
         int          i_stream = -1;
@@ -1504,15 +1758,22 @@ static bool MuxStreams(sout_mux_t *p_mux )
         {
             p_stream = (ts_stream_t*)p_mux->pp_inputs[i]->p_sys;
 
-            if( p_stream->i_pes_dts == 0 )
+            mtime_t i_stream_dts = p_stream->i_pes_dts;
+            if( b_threaded && p_stream != p_pcr_stream )
+            {
+                block_t *p_next = BufferChainPeek( &p_stream->chain_ts );
+                i_stream_dts = p_next != NULL ? p_next->i_pts : 0;
+            }
+
+            if( i_stream_dts == 0 )
             {
                 continue;
             }
 
-            if( i_stream == -1 || p_stream->i_pes_dts < i_dts )
+            if( i_stream == -1 || i_stream_dts < i_dts )
             {
                 i_stream = i;
-                i_dts = p_stream->i_pes_dts;
+                i_dts = i_stream_dts;
             }
         }
         if( i_stream == -1 || i_dts > i_pcr_dts + i_pcr_length )
@@ -1534,7 +1795,14 @@ static bool MuxStreams(sout_mux_t *p_mux )
         }
 
         /* Build the TS packet */
-        block_t *p_ts = TSNew( p_mux, p_stream, b_pcr );
+        block_t *p_ts;
+        if( b_threaded && p_stream != p_pcr_stream )
+        {
+            p_ts = BufferChainGet( &p_stream->chain_ts );
+            p_ts->i_pts = VLC_TS_INVALID;
+        }
+        else
+            p_ts = TSNew( p_mux, p_stream, b_pcr );
         if( p_sys->csa != NULL &&
              (p_input->p_fmt->i_cat != AUDIO_ES || p_sys->b_crypt_audio) &&
              (p_input->p_fmt->i_cat != VIDEO_ES || p_sys->b_crypt_video) )
@@ -1565,6 +1833,9 @@ static bool MuxStreams(sout_mux_t *p_mux )
         BufferChainAppend( &chain_ts, p_ts );
     }
 
+    if( b_threaded && p_sys->csa != NULL )
+        ScrambleStreams( p_mux, &chain_ts );
+
     /* 4: date and send */
     TSSchedule( p_mux, &chain_ts, i_pcr_length, i_pcr_dts );
     return false;
@@ -0,0 +1,141 @@
+/*****************************************************************************
+ * tssync.h: MPEG-TS sync byte scanning
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef VLC_MPEG_TSSYNC_H
+#define VLC_MPEG_TSSYNC_H 1
+
+#include <vlc_cpu.h>
+
+#define TS_SYNC_BYTE 0x47
+
+#if defined(HAVE_SSE2_INTRINSICS) && (VLC_GCC_VERSION(4, 9) || defined(__clang__))
+# include <immintrin.h>
+# define TS_SYNC_SIMD 1
+#endif
+
+/*
+ * All functions below look for the first offset i in p[0..i_data) such that
+ * p[i + k * i_stride] is a sync byte for every k in [0, i_count), i.e. where
+ * i_count packets of i_stride bytes (188, 192 or 204) follow each other.
+ * They return that offset, or -1 if there is none in the buffer.
+ * The whole window is scanned at once, 16 or 32 candidate offsets at a time.
+ */
+
+static inline ssize_t TsSyncFindC( const uint8_t *p, size_t i_data,
+                                   size_t i_stride, unsigned i_count )
+{
+    const size_t i_span = (i_count - 1) * i_stride;
+
+    if( i_count == 0 || i_data <= i_span )
+        return -1;
+
+    const uint8_t *p_end = p + i_data - i_span;
+    for( const uint8_t *p_sync = p; p_sync < p_end; p_sync++ )
+    {
+        p_sync = memchr( p_sync, TS_SYNC_BYTE, p_end - p_sync );
+        if( p_sync == NULL )
+            break;
+
+        unsigned k = 1;
+        while( k < i_count && p_sync[k * i_stride] == TS_SYNC_BYTE )
+            k++;
+        if( k == i_count )
+            return p_sync - p;
+    }
+    return -1;
+}
+
+#ifdef TS_SYNC_SIMD
+__attribute__ ((__target__ ("sse2")))
+static inline ssize_t TsSyncFindSSE2( const uint8_t *p, size_t i_data,
+                                      size_t i_stride, unsigned i_count )
+{
+    const size_t i_span = (i_count - 1) * i_stride;
+
+    if( i_count == 0 || i_data <= i_span )
+        return -1;
+
+    const size_t i_offsets = i_data - i_span;
+    const __m128i sync = _mm_set1_epi8( TS_SYNC_BYTE );
+    size_t i = 0;
+
+    for( ; i + 16 <= i_offsets; i += 16 )
+    {
+        __m128i match = _mm_cmpeq_epi8(
+            _mm_loadu_si128( (const __m128i *)&p[i] ), sync );
+        for( unsigned k = 1; k < i_count; k++ )
+            match = _mm_and_si128( match, _mm_cmpeq_epi8(
+                _mm_loadu_si128( (const __m128i *)&p[i + k * i_stride] ),
+                sync ) );
+
+        const unsigned i_mask = _mm_movemask_epi8( match );
+        if( i_mask )
+            return i + ctz( i_mask );
+    }
+
+    ssize_t i_tail = TsSyncFindC( &p[i], i_data - i, i_stride, i_count );
+    return i_tail >= 0 ? (ssize_t)i + i_tail : -1;
+}
+
+__attribute__ ((__target__ ("avx2")))
+static inline ssize_t TsSyncFindAVX2( const uint8_t *p, size_t i_data,
+                                      size_t i_stride, unsigned i_count )
+{
+    const size_t i_span = (i_count - 1) * i_stride;
+
+    if( i_count == 0 || i_data <= i_span )
+        return -1;
+
+    const size_t i_offsets = i_data - i_span;
+    const __m256i sync = _mm256_set1_epi8( TS_SYNC_BYTE );
+    size_t i = 0;
+
+    for( ; i + 32 <= i_offsets; i += 32 )
+    {
+        __m256i match = _mm256_cmpeq_epi8(
+            _mm256_loadu_si256( (const __m256i *)&p[i] ), sync );
+        for( unsigned k = 1; k < i_count; k++ )
+            match = _mm256_and_si256( match, _mm256_cmpeq_epi8(
+                _mm256_loadu_si256( (const __m256i *)&p[i + k * i_stride] ),
+                sync ) );
+
+        const unsigned i_mask = _mm256_movemask_epi8( match );
+        if( i_mask )
+            return i + ctz( i_mask );
+    }
+
+    ssize_t i_tail = TsSyncFindSSE2( &p[i], i_data - i, i_stride, i_count );
+    return i_tail >= 0 ? (ssize_t)i + i_tail : -1;
+}
+#endif
+
+static inline ssize_t TsSyncFind( const uint8_t *p, size_t i_data,
+                                  size_t i_stride, unsigned i_count )
+{
+#ifdef TS_SYNC_SIMD
+    if( vlc_CPU_AVX2() )
+        return TsSyncFindAVX2( p, i_data, i_stride, i_count );
+    if( vlc_CPU_SSE2() )
+        return TsSyncFindSSE2( p, i_data, i_stride, i_count );
+#endif
+    return TsSyncFindC( p, i_data, i_stride, i_count );
+}
+
+#endif
@@ -41,6 +41,7 @@ DASHDownloader::DASHDownloader  (HTTPConnectionManager *conManager, BlockBuffer
 }
 DASHDownloader::~DASHDownloader ()
 {
+    this->t_sys->conManager->interrupt();
     this->t_sys->buffer->setEOF(true);
     vlc_join(this->dashDLThread, NULL);
     free(this->t_sys);
@@ -58,24 +59,12 @@ void*       DASHDownloader::download    (void *thread_sys)
     thread_sys_t            *t_sys              = (thread_sys_t *) thread_sys;
     HTTPConnectionManager   *conManager         = t_sys->conManager;
     BlockBuffer             *buffer             = t_sys->buffer;
-    block_t                 *block              = block_Alloc(BLOCKSIZE);
-    int                     ret                 = 0;
+    block_t                 *block              = NULL;
 
-    do
-    {
-        ret = conManager->read(block);
-        if(ret > 0)
-        {
-            block_t *bufBlock = block_Alloc(ret);
-            memcpy(bufBlock->p_buffer, block->p_buffer, ret);
-
-            bufBlock->i_length = block->i_length;
-            buffer->put(bufBlock);
-        }
-    }while(ret && !buffer->getEOF());
+    while(!buffer->getEOF() && (block = conManager->read()) != NULL)
+        buffer->put(block);
 
     buffer->setEOF(true);
-    block_Release(block);
 
     return NULL;
 }
@@ -74,6 +74,7 @@ bool    DASHManager::start()
 
     this->conManager->attach(this->adaptationLogic);
     this->buffer->attach(this->adaptationLogic);
+    this->buffer->attach(this->conManager);
 
     return this->downloader->start();
 }
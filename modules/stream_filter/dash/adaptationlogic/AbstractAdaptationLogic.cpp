@@ -55,6 +55,9 @@ void AbstractAdaptationLogic::downloadRateChanged    (uint64_t bpsAvg, uint64_t
     this->bpsAvg        = bpsAvg;
     this->bpsLastChunk  = bpsLastChunk;
 }
+void AbstractAdaptationLogic::chunkDownloaded        (uint64_t)
+{
+}
 uint64_t AbstractAdaptationLogic::getBpsAvg          () const
 {
     return this->bpsAvg;
@@ -67,3 +70,7 @@ int AbstractAdaptationLogic::getBufferPercent        () const
 {
     return this->bufferedPercent;
 }
+mtime_t AbstractAdaptationLogic::getBufferedMicroSec  () const
+{
+    return this->bufferedMicroSec;
+}
@@ -47,11 +47,13 @@ namespace dash
                 virtual ~AbstractAdaptationLogic    ();
 
                 virtual void                downloadRateChanged     (uint64_t bpsAvg, uint64_t bpsLastChunk);
+                virtual void                chunkDownloaded         (uint64_t bpsChunk);
                 virtual void                bufferLevelChanged      (mtime_t bufferedMicroSec, int bufferedPercent);
 
                 uint64_t                    getBpsAvg               () const;
                 uint64_t                    getBpsLastChunk         () const;
                 int                         getBufferPercent        () const;
+                mtime_t                     getBufferedMicroSec     () const;
 
             private:
                 int                     bpsAvg;
@@ -0,0 +1,178 @@
+/*
+ * BufferBasedAdaptationLogic.cpp
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "BufferBasedAdaptationLogic.h"
+#include "RateBasedAdaptationLogic.h"
+
+#include <algorithm>
+
+using namespace dash::logic;
+using namespace dash::xml;
+using namespace dash::http;
+using namespace dash::mpd;
+
+static bool compareBandwidth (const Representation *a, const Representation *b)
+{
+    return a->getBandwidth() < b->getBandwidth();
+}
+
+BufferBasedAdaptationLogic::BufferBasedAdaptationLogic  (IMPDManager *mpdManager, stream_t *stream) :
+                            AbstractAdaptationLogic     (mpdManager, stream),
+                            mpdManager                  (mpdManager),
+                            stream                      (stream),
+                            count                       (0),
+                            currentPeriod               (NULL),
+                            currentRepresentation       (NULL),
+                            width                       (0),
+                            height                      (0)
+{
+    vlc_mutex_init(&this->lock);
+    this->width  = var_InheritInteger(stream, "dash-prefwidth");
+    this->height = var_InheritInteger(stream, "dash-prefheight");
+    this->controller.setBufferCapacity(var_InheritInteger(stream, "dash-buffersize"));
+    this->setPeriod(mpdManager->getFirstPeriod());
+}
+BufferBasedAdaptationLogic::~BufferBasedAdaptationLogic ()
+{
+    vlc_mutex_destroy(&this->lock);
+}
+
+void    BufferBasedAdaptationLogic::setPeriod           (Period *period)
+{
+    this->currentPeriod = period;
+    this->representations.clear();
+
+    if(period == NULL)
+        return;
+
+    /* same preference for the resolution as the other logics */
+    std::vector<Representation *>       all;
+    const std::vector<AdaptationSet *>  &sets = period->getAdaptationSets();
+
+    for(size_t i = 0; i < sets.size(); i++)
+    {
+        std::vector<Representation *> reps = sets.at(i)->getRepresentations();
+        for(size_t j = 0; j < reps.size(); j++)
+        {
+            /* without a bandwidth, there is nothing to weigh */
+            if(reps.at(j)->getBandwidth() == 0)
+                continue;
+            all.push_back(reps.at(j));
+            if(reps.at(j)->getWidth() == this->width && reps.at(j)->getHeight() == this->height)
+                this->representations.push_back(reps.at(j));
+        }
+    }
+    if(this->representations.empty())
+        this->representations = all;
+    if(this->representations.empty())
+        msg_Warn(this->stream, "no representation has a bandwidth, adapting on the download rate");
+
+    std::stable_sort(this->representations.begin(), this->representations.end(), compareBandwidth);
+
+    std::vector<uint64_t> bitrates;
+    for(size_t i = 0; i < this->representations.size(); i++)
+        bitrates.push_back(this->representations.at(i)->getBandwidth());
+    this->controller.setBitrates(bitrates);
+}
+
+void    BufferBasedAdaptationLogic::chunkDownloaded     (uint64_t bpsChunk)
+{
+    /* one sample per chunk, even if two chunks came at the same rate */
+    vlc_mutex_locker locker(&this->lock);
+    this->controller.addThroughputSample(bpsChunk);
+}
+
+Chunk*  BufferBasedAdaptationLogic::getNextChunk        ()
+{
+    if(this->mpdManager == NULL)
+        return NULL;
+
+    if(this->currentPeriod == NULL)
+        return NULL;
+
+    Representation *rep = this->representations.empty() ? this->selectByRate() : this->selectByBuffer();
+    if(rep == NULL)
+        return NULL;
+    this->currentRepresentation = rep;
+
+    std::vector<Segment *> segments = this->mpdManager->getSegments(rep);
+
+    if ( this->count == segments.size() )
+    {
+        this->setPeriod(this->mpdManager->getNextPeriod(this->currentPeriod));
+        this->count = 0;
+        return this->getNextChunk();
+    }
+
+    if ( segments.size() > this->count )
+    {
+        Segment *seg = segments.at( this->count );
+        Chunk *chunk = seg->toChunk();
+        //In case of UrlTemplate, we must stay on the same segment.
+        if ( seg->isSingleShot() == true )
+            this->count++;
+        seg->done();
+        return chunk;
+    }
+    return NULL;
+}
+
+Representation* BufferBasedAdaptationLogic::selectByRate        ()
+{
+    /* same choice as RateBasedAdaptationLogic */
+    uint64_t bitrate = this->getBpsAvg();
+
+    if(this->getBufferPercent() < MINBUFFER)
+        bitrate = 0;
+
+    return this->mpdManager->getRepresentation(this->currentPeriod, bitrate, this->width, this->height);
+}
+
+Representation* BufferBasedAdaptationLogic::selectByBuffer      ()
+{
+    double buffered = (double)this->getBufferedMicroSec() / CLOCK_FREQ;
+
+    vlc_mutex_lock(&this->lock);
+    bool   wasBufferBased = this->controller.isBufferBased();
+    size_t index          = this->controller.select(buffered);
+    uint64_t throughput   = this->controller.getThroughput();
+    bool   isBufferBased  = this->controller.isBufferBased();
+    vlc_mutex_unlock(&this->lock);
+
+    Representation *rep = this->representations.at(index);
+
+    if(wasBufferBased != isBufferBased)
+        msg_Dbg(this->stream, "switching to %s adaptation (%.1fs buffered)",
+                isBufferBased ? "buffer based" : "throughput based", buffered);
+    if(rep != this->currentRepresentation)
+        msg_Dbg(this->stream, "representation %" PRIu64 " bps (throughput %" PRIu64 " bps, "
+                "%.1fs buffered)", rep->getBandwidth(), throughput, buffered);
+    return rep;
+}
+
+const Representation *BufferBasedAdaptationLogic::getCurrentRepresentation() const
+{
+    if(this->currentRepresentation == NULL && !this->representations.empty())
+        return this->representations.front();
+    return this->currentRepresentation;
+}
@@ -0,0 +1,73 @@
+/*
+ * BufferBasedAdaptationLogic.h
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef BUFFERBASEDADAPTATIONLOGIC_H_
+#define BUFFERBASEDADAPTATIONLOGIC_H_
+
+#include "adaptationlogic/AbstractAdaptationLogic.h"
+#include "adaptationlogic/BufferBasedController.h"
+#include "xml/Node.h"
+#include "mpd/IMPDManager.h"
+#include "mpd/AdaptationSet.h"
+#include "mpd/Period.h"
+#include "http/Chunk.h"
+
+#include <vlc_common.h>
+#include <vlc_stream.h>
+
+#include <vector>
+
+namespace dash
+{
+    namespace logic
+    {
+        /* BOLA on the buffer level combined with an EWMA of the throughput,
+         * see BufferBasedController */
+        class BufferBasedAdaptationLogic : public AbstractAdaptationLogic
+        {
+            public:
+                BufferBasedAdaptationLogic          (dash::mpd::IMPDManager *mpdManager, stream_t *stream);
+                virtual ~BufferBasedAdaptationLogic ();
+
+                virtual void        chunkDownloaded         (uint64_t bpsChunk);
+
+                dash::http::Chunk*  getNextChunk            ();
+                const dash::mpd::Representation *getCurrentRepresentation() const;
+
+            private:
+                dash::mpd::IMPDManager              *mpdManager;
+                stream_t                            *stream;
+                size_t                              count;
+                dash::mpd::Period                   *currentPeriod;
+                dash::mpd::Representation           *currentRepresentation;
+                std::vector<dash::mpd::Representation *> representations;
+                BufferBasedController               controller;
+                vlc_mutex_t                         lock;
+                int                                 width;
+                int                                 height;
+
+                void                        setPeriod           (dash::mpd::Period *period);
+                dash::mpd::Representation*  selectByBuffer      ();
+                dash::mpd::Representation*  selectByRate        ();
+        };
+    }
+}
+
+#endif /* BUFFERBASEDADAPTATIONLOGIC_H_ */
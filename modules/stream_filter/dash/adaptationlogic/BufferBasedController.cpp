@@ -0,0 +1,178 @@
+/*
+ * BufferBasedController.cpp
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "BufferBasedController.h"
+
+#include <cmath>
+
+using namespace dash::logic;
+
+/* fraction of the estimated throughput a bitrate may use */
+const double    BufferBasedController::SAFETYFACTOR   = 0.9;
+/* buffer level, relative to the capacity, giving the highest bitrate */
+const double    BufferBasedController::TARGETRATIO    = 0.6;
+/* half-lives of the throughput averages, in samples (downloaded chunks) */
+const double    BufferBasedController::FASTHALFLIFE   = 3.0;
+const double    BufferBasedController::SLOWHALFLIFE   = 8.0;
+
+BufferBasedController::BufferBasedController    () :
+                       bufferTarget             (18.0),
+                       minimumBuffer            (6.0),
+                       Vp                       (0.0),
+                       gp                       (0.0),
+                       ewmaFast                 (0.0),
+                       ewmaSlow                 (0.0),
+                       samples                  (0),
+                       last                     (0),
+                       bufferBased              (false)
+{
+}
+
+void        BufferBasedController::setBitrates          (const std::vector<uint64_t> &bitrates)
+{
+    this->bitrates = bitrates;
+    if(this->last >= this->bitrates.size())
+        this->last = 0;
+    this->updateParameters();
+}
+void        BufferBasedController::setBufferCapacity    (double seconds)
+{
+    /* the highest bitrate must be reachable before the buffer is full,
+     * as the downloader then waits */
+    this->bufferTarget  = seconds * BufferBasedController::TARGETRATIO;
+    this->minimumBuffer = this->bufferTarget / 3 < 10.0 ? this->bufferTarget / 3 : 10.0;
+    this->updateParameters();
+}
+void        BufferBasedController::updateParameters     ()
+{
+    this->utilities.clear();
+    this->Vp = this->gp = 0.0;
+
+    if(this->bitrates.empty())
+        return;
+
+    /* utility of a bitrate is its log relative to the lowest one, plus one */
+    for(size_t i = 0; i < this->bitrates.size(); i++)
+        this->utilities.push_back(log((double)this->bitrates.at(i) / this->bitrates.front()) + 1.0);
+
+    /*
+     * Pick V and gamma so that the lowest bitrate is chosen below
+     * minimumBuffer and the highest one from bufferTarget on.
+     */
+    double ratio = this->bufferTarget / this->minimumBuffer;
+    if(ratio <= 1.0)
+        ratio = 2.0;
+    this->gp = (this->utilities.back() - 1.0) / (ratio - 1.0);
+    if(this->gp <= 0.0) /* single bitrate */
+        this->gp = 1.0;
+    this->Vp = this->minimumBuffer / this->gp;
+}
+void        BufferBasedController::addThroughputSample  (uint64_t bps)
+{
+    if(bps == 0)
+        return;
+
+    double alphaFast = 1.0 - pow(0.5, 1.0 / BufferBasedController::FASTHALFLIFE);
+    double alphaSlow = 1.0 - pow(0.5, 1.0 / BufferBasedController::SLOWHALFLIFE);
+
+    if(this->samples++ == 0)
+    {
+        this->ewmaFast = this->ewmaSlow = bps;
+        return;
+    }
+    this->ewmaFast += alphaFast * (bps - this->ewmaFast);
+    this->ewmaSlow += alphaSlow * (bps - this->ewmaSlow);
+}
+uint64_t    BufferBasedController::getThroughput        () const
+{
+    /* be quick to notice drops and slow to trust increases */
+    return (uint64_t)(this->ewmaFast < this->ewmaSlow ? this->ewmaFast : this->ewmaSlow);
+}
+double      BufferBasedController::getMinimumBuffer     () const
+{
+    return this->minimumBuffer;
+}
+bool        BufferBasedController::isBufferBased        () const
+{
+    return this->bufferBased;
+}
+size_t      BufferBasedController::selectByThroughput   (double bufferedSeconds) const
+{
+    double available = this->getThroughput() * BufferBasedController::SAFETYFACTOR;
+    size_t index     = 0;
+
+    /* with little buffered, a throughput drop would stall at once */
+    if(bufferedSeconds < this->minimumBuffer)
+        available *= bufferedSeconds / this->minimumBuffer;
+
+    for(size_t i = 1; i < this->bitrates.size(); i++)
+        if(this->bitrates.at(i) <= available)
+            index = i;
+
+    return index;
+}
+size_t      BufferBasedController::selectByBuffer       (double bufferedSeconds) const
+{
+    size_t  index = 0;
+    double  best  = 0.0;
+
+    for(size_t i = 0; i < this->bitrates.size(); i++)
+    {
+        double score = (this->Vp * (this->utilities.at(i) + this->gp) - bufferedSeconds) /
+                       this->bitrates.at(i);
+        if(i == 0 || score >= best)
+        {
+            best  = score;
+            index = i;
+        }
+    }
+    return index;
+}
+size_t      BufferBasedController::select               (double bufferedSeconds)
+{
+    if(this->bitrates.empty())
+        return 0;
+
+    size_t byThroughput = this->selectByThroughput(bufferedSeconds);
+
+    /* hysteresis between the start-up and the steady state */
+    if(!this->bufferBased && bufferedSeconds >= this->minimumBuffer)
+        this->bufferBased = true;
+    else if(this->bufferBased && bufferedSeconds < this->minimumBuffer / 2)
+        this->bufferBased = false;
+
+    if(!this->bufferBased)
+    {
+        this->last = byThroughput;
+        return this->last;
+    }
+
+    size_t byBuffer = this->selectByBuffer(bufferedSeconds);
+
+    /* do not go up further than both the previous and the sustainable bitrate */
+    if(byBuffer > this->last && byBuffer > byThroughput)
+        byBuffer = this->last > byThroughput ? this->last : byThroughput;
+
+    this->last = byBuffer;
+    return this->last;
+}
@@ -0,0 +1,84 @@
+/*
+ * BufferBasedController.h
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef BUFFERBASEDCONTROLLER_H_
+#define BUFFERBASEDCONTROLLER_H_
+
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace dash
+{
+    namespace logic
+    {
+        /*
+         * Bitrate selection shared by BufferBasedAdaptationLogic and the
+         * dash-sim harness. It does not depend on VLC nor on the MPD classes.
+         *
+         * While the buffer is low, the highest bitrate below the smoothed
+         * throughput is used. Once it has filled up, the choice is made by
+         * BOLA (Spiteri et al., "BOLA: Near-Optimal Bitrate Adaptation for
+         * Online Videos"), which maps the buffer level to a bitrate, and
+         * upswitches are still limited by the throughput to avoid
+         * oscillations.
+         */
+        class BufferBasedController
+        {
+            public:
+                BufferBasedController                   ();
+
+                /* bitrates in bits per second, in increasing order */
+                void        setBitrates                 (const std::vector<uint64_t> &bitrates);
+                void        setBufferCapacity           (double seconds);
+                void        addThroughputSample         (uint64_t bps);
+                /* index of the bitrate to use given the buffered media */
+                size_t      select                      (double bufferedSeconds);
+
+                uint64_t    getThroughput               () const;
+                double      getMinimumBuffer            () const;
+                bool        isBufferBased               () const;
+
+            private:
+                std::vector<uint64_t>   bitrates;
+                std::vector<double>     utilities;
+                double                  bufferTarget;
+                double                  minimumBuffer;
+                double                  Vp;
+                double                  gp;
+                double                  ewmaFast;
+                double                  ewmaSlow;
+                unsigned                samples;
+                size_t                  last;
+                bool                    bufferBased;
+
+                static const double     SAFETYFACTOR;
+                static const double     TARGETRATIO;
+                static const double     FASTHALFLIFE;
+                static const double     SLOWHALFLIFE;
+
+                void        updateParameters            ();
+                size_t      selectByThroughput          (double bufferedSeconds) const;
+                size_t      selectByBuffer              (double bufferedSeconds) const;
+        };
+    }
+}
+
+#endif /* BUFFERBASEDCONTROLLER_H_ */
@@ -35,6 +35,8 @@ namespace dash
         {
             public:
                 virtual void downloadRateChanged(uint64_t bpsAvg, uint64_t bpsLastChunk) = 0;
+                /* once per completed chunk, with the rate it was received at */
+                virtual void chunkDownloaded    (uint64_t bpsChunk) = 0;
                 virtual ~IDownloadRateObserver(){}
         };
     }
@@ -140,6 +140,7 @@ void    BlockBuffer::put                  (block_t *block)
     {
         vlc_cond_signal(&this->full);
         vlc_mutex_unlock(&this->monitorMutex);
+        block_Release(block);
         return;
     }
 
@@ -0,0 +1,362 @@
+/*
+ * dash-sim.cpp: offline simulation of the DASH adaptation logics
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*
+ * Replays a bandwidth trace against an MPD with a virtual clock, driving the
+ * adaptation logics of the module as DASHManager does, and reports the
+ * rebuffering and bitrates obtained by each of them:
+ *
+ *   dash-sim [file.mpd trace.txt [buffer seconds]]
+ *
+ * The trace has one "<seconds> <kbit/s>" pair per line and is looped.
+ * Without arguments, a built-in MPD and congested trace are used, and the
+ * program fails if the buffer based logic rebuffers more than the rate based
+ * one, so that it can run as a test. The MPD is parsed by the xml module,
+ * which is looked up in VLC_PLUGIN_PATH (the build tree by default).
+ */
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "../../../lib/libvlc_internal.h"
+
+#include <vlc_common.h>
+#include <vlc_stream.h>
+#include <vlc_url.h>
+
+#include "xml/DOMParser.h"
+#include "mpd/MPDFactory.h"
+#include "mpd/MPDManagerFactory.h"
+#include "adaptationlogic/AdaptationLogicFactory.h"
+
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace dash::logic;
+using namespace dash::mpd;
+using namespace dash::xml;
+using namespace dash::http;
+
+static const uint64_t   builtin_bitrates[] = { 350000, 700000, 1200000, 2400000, 4500000 };
+#define BUILTIN_SEGMENTS 150    /* of 2 seconds */
+
+/* congested edge link: long deep drops after good periods */
+static const char builtin_trace[] =
+    "60 5000\n" "30 250\n" "60 4000\n" "30 250\n";
+
+struct trace_t
+{
+    std::vector<double> duration;
+    std::vector<double> bps;
+    double              total;
+};
+
+struct result_t
+{
+    double      rebuffer;
+    unsigned    stalls;
+    unsigned    switches;
+    double      bitrate;    /* average, bits per second */
+};
+
+/* isoff-main, the profile whose parser handles SegmentList */
+static std::string builtinMPD ()
+{
+    std::ostringstream mpd;
+
+    mpd << "<?xml version=\"1.0\"?>\n"
+           "<MPD xmlns=\"urn:mpeg:dash:schema:mpd:2011\" type=\"static\"\n"
+           "     profiles=\"urn:mpeg:dash:profile:isoff-main:2011\"\n"
+           "     mediaPresentationDuration=\"PT" << 2 * BUILTIN_SEGMENTS << "S\" minBufferTime=\"PT2S\">\n"
+           " <Period>\n"
+           "  <AdaptationSet mimeType=\"video/mp4\">\n";
+    for(size_t i = 0; i < sizeof(builtin_bitrates) / sizeof(builtin_bitrates[0]); i++)
+    {
+        mpd << "   <Representation id=\"" << i << "\" bandwidth=\"" << builtin_bitrates[i] << "\">\n"
+               "    <SegmentList>\n";
+        for(unsigned n = 0; n < BUILTIN_SEGMENTS; n++)
+            mpd << "     <SegmentURL media=\"" << builtin_bitrates[i] << "/" << n << ".m4s\"/>\n";
+        mpd << "    </SegmentList>\n"
+               "   </Representation>\n";
+    }
+    mpd << "  </AdaptationSet>\n"
+           " </Period>\n"
+           "</MPD>\n";
+    return mpd.str();
+}
+
+static bool parseTrace (std::istream &in, trace_t *trace)
+{
+    double duration, kbps;
+
+    trace->total = 0;
+    while(in >> duration >> kbps)
+    {
+        if(duration <= 0 || kbps <= 0)
+            return false;
+        trace->duration.push_back(duration);
+        trace->bps.push_back(kbps * 1000);
+        trace->total += duration;
+    }
+    return trace->total > 0;
+}
+
+/* time needed to download some bits starting at a given time */
+static double downloadTime (const trace_t &trace, double start, double bits)
+{
+    double  t   = start;
+    double  off = fmod(start, trace.total);
+    size_t  i   = 0;
+
+    while(off >= trace.duration.at(i))
+        off -= trace.duration.at(i++);
+
+    for(;;)
+    {
+        double left = trace.duration.at(i) - off;
+        double bps  = trace.bps.at(i);
+
+        if(bits <= left * bps)
+            return t + bits / bps - start;
+        bits -= left * bps;
+        t    += left;
+        off   = 0;
+        i     = (i + 1) % trace.duration.size();
+    }
+}
+
+/* segment duration, assuming all segments of a representation are alike */
+static double segmentDuration (IMPDManager *mpdManager)
+{
+    Period *period = mpdManager->getFirstPeriod();
+    if(period == NULL)
+        return 0;
+
+    Representation *rep = mpdManager->getBestRepresentation(period);
+    if(rep == NULL)
+        return 0;
+
+    size_t count = mpdManager->getSegments(rep).size();
+    if(count == 0)
+        return 0;
+    return (double)mpdManager->getMPD()->getDuration() / count;
+}
+
+static result_t simulate (IAdaptationLogic::LogicType type, IMPDManager *mpdManager, stream_t *stream,
+                          const trace_t &trace, double capacity, bool verbose)
+{
+    IAdaptationLogic    *logic    = AdaptationLogicFactory::create(type, mpdManager, stream);
+    result_t            result    = { 0, 0, 0, 0 };
+    double              segment   = segmentDuration(mpdManager);
+    double              duration  = mpdManager->getMPD()->getDuration();
+    double              now       = 0;
+    double              buffer    = 0;
+    double              bits      = 0;  /* whole session, for the average rate */
+    double              time      = 0;
+    bool                playing   = false;
+    uint64_t            last      = 0;
+    unsigned            count     = 0;
+
+    if(logic == NULL || segment <= 0)
+        abort();
+
+    /* template segments never end, stop with the presentation */
+    while(count * segment < duration)
+    {
+        /* the downloader blocks while the buffer is full */
+        if(buffer + segment > capacity)
+        {
+            double idle = buffer + segment - capacity;
+            now    += idle;
+            buffer -= idle;
+        }
+        logic->bufferLevelChanged(buffer * CLOCK_FREQ, buffer * 100 / capacity);
+
+        Chunk *chunk = logic->getNextChunk();
+        if(chunk == NULL)
+            break;
+
+        uint64_t    bitrate = chunk->getBitrate();
+        double      size    = bitrate * segment;
+        double      dt      = downloadTime(trace, now, size);
+        delete chunk;
+
+        if(playing)
+        {
+            if(dt > buffer)
+            {
+                result.rebuffer += dt - buffer;
+                result.stalls++;
+                buffer = 0;
+            }
+            else
+                buffer -= dt;
+        }
+        now    += dt;
+        buffer += segment;
+        playing = true;
+
+        /* what HTTPConnectionManager reports once the chunk is received */
+        bits += size;
+        time += dt;
+        logic->downloadRateChanged(bits / time, size / dt);
+        logic->chunkDownloaded(size / dt);
+
+        if(count > 0 && bitrate != last)
+            result.switches++;
+        last = bitrate;
+        result.bitrate += bitrate;
+        count++;
+
+        if(verbose)
+            printf("%8.2f %3u %9" PRIu64 " %6.2f %6.2f\n", now, count, bitrate, dt, buffer);
+    }
+    if(count > 0)
+        result.bitrate /= count;
+    delete logic;
+    return result;
+}
+
+static void print (const char *name, const result_t &r)
+{
+    printf("%-14s rebuffer %7.2fs in %3u stalls, %4u switches, average %7.0f kbit/s\n",
+           name, r.rebuffer, r.stalls, r.switches, r.bitrate / 1000);
+}
+
+static IMPDManager *openMPD (stream_t *stream)
+{
+    DOMParser parser(stream);
+
+    if(!parser.parse())
+        return NULL;
+
+    MPD *mpd = MPDFactory::create(parser.getRootNode(), stream, parser.getProfile());
+    if(mpd == NULL)
+        return NULL;
+
+    IMPDManager *mpdManager = MPDManagerFactory::create(mpd);
+    if(mpdManager == NULL)
+        delete mpd;
+    return mpdManager;
+}
+
+int main (int argc, char **argv)
+{
+    static const char * const args[] = { "dash-sim", "--ignore-config", "--quiet" };
+
+    trace_t     trace;
+    double      capacity = 30;
+    bool        builtin  = argc < 3;
+    bool        verbose  = getenv("DASH_SIM_VERBOSE") != NULL;
+    std::string text;
+    stream_t    *stream;
+
+    setenv("VLC_PLUGIN_PATH", ".", 0);
+
+    /* environment failures skip the test (automake exit code 77) */
+    libvlc_int_t *vlc = libvlc_InternalCreate();
+    if(vlc == NULL)
+    {
+        fprintf(stderr, "cannot create libvlc instance\n");
+        return 77;
+    }
+    if(libvlc_InternalInit(vlc, sizeof(args) / sizeof(args[0]), (const char **)args))
+    {
+        fprintf(stderr, "cannot initialize libvlc\n");
+        libvlc_InternalDestroy(vlc);
+        return 77;
+    }
+
+    if(builtin)
+    {
+        std::istringstream in(builtin_trace);
+        if(!parseTrace(in, &trace))
+            abort();
+        text   = builtinMPD();
+        stream = stream_MemoryNew(vlc, (uint8_t *)&text[0], text.size(), true);
+    }
+    else
+    {
+        std::ifstream traceFile(argv[2]);
+        if(!traceFile || !parseTrace(traceFile, &trace))
+        {
+            fprintf(stderr, "cannot read bandwidth trace %s\n", argv[2]);
+            return 1;
+        }
+        if(argc > 3)
+            capacity = atof(argv[3]);
+
+        char *uri = strstr(argv[1], "://") ? strdup(argv[1]) : vlc_path2uri(argv[1], NULL);
+        stream    = uri ? stream_UrlNew(vlc, uri) : NULL;
+        free(uri);
+    }
+    if(stream == NULL)
+    {
+        fprintf(stderr, "cannot open %s\n", builtin ? "built-in MPD" : argv[1]);
+        libvlc_InternalCleanup(vlc);
+        libvlc_InternalDestroy(vlc);
+        return builtin ? 77 : 1;
+    }
+
+    /* the built-in MPD is valid, failing to parse it means no xml module */
+    IMPDManager *mpdManager = openMPD(stream);
+    if(mpdManager == NULL)
+    {
+        fprintf(stderr, "cannot read representations from %s\n", builtin ? "built-in MPD" : argv[1]);
+        stream_Delete(stream);
+        libvlc_InternalCleanup(vlc);
+        libvlc_InternalDestroy(vlc);
+        return builtin ? 77 : 1;
+    }
+
+    /* what the logics inherit from the dash module options */
+    var_Create(stream, "dash-prefwidth", VLC_VAR_INTEGER);
+    var_Create(stream, "dash-prefheight", VLC_VAR_INTEGER);
+    var_Create(stream, "dash-buffersize", VLC_VAR_INTEGER);
+    var_SetInteger(stream, "dash-buffersize", capacity);
+
+    printf("%.2fs segments, %llds, buffer %.0fs\n", segmentDuration(mpdManager),
+           (long long)mpdManager->getMPD()->getDuration(), capacity);
+
+    result_t rate   = simulate(IAdaptationLogic::RateBased, mpdManager, stream, trace, capacity, verbose);
+    result_t buffer = simulate(IAdaptationLogic::BufferBased, mpdManager, stream, trace, capacity, verbose);
+
+    print("rate based", rate);
+    print("buffer based", buffer);
+
+    delete mpdManager;
+    stream_Delete(stream);
+    libvlc_InternalCleanup(vlc);
+    libvlc_InternalDestroy(vlc);
+
+    if(builtin && buffer.rebuffer > rate.rebuffer)
+    {
+        fprintf(stderr, "buffer based logic rebuffers more than the rate based one\n");
+        return 1;
+    }
+    return 0;
+}
@@ -61,6 +61,25 @@ static void Close   (vlc_object_t *);
 #define DASH_BUFFER_TEXT N_("Buffer Size (Seconds)")
 #define DASH_BUFFER_LONGTEXT N_("Buffer size in seconds")
 
+#define DASH_LOGIC_TEXT N_("Adaptation logic")
+#define DASH_LOGIC_LONGTEXT N_("Algorithm choosing the representation: " \
+    "from the download rate only, or from the buffer level and a smoothed " \
+    "download rate.")
+
+#define DASH_CONNECTIONS_TEXT N_("Parallel connections")
+#define DASH_CONNECTIONS_LONGTEXT N_("Maximum number of connections opened " \
+    "to each server. Segments given as byte ranges are split into parts " \
+    "fetched over these connections at the same time.")
+
+#define DASH_PIPELINE_TEXT N_("Pipelined requests")
+#define DASH_PIPELINE_LONGTEXT N_("Number of requests sent ahead on each " \
+    "connection without waiting for the previous response.")
+
+static const int pi_logic[] = { dash::logic::IAdaptationLogic::RateBased,
+                                dash::logic::IAdaptationLogic::BufferBased };
+static const char *const ppsz_logic_text[] = { N_("Rate based"),
+                                               N_("Buffer and rate based") };
+
 vlc_module_begin ()
         set_shortname( N_("DASH"))
         set_description( N_("Dynamic Adaptive Streaming over HTTP") )
@@ -70,6 +89,13 @@ vlc_module_begin ()
         add_integer( "dash-prefwidth",  480, DASH_WIDTH_TEXT,  DASH_WIDTH_LONGTEXT,  true )
         add_integer( "dash-prefheight", 360, DASH_HEIGHT_TEXT, DASH_HEIGHT_LONGTEXT, true )
         add_integer( "dash-buffersize", 30, DASH_BUFFER_TEXT, DASH_BUFFER_LONGTEXT, true )
+        add_integer( "dash-logic", dash::logic::IAdaptationLogic::RateBased,
+                     DASH_LOGIC_TEXT, DASH_LOGIC_LONGTEXT, true )
+            change_integer_list( pi_logic, ppsz_logic_text )
+        add_integer_with_range( "dash-connections", 2, 1, 8, DASH_CONNECTIONS_TEXT,
+                                DASH_CONNECTIONS_LONGTEXT, true )
+        add_integer_with_range( "dash-pipeline", 2, 1, 16, DASH_PIPELINE_TEXT,
+                                DASH_PIPELINE_LONGTEXT, true )
         set_callbacks( Open, Close )
 vlc_module_end ()
 
@@ -117,9 +143,10 @@ static int Open(vlc_object_t *p_obj)
         return VLC_ENOMEM;
 
     p_sys->p_mpd = mpd;
+    dash::logic::IAdaptationLogic::LogicType logic =
+        (dash::logic::IAdaptationLogic::LogicType) var_InheritInteger( p_stream, "dash-logic" );
     dash::DASHManager*p_dashManager = new dash::DASHManager(p_sys->p_mpd,
-                                          dash::logic::IAdaptationLogic::RateBased,
-                                          p_stream);
+                                          logic, p_stream);
 
     if(!p_dashManager->start())
     {
@@ -205,7 +232,7 @@ static int  Read            (stream_t *p_stream, void *p_ptr, unsigned int i_len
     while( i_len > 0 )
     {
         i_read = p_dashManager->read( p_buffer, i_len );
-        if( i_read < 0 )
+        if( i_read <= 0 )
             break;
         p_buffer += i_read;
         i_ret += i_read;
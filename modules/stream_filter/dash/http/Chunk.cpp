@@ -37,8 +37,20 @@ Chunk::Chunk        () :
        isHostname   (false),
        length       (0),
        bytesRead    (0),
-       connection   (NULL)
+       connection   (NULL),
+       downloaded   (false),
+       failed       (false),
+       retries      (0),
+       partialBlock (NULL),
+       blocks       (NULL)
 {
+    this->blocksLast = &this->blocks;
+}
+Chunk::~Chunk       ()
+{
+    if(this->partialBlock)
+        block_Release(this->partialBlock);
+    block_ChainRelease(this->blocks);
 }
 
 int                 Chunk::getEndByte           () const
@@ -149,3 +161,53 @@ void                Chunk::setConnection   (IHTTPConnection *connection)
 {
     this->connection = connection;
 }
+bool                Chunk::isDownloaded         () const
+{
+    return this->downloaded;
+}
+void                Chunk::setDownloaded        (bool value)
+{
+    this->downloaded = value;
+}
+bool                Chunk::isFailed             () const
+{
+    return this->failed;
+}
+void                Chunk::setFailed            (bool value)
+{
+    this->failed = value;
+}
+int                 Chunk::getRetries           () const
+{
+    return this->retries;
+}
+void                Chunk::setRetries           (int retries)
+{
+    this->retries = retries;
+}
+block_t*            Chunk::getPartialBlock      ()
+{
+    return this->partialBlock;
+}
+void                Chunk::setPartialBlock      (block_t *block)
+{
+    this->partialBlock = block;
+}
+void                Chunk::pushBlock            (block_t *block)
+{
+    block_ChainLastAppend(&this->blocksLast, block);
+}
+block_t*            Chunk::popBlock             ()
+{
+    block_t *block = this->blocks;
+
+    if(block == NULL)
+        return NULL;
+
+    this->blocks = block->p_next;
+    if(this->blocks == NULL)
+        this->blocksLast = &this->blocks;
+    block->p_next = NULL;
+
+    return block;
+}
@@ -27,6 +27,7 @@
 
 #include <vlc_common.h>
 #include <vlc_url.h>
+#include <vlc_block.h>
 
 #include "IHTTPConnection.h"
 
@@ -42,6 +43,7 @@ namespace dash
         {
             public:
                 Chunk           ();
+                virtual ~Chunk  ();
 
                 int                 getEndByte              () const;
                 int                 getStartByte            () const;
@@ -55,6 +57,9 @@ namespace dash
                 uint64_t            getBytesToRead          () const;
                 size_t              getPercentDownloaded    () const;
                 IHTTPConnection*    getConnection           () const;
+                bool                isDownloaded            () const;
+                bool                isFailed                () const;
+                int                 getRetries              () const;
 
                 void                setConnection   (IHTTPConnection *connection);
                 void                setBytesRead    (uint64_t bytes);
@@ -67,6 +72,13 @@ namespace dash
                 void                setUseByteRange (bool value);
                 void                setBitrate      (uint64_t bitrate);
                 int                 getBitrate      ();
+                void                setDownloaded   (bool value);
+                void                setFailed       (bool value);
+                void                setRetries      (int retries);
+                block_t*            getPartialBlock ();
+                void                setPartialBlock (block_t *block);
+                void                pushBlock       (block_t *block);
+                block_t*            popBlock        ();
 
             private:
                 std::string                 url;
@@ -82,6 +94,12 @@ namespace dash
                 size_t                      length;
                 uint64_t                    bytesRead;
                 IHTTPConnection             *connection;
+                bool                        downloaded;
+                bool                        failed;
+                int                         retries;
+                block_t                     *partialBlock;
+                block_t                     *blocks;
+                block_t                     **blocksLast;
         };
     }
 }
@@ -27,103 +27,176 @@
 
 #include "HTTPConnectionManager.h"
 #include "mpd/Segment.h"
+#include "buffer/BlockBuffer.h"
+#include "Helper.h"
+
+#ifdef HAVE_POLL
+# include <poll.h>
+#endif
 
 using namespace dash::http;
 using namespace dash::logic;
 
-const size_t    HTTPConnectionManager::PIPELINE               = 80;
-const size_t    HTTPConnectionManager::PIPELINELENGTH         = 2;
+const size_t    HTTPConnectionManager::BLOCKSIZE              = 32768;
+const int       HTTPConnectionManager::SUBCHUNKMINSIZE        = 262144;
+const int       HTTPConnectionManager::POLLTIMEOUT            = 100;
 const uint64_t  HTTPConnectionManager::CHUNKDEFAULTBITRATE    = 1;
+const int       HTTPConnectionManager::CHUNKRETRIES           = 3;
 
 HTTPConnectionManager::HTTPConnectionManager    (logic::IAdaptationLogic *adaptationLogic, stream_t *stream) :
                        adaptationLogic          (adaptationLogic),
                        stream                   (stream),
-                       chunkCount               (0),
                        bpsAvg                   (0),
                        bpsLastChunk             (0),
                        bpsCurrentChunk          (0),
                        bytesReadSession         (0),
                        bytesReadChunk           (0),
                        timeSession              (0),
-                       timeChunk                (0)
+                       timeChunk                (0),
+                       bufferedMicroSec         (0),
+                       heldMicroSec             (0)
 {
+    this->maxConnections = __MAX(var_InheritInteger(stream, "dash-connections"), 1);
+    this->pipelineLength = __MAX(var_InheritInteger(stream, "dash-pipeline"), 1);
+
+    /* same capacity as the BlockBuffer the blocks end up in */
+    this->capacityMicroSec = var_InheritInteger(stream, "dash-buffersize") * 1000000;
+    if(this->capacityMicroSec <= 0)
+        this->capacityMicroSec = DEFAULTBUFFERLENGTH;
+
+    vlc_mutex_init(&this->lock);
+    atomic_init(&this->interrupted, false);
 }
 HTTPConnectionManager::~HTTPConnectionManager   ()
 {
     this->closeAllConnections();
+    vlc_mutex_destroy(&this->lock);
 }
 
-void                                HTTPConnectionManager::closeAllConnections      ()
+void                    HTTPConnectionManager::closeAllConnections      ()
 {
     vlc_delete_all(this->connectionPool);
     vlc_delete_all(this->downloadQueue);
 }
-int                                 HTTPConnectionManager::read                     (block_t *block)
+block_t*                HTTPConnectionManager::read                     ()
 {
-    if(this->downloadQueue.size() == 0)
-        if(!this->addChunk(this->adaptationLogic->getNextChunk()))
-            return 0;
-
-    if(this->downloadQueue.front()->getPercentDownloaded() > HTTPConnectionManager::PIPELINE &&
-       this->downloadQueue.size() < HTTPConnectionManager::PIPELINELENGTH)
-        this->addChunk(this->adaptationLogic->getNextChunk());
-
-    int ret = 0;
-
-    mtime_t start = mdate();
-    ret = this->downloadQueue.front()->getConnection()->read(block->p_buffer, block->i_buffer);
-    mtime_t end = mdate();
+    for(;;)
+    {
+        this->fillPipeline();
 
-    block->i_length = (mtime_t)((ret * 8) / ((float)this->downloadQueue.front()->getBitrate() / 1000000));
+        if(this->downloadQueue.size() == 0)
+            return NULL;
 
-    double time = ((double)(end - start)) / 1000000;
+        Chunk   *chunk = this->downloadQueue.front();
+        block_t *block = chunk->popBlock();
 
-    if(ret <= 0)
-    {
-        this->bpsLastChunk   = this->bpsCurrentChunk;
-        this->bytesReadChunk = 0;
-        this->timeChunk      = 0;
+        if(block != NULL)
+        {
+            this->heldMicroSec -= block->i_length;
+            return block;
+        }
 
-        delete(this->downloadQueue.front());
-        this->downloadQueue.pop_front();
+        if(chunk->isDownloaded())
+        {
+            delete chunk;
+            this->downloadQueue.pop_front();
+            continue;
+        }
 
-        return this->read(block);
+        if(!this->receive())
+            return NULL;
     }
-    else
-    {
-        this->updateStatistics(ret, time);
-    }
-
-    return ret;
 }
-void                                HTTPConnectionManager::attach                   (IDownloadRateObserver *observer)
+void                    HTTPConnectionManager::interrupt                ()
+{
+    atomic_store(&this->interrupted, true);
+}
+void                    HTTPConnectionManager::bufferLevelChanged       (mtime_t bufferedMicroSec, int)
+{
+    vlc_mutex_locker locker(&this->lock);
+    this->bufferedMicroSec = bufferedMicroSec;
+}
+void                    HTTPConnectionManager::attach                   (IDownloadRateObserver *observer)
 {
     this->rateObservers.push_back(observer);
 }
-void                                HTTPConnectionManager::notify                   ()
+void                    HTTPConnectionManager::notify                   ()
 {
     if ( this->bpsAvg == 0 )
         return ;
     for(size_t i = 0; i < this->rateObservers.size(); i++)
         this->rateObservers.at(i)->downloadRateChanged(this->bpsAvg, this->bpsLastChunk);
 }
-std::vector<PersistentConnection *> HTTPConnectionManager::getConnectionsForHost    (const std::string &hostname)
+PersistentConnection*   HTTPConnectionManager::getConnectionForHost     (const std::string &hostname)
+{
+    PersistentConnection    *con            = NULL;
+    size_t                  hostConnections = 0;
+
+    this->pruneConnections();
+
+    for(size_t i = 0; i < this->connectionPool.size(); i++)
+    {
+        PersistentConnection *candidate = this->connectionPool.at(i);
+
+        if(candidate->isConnected() && candidate->getHostname().compare(hostname))
+            continue;
+
+        hostConnections++;
+        if(con == NULL || candidate->getPendingChunks() < con->getPendingChunks())
+            con = candidate;
+    }
+
+    /* Open another connection rather than queue behind a busy one */
+    if(con == NULL || (con->getPendingChunks() > 0 && hostConnections < this->maxConnections))
+    {
+        con = new PersistentConnection(this->stream);
+        this->connectionPool.push_back(con);
+    }
+
+    return con;
+}
+PersistentConnection*   HTTPConnectionManager::getIdleConnection        (const std::string &hostname)
 {
-    std::vector<PersistentConnection *> cons;
+    this->pruneConnections();
 
     for(size_t i = 0; i < this->connectionPool.size(); i++)
-        if(!this->connectionPool.at(i)->getHostname().compare(hostname) || !this->connectionPool.at(i)->isConnected())
-            cons.push_back(this->connectionPool.at(i));
+    {
+        PersistentConnection *con = this->connectionPool.at(i);
+
+        if(con->getPendingChunks() == 0 && !con->getHostname().compare(hostname))
+            return con;
+    }
 
-    return cons;
+    PersistentConnection *con = new PersistentConnection(this->stream);
+    this->connectionPool.push_back(con);
+    return con;
 }
-void                                HTTPConnectionManager::updateStatistics         (int bytes, double time)
+void                    HTTPConnectionManager::pruneConnections         ()
+{
+    /* A closed connection with nothing left to read is of no use */
+    for(size_t i = 0; i < this->connectionPool.size();)
+    {
+        PersistentConnection *con = this->connectionPool.at(i);
+
+        if(con->getPendingChunks() == 0 && con->getSocket() == -1)
+        {
+            delete con;
+            this->connectionPool.erase(this->connectionPool.begin() + i);
+        }
+        else
+            i++;
+    }
+}
+void                    HTTPConnectionManager::updateStatistics         (int bytes, double time)
 {
     this->bytesReadSession  += bytes;
     this->bytesReadChunk    += bytes;
     this->timeSession       += time;
     this->timeChunk         += time;
 
+    if(this->timeSession <= 0 || this->timeChunk <= 0)
+        return;
+
     this->bpsAvg            = (int64_t) ((this->bytesReadSession * 8) / this->timeSession);
     this->bpsCurrentChunk   = (int64_t) ((this->bytesReadChunk * 8) / this->timeChunk);
 
@@ -135,32 +208,243 @@ void                                HTTPConnectionManager::updateStatistics
 
     this->notify();
 }
-bool                                HTTPConnectionManager::addChunk                 (Chunk *chunk)
+bool                    HTTPConnectionManager::addChunk                 (Chunk *chunk)
 {
     if(chunk == NULL)
         return false;
 
+    if(chunk->getBitrate() <= 0)
+        chunk->setBitrate(HTTPConnectionManager::CHUNKDEFAULTBITRATE);
+
+    if(!chunk->hasHostname())
+    {
+        std::stringstream ss;
+        ss << this->stream->psz_access << "://" <<
+              dash::Helper::combinePaths(dash::Helper::getDirectoryPath(this->stream->psz_path), chunk->getUrl());
+        chunk->setUrl(ss.str());
+    }
+
+    /* Split large byte ranges so that each connection fetches a part */
+    size_t parts = 1;
+    if(chunk->useByteRange() && chunk->getEndByte() > chunk->getStartByte())
+        parts = (chunk->getEndByte() - chunk->getStartByte() + 1) / HTTPConnectionManager::SUBCHUNKMINSIZE;
+    parts = VLC_CLIP(parts, 1, this->maxConnections);
+
+    if(parts == 1)
+    {
+        this->scheduleChunk(chunk);
+        return true;
+    }
+
+    int start   = chunk->getStartByte();
+    int step    = (chunk->getEndByte() - start + 1) / parts;
+
+    for(size_t i = 0; i < parts; i++)
+    {
+        Chunk *subChunk = new Chunk();
+
+        subChunk->setUrl(chunk->getUrl());
+        subChunk->setUseByteRange(true);
+        subChunk->setStartByte(start + i * step);
+        subChunk->setEndByte(i == parts - 1 ? chunk->getEndByte() : start + (i + 1) * step - 1);
+        subChunk->setBitrate(chunk->getBitrate());
+
+        this->scheduleChunk(subChunk);
+    }
+
+    delete chunk;
+    return true;
+}
+void                    HTTPConnectionManager::scheduleChunk            (Chunk *chunk)
+{
+    PersistentConnection *con = this->getConnectionForHost(chunk->getHostname());
+
     this->downloadQueue.push_back(chunk);
 
-    std::vector<PersistentConnection *> cons = this->getConnectionsForHost(chunk->getHostname());
+    /* Pipelined: the request goes out now, the response is read in turn */
+    if(!con->addChunk(chunk))
+    {
+        /* A connection closed under the pipeline is not reused: the
+         * requests it still carries are sent again when it is read */
+        msg_Warn(this->stream, "cannot request %s, retrying", chunk->getUrl().c_str());
+        con = this->getIdleConnection(chunk->getHostname());
 
-    if(cons.size() == 0)
+        /* Left without a connection, receive() retries it in turn */
+        if(!con->addChunk(chunk))
+            return;
+    }
+    chunk->setConnection(con);
+}
+void                    HTTPConnectionManager::fillPipeline             ()
+{
+    while(this->downloadQueue.size() < this->maxConnections * this->pipelineLength)
+        if(!this->addChunk(this->adaptationLogic->getNextChunk()))
+            break;
+}
+bool                    HTTPConnectionManager::receive                  ()
+{
+    std::vector<PersistentConnection *> active;
+    std::vector<struct pollfd>          ufd;
+    bool                                reopen  = false;
+
+    this->pruneConnections();
+
+    for(size_t i = 0; i < this->connectionPool.size(); i++)
     {
-        PersistentConnection *con = new PersistentConnection(this->stream);
-        this->connectionPool.push_back(con);
-        cons.push_back(con);
+        PersistentConnection *con = this->connectionPool.at(i);
+
+        if(con->getCurrentChunk() == NULL)
+            continue;
+
+        struct pollfd fd;
+        fd.fd       = con->getSocket();
+        fd.events   = POLLIN;
+        fd.revents  = 0;
+
+        /* A lost connection is reopened from read() right away */
+        if(fd.fd == -1)
+            reopen = true;
+
+        active.push_back(con);
+        ufd.push_back(fd);
+    }
+
+    size_t front = 0;
+    while(front < active.size() && active.at(front)->getCurrentChunk() != this->downloadQueue.front())
+        front++;
+
+    if(front == active.size())
+    {
+        /* Nothing in flight can complete the oldest chunk any more */
+        this->retryChunk(this->downloadQueue.front());
+        return true;
     }
 
-    size_t pos = this->chunkCount % cons.size();
+    /* What the pipeline holds counts against the buffer capacity: past
+     * it, only the chunk which is handed over to the buffer is read */
+    vlc_mutex_lock(&this->lock);
+    bool full = this->bufferedMicroSec + this->heldMicroSec >= this->capacityMicroSec;
+    vlc_mutex_unlock(&this->lock);
 
-    cons.at(pos)->addChunk(chunk);
+    if(full)
+    {
+        active = std::vector<PersistentConnection *>(1, active.at(front));
+        ufd    = std::vector<struct pollfd>(1, ufd.at(front));
+        reopen = ufd.at(0).fd == -1;
+    }
 
-    chunk->setConnection(cons.at(pos));
+    mtime_t start = mdate();
+    int     ready;
 
-    this->chunkCount++;
+    do
+    {
+        if(atomic_load(&this->interrupted))
+            return false;
 
-    if(chunk->getBitrate() <= 0)
-        chunk->setBitrate(HTTPConnectionManager::CHUNKDEFAULTBITRATE);
+        ready = poll(&ufd[0], ufd.size(), reopen ? 0 : HTTPConnectionManager::POLLTIMEOUT);
+    } while((ready == 0 && !reopen) || (ready < 0 && errno == EINTR));
+
+    if(ready < 0)
+        return false;
+
+    std::vector<Chunk *>    downloaded;
+    std::vector<Chunk *>    lost;
+    int                     bytes = 0;
+
+    for(size_t i = 0; i < active.size(); i++)
+    {
+        if(ufd[i].fd != -1 && ufd[i].revents == 0)
+            continue;
+
+        PersistentConnection    *con    = active.at(i);
+        Chunk                   *chunk  = con->getCurrentChunk();
+        block_t                 *block  = chunk->getPartialBlock();
+
+        if(block == NULL)
+        {
+            block = block_Alloc(HTTPConnectionManager::BLOCKSIZE);
+            if(block == NULL)
+                return false;
+            block->i_buffer = 0;
+        }
+
+        /* Received straight into the block handed over to the buffer */
+        int ret = con->read(block->p_buffer + block->i_buffer, HTTPConnectionManager::BLOCKSIZE - block->i_buffer);
+        if(ret > 0)
+        {
+            block->i_buffer += ret;
+            bytes           += ret;
+        }
+
+        bool done = (ret <= 0 || chunk->getBytesToRead() == 0);
+
+        chunk->setPartialBlock(NULL);
+        if(block->i_buffer == HTTPConnectionManager::BLOCKSIZE || (done && block->i_buffer > 0))
+        {
+            block->i_length     = (mtime_t)((block->i_buffer * 8) / ((float)chunk->getBitrate() / 1000000));
+            this->heldMicroSec += block->i_length;
+            chunk->pushBlock(block);
+        }
+        else if(block->i_buffer > 0)
+            chunk->setPartialBlock(block);
+        else
+            block_Release(block);
+
+        /* The connection gave up on the chunk and dropped it */
+        if(ret < 0)
+            lost.push_back(chunk);
+        else if(done)
+            downloaded.push_back(chunk);
+    }
+
+    mtime_t end = mdate();
+
+    if(bytes > 0)
+        this->updateStatistics(bytes, ((double)(end - start)) / 1000000);
+
+    /* after the statistics, so that the last bytes count for the chunk */
+    for(size_t i = 0; i < downloaded.size(); i++)
+        this->chunkDownloaded(downloaded.at(i));
+
+    for(size_t i = 0; i < lost.size(); i++)
+        this->retryChunk(lost.at(i));
 
     return true;
 }
+void                    HTTPConnectionManager::retryChunk               (Chunk *chunk)
+{
+    /* The range already skips what was received, see PersistentConnection */
+    while(chunk->getRetries() < HTTPConnectionManager::CHUNKRETRIES)
+    {
+        chunk->setRetries(chunk->getRetries() + 1);
+        msg_Warn(this->stream, "lost %s, requesting it again", chunk->getUrl().c_str());
+
+        /* The connection which dropped it is either busy or closed, and
+         * then pruned: this is another one */
+        PersistentConnection *con = this->getIdleConnection(chunk->getHostname());
+
+        if(con->addChunk(chunk))
+        {
+            chunk->setConnection(con);
+            return;
+        }
+    }
+
+    /* What the chunk still misses is skipped: the logic gets the rate it was
+     * received at, and the buffer only what arrived */
+    msg_Err(this->stream, "cannot download %s, skipping it", chunk->getUrl().c_str());
+    chunk->setFailed(true);
+    this->chunkDownloaded(chunk);
+}
+void                    HTTPConnectionManager::chunkDownloaded          (Chunk *chunk)
+{
+    chunk->setDownloaded(true);
+
+    this->bpsLastChunk   = this->bpsCurrentChunk;
+    this->bytesReadChunk = 0;
+    this->timeChunk      = 0;
+
+    if(this->bpsLastChunk > 0)
+        for(size_t i = 0; i < this->rateObservers.size(); i++)
+            this->rateObservers.at(i)->chunkDownloaded(this->bpsLastChunk);
+}
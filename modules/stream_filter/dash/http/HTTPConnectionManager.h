@@ -26,6 +26,7 @@
 #define HTTPCONNECTIONMANAGER_H_
 
 #include <vlc_common.h>
+#include <vlc_atomic.h>
 
 #include <string>
 #include <vector>
@@ -36,22 +37,25 @@
 
 #include "http/PersistentConnection.h"
 #include "adaptationlogic/IAdaptationLogic.h"
+#include "buffer/IBufferObserver.h"
 
 namespace dash
 {
     namespace http
     {
-        class HTTPConnectionManager
+        class HTTPConnectionManager : public dash::buffer::IBufferObserver
         {
             public:
                 HTTPConnectionManager           (logic::IAdaptationLogic *adaptationLogic, stream_t *stream);
                 virtual ~HTTPConnectionManager  ();
 
-                void    closeAllConnections ();
-                bool    addChunk            (Chunk *chunk);
-                int     read                (block_t *block);
-                void    attach              (dash::logic::IDownloadRateObserver *observer);
-                void    notify              ();
+                void        closeAllConnections ();
+                bool        addChunk            (Chunk *chunk);
+                block_t*    read                ();
+                void        attach              (dash::logic::IDownloadRateObserver *observer);
+                void        notify              ();
+                void        interrupt           ();
+                void        bufferLevelChanged  (mtime_t bufferedMicroSec, int bufferedPercent);
 
             private:
                 std::vector<dash::logic::IDownloadRateObserver *>   rateObservers;
@@ -59,7 +63,9 @@ namespace dash
                 std::vector<PersistentConnection *>                 connectionPool;
                 logic::IAdaptationLogic                             *adaptationLogic;
                 stream_t                                            *stream;
-                int                                                 chunkCount;
+                size_t                                              maxConnections;
+                size_t                                              pipelineLength;
+                atomic_bool                                         interrupted;
                 int64_t                                             bpsAvg;
                 int64_t                                             bpsLastChunk;
                 int64_t                                             bpsCurrentChunk;
@@ -67,13 +73,26 @@ namespace dash
                 int64_t                                             bytesReadChunk;
                 double                                              timeSession;
                 double                                              timeChunk;
+                vlc_mutex_t                                         lock;
+                mtime_t                                             capacityMicroSec;
+                mtime_t                                             bufferedMicroSec;
+                mtime_t                                             heldMicroSec;
 
-                static const size_t     PIPELINE;
-                static const size_t     PIPELINELENGTH;
+                static const size_t     BLOCKSIZE;
+                static const int        SUBCHUNKMINSIZE;
+                static const int        POLLTIMEOUT;
                 static const uint64_t   CHUNKDEFAULTBITRATE;
+                static const int        CHUNKRETRIES;
 
-                std::vector<PersistentConnection *>     getConnectionsForHost   (const std::string &hostname);
-                void                                    updateStatistics        (int bytes, double time);
+                PersistentConnection*   getConnectionForHost    (const std::string &hostname);
+                PersistentConnection*   getIdleConnection       (const std::string &hostname);
+                void                    pruneConnections        ();
+                void                    scheduleChunk           (Chunk *chunk);
+                void                    fillPipeline            ();
+                bool                    receive                 ();
+                void                    retryChunk              (Chunk *chunk);
+                void                    chunkDownloaded         (Chunk *chunk);
+                void                    updateStatistics        (int bytes, double time);
 
         };
     }
@@ -70,6 +70,12 @@ int                 PersistentConnection::read              (void *p_buffer, siz
 
     if(ret <= 0)
     {
+        /* Ask only for the missing part once the connection is back */
+        if(!readChunk->useByteRange())
+        {
+            readChunk->setUseByteRange(true);
+            readChunk->setEndByte(readChunk->getStartByte() + readChunk->getLength() - 1);
+        }
         readChunk->setStartByte(readChunk->getStartByte() + readChunk->getBytesRead());
         readChunk->setBytesRead(0);
         if(!this->reconnect(readChunk))
@@ -83,6 +89,10 @@ int                 PersistentConnection::read              (void *p_buffer, siz
 
     readChunk->setBytesRead(readChunk->getBytesRead() + ret);
 
+    /* The next response starts right after this one on the same socket */
+    if(readChunk->getBytesToRead() == 0)
+        this->chunkQueue.pop_front();
+
     return ret;
 }
 std::string         PersistentConnection::prepareRequest    (Chunk *chunk)
@@ -121,13 +131,17 @@ bool                PersistentConnection::init              (Chunk *chunk)
     if(this->httpSocket == -1)
         return false;
 
-    if(this->sendData(this->prepareRequest(chunk)))
-        this->isInit = true;
+    if(!this->sendData(this->prepareRequest(chunk)))
+    {
+        this->closeSocket();
+        return false;
+    }
 
+    this->isInit = true;
     this->chunkQueue.push_back(chunk);
     this->hostname = chunk->getHostname();
 
-    return this->isInit;
+    return true;
 }
 bool                PersistentConnection::addChunk          (Chunk *chunk)
 {
@@ -150,6 +164,12 @@ bool                PersistentConnection::addChunk          (Chunk *chunk)
         return true;
     }
 
+    /* Nothing left to read on it: connect afresh next time */
+    if(this->chunkQueue.size() == 0)
+    {
+        this->closeSocket();
+        this->isInit = false;
+    }
     return false;
 }
 bool                PersistentConnection::initChunk         (Chunk *chunk)
@@ -173,15 +193,19 @@ bool                PersistentConnection::initChunk         (Chunk *chunk)
 }
 bool                PersistentConnection::reconnect         (Chunk *chunk)
 {
-    int         count   = 0;
-    std::string request = this->prepareRequest(chunk);
+    int count = 0;
+
+    this->closeSocket();
 
     while(count < this->RETRY)
     {
         this->httpSocket = net_ConnectTCP(this->stream, chunk->getHostname().c_str(), chunk->getPort());
         if(this->httpSocket != -1)
+        {
             if(this->resendAllRequests())
                 return true;
+            this->closeSocket();
+        }
 
         count++;
     }
@@ -196,6 +220,21 @@ bool                PersistentConnection::isConnected       () const
 {
     return this->isInit;
 }
+Chunk*              PersistentConnection::getCurrentChunk   () const
+{
+    if(this->chunkQueue.size() == 0)
+        return NULL;
+
+    return this->chunkQueue.front();
+}
+size_t              PersistentConnection::getPendingChunks  () const
+{
+    return this->chunkQueue.size();
+}
+int                 PersistentConnection::getSocket         () const
+{
+    return this->httpSocket;
+}
 bool                PersistentConnection::resendAllRequests ()
 {
     for(size_t i = 0; i < this->chunkQueue.size(); i++)
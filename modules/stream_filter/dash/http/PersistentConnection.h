@@ -43,6 +43,9 @@ namespace dash
                 bool                addChunk    (Chunk *chunk);
                 const std::string&  getHostname () const;
                 bool                isConnected () const;
+                Chunk*              getCurrentChunk     () const;
+                size_t              getPendingChunks    () const;
+                int                 getSocket           () const;
 
             private:
                 std::deque<Chunk *>  chunkQueue;
@@ -43,6 +43,8 @@
 #include <vlc_memory.h>
 #include <vlc_gcrypt.h>
 #include <vlc_atomic.h>
+#include <vlc_network.h>
+#include <vlc_url.h>
 
 /*****************************************************************************
  * Module descriptor
@@ -50,11 +52,31 @@
 static int  Open (vlc_object_t *);
 static void Close(vlc_object_t *);
 
+#define PARALLEL_TEXT N_("Parallel segment downloads")
+#define PARALLEL_LONGTEXT N_("Number of segments downloaded at the same " \
+    "time. More than one helps on links with a long round-trip time.")
+#define LOOKAHEAD_TEXT N_("Segments downloaded ahead")
+#define LOOKAHEAD_LONGTEXT N_("Maximum number of segments downloaded " \
+    "ahead of the playback position.")
+#define BUFFER_TEXT N_("Download buffer size (MiB)")
+#define BUFFER_LONGTEXT N_("Segments are not downloaded further ahead " \
+    "once this much data is waiting to be played.")
+#define KEEPALIVE_TEXT N_("Reuse HTTP connections")
+#define KEEPALIVE_LONGTEXT N_("Download the segments over persistent " \
+    "HTTP/1.1 connections instead of opening one per segment.")
+
 vlc_module_begin()
     set_category(CAT_INPUT)
     set_subcategory(SUBCAT_INPUT_STREAM_FILTER)
     set_description(N_("Http Live Streaming stream filter"))
     set_capability("stream_filter", 20)
+    add_integer("hls-parallel", 3, PARALLEL_TEXT, PARALLEL_LONGTEXT, true)
+        change_integer_range(1, 16)
+    add_integer("hls-lookahead", 6, LOOKAHEAD_TEXT, LOOKAHEAD_LONGTEXT, true)
+        change_integer_range(1, 60)
+    add_integer("hls-buffer-size", 64, BUFFER_TEXT, BUFFER_LONGTEXT, true)
+        change_integer_range(1, 4096)
+    add_bool("hls-keepalive", true, KEEPALIVE_TEXT, KEEPALIVE_LONGTEXT, true)
     set_callbacks(Open, Close)
 vlc_module_end()
 
@@ -99,11 +121,20 @@ typedef struct hls_stream_s
     bool         b_iv_loaded;
 } hls_stream_t;
 
+/* persistent HTTP connection of a download thread */
+typedef struct hls_conn_s
+{
+    int         fd;
+    char        *psz_host;
+    unsigned    i_port;
+} hls_conn_t;
+
 struct stream_sys_t
 {
     char         *m3u8;         /* M3U8 url */
     vlc_thread_t  reload;       /* HLS m3u8 reload thread */
-    vlc_thread_t  thread;       /* HLS segment download thread */
+    vlc_thread_t *threads;      /* HLS segment download threads */
+    unsigned      i_threads;
 
     block_t      *peeked;
 
@@ -115,12 +146,29 @@ struct stream_sys_t
     struct hls_download_s
     {
         int         stream;     /* current hls_stream  */
-        int         segment;    /* current segment for downloading */
+        int         segment;    /* first segment not downloaded yet */
+        int         next;       /* next segment to hand to a download thread */
+        uint64_t    done;       /* segments downloaded after segment (bitmap) */
+        unsigned    epoch;      /* incremented on each seek */
         int         seek;       /* segment requested by seek (default -1) */
+        int         lookahead;  /* segments to download ahead of playback */
+        uint64_t    buffered;   /* downloaded bytes waiting to be played */
+        uint64_t    buffer_max;
+        bool        keepalive;
         vlc_mutex_t lock_wait;  /* protect segment download counter */
         vlc_cond_t  wait;       /* some condition to wait on */
+        vlc_mutex_t lock_key;   /* serializes AES keys loading */
     } download;
 
+    /* Download statistics, also exported as "hls-*" object variables */
+    struct hls_stats_s
+    {
+        uint64_t    bytes;      /* total bytes downloaded */
+        unsigned    segments;   /* segments downloaded */
+        unsigned    reused;     /* segments downloaded on a reused connection */
+        uint64_t    rate;       /* smoothed download rate (bits per second) */
+    } stats;
+
     /* Playback */
     struct hls_playback_s
     {
@@ -169,7 +217,8 @@ static ssize_t read_M3U8_from_stream(stream_t *s, uint8_t **buffer);
 static ssize_t read_M3U8_from_url(stream_t *s, const char *psz_url, uint8_t **buffer);
 static char *ReadLine(uint8_t *buffer, uint8_t **pos, size_t len);
 
-static int hls_Download(stream_t *s, segment_t *segment);
+static int hls_Download(stream_t *s, segment_t *segment, hls_conn_t *conn);
+static void hls_ConnClose(void *);
 
 static void* hls_Thread(void *);
 static void* hls_Reload(void *);
@@ -1262,7 +1311,12 @@ static int hls_DecodeSegmentData(stream_t *s, hls_stream_t *hls, segment_t *segm
     if (!segment->b_key_loaded)
     {
         /* No ? try to download it now */
-        if (hls_ManageSegmentKeys(s, hls) != VLC_SUCCESS)
+        stream_sys_t *p_sys = s->p_sys;
+
+        vlc_mutex_lock(&p_sys->download.lock_key);
+        int i_ret = hls_ManageSegmentKeys(s, hls);
+        vlc_mutex_unlock(&p_sys->download.lock_key);
+        if (i_ret != VLC_SUCCESS)
             return VLC_EGENERIC;
     }
 
@@ -1289,17 +1343,21 @@ static int hls_DecodeSegmentData(stream_t *s, hls_stream_t *hls, segment_t *segm
         return VLC_EGENERIC;
     }
 
+    /* segments may be decoded concurrently: do not store the IV */
+    uint8_t iv[AES_BLOCK_SIZE];
+
     if (hls->b_iv_loaded == false)
     {
-        memset(hls->psz_AES_IV, 0, AES_BLOCK_SIZE);
-        hls->psz_AES_IV[15] = segment->sequence & 0xff;
-        hls->psz_AES_IV[14] = (segment->sequence >> 8)& 0xff;
-        hls->psz_AES_IV[13] = (segment->sequence >> 16)& 0xff;
-        hls->psz_AES_IV[12] = (segment->sequence >> 24)& 0xff;
+        memset(iv, 0, AES_BLOCK_SIZE);
+        iv[15] = segment->sequence & 0xff;
+        iv[14] = (segment->sequence >> 8)& 0xff;
+        iv[13] = (segment->sequence >> 16)& 0xff;
+        iv[12] = (segment->sequence >> 24)& 0xff;
     }
+    else
+        memcpy(iv, hls->psz_AES_IV, AES_BLOCK_SIZE);
 
-    i_gcrypt_err = gcry_cipher_setiv(aes_ctx, hls->psz_AES_IV,
-                                      sizeof(hls->psz_AES_IV));
+    i_gcrypt_err = gcry_cipher_setiv(aes_ctx, iv, sizeof(iv));
 
     if (i_gcrypt_err)
     {
@@ -1527,11 +1585,11 @@ static int hls_ReloadPlaylist(stream_t *s)
     }
     vlc_array_destroy(hls_streams);
 
-    // Must signal the download thread otherwise new segments will not be downloaded at all!
+    // Must signal the download threads otherwise new segments will not be downloaded at all!
     if (stream_appended == true)
     {
         vlc_mutex_lock(&p_sys->download.lock_wait);
-        vlc_cond_signal(&p_sys->download.wait);
+        vlc_cond_broadcast(&p_sys->download.wait);
         vlc_mutex_unlock(&p_sys->download.lock_wait);
     }
 
@@ -1571,7 +1629,10 @@ static int BandwidthAdaptation(stream_t *s, int progid, uint64_t *bandwidth)
     return candidate;
 }
 
-static int hls_DownloadSegmentData(stream_t *s, hls_stream_t *hls, segment_t *segment, int *cur_stream)
+/* Downloads segment number index of hls, for the download epoch epoch */
+static int hls_DownloadSegmentData(stream_t *s, hls_stream_t *hls, segment_t *segment,
+                                   int index, unsigned epoch,
+                                   int *cur_stream, hls_conn_t *conn)
 {
     stream_sys_t *p_sys = s->p_sys;
 
@@ -1599,8 +1660,9 @@ static int hls_DownloadSegmentData(stream_t *s, hls_stream_t *hls, segment_t *se
     }
 
     mtime_t start = mdate();
+    bool b_reused = conn->fd != -1;
 
-    int i_ret = hls_Download(s, segment);
+    int i_ret = hls_Download(s, segment, conn);
     if (i_ret != VLC_SUCCESS)
     {
         msg_Err(s, "downloading segment %d from stream %d failed",
@@ -1624,11 +1686,33 @@ static int hls_DownloadSegmentData(stream_t *s, hls_stream_t *hls, segment_t *se
     if(i_ret != VLC_SUCCESS)
         return i_ret;
 
-    msg_Dbg(s, "downloaded segment %d from stream %d",
-                segment->sequence, *cur_stream);
-
     uint64_t bw = segment->size * 8 * 1000000 / __MAX(1, duration); /* bits / s */
+
+    msg_Dbg(s, "downloaded segment %d from stream %d (%"PRIu64" kbit/s%s)",
+                segment->sequence, *cur_stream, bw / 1000,
+                b_reused ? ", reused connection" : "");
+
+    vlc_mutex_lock(&p_sys->download.lock_wait);
     p_sys->bandwidth = bw;
+    /* a download started before a seek, or overtaken by playback, will not
+     * be played from the buffer */
+    if (epoch == p_sys->download.epoch && index >= p_sys->playback.segment)
+        p_sys->download.buffered += segment->size;
+    p_sys->stats.bytes += segment->size;
+    p_sys->stats.segments++;
+    if (b_reused)
+        p_sys->stats.reused++;
+    /* smooth the rate, a single segment says little with parallel downloads */
+    if (p_sys->stats.rate == 0)
+        p_sys->stats.rate = bw;
+    else
+        p_sys->stats.rate = (p_sys->stats.rate * 3 + bw) / 4;
+    var_SetInteger(s, "hls-download-rate", p_sys->stats.rate);
+    var_SetInteger(s, "hls-downloaded-bytes", p_sys->stats.bytes);
+    var_SetInteger(s, "hls-downloaded-segments", p_sys->stats.segments);
+    var_SetInteger(s, "hls-reused-connections", p_sys->stats.reused);
+    vlc_mutex_unlock(&p_sys->download.lock_wait);
+
     if (p_sys->b_meta && (hls->bandwidth != bw))
     {
         int newstream = BandwidthAdaptation(s, hls->id, &bw);
@@ -1644,89 +1728,136 @@ static int hls_DownloadSegmentData(stream_t *s, hls_stream_t *hls, segment_t *se
     return VLC_SUCCESS;
 }
 
+/* Tells if fewer segments are downloaded ahead of playback than wanted.
+ * The download threads stop at the lookahead or when the buffer is full,
+ * so a shorter lookahead or a full buffer is not a shortage. */
+static bool hls_ShortOfSegments(const stream_sys_t *p_sys)
+{
+    return p_sys->download.segment - p_sys->playback.segment
+               < __MIN(3, p_sys->download.lookahead)
+        && p_sys->download.buffered < p_sys->download.buffer_max;
+}
+
+/* Hands the next segment to download to a download thread, or returns -1
+ * if there is none for now (download.lock_wait held) */
+static int hls_ClaimSegment(stream_t *s, int count)
+{
+    stream_sys_t *p_sys = s->p_sys;
+    int wanted = p_sys->download.next;
+
+    if (wanted >= count)
+        return -1;
+    /* do not go too far ahead of playback, but always fetch what it needs */
+    if (wanted > p_sys->playback.segment &&
+        (wanted - p_sys->playback.segment >= p_sys->download.lookahead ||
+         p_sys->download.buffered >= p_sys->download.buffer_max))
+        return -1;
+    if (wanted - p_sys->download.segment >= 64)
+        return -1; /* out of bitmap */
+
+    p_sys->download.next++;
+    return wanted;
+}
+
+/* Records a finished download, successful or not (download.lock_wait held) */
+static void hls_SegmentDone(stream_t *s, int segment, unsigned epoch)
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    if (epoch != p_sys->download.epoch || segment < p_sys->download.segment)
+        return; /* seek in the mean time */
+
+    p_sys->download.done |= UINT64_C(1) << (segment - p_sys->download.segment);
+    while (p_sys->download.done & 1)
+    {
+        p_sys->download.done >>= 1;
+        p_sys->download.segment++;
+    }
+}
+
 static void* hls_Thread(void *p_this)
 {
     stream_t *s = (stream_t *)p_this;
     stream_sys_t *p_sys = s->p_sys;
+    hls_conn_t conn = { .fd = -1, .psz_host = NULL };
 
+    vlc_cleanup_push(hls_ConnClose, &conn);
     for( ;; )
     {
+        vlc_mutex_lock(&p_sys->lock);
+        mutex_cleanup_push(&p_sys->lock); //C1
+        while (p_sys->paused)
+            vlc_cond_wait(&p_sys->wait, &p_sys->lock);
+        vlc_cleanup_run( ); //C1 vlc_mutex_unlock(&p_sys->lock);
+
         hls_stream_t *hls = hls_Get(p_sys->hls_stream, p_sys->download.stream);
         assert(hls);
 
-        /* Sliding window (~60 seconds worth of movie) */
         vlc_mutex_lock(&hls->lock);
         int count = vlc_array_count(hls->segments);
         vlc_mutex_unlock(&hls->lock);
 
         /* Is there a new segment to process? */
-        if ((!p_sys->b_live && (p_sys->playback.segment < (count - 6))) ||
-            (p_sys->download.segment >= count))
-        {
-            /* wait */
-            vlc_mutex_lock(&p_sys->download.lock_wait);
-            mutex_cleanup_push(&p_sys->download.lock_wait); //CO
-            while (((p_sys->download.segment - p_sys->playback.segment > 6) ||
-                    (p_sys->download.segment >= count)) &&
-                   (p_sys->download.seek == -1))
-            {
-
-                if(!p_sys->b_live && p_sys->download.segment >= count)
-                {
-                    /* this was last segment to read */
-                    atomic_store(&p_sys->eof, true);
-                }
+        int stream, wanted;
+        unsigned epoch;
 
-                vlc_cond_wait(&p_sys->download.wait, &p_sys->download.lock_wait);
-                if (p_sys->b_live /*&& (mdate() >= p_sys->playlist.wakeup)*/)
-                    break;
-            }
-            vlc_cleanup_pop( ); //CO
+        vlc_mutex_lock(&p_sys->download.lock_wait);
+        mutex_cleanup_push(&p_sys->download.lock_wait); //CO
+        if (p_sys->download.seek >= 0)
+        {
+            p_sys->download.segment = p_sys->download.seek;
+            p_sys->download.next = p_sys->download.seek;
+            p_sys->download.done = 0;
+            p_sys->download.buffered = 0;
+            p_sys->download.epoch++;
+            p_sys->download.seek = -1;
+            atomic_store(&p_sys->eof, false);
+        }
 
-            /* */
-            if (p_sys->download.seek >= 0)
+        stream = p_sys->download.stream;
+        epoch = p_sys->download.epoch;
+        wanted = hls_ClaimSegment(s, count);
+        if (wanted < 0)
+        {
+            if (!p_sys->b_live && p_sys->download.segment >= count)
             {
-                p_sys->download.segment = p_sys->download.seek;
-                p_sys->download.seek = -1;
-                atomic_store(&p_sys->eof, false);
+                /* this was last segment to read */
+                atomic_store(&p_sys->eof, true);
             }
 
-            vlc_mutex_unlock(&p_sys->download.lock_wait);
+            /* wait for playback, a seek, a reload or another download */
+            vlc_cond_wait(&p_sys->download.wait, &p_sys->download.lock_wait);
         }
+        vlc_cleanup_pop( ); //CO
+        vlc_mutex_unlock(&p_sys->download.lock_wait);
 
-        vlc_mutex_lock(&p_sys->lock);
-        mutex_cleanup_push(&p_sys->lock); //C1
-        while (p_sys->paused)
-            vlc_cond_wait(&p_sys->wait, &p_sys->lock);
-        vlc_cleanup_run( ); //C1 vlc_mutex_unlock(&p_sys->lock);
+        if (wanted < 0)
+            continue;
 
+        hls = hls_Get(p_sys->hls_stream, stream);
         vlc_mutex_lock(&hls->lock);
-        segment_t *segment = segment_GetSegment(hls, p_sys->download.segment);
+        segment_t *segment = segment_GetSegment(hls, wanted);
         vlc_mutex_unlock(&hls->lock);
 
         int i_canc = vlc_savecancel();
-        if ((segment != NULL) &&
-            (hls_DownloadSegmentData(s, hls, segment, &p_sys->download.stream) != VLC_SUCCESS))
+        int cur_stream = stream;
+        bool b_failed = (segment != NULL) &&
+            (hls_DownloadSegmentData(s, hls, segment, wanted, epoch,
+                                     &cur_stream, &conn) != VLC_SUCCESS);
+        vlc_restorecancel(i_canc);
+
+        if (b_failed && !p_sys->b_live)
         {
-            if (!p_sys->b_live)
-            {
-                p_sys->b_error = true;
-                break;
-            }
+            p_sys->b_error = true;
+            break;
         }
-        vlc_restorecancel(i_canc);
 
-        /* download succeeded */
         /* determine next segment to download */
         vlc_mutex_lock(&p_sys->download.lock_wait);
-        if (p_sys->download.seek >= 0)
-        {
-            p_sys->download.segment = p_sys->download.seek;
-            p_sys->download.seek = -1;
-        }
-        else if (p_sys->download.segment < count)
-            p_sys->download.segment++;
-        vlc_cond_signal(&p_sys->download.wait);
+        hls_SegmentDone(s, wanted, epoch);
+        if (cur_stream != stream && epoch == p_sys->download.epoch)
+            p_sys->download.stream = cur_stream;
+        vlc_cond_broadcast(&p_sys->download.wait);
         vlc_mutex_unlock(&p_sys->download.lock_wait);
 
         // In case of a successful download signal the read thread that data is available
@@ -1736,7 +1867,12 @@ static void* hls_Thread(void *p_this)
 
         vlc_testcancel();
     }
+    vlc_cleanup_run( );
 
+    /* wake up the reader */
+    vlc_mutex_lock(&p_sys->read.lock_wait);
+    vlc_cond_signal(&p_sys->read.wait);
+    vlc_mutex_unlock(&p_sys->read.lock_wait);
     return NULL;
 }
 
@@ -1756,7 +1892,7 @@ static void* hls_Reload(void *p_this)
             int canc = vlc_savecancel();
 
             /* reload the m3u8 if there are less than 3 segments what aren't downloaded */
-            if ( ( p_sys->download.segment - p_sys->playback.segment < 3 ) &&
+            if ( hls_ShortOfSegments(p_sys) &&
                  ( hls_ReloadPlaylist(s) != VLC_SUCCESS) )
             {
                 /* No change in playlist, then backoff */
@@ -1766,7 +1902,7 @@ static void* hls_Reload(void *p_this)
                 else if (p_sys->playlist.tries >= 3) wait = 1.5;
 
                 /* Can we afford to backoff? */
-                if (p_sys->download.segment - p_sys->playback.segment < 3)
+                if (hls_ShortOfSegments(p_sys))
                 {
                     p_sys->playlist.tries = 0;
                     wait = 0.5;
@@ -1803,6 +1939,8 @@ static int Prefetch(stream_t *s, int *current)
 {
     stream_sys_t *p_sys = s->p_sys;
     int stream = *current;
+    hls_conn_t conn = { .fd = -1, .psz_host = NULL };
+    int i_ret = VLC_SUCCESS;
 
     hls_stream_t *hls = hls_Get(p_sys->hls_stream, stream);
     if (hls == NULL)
@@ -1819,7 +1957,10 @@ static int Prefetch(stream_t *s, int *current)
     {
         segment_t *segment = segment_GetSegment(hls, p_sys->download.segment);
         if (segment == NULL )
-            return VLC_EGENERIC;
+        {
+            i_ret = VLC_EGENERIC;
+            break;
+        }
 
         /* It is useless to lock the segment here, as Prefetch is called before
            download and playlit thread are started. */
@@ -1829,8 +1970,12 @@ static int Prefetch(stream_t *s, int *current)
             continue;
         }
 
-        if (hls_DownloadSegmentData(s, hls, segment, current) != VLC_SUCCESS)
-            return VLC_EGENERIC;
+        if (hls_DownloadSegmentData(s, hls, segment, p_sys->download.segment,
+                                    p_sys->download.epoch, current, &conn) != VLC_SUCCESS)
+        {
+            i_ret = VLC_EGENERIC;
+            break;
+        }
 
         p_sys->download.segment++;
 
@@ -1839,13 +1984,17 @@ static int Prefetch(stream_t *s, int *current)
         {
             hls_stream_t *hls = hls_Get(p_sys->hls_stream, *current);
             if (hls == NULL)
-                return VLC_EGENERIC;
+            {
+                i_ret = VLC_EGENERIC;
+                break;
+            }
 
              stream = *current;
         }
     }
 
-    return VLC_SUCCESS;
+    hls_ConnClose(&conn);
+    return i_ret;
 }
 
 /****************************************************************************
@@ -1853,11 +2002,256 @@ static int Prefetch(stream_t *s, int *current)
  ****************************************************************************/
 #define HLS_READ_SIZE 65536
 
-static int hls_Download(stream_t *s, segment_t *segment)
+static void hls_ConnClose(void *data)
+{
+    hls_conn_t *conn = data;
+
+    if (conn->fd != -1)
+        net_Close(conn->fd);
+    conn->fd = -1;
+    free(conn->psz_host);
+    conn->psz_host = NULL;
+}
+
+/* Reads an HTTP/1.1 message body, either of known length (i_length >= 0),
+ * chunked or up to the end of the connection */
+static block_t *hls_HttpReadBody(stream_t *s, int fd, int64_t i_length,
+                                 bool b_chunked)
+{
+    stream_sys_t *p_sys = s->p_sys;
+    block_t *p_chain = NULL, **pp_last = &p_chain;
+
+    for (;;)
+    {
+        int64_t i_chunk = i_length;
+
+        if (b_chunked)
+        {
+            char *psz = net_Gets(s, fd, NULL);
+            if (psz == NULL)
+                goto error;
+            i_chunk = strtoll(psz, NULL, 16);
+            free(psz);
+            if (i_chunk == 0)
+            {
+                /* skip the trailer */
+                while ((psz = net_Gets(s, fd, NULL)) != NULL && *psz)
+                    free(psz);
+                if (psz == NULL)
+                    goto error;
+                free(psz);
+                break;
+            }
+            if (i_chunk < 0)
+                goto error;
+        }
+
+        /* read the chunk, or the whole body, HLS_READ_SIZE at a time */
+        block_t *p_block = block_Alloc(i_chunk >= 0 ? i_chunk : HLS_READ_SIZE);
+        if (p_block == NULL)
+            goto error;
+
+        size_t i_total = 0;
+        while (i_total < p_block->i_buffer)
+        {
+            size_t i_toread = __MIN(p_block->i_buffer - i_total, HLS_READ_SIZE);
+            ssize_t i_read = net_Read(s, fd, NULL, &p_block->p_buffer[i_total],
+                                      i_toread, true);
+            if (i_read <= 0)
+                break;
+            i_total += i_read;
+
+            if (atomic_load(&p_sys->closing))
+                break;
+        }
+
+        block_ChainLastAppend(&pp_last, p_block);
+        if (i_total < p_block->i_buffer)
+        {
+            p_block->i_buffer = i_total;
+            if (i_chunk >= 0 || atomic_load(&p_sys->closing))
+                goto error;
+            break; /* end of connection */
+        }
+
+        if (b_chunked)
+        {
+            char *psz = net_Gets(s, fd, NULL); /* CRLF after the chunk data */
+            if (psz == NULL)
+                goto error;
+            free(psz);
+        }
+        else if (i_length >= 0)
+            break;
+    }
+
+    return block_ChainGather(p_chain);
+
+error:
+    block_ChainRelease(p_chain);
+    return NULL;
+}
+
+/* Downloads an http:// URL over the persistent connection of the download
+ * thread. Returns NULL if that was not possible, so that the caller falls
+ * back to the generic access. */
+static block_t *hls_HttpGet(stream_t *s, hls_conn_t *conn, const char *psz_url)
+{
+    block_t *p_data = NULL;
+    vlc_url_t url;
+
+    vlc_UrlParse(&url, psz_url, '?');
+    if (url.psz_protocol == NULL || strcasecmp(url.psz_protocol, "http")
+     || url.psz_host == NULL || url.psz_username != NULL
+     || url.psz_password != NULL)
+        goto out;
+
+    /* let the http access deal with proxies */
+    char *psz_proxy = var_InheritString(s, "http-proxy");
+    if (psz_proxy == NULL)
+        psz_proxy = vlc_getProxyUrl(psz_url);
+    if (psz_proxy != NULL)
+    {
+        free(psz_proxy);
+        goto out;
+    }
+
+    unsigned i_port = url.i_port > 0 ? url.i_port : 80;
+    if (conn->fd != -1 &&
+        (conn->i_port != i_port || strcasecmp(conn->psz_host, url.psz_host)))
+        hls_ConnClose(conn);
+
+    char *psz_agent = var_InheritString(s, "http-user-agent");
+    bool b_ipv6 = strchr(url.psz_host, ':') != NULL;
+    char *psz_status = NULL;
+
+    for (int i_try = 0; i_try < 2 && psz_status == NULL; i_try++)
+    {
+        bool b_reused = conn->fd != -1;
+
+        if (!b_reused)
+        {
+            conn->fd = net_ConnectTCP(s, url.psz_host, i_port);
+            if (conn->fd == -1)
+                break;
+            conn->psz_host = strdup(url.psz_host);
+            conn->i_port = i_port;
+        }
+
+        if (net_Printf(s, conn->fd, NULL,
+                       "GET %s%s%s HTTP/1.1\r\n"
+                       "Host: %s%s%s:%u\r\n"
+                       "User-Agent: %s\r\n"
+                       "Connection: Keep-Alive\r\n\r\n",
+                       url.psz_path ? url.psz_path : "/",
+                       url.psz_option ? "?" : "",
+                       url.psz_option ? url.psz_option : "",
+                       b_ipv6 ? "[" : "", url.psz_host, b_ipv6 ? "]" : "",
+                       i_port, psz_agent ? psz_agent : PACKAGE_NAME) >= 0)
+            psz_status = net_Gets(s, conn->fd, NULL);
+
+        if (psz_status == NULL)
+        {
+            /* the server may have closed an idle connection: retry once */
+            hls_ConnClose(conn);
+            if (!b_reused)
+                break;
+        }
+    }
+    free(psz_agent);
+
+    if (psz_status == NULL)
+        goto out;
+
+    int i_code = 0;
+    bool b_close = true;
+    if (!strncmp(psz_status, "HTTP/1.", 7) && strlen(psz_status) > 12)
+    {
+        b_close = psz_status[7] == '0';
+        i_code = atoi(&psz_status[9]);
+    }
+    free(psz_status);
+
+    /* headers */
+    int64_t i_length = -1;
+    bool b_chunked = false;
+    for (;;)
+    {
+        char *psz = net_Gets(s, conn->fd, NULL);
+        if (psz == NULL)
+        {
+            i_code = 0;
+            break;
+        }
+        if (*psz == '\0')
+        {
+            free(psz);
+            break;
+        }
+
+        char *psz_value = strchr(psz, ':');
+        if (psz_value != NULL)
+        {
+            *psz_value++ = '\0';
+            while (*psz_value == ' ' || *psz_value == '\t')
+                psz_value++;
+
+            if (!strcasecmp(psz, "Content-Length"))
+                i_length = strtoll(psz_value, NULL, 10);
+            else if (!strcasecmp(psz, "Transfer-Encoding"))
+                b_chunked = strcasestr(psz_value, "chunked") != NULL;
+            else if (!strcasecmp(psz, "Connection"))
+            {
+                if (!strcasecmp(psz_value, "close"))
+                    b_close = true;
+                else if (!strcasecmp(psz_value, "keep-alive"))
+                    b_close = false;
+            }
+        }
+        free(psz);
+    }
+
+    /* redirections, authentication and errors are left to the http access */
+    if (i_code != 200)
+    {
+        if (i_code != 0)
+            msg_Dbg(s, "HTTP %d for %s, using the http access", i_code, psz_url);
+        hls_ConnClose(conn);
+        goto out;
+    }
+
+    if (!b_chunked && i_length < 0)
+        b_close = true;
+    p_data = hls_HttpReadBody(s, conn->fd, b_chunked ? -1 : i_length, b_chunked);
+    if (p_data == NULL || b_close)
+        hls_ConnClose(conn);
+
+out:
+    vlc_UrlClean(&url);
+    return p_data;
+}
+
+static int hls_Download(stream_t *s, segment_t *segment, hls_conn_t *conn)
 {
     stream_sys_t *p_sys = s->p_sys;
     assert(segment);
 
+    if (p_sys->download.keepalive)
+    {
+        int i_canc = vlc_savecancel();
+        block_t *p_data = hls_HttpGet(s, conn, segment->url);
+        vlc_restorecancel(i_canc);
+
+        if (p_data != NULL)
+        {
+            segment->data = p_data;
+            segment->size = p_data->i_buffer;
+            return VLC_SUCCESS;
+        }
+        if (atomic_load(&p_sys->closing))
+            return VLC_EGENERIC;
+    }
+
     stream_t *p_ts = stream_UrlNew(s, segment->url);
     if (p_ts == NULL)
         return VLC_EGENERIC;
@@ -2087,6 +2481,23 @@ static int Open(vlc_object_t *p_this)
     vlc_cond_init(&p_sys->wait);
     vlc_mutex_init(&p_sys->lock);
 
+    vlc_mutex_init(&p_sys->download.lock_wait);
+    vlc_cond_init(&p_sys->download.wait);
+    vlc_mutex_init(&p_sys->download.lock_key);
+
+    vlc_mutex_init(&p_sys->read.lock_wait);
+    vlc_cond_init(&p_sys->read.wait);
+
+    p_sys->download.lookahead = var_InheritInteger(s, "hls-lookahead");
+    p_sys->download.buffer_max =
+        (uint64_t)var_InheritInteger(s, "hls-buffer-size") << 20;
+    p_sys->download.keepalive = var_InheritBool(s, "hls-keepalive");
+
+    var_Create(s, "hls-download-rate", VLC_VAR_INTEGER);
+    var_Create(s, "hls-downloaded-bytes", VLC_VAR_INTEGER);
+    var_Create(s, "hls-downloaded-segments", VLC_VAR_INTEGER);
+    var_Create(s, "hls-reused-connections", VLC_VAR_INTEGER);
+
     /* Parse HLS m3u8 content. */
     uint8_t *buffer = NULL;
     ssize_t len = read_M3U8_from_stream(s->p_source, &buffer);
@@ -2116,15 +2527,10 @@ static int Open(vlc_object_t *p_this)
     }
 
     p_sys->download.stream = current;
+    p_sys->download.next = p_sys->download.segment;
     p_sys->playback.stream = current;
     p_sys->download.seek = -1;
 
-    vlc_mutex_init(&p_sys->download.lock_wait);
-    vlc_cond_init(&p_sys->download.wait);
-
-    vlc_mutex_init(&p_sys->read.lock_wait);
-    vlc_cond_init(&p_sys->read.wait);
-
     /* Initialize HLS live stream */
     if (p_sys->b_live)
     {
@@ -2135,30 +2541,43 @@ static int Open(vlc_object_t *p_this)
 
         if (vlc_clone(&p_sys->reload, hls_Reload, s, VLC_THREAD_PRIORITY_LOW))
         {
-            goto fail_thread;
+            goto fail;
         }
     }
 
-    if (vlc_clone(&p_sys->thread, hls_Thread, s, VLC_THREAD_PRIORITY_INPUT))
+    unsigned i_threads = var_InheritInteger(s, "hls-parallel");
+    p_sys->threads = malloc(i_threads * sizeof(*p_sys->threads));
+    for (p_sys->i_threads = 0; p_sys->threads != NULL &&
+                               p_sys->i_threads < i_threads; p_sys->i_threads++)
+    {
+        if (vlc_clone(&p_sys->threads[p_sys->i_threads], hls_Thread, s,
+                      VLC_THREAD_PRIORITY_INPUT))
+            break;
+    }
+
+    if (p_sys->i_threads == 0)
     {
         if (p_sys->b_live)
         {
             vlc_cancel(p_sys->reload);
             vlc_join(p_sys->reload, NULL);
         }
-        goto fail_thread;
+        free(p_sys->threads);
+        goto fail;
     }
+    msg_Dbg(s, "downloading with %u threads, up to %d segments ahead",
+            p_sys->i_threads, p_sys->download.lookahead);
 
     return VLC_SUCCESS;
 
-fail_thread:
+fail:
     vlc_mutex_destroy(&p_sys->download.lock_wait);
     vlc_cond_destroy(&p_sys->download.wait);
+    vlc_mutex_destroy(&p_sys->download.lock_key);
 
     vlc_mutex_destroy(&p_sys->read.lock_wait);
     vlc_cond_destroy(&p_sys->read.wait);
 
-fail:
     /* Free hls streams */
     for (int i = 0; i < vlc_array_count(p_sys->hls_stream); i++)
     {
@@ -2189,7 +2608,7 @@ static void Close(vlc_object_t *p_this)
     vlc_mutex_lock(&p_sys->lock);
     p_sys->paused = false;
     atomic_store(&p_sys->closing, true);
-    vlc_cond_signal(&p_sys->wait);
+    vlc_cond_broadcast(&p_sys->wait);
     vlc_mutex_unlock(&p_sys->lock);
 
     /* */
@@ -2197,7 +2616,7 @@ static void Close(vlc_object_t *p_this)
     /* negate the condition variable's predicate */
     p_sys->download.segment = p_sys->playback.segment = 0;
     p_sys->download.seek = 0; /* better safe than sorry */
-    vlc_cond_signal(&p_sys->download.wait);
+    vlc_cond_broadcast(&p_sys->download.wait);
     vlc_mutex_unlock(&p_sys->download.lock_wait);
 
     vlc_cond_signal(&p_sys->read.wait); /* set closing first */
@@ -2209,11 +2628,15 @@ static void Close(vlc_object_t *p_this)
         vlc_join(p_sys->reload, NULL);
     }
 
-    vlc_cancel(p_sys->thread);
-    vlc_join(p_sys->thread, NULL);
+    for (unsigned i = 0; i < p_sys->i_threads; i++)
+        vlc_cancel(p_sys->threads[i]);
+    for (unsigned i = 0; i < p_sys->i_threads; i++)
+        vlc_join(p_sys->threads[i], NULL);
+    free(p_sys->threads);
 
     vlc_mutex_destroy(&p_sys->download.lock_wait);
     vlc_cond_destroy(&p_sys->download.wait);
+    vlc_mutex_destroy(&p_sys->download.lock_key);
 
     vlc_mutex_destroy(&p_sys->read.lock_wait);
     vlc_cond_destroy(&p_sys->read.wait);
@@ -2320,7 +2743,7 @@ check:
         if ((p_sys->download.segment - p_sys->playback.segment == 0) &&
             ((count != p_sys->download.segment) || p_sys->b_live))
             msg_Err(s, "playback will stall");
-        else if ((p_sys->download.segment - p_sys->playback.segment < 3) &&
+        else if (hls_ShortOfSegments(p_sys) &&
                  ((count != p_sys->download.segment) || p_sys->b_live))
             msg_Warn(s, "playback in danger of stalling");
     }
@@ -2359,6 +2782,8 @@ static ssize_t hls_Read(stream_t *s, uint8_t *p_read, unsigned int i_read)
         vlc_mutex_lock(&segment->lock);
         if (segment->data->i_buffer == 0)
         {
+            uint64_t i_size = segment->size;
+
             if (!p_sys->b_cache || p_sys->b_live)
             {
                 block_Release(segment->data);
@@ -2369,10 +2794,11 @@ static ssize_t hls_Read(stream_t *s, uint8_t *p_read, unsigned int i_read)
 
             vlc_mutex_unlock(&segment->lock);
 
-            /* signal download thread */
+            /* signal download threads */
             vlc_mutex_lock(&p_sys->download.lock_wait);
             p_sys->playback.segment++;
-            vlc_cond_signal(&p_sys->download.wait);
+            p_sys->download.buffered -= __MIN(p_sys->download.buffered, i_size);
+            vlc_cond_broadcast(&p_sys->download.wait);
             vlc_mutex_unlock(&p_sys->download.lock_wait);
             continue;
         }
@@ -2689,12 +3115,13 @@ static int segment_Seek(stream_t *s, const uint64_t pos)
         /* Wake up download thread */
         vlc_mutex_lock(&p_sys->download.lock_wait);
         p_sys->download.seek = p_sys->playback.segment;
-        vlc_cond_signal(&p_sys->download.wait);
+        vlc_cond_broadcast(&p_sys->download.wait);
 
-        /* Wait for download to be finished */
+        /* Wait for the segment seeked to, the download threads may stop
+         * short of any more because of the lookahead or buffer size */
         msg_Dbg(s, "seek to segment %d", p_sys->playback.segment);
         while ((p_sys->download.seek != -1) ||
-           ((p_sys->download.segment - p_sys->playback.segment < 3) &&
+           ((p_sys->download.segment <= p_sys->playback.segment) &&
                 (p_sys->download.segment < count)))
         {
             vlc_cond_wait(&p_sys->download.wait, &p_sys->download.lock_wait);
@@ -2735,7 +3162,7 @@ static int Control(stream_t *s, int i_query, va_list args)
 
             vlc_mutex_lock(&p_sys->lock);
             p_sys->paused = paused;
-            vlc_cond_signal(&p_sys->wait);
+            vlc_cond_broadcast(&p_sys->wait);
             vlc_mutex_unlock(&p_sys->lock);
             break;
         }
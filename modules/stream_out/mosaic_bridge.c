@@ -354,6 +354,8 @@ static sout_stream_id_sys_t * Add( sout_stream_t *p_stream, es_format_t *p_fmt )
 
         p_bridge->i_es_num = 0;
         p_bridge->pp_es = NULL;
+        p_bridge->pf_notify = NULL;
+        p_bridge->p_notify_data = NULL;
     }
 
     for ( i = 0; i < p_bridge->i_es_num; i++ )
@@ -507,6 +509,10 @@ static void PushPicture( sout_stream_t *p_stream, picture_t *p_picture )
     p_picture->p_next = NULL;
     p_es->pp_last = &p_picture->p_next;
 
+    bridge_t *p_bridge = GetBridge( p_stream );
+    if( p_bridge->pf_notify != NULL )
+        p_bridge->pf_notify( p_bridge->p_notify_data, p_bridge );
+
     vlc_global_unlock( VLC_MOSAIC_MUTEX );
 }
 
@@ -0,0 +1,480 @@
+/*****************************************************************************
+ * rendition.c: transcoding stream output module (extra video renditions)
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*****************************************************************************
+ * Preamble
+ *****************************************************************************/
+
+#include "transcode.h"
+
+#include <vlc_modules.h>
+
+/*
+ * A rendition is an extra scaler and encoder fed by the pictures of the
+ * transcoded video ES once they went through the deinterlacer and the user
+ * filters, but before they get scaled for the main encoder, so that
+ * several qualities of the same input only cost one decoding. Each rendition
+ * outputs to a sout chain of its own, which also gets a copy of every other
+ * ES of the transcode output (audio, passthrough ES...).
+ *
+ * All the renditions are scaled and encoded one after the other on the
+ * thread that runs the video filters; the rendition chains are only ever
+ * called from the sout thread.
+ */
+
+#define RENDITION_FRAMERATE (25 * 1000)
+#define RENDITION_FRAMERATE_BASE 1000
+
+static transcode_rendition_t *RenditionNew( sout_stream_t *p_stream,
+                                            const char *psz_opts )
+{
+    transcode_rendition_t *r = calloc( 1, sizeof( *r ) );
+    config_chain_t *p_cfg = NULL;
+    char *psz_dst = NULL;
+
+    if( !r )
+        return NULL;
+
+    config_ChainParseOptions( &p_cfg, psz_opts );
+    for( config_chain_t *p = p_cfg; p != NULL; p = p->p_next )
+    {
+        const char *psz_value = p->psz_value ? p->psz_value : "";
+
+        if( !strcmp( p->psz_name, "width" ) )
+            r->i_width = atoi( psz_value ) & ~1;
+        else if( !strcmp( p->psz_name, "height" ) )
+            r->i_height = atoi( psz_value ) & ~1;
+        else if( !strcmp( p->psz_name, "vb" ) )
+        {
+            r->i_vbitrate = atoi( psz_value );
+            if( r->i_vbitrate < 16000 ) r->i_vbitrate *= 1000;
+        }
+        else if( !strcmp( p->psz_name, "vcodec" ) )
+        {
+            char fcc[5] = "    \0";
+            memcpy( fcc, psz_value, __MIN( strlen( psz_value ), 4 ) );
+            r->i_vcodec = vlc_fourcc_GetCodecFromString( VIDEO_ES, fcc );
+        }
+        else if( !strcmp( p->psz_name, "venc" ) && !r->psz_venc )
+            free( config_ChainCreate( &r->psz_venc, &r->p_video_cfg,
+                                      psz_value ) );
+        else if( !strcmp( p->psz_name, "dst" ) && !psz_dst )
+            psz_dst = strdup( psz_value );
+        else
+            msg_Err( p_stream, "ignoring unknown rendition option `%s'",
+                     p->psz_name );
+    }
+    config_ChainDestroy( p_cfg );
+
+    if( !r->i_vcodec )
+        r->i_vcodec = p_stream->p_sys->i_vcodec;
+    if( !r->psz_venc && p_stream->p_sys->psz_venc )
+    {
+        r->psz_venc = strdup( p_stream->p_sys->psz_venc );
+        r->p_video_cfg = config_ChainDuplicate( p_stream->p_sys->p_video_cfg );
+    }
+
+    if( psz_dst == NULL || !*psz_dst )
+    {
+        msg_Err( p_stream, "rendition without destination" );
+        goto error;
+    }
+
+    r->p_encoder = sout_EncoderCreate( p_stream );
+    if( !r->p_encoder )
+        goto error;
+    r->p_encoder->p_module = NULL;
+
+    r->p_first = sout_StreamChainNew( p_stream->p_sout, psz_dst, NULL,
+                                      &r->p_last );
+    if( !r->p_first )
+    {
+        msg_Err( p_stream, "cannot create rendition chain `%s'", psz_dst );
+        goto error;
+    }
+    free( psz_dst );
+
+    vlc_mutex_init( &r->lock );
+    msg_Dbg( p_stream, "rendition %ux%u %4.4s %dkb/s",
+             r->i_width, r->i_height, (char *)&r->i_vcodec,
+             r->i_vbitrate / 1000 );
+    return r;
+
+error:
+    if( r->p_encoder )
+        vlc_object_release( r->p_encoder );
+    free( psz_dst );
+    free( r->psz_venc );
+    config_ChainDestroy( r->p_video_cfg );
+    free( r );
+    return NULL;
+}
+
+int transcode_rendition_open( sout_stream_t *p_stream )
+{
+    sout_stream_sys_t *p_sys = p_stream->p_sys;
+
+    TAB_INIT( p_sys->i_renditions, p_sys->pp_renditions );
+    p_sys->id_rendition = NULL;
+
+    for( config_chain_t *p_cfg = p_stream->p_cfg; p_cfg; p_cfg = p_cfg->p_next )
+    {
+        if( strcmp( p_cfg->psz_name, "rendition" ) || !p_cfg->psz_value )
+            continue;
+
+        transcode_rendition_t *r = RenditionNew( p_stream, p_cfg->psz_value );
+        if( !r )
+        {
+            transcode_rendition_close( p_stream );
+            return VLC_EGENERIC;
+        }
+        TAB_APPEND( p_sys->i_renditions, p_sys->pp_renditions, r );
+    }
+
+    if( p_sys->i_renditions > 0 && !p_sys->i_vcodec )
+        msg_Warn( p_stream, "renditions need video transcoding (vcodec)" );
+    return VLC_SUCCESS;
+}
+
+void transcode_rendition_close( sout_stream_t *p_stream )
+{
+    sout_stream_sys_t *p_sys = p_stream->p_sys;
+
+    for( int i = 0; i < p_sys->i_renditions; i++ )
+    {
+        transcode_rendition_t *r = p_sys->pp_renditions[i];
+
+        sout_StreamChainDelete( r->p_first, r->p_last );
+        es_format_Clean( &r->p_encoder->fmt_in );
+        es_format_Clean( &r->p_encoder->fmt_out );
+        vlc_object_release( r->p_encoder );
+        vlc_mutex_destroy( &r->lock );
+        free( r->psz_venc );
+        config_ChainDestroy( r->p_video_cfg );
+        free( r );
+    }
+    TAB_CLEAN( p_sys->i_renditions, p_sys->pp_renditions );
+}
+
+/*****************************************************************************
+ * Other ES: every rendition chain gets the same output as p_next
+ *****************************************************************************/
+int transcode_rendition_add( sout_stream_t *p_stream,
+                             sout_stream_id_sys_t *id, es_format_t *p_fmt )
+{
+    sout_stream_sys_t *p_sys = p_stream->p_sys;
+
+    id->pp_rendition_ids = calloc( p_sys->i_renditions,
+                                   sizeof( *id->pp_rendition_ids ) );
+    if( !id->pp_rendition_ids )
+        return VLC_ENOMEM;
+
+    for( int i = 0; i < p_sys->i_renditions; i++ )
+    {
+        transcode_rendition_t *r = p_sys->pp_renditions[i];
+
+        id->pp_rendition_ids[i] = sout_StreamIdAdd( r->p_first, p_fmt );
+        if( !id->pp_rendition_ids[i] )
+            msg_Warn( p_stream, "rendition %d refused ES (fcc=`%4.4s')", i,
+                      (char *)&p_fmt->i_codec );
+    }
+    return VLC_SUCCESS;
+}
+
+void transcode_rendition_del( sout_stream_t *p_stream,
+                              sout_stream_id_sys_t *id )
+{
+    sout_stream_sys_t *p_sys = p_stream->p_sys;
+
+    for( int i = 0; i < p_sys->i_renditions; i++ )
+        if( id->pp_rendition_ids[i] )
+            sout_StreamIdDel( p_sys->pp_renditions[i]->p_first,
+                              id->pp_rendition_ids[i] );
+    free( id->pp_rendition_ids );
+    id->pp_rendition_ids = NULL;
+}
+
+void transcode_rendition_send( sout_stream_t *p_stream,
+                               sout_stream_id_sys_t *id, const block_t *p_in )
+{
+    sout_stream_sys_t *p_sys = p_stream->p_sys;
+
+    for( int i = 0; i < p_sys->i_renditions; i++ )
+    {
+        block_t *p_out = NULL;
+
+        if( !id->pp_rendition_ids[i] )
+            continue;
+        for( const block_t *p = p_in; p != NULL; p = p->p_next )
+        {
+            block_t *p_dup = block_Duplicate( (block_t *)p );
+            if( p_dup )
+                block_ChainAppend( &p_out, p_dup );
+        }
+        if( p_out )
+            sout_StreamIdSend( p_sys->pp_renditions[i]->p_first,
+                               id->pp_rendition_ids[i], p_out );
+    }
+}
+
+/*****************************************************************************
+ * Video
+ *****************************************************************************/
+/* (Re)builds the scaler from the current source format to the encoder one */
+static int RenditionConversion( sout_stream_t *p_stream,
+                                transcode_rendition_t *r,
+                                const es_format_t *p_fmt )
+{
+    encoder_t *p_enc = r->p_encoder;
+
+    if( r->p_conv_chain )
+        filter_chain_Delete( r->p_conv_chain );
+    r->p_conv_chain = filter_chain_New( p_stream, "video filter2", false,
+                                        transcode_video_filter_allocation_init,
+                                        transcode_video_filter_allocation_clear,
+                                        p_stream->p_sys );
+    if( !r->p_conv_chain )
+        return VLC_ENOMEM;
+    filter_chain_Reset( r->p_conv_chain, p_fmt, &p_enc->fmt_in );
+
+    if( p_fmt->video.i_chroma != p_enc->fmt_in.video.i_chroma ||
+        p_fmt->video.i_width != p_enc->fmt_in.video.i_width ||
+        p_fmt->video.i_height != p_enc->fmt_in.video.i_height )
+    {
+        if( !filter_chain_AppendFilter( r->p_conv_chain, NULL, NULL,
+                                        p_fmt, &p_enc->fmt_in ) )
+        {
+            msg_Err( p_stream, "cannot convert %4.4s %ux%u to %4.4s %ux%u",
+                     (char *)&p_fmt->video.i_chroma,
+                     p_fmt->video.i_width, p_fmt->video.i_height,
+                     (char *)&p_enc->fmt_in.video.i_chroma,
+                     p_enc->fmt_in.video.i_width, p_enc->fmt_in.video.i_height );
+            return VLC_EGENERIC;
+        }
+    }
+    r->fmt_src = p_fmt->video;
+    return VLC_SUCCESS;
+}
+
+static int RenditionOpen( sout_stream_t *p_stream, transcode_rendition_t *r,
+                          const es_format_t *p_fmt )
+{
+    sout_stream_sys_t *p_sys = p_stream->p_sys;
+    encoder_t *p_enc = r->p_encoder;
+    const video_format_t *p_src = &p_fmt->video;
+
+    unsigned i_src_width = p_src->i_visible_width ? p_src->i_visible_width
+                                                  : p_src->i_width;
+    unsigned i_src_height = p_src->i_visible_height ? p_src->i_visible_height
+                                                    : p_src->i_height;
+    if( !i_src_width || !i_src_height )
+        return VLC_EGENERIC;
+
+    /* A missing dimension keeps the source pixel aspect ratio */
+    unsigned i_width = r->i_width, i_height = r->i_height;
+    if( !i_width && !i_height )
+    {
+        i_width = i_src_width;
+        i_height = i_src_height;
+    }
+    else if( !i_height )
+        i_height = (uint64_t)i_width * i_src_height / i_src_width;
+    else if( !i_width )
+        i_width = (uint64_t)i_height * i_src_width / i_src_height;
+    i_width = __MAX( 2, i_width & ~1 );
+    i_height = __MAX( 2, i_height & ~1 );
+
+    es_format_Clean( &p_enc->fmt_in );
+    es_format_Init( &p_enc->fmt_in, VIDEO_ES, p_src->i_chroma );
+    es_format_Clean( &p_enc->fmt_out );
+    es_format_Init( &p_enc->fmt_out, VIDEO_ES, r->i_vcodec );
+
+    video_format_t *p_out = &p_enc->fmt_out.video;
+    p_out->i_width = p_out->i_visible_width = i_width;
+    p_out->i_height = p_out->i_visible_height = i_height;
+    if( p_src->i_frame_rate && p_src->i_frame_rate_base )
+    {
+        p_out->i_frame_rate = p_src->i_frame_rate;
+        p_out->i_frame_rate_base = p_src->i_frame_rate_base;
+    }
+    else
+    {
+        p_out->i_frame_rate = RENDITION_FRAMERATE;
+        p_out->i_frame_rate_base = RENDITION_FRAMERATE_BASE;
+    }
+    vlc_ureduce( &p_out->i_frame_rate, &p_out->i_frame_rate_base,
+                 p_out->i_frame_rate, p_out->i_frame_rate_base, 0 );
+    if( p_src->i_sar_num && p_src->i_sar_den )
+        vlc_ureduce( &p_out->i_sar_num, &p_out->i_sar_den,
+                     (uint64_t)p_src->i_sar_num * i_src_width * i_height,
+                     (uint64_t)p_src->i_sar_den * i_src_height * i_width, 0 );
+    else
+        p_out->i_sar_num = p_out->i_sar_den = 1;
+    p_out->orientation = p_src->orientation;
+
+    p_enc->fmt_in.video = *p_out;
+    p_enc->fmt_in.video.i_chroma = p_src->i_chroma;
+    p_enc->fmt_out.i_bitrate = r->i_vbitrate;
+    p_enc->fmt_out.i_id = p_sys->id_rendition->p_encoder->fmt_out.i_id;
+    p_enc->fmt_out.i_group = p_sys->id_rendition->p_encoder->fmt_out.i_group;
+
+    p_enc->i_threads = p_sys->i_threads;
+    p_enc->p_cfg = r->p_video_cfg;
+
+    p_enc->p_module = module_need( p_enc, "encoder", r->psz_venc, true );
+    if( !p_enc->p_module )
+    {
+        msg_Err( p_stream, "cannot find rendition encoder (module:%s fourcc:%4.4s)",
+                 r->psz_venc ? r->psz_venc : "any", (char *)&r->i_vcodec );
+        return VLC_EGENERIC;
+    }
+    p_enc->fmt_in.video.i_chroma = p_enc->fmt_in.i_codec;
+    p_enc->fmt_out.i_codec = vlc_fourcc_GetCodec( VIDEO_ES,
+                                                  p_enc->fmt_out.i_codec );
+
+    if( RenditionConversion( p_stream, r, p_fmt ) )
+    {
+        module_unneed( p_enc, p_enc->p_module );
+        p_enc->p_module = NULL;
+        return VLC_EGENERIC;
+    }
+
+    msg_Dbg( p_stream, "rendition source %ux%u, destination %ux%u",
+             i_src_width, i_src_height, i_width, i_height );
+
+    vlc_mutex_lock( &r->lock );
+    r->b_ready = true;
+    vlc_mutex_unlock( &r->lock );
+    return VLC_SUCCESS;
+}
+
+/* Called with each picture out of the user filters (or the deinterlacer if
+ * there are none), which is left to the caller */
+void transcode_rendition_video_process( sout_stream_t *p_stream,
+                                        picture_t *p_pic,
+                                        const es_format_t *p_fmt )
+{
+    sout_stream_sys_t *p_sys = p_stream->p_sys;
+
+    for( int i = 0; i < p_sys->i_renditions; i++ )
+    {
+        transcode_rendition_t *r = p_sys->pp_renditions[i];
+
+        if( r->b_error )
+            continue;
+        if( !r->p_encoder->p_module )
+        {
+            if( RenditionOpen( p_stream, r, p_fmt ) )
+            {
+                r->b_error = true;
+                continue;
+            }
+        }
+        else if( !video_format_IsSimilar( &r->fmt_src, &p_fmt->video ) &&
+                 RenditionConversion( p_stream, r, p_fmt ) )
+        {
+            r->b_error = true;
+            continue;
+        }
+
+        picture_t *p_conv =
+            filter_chain_VideoFilter( r->p_conv_chain, picture_Hold( p_pic ) );
+        if( !p_conv )
+            continue;
+
+        block_t *p_block = r->p_encoder->pf_encode_video( r->p_encoder,
+                                                          p_conv );
+        picture_Release( p_conv );
+
+        vlc_mutex_lock( &r->lock );
+        block_ChainAppend( &r->p_buffers, p_block );
+        vlc_mutex_unlock( &r->lock );
+    }
+}
+
+/* Declares the rendition streams once their encoder is opened and sends
+ * what was encoded so far. With b_drain, the encoders are flushed too, the
+ * video filters must not run anymore then. */
+void transcode_rendition_video_output( sout_stream_t *p_stream, bool b_drain )
+{
+    sout_stream_sys_t *p_sys = p_stream->p_sys;
+
+    for( int i = 0; i < p_sys->i_renditions; i++ )
+    {
+        transcode_rendition_t *r = p_sys->pp_renditions[i];
+        block_t *p_out;
+
+        vlc_mutex_lock( &r->lock );
+        const bool b_ready = r->b_ready;
+        r->b_ready = false;
+        p_out = r->p_buffers;
+        r->p_buffers = NULL;
+        vlc_mutex_unlock( &r->lock );
+
+        if( b_ready )
+        {
+            r->id = sout_StreamIdAdd( r->p_first, &r->p_encoder->fmt_out );
+            if( !r->id )
+                msg_Err( p_stream, "cannot add rendition %d stream", i );
+        }
+
+        if( b_drain && r->p_encoder->p_module )
+        {
+            block_t *p_block;
+            do {
+                p_block = r->p_encoder->pf_encode_video( r->p_encoder, NULL );
+                block_ChainAppend( &p_out, p_block );
+            } while( p_block );
+        }
+
+        if( p_out == NULL )
+            continue;
+        if( r->id )
+            sout_StreamIdSend( r->p_first, r->id, p_out );
+        else
+            block_ChainRelease( p_out );
+    }
+}
+
+/* The video ES feeding the renditions is going away */
+void transcode_rendition_video_close( sout_stream_t *p_stream )
+{
+    sout_stream_sys_t *p_sys = p_stream->p_sys;
+
+    for( int i = 0; i < p_sys->i_renditions; i++ )
+    {
+        transcode_rendition_t *r = p_sys->pp_renditions[i];
+
+        if( r->id )
+            sout_StreamIdDel( r->p_first, r->id );
+        r->id = NULL;
+        if( r->p_encoder->p_module )
+            module_unneed( r->p_encoder, r->p_encoder->p_module );
+        r->p_encoder->p_module = NULL;
+        if( r->p_conv_chain )
+            filter_chain_Delete( r->p_conv_chain );
+        r->p_conv_chain = NULL;
+        block_ChainRelease( r->p_buffers );
+        r->p_buffers = NULL;
+        r->b_ready = false;
+        r->b_error = false;
+    }
+    p_sys->id_rendition = NULL;
+}
@@ -80,6 +80,13 @@
 #define VFILTER_LONGTEXT N_( \
     "Video filters will be applied to the video streams (after overlays " \
     "are applied). You can enter a colon-separated list of filters." )
+#define RENDITION_TEXT N_("Extra video rendition")
+#define RENDITION_LONGTEXT N_( \
+    "Encodes the video once more from the same decoded pictures, after " \
+    "deinterlacing and the video filters (vfilter), to a sout chain of its " \
+    "own which also gets the other streams. Can be repeated, e.g. " \
+    "rendition={height=360,vb=800,dst=std{...}}. Known options are width, " \
+    "height, vb, vcodec, venc and dst." )
 
 #define AENC_TEXT N_("Audio encoder")
 #define AENC_LONGTEXT N_( \
@@ -131,6 +138,15 @@
 #define HP_LONGTEXT N_( \
     "Runs the optional encoder thread at the OUTPUT priority instead of " \
     "VIDEO." )
+#define PIPELINE_TEXT N_("Pipelined video transcoding")
+#define PIPELINE_LONGTEXT N_( \
+    "Decode and filter video in threads of their own as well, so that " \
+    "decoding, filtering and encoding overlap. This needs at least one " \
+    "encoder thread." )
+#define PIPELINE_DEPTH_TEXT N_("Video pipeline depth")
+#define PIPELINE_DEPTH_LONGTEXT N_( \
+    "Number of blocks or pictures each video pipeline stage can queue " \
+    "for the next one before it has to wait." )
 
 
 static const char *const ppsz_deinterlace_type[] =
@@ -179,6 +195,8 @@ vlc_module_begin ()
                  MAXHEIGHT_LONGTEXT, true )
     add_module_list( SOUT_CFG_PREFIX "vfilter", "video filter2",
                      NULL, VFILTER_TEXT, VFILTER_LONGTEXT, false )
+    add_string( SOUT_CFG_PREFIX "rendition", NULL, RENDITION_TEXT,
+                RENDITION_LONGTEXT, true )
 
     set_section( N_("Audio"), NULL )
     add_module( SOUT_CFG_PREFIX "aenc", "encoder", NULL, AENC_TEXT,
@@ -218,6 +236,10 @@ vlc_module_begin ()
                  THREADS_LONGTEXT, true )
     add_bool( SOUT_CFG_PREFIX "high-priority", false, HP_TEXT, HP_LONGTEXT,
               true )
+    add_bool( SOUT_CFG_PREFIX "pipeline", false, PIPELINE_TEXT,
+              PIPELINE_LONGTEXT, true )
+    add_integer_with_range( SOUT_CFG_PREFIX "pipeline-depth", 4, 1, 64,
+                            PIPELINE_DEPTH_TEXT, PIPELINE_DEPTH_LONGTEXT, true )
 
 vlc_module_end ()
 
@@ -227,6 +249,7 @@ static const char *const ppsz_sout_options[] = {
     "deinterlace-module", "threads", "aenc", "acodec", "ab", "alang",
     "afilter", "samplerate", "channels", "senc", "scodec", "soverlay",
     "sfilter", "osd", "high-priority", "maxwidth", "maxheight",
+    "pipeline", "pipeline-depth", "rendition",
     NULL
 };
 
@@ -375,6 +398,15 @@ static int Open( vlc_object_t *p_this )
 
     p_sys->i_threads = var_GetInteger( p_stream, SOUT_CFG_PREFIX "threads" );
     p_sys->b_high_priority = var_GetBool( p_stream, SOUT_CFG_PREFIX "high-priority" );
+    p_sys->b_pipeline = var_GetBool( p_stream, SOUT_CFG_PREFIX "pipeline" );
+    p_sys->i_pipeline_depth = __MAX( 1, var_GetInteger( p_stream,
+                                            SOUT_CFG_PREFIX "pipeline-depth" ) );
+    p_sys->b_pipeline_running = false;
+    if( p_sys->b_pipeline && p_sys->i_threads < 1 )
+    {
+        msg_Warn( p_stream, "the video pipeline needs threads > 0, disabling" );
+        p_sys->b_pipeline = false;
+    }
 
     if( p_sys->i_vcodec )
     {
@@ -467,6 +499,12 @@ static int Open( vlc_object_t *p_this )
     p_stream->pf_send   = Send;
     p_stream->p_sys     = p_sys;
 
+    if( transcode_rendition_open( p_stream ) )
+    {
+        Close( p_this );
+        return VLC_EGENERIC;
+    }
+
     return VLC_SUCCESS;
 }
 
@@ -478,6 +516,8 @@ static void Close( vlc_object_t * p_this )
     sout_stream_t       *p_stream = (sout_stream_t*)p_this;
     sout_stream_sys_t   *p_sys = p_stream->p_sys;
 
+    transcode_rendition_close( p_stream );
+
     free( p_sys->psz_af );
 
     config_ChainDestroy( p_sys->p_audio_cfg );
@@ -565,6 +605,17 @@ static sout_stream_id_sys_t *Add( sout_stream_t *p_stream, es_format_t *p_fmt )
     if(!success)
         goto error;
 
+    /* Copy this ES to the rendition chains too. A transcoded video ES has
+     * no id yet, its stream is added once the first picture is decoded. */
+    if( p_sys->i_renditions > 0 && id->id &&
+        transcode_rendition_add( p_stream, id, id->b_transcode
+                                 ? &id->p_encoder->fmt_out : p_fmt ) )
+    {
+        sout_StreamIdDel( p_stream->p_next, id->id );
+        id->id = NULL;
+        goto error;
+    }
+
     return id;
 
 error:
@@ -614,6 +665,7 @@ static int Del( sout_stream_t *p_stream, sout_stream_id_sys_t *id )
     }
 
     if( id->id ) sout_StreamIdDel( p_stream->p_next, id->id );
+    if( id->pp_rendition_ids ) transcode_rendition_del( p_stream, id );
 
     if( id->p_decoder )
     {
@@ -640,6 +692,8 @@ static int Send( sout_stream_t *p_stream, sout_stream_id_sys_t *id,
 
     if( !id->b_transcode )
     {
+        if( id->pp_rendition_ids )
+            transcode_rendition_send( p_stream, id, p_buffer );
         if( id->id )
             return sout_StreamIdSend( p_stream->p_next, id->id, p_buffer );
 
@@ -688,6 +742,8 @@ static int Send( sout_stream_t *p_stream, sout_stream_id_sys_t *id,
         break;
     }
 
+    if( p_out && id->pp_rendition_ids )
+        transcode_rendition_send( p_stream, id, p_out );
     if( p_out )
         return sout_StreamIdSend( p_stream->p_next, id->id, p_out );
     return VLC_SUCCESS;
@@ -14,6 +14,43 @@
 /*100ms is around the limit where people are noticing lipsync issues*/
 #define MASTER_SYNC_MAX_DRIFT 100000
 
+/* Bounded queue between two video pipeline stages, NULL marks the end */
+typedef struct
+{
+    vlc_mutex_t     lock;
+    vlc_cond_t      wait_space;
+    vlc_cond_t      wait_data;
+    void          **pp_items;
+    unsigned        i_size;
+    unsigned        i_first;
+    unsigned        i_count;
+    bool            b_abort;
+    void          (*pf_release)( void * );
+} transcode_queue_t;
+
+/* Extra video rendition, see rendition.c */
+typedef struct
+{
+    sout_stream_t   *p_first;       /**< Its own sout chain */
+    sout_stream_t   *p_last;
+
+    vlc_fourcc_t    i_vcodec;
+    char            *psz_venc;
+    config_chain_t  *p_video_cfg;
+    int             i_vbitrate;
+    unsigned int    i_width, i_height;
+
+    encoder_t       *p_encoder;
+    filter_chain_t  *p_conv_chain;  /**< Scaling and chroma conversion */
+    video_format_t  fmt_src;        /**< Input format of p_conv_chain */
+    void            *id;            /**< Video ES in its chain */
+    bool            b_error;
+
+    vlc_mutex_t     lock;
+    block_t         *p_buffers;
+    bool            b_ready;        /**< Encoder opened, ES to be added */
+} transcode_rendition_t;
+
 struct sout_stream_sys_t
 {
     sout_stream_id_sys_t *id_video;
@@ -24,6 +61,24 @@ struct sout_stream_sys_t
     picture_fifo_t *pp_pics;
     vlc_thread_t    thread;
 
+    /* Video pipeline: decoding and filtering get their own threads too */
+    bool            b_pipeline;
+    bool            b_pipeline_running;
+    unsigned        i_pipeline_depth;
+    transcode_queue_t decode_queue; /**< Blocks for the decoder */
+    transcode_queue_t filter_queue; /**< Decoded pictures */
+    vlc_thread_t    decode_thread;
+    vlc_thread_t    filter_thread;
+    es_format_t     fmt_dec;        /**< Format of the pictures being filtered */
+    vlc_cond_t      cond_space;
+    unsigned        i_pics;         /**< Pictures waiting for the encoder */
+    bool            b_encoder_ready;
+    bool            b_pipeline_error;
+    mtime_t         i_decode_time;
+    mtime_t         i_filter_time;
+    mtime_t         i_filter_wait;
+    mtime_t         i_encode_time;
+
     /* Audio */
     vlc_fourcc_t    i_acodec;   /* codec audio (0 if not transcode) */
     char            *psz_aenc;
@@ -53,6 +108,11 @@ struct sout_stream_sys_t
 
     char            *psz_vf2;
 
+    /* Extra renditions of the first transcoded video ES */
+    int             i_renditions;
+    transcode_rendition_t **pp_renditions;
+    sout_stream_id_sys_t  *id_rendition;
+
     /* SPU */
     vlc_fourcc_t    i_scodec;   /* codec spu (0 if not transcode) */
     char            *psz_senc;
@@ -81,6 +141,8 @@ struct sout_stream_id_sys_t
 
     /* id of the out stream */
     void *id;
+    /* ids of the same ES in the rendition chains */
+    void **pp_rendition_ids;
 
     /* Decoder */
     decoder_t       *p_decoder;
@@ -91,6 +153,7 @@ struct sout_stream_id_sys_t
          {
              filter_chain_t  *p_f_chain; /**< Video filters */
              filter_chain_t  *p_uf_chain; /**< User-specified video filters */
+             filter_chain_t  *p_conv_chain; /**< Conversion to the encoder format */
              video_format_t  fmt_input_video;
          };
          struct
@@ -144,3 +207,19 @@ int  transcode_video_process( sout_stream_t *, sout_stream_id_sys_t *,
                                      block_t *, block_t ** );
 bool transcode_video_add    ( sout_stream_t *, es_format_t *,
                                 sout_stream_id_sys_t *);
+int  transcode_video_filter_allocation_init( filter_t *, void * );
+void transcode_video_filter_allocation_clear( filter_t * );
+
+/* RENDITIONS */
+
+int  transcode_rendition_open ( sout_stream_t * );
+void transcode_rendition_close( sout_stream_t * );
+int  transcode_rendition_add  ( sout_stream_t *, sout_stream_id_sys_t *,
+                                es_format_t * );
+void transcode_rendition_del  ( sout_stream_t *, sout_stream_id_sys_t * );
+void transcode_rendition_send ( sout_stream_t *, sout_stream_id_sys_t *,
+                                const block_t * );
+void transcode_rendition_video_process( sout_stream_t *, picture_t *,
+                                        const es_format_t * );
+void transcode_rendition_video_output ( sout_stream_t *, bool );
+void transcode_rendition_video_close  ( sout_stream_t * );
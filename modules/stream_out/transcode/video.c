@@ -83,8 +83,8 @@ static void transcode_video_filter_buffer_del( filter_t *p_filter, picture_t *p_
     picture_Release( p_pic );
 }
 
-static int transcode_video_filter_allocation_init( filter_t *p_filter,
-                                                   void *p_data )
+int transcode_video_filter_allocation_init( filter_t *p_filter,
+                                            void *p_data )
 {
     VLC_UNUSED(p_data);
     p_filter->pf_video_buffer_new = transcode_video_filter_buffer_new;
@@ -92,14 +92,148 @@ static int transcode_video_filter_allocation_init( filter_t *p_filter,
     return VLC_SUCCESS;
 }
 
-static void transcode_video_filter_allocation_clear( filter_t *p_filter )
+void transcode_video_filter_allocation_clear( filter_t *p_filter )
 {
     VLC_UNUSED(p_filter);
 }
 
+/*****************************************************************************
+ * Video pipeline queues
+ *****************************************************************************/
+static void transcode_queue_ReleaseBlock( void *p_item )
+{
+    block_Release( p_item );
+}
+
+static void transcode_queue_ReleasePicture( void *p_item )
+{
+    picture_Release( p_item );
+}
+
+static int transcode_queue_Init( transcode_queue_t *p_queue, unsigned i_size,
+                                 void (*pf_release)( void * ) )
+{
+    p_queue->pp_items = malloc( i_size * sizeof(*p_queue->pp_items) );
+    if( p_queue->pp_items == NULL )
+        return VLC_ENOMEM;
+    p_queue->i_size = i_size;
+    p_queue->i_first = 0;
+    p_queue->i_count = 0;
+    p_queue->b_abort = false;
+    p_queue->pf_release = pf_release;
+    vlc_mutex_init( &p_queue->lock );
+    vlc_cond_init( &p_queue->wait_space );
+    vlc_cond_init( &p_queue->wait_data );
+    return VLC_SUCCESS;
+}
+
+static void transcode_queue_Clean( transcode_queue_t *p_queue )
+{
+    while( p_queue->i_count > 0 )
+    {
+        void *p_item = p_queue->pp_items[p_queue->i_first];
+        if( p_item )
+            p_queue->pf_release( p_item );
+        p_queue->i_first = (p_queue->i_first + 1) % p_queue->i_size;
+        p_queue->i_count--;
+    }
+    free( p_queue->pp_items );
+    vlc_cond_destroy( &p_queue->wait_data );
+    vlc_cond_destroy( &p_queue->wait_space );
+    vlc_mutex_destroy( &p_queue->lock );
+}
+
+/* Waits for some room, the item is released if the queue got aborted */
+static void transcode_queue_Put( transcode_queue_t *p_queue, void *p_item )
+{
+    vlc_mutex_lock( &p_queue->lock );
+    while( !p_queue->b_abort && p_queue->i_count >= p_queue->i_size )
+        vlc_cond_wait( &p_queue->wait_space, &p_queue->lock );
+
+    if( p_queue->b_abort )
+    {
+        vlc_mutex_unlock( &p_queue->lock );
+        if( p_item )
+            p_queue->pf_release( p_item );
+        return;
+    }
+    p_queue->pp_items[(p_queue->i_first + p_queue->i_count) % p_queue->i_size] = p_item;
+    p_queue->i_count++;
+    vlc_cond_signal( &p_queue->wait_data );
+    vlc_mutex_unlock( &p_queue->lock );
+}
+
+/* Returns false once the queue is aborted, pi_depth gets the queue depth
+ * as seen before the item was removed */
+static bool transcode_queue_Get( transcode_queue_t *p_queue, void **pp_item,
+                                 unsigned *pi_depth )
+{
+    vlc_mutex_lock( &p_queue->lock );
+    while( !p_queue->b_abort && p_queue->i_count == 0 )
+        vlc_cond_wait( &p_queue->wait_data, &p_queue->lock );
+
+    if( p_queue->b_abort )
+    {
+        vlc_mutex_unlock( &p_queue->lock );
+        return false;
+    }
+    *pi_depth = p_queue->i_count;
+    *pp_item = p_queue->pp_items[p_queue->i_first];
+    p_queue->i_first = (p_queue->i_first + 1) % p_queue->i_size;
+    p_queue->i_count--;
+    vlc_cond_signal( &p_queue->wait_space );
+    vlc_mutex_unlock( &p_queue->lock );
+    return true;
+}
+
+static void transcode_queue_Abort( transcode_queue_t *p_queue )
+{
+    vlc_mutex_lock( &p_queue->lock );
+    p_queue->b_abort = true;
+    vlc_cond_broadcast( &p_queue->wait_space );
+    vlc_cond_broadcast( &p_queue->wait_data );
+    vlc_mutex_unlock( &p_queue->lock );
+}
+
+/* Keeps a smoothed per item duration of a pipeline stage */
+static void transcode_video_stage_time( sout_stream_t *p_stream,
+                                        const char *psz_var,
+                                        mtime_t *pi_time, mtime_t i_duration )
+{
+    if( *pi_time == 0 )
+        *pi_time = i_duration;
+    else
+        *pi_time += (i_duration - *pi_time) / 8;
+    var_SetInteger( p_stream, psz_var, *pi_time );
+}
+
+/* Hands a picture to the encoder thread. In pipeline mode, the filter thread
+ * waits there while the encoder is i_pipeline_depth pictures behind. */
+static void transcode_video_encoder_push( sout_stream_t *p_stream,
+                                          picture_t *p_pic )
+{
+    sout_stream_sys_t *p_sys = p_stream->p_sys;
+
+    vlc_mutex_lock( &p_sys->lock_out );
+    if( p_sys->b_pipeline )
+    {
+        const mtime_t i_start = mdate();
+
+        while( !p_sys->b_abort && p_sys->i_pics >= p_sys->i_pipeline_depth )
+            vlc_cond_wait( &p_sys->cond_space, &p_sys->lock_out );
+        p_sys->i_filter_wait += mdate() - i_start;
+        var_SetInteger( p_stream, "transcode-encode-depth", p_sys->i_pics );
+    }
+    picture_fifo_Push( p_sys->pp_pics, p_pic );
+    p_sys->i_pics++;
+    vlc_cond_signal( &p_sys->cond );
+    vlc_mutex_unlock( &p_sys->lock_out );
+}
+
 static void* EncoderThread( void *obj )
 {
-    sout_stream_sys_t *p_sys = (sout_stream_sys_t*)obj;
+    sout_stream_t *p_stream = obj;
+    sout_stream_sys_t *p_sys = p_stream->p_sys;
     sout_stream_id_sys_t *id = p_sys->id_video;
     picture_t *p_pic = NULL;
     int canc = vlc_savecancel ();
@@ -118,11 +252,19 @@ static void* EncoderThread( void *obj )
             vlc_mutex_unlock( &p_sys->lock_out );
             break;
         }
+        p_sys->i_pics--;
+        vlc_cond_signal( &p_sys->cond_space );
         vlc_mutex_unlock( &p_sys->lock_out );
 
         if( p_pic )
         {
+            const mtime_t i_start = mdate();
+
             p_block = id->p_encoder->pf_encode_video( id->p_encoder, p_pic );
+            if( p_sys->b_pipeline )
+                transcode_video_stage_time( p_stream, "transcode-encode-time",
+                                            &p_sys->i_encode_time,
+                                            mdate() - i_start );
 
             vlc_mutex_lock( &p_sys->lock_out );
             block_ChainAppend( &p_sys->p_buffers, p_block );
@@ -144,6 +286,7 @@ static void* EncoderThread( void *obj )
     vlc_mutex_lock( &p_sys->lock_out );
     while( (p_pic = picture_fifo_Pop( p_sys->pp_pics )) != NULL )
     {
+        p_sys->i_pics--;
         p_block = id->p_encoder->pf_encode_video( id->p_encoder, p_pic );
 
         block_ChainAppend( &p_sys->p_buffers, p_block );
@@ -152,10 +295,13 @@ static void* EncoderThread( void *obj )
     }
 
     /*Now flush encoder*/
-    do {
-       p_block = id->p_encoder->pf_encode_video(id->p_encoder, NULL );
-       block_ChainAppend( &p_sys->p_buffers, p_block );
-    } while( p_block );
+    if( id->p_encoder->p_module )
+    {
+        do {
+           p_block = id->p_encoder->pf_encode_video(id->p_encoder, NULL );
+           block_ChainAppend( &p_sys->p_buffers, p_block );
+        } while( p_block );
+    }
 
     vlc_mutex_unlock( &p_sys->lock_out );
 
@@ -164,6 +310,9 @@ static void* EncoderThread( void *obj )
     return NULL;
 }
 
+static int transcode_video_pipeline_start( sout_stream_t *, int );
+static void transcode_video_pipeline_stop( sout_stream_t *, bool );
+
 int transcode_video_new( sout_stream_t *p_stream, sout_stream_id_sys_t *id )
 {
     sout_stream_sys_t *p_sys = p_stream->p_sys;
@@ -268,38 +417,51 @@ int transcode_video_new( sout_stream_t *p_stream, sout_stream_id_sys_t *id )
         p_sys->id_video = id;
         vlc_mutex_init( &p_sys->lock_out );
         vlc_cond_init( &p_sys->cond );
+        vlc_cond_init( &p_sys->cond_space );
         p_sys->pp_pics = picture_fifo_New();
         if( p_sys->pp_pics == NULL )
         {
             msg_Err( p_stream, "cannot create picture fifo" );
             vlc_mutex_destroy( &p_sys->lock_out );
             vlc_cond_destroy( &p_sys->cond );
+            vlc_cond_destroy( &p_sys->cond_space );
             module_unneed( id->p_decoder, id->p_decoder->p_module );
             id->p_decoder->p_module = NULL;
             free( id->p_decoder->p_owner );
             return VLC_ENOMEM;
         }
         p_sys->p_buffers = NULL;
+        p_sys->i_pics = 0;
         p_sys->b_abort = false;
-        if( vlc_clone( &p_sys->thread, EncoderThread, p_sys, i_priority ) )
+        if( vlc_clone( &p_sys->thread, EncoderThread, p_stream, i_priority ) )
         {
             msg_Err( p_stream, "cannot spawn encoder thread" );
             vlc_mutex_destroy( &p_sys->lock_out );
             vlc_cond_destroy( &p_sys->cond );
+            vlc_cond_destroy( &p_sys->cond_space );
             picture_fifo_Delete( p_sys->pp_pics );
             module_unneed( id->p_decoder, id->p_decoder->p_module );
             id->p_decoder->p_module = NULL;
             free( id->p_decoder->p_owner );
             return VLC_EGENERIC;
         }
+
+        if( p_sys->b_pipeline &&
+            transcode_video_pipeline_start( p_stream, i_priority ) )
+        {
+            msg_Warn( p_stream, "cannot start the video pipeline, "
+                      "decoding and filtering on the sout thread" );
+            p_sys->b_pipeline = false;
+        }
     }
     return VLC_SUCCESS;
 }
 
 static void transcode_video_filter_init( sout_stream_t *p_stream,
-                                         sout_stream_id_sys_t *id )
+                                         sout_stream_id_sys_t *id,
+                                         es_format_t *p_fmt_dec )
 {
-    es_format_t *p_fmt_out = &id->p_decoder->fmt_out;
+    es_format_t *p_fmt_out = p_fmt_dec;
     id->p_encoder->fmt_in.video.i_chroma = id->p_encoder->fmt_in.i_codec;
 
     id->p_f_chain = filter_chain_New( p_stream, "video filter2",
@@ -315,8 +477,7 @@ static void transcode_video_filter_init( sout_stream_t *p_stream,
         filter_chain_AppendFilter( id->p_f_chain,
                                    p_stream->p_sys->psz_deinterlace,
                                    p_stream->p_sys->p_deinterlace_cfg,
-                                   &id->p_decoder->fmt_out,
-                                   &id->p_decoder->fmt_out );
+                                   p_fmt_dec, p_fmt_dec );
 
         p_fmt_out = filter_chain_GetFmtOut( id->p_f_chain );
     }
@@ -358,10 +519,13 @@ static void transcode_video_filter_init( sout_stream_t *p_stream,
 
 }
 
-/* Take care of the scaling and chroma conversions. */
-static void conversion_video_filter_append( sout_stream_id_sys_t *id )
+/* Take care of the scaling and chroma conversions, in a chain of their own
+ * so that the renditions get the pictures before they are scaled. */
+static void conversion_video_filter_append( sout_stream_t *p_stream,
+                                            sout_stream_id_sys_t *id,
+                                            const es_format_t *p_fmt_dec )
 {
-    const es_format_t *p_fmt_out = &id->p_decoder->fmt_out;
+    const es_format_t *p_fmt_out = p_fmt_dec;
     if( id->p_f_chain )
         p_fmt_out = filter_chain_GetFmtOut( id->p_f_chain );
 
@@ -372,7 +536,14 @@ static void conversion_video_filter_append( sout_stream_id_sys_t *id )
         ( p_fmt_out->video.i_width != id->p_encoder->fmt_in.video.i_width ) ||
         ( p_fmt_out->video.i_height != id->p_encoder->fmt_in.video.i_height ) )
     {
-        filter_chain_AppendFilter( id->p_uf_chain ? id->p_uf_chain : id->p_f_chain,
+        id->p_conv_chain = filter_chain_New( p_stream, "video filter2",
+                                             false,
+                                   transcode_video_filter_allocation_init,
+                                   transcode_video_filter_allocation_clear,
+                                   p_stream->p_sys );
+        filter_chain_Reset( id->p_conv_chain, p_fmt_out,
+                            &id->p_encoder->fmt_in );
+        filter_chain_AppendFilter( id->p_conv_chain,
                                    NULL, NULL,
                                    p_fmt_out,
                                    &id->p_encoder->fmt_in );
@@ -380,11 +551,12 @@ static void conversion_video_filter_append( sout_stream_id_sys_t *id )
 }
 
 static void transcode_video_encoder_init( sout_stream_t *p_stream,
-                                          sout_stream_id_sys_t *id )
+                                          sout_stream_id_sys_t *id,
+                                          const es_format_t *p_fmt_dec )
 {
     sout_stream_sys_t *p_sys = p_stream->p_sys;
 
-    const es_format_t *p_fmt_out = &id->p_decoder->fmt_out;
+    const es_format_t *p_fmt_out = p_fmt_dec;
     if( id->p_f_chain ) {
         p_fmt_out = filter_chain_GetFmtOut( id->p_f_chain );
     }
@@ -544,21 +716,21 @@ static void transcode_video_encoder_init( sout_stream_t *p_stream,
         id->p_encoder->fmt_in.video.i_frame_rate_base,
         0 );
      msg_Dbg( p_stream, "source fps %d/%d, destination %d/%d",
-        id->p_decoder->fmt_out.video.i_frame_rate,
-        id->p_decoder->fmt_out.video.i_frame_rate_base,
+        p_fmt_dec->video.i_frame_rate,
+        p_fmt_dec->video.i_frame_rate_base,
         id->p_encoder->fmt_in.video.i_frame_rate,
         id->p_encoder->fmt_in.video.i_frame_rate_base );
 
-    id->i_input_frame_interval  = id->p_decoder->fmt_out.video.i_frame_rate_base * CLOCK_FREQ / id->p_decoder->fmt_out.video.i_frame_rate;
+    id->i_input_frame_interval  = p_fmt_dec->video.i_frame_rate_base * CLOCK_FREQ / p_fmt_dec->video.i_frame_rate;
     msg_Info( p_stream, "input interval %d (base %d)",
-                        id->i_input_frame_interval, id->p_decoder->fmt_out.video.i_frame_rate_base );
+                        id->i_input_frame_interval, p_fmt_dec->video.i_frame_rate_base );
 
     id->i_output_frame_interval = id->p_encoder->fmt_in.video.i_frame_rate_base * CLOCK_FREQ / id->p_encoder->fmt_in.video.i_frame_rate;
     msg_Info( p_stream, "output interval %d (base %d)",
                         id->i_output_frame_interval, id->p_encoder->fmt_in.video.i_frame_rate_base );
 
     date_Init( &id->next_input_pts,
-               id->p_decoder->fmt_out.video.i_frame_rate,
+               p_fmt_dec->video.i_frame_rate,
                1 );
 
     date_Init( &id->next_output_pts,
@@ -621,6 +793,13 @@ static int transcode_video_encoder_open( sout_stream_t *p_stream,
     id->p_encoder->fmt_out.i_codec =
         vlc_fourcc_GetCodec( VIDEO_ES, id->p_encoder->fmt_out.i_codec );
 
+    return VLC_SUCCESS;
+}
+
+/* Declares the encoded stream downstream, on the sout thread only */
+static int transcode_video_encoder_add( sout_stream_t *p_stream,
+                                        sout_stream_id_sys_t *id )
+{
     id->id = sout_StreamIdAdd( p_stream->p_next, &id->p_encoder->fmt_out );
     if( !id->id )
     {
@@ -634,7 +813,18 @@ static int transcode_video_encoder_open( sout_stream_t *p_stream,
 void transcode_video_close( sout_stream_t *p_stream,
                                    sout_stream_id_sys_t *id )
 {
-    if( p_stream->p_sys->i_threads >= 1 )
+    if( p_stream->p_sys->b_pipeline )
+    {
+        transcode_video_pipeline_stop( p_stream, true );
+        vlc_mutex_destroy( &p_stream->p_sys->lock_out );
+        vlc_cond_destroy( &p_stream->p_sys->cond );
+        vlc_cond_destroy( &p_stream->p_sys->cond_space );
+
+        picture_fifo_Delete( p_stream->p_sys->pp_pics );
+        block_ChainRelease( p_stream->p_sys->p_buffers );
+        p_stream->p_sys->pp_pics = NULL;
+    }
+    else if( p_stream->p_sys->i_threads >= 1 )
     {
         vlc_mutex_lock( &p_stream->p_sys->lock_out );
         p_stream->p_sys->b_abort = true;
@@ -644,12 +834,16 @@ void transcode_video_close( sout_stream_t *p_stream,
         vlc_join( p_stream->p_sys->thread, NULL );
         vlc_mutex_destroy( &p_stream->p_sys->lock_out );
         vlc_cond_destroy( &p_stream->p_sys->cond );
+        vlc_cond_destroy( &p_stream->p_sys->cond_space );
 
         picture_fifo_Delete( p_stream->p_sys->pp_pics );
         block_ChainRelease( p_stream->p_sys->p_buffers );
         p_stream->p_sys->pp_pics = NULL;
     }
 
+    if( id == p_stream->p_sys->id_rendition )
+        transcode_rendition_video_close( p_stream );
+
     /* Close decoder */
     if( id->p_decoder->p_module )
         module_unneed( id->p_decoder, id->p_decoder->p_module );
@@ -667,6 +861,8 @@ void transcode_video_close( sout_stream_t *p_stream,
         filter_chain_Delete( id->p_f_chain );
     if( id->p_uf_chain )
         filter_chain_Delete( id->p_uf_chain );
+    if( id->p_conv_chain )
+        filter_chain_Delete( id->p_conv_chain );
 }
 
 static void OutputFrame( sout_stream_t *p_stream, picture_t *p_pic, sout_stream_id_sys_t *id, block_t **out )
@@ -714,10 +910,11 @@ static void OutputFrame( sout_stream_t *p_stream, picture_t *p_pic, sout_stream_
         /* Overlay subpicture */
         if( p_subpic )
         {
-            if( picture_IsReferenced( p_pic ) && !filter_chain_GetLength( id->p_f_chain ) )
+            if( picture_IsReferenced( p_pic ) && !id->p_conv_chain )
             {
                 /* We can't modify the picture, we need to duplicate it,
-                 * in this point the picture is already p_encoder->fmt.in format*/
+                 * in this point the picture is already p_encoder->fmt.in format.
+                 * Only the conversion chain hands us a picture of our own. */
                 picture_t *p_tmp = video_new_buffer_encoder( id->p_encoder );
                 if( likely( p_tmp ) )
                 {
@@ -759,10 +956,7 @@ static void OutputFrame( sout_stream_t *p_stream, picture_t *p_pic, sout_stream_
             if( likely( p_pic2 != NULL ) )
                 picture_Copy( p_pic2, p_pic );
         }
-        vlc_mutex_lock( &p_sys->lock_out );
-        picture_fifo_Push( p_sys->pp_pics, p_pic );
-        vlc_cond_signal( &p_sys->cond );
-        vlc_mutex_unlock( &p_sys->lock_out );
+        transcode_video_encoder_push( p_stream, p_pic );
     }
 
     while( (p_sys->b_master_sync && b_need_duplicate ))
@@ -776,10 +970,7 @@ static void OutputFrame( sout_stream_t *p_stream, picture_t *p_pic, sout_stream_
             {
                 picture_Copy( p_tmp, p_pic2 );
                 p_tmp->date = date_Get( &id->next_output_pts );
-                vlc_mutex_lock( &p_sys->lock_out );
-                picture_fifo_Push( p_sys->pp_pics, p_tmp );
-                vlc_cond_signal( &p_sys->cond );
-                vlc_mutex_unlock( &p_sys->lock_out );
+                transcode_video_encoder_push( p_stream, p_tmp );
             }
         }
         else
@@ -803,6 +994,416 @@ static void OutputFrame( sout_stream_t *p_stream, picture_t *p_pic, sout_stream_
         picture_Release( p_pic );
 }
 
+/* Takes one decoded picture through the filters to the encoder.
+ * p_fmt_dec is the format the decoder gave to that picture. */
+static int transcode_video_filter_process( sout_stream_t *p_stream,
+                                           sout_stream_id_sys_t *id,
+                                           picture_t *p_pic,
+                                           es_format_t *p_fmt_dec,
+                                           block_t **out )
+{
+    sout_stream_sys_t *p_sys = p_stream->p_sys;
+
+    if( unlikely (
+         id->p_encoder->p_module &&
+         !video_format_IsSimilar( &id->fmt_input_video, &p_fmt_dec->video )
+        )
+      )
+    {
+        msg_Info( p_stream, "aspect-ratio changed, reiniting. %i -> %i : %i -> %i.",
+                    id->fmt_input_video.i_sar_num, p_fmt_dec->video.i_sar_num,
+                    id->fmt_input_video.i_sar_den, p_fmt_dec->video.i_sar_den
+                );
+        /* Close filters */
+        if( id->p_f_chain )
+            filter_chain_Delete( id->p_f_chain );
+        id->p_f_chain = NULL;
+        if( id->p_uf_chain )
+            filter_chain_Delete( id->p_uf_chain );
+        id->p_uf_chain = NULL;
+        if( id->p_conv_chain )
+            filter_chain_Delete( id->p_conv_chain );
+        id->p_conv_chain = NULL;
+
+        /* Reinitialize filters */
+        id->p_encoder->fmt_out.video.i_visible_width  = p_sys->i_width & ~1;
+        id->p_encoder->fmt_out.video.i_visible_height = p_sys->i_height & ~1;
+        id->p_encoder->fmt_out.video.i_sar_num = id->p_encoder->fmt_out.video.i_sar_den = 0;
+
+        transcode_video_filter_init( p_stream, id, p_fmt_dec );
+        transcode_video_encoder_init( p_stream, id, p_fmt_dec );
+        conversion_video_filter_append( p_stream, id, p_fmt_dec );
+        memcpy( &id->fmt_input_video, &p_fmt_dec->video, sizeof(video_format_t));
+    }
+
+
+    if( unlikely( !id->p_encoder->p_module ) )
+    {
+        if( id->p_f_chain )
+            filter_chain_Delete( id->p_f_chain );
+        if( id->p_uf_chain )
+            filter_chain_Delete( id->p_uf_chain );
+        if( id->p_conv_chain )
+            filter_chain_Delete( id->p_conv_chain );
+        id->p_f_chain = id->p_uf_chain = id->p_conv_chain = NULL;
+
+        transcode_video_filter_init( p_stream, id, p_fmt_dec );
+        transcode_video_encoder_init( p_stream, id, p_fmt_dec );
+        conversion_video_filter_append( p_stream, id, p_fmt_dec );
+        memcpy( &id->fmt_input_video, &p_fmt_dec->video, sizeof(video_format_t));
+
+        if( transcode_video_encoder_open( p_stream, id ) != VLC_SUCCESS )
+        {
+            picture_Release( p_pic );
+            return VLC_EGENERIC;
+        }
+        if( p_sys->b_pipeline )
+        {
+            /* The sout thread declares the stream */
+            vlc_mutex_lock( &p_sys->lock_out );
+            p_sys->b_encoder_ready = true;
+            vlc_mutex_unlock( &p_sys->lock_out );
+        }
+        else if( transcode_video_encoder_add( p_stream, id ) != VLC_SUCCESS )
+        {
+            picture_Release( p_pic );
+            return VLC_EGENERIC;
+        }
+        date_Set( &id->next_output_pts, p_pic->date );
+        date_Set( &id->next_input_pts, p_pic->date );
+    }
+
+    /*Input lipsync and drop check */
+    if( p_sys->b_master_sync )
+    {
+        /* If input pts lower than next_output_pts - output_frame_interval
+         * Then the future input frame should fit better and we can drop this one 
+         *
+         * We check this here as we don't need to run video filter at all for pictures
+         * we are going to drop anyway
+         *
+         * Duplication need is checked in OutputFrame */
+        if( ( p_pic->date ) <
+            ( date_Get( &id->next_output_pts ) - (mtime_t)id->i_output_frame_interval ) )
+        {
+#if 0
+            msg_Dbg( p_stream, "dropping frame (%"PRId64" + %"PRId64" vs %"PRId64")",
+                     p_pic->date, id->i_input_frame_interval, date_Get(&id->next_output_pts) );
+#endif
+            picture_Release( p_pic );
+            date_Increment( &id->next_input_pts, p_fmt_dec->video.i_frame_rate_base );
+            return VLC_SUCCESS;
+        }
+#if 0
+        msg_Dbg( p_stream, "not dropping frame");
+#endif
+
+    }
+    /* Check input drift regardless, if it's more than 100ms from our approximation, we most likely have lost pictures
+     * and are in danger to become out of sync, so better reset timestamps then */
+    if( likely( p_pic->date != VLC_TS_INVALID ) )
+    {
+        mtime_t input_drift = p_pic->date - date_Get( &id->next_input_pts );
+        if( unlikely( (input_drift > (CLOCK_FREQ/10)) ||
+                      (input_drift < -(CLOCK_FREQ/10))
+           ) )
+        {
+            msg_Warn( p_stream, "Reseting video sync" );
+            date_Set( &id->next_output_pts, p_pic->date );
+            date_Set( &id->next_input_pts, p_pic->date );
+        }
+    }
+    date_Increment( &id->next_input_pts, p_fmt_dec->video.i_frame_rate_base );
+
+    /* Run the filter and output chains; first with the picture,
+     * and then with NULL as many times as we need until they
+     * stop outputting frames.
+     */
+    for ( ;; ) {
+        picture_t *p_filtered_pic = p_pic;
+
+        /* Run filter chain */
+        if( id->p_f_chain )
+            p_filtered_pic = filter_chain_VideoFilter( id->p_f_chain, p_filtered_pic );
+        if( !p_filtered_pic )
+            break;
+
+        for ( ;; ) {
+            picture_t *p_user_filtered_pic = p_filtered_pic;
+
+            /* Run user specified filter chain */
+            if( id->p_uf_chain )
+                p_user_filtered_pic = filter_chain_VideoFilter( id->p_uf_chain, p_user_filtered_pic );
+            if( !p_user_filtered_pic )
+                break;
+
+            /* Feed the extra renditions before the encoder conversion */
+            if( id == p_sys->id_rendition )
+                transcode_rendition_video_process( p_stream, p_user_filtered_pic,
+                        filter_chain_GetFmtOut( id->p_uf_chain ? id->p_uf_chain
+                                                               : id->p_f_chain ) );
+
+            for ( ;; ) {
+                picture_t *p_conv_pic = p_user_filtered_pic;
+
+                /* Run the conversion to the encoder format */
+                if( id->p_conv_chain )
+                    p_conv_pic = filter_chain_VideoFilter( id->p_conv_chain, p_conv_pic );
+                if( !p_conv_pic )
+                    break;
+
+                OutputFrame( p_stream, p_conv_pic, id, out );
+
+                p_user_filtered_pic = NULL;
+            }
+
+            p_filtered_pic = NULL;
+        }
+
+        p_pic = NULL;
+    }
+
+    return VLC_SUCCESS;
+}
+
+static void* DecodeThread( void *obj )
+{
+    sout_stream_t *p_stream = obj;
+    sout_stream_sys_t *p_sys = p_stream->p_sys;
+    sout_stream_id_sys_t *id = p_sys->id_video;
+    void *p_item;
+    unsigned i_depth;
+    int canc = vlc_savecancel();
+
+    while( transcode_queue_Get( &p_sys->decode_queue, &p_item, &i_depth ) )
+    {
+        block_t *p_block = p_item;
+        picture_t *p_pic;
+
+        var_SetInteger( p_stream, "transcode-decode-depth", i_depth );
+        if( p_block == NULL )
+        {
+            /* End of stream, let the next stages finish */
+            transcode_queue_Put( &p_sys->filter_queue, NULL );
+            break;
+        }
+
+        /* Only the decoding itself is timed, not the hand-off */
+        mtime_t i_start = mdate(), i_duration = 0;
+        while( (p_pic = id->p_decoder->pf_decode_video( id->p_decoder, &p_block )) )
+        {
+            i_duration += mdate() - i_start;
+            transcode_queue_Put( &p_sys->filter_queue, p_pic );
+            i_start = mdate();
+        }
+        i_duration += mdate() - i_start;
+        transcode_video_stage_time( p_stream, "transcode-decode-time",
+                                    &p_sys->i_decode_time, i_duration );
+    }
+
+    vlc_restorecancel( canc );
+    return NULL;
+}
+
+static void* FilterThread( void *obj )
+{
+    sout_stream_t *p_stream = obj;
+    sout_stream_sys_t *p_sys = p_stream->p_sys;
+    sout_stream_id_sys_t *id = p_sys->id_video;
+    void *p_item;
+    unsigned i_depth;
+    int canc = vlc_savecancel();
+
+    while( transcode_queue_Get( &p_sys->filter_queue, &p_item, &i_depth ) )
+    {
+        picture_t *p_pic = p_item;
+
+        var_SetInteger( p_stream, "transcode-filter-depth", i_depth );
+        if( p_pic == NULL )
+        {
+            /* End of stream, the encoder thread flushes what is left */
+            vlc_mutex_lock( &p_sys->lock_out );
+            p_sys->b_abort = true;
+            vlc_cond_signal( &p_sys->cond );
+            vlc_mutex_unlock( &p_sys->lock_out );
+            break;
+        }
+
+        if( p_sys->b_pipeline_error )
+        {
+            picture_Release( p_pic );
+            continue;
+        }
+
+        /* The decoder may already be ahead with another format, so follow
+         * the one of the picture rather than p_decoder->fmt_out */
+        if( !video_format_IsSimilar( &p_sys->fmt_dec.video, &p_pic->format ) )
+        {
+            es_format_Init( &p_sys->fmt_dec, VIDEO_ES, p_pic->format.i_chroma );
+            p_sys->fmt_dec.video = p_pic->format;
+        }
+
+        const mtime_t i_start = mdate();
+        mtime_t i_wait;
+
+        /* i_filter_wait is accumulated under lock_out by encoder_push */
+        vlc_mutex_lock( &p_sys->lock_out );
+        p_sys->i_filter_wait = 0;
+        vlc_mutex_unlock( &p_sys->lock_out );
+
+        int i_ret = transcode_video_filter_process( p_stream, id, p_pic,
+                                                    &p_sys->fmt_dec, NULL );
+
+        vlc_mutex_lock( &p_sys->lock_out );
+        if( i_ret )
+            p_sys->b_pipeline_error = true;
+        i_wait = p_sys->i_filter_wait;
+        vlc_mutex_unlock( &p_sys->lock_out );
+
+        transcode_video_stage_time( p_stream, "transcode-filter-time",
+                                    &p_sys->i_filter_time,
+                                    mdate() - i_start - i_wait );
+    }
+
+    vlc_restorecancel( canc );
+    return NULL;
+}
+
+static const char *const ppsz_pipeline_vars[] = {
+    "transcode-decode-time", "transcode-decode-depth",
+    "transcode-filter-time", "transcode-filter-depth",
+    "transcode-encode-time", "transcode-encode-depth",
+};
+#define PIPELINE_VARS (sizeof(ppsz_pipeline_vars) / sizeof(*ppsz_pipeline_vars))
+
+static int transcode_video_pipeline_start( sout_stream_t *p_stream,
+                                           int i_priority )
+{
+    sout_stream_sys_t *p_sys = p_stream->p_sys;
+
+    if( transcode_queue_Init( &p_sys->decode_queue, p_sys->i_pipeline_depth,
+                              transcode_queue_ReleaseBlock ) )
+        return VLC_ENOMEM;
+    if( transcode_queue_Init( &p_sys->filter_queue, p_sys->i_pipeline_depth,
+                              transcode_queue_ReleasePicture ) )
+    {
+        transcode_queue_Clean( &p_sys->decode_queue );
+        return VLC_ENOMEM;
+    }
+    es_format_Init( &p_sys->fmt_dec, VIDEO_ES, 0 );
+    p_sys->b_encoder_ready = false;
+    p_sys->b_pipeline_error = false;
+    p_sys->i_decode_time = p_sys->i_filter_time = p_sys->i_encode_time = 0;
+
+    for( size_t i = 0; i < PIPELINE_VARS; i++ )
+        var_Create( p_stream, ppsz_pipeline_vars[i], VLC_VAR_INTEGER );
+
+    if( vlc_clone( &p_sys->decode_thread, DecodeThread, p_stream, i_priority ) )
+        goto error;
+    if( vlc_clone( &p_sys->filter_thread, FilterThread, p_stream, i_priority ) )
+    {
+        transcode_queue_Abort( &p_sys->decode_queue );
+        vlc_join( p_sys->decode_thread, NULL );
+        goto error;
+    }
+    p_sys->b_pipeline_running = true;
+    return VLC_SUCCESS;
+
+error:
+    for( size_t i = 0; i < PIPELINE_VARS; i++ )
+        var_Destroy( p_stream, ppsz_pipeline_vars[i] );
+    transcode_queue_Clean( &p_sys->filter_queue );
+    transcode_queue_Clean( &p_sys->decode_queue );
+    return VLC_EGENERIC;
+}
+
+/* Joins the decoder, filter and encoder threads. Unless b_abort is set, the
+ * end of stream must have been queued already so that they all drain. */
+static void transcode_video_pipeline_stop( sout_stream_t *p_stream,
+                                           bool b_abort )
+{
+    sout_stream_sys_t *p_sys = p_stream->p_sys;
+
+    if( !p_sys->b_pipeline_running )
+        return;
+
+    if( b_abort )
+    {
+        transcode_queue_Abort( &p_sys->decode_queue );
+        transcode_queue_Abort( &p_sys->filter_queue );
+        vlc_mutex_lock( &p_sys->lock_out );
+        p_sys->b_abort = true;
+        vlc_cond_signal( &p_sys->cond );
+        vlc_cond_broadcast( &p_sys->cond_space );
+        vlc_mutex_unlock( &p_sys->lock_out );
+    }
+
+    vlc_join( p_sys->decode_thread, NULL );
+    vlc_join( p_sys->filter_thread, NULL );
+    vlc_join( p_sys->thread, NULL );
+    p_sys->b_pipeline_running = false;
+
+    msg_Dbg( p_stream, "video pipeline stage times: decode %"PRId64
+             " us, filter %"PRId64" us, encode %"PRId64" us",
+             p_sys->i_decode_time, p_sys->i_filter_time, p_sys->i_encode_time );
+
+    transcode_queue_Clean( &p_sys->filter_queue );
+    transcode_queue_Clean( &p_sys->decode_queue );
+    for( size_t i = 0; i < PIPELINE_VARS; i++ )
+        var_Destroy( p_stream, ppsz_pipeline_vars[i] );
+}
+
+/* In pipeline mode, the sout thread only feeds the decoder thread and picks
+ * up what the encoder thread produced */
+static int transcode_video_pipeline_process( sout_stream_t *p_stream,
+                                             sout_stream_id_sys_t *id,
+                                             block_t *in, block_t **out )
+{
+    sout_stream_sys_t *p_sys = p_stream->p_sys;
+
+    /* This waits while the decoder thread is behind */
+    transcode_queue_Put( &p_sys->decode_queue, in );
+
+    if( unlikely( in == NULL ) )
+    {
+        msg_Dbg( p_stream, "Flushing pipeline and waiting that");
+        transcode_video_pipeline_stop( p_stream, false );
+    }
+
+    vlc_mutex_lock( &p_sys->lock_out );
+    const bool b_error = p_sys->b_pipeline_error;
+    const bool b_ready = p_sys->b_encoder_ready;
+    p_sys->b_encoder_ready = false;
+    vlc_mutex_unlock( &p_sys->lock_out );
+
+    if( unlikely( b_error ) ||
+        ( b_ready && transcode_video_encoder_add( p_stream, id ) != VLC_SUCCESS ) )
+    {
+        /* The final drain comes from Del(), which closes the ES itself */
+        if( in != NULL )
+        {
+            transcode_video_close( p_stream, id );
+            id->b_transcode = false;
+        }
+        return VLC_EGENERIC;
+    }
+
+    /* Pick up any return data the encoder thread wants to output,
+     * once the stream has been declared. */
+    if( id->id )
+    {
+        vlc_mutex_lock( &p_sys->lock_out );
+        *out = p_sys->p_buffers;
+        p_sys->p_buffers = NULL;
+        vlc_mutex_unlock( &p_sys->lock_out );
+    }
+
+    if( id == p_sys->id_rendition )
+        transcode_rendition_video_output( p_stream, in == NULL );
+
+    return VLC_SUCCESS;
+}
+
 int transcode_video_process( sout_stream_t *p_stream, sout_stream_id_sys_t *id,
                                     block_t *in, block_t **out )
 {
@@ -810,6 +1411,9 @@ int transcode_video_process( sout_stream_t *p_stream, sout_stream_id_sys_t *id,
     picture_t *p_pic = NULL;
     *out = NULL;
 
+    if( p_sys->b_pipeline )
+        return transcode_video_pipeline_process( p_stream, id, in, out );
+
     if( unlikely( in == NULL ) )
     {
         if( p_sys->i_threads == 0 )
@@ -836,137 +1440,20 @@ int transcode_video_process( sout_stream_t *p_stream, sout_stream_id_sys_t *id,
 
             msg_Dbg( p_stream, "Flushing done");
         }
+        if( id == p_sys->id_rendition )
+            transcode_rendition_video_output( p_stream, true );
         return VLC_SUCCESS;
     }
 
 
     while( (p_pic = id->p_decoder->pf_decode_video( id->p_decoder, &in )) )
     {
-
-        if( unlikely (
-             id->p_encoder->p_module &&
-             !video_format_IsSimilar( &id->fmt_input_video, &id->p_decoder->fmt_out.video )
-            )
-          )
-        {
-            msg_Info( p_stream, "aspect-ratio changed, reiniting. %i -> %i : %i -> %i.",
-                        id->fmt_input_video.i_sar_num, id->p_decoder->fmt_out.video.i_sar_num,
-                        id->fmt_input_video.i_sar_den, id->p_decoder->fmt_out.video.i_sar_den
-                    );
-            /* Close filters */
-            if( id->p_f_chain )
-                filter_chain_Delete( id->p_f_chain );
-            id->p_f_chain = NULL;
-            if( id->p_uf_chain )
-                filter_chain_Delete( id->p_uf_chain );
-            id->p_uf_chain = NULL;
-
-            /* Reinitialize filters */
-            id->p_encoder->fmt_out.video.i_visible_width  = p_sys->i_width & ~1;
-            id->p_encoder->fmt_out.video.i_visible_height = p_sys->i_height & ~1;
-            id->p_encoder->fmt_out.video.i_sar_num = id->p_encoder->fmt_out.video.i_sar_den = 0;
-
-            transcode_video_filter_init( p_stream, id );
-            transcode_video_encoder_init( p_stream, id );
-            conversion_video_filter_append( id );
-            memcpy( &id->fmt_input_video, &id->p_decoder->fmt_out.video, sizeof(video_format_t));
-        }
-
-
-        if( unlikely( !id->p_encoder->p_module ) )
-        {
-            if( id->p_f_chain )
-                filter_chain_Delete( id->p_f_chain );
-            if( id->p_uf_chain )
-                filter_chain_Delete( id->p_uf_chain );
-            id->p_f_chain = id->p_uf_chain = NULL;
-
-            transcode_video_filter_init( p_stream, id );
-            transcode_video_encoder_init( p_stream, id );
-            conversion_video_filter_append( id );
-            memcpy( &id->fmt_input_video, &id->p_decoder->fmt_out.video, sizeof(video_format_t));
-
-            if( transcode_video_encoder_open( p_stream, id ) != VLC_SUCCESS )
-            {
-                picture_Release( p_pic );
-                transcode_video_close( p_stream, id );
-                id->b_transcode = false;
-                return VLC_EGENERIC;
-            }
-            date_Set( &id->next_output_pts, p_pic->date );
-            date_Set( &id->next_input_pts, p_pic->date );
-        }
-
-        /*Input lipsync and drop check */
-        if( p_sys->b_master_sync )
-        {
-            /* If input pts lower than next_output_pts - output_frame_interval
-             * Then the future input frame should fit better and we can drop this one 
-             *
-             * We check this here as we don't need to run video filter at all for pictures
-             * we are going to drop anyway
-             *
-             * Duplication need is checked in OutputFrame */
-            if( ( p_pic->date ) <
-                ( date_Get( &id->next_output_pts ) - (mtime_t)id->i_output_frame_interval ) )
-            {
-#if 0
-                msg_Dbg( p_stream, "dropping frame (%"PRId64" + %"PRId64" vs %"PRId64")",
-                         p_pic->date, id->i_input_frame_interval, date_Get(&id->next_output_pts) );
-#endif
-                picture_Release( p_pic );
-                date_Increment( &id->next_input_pts, id->p_decoder->fmt_out.video.i_frame_rate_base );
-                continue;
-            }
-#if 0
-            msg_Dbg( p_stream, "not dropping frame");
-#endif
-
-        }
-        /* Check input drift regardless, if it's more than 100ms from our approximation, we most likely have lost pictures
-         * and are in danger to become out of sync, so better reset timestamps then */
-        if( likely( p_pic->date != VLC_TS_INVALID ) )
+        if( transcode_video_filter_process( p_stream, id, p_pic,
+                                            &id->p_decoder->fmt_out, out ) )
         {
-            mtime_t input_drift = p_pic->date - date_Get( &id->next_input_pts );
-            if( unlikely( (input_drift > (CLOCK_FREQ/10)) ||
-                          (input_drift < -(CLOCK_FREQ/10))
-               ) )
-            {
-                msg_Warn( p_stream, "Reseting video sync" );
-                date_Set( &id->next_output_pts, p_pic->date );
-                date_Set( &id->next_input_pts, p_pic->date );
-            }
-        }
-        date_Increment( &id->next_input_pts, id->p_decoder->fmt_out.video.i_frame_rate_base );
-
-        /* Run the filter and output chains; first with the picture,
-         * and then with NULL as many times as we need until they
-         * stop outputting frames.
-         */
-        for ( ;; ) {
-            picture_t *p_filtered_pic = p_pic;
-
-            /* Run filter chain */
-            if( id->p_f_chain )
-                p_filtered_pic = filter_chain_VideoFilter( id->p_f_chain, p_filtered_pic );
-            if( !p_filtered_pic )
-                break;
-
-            for ( ;; ) {
-                picture_t *p_user_filtered_pic = p_filtered_pic;
-
-                /* Run user specified filter chain */
-                if( id->p_uf_chain )
-                    p_user_filtered_pic = filter_chain_VideoFilter( id->p_uf_chain, p_user_filtered_pic );
-                if( !p_user_filtered_pic )
-                    break;
-
-                OutputFrame( p_stream, p_user_filtered_pic, id, out );
-
-                p_filtered_pic = NULL;
-            }
-
-            p_pic = NULL;
+            transcode_video_close( p_stream, id );
+            id->b_transcode = false;
+            return VLC_EGENERIC;
         }
     }
 
@@ -979,6 +1466,9 @@ int transcode_video_process( sout_stream_t *p_stream, sout_stream_id_sys_t *id,
         vlc_mutex_unlock( &p_sys->lock_out );
     }
 
+    if( id == p_sys->id_rendition )
+        transcode_rendition_video_output( p_stream, false );
+
     return VLC_SUCCESS;
 }
 
@@ -1008,6 +1498,10 @@ bool transcode_video_add( sout_stream_t *p_stream, es_format_t *p_fmt,
      * all the characteristics of the decoded stream yet */
     id->b_transcode = true;
 
+    /* The first transcoded video ES feeds the extra renditions */
+    if( p_sys->i_renditions > 0 && p_sys->id_rendition == NULL )
+        p_sys->id_rendition = id;
+
     if( p_sys->fps_num )
     {
         id->p_encoder->fmt_out.video.i_frame_rate = (p_sys->fps_num );
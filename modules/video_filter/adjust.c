@@ -129,8 +129,21 @@ struct filter_sys_t
                                        int, int );
     int        (* pf_process_sat_hue_clip)( picture_t *, picture_t *, int, int,
                                             int, int, int );
+    filter_slices_t *p_slices;
 };
 
+/* Parameters of one picture, shared by the slices */
+typedef struct
+{
+    picture_t *p_pic;
+    picture_t *p_outpic;
+    const int *pi_luma;
+    int        i_y_offset;  /* Packed YUV only */
+    int        (* pf_process_sat_hue)( picture_t *, picture_t *, int, int, int,
+                                       int, int );
+    int        i_sin, i_cos, i_sat, i_x, i_y;
+} adjust_job_t;
+
 /*****************************************************************************
  * Create: allocates adjust video filter
  *****************************************************************************/
@@ -188,6 +201,8 @@ static int Create( vlc_object_t *p_this )
             return VLC_EGENERIC;
     }
 
+    p_sys->p_slices = filter_NewSlices( p_filter );
+
     vlc_mutex_init( &p_sys->lock );
     var_AddCallback( p_filter, "contrast",   AdjustCallback, p_sys );
     var_AddCallback( p_filter, "brightness", AdjustCallback, p_sys );
@@ -216,10 +231,131 @@ static void Destroy( vlc_object_t *p_this )
     var_DelCallback( p_filter, "brightness-threshold",
                                              AdjustCallback, p_sys );
 
+    filter_DeleteSlices( p_sys->p_slices );
     vlc_mutex_destroy( &p_sys->lock );
     free( p_sys );
 }
 
+/*****************************************************************************
+ * Process a band of a Planar YUV picture
+ *****************************************************************************/
+static void PlanarSlice( void *p_data, unsigned i_slice, unsigned i_slices )
+{
+    const adjust_job_t *p_job = p_data;
+    picture_t pic, outpic;
+    uint8_t *p_in, *p_in_end, *p_line_end;
+    uint8_t *p_out;
+    const int *pi_luma = p_job->pi_luma;
+
+    filter_SlicePicture( &pic, p_job->p_pic, i_slice, i_slices, 4 );
+    filter_SlicePicture( &outpic, p_job->p_outpic, i_slice, i_slices, 4 );
+
+    /*
+     * Do the Y plane
+     */
+
+    p_in = pic.p[Y_PLANE].p_pixels;
+    p_in_end = p_in + pic.p[Y_PLANE].i_visible_lines
+                      * pic.p[Y_PLANE].i_pitch - 8;
+
+    p_out = outpic.p[Y_PLANE].p_pixels;
+
+    for( ; p_in < p_in_end ; )
+    {
+        p_line_end = p_in + pic.p[Y_PLANE].i_visible_pitch - 8;
+
+        for( ; p_in < p_line_end ; )
+        {
+            /* Do 8 pixels at a time */
+            *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
+            *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
+            *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
+            *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
+        }
+
+        p_line_end += 8;
+
+        for( ; p_in < p_line_end ; )
+        {
+            *p_out++ = pi_luma[ *p_in++ ];
+        }
+
+        p_in += pic.p[Y_PLANE].i_pitch
+              - pic.p[Y_PLANE].i_visible_pitch;
+        p_out += outpic.p[Y_PLANE].i_pitch
+               - outpic.p[Y_PLANE].i_visible_pitch;
+    }
+
+    /*
+     * Do the U and V planes
+     */
+
+    p_job->pf_process_sat_hue( &pic, &outpic, p_job->i_sin, p_job->i_cos,
+                               p_job->i_sat, p_job->i_x, p_job->i_y );
+}
+
+/*****************************************************************************
+ * Process a band of a Packed YUV picture
+ *****************************************************************************/
+static void PackedSlice( void *p_data, unsigned i_slice, unsigned i_slices )
+{
+    const adjust_job_t *p_job = p_data;
+    picture_t pic, outpic;
+    uint8_t *p_in, *p_in_end, *p_line_end;
+    uint8_t *p_out;
+    const int *pi_luma = p_job->pi_luma;
+
+    filter_SlicePicture( &pic, p_job->p_pic, i_slice, i_slices, 1 );
+    filter_SlicePicture( &outpic, p_job->p_outpic, i_slice, i_slices, 1 );
+
+    const int i_pitch = pic.p->i_pitch;
+    const int i_visible_pitch = pic.p->i_visible_pitch;
+
+    /*
+     * Do the Y plane
+     */
+
+    p_in = pic.p->p_pixels + p_job->i_y_offset;
+    p_in_end = p_in + pic.p->i_visible_lines * pic.p->i_pitch - 8 * 4;
+
+    p_out = outpic.p->p_pixels + p_job->i_y_offset;
+
+    for( ; p_in < p_in_end ; )
+    {
+        p_line_end = p_in + i_visible_pitch - 8 * 4;
+
+        for( ; p_in < p_line_end ; )
+        {
+            /* Do 8 pixels at a time */
+            *p_out = pi_luma[ *p_in ]; p_in += 2; p_out += 2;
+            *p_out = pi_luma[ *p_in ]; p_in += 2; p_out += 2;
+            *p_out = pi_luma[ *p_in ]; p_in += 2; p_out += 2;
+            *p_out = pi_luma[ *p_in ]; p_in += 2; p_out += 2;
+            *p_out = pi_luma[ *p_in ]; p_in += 2; p_out += 2;
+            *p_out = pi_luma[ *p_in ]; p_in += 2; p_out += 2;
+            *p_out = pi_luma[ *p_in ]; p_in += 2; p_out += 2;
+            *p_out = pi_luma[ *p_in ]; p_in += 2; p_out += 2;
+        }
+
+        p_line_end += 8 * 4;
+
+        for( ; p_in < p_line_end ; )
+        {
+            *p_out = pi_luma[ *p_in ]; p_in += 2; p_out += 2;
+        }
+
+        p_in += i_pitch - pic.p->i_visible_pitch;
+        p_out += i_pitch - outpic.p->i_visible_pitch;
+    }
+
+    /*
+     * Do the U and V planes
+     */
+
+    p_job->pf_process_sat_hue( &pic, &outpic, p_job->i_sin, p_job->i_cos,
+                               p_job->i_sat, p_job->i_x, p_job->i_y );
+}
+
 /*****************************************************************************
  * Run the filter on a Planar YUV picture
  *****************************************************************************/
@@ -229,8 +365,6 @@ static picture_t *FilterPlanar( filter_t *p_filter, picture_t *p_pic )
     int pi_gamma[256];
 
     picture_t *p_outpic;
-    uint8_t *p_in, *p_in_end, *p_line_end;
-    uint8_t *p_out;
 
     bool b_thres;
     double  f_hue;
@@ -300,43 +434,7 @@ static picture_t *FilterPlanar( filter_t *p_filter, picture_t *p_pic )
     }
 
     /*
-     * Do the Y plane
-     */
-
-    p_in = p_pic->p[Y_PLANE].p_pixels;
-    p_in_end = p_in + p_pic->p[Y_PLANE].i_visible_lines
-                      * p_pic->p[Y_PLANE].i_pitch - 8;
-
-    p_out = p_outpic->p[Y_PLANE].p_pixels;
-
-    for( ; p_in < p_in_end ; )
-    {
-        p_line_end = p_in + p_pic->p[Y_PLANE].i_visible_pitch - 8;
-
-        for( ; p_in < p_line_end ; )
-        {
-            /* Do 8 pixels at a time */
-            *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
-            *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
-            *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
-            *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
-        }
-
-        p_line_end += 8;
-
-        for( ; p_in < p_line_end ; )
-        {
-            *p_out++ = pi_luma[ *p_in++ ];
-        }
-
-        p_in += p_pic->p[Y_PLANE].i_pitch
-              - p_pic->p[Y_PLANE].i_visible_pitch;
-        p_out += p_outpic->p[Y_PLANE].i_pitch
-               - p_outpic->p[Y_PLANE].i_visible_pitch;
-    }
-
-    /*
-     * Do the U and V planes
+     * Hue and saturation parameters of the U and V planes
      */
 
     i_sin = sin(f_hue) * 256;
@@ -345,20 +443,16 @@ static picture_t *FilterPlanar( filter_t *p_filter, picture_t *p_pic )
     i_x = ( cos(f_hue) + sin(f_hue) ) * 32768;
     i_y = ( cos(f_hue) - sin(f_hue) ) * 32768;
 
-    if ( i_sat > 256 )
-    {
-        /* Currently no errors are implemented in the function, if any are added
-         * check them here */
-        p_sys->pf_process_sat_hue_clip( p_pic, p_outpic, i_sin, i_cos, i_sat,
-                                        i_x, i_y );
-    }
-    else
-    {
-        /* Currently no errors are implemented in the function, if any are added
-         * check them here */
-        p_sys->pf_process_sat_hue( p_pic, p_outpic, i_sin, i_cos, i_sat,
-                                        i_x, i_y );
-    }
+    /* Process the picture in horizontal bands */
+    adjust_job_t job = {
+        .p_pic = p_pic, .p_outpic = p_outpic, .pi_luma = pi_luma,
+        /* Currently no errors are implemented in the function, if any are
+         * added check them here */
+        .pf_process_sat_hue = i_sat > 256 ? p_sys->pf_process_sat_hue_clip
+                                          : p_sys->pf_process_sat_hue,
+        .i_sin = i_sin, .i_cos = i_cos, .i_sat = i_sat, .i_x = i_x, .i_y = i_y,
+    };
+    filter_RunSlices( p_sys->p_slices, PlanarSlice, &job );
 
     return CopyInfoAndRelease( p_outpic, p_pic );
 }
@@ -372,12 +466,8 @@ static picture_t *FilterPacked( filter_t *p_filter, picture_t *p_pic )
     int pi_gamma[256];
 
     picture_t *p_outpic;
-    uint8_t *p_in, *p_in_end, *p_line_end;
-    uint8_t *p_out;
     int i_y_offset, i_u_offset, i_v_offset;
 
-    int i_pitch, i_visible_pitch;
-
     bool b_thres;
     double  f_hue;
     double  f_gamma;
@@ -389,9 +479,6 @@ static picture_t *FilterPacked( filter_t *p_filter, picture_t *p_pic )
 
     if( !p_pic ) return NULL;
 
-    i_pitch = p_pic->p->i_pitch;
-    i_visible_pitch = p_pic->p->i_visible_pitch;
-
     if( GetPackedYuvOffsets( p_pic->format.i_chroma, &i_y_offset,
                              &i_u_offset, &i_v_offset ) != VLC_SUCCESS )
     {
@@ -461,44 +548,7 @@ static picture_t *FilterPacked( filter_t *p_filter, picture_t *p_pic )
     }
 
     /*
-     * Do the Y plane
-     */
-
-    p_in = p_pic->p->p_pixels + i_y_offset;
-    p_in_end = p_in + p_pic->p->i_visible_lines * p_pic->p->i_pitch - 8 * 4;
-
-    p_out = p_outpic->p->p_pixels + i_y_offset;
-
-    for( ; p_in < p_in_end ; )
-    {
-        p_line_end = p_in + i_visible_pitch - 8 * 4;
-
-        for( ; p_in < p_line_end ; )
-        {
-            /* Do 8 pixels at a time */
-            *p_out = pi_luma[ *p_in ]; p_in += 2; p_out += 2;
-            *p_out = pi_luma[ *p_in ]; p_in += 2; p_out += 2;
-            *p_out = pi_luma[ *p_in ]; p_in += 2; p_out += 2;
-            *p_out = pi_luma[ *p_in ]; p_in += 2; p_out += 2;
-            *p_out = pi_luma[ *p_in ]; p_in += 2; p_out += 2;
-            *p_out = pi_luma[ *p_in ]; p_in += 2; p_out += 2;
-            *p_out = pi_luma[ *p_in ]; p_in += 2; p_out += 2;
-            *p_out = pi_luma[ *p_in ]; p_in += 2; p_out += 2;
-        }
-
-        p_line_end += 8 * 4;
-
-        for( ; p_in < p_line_end ; )
-        {
-            *p_out = pi_luma[ *p_in ]; p_in += 2; p_out += 2;
-        }
-
-        p_in += i_pitch - p_pic->p->i_visible_pitch;
-        p_out += i_pitch - p_outpic->p->i_visible_pitch;
-    }
-
-    /*
-     * Do the U and V planes
+     * Hue and saturation parameters of the U and V planes
      */
 
     i_sin = sin(f_hue) * 256;
@@ -507,32 +557,17 @@ static picture_t *FilterPacked( filter_t *p_filter, picture_t *p_pic )
     i_x = ( cos(f_hue) + sin(f_hue) ) * 32768;
     i_y = ( cos(f_hue) - sin(f_hue) ) * 32768;
 
-    if ( i_sat > 256 )
-    {
-        if ( p_sys->pf_process_sat_hue_clip( p_pic, p_outpic, i_sin, i_cos, i_sat,
-                                             i_x, i_y ) != VLC_SUCCESS )
-        {
-            /* Currently only one error can happen in the function, but if there
-             * will be more of them, this message must go away */
-            msg_Warn( p_filter, "Unsupported input chroma (%4.4s)",
-                      (char*)&(p_pic->format.i_chroma) );
-            picture_Release( p_pic );
-            return NULL;
-        }
-    }
-    else
-    {
-        if ( p_sys->pf_process_sat_hue( p_pic, p_outpic, i_sin, i_cos, i_sat,
-                                        i_x, i_y ) != VLC_SUCCESS )
-        {
-            /* Currently only one error can happen in the function, but if there
-             * will be more of them, this message must go away */
-            msg_Warn( p_filter, "Unsupported input chroma (%4.4s)",
-                      (char*)&(p_pic->format.i_chroma) );
-            picture_Release( p_pic );
-            return NULL;
-        }
-    }
+    /* The saturation and hue functions can only fail on the chromas
+     * GetPackedYuvOffsets() rejected above */
+    /* Process the picture in horizontal bands */
+    adjust_job_t job = {
+        .p_pic = p_pic, .p_outpic = p_outpic, .pi_luma = pi_luma,
+        .i_y_offset = i_y_offset,
+        .pf_process_sat_hue = i_sat > 256 ? p_sys->pf_process_sat_hue_clip
+                                          : p_sys->pf_process_sat_hue,
+        .i_sin = i_sin, .i_cos = i_cos, .i_sat = i_sat, .i_x = i_x, .i_y = i_y,
+    };
+    filter_RunSlices( p_sys->p_slices, PackedSlice, &job );
 
     return CopyInfoAndRelease( p_outpic, p_pic );
 }
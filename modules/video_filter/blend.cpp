@@ -32,8 +32,13 @@
 #include <vlc_common.h>
 #include <vlc_plugin.h>
 #include <vlc_filter.h>
+#include <vlc_cpu.h>
 #include "filter_picture.h"
 
+#if defined(HAVE_SSE2_INTRINSICS) && (VLC_GCC_VERSION(4, 9) || defined(__clang__))
+# include <immintrin.h>
+#endif
+
 /*****************************************************************************
  * Module descriptor
  *****************************************************************************/
@@ -541,14 +546,822 @@ void Blend(const CPicture &dst_data, const CPicture &src_data,
     }
 }
 
+/*****************************************************************************
+ * Span kernels
+ *****************************************************************************
+ * The common pairs (YUVA and RGBA onto I420, NV12 and RV32) are blended a
+ * span of pixels at a time: the source line is split into planar rows, its
+ * alpha computed for the whole span, and the destination merged with
+ * vectorized kernels. Spans which are fully transparent are skipped before
+ * even reading the source colors, and the kernels store the source directly
+ * where the alpha is fully opaque.
+ * Every kernel comes as a C version and SSE2/AVX2 versions producing the
+ * same output bit for bit, which is also the output of Blend<> above.
+ */
+#define SPAN_MAX 256
+
+enum {
+    SPAN_TRANSPARENT,
+    SPAN_OPAQUE,
+    SPAN_MIXED,
+};
+
+static inline int SpanCoverage(unsigned all, unsigned any)
+{
+    if (any == 0)
+        return SPAN_TRANSPARENT;
+    if (all == 255)
+        return SPAN_OPAQUE;
+    return SPAN_MIXED;
+}
+
+/* a[i] = div255(alpha * src[i]). It returns the span coverage. a may
+ * alias src. */
+static int SpanAlphaC(uint8_t *a, const uint8_t *src, unsigned n,
+                      unsigned alpha, unsigned all = 255, unsigned any = 0)
+{
+    for (unsigned i = 0; i < n; i++) {
+        a[i] = div255(alpha * src[i]);
+        all &= a[i];
+        any |= a[i];
+    }
+    return SpanCoverage(all, any);
+}
+
+/* dst[i] = div255((255 - a[i]) * dst[i] + src[i] * a[i]) */
+static void SpanMergeC(uint8_t *dst, const uint8_t *src, const uint8_t *a,
+                       unsigned n)
+{
+    for (unsigned i = 0; i < n; i++)
+        ::merge(&dst[i], src[i], a[i]);
+}
+
+/* Merges the 4 bytes pixels of src onto dst with the alpha a[i] of each
+ * pixel, leaving the byte at offset pad of each pixel untouched */
+static void SpanMergeRGBXC(uint8_t *dst, const uint8_t *src, const uint8_t *a,
+                           unsigned n, unsigned pad)
+{
+    for (unsigned i = 0; i < n; i++) {
+        for (unsigned b = 0; b < 4; b++) {
+            if (b != pad)
+                ::merge(&dst[4 * i + b], src[4 * i + b], a[i]);
+        }
+    }
+}
+
+/* Splits n 4 bytes pixels into 4 planes */
+static void SpanDeinterleave4C(uint8_t *p0, uint8_t *p1, uint8_t *p2,
+                               uint8_t *p3, const uint8_t *src, unsigned n)
+{
+    for (unsigned i = 0; i < n; i++) {
+        p0[i] = src[4 * i + 0];
+        p1[i] = src[4 * i + 1];
+        p2[i] = src[4 * i + 2];
+        p3[i] = src[4 * i + 3];
+    }
+}
+
+/* Packs 3 planes into n 4 bytes pixels, at the given byte offsets */
+static void SpanInterleaveRGBXC(uint8_t *dst, const uint8_t *i, const uint8_t *j,
+                                const uint8_t *k, unsigned n,
+                                unsigned offset_i, unsigned offset_j,
+                                unsigned offset_k)
+{
+    for (unsigned x = 0; x < n; x++) {
+        dst[4 * x + offset_i] = i[x];
+        dst[4 * x + offset_j] = j[x];
+        dst[4 * x + offset_k] = k[x];
+    }
+}
+
+/* dst[i] = src[2 * i], src must hold 2 * n - 1 bytes */
+static void SpanPackEvenC(uint8_t *dst, const uint8_t *src, unsigned n)
+{
+    for (unsigned i = 0; i < n; i++)
+        dst[i] = src[2 * i];
+}
+
+/* Interleaves 2 planes of n bytes */
+static void SpanInterleave2C(uint8_t *dst, const uint8_t *p0, const uint8_t *p1,
+                             unsigned n)
+{
+    for (unsigned i = 0; i < n; i++) {
+        dst[2 * i + 0] = p0[i];
+        dst[2 * i + 1] = p1[i];
+    }
+}
+
+#if defined(HAVE_SSE2_INTRINSICS) && (VLC_GCC_VERSION(4, 9) || defined(__clang__))
+# define SPAN_SIMD_X86 1
+
+/* div255() of 8 or 16 words */
+__attribute__ ((__target__ ("sse2")))
+static inline __m128i SpanDiv255SSE2(__m128i v)
+{
+    v = _mm_add_epi16(_mm_add_epi16(v, _mm_srli_epi16(v, 8)),
+                      _mm_set1_epi16(1));
+    return _mm_srli_epi16(v, 8);
+}
+
+__attribute__ ((__target__ ("avx2")))
+static inline __m256i SpanDiv255AVX2(__m256i v)
+{
+    v = _mm256_add_epi16(_mm256_add_epi16(v, _mm256_srli_epi16(v, 8)),
+                         _mm256_set1_epi16(1));
+    return _mm256_srli_epi16(v, 8);
+}
+
+/* Merges 16 bytes, a being fully neither transparent nor opaque */
+__attribute__ ((__target__ ("sse2")))
+static inline __m128i SpanMerge16SSE2(__m128i d, __m128i s, __m128i a)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ia = _mm_xor_si128(a, _mm_set1_epi8(-1));
+    __m128i lo = _mm_add_epi16(
+        _mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi8(ia, zero)),
+        _mm_mullo_epi16(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(a, zero)));
+    __m128i hi = _mm_add_epi16(
+        _mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi8(ia, zero)),
+        _mm_mullo_epi16(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(a, zero)));
+    return _mm_packus_epi16(SpanDiv255SSE2(lo), SpanDiv255SSE2(hi));
+}
+
+__attribute__ ((__target__ ("avx2")))
+static inline __m256i SpanMerge32AVX2(__m256i d, __m256i s, __m256i a)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i ia = _mm256_xor_si256(a, _mm256_set1_epi8(-1));
+    __m256i lo = _mm256_add_epi16(
+        _mm256_mullo_epi16(_mm256_unpacklo_epi8(d, zero),
+                           _mm256_unpacklo_epi8(ia, zero)),
+        _mm256_mullo_epi16(_mm256_unpacklo_epi8(s, zero),
+                           _mm256_unpacklo_epi8(a, zero)));
+    __m256i hi = _mm256_add_epi16(
+        _mm256_mullo_epi16(_mm256_unpackhi_epi8(d, zero),
+                           _mm256_unpackhi_epi8(ia, zero)),
+        _mm256_mullo_epi16(_mm256_unpackhi_epi8(s, zero),
+                           _mm256_unpackhi_epi8(a, zero)));
+    /* unpack and pack work within 128 bits lanes: the order is kept */
+    return _mm256_packus_epi16(SpanDiv255AVX2(lo), SpanDiv255AVX2(hi));
+}
+
+__attribute__ ((__target__ ("sse2")))
+static int SpanAlphaSSE2(uint8_t *a, const uint8_t *src, unsigned n,
+                         unsigned alpha)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i factor = _mm_set1_epi16(alpha);
+    __m128i all = _mm_set1_epi8(-1);
+    __m128i any = zero;
+    unsigned i = 0;
+
+    for (; i + 16 <= n; i += 16) {
+        const __m128i s = _mm_loadu_si128((const __m128i *)&src[i]);
+        const __m128i r = _mm_packus_epi16(
+            SpanDiv255SSE2(_mm_mullo_epi16(_mm_unpacklo_epi8(s, zero), factor)),
+            SpanDiv255SSE2(_mm_mullo_epi16(_mm_unpackhi_epi8(s, zero), factor)));
+        _mm_storeu_si128((__m128i *)&a[i], r);
+        all = _mm_and_si128(all, r);
+        any = _mm_or_si128(any, r);
+    }
+    const bool all_opaque = _mm_movemask_epi8(
+        _mm_cmpeq_epi8(all, _mm_set1_epi8(-1))) == 0xffff;
+    const bool all_transparent = _mm_movemask_epi8(
+        _mm_cmpeq_epi8(any, zero)) == 0xffff;
+    return SpanAlphaC(&a[i], &src[i], n - i, alpha,
+                      all_opaque ? 255 : 0, all_transparent ? 0 : 255);
+}
+
+__attribute__ ((__target__ ("avx2")))
+static int SpanAlphaAVX2(uint8_t *a, const uint8_t *src, unsigned n,
+                         unsigned alpha)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i factor = _mm256_set1_epi16(alpha);
+    __m256i all = _mm256_set1_epi8(-1);
+    __m256i any = zero;
+    unsigned i = 0;
+
+    for (; i + 32 <= n; i += 32) {
+        const __m256i s = _mm256_loadu_si256((const __m256i *)&src[i]);
+        const __m256i r = _mm256_packus_epi16(
+            SpanDiv255AVX2(_mm256_mullo_epi16(_mm256_unpacklo_epi8(s, zero),
+                                              factor)),
+            SpanDiv255AVX2(_mm256_mullo_epi16(_mm256_unpackhi_epi8(s, zero),
+                                              factor)));
+        _mm256_storeu_si256((__m256i *)&a[i], r);
+        all = _mm256_and_si256(all, r);
+        any = _mm256_or_si256(any, r);
+    }
+    const bool all_opaque = _mm256_movemask_epi8(
+        _mm256_cmpeq_epi8(all, _mm256_set1_epi8(-1))) == -1;
+    const bool all_transparent = _mm256_movemask_epi8(
+        _mm256_cmpeq_epi8(any, zero)) == -1;
+    return SpanAlphaC(&a[i], &src[i], n - i, alpha,
+                      all_opaque ? 255 : 0, all_transparent ? 0 : 255);
+}
+
+__attribute__ ((__target__ ("sse2")))
+static void SpanMergeSSE2(uint8_t *dst, const uint8_t *src, const uint8_t *a,
+                          unsigned n)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i full = _mm_set1_epi8(-1);
+    unsigned i = 0;
+
+    for (; i + 16 <= n; i += 16) {
+        const __m128i va = _mm_loadu_si128((const __m128i *)&a[i]);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(va, zero)) == 0xffff)
+            continue;
+        const __m128i s = _mm_loadu_si128((const __m128i *)&src[i]);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(va, full)) == 0xffff) {
+            _mm_storeu_si128((__m128i *)&dst[i], s);
+            continue;
+        }
+        const __m128i d = _mm_loadu_si128((const __m128i *)&dst[i]);
+        _mm_storeu_si128((__m128i *)&dst[i], SpanMerge16SSE2(d, s, va));
+    }
+    SpanMergeC(&dst[i], &src[i], &a[i], n - i);
+}
+
+__attribute__ ((__target__ ("avx2")))
+static void SpanMergeAVX2(uint8_t *dst, const uint8_t *src, const uint8_t *a,
+                          unsigned n)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i full = _mm256_set1_epi8(-1);
+    unsigned i = 0;
+
+    for (; i + 32 <= n; i += 32) {
+        const __m256i va = _mm256_loadu_si256((const __m256i *)&a[i]);
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(va, zero)) == -1)
+            continue;
+        const __m256i s = _mm256_loadu_si256((const __m256i *)&src[i]);
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(va, full)) == -1) {
+            _mm256_storeu_si256((__m256i *)&dst[i], s);
+            continue;
+        }
+        const __m256i d = _mm256_loadu_si256((const __m256i *)&dst[i]);
+        _mm256_storeu_si256((__m256i *)&dst[i], SpanMerge32AVX2(d, s, va));
+    }
+    SpanMergeSSE2(&dst[i], &src[i], &a[i], n - i);
+}
+
+__attribute__ ((__target__ ("sse2")))
+static void SpanMergeRGBXSSE2(uint8_t *dst, const uint8_t *src,
+                              const uint8_t *a, unsigned n, unsigned pad)
+{
+    const __m128i full = _mm_set1_epi8(-1);
+    const __m128i keep = _mm_set1_epi32(0xff << (8 * pad));
+    unsigned i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        uint32_t a4;
+        memcpy(&a4, &a[i], 4);
+        if (a4 == 0)
+            continue;
+        /* Spread the alpha of each pixel over its color bytes */
+        __m128i va = _mm_cvtsi32_si128(a4);
+        va = _mm_unpacklo_epi8(va, va);
+        va = _mm_andnot_si128(keep, _mm_unpacklo_epi16(va, va));
+
+        const __m128i s = _mm_loadu_si128((const __m128i *)&src[4 * i]);
+        const __m128i d = _mm_loadu_si128((const __m128i *)&dst[4 * i]);
+        __m128i r;
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_or_si128(va, keep), full))
+            == 0xffff)
+            r = _mm_or_si128(_mm_andnot_si128(keep, s), _mm_and_si128(keep, d));
+        else
+            r = SpanMerge16SSE2(d, s, va);
+        _mm_storeu_si128((__m128i *)&dst[4 * i], r);
+    }
+    SpanMergeRGBXC(&dst[4 * i], &src[4 * i], &a[i], n - i, pad);
+}
+
+__attribute__ ((__target__ ("avx2")))
+static void SpanMergeRGBXAVX2(uint8_t *dst, const uint8_t *src,
+                              const uint8_t *a, unsigned n, unsigned pad)
+{
+    const __m256i full = _mm256_set1_epi8(-1);
+    const __m256i keep = _mm256_set1_epi32(0xff << (8 * pad));
+    const __m256i spread = _mm256_set1_epi32(0x01010101);
+    unsigned i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        uint64_t a8;
+        memcpy(&a8, &a[i], 8);
+        if (a8 == 0)
+            continue;
+        /* Spread the alpha of each pixel over its color bytes */
+        __m256i va = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)&a[i]));
+        va = _mm256_andnot_si256(keep, _mm256_mullo_epi32(va, spread));
+
+        const __m256i s = _mm256_loadu_si256((const __m256i *)&src[4 * i]);
+        const __m256i d = _mm256_loadu_si256((const __m256i *)&dst[4 * i]);
+        __m256i r;
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_or_si256(va, keep),
+                                                   full)) == -1)
+            r = _mm256_or_si256(_mm256_andnot_si256(keep, s),
+                                _mm256_and_si256(keep, d));
+        else
+            r = SpanMerge32AVX2(d, s, va);
+        _mm256_storeu_si256((__m256i *)&dst[4 * i], r);
+    }
+    SpanMergeRGBXSSE2(&dst[4 * i], &src[4 * i], &a[i], n - i, pad);
+}
+
+__attribute__ ((__target__ ("sse2")))
+static void SpanDeinterleave4SSE2(uint8_t *p0, uint8_t *p1, uint8_t *p2,
+                                  uint8_t *p3, const uint8_t *src, unsigned n)
+{
+    const __m128i mask = _mm_set1_epi32(0xff);
+    unsigned i = 0;
+
+    for (; i + 16 <= n; i += 16) {
+        __m128i v[4];
+        for (unsigned k = 0; k < 4; k++)
+            v[k] = _mm_loadu_si128((const __m128i *)&src[4 * (i + 4 * k)]);
+#define PLANE(p, shift) \
+        _mm_storeu_si128((__m128i *)&p[i], _mm_packus_epi16( \
+            _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(v[0], shift), mask), \
+                            _mm_and_si128(_mm_srli_epi32(v[1], shift), mask)), \
+            _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(v[2], shift), mask), \
+                            _mm_and_si128(_mm_srli_epi32(v[3], shift), mask))))
+        PLANE(p0, 0);
+        PLANE(p1, 8);
+        PLANE(p2, 16);
+        PLANE(p3, 24);
+#undef PLANE
+    }
+    SpanDeinterleave4C(&p0[i], &p1[i], &p2[i], &p3[i], &src[4 * i], n - i);
+}
+
+__attribute__ ((__target__ ("avx2")))
+static void SpanDeinterleave4AVX2(uint8_t *p0, uint8_t *p1, uint8_t *p2,
+                                  uint8_t *p3, const uint8_t *src, unsigned n)
+{
+    const __m256i mask = _mm256_set1_epi32(0xff);
+    /* The packs work within 128 bits lanes, leaving 4 bytes groups as
+     * 0 2 4 6 1 3 5 7 */
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    unsigned i = 0;
+
+    for (; i + 32 <= n; i += 32) {
+        __m256i v[4];
+        for (unsigned k = 0; k < 4; k++)
+            v[k] = _mm256_loadu_si256((const __m256i *)&src[4 * (i + 8 * k)]);
+#define PLANE(p, shift) \
+        _mm256_storeu_si256((__m256i *)&p[i], _mm256_permutevar8x32_epi32( \
+            _mm256_packus_epi16( \
+                _mm256_packs_epi32( \
+                    _mm256_and_si256(_mm256_srli_epi32(v[0], shift), mask), \
+                    _mm256_and_si256(_mm256_srli_epi32(v[1], shift), mask)), \
+                _mm256_packs_epi32( \
+                    _mm256_and_si256(_mm256_srli_epi32(v[2], shift), mask), \
+                    _mm256_and_si256(_mm256_srli_epi32(v[3], shift), mask))), \
+            order))
+        PLANE(p0, 0);
+        PLANE(p1, 8);
+        PLANE(p2, 16);
+        PLANE(p3, 24);
+#undef PLANE
+    }
+    SpanDeinterleave4SSE2(&p0[i], &p1[i], &p2[i], &p3[i], &src[4 * i], n - i);
+}
+
+__attribute__ ((__target__ ("sse2")))
+static void SpanInterleaveRGBXSSE2(uint8_t *dst, const uint8_t *i,
+                                   const uint8_t *j, const uint8_t *k,
+                                   unsigned n, unsigned offset_i,
+                                   unsigned offset_j, unsigned offset_k)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i si = _mm_cvtsi32_si128(8 * offset_i);
+    const __m128i sj = _mm_cvtsi32_si128(8 * offset_j);
+    const __m128i sk = _mm_cvtsi32_si128(8 * offset_k);
+    unsigned x = 0;
+
+    for (; x + 16 <= n; x += 16) {
+        const __m128i vi = _mm_loadu_si128((const __m128i *)&i[x]);
+        const __m128i vj = _mm_loadu_si128((const __m128i *)&j[x]);
+        const __m128i vk = _mm_loadu_si128((const __m128i *)&k[x]);
+        const __m128i wi[2] = { _mm_unpacklo_epi8(vi, zero),
+                                _mm_unpackhi_epi8(vi, zero) };
+        const __m128i wj[2] = { _mm_unpacklo_epi8(vj, zero),
+                                _mm_unpackhi_epi8(vj, zero) };
+        const __m128i wk[2] = { _mm_unpacklo_epi8(vk, zero),
+                                _mm_unpackhi_epi8(vk, zero) };
+        for (unsigned h = 0; h < 2; h++) {
+#define WIDEN(w, unpack, s) _mm_sll_epi32(unpack(w[h], zero), s)
+            const __m128i lo =
+                _mm_or_si128(WIDEN(wi, _mm_unpacklo_epi16, si),
+                _mm_or_si128(WIDEN(wj, _mm_unpacklo_epi16, sj),
+                             WIDEN(wk, _mm_unpacklo_epi16, sk)));
+            const __m128i hi =
+                _mm_or_si128(WIDEN(wi, _mm_unpackhi_epi16, si),
+                _mm_or_si128(WIDEN(wj, _mm_unpackhi_epi16, sj),
+                             WIDEN(wk, _mm_unpackhi_epi16, sk)));
+#undef WIDEN
+            _mm_storeu_si128((__m128i *)&dst[4 * (x + 8 * h)], lo);
+            _mm_storeu_si128((__m128i *)&dst[4 * (x + 8 * h + 4)], hi);
+        }
+    }
+    SpanInterleaveRGBXC(&dst[4 * x], &i[x], &j[x], &k[x], n - x,
+                        offset_i, offset_j, offset_k);
+}
+
+__attribute__ ((__target__ ("avx2")))
+static void SpanInterleaveRGBXAVX2(uint8_t *dst, const uint8_t *i,
+                                   const uint8_t *j, const uint8_t *k,
+                                   unsigned n, unsigned offset_i,
+                                   unsigned offset_j, unsigned offset_k)
+{
+    const __m128i si = _mm_cvtsi32_si128(8 * offset_i);
+    const __m128i sj = _mm_cvtsi32_si128(8 * offset_j);
+    const __m128i sk = _mm_cvtsi32_si128(8 * offset_k);
+    unsigned x = 0;
+
+    for (; x + 8 <= n; x += 8) {
+#define WIDEN(p, s) \
+        _mm256_sll_epi32(_mm256_cvtepu8_epi32( \
+            _mm_loadl_epi64((const __m128i *)&p[x])), s)
+        _mm256_storeu_si256((__m256i *)&dst[4 * x],
+                            _mm256_or_si256(WIDEN(i, si),
+                            _mm256_or_si256(WIDEN(j, sj), WIDEN(k, sk))));
+#undef WIDEN
+    }
+    SpanInterleaveRGBXC(&dst[4 * x], &i[x], &j[x], &k[x], n - x,
+                        offset_i, offset_j, offset_k);
+}
+
+__attribute__ ((__target__ ("sse2")))
+static void SpanPackEvenSSE2(uint8_t *dst, const uint8_t *src, unsigned n)
+{
+    const __m128i mask = _mm_set1_epi16(0xff);
+    unsigned i = 0;
+
+    /* Only 2 * n - 1 source bytes are readable */
+    for (; i + 16 < n; i += 16) {
+        const __m128i lo = _mm_loadu_si128((const __m128i *)&src[2 * i]);
+        const __m128i hi = _mm_loadu_si128((const __m128i *)&src[2 * i + 16]);
+        _mm_storeu_si128((__m128i *)&dst[i],
+                         _mm_packus_epi16(_mm_and_si128(lo, mask),
+                                          _mm_and_si128(hi, mask)));
+    }
+    SpanPackEvenC(&dst[i], &src[2 * i], n - i);
+}
+
+__attribute__ ((__target__ ("avx2")))
+static void SpanPackEvenAVX2(uint8_t *dst, const uint8_t *src, unsigned n)
+{
+    const __m256i mask = _mm256_set1_epi16(0xff);
+    unsigned i = 0;
+
+    for (; i + 32 < n; i += 32) {
+        const __m256i lo = _mm256_loadu_si256((const __m256i *)&src[2 * i]);
+        const __m256i hi = _mm256_loadu_si256((const __m256i *)&src[2 * i + 32]);
+        const __m256i r = _mm256_packus_epi16(_mm256_and_si256(lo, mask),
+                                              _mm256_and_si256(hi, mask));
+        _mm256_storeu_si256((__m256i *)&dst[i],
+                            _mm256_permute4x64_epi64(r, 0xd8));
+    }
+    SpanPackEvenSSE2(&dst[i], &src[2 * i], n - i);
+}
+
+__attribute__ ((__target__ ("sse2")))
+static void SpanInterleave2SSE2(uint8_t *dst, const uint8_t *p0,
+                                const uint8_t *p1, unsigned n)
+{
+    unsigned i = 0;
+
+    for (; i + 16 <= n; i += 16) {
+        const __m128i v0 = _mm_loadu_si128((const __m128i *)&p0[i]);
+        const __m128i v1 = _mm_loadu_si128((const __m128i *)&p1[i]);
+        _mm_storeu_si128((__m128i *)&dst[2 * i], _mm_unpacklo_epi8(v0, v1));
+        _mm_storeu_si128((__m128i *)&dst[2 * i + 16], _mm_unpackhi_epi8(v0, v1));
+    }
+    SpanInterleave2C(&dst[2 * i], &p0[i], &p1[i], n - i);
+}
+
+__attribute__ ((__target__ ("avx2")))
+static void SpanInterleave2AVX2(uint8_t *dst, const uint8_t *p0,
+                                const uint8_t *p1, unsigned n)
+{
+    unsigned i = 0;
+
+    for (; i + 32 <= n; i += 32) {
+        const __m256i v0 = _mm256_loadu_si256((const __m256i *)&p0[i]);
+        const __m256i v1 = _mm256_loadu_si256((const __m256i *)&p1[i]);
+        const __m256i lo = _mm256_unpacklo_epi8(v0, v1);
+        const __m256i hi = _mm256_unpackhi_epi8(v0, v1);
+        _mm256_storeu_si256((__m256i *)&dst[2 * i],
+                            _mm256_permute2x128_si256(lo, hi, 0x20));
+        _mm256_storeu_si256((__m256i *)&dst[2 * i + 32],
+                            _mm256_permute2x128_si256(lo, hi, 0x31));
+    }
+    SpanInterleave2SSE2(&dst[2 * i], &p0[i], &p1[i], n - i);
+}
+#endif
+
+#ifdef SPAN_SIMD_X86
+# define SPAN_DISPATCH(name, args) \
+    do { \
+        if (vlc_CPU_AVX2()) \
+            return name##AVX2 args; \
+        if (vlc_CPU_SSE2()) \
+            return name##SSE2 args; \
+        return name##C args; \
+    } while (0)
+#else
+# define SPAN_DISPATCH(name, args) return name##C args
+#endif
+
+static inline const char *SpanKernelsName()
+{
+#ifdef SPAN_SIMD_X86
+    if (vlc_CPU_AVX2())
+        return "avx2";
+    if (vlc_CPU_SSE2())
+        return "sse2";
+#endif
+    return "c";
+}
+
+static inline int SpanAlpha(uint8_t *a, const uint8_t *src, unsigned n,
+                            unsigned alpha)
+{
+    SPAN_DISPATCH(SpanAlpha, (a, src, n, alpha));
+}
+
+static inline void SpanMerge(uint8_t *dst, const uint8_t *src,
+                             const uint8_t *a, unsigned n)
+{
+    SPAN_DISPATCH(SpanMerge, (dst, src, a, n));
+}
+
+static inline void SpanMergeRGBX(uint8_t *dst, const uint8_t *src,
+                                 const uint8_t *a, unsigned n, unsigned pad)
+{
+    SPAN_DISPATCH(SpanMergeRGBX, (dst, src, a, n, pad));
+}
+
+static inline void SpanDeinterleave4(uint8_t *p0, uint8_t *p1, uint8_t *p2,
+                                     uint8_t *p3, const uint8_t *src,
+                                     unsigned n)
+{
+    SPAN_DISPATCH(SpanDeinterleave4, (p0, p1, p2, p3, src, n));
+}
+
+static inline void SpanInterleaveRGBX(uint8_t *dst, const uint8_t *i,
+                                      const uint8_t *j, const uint8_t *k,
+                                      unsigned n, unsigned offset_i,
+                                      unsigned offset_j, unsigned offset_k)
+{
+    SPAN_DISPATCH(SpanInterleaveRGBX,
+                  (dst, i, j, k, n, offset_i, offset_j, offset_k));
+}
+
+static inline void SpanPackEven(uint8_t *dst, const uint8_t *src, unsigned n)
+{
+    SPAN_DISPATCH(SpanPackEven, (dst, src, n));
+}
+
+static inline void SpanInterleave2(uint8_t *dst, const uint8_t *p0,
+                                   const uint8_t *p1, unsigned n)
+{
+    SPAN_DISPATCH(SpanInterleave2, (dst, p0, p1, n));
+}
+
+/* Color conversions of the span sources, left to the compiler */
+static void SpanYuvToRgb(uint8_t *r, uint8_t *g, uint8_t *b,
+                         const uint8_t *y, const uint8_t *u, const uint8_t *v,
+                         unsigned n)
+{
+    for (unsigned t = 0; t < n; t++) {
+        int pr, pg, pb;
+        yuv_to_rgb(&pr, &pg, &pb, y[t], u[t], v[t]);
+        r[t] = pr;
+        g[t] = pg;
+        b[t] = pb;
+    }
+}
+
+/* In place */
+static void SpanRgbToYuv(uint8_t *i, uint8_t *j, uint8_t *k, unsigned n)
+{
+    for (unsigned t = 0; t < n; t++)
+        rgb_to_yuv(&i[t], &j[t], &k[t], i[t], j[t], k[t]);
+}
+
+/*****************************************************************************
+ * Span sources and destinations
+ *****************************************************************************/
+struct CSpan {
+    /* Planar rows of the span colors and alpha, either pointing into the
+     * source picture or into the buffers */
+    const uint8_t *i, *j, *k;
+    const uint8_t *a;
+    uint8_t buffer[4][SPAN_MAX];
+};
+
+template <bool to_rgb>
+class CSpanSrcYUVA : public CPicture {
+public:
+    CSpanSrcYUVA(const CPicture &cfg) : CPicture(cfg)
+    {
+        for (unsigned plane = 0; plane < 4; plane++)
+            data[plane] = CPicture::getLine<1>(plane) + x;
+    }
+    int getAlpha(CSpan *span, unsigned dx, unsigned n, unsigned alpha) const
+    {
+        span->a = span->buffer[3];
+        return SpanAlpha(span->buffer[3], &data[3][dx], n, alpha);
+    }
+    void get(CSpan *span, unsigned dx, unsigned n) const
+    {
+        if (!to_rgb) {
+            span->i = &data[0][dx];
+            span->j = &data[1][dx];
+            span->k = &data[2][dx];
+            return;
+        }
+        SpanYuvToRgb(span->buffer[0], span->buffer[1], span->buffer[2],
+                     &data[0][dx], &data[1][dx], &data[2][dx], n);
+        span->i = span->buffer[0];
+        span->j = span->buffer[1];
+        span->k = span->buffer[2];
+    }
+    void nextLine()
+    {
+        y++;
+        for (unsigned plane = 0; plane < 4; plane++)
+            data[plane] += picture->p[plane].i_pitch;
+    }
+private:
+    const uint8_t *data[4];
+};
+
+template <bool to_yuv>
+class CSpanSrcRGBA : public CPicture {
+public:
+    CSpanSrcRGBA(const CPicture &cfg) : CPicture(cfg)
+    {
+        data = CPicture::getLine<1>(0) + 4 * x;
+    }
+    int getAlpha(CSpan *span, unsigned dx, unsigned n, unsigned alpha) const
+    {
+        SpanDeinterleave4(span->buffer[0], span->buffer[1], span->buffer[2],
+                          span->buffer[3], &data[4 * dx], n);
+        span->a = span->buffer[3];
+        return SpanAlpha(span->buffer[3], span->buffer[3], n, alpha);
+    }
+    void get(CSpan *span, unsigned, unsigned n) const
+    {
+        if (to_yuv) {
+            SpanRgbToYuv(span->buffer[0], span->buffer[1], span->buffer[2], n);
+        }
+        span->i = span->buffer[0];
+        span->j = span->buffer[1];
+        span->k = span->buffer[2];
+    }
+    void nextLine()
+    {
+        y++;
+        data += picture->p[0].i_pitch;
+    }
+private:
+    const uint8_t *data;
+};
+
+/* 4:2:0 destinations, the chroma being merged with the alpha of the top
+ * left pixel just like Blend<> does */
+template <bool semi_planar, bool swap_uv>
+class CSpanDst420 : public CPicture {
+public:
+    CSpanDst420(const CPicture &cfg) : CPicture(cfg)
+    {
+        data[0] = CPicture::getLine<1>(0);
+        data[1] = CPicture::getLine<2>(semi_planar ? 1 : swap_uv ? 2 : 1);
+        data[2] = semi_planar ? NULL : CPicture::getLine<2>(swap_uv ? 1 : 2);
+    }
+    void merge(unsigned dx, unsigned n, const CSpan &span, bool opaque)
+    {
+        if (opaque)
+            memcpy(&data[0][x + dx], span.i, n);
+        else
+            SpanMerge(&data[0][x + dx], span.i, span.a, n);
+
+        if (y % 2)
+            return;
+        const unsigned first = (x + dx) % 2;
+        if (first >= n)
+            return;
+        const unsigned count = (n - first + 1) / 2;
+        const unsigned offset = (x + dx + first) / 2;
+
+        uint8_t u[SPAN_MAX / 2], v[SPAN_MAX / 2], a[SPAN_MAX / 2];
+        SpanPackEven(u, &span.j[first], count);
+        SpanPackEven(v, &span.k[first], count);
+        SpanPackEven(a, &span.a[first], count);
+        if (semi_planar) {
+            uint8_t uv[SPAN_MAX], aa[SPAN_MAX];
+            SpanInterleave2(uv, swap_uv ? v : u, swap_uv ? u : v, count);
+            SpanInterleave2(aa, a, a, count);
+            SpanMerge(&data[1][2 * offset], uv, aa, 2 * count);
+        } else {
+            SpanMerge(&data[1][offset], u, a, count);
+            SpanMerge(&data[2][offset], v, a, count);
+        }
+    }
+    void nextLine()
+    {
+        y++;
+        data[0] += picture->p[0].i_pitch;
+        if ((y % 2) == 0) {
+            data[1] += picture->p[semi_planar ? 1 : swap_uv ? 2 : 1].i_pitch;
+            if (!semi_planar)
+                data[2] += picture->p[swap_uv ? 1 : 2].i_pitch;
+        }
+    }
+private:
+    uint8_t *data[3];
+};
+
+/* 32 bits RGB without alpha */
+class CSpanDstRGB32 : public CPicture {
+public:
+    CSpanDstRGB32(const CPicture &cfg) : CPicture(cfg)
+    {
+#ifdef WORDS_BIGENDIAN
+        offset_r = (32 - fmt->i_lrshift) / 8;
+        offset_g = (32 - fmt->i_lgshift) / 8;
+        offset_b = (32 - fmt->i_lbshift) / 8;
+#else
+        offset_r = fmt->i_lrshift / 8;
+        offset_g = fmt->i_lgshift / 8;
+        offset_b = fmt->i_lbshift / 8;
+#endif
+        offset_x = 6 - offset_r - offset_g - offset_b;
+        data = CPicture::getLine<1>(0);
+    }
+    void merge(unsigned dx, unsigned n, const CSpan &span, bool)
+    {
+        uint8_t rgbx[4 * SPAN_MAX];
+        SpanInterleaveRGBX(rgbx, span.i, span.j, span.k, n,
+                           offset_r, offset_g, offset_b);
+        SpanMergeRGBX(&data[4 * (x + dx)], rgbx, span.a, n, offset_x);
+    }
+    void nextLine()
+    {
+        y++;
+        data += picture->p[0].i_pitch;
+    }
+private:
+    unsigned offset_r;
+    unsigned offset_g;
+    unsigned offset_b;
+    unsigned offset_x;
+    uint8_t *data;
+};
+
+typedef CSpanDst420<false, false> CSpanDstI420;
+typedef CSpanDst420<false, true>  CSpanDstYV12;
+typedef CSpanDst420<true,  false> CSpanDstNV12;
+typedef CSpanDst420<true,  true>  CSpanDstNV21;
+
+template <class TDst, class TSrc>
+void BlendSpan(const CPicture &dst_data, const CPicture &src_data,
+               unsigned width, unsigned height, int alpha)
+{
+    TSrc src(src_data);
+    TDst dst(dst_data);
+    CSpan span;
+
+    for (unsigned y = 0; y < height; y++) {
+        for (unsigned x = 0; x < width; x += SPAN_MAX) {
+            const unsigned n = __MIN(width - x, SPAN_MAX);
+
+            const int coverage = src.getAlpha(&span, x, n, alpha);
+            if (coverage == SPAN_TRANSPARENT)
+                continue;
+            src.get(&span, x, n);
+            dst.merge(x, n, span, coverage == SPAN_OPAQUE);
+        }
+        src.nextLine();
+        dst.nextLine();
+    }
+}
+
 typedef void (*blend_function_t)(const CPicture &dst_data, const CPicture &src_data,
                                  unsigned width, unsigned height, int alpha);
 
-static const struct {
+struct blend_entry_t {
     vlc_fourcc_t     dst;
     vlc_fourcc_t     src;
     blend_function_t blend;
-} blends[] = {
+};
+
+static const blend_entry_t blends[] = {
 #undef RGB
 #undef YUV
 #define RGB(csp, picture, cvt) \
@@ -615,6 +1428,41 @@ static const struct {
 #undef YUV
 };
 
+/* Span based versions of the common pairs, preferred over blends[] */
+static const blend_entry_t spans[] = {
+    { VLC_CODEC_I420,  VLC_CODEC_YUVA, BlendSpan<CSpanDstI420,  CSpanSrcYUVA<false> > },
+    { VLC_CODEC_J420,  VLC_CODEC_YUVA, BlendSpan<CSpanDstI420,  CSpanSrcYUVA<false> > },
+    { VLC_CODEC_YV12,  VLC_CODEC_YUVA, BlendSpan<CSpanDstYV12,  CSpanSrcYUVA<false> > },
+    { VLC_CODEC_NV12,  VLC_CODEC_YUVA, BlendSpan<CSpanDstNV12,  CSpanSrcYUVA<false> > },
+    { VLC_CODEC_NV21,  VLC_CODEC_YUVA, BlendSpan<CSpanDstNV21,  CSpanSrcYUVA<false> > },
+    { VLC_CODEC_RGB32, VLC_CODEC_YUVA, BlendSpan<CSpanDstRGB32, CSpanSrcYUVA<true> > },
+
+    { VLC_CODEC_I420,  VLC_CODEC_RGBA, BlendSpan<CSpanDstI420,  CSpanSrcRGBA<true> > },
+    { VLC_CODEC_J420,  VLC_CODEC_RGBA, BlendSpan<CSpanDstI420,  CSpanSrcRGBA<true> > },
+    { VLC_CODEC_YV12,  VLC_CODEC_RGBA, BlendSpan<CSpanDstYV12,  CSpanSrcRGBA<true> > },
+    { VLC_CODEC_NV12,  VLC_CODEC_RGBA, BlendSpan<CSpanDstNV12,  CSpanSrcRGBA<true> > },
+    { VLC_CODEC_NV21,  VLC_CODEC_RGBA, BlendSpan<CSpanDstNV21,  CSpanSrcRGBA<true> > },
+    { VLC_CODEC_RGB32, VLC_CODEC_RGBA, BlendSpan<CSpanDstRGB32, CSpanSrcRGBA<false> > },
+};
+
+/* The span kernels only handle RV32 with every component in its own byte */
+static bool IsSpanCapable(const video_format_t *fmt)
+{
+    if (fmt->i_chroma != VLC_CODEC_RGB32)
+        return true;
+
+    video_format_t rgb = *fmt;
+    video_format_FixRgb(&rgb);
+    const int shifts[3] = { rgb.i_lrshift, rgb.i_lgshift, rgb.i_lbshift };
+    unsigned used = 0;
+    for (unsigned i = 0; i < 3; i++) {
+        if (shifts[i] % 8 || shifts[i] < 0 || shifts[i] >= 32)
+            return false;
+        used |= 1 << (shifts[i] / 8);
+    }
+    return used == 0x7 || used == 0xb || used == 0xd || used == 0xe;
+}
+
 struct filter_sys_t {
     filter_sys_t() : blend(NULL)
     {
@@ -663,9 +1511,20 @@ static int Open(vlc_object_t *object)
     const vlc_fourcc_t dst = filter->fmt_out.video.i_chroma;
 
     filter_sys_t *sys = new filter_sys_t();
-    for (size_t i = 0; i < sizeof(blends) / sizeof(*blends); i++) {
-        if (blends[i].src == src && blends[i].dst == dst)
-            sys->blend = blends[i].blend;
+    if (IsSpanCapable(&filter->fmt_out.video)) {
+        for (size_t i = 0; i < sizeof(spans) / sizeof(*spans); i++) {
+            if (spans[i].src == src && spans[i].dst == dst)
+                sys->blend = spans[i].blend;
+        }
+    }
+    if (sys->blend) {
+        msg_Dbg(filter, "using %s span blending (chroma: %4.4s -> %4.4s)",
+                SpanKernelsName(), (char *)&src, (char *)&dst);
+    } else {
+        for (size_t i = 0; i < sizeof(blends) / sizeof(*blends); i++) {
+            if (blends[i].src == src && blends[i].dst == dst)
+                sys->blend = blends[i].blend;
+        }
     }
 
     if (!sys->blend) {
@@ -55,6 +55,20 @@ static picture_t *Filter( filter_t *, picture_t * );
 #define ALPHA_TEXT N_("Alpha of the blended image")
 #define ALPHA_LONGTEXT N_("Alpha with which the blend image is blended")
 
+#define WIDTH_TEXT N_("Width of the generated images")
+#define WIDTH_LONGTEXT N_("Width of the base and blend images generated " \
+                          "when no image files are given")
+
+#define HEIGHT_TEXT N_("Height of the generated images")
+#define HEIGHT_LONGTEXT N_("Height of the base and blend images generated " \
+                           "when no image files are given")
+
+#define PAIRS_TEXT N_("Chroma pairs to benchmark")
+#define PAIRS_LONGTEXT N_("Comma separated list of base:blend chroma pairs " \
+                          "benchmarked on generated images, for instance " \
+                          "\"I420:YUVA,RV32:RGBA\". Leave empty for the " \
+                          "common pairs.")
+
 #define BASE_IMAGE_TEXT N_("Image to be blended onto")
 #define BASE_IMAGE_LONGTEXT N_("The image which will be used to blend onto")
 
@@ -82,6 +96,12 @@ vlc_module_begin ()
               LOOPS_LONGTEXT, false )
     add_integer_with_range( CFG_PREFIX "alpha", 128, 0, 255, ALPHA_TEXT,
               ALPHA_LONGTEXT, false )
+    add_integer( CFG_PREFIX "width", 1280, WIDTH_TEXT,
+                 WIDTH_LONGTEXT, false )
+    add_integer( CFG_PREFIX "height", 720, HEIGHT_TEXT,
+                 HEIGHT_LONGTEXT, false )
+    add_string( CFG_PREFIX "pairs", NULL, PAIRS_TEXT,
+                PAIRS_LONGTEXT, false )
 
     set_section( N_("Base image"), NULL )
     add_loadfile( CFG_PREFIX "base-image", NULL, BASE_IMAGE_TEXT,
@@ -99,10 +119,17 @@ vlc_module_begin ()
 vlc_module_end ()
 
 static const char *const ppsz_filter_options[] = {
-    "loops", "alpha", "base-image", "base-chroma", "blend-image",
-    "blend-chroma", NULL
+    "loops", "alpha", "width", "height", "pairs", "base-image", "base-chroma",
+    "blend-image", "blend-chroma", NULL
 };
 
+/* Pairs benchmarked on generated images when none are given: the common
+ * OSD/subpicture/logo cases first, then a few going through the generic
+ * per pixel code for reference */
+static const char psz_default_pairs[] =
+    "I420:YUVA,NV12:YUVA,RV32:YUVA,I420:RGBA,NV12:RGBA,RV32:RGBA,"
+    "YV12:YUVA,I422:YUVA,YUY2:YUVA,RV24:RGBA";
+
 /*****************************************************************************
  * filter_sys_t: filter method descriptor
  *****************************************************************************/
@@ -110,6 +137,8 @@ struct filter_sys_t
 {
     bool b_done;
     int i_loops, i_alpha;
+    int i_width, i_height;
+    char *psz_pairs;
 
     picture_t *p_base_image;
     picture_t *p_blend_image;
@@ -145,6 +174,88 @@ static int blendbench_LoadImage( vlc_object_t *p_this, picture_t **pp_pic,
     return VLC_SUCCESS;
 }
 
+/* Linear congruential generator, so that every run blends the same data */
+static inline uint32_t blendbench_Random( uint32_t *p_seed )
+{
+    *p_seed = *p_seed * 1103515245 + 12345;
+    return *p_seed >> 16;
+}
+
+/**
+ * Creates a picture filled with reproducible noise. When it carries alpha,
+ * the coverage is laid out in 32x32 blocks which are either fully
+ * transparent, fully opaque or of random opacity, the way OSD, subtitles and
+ * logos usually are.
+ */
+static picture_t *blendbench_NewImage( vlc_fourcc_t i_chroma,
+                                       int i_width, int i_height,
+                                       uint32_t i_seed )
+{
+    video_format_t fmt;
+    memset( &fmt, 0, sizeof(fmt) );
+    video_format_Setup( &fmt, i_chroma, i_width, i_height,
+                        i_width, i_height, 1, 1 );
+
+    picture_t *p_pic = picture_NewFromFormat( &fmt );
+    if( p_pic == NULL )
+        return NULL;
+
+    for( int i_plane = 0; i_plane < p_pic->i_planes; i_plane++ )
+    {
+        plane_t *p = &p_pic->p[i_plane];
+        for( int y = 0; y < p->i_lines; y++ )
+            for( int x = 0; x < p->i_pitch; x++ )
+                p->p_pixels[y * p->i_pitch + x] =
+                    blendbench_Random( &i_seed );
+    }
+
+    uint8_t *p_alpha;
+    int i_pitch, i_step;
+    if( i_chroma == VLC_CODEC_YUVA )
+    {
+        p_alpha = p_pic->p[A_PLANE].p_pixels;
+        i_pitch = p_pic->p[A_PLANE].i_pitch;
+        i_step  = 1;
+    }
+    else if( i_chroma == VLC_CODEC_RGBA )
+    {
+        p_alpha = &p_pic->p[0].p_pixels[3];
+        i_pitch = p_pic->p[0].i_pitch;
+        i_step  = 4;
+    }
+    else
+        return p_pic;
+
+    for( int y = 0; y < i_height; y++ )
+        for( int x = 0; x < i_width; x++ )
+        {
+            uint8_t *p_a = &p_alpha[y * i_pitch + x * i_step];
+            switch( (x / 32 * 7 + y / 32 * 3) % 4 )
+            {
+                case 0:  *p_a = 0x00; break;
+                case 1:  *p_a = 0xff; break;
+                default: *p_a = blendbench_Random( &i_seed ); break;
+            }
+        }
+    return p_pic;
+}
+
+/* FNV-1a hash of the visible pixels */
+static uint32_t blendbench_Checksum( const picture_t *p_pic )
+{
+    uint32_t i_hash = 2166136261u;
+
+    for( int i_plane = 0; i_plane < p_pic->i_planes; i_plane++ )
+    {
+        const plane_t *p = &p_pic->p[i_plane];
+        for( int y = 0; y < p->i_visible_lines; y++ )
+            for( int x = 0; x < p->i_visible_pitch; x++ )
+                i_hash = (i_hash ^ p->p_pixels[y * p->i_pitch + x])
+                       * 16777619u;
+    }
+    return i_hash;
+}
+
 /*****************************************************************************
  * Create: allocates video thread output method
  *****************************************************************************/
@@ -162,6 +273,8 @@ static int Create( vlc_object_t *p_this )
 
     p_sys = p_filter->p_sys;
     p_sys->b_done = false;
+    p_sys->p_base_image = NULL;
+    p_sys->p_blend_image = NULL;
 
     p_filter->pf_video_filter = Filter;
 
@@ -174,17 +287,39 @@ static int Create( vlc_object_t *p_this )
                                                   CFG_PREFIX "loops" );
     p_sys->i_alpha = var_CreateGetIntegerCommand( p_filter,
                                                   CFG_PREFIX "alpha" );
+    p_sys->i_width = var_CreateGetIntegerCommand( p_filter,
+                                                  CFG_PREFIX "width" );
+    p_sys->i_height = var_CreateGetIntegerCommand( p_filter,
+                                                   CFG_PREFIX "height" );
+    p_sys->psz_pairs = var_CreateGetStringCommand( p_filter,
+                                                   CFG_PREFIX "pairs" );
+
+    psz_cmd = var_CreateGetStringCommand( p_filter, CFG_PREFIX "base-image" );
+    if( psz_cmd == NULL || *psz_cmd == '\0' )
+    {
+        /* Generated images */
+        free( psz_cmd );
+        if( p_sys->i_width <= 0 || p_sys->i_height <= 0 )
+        {
+            msg_Err( p_filter, "invalid image size %dx%d",
+                     p_sys->i_width, p_sys->i_height );
+            free( p_sys->psz_pairs );
+            free( p_sys );
+            return VLC_EGENERIC;
+        }
+        return VLC_SUCCESS;
+    }
 
     psz_temp = var_CreateGetStringCommand( p_filter, CFG_PREFIX "base-chroma" );
     p_sys->i_base_chroma = VLC_FOURCC( psz_temp[0], psz_temp[1],
                                        psz_temp[2], psz_temp[3] );
-    psz_cmd = var_CreateGetStringCommand( p_filter, CFG_PREFIX "base-image" );
     i_ret = blendbench_LoadImage( p_this, &p_sys->p_base_image,
                                   p_sys->i_base_chroma, psz_cmd, "Base" );
     free( psz_temp );
     free( psz_cmd );
     if( i_ret != VLC_SUCCESS )
     {
+        free( p_sys->psz_pairs );
         free( p_sys );
         return i_ret;
     }
@@ -194,10 +329,17 @@ static int Create( vlc_object_t *p_this )
     p_sys->i_blend_chroma = VLC_FOURCC( psz_temp[0], psz_temp[1],
                                         psz_temp[2], psz_temp[3] );
     psz_cmd = var_CreateGetStringCommand( p_filter, CFG_PREFIX "blend-image" );
-    blendbench_LoadImage( p_this, &p_sys->p_blend_image, p_sys->i_blend_chroma,
-                          psz_cmd, "Blend" );
+    i_ret = blendbench_LoadImage( p_this, &p_sys->p_blend_image,
+                                  p_sys->i_blend_chroma, psz_cmd, "Blend" );
     free( psz_temp );
     free( psz_cmd );
+    if( i_ret != VLC_SUCCESS )
+    {
+        picture_Release( p_sys->p_base_image );
+        free( p_sys->psz_pairs );
+        free( p_sys );
+        return i_ret;
+    }
 
     return VLC_SUCCESS;
 }
@@ -210,58 +352,140 @@ static void Destroy( vlc_object_t *p_this )
     filter_t *p_filter = (filter_t *)p_this;
     filter_sys_t *p_sys = p_filter->p_sys;
 
-    picture_Release( p_sys->p_base_image );
-    picture_Release( p_sys->p_blend_image );
+    if( p_sys->p_base_image )
+        picture_Release( p_sys->p_base_image );
+    if( p_sys->p_blend_image )
+        picture_Release( p_sys->p_blend_image );
+    free( p_sys->psz_pairs );
+    free( p_sys );
 }
 
-/*****************************************************************************
- * Render: displays previously rendered output
- *****************************************************************************/
-static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
+/**
+ * Blends p_blend_image onto p_base_image i_loops times and reports the
+ * throughput. The checksum is taken after the first blend, so that runs on
+ * different builds or CPUs can be checked for identical output.
+ */
+static int blendbench_Run( filter_t *p_filter, picture_t *p_base_image,
+                           picture_t *p_blend_image )
 {
     filter_sys_t *p_sys = p_filter->p_sys;
-    filter_t *p_blend;
-
-    if( p_sys->b_done )
-        return p_pic;
+    const vlc_fourcc_t i_base = p_base_image->format.i_chroma;
+    const vlc_fourcc_t i_blend = p_blend_image->format.i_chroma;
 
-    p_blend = vlc_object_create( p_filter, sizeof(filter_t) );
+    filter_t *p_blend = vlc_object_create( p_filter, sizeof(filter_t) );
     if( !p_blend )
-    {
-        picture_Release( p_pic );
-        return NULL;
-    }
-    p_blend->fmt_out.video = p_sys->p_base_image->format;
-    p_blend->fmt_in.video = p_sys->p_blend_image->format;
+        return VLC_ENOMEM;
+
+    p_blend->fmt_out.video = p_base_image->format;
+    p_blend->fmt_in.video = p_blend_image->format;
     p_blend->p_module = module_need( p_blend, "video blending", NULL, false );
     if( !p_blend->p_module )
     {
-        picture_Release( p_pic );
+        msg_Err( p_filter, "cannot blend %4.4s onto %4.4s",
+                 (const char *)&i_blend, (const char *)&i_base );
         vlc_object_release( p_blend );
-        return NULL;
+        return VLC_EGENERIC;
     }
 
+    p_blend->pf_video_blend( p_blend, p_base_image, p_blend_image,
+                             0, 0, p_sys->i_alpha );
+    const uint32_t i_checksum = blendbench_Checksum( p_base_image );
+
     mtime_t time = mdate();
     for( int i_iter = 0; i_iter < p_sys->i_loops; ++i_iter )
     {
-        p_blend->pf_video_blend( p_blend,
-                                 p_sys->p_base_image, p_sys->p_blend_image,
+        p_blend->pf_video_blend( p_blend, p_base_image, p_blend_image,
                                  0, 0, p_sys->i_alpha );
     }
     time = mdate() - time;
 
-    msg_Info( p_filter, "Blended %d images in %f sec", p_sys->i_loops,
-              time / 1000000.0f );
-    msg_Info( p_filter, "Speed is: %f images/second, %f pixels/second",
-              (float) p_sys->i_loops / time * 1000000,
-              (float) p_sys->i_loops / time * 1000000 *
-                  p_sys->p_blend_image->p[Y_PLANE].i_visible_pitch *
-                  p_sys->p_blend_image->p[Y_PLANE].i_visible_lines );
-
     module_unneed( p_blend, p_blend->p_module );
-
     vlc_object_release( p_blend );
 
+    const unsigned i_width  = __MIN( p_base_image->format.i_visible_width,
+                                     p_blend_image->format.i_visible_width );
+    const unsigned i_height = __MIN( p_base_image->format.i_visible_height,
+                                     p_blend_image->format.i_visible_height );
+    const double f_sec = __MAX( time, 1 ) / 1000000.;
+
+    msg_Info( p_filter, "%4.4s onto %4.4s: blended %d images of %ux%u in %f "
+              "sec, %.2f images/second, %.1f Mpixels/second, checksum %08"
+              PRIx32, (const char *)&i_blend, (const char *)&i_base,
+              p_sys->i_loops, i_width, i_height, f_sec,
+              p_sys->i_loops / f_sec,
+              p_sys->i_loops / f_sec * i_width * i_height / 1000000.,
+              i_checksum );
+    return VLC_SUCCESS;
+}
+
+/* Benchmarks every base:blend chroma pair of the list on generated images */
+static void blendbench_RunPairs( filter_t *p_filter )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+    const char *psz_pairs = p_sys->psz_pairs && *p_sys->psz_pairs ?
+                            p_sys->psz_pairs : psz_default_pairs;
+
+    char *psz_list = strdup( psz_pairs );
+    if( psz_list == NULL )
+        return;
+
+    char *psz_save;
+    for( char *psz_pair = strtok_r( psz_list, ",", &psz_save );
+         psz_pair != NULL; psz_pair = strtok_r( NULL, ",", &psz_save ) )
+    {
+        char *psz_blend = strchr( psz_pair, ':' );
+        if( psz_blend == NULL || psz_blend - psz_pair != 4
+         || strlen( psz_blend + 1 ) != 4 )
+        {
+            msg_Err( p_filter, "invalid chroma pair \"%s\"", psz_pair );
+            continue;
+        }
+        *psz_blend++ = '\0';
+        const vlc_fourcc_t i_base = vlc_fourcc_GetCodecFromString( VIDEO_ES,
+                                                                   psz_pair );
+        const vlc_fourcc_t i_blend = vlc_fourcc_GetCodecFromString( VIDEO_ES,
+                                                                    psz_blend );
+        if( i_base == 0 || i_blend == 0 )
+        {
+            msg_Err( p_filter, "unknown chroma pair %s:%s", psz_pair,
+                     psz_blend );
+            continue;
+        }
+
+        /* The blend image covers the whole base image */
+        picture_t *p_base = blendbench_NewImage( i_base, p_sys->i_width,
+                                                 p_sys->i_height, 1 );
+        picture_t *p_blend = blendbench_NewImage( i_blend, p_sys->i_width,
+                                                  p_sys->i_height, 2 );
+        if( p_base && p_blend )
+            blendbench_Run( p_filter, p_base, p_blend );
+        else
+            msg_Err( p_filter, "cannot allocate %4.4s/%4.4s images",
+                     (const char *)&i_base, (const char *)&i_blend );
+
+        if( p_base )
+            picture_Release( p_base );
+        if( p_blend )
+            picture_Release( p_blend );
+    }
+    free( psz_list );
+}
+
+/*****************************************************************************
+ * Render: displays previously rendered output
+ *****************************************************************************/
+static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+
+    if( p_sys->b_done )
+        return p_pic;
+
+    if( p_sys->p_base_image )
+        blendbench_Run( p_filter, p_sys->p_base_image, p_sys->p_blend_image );
+    else
+        blendbench_RunPairs( p_filter );
+
     p_sys->b_done = true;
     return p_pic;
 }
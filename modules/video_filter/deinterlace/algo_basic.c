@@ -39,208 +39,194 @@
 #include "algo_basic.h"
 
 /*****************************************************************************
- * RenderDiscard: only keep TOP or BOTTOM field, discard the other.
+ * Slices
  *****************************************************************************/
 
-void RenderDiscard( picture_t *p_outpic, picture_t *p_pic, int i_field )
+/* Every output line of these algorithms only depends on the input picture,
+ * so each slice renders its own band of output lines in all planes. */
+typedef struct
 {
-    int i_plane;
-
-    /* Copy image and skip lines */
-    for( i_plane = 0 ; i_plane < p_pic->i_planes ; i_plane++ )
-    {
-        uint8_t *p_in, *p_out_end, *p_out;
+    filter_t  *p_filter;
+    picture_t *p_outpic;
+    picture_t *p_pic;
+    int        i_field;
+} basic_job_t;
+
+static void RenderSlices( filter_t *p_filter, filter_slice_cb_t pf_slice,
+                          picture_t *p_outpic, picture_t *p_pic, int i_field )
+{
+    basic_job_t job = {
+        .p_filter = p_filter,
+        .p_outpic = p_outpic,
+        .p_pic    = p_pic,
+        .i_field  = i_field,
+    };
+    filter_RunSlices( p_filter->p_sys->p_slices, pf_slice, &job );
+}
 
-        p_in = p_pic->p[i_plane].p_pixels
-                   + i_field * p_pic->p[i_plane].i_pitch;
+#define SLICE_LINE( p, y ) ((p)->p_pixels + (y) * (p)->i_pitch)
 
-        p_out = p_outpic->p[i_plane].p_pixels;
-        p_out_end = p_out + p_outpic->p[i_plane].i_pitch
-                             * p_outpic->p[i_plane].i_visible_lines;
+/*****************************************************************************
+ * RenderDiscard: only keep TOP or BOTTOM field, discard the other.
+ *****************************************************************************/
 
-        for( ; p_out < p_out_end ; )
-        {
-            memcpy( p_out, p_in, p_pic->p[i_plane].i_pitch );
+static void DiscardSlice( void *p_data, unsigned i_slice, unsigned i_slices )
+{
+    const basic_job_t *p_job = p_data;
+    const picture_t *p_pic = p_job->p_pic;
 
-            p_out += p_outpic->p[i_plane].i_pitch;
-            p_in += 2 * p_pic->p[i_plane].i_pitch;
-        }
+    for( int i_plane = 0 ; i_plane < p_pic->i_planes ; i_plane++ )
+    {
+        const plane_t *p_in = &p_pic->p[i_plane];
+        plane_t *p_out = &p_job->p_outpic->p[i_plane];
+        filter_slice_t slice;
+
+        filter_GetSlice( &slice, p_out->i_visible_lines,
+                         i_slice, i_slices, 2, 0 );
+        for( int y = slice.i_first; y < slice.i_end; y++ )
+            memcpy( SLICE_LINE( p_out, y ),
+                    SLICE_LINE( p_in, 2 * y + p_job->i_field ),
+                    p_in->i_pitch );
     }
 }
 
+void RenderDiscard( filter_t *p_filter,
+                    picture_t *p_outpic, picture_t *p_pic, int i_field )
+{
+    RenderSlices( p_filter, DiscardSlice, p_outpic, p_pic, i_field );
+}
+
 /*****************************************************************************
  * RenderBob: renders a BOB picture - simple copy
  *****************************************************************************/
 
-void RenderBob( picture_t *p_outpic, picture_t *p_pic, int i_field )
+/* Lines of the rendered field are copied. The other lines are copied from
+ * the line above (Bob) or interpolated from the lines around them (Linear),
+ * except on the picture edges where the original line is kept. */
+static void BobSlice( void *p_data, unsigned i_slice, unsigned i_slices,
+                      bool b_linear )
 {
-    int i_plane;
+    const basic_job_t *p_job = p_data;
+    filter_t *p_filter = p_job->p_filter;
+    const picture_t *p_pic = p_job->p_pic;
 
-    /* Copy image and skip lines */
-    for( i_plane = 0 ; i_plane < p_pic->i_planes ; i_plane++ )
+    for( int i_plane = 0 ; i_plane < p_pic->i_planes ; i_plane++ )
     {
-        uint8_t *p_in, *p_out_end, *p_out;
-
-        p_in = p_pic->p[i_plane].p_pixels;
-        p_out = p_outpic->p[i_plane].p_pixels;
-        p_out_end = p_out + p_outpic->p[i_plane].i_pitch
-                             * p_outpic->p[i_plane].i_visible_lines;
-
-        /* For BOTTOM field we need to add the first line */
-        if( i_field == 1 )
-        {
-            memcpy( p_out, p_in, p_pic->p[i_plane].i_pitch );
-            p_in += p_pic->p[i_plane].i_pitch;
-            p_out += p_outpic->p[i_plane].i_pitch;
-        }
+        const plane_t *p_in = &p_pic->p[i_plane];
+        plane_t *p_out = &p_job->p_outpic->p[i_plane];
+        const int i_lines = p_out->i_visible_lines;
+        filter_slice_t slice;
 
-        p_out_end -= 2 * p_outpic->p[i_plane].i_pitch;
-
-        for( ; p_out < p_out_end ; )
+        filter_GetSlice( &slice, i_lines, i_slice, i_slices, 2, 0 );
+        for( int y = slice.i_first; y < slice.i_end; y++ )
         {
-            memcpy( p_out, p_in, p_pic->p[i_plane].i_pitch );
-
-            p_out += p_outpic->p[i_plane].i_pitch;
-
-            memcpy( p_out, p_in, p_pic->p[i_plane].i_pitch );
-
-            p_in += 2 * p_pic->p[i_plane].i_pitch;
-            p_out += p_outpic->p[i_plane].i_pitch;
+            uint8_t *p_dst = SLICE_LINE( p_out, y );
+
+            if( (y & 1) == p_job->i_field || y == 0 || y == i_lines - 1 )
+                memcpy( p_dst, SLICE_LINE( p_in, y ), p_in->i_pitch );
+            else if( b_linear )
+                Merge( p_dst, SLICE_LINE( p_in, y - 1 ),
+                       SLICE_LINE( p_in, y + 1 ), p_in->i_pitch );
+            else
+                memcpy( p_dst, SLICE_LINE( p_in, y - 1 ), p_in->i_pitch );
         }
+    }
+    if( b_linear )
+        EndMerge();
+}
 
-        memcpy( p_out, p_in, p_pic->p[i_plane].i_pitch );
+static void CopySlice( void *p_data, unsigned i_slice, unsigned i_slices )
+{
+    BobSlice( p_data, i_slice, i_slices, false );
+}
 
-        /* For TOP field we need to add the last line */
-        if( i_field == 0 )
-        {
-            p_in += p_pic->p[i_plane].i_pitch;
-            p_out += p_outpic->p[i_plane].i_pitch;
-            memcpy( p_out, p_in, p_pic->p[i_plane].i_pitch );
-        }
-    }
+void RenderBob( filter_t *p_filter,
+                picture_t *p_outpic, picture_t *p_pic, int i_field )
+{
+    RenderSlices( p_filter, CopySlice, p_outpic, p_pic, i_field );
 }
 
 /*****************************************************************************
  * RenderLinear: BOB with linear interpolation
  *****************************************************************************/
 
+static void LinearSlice( void *p_data, unsigned i_slice, unsigned i_slices )
+{
+    BobSlice( p_data, i_slice, i_slices, true );
+}
+
 void RenderLinear( filter_t *p_filter,
                    picture_t *p_outpic, picture_t *p_pic, int i_field )
 {
-    int i_plane;
-
-    /* Copy image and skip lines */
-    for( i_plane = 0 ; i_plane < p_pic->i_planes ; i_plane++ )
-    {
-        uint8_t *p_in, *p_out_end, *p_out;
-
-        p_in = p_pic->p[i_plane].p_pixels;
-        p_out = p_outpic->p[i_plane].p_pixels;
-        p_out_end = p_out + p_outpic->p[i_plane].i_pitch
-                             * p_outpic->p[i_plane].i_visible_lines;
-
-        /* For BOTTOM field we need to add the first line */
-        if( i_field == 1 )
-        {
-            memcpy( p_out, p_in, p_pic->p[i_plane].i_pitch );
-            p_in += p_pic->p[i_plane].i_pitch;
-            p_out += p_outpic->p[i_plane].i_pitch;
-        }
-
-        p_out_end -= 2 * p_outpic->p[i_plane].i_pitch;
-
-        for( ; p_out < p_out_end ; )
-        {
-            memcpy( p_out, p_in, p_pic->p[i_plane].i_pitch );
-
-            p_out += p_outpic->p[i_plane].i_pitch;
-
-            Merge( p_out, p_in, p_in + 2 * p_pic->p[i_plane].i_pitch,
-                   p_pic->p[i_plane].i_pitch );
-
-            p_in += 2 * p_pic->p[i_plane].i_pitch;
-            p_out += p_outpic->p[i_plane].i_pitch;
-        }
-
-        memcpy( p_out, p_in, p_pic->p[i_plane].i_pitch );
-
-        /* For TOP field we need to add the last line */
-        if( i_field == 0 )
-        {
-            p_in += p_pic->p[i_plane].i_pitch;
-            p_out += p_outpic->p[i_plane].i_pitch;
-            memcpy( p_out, p_in, p_pic->p[i_plane].i_pitch );
-        }
-    }
-    EndMerge();
+    RenderSlices( p_filter, LinearSlice, p_outpic, p_pic, i_field );
 }
 
 /*****************************************************************************
  * RenderMean: Half-resolution blender
  *****************************************************************************/
 
-void RenderMean( filter_t *p_filter,
-                 picture_t *p_outpic, picture_t *p_pic )
+static void MeanSlice( void *p_data, unsigned i_slice, unsigned i_slices )
 {
-    int i_plane;
+    const basic_job_t *p_job = p_data;
+    filter_t *p_filter = p_job->p_filter;
+    const picture_t *p_pic = p_job->p_pic;
 
-    /* Copy image and skip lines */
-    for( i_plane = 0 ; i_plane < p_pic->i_planes ; i_plane++ )
+    for( int i_plane = 0 ; i_plane < p_pic->i_planes ; i_plane++ )
     {
-        uint8_t *p_in, *p_out_end, *p_out;
-
-        p_in = p_pic->p[i_plane].p_pixels;
-
-        p_out = p_outpic->p[i_plane].p_pixels;
-        p_out_end = p_out + p_outpic->p[i_plane].i_pitch
-                             * p_outpic->p[i_plane].i_visible_lines;
+        const plane_t *p_in = &p_pic->p[i_plane];
+        plane_t *p_out = &p_job->p_outpic->p[i_plane];
+        filter_slice_t slice;
 
         /* All lines: mean value */
-        for( ; p_out < p_out_end ; )
-        {
-            Merge( p_out, p_in, p_in + p_pic->p[i_plane].i_pitch,
-                   p_pic->p[i_plane].i_pitch );
-
-            p_out += p_outpic->p[i_plane].i_pitch;
-            p_in += 2 * p_pic->p[i_plane].i_pitch;
-        }
+        filter_GetSlice( &slice, p_out->i_visible_lines,
+                         i_slice, i_slices, 2, 0 );
+        for( int y = slice.i_first; y < slice.i_end; y++ )
+            Merge( SLICE_LINE( p_out, y ), SLICE_LINE( p_in, 2 * y ),
+                   SLICE_LINE( p_in, 2 * y + 1 ), p_in->i_pitch );
     }
     EndMerge();
 }
 
+void RenderMean( filter_t *p_filter,
+                 picture_t *p_outpic, picture_t *p_pic )
+{
+    RenderSlices( p_filter, MeanSlice, p_outpic, p_pic, 0 );
+}
+
 /*****************************************************************************
  * RenderBlend: Full-resolution blender
  *****************************************************************************/
 
-void RenderBlend( filter_t *p_filter,
-                  picture_t *p_outpic, picture_t *p_pic )
+static void BlendSlice( void *p_data, unsigned i_slice, unsigned i_slices )
 {
-    int i_plane;
+    const basic_job_t *p_job = p_data;
+    filter_t *p_filter = p_job->p_filter;
+    const picture_t *p_pic = p_job->p_pic;
 
-    /* Copy image and skip lines */
-    for( i_plane = 0 ; i_plane < p_pic->i_planes ; i_plane++ )
+    for( int i_plane = 0 ; i_plane < p_pic->i_planes ; i_plane++ )
     {
-        uint8_t *p_in, *p_out_end, *p_out;
+        const plane_t *p_in = &p_pic->p[i_plane];
+        plane_t *p_out = &p_job->p_outpic->p[i_plane];
+        filter_slice_t slice;
 
-        p_in = p_pic->p[i_plane].p_pixels;
-
-        p_out = p_outpic->p[i_plane].p_pixels;
-        p_out_end = p_out + p_outpic->p[i_plane].i_pitch
-                             * p_outpic->p[i_plane].i_visible_lines;
-
-        /* First line: simple copy */
-        memcpy( p_out, p_in, p_pic->p[i_plane].i_pitch );
-        p_out += p_outpic->p[i_plane].i_pitch;
-
-        /* Remaining lines: mean value */
-        for( ; p_out < p_out_end ; )
+        filter_GetSlice( &slice, p_out->i_visible_lines,
+                         i_slice, i_slices, 2, 0 );
+        for( int y = slice.i_first; y < slice.i_end; y++ )
         {
-            Merge( p_out, p_in, p_in + p_pic->p[i_plane].i_pitch,
-                   p_pic->p[i_plane].i_pitch );
-
-            p_out += p_outpic->p[i_plane].i_pitch;
-            p_in  += p_pic->p[i_plane].i_pitch;
+            /* First line: simple copy, remaining lines: mean value */
+            if( y == 0 )
+                memcpy( SLICE_LINE( p_out, 0 ), SLICE_LINE( p_in, 0 ),
+                        p_in->i_pitch );
+            else
+                Merge( SLICE_LINE( p_out, y ), SLICE_LINE( p_in, y - 1 ),
+                       SLICE_LINE( p_in, y ), p_in->i_pitch );
         }
     }
     EndMerge();
 }
+
+void RenderBlend( filter_t *p_filter,
+                  picture_t *p_outpic, picture_t *p_pic )
+{
+    RenderSlices( p_filter, BlendSlice, p_outpic, p_pic, 0 );
+}
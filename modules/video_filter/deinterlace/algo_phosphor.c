@@ -268,6 +268,58 @@ static void DarkenFieldMMX( picture_t *p_dst,
 }
 #endif
 
+typedef struct
+{
+    filter_t *p_filter;
+    picture_t *p_dst;
+    picture_t *p_in_top;
+    picture_t *p_in_bottom;
+    compose_chroma_t cc;
+    int i_field;
+} phosphor_job_t;
+
+/* Composes and dims a band of the output frame. The bands start on a line
+   multiple of 4, so that the field parity is kept in every plane. */
+static void PhosphorSlice( void *p_data, unsigned i_slice, unsigned i_slices )
+{
+    const phosphor_job_t *p_job = p_data;
+    filter_t *p_filter = p_job->p_filter;
+    filter_sys_t *p_sys = p_filter->p_sys;
+    const int i_field = p_job->i_field;
+    picture_t dst, in_top, in_bottom;
+
+    filter_SlicePicture( &dst, p_job->p_dst, i_slice, i_slices, 4 );
+    filter_SlicePicture( &in_top, p_job->p_in_top, i_slice, i_slices, 4 );
+    filter_SlicePicture( &in_bottom, p_job->p_in_bottom,
+                         i_slice, i_slices, 4 );
+
+    ComposeFrame( p_filter, &dst, &in_top, &in_bottom, p_job->cc,
+                  p_filter->fmt_in.video.i_chroma == VLC_CODEC_YV12 );
+
+    /* Simulate phosphor light output decay for the old field.
+
+       The dimmer can also be switched off in the configuration, but that is
+       more of a technical curiosity or an educational toy for advanced users
+       than a useful deinterlacer mode (although it does make telecined
+       material look slightly better than without any filtering).
+
+       In most use cases the dimmer is used.
+    */
+    if( p_sys->phosphor.i_dimmer_strength > 0 )
+    {
+#ifdef CAN_COMPILE_MMXEXT
+        if( vlc_CPU_MMXEXT() )
+            DarkenFieldMMX( &dst, !i_field, p_sys->phosphor.i_dimmer_strength,
+                p_sys->chroma->p[1].h.num == p_sys->chroma->p[1].h.den &&
+                p_sys->chroma->p[2].h.num == p_sys->chroma->p[2].h.den );
+        else
+#endif
+            DarkenField( &dst, !i_field, p_sys->phosphor.i_dimmer_strength,
+                p_sys->chroma->p[1].h.num == p_sys->chroma->p[1].h.den &&
+                p_sys->chroma->p[2].h.num == p_sys->chroma->p[2].h.den );
+    }
+}
+
 /*****************************************************************************
  * Public functions
  *****************************************************************************/
@@ -340,29 +392,15 @@ int RenderPhosphor( filter_t *p_filter,
             break;
         }
     }
-    ComposeFrame( p_filter, p_dst, p_in_top, p_in_bottom, cc, p_filter->fmt_in.video.i_chroma == VLC_CODEC_YV12 );
-
-    /* Simulate phosphor light output decay for the old field.
 
-       The dimmer can also be switched off in the configuration, but that is
-       more of a technical curiosity or an educational toy for advanced users
-       than a useful deinterlacer mode (although it does make telecined
-       material look slightly better than without any filtering).
-
-       In most use cases the dimmer is used.
-    */
-    if( p_sys->phosphor.i_dimmer_strength > 0 )
-    {
-#ifdef CAN_COMPILE_MMXEXT
-        if( vlc_CPU_MMXEXT() )
-            DarkenFieldMMX( p_dst, !i_field, p_sys->phosphor.i_dimmer_strength,
-                p_sys->chroma->p[1].h.num == p_sys->chroma->p[1].h.den &&
-                p_sys->chroma->p[2].h.num == p_sys->chroma->p[2].h.den );
-        else
-#endif
-            DarkenField( p_dst, !i_field, p_sys->phosphor.i_dimmer_strength,
-                p_sys->chroma->p[1].h.num == p_sys->chroma->p[1].h.den &&
-                p_sys->chroma->p[2].h.num == p_sys->chroma->p[2].h.den );
-    }
+    phosphor_job_t job = {
+        .p_filter = p_filter,
+        .p_dst = p_dst,
+        .p_in_top = p_in_top,
+        .p_in_bottom = p_in_bottom,
+        .cc = cc,
+        .i_field = i_field,
+    };
+    filter_RunSlices( p_sys->p_slices, PhosphorSlice, &job );
     return VLC_SUCCESS;
 }
@@ -34,6 +34,7 @@
 #include <vlc_common.h>
 #include <vlc_cpu.h>
 #include <vlc_picture.h>
+#include <vlc_filter.h>
 
 #include "deinterlace.h" /* filter_sys_t */
 
@@ -537,8 +538,19 @@ static inline void XDeintBand8x8MMXEXT( uint8_t *dst, int i_dst,
  * Public functions
  *****************************************************************************/
 
-void RenderX( picture_t *p_outpic, picture_t *p_pic )
+typedef struct
 {
+    picture_t *p_outpic;
+    picture_t *p_pic;
+} x_job_t;
+
+/* Each slice renders a band of 8-line blocks of every plane; the last slice
+ * also renders the remaining lines. */
+static void XSlice( void *p_data, unsigned i_slice, unsigned i_slices )
+{
+    const x_job_t *p_job = p_data;
+    picture_t *p_outpic = p_job->p_outpic;
+    picture_t *p_pic = p_job->p_pic;
     int i_plane;
 #if defined (CAN_COMPILE_MMXEXT)
     const bool mmxext = vlc_CPU_MMXEXT();
@@ -556,9 +568,11 @@ void RenderX( picture_t *p_outpic, picture_t *p_pic )
         const int i_dst = p_outpic->p[i_plane].i_pitch;
         const int i_src = p_pic->p[i_plane].i_pitch;
 
+        filter_slice_t slice;
         int y, x;
 
-        for( y = 0; y < i_mby; y++ )
+        filter_GetSlice( &slice, i_mby, i_slice, i_slices, 1, 0 );
+        for( y = slice.i_first; y < slice.i_end; y++ )
         {
             uint8_t *dst = &p_outpic->p[i_plane].p_pixels[8*y*i_dst];
             uint8_t *src = &p_pic->p[i_plane].p_pixels[8*y*i_src];
@@ -572,10 +586,10 @@ void RenderX( picture_t *p_outpic, picture_t *p_pic )
         }
 
         /* Last line (C only)*/
-        if( i_mody )
+        if( i_mody && i_slice == i_slices - 1 )
         {
-            uint8_t *dst = &p_outpic->p[i_plane].p_pixels[8*y*i_dst];
-            uint8_t *src = &p_pic->p[i_plane].p_pixels[8*y*i_src];
+            uint8_t *dst = &p_outpic->p[i_plane].p_pixels[8*i_mby*i_dst];
+            uint8_t *src = &p_pic->p[i_plane].p_pixels[8*i_mby*i_src];
 
             for( x = 0; x < i_mbx; x++ )
             {
@@ -595,3 +609,10 @@ void RenderX( picture_t *p_outpic, picture_t *p_pic )
         emms();
 #endif
 }
+
+void RenderX( filter_t *p_filter, picture_t *p_outpic, picture_t *p_pic )
+{
+    x_job_t job = { .p_outpic = p_outpic, .p_pic = p_pic };
+
+    filter_RunSlices( p_filter->p_sys->p_slices, XSlice, &job );
+}
@@ -47,6 +47,79 @@
    Necessary preprocessor macros are defined in common.h. */
 #include "yadif.h"
 
+typedef void (*yadif_line_t)( uint8_t *dst, uint8_t *prev, uint8_t *cur,
+                              uint8_t *next, int w, int prefs, int mrefs,
+                              int parity, int mode );
+
+typedef struct
+{
+    yadif_line_t pf_filter;
+    picture_t   *p_dst;
+    picture_t   *p_prev, *p_cur, *p_next;
+    int          i_field;
+    int          i_parity;
+    int          i_pixel_size;
+} yadif_job_t;
+
+/* Renders a band of the lines 1 to i_visible_lines - 2 of every plane. The
+ * slices owning them also duplicate the first and last lines. */
+static void YadifSlice( void *p_data, unsigned i_slice, unsigned i_slices )
+{
+    const yadif_job_t *p_job = p_data;
+    const yadif_line_t filter = p_job->pf_filter;
+    const int i_field = p_job->i_field;
+    const int yadif_parity = p_job->i_parity;
+    const int i_pixel_size = p_job->i_pixel_size;
+    picture_t *p_dst = p_job->p_dst;
+
+    for( int n = 0; n < p_dst->i_planes; n++ )
+    {
+        const plane_t *prevp = &p_job->p_prev->p[n];
+        const plane_t *curp  = &p_job->p_cur->p[n];
+        const plane_t *nextp = &p_job->p_next->p[n];
+        plane_t *dstp        = &p_dst->p[n];
+        filter_slice_t slice;
+
+        filter_GetSlice( &slice, dstp->i_visible_lines - 2,
+                         i_slice, i_slices, 2, 0 );
+        for( int y = 1 + slice.i_first; y < 1 + slice.i_end; y++ )
+        {
+            if( (y % 2) == i_field  ||  yadif_parity == 2 )
+            {
+                memcpy( &dstp->p_pixels[y * dstp->i_pitch],
+                            &curp->p_pixels[y * curp->i_pitch], dstp->i_visible_pitch );
+            }
+            else
+            {
+                int mode;
+                /* Spatial checks only when enough data */
+                mode = (y >= 2 && y < dstp->i_visible_lines - 2) ? 0 : 2;
+
+                assert( prevp->i_pitch == curp->i_pitch && curp->i_pitch == nextp->i_pitch );
+                filter( &dstp->p_pixels[y * dstp->i_pitch],
+                        &prevp->p_pixels[y * prevp->i_pitch],
+                        &curp->p_pixels[y * curp->i_pitch],
+                        &nextp->p_pixels[y * nextp->i_pitch],
+                        dstp->i_visible_pitch / i_pixel_size,
+                        y < dstp->i_visible_lines - 2  ? curp->i_pitch : -curp->i_pitch,
+                        y  - 1  ?  -curp->i_pitch : curp->i_pitch,
+                        yadif_parity,
+                        mode );
+            }
+
+            /* We duplicate the first and last lines */
+            if( y == 1 )
+                memcpy(&dstp->p_pixels[(y-1) * dstp->i_pitch],
+                           &dstp->p_pixels[ y    * dstp->i_pitch],
+                           dstp->i_pitch);
+            else if( y == dstp->i_visible_lines - 2 )
+                memcpy(&dstp->p_pixels[(y+1) * dstp->i_pitch],
+                           &dstp->p_pixels[ y    * dstp->i_pitch],
+                           dstp->i_pitch);
+        }
+    }
+}
+
 int RenderYadif( filter_t *p_filter, picture_t *p_dst, picture_t *p_src,
                  int i_order, int i_field )
 {
@@ -105,9 +178,23 @@ int RenderYadif( filter_t *p_filter, picture_t *p_dst, picture_t *p_src,
     if( p_prev && p_cur && p_next )
     {
         /* */
-        void (*filter)(uint8_t *dst, uint8_t *prev, uint8_t *cur, uint8_t *next,
-                       int w, int prefs, int mrefs, int parity, int mode);
+        yadif_line_t filter;
 
+        if( p_sys->chroma->pixel_size == 2 )
+        {
+#if defined(HAVE_YADIF_AVX2)
+            if( vlc_CPU_AVX2() )
+                filter = (yadif_line_t)yadif_filter_line_avx2_16bit;
+            else
+#endif
+                filter = (yadif_line_t)yadif_filter_line_c_16bit;
+        }
+        else
+#if defined(HAVE_YADIF_AVX2)
+        if( vlc_CPU_AVX2() )
+            filter = yadif_filter_line_avx2;
+        else
+#endif
 #if defined(HAVE_YADIF_SSSE3)
         if( vlc_CPU_SSSE3() )
             filter = yadif_filter_line_ssse3;
@@ -125,52 +212,15 @@ int RenderYadif( filter_t *p_filter, picture_t *p_dst, picture_t *p_src,
 #endif
             filter = yadif_filter_line_c;
 
-        if( p_sys->chroma->pixel_size == 2 )
-            filter = yadif_filter_line_c_16bit;
-
-        for( int n = 0; n < p_dst->i_planes; n++ )
-        {
-            const plane_t *prevp = &p_prev->p[n];
-            const plane_t *curp  = &p_cur->p[n];
-            const plane_t *nextp = &p_next->p[n];
-            plane_t *dstp        = &p_dst->p[n];
-
-            for( int y = 1; y < dstp->i_visible_lines - 1; y++ )
-            {
-                if( (y % 2) == i_field  ||  yadif_parity == 2 )
-                {
-                    memcpy( &dstp->p_pixels[y * dstp->i_pitch],
-                                &curp->p_pixels[y * curp->i_pitch], dstp->i_visible_pitch );
-                }
-                else
-                {
-                    int mode;
-                    /* Spatial checks only when enough data */
-                    mode = (y >= 2 && y < dstp->i_visible_lines - 2) ? 0 : 2;
-
-                    assert( prevp->i_pitch == curp->i_pitch && curp->i_pitch == nextp->i_pitch );
-                    filter( &dstp->p_pixels[y * dstp->i_pitch],
-                            &prevp->p_pixels[y * prevp->i_pitch],
-                            &curp->p_pixels[y * curp->i_pitch],
-                            &nextp->p_pixels[y * nextp->i_pitch],
-                            dstp->i_visible_pitch,
-                            y < dstp->i_visible_lines - 2  ? curp->i_pitch : -curp->i_pitch,
-                            y  - 1  ?  -curp->i_pitch : curp->i_pitch,
-                            yadif_parity,
-                            mode );
-                }
-
-                /* We duplicate the first and last lines */
-                if( y == 1 )
-                    memcpy(&dstp->p_pixels[(y-1) * dstp->i_pitch],
-                               &dstp->p_pixels[ y    * dstp->i_pitch],
-                               dstp->i_pitch);
-                else if( y == dstp->i_visible_lines - 2 )
-                    memcpy(&dstp->p_pixels[(y+1) * dstp->i_pitch],
-                               &dstp->p_pixels[ y    * dstp->i_pitch],
-                               dstp->i_pitch);
-            }
-        }
+        yadif_job_t job = {
+            .pf_filter = filter,
+            .p_dst = p_dst,
+            .p_prev = p_prev, .p_cur = p_cur, .p_next = p_next,
+            .i_field = i_field,
+            .i_parity = yadif_parity,
+            .i_pixel_size = p_sys->chroma->pixel_size,
+        };
+        filter_RunSlices( p_sys->p_slices, YadifSlice, &job );
 
         p_sys->i_frame_offset = 1; /* p_cur will be rendered at next frame, too */
 
@@ -182,7 +232,7 @@ int RenderYadif( filter_t *p_filter, picture_t *p_dst, picture_t *p_src,
                  as set by Open() or SetFilterMethod(). It is always 0. */
 
         /* FIXME not good as it does not use i_order/i_field */
-        RenderX( p_dst, p_next );
+        RenderX( p_filter, p_dst, p_next );
         return VLC_SUCCESS;
     }
     else
@@ -441,15 +441,15 @@ picture_t *Deinterlace( filter_t *p_filter, picture_t *p_pic )
     switch( p_sys->i_mode )
     {
         case DEINTERLACE_DISCARD:
-            RenderDiscard( p_dst[0], p_pic, 0 );
+            RenderDiscard( p_filter, p_dst[0], p_pic, 0 );
             break;
 
         case DEINTERLACE_BOB:
-            RenderBob( p_dst[0], p_pic, !b_top_field_first );
+            RenderBob( p_filter, p_dst[0], p_pic, !b_top_field_first );
             if( p_dst[1] )
-                RenderBob( p_dst[1], p_pic, b_top_field_first );
+                RenderBob( p_filter, p_dst[1], p_pic, b_top_field_first );
             if( p_dst[2] )
-                RenderBob( p_dst[2], p_pic, !b_top_field_first );
+                RenderBob( p_filter, p_dst[2], p_pic, !b_top_field_first );
             break;;
 
         case DEINTERLACE_LINEAR:
@@ -469,7 +469,7 @@ picture_t *Deinterlace( filter_t *p_filter, picture_t *p_pic )
             break;
 
         case DEINTERLACE_X:
-            RenderX( p_dst[0], p_pic );
+            RenderX( p_filter, p_dst[0], p_pic );
             break;
 
         case DEINTERLACE_YADIF:
@@ -668,6 +668,14 @@ notsupp:
         p_sys->pf_merge = MergeAltivec;
     else
 #endif
+#if defined(HAVE_MERGE_AVX2)
+    if( vlc_CPU_AVX2() )
+    {
+        p_sys->pf_merge = pixel_size == 1 ? Merge8BitAVX2 : Merge16BitAVX2;
+        p_sys->pf_end_merge = NULL;
+    }
+    else
+#endif
 #if defined(CAN_COMPILE_SSE2)
     if( vlc_CPU_SSE2() )
     {
@@ -707,6 +715,12 @@ notsupp:
 #endif
     }
 
+    /* IVTC works on whole frames and keeps running sequentially */
+    if( p_sys->i_mode != DEINTERLACE_IVTC )
+        p_sys->p_slices = filter_NewSlices( p_filter );
+    else
+        p_sys->p_slices = NULL;
+
     /* */
     if( p_sys->i_mode == DEINTERLACE_PHOSPHOR )
     {
@@ -774,5 +788,6 @@ void Close( vlc_object_t *p_this )
     filter_t *p_filter = (filter_t*)p_this;
 
     Flush( p_filter );
+    filter_DeleteSlices( p_filter->p_sys->p_slices );
     free( p_filter->p_sys );
 }
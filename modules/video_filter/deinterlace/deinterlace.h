@@ -34,6 +34,7 @@ struct picture_t;
 struct vlc_object_t;
 
 #include <vlc_common.h>
+#include <vlc_filter.h>
 #include <vlc_mouse.h>
 
 /* Local algorithm headers */
@@ -118,6 +119,9 @@ struct filter_sys_t
     /** Input frame history buffer for algorithms with temporal filtering. */
     picture_t *pp_history[HISTORY_SIZE];
 
+    /** Slice threads rendering bands of the output frames, or NULL. */
+    filter_slices_t *p_slices;
+
     /* Algorithm-specific substructures */
     phosphor_sys_t phosphor; /**< Phosphor algorithm state. */
     ivtc_sys_t ivtc;         /**< IVTC algorithm state. */
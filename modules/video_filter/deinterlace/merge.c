@@ -42,6 +42,10 @@
 #   include <altivec.h>
 #endif
 
+#ifdef HAVE_MERGE_AVX2
+#   include <immintrin.h>
+#endif
+
 /*****************************************************************************
  * Merge (line blending) routines
  *****************************************************************************/
@@ -178,6 +182,83 @@ void Merge16BitSSE2( void *_p_dest, const void *_p_s1, const void *_p_s2,
 
 #endif
 
+#ifdef HAVE_MERGE_AVX2
+/* Like the SSE2 versions, these average with rounding up except for the
+   bytes before the first 16-bytes aligned source pixel and the remainder. */
+__attribute__ ((__target__ ("avx2")))
+void Merge8BitAVX2( void *_p_dest, const void *_p_s1, const void *_p_s2,
+                    size_t i_bytes )
+{
+    uint8_t *p_dest = _p_dest;
+    const uint8_t *p_s1 = _p_s1;
+    const uint8_t *p_s2 = _p_s2;
+
+    for( ; i_bytes > 0 && ((uintptr_t)p_s1 & 15); i_bytes-- )
+        *p_dest++ = ( *p_s1++ + *p_s2++ ) >> 1;
+
+    for( ; i_bytes >= 32; i_bytes -= 32 )
+    {
+        __m256i s1 = _mm256_loadu_si256( (const __m256i *)p_s1 );
+        __m256i s2 = _mm256_loadu_si256( (const __m256i *)p_s2 );
+        _mm256_storeu_si256( (__m256i *)p_dest, _mm256_avg_epu8( s1, s2 ) );
+        p_dest += 32;
+        p_s1 += 32;
+        p_s2 += 32;
+    }
+
+    if( i_bytes >= 16 )
+    {
+        __m128i s1 = _mm_load_si128( (const __m128i *)p_s1 );
+        __m128i s2 = _mm_loadu_si128( (const __m128i *)p_s2 );
+        _mm_storeu_si128( (__m128i *)p_dest, _mm_avg_epu8( s1, s2 ) );
+        p_dest += 16;
+        p_s1 += 16;
+        p_s2 += 16;
+        i_bytes -= 16;
+    }
+
+    for( ; i_bytes > 0; i_bytes-- )
+        *p_dest++ = ( *p_s1++ + *p_s2++ ) >> 1;
+}
+
+__attribute__ ((__target__ ("avx2")))
+void Merge16BitAVX2( void *_p_dest, const void *_p_s1, const void *_p_s2,
+                     size_t i_bytes )
+{
+    uint16_t *p_dest = _p_dest;
+    const uint16_t *p_s1 = _p_s1;
+    const uint16_t *p_s2 = _p_s2;
+
+    size_t i_words = i_bytes / 2;
+    for( ; i_words > 0 && ((uintptr_t)p_s1 & 15); i_words-- )
+        *p_dest++ = ( *p_s1++ + *p_s2++ ) >> 1;
+
+    for( ; i_words >= 16; i_words -= 16 )
+    {
+        __m256i s1 = _mm256_loadu_si256( (const __m256i *)p_s1 );
+        __m256i s2 = _mm256_loadu_si256( (const __m256i *)p_s2 );
+        _mm256_storeu_si256( (__m256i *)p_dest, _mm256_avg_epu16( s1, s2 ) );
+        p_dest += 16;
+        p_s1 += 16;
+        p_s2 += 16;
+    }
+
+    if( i_words >= 8 )
+    {
+        __m128i s1 = _mm_load_si128( (const __m128i *)p_s1 );
+        __m128i s2 = _mm_loadu_si128( (const __m128i *)p_s2 );
+        _mm_storeu_si128( (__m128i *)p_dest, _mm_avg_epu16( s1, s2 ) );
+        p_dest += 8;
+        p_s1 += 8;
+        p_s2 += 8;
+        i_words -= 8;
+    }
+
+    for( ; i_words > 0; i_words-- )
+        *p_dest++ = ( *p_s1++ + *p_s2++ ) >> 1;
+}
+#endif
+
 #ifdef CAN_COMPILE_C_ALTIVEC
 void MergeAltivec( void *_p_dest, const void *_p_s1,
                    const void *_p_s2, size_t i_bytes )
@@ -145,3 +145,43 @@ static void yadif_filter_line_c_16bit(uint16_t *dst, uint16_t *prev, uint16_t *c
     prefs /= 2;
     FILTER
 }
+
+#if defined(HAVE_SSE2_INTRINSICS) && (VLC_GCC_VERSION(4, 9) || defined(__clang__))
+#include <immintrin.h>
+// ================= AVX2 =================
+#define HAVE_YADIF_AVX2
+#define OP(op) _mm256_ ## op ## _epi16
+#define PIXEL uint8_t
+#define STEP 16
+#define LOAD(p) _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(p)))
+#define STORE(p, v) _mm_storeu_si128((__m128i *)(p), \
+    _mm_packus_epi16(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1)))
+#define C_FILTER yadif_filter_line_c
+#define RENAME(a) a ## _avx2
+#include "yadif_avx2_template.h"
+#undef OP
+#undef PIXEL
+#undef STEP
+#undef LOAD
+#undef STORE
+#undef C_FILTER
+#undef RENAME
+
+// ============= AVX2 16 bits =============
+#define OP(op) _mm256_ ## op ## _epi32
+#define PIXEL uint16_t
+#define STEP 8
+#define LOAD(p) _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(p)))
+#define STORE(p, v) _mm_storeu_si128((__m128i *)(p), \
+    _mm_packus_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1)))
+#define C_FILTER yadif_filter_line_c_16bit
+#define RENAME(a) a ## _avx2_16bit
+#include "yadif_avx2_template.h"
+#undef OP
+#undef PIXEL
+#undef STEP
+#undef LOAD
+#undef STORE
+#undef C_FILTER
+#undef RENAME
+#endif
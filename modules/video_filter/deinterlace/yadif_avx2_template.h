@@ -0,0 +1,133 @@
+/*****************************************************************************
+ * yadif_avx2_template.h: AVX2 Yadif line filter
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* This is the FILTER macro of yadif.h computed on STEP pixels at once, with
+ * the pixels widened to 16 bits (8 bits input) or 32 bits (16 bits input)
+ * lanes. The output is the same as the C version bit for bit.
+ *
+ * It is included by yadif.h with:
+ *   RENAME(a)    name of the function
+ *   PIXEL        pixel type
+ *   STEP         number of pixels per iteration
+ *   LOAD(p)      loads STEP widened pixels
+ *   STORE(p, v)  narrows and stores STEP pixels
+ *   OP(op)       lane size intrinsic, e.g. _mm256_add_epi16
+ *   C_FILTER     C line filter for the remaining pixels
+ */
+
+#define YADIF_ABSDIFF(a, b) OP(abs)( OP(sub)( a, b ) )
+#define YADIF_SCORE(j) \
+    OP(add)( OP(add)( \
+        YADIF_ABSDIFF( LOAD(&cur[mrefs-1+(j)]), LOAD(&cur[prefs-1-(j)]) ), \
+        YADIF_ABSDIFF( LOAD(&cur[mrefs  +(j)]), LOAD(&cur[prefs  -(j)]) ) ), \
+        YADIF_ABSDIFF( LOAD(&cur[mrefs+1+(j)]), LOAD(&cur[prefs+1-(j)]) ) )
+#define YADIF_PRED(j) \
+    OP(srai)( OP(add)( LOAD(&cur[mrefs+(j)]), LOAD(&cur[prefs-(j)]) ), 1 )
+/* Takes the direction j for the pixels of mask where its score is lower */
+#define YADIF_CHECK(j, mask) \
+    do { \
+        const __m256i score = YADIF_SCORE(j); \
+        mask = _mm256_and_si256( mask, OP(cmpgt)( spatial_score, score ) ); \
+        spatial_score = _mm256_blendv_epi8( spatial_score, score, mask ); \
+        spatial_pred = _mm256_blendv_epi8( spatial_pred, YADIF_PRED(j), \
+                                           mask ); \
+    } while(0)
+
+__attribute__ ((__target__ ("avx2")))
+static void RENAME(yadif_filter_line)(PIXEL *dst, PIXEL *prev, PIXEL *cur, PIXEL *next, int w, int prefs, int mrefs, int parity, int mode)
+{
+    const int i_prefs = prefs, i_mrefs = mrefs;
+    PIXEL *prev2 = parity ? prev : cur ;
+    PIXEL *next2 = parity ? cur  : next;
+    const __m256i one = OP(set1)( 1 );
+    int x;
+
+    prefs /= (int)sizeof(PIXEL);
+    mrefs /= (int)sizeof(PIXEL);
+
+    for( x = 0; x + STEP <= w; x += STEP )
+    {
+        const __m256i c = LOAD(&cur[mrefs]);
+        const __m256i e = LOAD(&cur[prefs]);
+        const __m256i p2 = LOAD(prev2);
+        const __m256i n2 = LOAD(next2);
+        const __m256i d = OP(srai)( OP(add)( p2, n2 ), 1 );
+
+        const __m256i temporal_diff0 = YADIF_ABSDIFF( p2, n2 );
+        const __m256i temporal_diff1 = OP(srai)( OP(add)(
+            YADIF_ABSDIFF( LOAD(&prev[mrefs]), c ),
+            YADIF_ABSDIFF( LOAD(&prev[prefs]), e ) ), 1 );
+        const __m256i temporal_diff2 = OP(srai)( OP(add)(
+            YADIF_ABSDIFF( LOAD(&next[mrefs]), c ),
+            YADIF_ABSDIFF( LOAD(&next[prefs]), e ) ), 1 );
+        __m256i diff = OP(max)( OP(max)( OP(srai)( temporal_diff0, 1 ),
+                                         temporal_diff1 ), temporal_diff2 );
+
+        __m256i spatial_pred = OP(srai)( OP(add)( c, e ), 1 );
+        __m256i spatial_score = OP(sub)( OP(add)( OP(add)(
+            YADIF_ABSDIFF( LOAD(&cur[mrefs-1]), LOAD(&cur[prefs-1]) ),
+            YADIF_ABSDIFF( c, e ) ),
+            YADIF_ABSDIFF( LOAD(&cur[mrefs+1]), LOAD(&cur[prefs+1]) ) ), one );
+
+        /* The directions 2 are only checked where 1 was taken */
+        __m256i mask = _mm256_cmpeq_epi8( one, one );
+        YADIF_CHECK( -1, mask );
+        YADIF_CHECK( -2, mask );
+        mask = _mm256_cmpeq_epi8( one, one );
+        YADIF_CHECK( 1, mask );
+        YADIF_CHECK( 2, mask );
+
+        if( mode < 2 )
+        {
+            const __m256i b = OP(srai)( OP(add)( LOAD(&prev2[2*mrefs]),
+                                                 LOAD(&next2[2*mrefs]) ), 1 );
+            const __m256i f = OP(srai)( OP(add)( LOAD(&prev2[2*prefs]),
+                                                 LOAD(&next2[2*prefs]) ), 1 );
+            const __m256i de = OP(sub)( d, e ), dc = OP(sub)( d, c );
+            const __m256i bc = OP(sub)( b, c ), fe = OP(sub)( f, e );
+            const __m256i max = OP(max)( OP(max)( de, dc ), OP(min)( bc, fe ) );
+            const __m256i min = OP(min)( OP(min)( de, dc ), OP(max)( bc, fe ) );
+
+            diff = OP(max)( OP(max)( diff, min ),
+                            OP(sub)( _mm256_setzero_si256(), max ) );
+        }
+
+        /* diff is never negative, so this is the clipping of FILTER */
+        spatial_pred = OP(min)( OP(max)( spatial_pred, OP(sub)( d, diff ) ),
+                                OP(add)( d, diff ) );
+        STORE( dst, spatial_pred );
+
+        dst += STEP;
+        cur += STEP;
+        prev += STEP;
+        next += STEP;
+        prev2 += STEP;
+        next2 += STEP;
+    }
+
+    if( x < w )
+        C_FILTER( dst, prev, cur, next, w - x, i_prefs, i_mrefs,
+                  parity, mode );
+}
+
+#undef YADIF_CHECK
+#undef YADIF_PRED
+#undef YADIF_SCORE
+#undef YADIF_ABSDIFF
@@ -0,0 +1,425 @@
+/*****************************************************************************
+ * deinterlacebench.c : deinterlacing benchmark plugin for vlc
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*****************************************************************************
+ * Preamble
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc_common.h>
+#include <vlc_plugin.h>
+#include <vlc_modules.h>
+#include <vlc_filter.h>
+
+/*****************************************************************************
+ * Local prototypes
+ *****************************************************************************/
+static int Create( vlc_object_t * );
+static void Destroy( vlc_object_t * );
+
+static picture_t *Filter( filter_t *, picture_t * );
+
+/*****************************************************************************
+ * Module descriptor
+ *****************************************************************************/
+
+#define LOOPS_TEXT N_("Number of frames to deinterlace")
+#define LOOPS_LONGTEXT N_("The number of frames each deinterlace mode " \
+                          "processes for every size and chroma")
+
+#define SIZES_TEXT N_("Frame sizes")
+#define SIZES_LONGTEXT N_("Comma separated list of the sizes of the " \
+                          "generated interlaced frames, for instance " \
+                          "\"1920x1080,3840x2160\"")
+
+#define CHROMAS_TEXT N_("Chromas")
+#define CHROMAS_LONGTEXT N_("Comma separated list of the fourccs of the " \
+                            "generated interlaced frames")
+
+#define MODES_TEXT N_("Deinterlace modes")
+#define MODES_LONGTEXT N_("Comma separated list of the deinterlace modes " \
+                          "to benchmark. Leave empty for all of them.")
+
+#define CFG_PREFIX "deinterlacebench-"
+
+vlc_module_begin ()
+    set_description( N_("Deinterlacing benchmark filter") )
+    set_shortname( N_("Deinterlacebench" ))
+    set_category( CAT_VIDEO )
+    set_subcategory( SUBCAT_VIDEO_VFILTER )
+    set_capability( "video filter2", 0 )
+
+    set_section( N_("Benchmarking"), NULL )
+    add_integer( CFG_PREFIX "loops", 100, LOOPS_TEXT,
+                 LOOPS_LONGTEXT, false )
+    add_string( CFG_PREFIX "sizes", "1920x1080,3840x2160", SIZES_TEXT,
+                SIZES_LONGTEXT, false )
+    add_string( CFG_PREFIX "chromas", "I420,I0AL", CHROMAS_TEXT,
+                CHROMAS_LONGTEXT, false )
+    add_string( CFG_PREFIX "modes", NULL, MODES_TEXT,
+                MODES_LONGTEXT, false )
+
+    set_callbacks( Create, Destroy )
+vlc_module_end ()
+
+static const char *const ppsz_filter_options[] = {
+    "loops", "sizes", "chromas", "modes", NULL
+};
+
+/* The modes of the deinterlace filter, see SetFilterMethod() */
+static const char psz_default_modes[] =
+    "discard,blend,mean,bob,linear,x,yadif,yadif2x,phosphor,ivtc";
+
+/* Modes the deinterlace filter only has for 8 bits chromas */
+static const char *const ppsz_8bit_modes[] = { "x", "phosphor", "ivtc" };
+
+/* Number of distinct input frames. The deinterlace filter keeps up to three
+ * of them in its history, so the frame being timestamped is never held. */
+#define BENCH_FRAMES 4
+
+/*****************************************************************************
+ * filter_sys_t: filter method descriptor
+ *****************************************************************************/
+struct filter_sys_t
+{
+    bool b_done;
+    int i_loops;
+    char *psz_sizes;
+    char *psz_chromas;
+    char *psz_modes;
+};
+
+/*****************************************************************************
+ * Create: allocates video thread output method
+ *****************************************************************************/
+static int Create( vlc_object_t *p_this )
+{
+    filter_t *p_filter = (filter_t *)p_this;
+    filter_sys_t *p_sys;
+
+    /* Allocate structure */
+    p_filter->p_sys = p_sys = malloc( sizeof( filter_sys_t ) );
+    if( p_sys == NULL )
+        return VLC_ENOMEM;
+
+    p_sys->b_done = false;
+
+    p_filter->pf_video_filter = Filter;
+
+    /* needed to get options passed in transcode using the
+     * deinterlacebench{name=value} syntax */
+    config_ChainParse( p_filter, CFG_PREFIX, ppsz_filter_options,
+                       p_filter->p_cfg );
+
+    p_sys->i_loops = var_CreateGetIntegerCommand( p_filter,
+                                                  CFG_PREFIX "loops" );
+    p_sys->psz_sizes = var_CreateGetStringCommand( p_filter,
+                                                   CFG_PREFIX "sizes" );
+    p_sys->psz_chromas = var_CreateGetStringCommand( p_filter,
+                                                     CFG_PREFIX "chromas" );
+    p_sys->psz_modes = var_CreateGetStringCommand( p_filter,
+                                                   CFG_PREFIX "modes" );
+
+    return VLC_SUCCESS;
+}
+
+/*****************************************************************************
+ * Destroy: destroy video thread output method
+ *****************************************************************************/
+static void Destroy( vlc_object_t *p_this )
+{
+    filter_t *p_filter = (filter_t *)p_this;
+    filter_sys_t *p_sys = p_filter->p_sys;
+
+    free( p_sys->psz_sizes );
+    free( p_sys->psz_chromas );
+    free( p_sys->psz_modes );
+    free( p_sys );
+}
+
+/**
+ * Generates an interlaced frame: a diagonal pattern moving by i_frame
+ * pixels a frame, whose bottom field lags half a frame behind, with some
+ * noise so that the comb detectors see both still and moving areas.
+ */
+static picture_t *deinterlacebench_NewFrame( const video_format_t *p_fmt,
+                                             unsigned i_frame )
+{
+    picture_t *p_pic = picture_NewFromFormat( p_fmt );
+    if( !p_pic )
+        return NULL;
+
+    const vlc_chroma_description_t *p_dsc =
+        vlc_fourcc_GetChromaDescription( p_fmt->i_chroma );
+    const unsigned i_max = (1 << p_dsc->pixel_bits) - 1;
+    uint32_t i_seed = 1 + i_frame;
+
+    for( int i = 0; i < p_pic->i_planes; i++ )
+    {
+        plane_t *p = &p_pic->p[i];
+        const int i_width = p->i_visible_pitch / p->i_pixel_pitch;
+
+        for( int y = 0; y < p->i_visible_lines; y++ )
+        {
+            uint8_t *p_line = &p->p_pixels[y * p->i_pitch];
+            /* The moving half of the picture moves a field at a time */
+            const int i_shift = 2 * i_frame + (y & 1);
+
+            for( int x = 0; x < i_width; x++ )
+            {
+                i_seed = i_seed * 1103515245 + 12345;
+                unsigned v = 4 * (x + y) + 16 * i;
+                if( y >= p->i_visible_lines / 2 )
+                    v += 8 * i_shift;
+                v = (v & 0xff) + (i_seed >> 28);
+                if( p_dsc->pixel_size == 2 )
+                    ((uint16_t *)p_line)[x] = __MIN( v << 2, i_max );
+                else
+                    p_line[x] = __MIN( v, 255 );
+            }
+        }
+    }
+    p_pic->b_progressive = false;
+    p_pic->b_top_field_first = true;
+    p_pic->i_nb_fields = 2;
+    return p_pic;
+}
+
+static uint32_t deinterlacebench_Checksum( const picture_t *p_pic )
+{
+    uint32_t i_hash = 2166136261u;
+
+    for( int i = 0; i < p_pic->i_planes; i++ )
+    {
+        const plane_t *p = &p_pic->p[i];
+        for( int y = 0; y < p->i_visible_lines; y++ )
+            for( int x = 0; x < p->i_visible_pitch; x++ )
+                i_hash = (i_hash ^ p->p_pixels[y * p->i_pitch + x])
+                         * 16777619u;
+    }
+    return i_hash;
+}
+
+static picture_t *deinterlacebench_NewPicture( filter_t *p_deint )
+{
+    return picture_NewFromFormat( &p_deint->fmt_out.video );
+}
+
+static void deinterlacebench_DelPicture( filter_t *p_deint, picture_t *p_pic )
+{
+    VLC_UNUSED( p_deint );
+    picture_Release( p_pic );
+}
+
+/**
+ * Deinterlaces i_loops frames with the given mode and reports the
+ * throughput. The checksum is taken on the last output frame, so that runs
+ * on different builds or CPUs can be checked for identical output.
+ */
+static void deinterlacebench_Run( filter_t *p_filter, const char *psz_mode,
+                                  picture_t **pp_frames )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+    const video_format_t *p_fmt = &pp_frames[0]->format;
+    config_chain_t cfg = {
+        .p_next = NULL,
+        .psz_name = (char *)"mode",
+        .psz_value = (char *)psz_mode,
+    };
+
+    filter_t *p_deint = vlc_object_create( p_filter, sizeof(filter_t) );
+    if( !p_deint )
+        return;
+
+    es_format_Init( &p_deint->fmt_in, VIDEO_ES, p_fmt->i_chroma );
+    p_deint->fmt_in.video = *p_fmt;
+    p_deint->fmt_out = p_deint->fmt_in;
+    p_deint->b_allow_fmt_out_change = true;
+    p_deint->p_cfg = &cfg;
+    p_deint->pf_video_buffer_new = deinterlacebench_NewPicture;
+    p_deint->pf_video_buffer_del = deinterlacebench_DelPicture;
+    p_deint->p_module = module_need( p_deint, "video filter2",
+                                     "deinterlace", true );
+    if( !p_deint->p_module )
+    {
+        msg_Err( p_filter, "cannot deinterlace %4.4s",
+                 (const char *)&p_fmt->i_chroma );
+        vlc_object_release( p_deint );
+        return;
+    }
+
+    const mtime_t i_frame_dur = CLOCK_FREQ * p_fmt->i_frame_rate_base
+                                / p_fmt->i_frame_rate;
+    unsigned i_out = 0;
+    uint32_t i_checksum = 0;
+
+    mtime_t time = mdate();
+    for( int i_iter = 0; i_iter < p_sys->i_loops; ++i_iter )
+    {
+        picture_t *p_pic = picture_Hold( pp_frames[i_iter % BENCH_FRAMES] );
+        p_pic->date = VLC_TS_0 + i_iter * i_frame_dur;
+
+        picture_t *p_out = p_deint->pf_video_filter( p_deint, p_pic );
+        while( p_out )
+        {
+            picture_t *p_next = p_out->p_next;
+            if( !p_next && i_iter == p_sys->i_loops - 1 )
+                i_checksum = deinterlacebench_Checksum( p_out );
+            picture_Release( p_out );
+            p_out = p_next;
+            i_out++;
+        }
+    }
+    time = mdate() - time;
+
+    module_unneed( p_deint, p_deint->p_module );
+    vlc_object_release( p_deint );
+
+    const double f_sec = __MAX( time, 1 ) / 1000000.;
+
+    msg_Info( p_filter, "%s on %4.4s %ux%u: deinterlaced %d frames into %u "
+              "in %f sec, %.2f frames/second, checksum %08" PRIx32,
+              psz_mode, (const char *)&p_fmt->i_chroma,
+              p_fmt->i_visible_width, p_fmt->i_visible_height,
+              p_sys->i_loops, i_out, f_sec, p_sys->i_loops / f_sec,
+              i_checksum );
+}
+
+/* Benchmarks every mode of the list on frames of the given format */
+static void deinterlacebench_RunModes( filter_t *p_filter,
+                                       const video_format_t *p_fmt )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+    const char *psz_modes = p_sys->psz_modes && *p_sys->psz_modes ?
+                            p_sys->psz_modes : psz_default_modes;
+    const bool b_8bit =
+        vlc_fourcc_GetChromaDescription( p_fmt->i_chroma )->pixel_size == 1;
+    picture_t *pp_frames[BENCH_FRAMES];
+
+    for( unsigned i = 0; i < BENCH_FRAMES; i++ )
+    {
+        pp_frames[i] = deinterlacebench_NewFrame( p_fmt, i );
+        if( !pp_frames[i] )
+        {
+            msg_Err( p_filter, "cannot allocate %4.4s frames",
+                     (const char *)&p_fmt->i_chroma );
+            while( i > 0 )
+                picture_Release( pp_frames[--i] );
+            return;
+        }
+    }
+
+    char *psz_list = strdup( psz_modes );
+    if( psz_list == NULL )
+        goto out;
+
+    char *psz_save;
+    for( char *psz_mode = strtok_r( psz_list, ",", &psz_save );
+         psz_mode != NULL; psz_mode = strtok_r( NULL, ",", &psz_save ) )
+    {
+        bool b_skip = false;
+        for( size_t i = 0; !b_8bit && i < ARRAY_SIZE(ppsz_8bit_modes); i++ )
+            b_skip |= !strcmp( psz_mode, ppsz_8bit_modes[i] );
+        if( b_skip )
+        {
+            msg_Dbg( p_filter, "%s does not support %4.4s, skipped",
+                     psz_mode, (const char *)&p_fmt->i_chroma );
+            continue;
+        }
+        deinterlacebench_Run( p_filter, psz_mode, pp_frames );
+    }
+    free( psz_list );
+out:
+    for( unsigned i = 0; i < BENCH_FRAMES; i++ )
+        picture_Release( pp_frames[i] );
+}
+
+/* Benchmarks every size and chroma of the lists */
+static void deinterlacebench_RunAll( filter_t *p_filter )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+    char *psz_sizes = strdup( p_sys->psz_sizes ? p_sys->psz_sizes : "" );
+    char *psz_chromas = strdup( p_sys->psz_chromas ? p_sys->psz_chromas : "" );
+    char *psz_size_save, *psz_chroma_save;
+
+    if( psz_sizes == NULL || psz_chromas == NULL )
+        goto out;
+
+    for( char *psz_size = strtok_r( psz_sizes, ",", &psz_size_save );
+         psz_size != NULL; psz_size = strtok_r( NULL, ",", &psz_size_save ) )
+    {
+        unsigned i_width, i_height;
+        if( sscanf( psz_size, "%ux%u", &i_width, &i_height ) != 2
+         || i_width < 16 || i_height < 16 )
+        {
+            msg_Err( p_filter, "invalid frame size \"%s\"", psz_size );
+            continue;
+        }
+
+        /* The list is walked again for every size */
+        char *psz_list = strdup( psz_chromas );
+        if( psz_list == NULL )
+            break;
+        for( char *psz_chroma = strtok_r( psz_list, ",", &psz_chroma_save );
+             psz_chroma != NULL;
+             psz_chroma = strtok_r( NULL, ",", &psz_chroma_save ) )
+        {
+            const vlc_fourcc_t i_chroma =
+                vlc_fourcc_GetCodecFromString( VIDEO_ES, psz_chroma );
+            const vlc_chroma_description_t *p_dsc =
+                vlc_fourcc_GetChromaDescription( i_chroma );
+            if( p_dsc == NULL || p_dsc->plane_count != 3
+             || p_dsc->pixel_size > 2 )
+            {
+                msg_Err( p_filter, "unsupported chroma \"%s\"", psz_chroma );
+                continue;
+            }
+
+            video_format_t fmt;
+            video_format_Setup( &fmt, i_chroma, i_width, i_height,
+                                i_width, i_height, 1, 1 );
+            fmt.i_frame_rate = 30000;
+            fmt.i_frame_rate_base = 1001;
+            deinterlacebench_RunModes( p_filter, &fmt );
+        }
+        free( psz_list );
+    }
+out:
+    free( psz_chromas );
+    free( psz_sizes );
+}
+
+/*****************************************************************************
+ * Filter: runs the benchmark once and lets the video through
+ *****************************************************************************/
+static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+
+    if( !p_sys->b_done )
+    {
+        deinterlacebench_RunAll( p_filter );
+        p_sys->b_done = true;
+    }
+    return p_pic;
+}
@@ -106,8 +106,17 @@ struct filter_sys_t {
     int              radius;
     const vlc_chroma_description_t *chroma;
     struct vf_priv_s cfg;
+    filter_slices_t  *slices;
 };
 
+/* Picture being filtered, shared by the slices */
+typedef struct {
+    filter_sys_t *sys;
+    const video_format_t *fmt;
+    picture_t    *src;
+    picture_t    *dst;
+} gradfun_job_t;
+
 static int Open(vlc_object_t *object)
 {
     filter_t *filter = (filter_t *)object;
@@ -129,12 +138,13 @@ static int Open(vlc_object_t *object)
     sys->radius   = var_CreateGetIntegerCommand(filter, CFG_PREFIX "radius");
     var_AddCallback(filter, CFG_PREFIX "strength", Callback, NULL);
     var_AddCallback(filter, CFG_PREFIX "radius",   Callback, NULL);
-    sys->cfg.buf = NULL;
+    sys->slices   = filter_NewSlices(filter);
 
     struct vf_priv_s *cfg = &sys->cfg;
     cfg->thresh      = 0.0;
     cfg->radius      = 0;
     cfg->buf         = NULL;
+    cfg->buf_size    = 0;
 
 #if HAVE_SSE2 && HAVE_6REGS
     if (vlc_CPU_SSE2())
@@ -166,11 +176,47 @@ static void Close(vlc_object_t *object)
 
     var_DelCallback(filter, CFG_PREFIX "radius",   Callback, NULL);
     var_DelCallback(filter, CFG_PREFIX "strength", Callback, NULL);
+    filter_DeleteSlices(sys->slices);
     vlc_free(sys->cfg.buf);
     vlc_mutex_destroy(&sys->lock);
     free(sys);
 }
 
+static void Slice(void *data, unsigned index, unsigned count)
+{
+    const gradfun_job_t *job = data;
+    const filter_sys_t *sys = job->sys;
+    const video_format_t *fmt = job->fmt;
+    const struct vf_priv_s *cfg = &sys->cfg;
+
+    /* Each band keeps its own blur state */
+    uint16_t *buf = cfg->buf ? &cfg->buf[index * cfg->buf_size] : NULL;
+
+    for (int i = 0; i < job->dst->i_planes; i++) {
+        const plane_t *srcp = &job->src->p[i];
+        plane_t       *dstp = &job->dst->p[i];
+
+        const vlc_chroma_description_t *chroma = sys->chroma;
+        int w = fmt->i_width  * chroma->p[i].w.num / chroma->p[i].w.den;
+        int h = fmt->i_height * chroma->p[i].h.num / chroma->p[i].h.den;
+        int r = (cfg->radius  * chroma->p[i].w.num / chroma->p[i].w.den +
+                 cfg->radius  * chroma->p[i].h.num / chroma->p[i].h.den) / 2;
+        r = VLC_CLIP((r + 1) & ~1, RADIUS_MIN, RADIUS_MAX);
+        if (__MIN(w, h) > 2 * r && buf) {
+            filter_slice_t slice;
+            filter_GetSlice(&slice, h, index, count, 2, 0);
+            filter_plane(cfg, buf, dstp->p_pixels, srcp->p_pixels,
+                         w, h, dstp->i_pitch, srcp->i_pitch, r,
+                         slice.i_first, slice.i_end);
+        } else {
+            picture_t src_band, dst_band;
+            filter_SlicePicture(&src_band, job->src, index, count, 4);
+            filter_SlicePicture(&dst_band, job->dst, index, count, 4);
+            plane_CopyPixels(&dst_band.p[i], &src_band.p[i]);
+        }
+    }
+}
+
 static picture_t *Filter(filter_t *filter, picture_t *src)
 {
     filter_sys_t *sys = filter->p_sys;
@@ -191,28 +237,18 @@ static picture_t *Filter(filter_t *filter, picture_t *src)
 
     cfg->thresh = (1 << 15) / strength;
     if (cfg->radius != radius) {
-        cfg->radius = radius;
-        cfg->buf    = vlc_memalign(16,
-                                   (((fmt->i_width + 15) & ~15) * (cfg->radius + 1) / 2 + 32) * sizeof(*cfg->buf));
+        /* A multiple of 8 entries keeps every slice buffer aligned */
+        cfg->radius   = radius;
+        cfg->buf_size = ((fmt->i_width + 15) & ~15) / 2 * (radius + 1) + 32;
+        vlc_free(cfg->buf);
+        cfg->buf      = vlc_memalign(16, filter_CountSlices(sys->slices) *
+                                         cfg->buf_size * sizeof(*cfg->buf));
     }
 
-    for (int i = 0; i < dst->i_planes; i++) {
-        const plane_t *srcp = &src->p[i];
-        plane_t       *dstp = &dst->p[i];
-
-        const vlc_chroma_description_t *chroma = sys->chroma;
-        int w = fmt->i_width  * chroma->p[i].w.num / chroma->p[i].w.den;
-        int h = fmt->i_height * chroma->p[i].h.num / chroma->p[i].h.den;
-        int r = (cfg->radius  * chroma->p[i].w.num / chroma->p[i].w.den +
-                 cfg->radius  * chroma->p[i].h.num / chroma->p[i].h.den) / 2;
-        r = VLC_CLIP((r + 1) & ~1, RADIUS_MIN, RADIUS_MAX);
-        if (__MIN(w, h) > 2 * r && cfg->buf) {
-            filter_plane(cfg, dstp->p_pixels, srcp->p_pixels,
-                         w, h, dstp->i_pitch, srcp->i_pitch, r);
-        } else {
-            plane_CopyPixels(dstp, srcp);
-        }
-    }
+    gradfun_job_t job = {
+        .sys = sys, .fmt = fmt, .src = src, .dst = dst,
+    };
+    filter_RunSlices(sys->slices, Slice, &job);
 
     picture_CopyProperties(dst, src);
     picture_Release(src);
@@ -31,7 +31,8 @@
 struct vf_priv_s {
     int thresh;
     int radius;
-    uint16_t *buf;
+    uint16_t *buf;      /* One blur buffer of buf_size entries per slice */
+    int buf_size;
     void (*filter_line)(uint8_t *dst, uint8_t *src, uint16_t *dc,
                         int width, int thresh, const uint16_t *dithers);
     void (*blur_line)(uint16_t *dc, uint16_t *buf, uint16_t *buf1,
@@ -223,45 +224,60 @@ static void blur_line_sse2(uint16_t *dc, uint16_t *buf, uint16_t *buf1,
 }
 #endif // HAVE_6REGS && HAVE_SSE2
 
-static void filter_plane(struct vf_priv_s *ctx, uint8_t *dst, uint8_t *src,
-                         int width, int height, int dstride, int sstride, int r)
+/* Last pair of lines in the blur window used for line y */
+static int blur_window(int y, int height, int r)
+{
+    int step = y < r ? r : y & ~1;
+    int last = (height - r - 1 - r) & ~1; /* last step which blurs a pair */
+    if (step > r + last)
+        step = r + last;
+    return (step + r) / 2;
+}
+
+/* Filters the lines y_first to y_end - 1. The blur state is rebuilt from the
+ * r pairs of lines before the window of y_first, so that independent bands
+ * give the same result as the whole plane. buffer holds the state. */
+static void filter_plane(const struct vf_priv_s *ctx, uint16_t *buffer,
+                         uint8_t *dst, uint8_t *src,
+                         int width, int height, int dstride, int sstride, int r,
+                         int y_first, int y_end)
 {
     int bstride = ((width+15)&~15)/2;
-    int y;
+    int y, p, t;
     uint32_t dc_factor = (1<<21)/(r*r);
-    uint16_t *dc = ctx->buf+16;
-    uint16_t *buf = ctx->buf+bstride+32;
+    uint16_t *dc = buffer+16;
+    uint16_t *buf = buffer+bstride+32;
     int thresh = ctx->thresh;
 
-    memset(dc, 0, (bstride+16)*sizeof(*buf));
-    for (y=0; y<r; y++)
-        ctx->blur_line(dc, buf+y*bstride, buf+(y-1)*bstride, src+2*y*sstride, sstride, width/2);
-    for (;;) {
-        if (y < height-r) {
-            int mod = ((y+r)/2)%r;
-            uint16_t *buf0 = buf+mod*bstride;
-            uint16_t *buf1 = buf+(mod?mod-1:r-1)*bstride;
-            int x, v;
-            ctx->blur_line(dc, buf0, buf1, src+(y+r)*sstride, sstride, width/2);
-            for (x=v=0; x<r; x++)
-                v += dc[x];
-            for (; x<width/2; x++) {
-                v += dc[x] - dc[x-r];
-                dc[x-r] = v * dc_factor >> 16;
-            }
-            for (; x<(width+r+1)/2; x++)
-                dc[x-r] = v * dc_factor >> 16;
-            for (x=-r/2; x<0; x++)
-                dc[x] = dc[0];
-        }
-        if (y == r) {
-            for (y=0; y<r; y++)
-                ctx->filter_line(dst+y*dstride, src+y*sstride, dc-r/2, width, thresh, dither[y&7]);
+    if (y_first >= y_end)
+        return;
+
+    memset(buffer, 0, (bstride*(r+1)+32)*sizeof(*buffer));
+    t = blur_window(y_first, height, r);
+    for (p = __MAX(t-r+1, 0); ; p++) {
+        uint16_t *buf0 = buf+(p%r)*bstride;
+        uint16_t *buf1 = buf+((p+r-1)%r)*bstride;
+        int x, v;
+        ctx->blur_line(dc, buf0, buf1, src+2*p*sstride, sstride, width/2);
+        if (p < t)
+            continue;
+        for (x=v=0; x<r; x++)
+            v += dc[x];
+        for (; x<width/2; x++) {
+            v += dc[x] - dc[x-r];
+            dc[x-r] = v * dc_factor >> 16;
         }
-        ctx->filter_line(dst+y*dstride, src+y*sstride, dc-r/2, width, thresh, dither[y&7]);
-        if (++y >= height) break;
-        ctx->filter_line(dst+y*dstride, src+y*sstride, dc-r/2, width, thresh, dither[y&7]);
-        if (++y >= height) break;
+        for (; x<(width+r+1)/2; x++)
+            dc[x-r] = v * dc_factor >> 16;
+        for (x=-r/2; x<0; x++)
+            dc[x] = dc[0];
+
+        for (y = y_first; y < y_end && blur_window(y, height, r) == p; y++)
+            ctx->filter_line(dst+y*dstride, src+y*sstride, dc-r/2, width, thresh, dither[y&7]);
+        if (y >= y_end)
+            break;
+        y_first = y;
+        t = blur_window(y, height, r);
     }
 }
 
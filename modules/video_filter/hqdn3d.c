@@ -37,6 +37,9 @@
 
 #include "hqdn3d.h"
 
+/* Lines above a band used to prime the vertical recursion of its slice */
+#define SLICE_OVERLAP 16
+
 /*****************************************************************************
  * Local protypes
  *****************************************************************************/
@@ -57,6 +60,11 @@ static int DenoiseCallback( vlc_object_t *p_this, char const *psz_var,
 #define CHROMA_SPAT_TEXT        N_("Spatial chroma strength (0-254)")
 #define LUMA_TEMP_TEXT          N_("Temporal luma strength (0-254)")
 #define CHROMA_TEMP_TEXT        N_("Temporal chroma strength (0-254)")
+#define SLICES_TEXT             N_("Slice threading")
+#define SLICES_LONGTEXT         N_("Denoise bands of the picture in " \
+    "parallel, using the \"filter-threads\" setting. The vertical " \
+    "recursion restarts near each band edge, so the output differs " \
+    "slightly from the single-threaded output.")
 
 vlc_module_begin()
     set_shortname(N_("HQ Denoiser 3D"))
@@ -73,6 +81,8 @@ vlc_module_begin()
             LUMA_TEMP_TEXT, LUMA_TEMP_TEXT, false)
     add_float_with_range(FILTER_PREFIX "chroma-temp", 4.5, 0.0, 254.0,
             CHROMA_TEMP_TEXT, CHROMA_TEMP_TEXT, false)
+    add_bool(FILTER_PREFIX "slices", false,
+            SLICES_TEXT, SLICES_LONGTEXT, true)
 
     add_shortcut("hqdn3d")
 
@@ -80,7 +90,7 @@ vlc_module_begin()
 vlc_module_end()
 
 static const char *const filter_options[] = {
-    "luma-spat", "chroma-spat", "luma-temp", "chroma-temp", NULL
+    "luma-spat", "chroma-spat", "luma-temp", "chroma-temp", "slices", NULL
 };
 
 /*****************************************************************************
@@ -92,6 +102,8 @@ struct filter_sys_t
     int w[3], h[3];
 
     struct vf_priv_s cfg;
+    filter_slices_t *slices;
+    int    wmax;
     bool   b_recalc_coefs;
     vlc_mutex_t coefs_mutex;
     float  luma_spat, luma_temp, chroma_spat, chroma_temp;
@@ -137,15 +149,21 @@ static int Open(vlc_object_t *this)
         if (sys->w[i] > wmax) wmax = sys->w[i];
         sys->h[i] = fmt_out->i_height * chroma->p[i].h.num / chroma->p[i].h.den;
     }
-    cfg->Line = malloc(wmax*sizeof(unsigned int));
+    config_ChainParse(filter, FILTER_PREFIX, filter_options,
+                      filter->p_cfg);
+
+    /* Slicing changes the output near the band edges: opt-in only */
+    if (var_InheritBool(filter, FILTER_PREFIX "slices"))
+        sys->slices = filter_NewSlices(filter);
+    /* One line of vertical state for each slice */
+    sys->wmax = wmax;
+    cfg->Line = malloc(filter_CountSlices(sys->slices) * wmax * sizeof(unsigned int));
     if (!cfg->Line) {
+        filter_DeleteSlices(sys->slices);
         free(sys);
         return VLC_ENOMEM;
     }
 
-    config_ChainParse(filter, FILTER_PREFIX, filter_options,
-                      filter->p_cfg);
-
 
     vlc_mutex_init( &sys->coefs_mutex );
     sys->b_recalc_coefs = true;
@@ -180,6 +198,7 @@ static void Close(vlc_object_t *this)
     var_DelCallback( filter, FILTER_PREFIX "chroma-temp", DenoiseCallback, sys );
 
     vlc_mutex_destroy( &sys->coefs_mutex );
+    filter_DeleteSlices(sys->slices);
 
     for (int i = 0; i < 3; ++i) {
         free(cfg->Frame[i]);
@@ -188,6 +207,49 @@ static void Close(vlc_object_t *this)
     free(sys);
 }
 
+/*****************************************************************************
+ * Slice: denoises a band of the three planes
+ *****************************************************************************
+ * The vertical recursion of a band starts SLICE_OVERLAP lines above it, so
+ * the lines next to a band edge may slightly differ from a single band.
+ *****************************************************************************/
+typedef struct
+{
+    filter_sys_t *sys;
+    picture_t    *src;
+    picture_t    *dst;
+} hqdn3d_job_t;
+
+static void Slice(void *data, unsigned index, unsigned count)
+{
+    const hqdn3d_job_t *job = data;
+    filter_sys_t *sys = job->sys;
+    struct vf_priv_s *cfg = &sys->cfg;
+    unsigned int *line = &cfg->Line[index * sys->wmax];
+
+    for (int i = 0; i < 3; ++i) {
+        const plane_t *srcp = &job->src->p[i];
+        plane_t       *dstp = &job->dst->p[i];
+        int *spat = cfg->Coefs[i == 0 ? 0 : 2];
+        int *temp = cfg->Coefs[i == 0 ? 1 : 3];
+        filter_slice_t slice;
+
+        filter_GetSlice(&slice, sys->h[i], index, count, 2, SLICE_OVERLAP);
+        if (!cfg->Frame[i]) {
+            picture_t src_band, dst_band;
+            filter_SlicePicture(&src_band, job->src, index, count, 4);
+            filter_SlicePicture(&dst_band, job->dst, index, count, 4);
+            plane_CopyPixels(&dst_band.p[i], &src_band.p[i]);
+            continue;
+        }
+        deNoise(srcp->p_pixels, dstp->p_pixels,
+                line, cfg->Frame[i], sys->w[i],
+                srcp->i_pitch, dstp->i_pitch,
+                spat, spat, temp,
+                slice.i_start, slice.i_first, slice.i_end);
+    }
+}
+
 /*****************************************************************************
  * Filter
  *****************************************************************************/
@@ -220,24 +282,14 @@ static picture_t *Filter(filter_t *filter, picture_t *src)
     }
     vlc_mutex_unlock( &sys->coefs_mutex );
 
-    deNoise(src->p[0].p_pixels, dst->p[0].p_pixels,
-            cfg->Line, &cfg->Frame[0], sys->w[0], sys->h[0],
-            src->p[0].i_pitch, dst->p[0].i_pitch,
-            cfg->Coefs[0],
-            cfg->Coefs[0],
-            cfg->Coefs[1]);
-    deNoise(src->p[1].p_pixels, dst->p[1].p_pixels,
-            cfg->Line, &cfg->Frame[1], sys->w[1], sys->h[1],
-            src->p[1].i_pitch, dst->p[1].i_pitch,
-            cfg->Coefs[2],
-            cfg->Coefs[2],
-            cfg->Coefs[3]);
-    deNoise(src->p[2].p_pixels, dst->p[2].p_pixels,
-            cfg->Line, &cfg->Frame[2], sys->w[2], sys->h[2],
-            src->p[2].i_pitch, dst->p[2].i_pitch,
-            cfg->Coefs[2],
-            cfg->Coefs[2],
-            cfg->Coefs[3]);
+    for (int i = 0; i < 3; ++i) {
+        if (!cfg->Frame[i])
+            cfg->Frame[i] = deNoiseInit(src->p[i].p_pixels, sys->w[i], sys->h[i],
+                                        src->p[i].i_pitch);
+    }
+
+    hqdn3d_job_t job = { .sys = sys, .src = src, .dst = dst };
+    filter_RunSlices(sys->slices, Slice, &job);
 
     return CopyInfoAndRelease(dst, src);
 }
@@ -68,34 +68,47 @@ static void deNoiseTemporal(
     }
 }
 
+/* The spatial filter is recursive: each line depends on all the lines above
+ * it. Lines YStart to YFirst - 1 are only used to prime the vertical
+ * recursion, lines YFirst to YEnd - 1 are written. */
 static void deNoiseSpacial(
                     unsigned char *Frame,        // mpi->planes[x]
                     unsigned char *FrameDest,    // dmpi->planes[x]
                     unsigned int *LineAnt,       // vf->priv->Line (width bytes)
-                    int W, int H, int sStride, int dStride,
-                    int *Horizontal, int *Vertical)
+                    int W, int sStride, int dStride,
+                    int *Horizontal, int *Vertical,
+                    int YStart, int YFirst, int YEnd)
 {
     long X, Y;
-    long sLineOffs = 0, dLineOffs = 0;
+    long sLineOffs = YStart * sStride, dLineOffs = YStart * dStride;
     unsigned int PixelAnt;
     unsigned int PixelDst;
 
     /* First pixel has no left nor top neighbor. */
-    PixelDst = LineAnt[0] = PixelAnt = Frame[0]<<16;
-    FrameDest[0]= ((PixelDst+0x10007FFF)>>16);
+    PixelDst = LineAnt[0] = PixelAnt = Frame[sLineOffs]<<16;
+    if (YStart >= YFirst)
+        FrameDest[dLineOffs]= ((PixelDst+0x10007FFF)>>16);
 
     /* First line has no top neighbor, only left. */
     for (X = 1; X < W; X++){
-        PixelDst = LineAnt[X] = LowPassMul(PixelAnt, Frame[X]<<16, Horizontal);
-        FrameDest[X]= ((PixelDst+0x10007FFF)>>16);
+        PixelDst = LineAnt[X] = LowPassMul(PixelAnt, Frame[sLineOffs+X]<<16, Horizontal);
+        if (YStart >= YFirst)
+            FrameDest[dLineOffs+X]= ((PixelDst+0x10007FFF)>>16);
     }
 
-    for (Y = 1; Y < H; Y++){
+    for (Y = YStart + 1; Y < YEnd; Y++){
         unsigned int PixelAnt;
         sLineOffs += sStride, dLineOffs += dStride;
         /* First pixel on each line doesn't have previous pixel */
         PixelAnt = Frame[sLineOffs]<<16;
         PixelDst = LineAnt[0] = LowPassMul(LineAnt[0], PixelAnt, Vertical);
+        if (Y < YFirst){
+            for (X = 1; X < W; X++){
+                PixelAnt = LowPassMul(PixelAnt, Frame[sLineOffs+X]<<16, Horizontal);
+                LineAnt[X] = LowPassMul(LineAnt[X], PixelAnt, Vertical);
+            }
+            continue;
+        }
         FrameDest[dLineOffs]= ((PixelDst+0x10007FFF)>>16);
 
         for (X = 1; X < W; X++){
@@ -108,58 +121,82 @@ static void deNoiseSpacial(
     }
 }
 
+/* Initializes the previous frame state from the first frame */
+static unsigned short *deNoiseInit(unsigned char *Frame, int W, int H, int sStride)
+{
+    long X, Y;
+    unsigned short* FrameAnt=malloc(W*H*sizeof(unsigned short));
+    if(!FrameAnt)
+        return NULL;
+    for (Y = 0; Y < H; Y++){
+        unsigned short* dst=&FrameAnt[Y*W];
+        unsigned char* src=Frame+Y*sStride;
+        for (X = 0; X < W; X++) dst[X]=src[X]<<8;
+    }
+    return FrameAnt;
+}
+
+/* Denoises the lines YFirst to YEnd - 1, the vertical recursion starting at
+ * line YStart (see deNoiseSpacial()). */
 static void deNoise(unsigned char *Frame,        // mpi->planes[x]
                     unsigned char *FrameDest,    // dmpi->planes[x]
                     unsigned int *LineAnt,      // vf->priv->Line (width bytes)
-                    unsigned short **FrameAntPtr,
-                    int W, int H, int sStride, int dStride,
-                    int *Horizontal, int *Vertical, int *Temporal)
+                    unsigned short *FrameAnt,
+                    int W, int sStride, int dStride,
+                    int *Horizontal, int *Vertical, int *Temporal,
+                    int YStart, int YFirst, int YEnd)
 {
     long X, Y;
-    long sLineOffs = 0, dLineOffs = 0;
+    long sLineOffs = YStart * sStride, dLineOffs = YStart * dStride;
     unsigned int PixelAnt;
     unsigned int PixelDst;
-    unsigned short* FrameAnt=(*FrameAntPtr);
-
-    if(!FrameAnt){
-        (*FrameAntPtr)=FrameAnt=malloc(W*H*sizeof(unsigned short));
-        for (Y = 0; Y < H; Y++){
-            unsigned short* dst=&FrameAnt[Y*W];
-            unsigned char* src=Frame+Y*sStride;
-            for (X = 0; X < W; X++) dst[X]=src[X]<<8;
-        }
-    }
+
+    if (YFirst >= YEnd)
+        return;
 
     if(!Horizontal[0] && !Vertical[0]){
-        deNoiseTemporal(Frame, FrameDest, FrameAnt,
-                        W, H, sStride, dStride, Temporal);
+        deNoiseTemporal(Frame + YFirst * sStride, FrameDest + YFirst * dStride,
+                        FrameAnt + YFirst * W,
+                        W, YEnd - YFirst, sStride, dStride, Temporal);
         return;
     }
     if(!Temporal[0]){
         deNoiseSpacial(Frame, FrameDest, LineAnt,
-                       W, H, sStride, dStride, Horizontal, Vertical);
+                       W, sStride, dStride, Horizontal, Vertical,
+                       YStart, YFirst, YEnd);
         return;
     }
 
-    /* First pixel has no left nor top neighbor. Only previous frame */
-    LineAnt[0] = PixelAnt = Frame[0]<<16;
-    PixelDst = LowPassMul(FrameAnt[0]<<8, PixelAnt, Temporal);
-    FrameAnt[0] = ((PixelDst+0x1000007F)>>8);
-    FrameDest[0]= ((PixelDst+0x10007FFF)>>16);
+    /* Prime the vertical recursion */
+    if (YStart < YFirst){
+        deNoiseSpacial(Frame, FrameDest, LineAnt,
+                       W, sStride, dStride, Horizontal, Vertical,
+                       YStart, YFirst, YFirst);
+        sLineOffs = YFirst * sStride, dLineOffs = YFirst * dStride;
+    }
+    else {
+        /* First pixel has no left nor top neighbor. Only previous frame */
+        unsigned short* LinePrev=&FrameAnt[YFirst*W];
+        LineAnt[0] = PixelAnt = Frame[sLineOffs]<<16;
+        PixelDst = LowPassMul(LinePrev[0]<<8, PixelAnt, Temporal);
+        LinePrev[0] = ((PixelDst+0x1000007F)>>8);
+        FrameDest[dLineOffs]= ((PixelDst+0x10007FFF)>>16);
 
-    /* First line has no top neighbor. Only left one for each pixel and
-     * last frame */
-    for (X = 1; X < W; X++){
-        LineAnt[X] = PixelAnt = LowPassMul(PixelAnt, Frame[X]<<16, Horizontal);
-        PixelDst = LowPassMul(FrameAnt[X]<<8, PixelAnt, Temporal);
-        FrameAnt[X] = ((PixelDst+0x1000007F)>>8);
-        FrameDest[X]= ((PixelDst+0x10007FFF)>>16);
+        /* First line has no top neighbor. Only left one for each pixel and
+         * last frame */
+        for (X = 1; X < W; X++){
+            LineAnt[X] = PixelAnt = LowPassMul(PixelAnt, Frame[sLineOffs+X]<<16, Horizontal);
+            PixelDst = LowPassMul(LinePrev[X]<<8, PixelAnt, Temporal);
+            LinePrev[X] = ((PixelDst+0x1000007F)>>8);
+            FrameDest[dLineOffs+X]= ((PixelDst+0x10007FFF)>>16);
+        }
+        YFirst++;
+        sLineOffs += sStride, dLineOffs += dStride;
     }
 
-    for (Y = 1; Y < H; Y++){
+    for (Y = YFirst; Y < YEnd; Y++){
         unsigned int PixelAnt;
         unsigned short* LinePrev=&FrameAnt[Y*W];
-        sLineOffs += sStride, dLineOffs += dStride;
         /* First pixel on each line doesn't have previous pixel */
         PixelAnt = Frame[sLineOffs]<<16;
         LineAnt[0] = LowPassMul(LineAnt[0], PixelAnt, Vertical);
@@ -176,6 +213,7 @@ static void deNoise(unsigned char *Frame,        // mpi->planes[x]
             LinePrev[X] = ((PixelDst+0x1000007F)>>8);
             FrameDest[dLineOffs+X]= ((PixelDst+0x10007FFF)>>16);
         }
+        sLineOffs += sStride, dLineOffs += dStride;
     }
 }
 
@@ -37,6 +37,7 @@
 
 #include <vlc_filter.h>
 #include <vlc_image.h>
+#include <vlc_cpu.h>
 
 #include "mosaic.h"
 
@@ -48,6 +49,8 @@
 static int  CreateFilter    ( vlc_object_t * );
 static void DestroyFilter   ( vlc_object_t * );
 static subpicture_t *Filter ( filter_t *, mtime_t );
+static int  CompositorNew   ( filter_t * );
+static void CompositorDelete( filter_t * );
 
 static int MosaicCallback   ( vlc_object_t *, char const *, vlc_value_t,
                               vlc_value_t, void * );
@@ -55,6 +58,8 @@ static int MosaicCallback   ( vlc_object_t *, char const *, vlc_value_t,
 /*****************************************************************************
  * filter_sys_t : filter descriptor
  *****************************************************************************/
+typedef struct mosaic_compositor_t mosaic_compositor_t;
+
 struct filter_sys_t
 {
     vlc_mutex_t lock;         /* Internal filter lock */
@@ -79,6 +84,8 @@ struct filter_sys_t
     int i_offsets_length;
 
     mtime_t i_delay;
+
+    mosaic_compositor_t *p_compositor; /* NULL unless in compositor mode */
 };
 
 /*****************************************************************************
@@ -157,6 +164,17 @@ struct filter_sys_t
         "according to this value (in milliseconds). For high " \
         "values you will need to raise caching at input.")
 
+#define COMPOSITOR_TEXT N_("Compositor mode")
+#define COMPOSITOR_LONGTEXT N_( \
+        "Resize the pictures on worker threads as soon as they are received " \
+        "and only redraw the elements which changed. Each element then " \
+        "shows its most recent picture." )
+
+#define THREADS_TEXT N_("Compositor threads")
+#define THREADS_LONGTEXT N_( \
+        "Number of threads resizing the pictures in compositor mode " \
+        "(0 for one per CPU)." )
+
 enum
 {
     position_auto = 0, position_fixed = 1, position_offsets = 2
@@ -223,13 +241,18 @@ vlc_module_begin ()
 
     add_integer( CFG_PREFIX "delay", 0, DELAY_TEXT, DELAY_LONGTEXT,
                  false )
+
+    add_bool( CFG_PREFIX "compositor", false,
+              COMPOSITOR_TEXT, COMPOSITOR_LONGTEXT, true )
+    add_integer( CFG_PREFIX "threads", 0,
+                 THREADS_TEXT, THREADS_LONGTEXT, true )
 vlc_module_end ()
 
 static const char *const ppsz_filter_options[] = {
     "alpha", "height", "width", "align", "xoffset", "yoffset",
     "borderw", "borderh", "position", "rows", "cols",
     "keep-aspect-ratio", "keep-picture", "order", "offsets",
-    "delay", NULL
+    "delay", "compositor", "threads", NULL
 };
 
 /*****************************************************************************
@@ -367,6 +390,11 @@ static int CreateFilter( vlc_object_t *p_this )
     free( psz_offsets );
     var_AddCallback( p_filter, CFG_PREFIX "offsets", MosaicCallback, p_sys );
 
+    p_sys->p_compositor = NULL;
+    if( var_CreateGetBool( p_filter, CFG_PREFIX "compositor" )
+     && CompositorNew( p_filter ) != VLC_SUCCESS )
+        msg_Warn( p_filter, "cannot start the compositor threads" );
+
     vlc_mutex_unlock( &p_sys->lock );
 
     return VLC_SUCCESS;
@@ -401,6 +429,9 @@ static void DestroyFilter( vlc_object_t *p_this )
     DEL_CB( order );
 #undef DEL_CB
 
+    if( p_sys->p_compositor )
+        CompositorDelete( p_filter );
+
     if( !p_sys->b_keep )
     {
         image_HandlerDelete( p_sys->p_image );
@@ -426,48 +457,13 @@ static void DestroyFilter( vlc_object_t *p_this )
 }
 
 /*****************************************************************************
- * Filter
+ * Layout
  *****************************************************************************/
-static subpicture_t *Filter( filter_t *p_filter, mtime_t date )
-{
-    filter_sys_t *p_sys = p_filter->p_sys;
-    bridge_t *p_bridge;
-
-    int i_index, i_real_index, i_row, i_col;
-    int i_greatest_real_index_used = p_sys->i_order_length - 1;
-
-    unsigned int col_inner_width, row_inner_height;
-
-    subpicture_region_t *p_region;
-    subpicture_region_t *p_region_prev = NULL;
-
-    /* Allocate the subpicture internal data. */
-    subpicture_t *p_spu = filter_NewSubpicture( p_filter );
-    if( !p_spu )
-        return NULL;
-
-    /* Initialize subpicture */
-    p_spu->i_channel = 0;
-    p_spu->i_start  = date;
-    p_spu->i_stop = 0;
-    p_spu->b_ephemer = true;
-    p_spu->i_alpha = p_sys->i_alpha;
-    p_spu->b_absolute = false;
-
-    p_spu->i_original_picture_width = p_sys->i_width;
-    p_spu->i_original_picture_height = p_sys->i_height;
-
-    vlc_mutex_lock( &p_sys->lock );
-    vlc_global_lock( VLC_MOSAIC_MUTEX );
-
-    p_bridge = GetBridge( p_filter );
-    if ( p_bridge == NULL )
-    {
-        vlc_global_unlock( VLC_MOSAIC_MUTEX );
-        vlc_mutex_unlock( &p_sys->lock );
-        return p_spu;
-    }
 
+/* Computes the number of rows and columns of the mosaic */
+static void mosaic_UpdateGrid( filter_t *p_filter, filter_sys_t *p_sys,
+                               const bridge_t *p_bridge )
+{
     if ( p_sys->i_position == position_offsets )
     {
         /* If we have either too much or not enough offsets, fall-back
@@ -486,7 +482,7 @@ static subpicture_t *Filter( filter_t *p_filter, mtime_t date )
     if ( p_sys->i_position == position_auto )
     {
         int i_numpics = p_sys->i_order_length; /* keep slots and all */
-        for ( i_index = 0; i_index < p_bridge->i_es_num; i_index++ )
+        for ( int i_index = 0; i_index < p_bridge->i_es_num; i_index++ )
         {
             bridged_es_t *p_es = p_bridge->pp_es[i_index];
             if ( !p_es->b_empty )
@@ -514,6 +510,1123 @@ static subpicture_t *Filter( filter_t *p_filter, mtime_t date )
                             i_numpics / p_sys->i_rows :
                             i_numpics / p_sys->i_rows + 1 );
     }
+}
+
+/* Returns the slot of a picture in the mosaic. *pi_real_index and
+ * *pi_greatest_real_index_used carry the state from one picture to the next
+ * and must be initialized to 0 and p_sys->i_order_length - 1 for each
+ * frame. */
+static int mosaic_GetRealIndex( const filter_sys_t *p_sys,
+                                const bridged_es_t *p_es, int *pi_real_index,
+                                int *pi_greatest_real_index_used )
+{
+    if ( p_sys->i_order_length == 0 )
+        return ++*pi_real_index;
+
+    for ( int i = 0; i < p_sys->i_order_length; i++ )
+    {
+        if ( strcmp( p_es->psz_id, p_sys->ppsz_order[i] ) == 0 )
+        {
+            *pi_real_index = i;
+            return i;
+        }
+    }
+    *pi_real_index = ++*pi_greatest_real_index_used;
+    return *pi_real_index;
+}
+
+/* Computes the size of a picture resized into its cell */
+static void mosaic_GetSize( const filter_sys_t *p_sys,
+                            unsigned i_in_width, unsigned i_in_height,
+                            unsigned col_inner_width,
+                            unsigned row_inner_height,
+                            unsigned *pi_width, unsigned *pi_height )
+{
+    *pi_width = col_inner_width;
+    *pi_height = row_inner_height;
+
+    if( p_sys->b_ar ) /* keep aspect ratio */
+    {
+        if( (float)*pi_width / (float)*pi_height
+              > (float)i_in_width / (float)i_in_height )
+        {
+            *pi_width = ( *pi_height * i_in_width ) / i_in_height;
+        }
+        else
+        {
+            *pi_height = ( *pi_width * i_in_height ) / i_in_width;
+        }
+    }
+}
+
+/* Computes the position of a picture of the given size in the mosaic */
+static void mosaic_GetPosition( const filter_sys_t *p_sys,
+                                const bridged_es_t *p_es, int i_real_index,
+                                unsigned col_inner_width,
+                                unsigned row_inner_height,
+                                unsigned i_width, unsigned i_height,
+                                int *pi_x, int *pi_y )
+{
+    const int i_row = ( i_real_index / p_sys->i_cols ) % p_sys->i_rows;
+    const int i_col = i_real_index % p_sys->i_cols ;
+
+    if( p_es->i_x >= 0 && p_es->i_y >= 0 )
+    {
+        *pi_x = p_es->i_x;
+        *pi_y = p_es->i_y;
+    }
+    else if( p_sys->i_position == position_offsets )
+    {
+        *pi_x = p_sys->pi_x_offsets[i_real_index];
+        *pi_y = p_sys->pi_y_offsets[i_real_index];
+    }
+    else
+    {
+        if( i_width > col_inner_width ||
+            p_sys->b_ar || p_sys->b_keep )
+        {
+            /* we don't have to center the video since it takes the
+            whole rectangle area or it's larger than the rectangle */
+            *pi_x = p_sys->i_xoffset
+                        + i_col * ( p_sys->i_width / p_sys->i_cols )
+                        + ( i_col * p_sys->i_borderw ) / p_sys->i_cols;
+        }
+        else
+        {
+            /* center the video in the dedicated rectangle */
+            *pi_x = p_sys->i_xoffset
+                    + i_col * ( p_sys->i_width / p_sys->i_cols )
+                    + ( i_col * p_sys->i_borderw ) / p_sys->i_cols
+                    + ( col_inner_width - i_width ) / 2;
+        }
+
+        if( i_height > row_inner_height
+            || p_sys->b_ar || p_sys->b_keep )
+        {
+            /* we don't have to center the video since it takes the
+            whole rectangle area or it's taller than the rectangle */
+            *pi_y = p_sys->i_yoffset
+                    + i_row * ( p_sys->i_height / p_sys->i_rows )
+                    + ( i_row * p_sys->i_borderh ) / p_sys->i_rows;
+        }
+        else
+        {
+            /* center the video in the dedicated rectangle */
+            *pi_y = p_sys->i_yoffset
+                    + i_row * ( p_sys->i_height / p_sys->i_rows )
+                    + ( i_row * p_sys->i_borderh ) / p_sys->i_rows
+                    + ( row_inner_height - i_height ) / 2;
+        }
+    }
+}
+
+/*****************************************************************************
+ * Compositor
+ *****************************************************************************
+ * In compositor mode, the pictures are taken from the bridge as soon as they
+ * are pushed and resized by a pool of worker threads. Filter() then only
+ * copies the tiles which received a new picture into a canvas kept from one
+ * call to the next, and hands the whole canvas over as a single region.
+ * The canvas covers the shown tiles, each of them drawn where its own
+ * region would be placed, whatever mosaic-align is.
+ * Each tile only shows the newest picture of its element: the older ones
+ * are counted as dropped, and mosaic-delay only delays the blanking of
+ * elements which stopped sending pictures.
+ *****************************************************************************/
+#define STATS_PERIOD INT64_C(5000000)
+
+typedef struct
+{
+    bridged_es_t *p_es;         /* Element the tile belongs to, or NULL */
+    char *psz_id;
+    unsigned i_generation;      /* Invalidates the scaling in progress */
+
+    /* Geometry, set by Filter() */
+    bool b_placed;
+    int i_x, i_y;               /* Position of its own region */
+    unsigned i_width, i_height; /* Size of the resized pictures */
+    int i_alpha;
+
+    /* Latest picture from the bridge, kept to be resized again when the
+     * geometry changes */
+    picture_t *p_source;
+    mtime_t i_arrival;
+    bool b_pending;             /* p_source still has to be resized */
+    bool b_busy;                /* A worker is resizing p_source */
+
+    picture_t *p_scaled;        /* Resized picture waiting to be drawn */
+    mtime_t i_scaled_arrival;
+    picture_t *p_shown;         /* Resized picture drawn on the canvas */
+
+    /* Statistics */
+    unsigned i_frames;
+    unsigned i_drops;
+    mtime_t i_latency_total;
+    mtime_t i_latency_max;
+} mosaic_tile_t;
+
+typedef struct
+{
+    picture_t *p_pic;
+    int i_x, i_y;               /* Position in the canvas */
+    int i_alpha;
+    bool b_blend;               /* Over what is drawn, else replaces it */
+} mosaic_blit_t;
+
+/* Extent of the shown tiles along one axis */
+typedef struct
+{
+    int i_lo, i_hi;             /* Smallest start and largest end */
+} mosaic_span_t;
+
+struct mosaic_compositor_t
+{
+    vlc_mutex_t lock;
+    vlc_cond_t wait;            /* Signaled when a tile needs a worker */
+    bool b_abort;
+
+    vlc_thread_t *p_threads;
+    int i_threads;
+
+    mosaic_tile_t *p_tiles;     /* Indexed like the bridge elements */
+    int i_tiles;
+    bool b_keep;
+
+    /* Only used by Filter() */
+    picture_t *p_canvas;
+    mosaic_span_t span_x, span_y; /* Tiles covered by the canvas */
+    int i_align;                /* Layout the canvas was drawn for */
+    int i_width, i_height;
+    mosaic_blit_t *p_blits;     /* Pictures to draw once the lock is released */
+    int i_blits_max;
+    bool b_redraw;
+    bool b_notified;
+    mtime_t i_stats_date;
+};
+
+/* Drops the content of a tile. It must be redrawn if it was shown. */
+static void mosaic_TileClear( mosaic_compositor_t *p_comp,
+                              mosaic_tile_t *p_tile )
+{
+    if( p_tile->p_shown )
+    {
+        picture_Release( p_tile->p_shown );
+        p_tile->p_shown = NULL;
+        p_comp->b_redraw = true;
+    }
+    if( p_tile->p_scaled )
+    {
+        picture_Release( p_tile->p_scaled );
+        p_tile->p_scaled = NULL;
+    }
+    if( p_tile->p_source )
+    {
+        picture_Release( p_tile->p_source );
+        p_tile->p_source = NULL;
+    }
+    p_tile->b_pending = false;
+    p_tile->b_placed = false;
+    p_tile->i_generation++;
+}
+
+static void mosaic_TileStats( filter_t *p_filter, const mosaic_tile_t *p_tile,
+                              int i_level )
+{
+    if( p_tile->psz_id == NULL || p_tile->i_frames + p_tile->i_drops == 0 )
+        return;
+
+    const char *psz_format = "tile %s: %u frames, %u dropped, latency "
+                             "%"PRId64" us average, %"PRId64" us max";
+    const mtime_t i_average = p_tile->i_frames ?
+        p_tile->i_latency_total / p_tile->i_frames : 0;
+    if( i_level == VLC_MSG_INFO )
+        msg_Info( p_filter, psz_format, p_tile->psz_id, p_tile->i_frames,
+                  p_tile->i_drops, i_average, p_tile->i_latency_max );
+    else
+        msg_Dbg( p_filter, psz_format, p_tile->psz_id, p_tile->i_frames,
+                 p_tile->i_drops, i_average, p_tile->i_latency_max );
+}
+
+/* Gives a tile to a new element */
+static void mosaic_TileReset( filter_t *p_filter, mosaic_compositor_t *p_comp,
+                              mosaic_tile_t *p_tile, bridged_es_t *p_es )
+{
+    mosaic_TileStats( p_filter, p_tile, VLC_MSG_DBG );
+    mosaic_TileClear( p_comp, p_tile );
+    free( p_tile->psz_id );
+
+    p_tile->p_es = p_es;
+    p_tile->psz_id = p_es && p_es->psz_id ? strdup( p_es->psz_id ) : NULL;
+    p_tile->i_frames = 0;
+    p_tile->i_drops = 0;
+    p_tile->i_latency_total = 0;
+    p_tile->i_latency_max = 0;
+}
+
+/**
+ * Moves the pictures queued in the bridge to the tiles and wakes the workers
+ * up. It is called with VLC_MOSAIC_MUTEX and the compositor lock held.
+ */
+static void mosaic_Collect( filter_t *p_filter, mosaic_compositor_t *p_comp,
+                            const bridge_t *p_bridge )
+{
+    const int i_es_num = p_bridge ? p_bridge->i_es_num : 0;
+
+    if( i_es_num > p_comp->i_tiles )
+    {
+        mosaic_tile_t *p_tiles = realloc( p_comp->p_tiles,
+                                          i_es_num * sizeof(*p_tiles) );
+        if( p_tiles == NULL )
+            return;
+        memset( &p_tiles[p_comp->i_tiles], 0,
+                ( i_es_num - p_comp->i_tiles ) * sizeof(*p_tiles) );
+        p_comp->p_tiles = p_tiles;
+        p_comp->i_tiles = i_es_num;
+    }
+
+    bool b_signal = false;
+    for( int i = 0; i < p_comp->i_tiles; i++ )
+    {
+        mosaic_tile_t *p_tile = &p_comp->p_tiles[i];
+        bridged_es_t *p_es = i < i_es_num ? p_bridge->pp_es[i] : NULL;
+
+        if( p_es != NULL && p_es->b_empty )
+            p_es = NULL;
+        if( p_tile->p_es != p_es )
+            mosaic_TileReset( p_filter, p_comp, p_tile, p_es );
+        if( p_es == NULL || p_es->p_picture == NULL )
+            continue;
+
+        /* Only the newest picture is worth resizing */
+        picture_t *p_pic = p_es->p_picture;
+        while( p_pic->p_next != NULL )
+        {
+            picture_t *p_next = p_pic->p_next;
+            picture_Release( p_pic );
+            p_tile->i_drops++;
+            p_pic = p_next;
+        }
+        p_es->p_picture = NULL;
+        p_es->pp_last = &p_es->p_picture;
+
+        if( p_tile->b_pending )
+            p_tile->i_drops++;
+        if( p_tile->p_source )
+            picture_Release( p_tile->p_source );
+        p_tile->p_source = p_pic;
+        p_tile->i_arrival = mdate();
+        p_tile->b_pending = true;
+        b_signal |= p_tile->b_placed;
+    }
+
+    if( b_signal )
+        vlc_cond_broadcast( &p_comp->wait );
+}
+
+/* Called by the bridge when a picture is pushed */
+static void mosaic_Notify( void *p_data, bridge_t *p_bridge )
+{
+    filter_t *p_filter = p_data;
+    mosaic_compositor_t *p_comp = p_filter->p_sys->p_compositor;
+
+    vlc_mutex_lock( &p_comp->lock );
+    mosaic_Collect( p_filter, p_comp, p_bridge );
+    vlc_mutex_unlock( &p_comp->lock );
+}
+
+/* Returns the placed tile waiting the longest for a worker, or -1 */
+static int mosaic_NextTile( const mosaic_compositor_t *p_comp )
+{
+    int i_next = -1;
+
+    for( int i = 0; i < p_comp->i_tiles; i++ )
+    {
+        const mosaic_tile_t *p_tile = &p_comp->p_tiles[i];
+        if( !p_tile->b_pending || p_tile->b_busy || !p_tile->b_placed )
+            continue;
+        if( i_next < 0 || p_tile->i_arrival < p_comp->p_tiles[i_next].i_arrival )
+            i_next = i;
+    }
+    return i_next;
+}
+
+/* Resizes a picture to the I420 or YUVA picture a tile shows */
+static picture_t *mosaic_Scale( image_handler_t *p_image, picture_t *p_pic,
+                                unsigned i_width, unsigned i_height,
+                                bool b_keep )
+{
+    video_format_t fmt_in, fmt_out;
+
+    memset( &fmt_in, 0, sizeof( video_format_t ) );
+    memset( &fmt_out, 0, sizeof( video_format_t ) );
+
+    fmt_in.i_chroma = p_pic->format.i_chroma;
+    fmt_in.i_width = p_pic->format.i_width;
+    fmt_in.i_height = p_pic->format.i_height;
+
+    if( fmt_in.i_chroma == VLC_CODEC_YUVA ||
+        fmt_in.i_chroma == VLC_CODEC_RGBA )
+        fmt_out.i_chroma = VLC_CODEC_YUVA;
+    else
+        fmt_out.i_chroma = VLC_CODEC_I420;
+
+    if( b_keep )
+    {
+        if( fmt_in.i_chroma == fmt_out.i_chroma )
+            return picture_Hold( p_pic );
+        i_width = fmt_in.i_width;
+        i_height = fmt_in.i_height;
+    }
+
+    fmt_out.i_width = fmt_out.i_visible_width = i_width;
+    fmt_out.i_height = fmt_out.i_visible_height = i_height;
+
+    return image_Convert( p_image, p_pic, &fmt_in, &fmt_out );
+}
+
+static void *mosaic_Worker( void *p_data )
+{
+    filter_t *p_filter = p_data;
+    mosaic_compositor_t *p_comp = p_filter->p_sys->p_compositor;
+    image_handler_t *p_image = image_HandlerCreate( p_filter );
+    int canc = vlc_savecancel();
+
+    vlc_mutex_lock( &p_comp->lock );
+    for( ;; )
+    {
+        int i_tile;
+        while( !p_comp->b_abort && ( i_tile = mosaic_NextTile( p_comp ) ) < 0 )
+            vlc_cond_wait( &p_comp->wait, &p_comp->lock );
+        if( p_comp->b_abort )
+            break;
+
+        mosaic_tile_t *p_tile = &p_comp->p_tiles[i_tile];
+        picture_t *p_source = picture_Hold( p_tile->p_source );
+        const unsigned i_generation = p_tile->i_generation;
+        const unsigned i_width = p_tile->i_width;
+        const unsigned i_height = p_tile->i_height;
+        const mtime_t i_arrival = p_tile->i_arrival;
+        const bool b_keep = p_comp->b_keep;
+        p_tile->b_pending = false;
+        p_tile->b_busy = true;
+        vlc_mutex_unlock( &p_comp->lock );
+
+        picture_t *p_scaled = NULL;
+        if( p_image )
+            p_scaled = mosaic_Scale( p_image, p_source, i_width, i_height,
+                                     b_keep );
+        picture_Release( p_source );
+        if( p_scaled == NULL )
+            msg_Warn( p_filter, "image resizing and chroma conversion failed" );
+
+        vlc_mutex_lock( &p_comp->lock );
+        /* The tiles may have been reallocated in the meantime */
+        p_tile = &p_comp->p_tiles[i_tile];
+        p_tile->b_busy = false;
+        if( p_scaled != NULL && p_tile->i_generation == i_generation )
+        {
+            if( p_tile->p_scaled )
+            {
+                picture_Release( p_tile->p_scaled );
+                p_tile->i_drops++;
+            }
+            p_tile->p_scaled = p_scaled;
+            p_tile->i_scaled_arrival = i_arrival;
+        }
+        else if( p_scaled != NULL )
+            picture_Release( p_scaled );
+    }
+    vlc_mutex_unlock( &p_comp->lock );
+
+    if( p_image )
+        image_HandlerDelete( p_image );
+    vlc_restorecancel( canc );
+    return NULL;
+}
+
+/* Makes the whole canvas transparent */
+static void mosaic_CanvasClear( picture_t *p_canvas )
+{
+    plane_t *p = &p_canvas->p[A_PLANE];
+    for( int y = 0; y < p->i_lines; y++ )
+        memset( &p->p_pixels[y * p->i_pitch], 0, p->i_pitch );
+}
+
+/* Blends one row of an I420 or YUVA picture over the canvas row p_dst */
+static void mosaic_BlendRow( uint8_t *p_dst[4], const picture_t *p_pic,
+                             int sy, int i_src_x, int i_width, int i_alpha )
+{
+    const bool b_alpha = p_pic->format.i_chroma == VLC_CODEC_YUVA;
+    const int i_chroma_y = b_alpha ? sy : sy / 2;
+    const uint8_t *p_src[4];
+
+    for( int i_plane = 0; i_plane < (b_alpha ? 4 : 3); i_plane++ )
+        p_src[i_plane] = &p_pic->p[i_plane].p_pixels[
+            ( i_plane == Y_PLANE || i_plane == A_PLANE ? sy : i_chroma_y )
+            * p_pic->p[i_plane].i_pitch];
+
+    for( int x = 0; x < i_width; x++ )
+    {
+        const int sx = i_src_x + x;
+        const int i_cx = b_alpha ? sx : sx / 2;
+        const int a = b_alpha ? p_src[A_PLANE][sx] * i_alpha / 255 : i_alpha;
+        if( a == 0 )
+            continue;
+
+        /* Non premultiplied "over" operator */
+        const int t = p_dst[A_PLANE][x] * ( 255 - a ) / 255;
+        const int oa = a + t;
+        p_dst[Y_PLANE][x] = ( p_src[Y_PLANE][sx] * a + p_dst[Y_PLANE][x] * t
+                              + oa / 2 ) / oa;
+        p_dst[U_PLANE][x] = ( p_src[U_PLANE][i_cx] * a + p_dst[U_PLANE][x] * t
+                              + oa / 2 ) / oa;
+        p_dst[V_PLANE][x] = ( p_src[V_PLANE][i_cx] * a + p_dst[V_PLANE][x] * t
+                              + oa / 2 ) / oa;
+        p_dst[A_PLANE][x] = oa;
+    }
+}
+
+/**
+ * Draws an I420 or YUVA picture onto the YUVA canvas, multiplying its alpha
+ * by i_alpha. It is blended over what the canvas shows if b_blend is set,
+ * else it replaces it.
+ */
+static void mosaic_CanvasBlit( picture_t *p_canvas, const picture_t *p_pic,
+                               int i_x, int i_y, int i_alpha, bool b_blend )
+{
+    const bool b_alpha = p_pic->format.i_chroma == VLC_CODEC_YUVA;
+    int i_width = p_pic->format.i_visible_width;
+    int i_height = p_pic->format.i_visible_height;
+    int i_src_x = 0, i_src_y = 0;
+
+    /* Clip to the canvas */
+    if( i_x < 0 )
+    {
+        i_src_x = -i_x;
+        i_width += i_x;
+        i_x = 0;
+    }
+    if( i_y < 0 )
+    {
+        i_src_y = -i_y;
+        i_height += i_y;
+        i_y = 0;
+    }
+    i_width = __MIN( i_width, (int)p_canvas->format.i_visible_width - i_x );
+    i_height = __MIN( i_height, (int)p_canvas->format.i_visible_height - i_y );
+    if( i_width <= 0 || i_height <= 0 )
+        return;
+
+    for( int y = 0; y < i_height; y++ )
+    {
+        const int sy = i_src_y + y;
+        uint8_t *p_dst[4];
+        for( int i_plane = 0; i_plane < 4; i_plane++ )
+            p_dst[i_plane] = &p_canvas->p[i_plane].p_pixels[
+                (i_y + y) * p_canvas->p[i_plane].i_pitch + i_x];
+
+        if( b_blend )
+        {
+            mosaic_BlendRow( p_dst, p_pic, sy, i_src_x, i_width, i_alpha );
+            continue;
+        }
+
+        memcpy( p_dst[Y_PLANE],
+                &p_pic->p[Y_PLANE].p_pixels[sy * p_pic->p[Y_PLANE].i_pitch
+                                            + i_src_x], i_width );
+        if( b_alpha )
+        {
+            for( int i_plane = U_PLANE; i_plane <= V_PLANE; i_plane++ )
+                memcpy( p_dst[i_plane],
+                        &p_pic->p[i_plane].p_pixels[
+                            sy * p_pic->p[i_plane].i_pitch + i_src_x],
+                        i_width );
+
+            const uint8_t *p_a = &p_pic->p[A_PLANE].p_pixels[
+                sy * p_pic->p[A_PLANE].i_pitch + i_src_x];
+            if( i_alpha == 255 )
+                memcpy( p_dst[A_PLANE], p_a, i_width );
+            else
+                for( int x = 0; x < i_width; x++ )
+                    p_dst[A_PLANE][x] = p_a[x] * i_alpha / 255;
+        }
+        else
+        {
+            /* 4:2:0 chroma is duplicated to 4:4:4 */
+            for( int i_plane = U_PLANE; i_plane <= V_PLANE; i_plane++ )
+            {
+                const uint8_t *p_src = &p_pic->p[i_plane].p_pixels[
+                    sy / 2 * p_pic->p[i_plane].i_pitch];
+                for( int x = 0; x < i_width; x++ )
+                    p_dst[i_plane][x] = p_src[( i_src_x + x ) / 2];
+            }
+            memset( p_dst[A_PLANE], i_alpha, i_width );
+        }
+    }
+}
+
+/**
+ * Places the tiles in the mosaic. It is called with VLC_MOSAIC_MUTEX and
+ * the compositor lock held.
+ */
+static void mosaic_Place( filter_t *p_filter, mosaic_compositor_t *p_comp )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+    const mtime_t i_now = mdate();
+    int i_real_index = 0;
+    int i_greatest_real_index_used = p_sys->i_order_length - 1;
+    bool b_signal = false;
+
+    const unsigned col_inner_width =
+        ( ( p_sys->i_width - ( p_sys->i_cols - 1 ) * p_sys->i_borderw )
+          / p_sys->i_cols );
+    const unsigned row_inner_height =
+        ( ( p_sys->i_height - ( p_sys->i_rows - 1 ) * p_sys->i_borderh )
+          / p_sys->i_rows );
+
+    for( int i = 0; i < p_comp->i_tiles; i++ )
+    {
+        mosaic_tile_t *p_tile = &p_comp->p_tiles[i];
+        if( p_tile->p_es == NULL || p_tile->p_source == NULL )
+            continue;
+
+        if( p_tile->i_arrival + p_sys->i_delay + BLANK_DELAY < i_now )
+        {
+            /* Display blank */
+            mosaic_TileClear( p_comp, p_tile );
+            continue;
+        }
+
+        const video_format_t *p_fmt = &p_tile->p_source->format;
+        const int i_slot = mosaic_GetRealIndex( p_sys, p_tile->p_es,
+                                                &i_real_index,
+                                                &i_greatest_real_index_used );
+        unsigned i_width, i_height;
+        int i_x, i_y;
+
+        if( p_sys->b_keep )
+        {
+            i_width = p_fmt->i_width;
+            i_height = p_fmt->i_height;
+        }
+        else
+            mosaic_GetSize( p_sys, p_fmt->i_width, p_fmt->i_height,
+                            col_inner_width, row_inner_height,
+                            &i_width, &i_height );
+        mosaic_GetPosition( p_sys, p_tile->p_es, i_slot,
+                            col_inner_width, row_inner_height,
+                            i_width, i_height, &i_x, &i_y );
+        if( p_tile->b_placed && p_tile->i_width == i_width &&
+            p_tile->i_height == i_height && p_comp->b_keep == p_sys->b_keep )
+        {
+            if( p_tile->i_x != i_x || p_tile->i_y != i_y ||
+                p_tile->i_alpha != p_tile->p_es->i_alpha )
+                p_comp->b_redraw = true;
+        }
+        else
+        {
+            /* Resize the last picture again */
+            if( p_tile->p_scaled )
+            {
+                picture_Release( p_tile->p_scaled );
+                p_tile->p_scaled = NULL;
+            }
+            if( p_tile->p_shown )
+                p_comp->b_redraw = true;
+            p_tile->i_generation++;
+            p_tile->b_pending = true;
+            p_tile->b_placed = true;
+            b_signal = true;
+        }
+        p_tile->i_x = i_x;
+        p_tile->i_y = i_y;
+        p_tile->i_width = i_width;
+        p_tile->i_height = i_height;
+        p_tile->i_alpha = p_tile->p_es->i_alpha;
+    }
+    p_comp->b_keep = p_sys->b_keep;
+
+    if( b_signal )
+        vlc_cond_broadcast( &p_comp->wait );
+}
+
+/*
+ * Position along an axis of the region a tile would have on its own, as the
+ * SPU renderer places it for the alignment and keeps it inside the mosaic.
+ * The canvas puts each tile there, so that the layout does not depend on
+ * the mode.
+ */
+static int mosaic_AxisPlace( bool b_start, bool b_end, int i_total,
+                             int i_pos, int i_size )
+{
+    int i;
+    if( b_start )
+        i = i_pos;
+    else if( b_end )
+        i = i_total - i_size - i_pos;
+    else
+        i = i_total / 2 - i_size / 2;
+    if( i + i_size > i_total )
+        i = i_total - i_size;
+    return __MAX( i, 0 );
+}
+
+static void mosaic_RegionPlace( const mosaic_compositor_t *p_comp,
+                                const mosaic_tile_t *p_tile,
+                                int *pi_x, int *pi_y )
+{
+    *pi_x = mosaic_AxisPlace( p_comp->i_align & SUBPICTURE_ALIGN_LEFT,
+                              p_comp->i_align & SUBPICTURE_ALIGN_RIGHT,
+                              p_comp->i_width, p_tile->i_x, p_tile->i_width );
+    *pi_y = mosaic_AxisPlace( p_comp->i_align & SUBPICTURE_ALIGN_TOP,
+                              p_comp->i_align & SUBPICTURE_ALIGN_BOTTOM,
+                              p_comp->i_height, p_tile->i_y, p_tile->i_height );
+}
+
+static void mosaic_SpanAdd( mosaic_span_t *p_span, int i_pos, int i_size )
+{
+    p_span->i_lo = __MIN( p_span->i_lo, i_pos );
+    p_span->i_hi = __MAX( p_span->i_hi, i_pos + i_size );
+}
+
+static bool mosaic_SpanEqual( const mosaic_span_t *p_a,
+                              const mosaic_span_t *p_b )
+{
+    return p_a->i_lo == p_b->i_lo && p_a->i_hi == p_b->i_hi;
+}
+
+/* Tells if the shown picture of a tile still has the size of the tile */
+static bool mosaic_TileFits( const mosaic_tile_t *p_tile )
+{
+    return p_tile->p_shown != NULL &&
+           p_tile->p_shown->format.i_visible_width == p_tile->i_width &&
+           p_tile->p_shown->format.i_visible_height == p_tile->i_height;
+}
+
+/* Tells if the canvas has the given size, no canvas counting as empty */
+static bool mosaic_CanvasFits( const mosaic_compositor_t *p_comp,
+                               int i_width, int i_height )
+{
+    if( p_comp->p_canvas == NULL )
+        return i_width <= 0 || i_height <= 0;
+    return (int)p_comp->p_canvas->format.i_width == i_width &&
+           (int)p_comp->p_canvas->format.i_height == i_height;
+}
+
+/* Makes sure the canvas has the given size and can be drawn on. A canvas
+ * of another size is replaced by a blank one, which mosaic_Prepare()
+ * already planned to redraw. A canvas still held by the subpicture of the
+ * previous call is replaced by a copy. */
+static void mosaic_CanvasUpdate( mosaic_compositor_t *p_comp,
+                                 int i_width, int i_height )
+{
+    picture_t *p_old = p_comp->p_canvas;
+    const bool b_resized = !mosaic_CanvasFits( p_comp, i_width, i_height );
+
+    if( !b_resized && ( p_old == NULL || !picture_IsReferenced( p_old ) ) )
+        return;
+
+    p_comp->p_canvas = NULL;
+    if( i_width > 0 && i_height > 0 )
+    {
+        video_format_t fmt;
+        memset( &fmt, 0, sizeof( fmt ) );
+        video_format_Setup( &fmt, VLC_CODEC_YUVA,
+                            i_width, i_height, i_width, i_height, 1, 1 );
+        p_comp->p_canvas = picture_NewFromFormat( &fmt );
+    }
+    if( p_old != NULL )
+    {
+        if( p_comp->p_canvas != NULL && !b_resized )
+            picture_Copy( p_comp->p_canvas, p_old );
+        picture_Release( p_old );
+    }
+}
+
+/* Tells if two placed tiles cover a common part of the mosaic */
+static bool mosaic_TilesOverlap( const mosaic_compositor_t *p_comp,
+                                 const mosaic_tile_t *p_a,
+                                 const mosaic_tile_t *p_b )
+{
+    int i_ax, i_ay, i_bx, i_by;
+
+    mosaic_RegionPlace( p_comp, p_a, &i_ax, &i_ay );
+    mosaic_RegionPlace( p_comp, p_b, &i_bx, &i_by );
+    return i_ax < i_bx + (int)p_b->i_width && i_bx < i_ax + (int)p_a->i_width
+        && i_ay < i_by + (int)p_b->i_height && i_by < i_ay + (int)p_a->i_height;
+}
+
+/* Tells if a tile with a new picture overlaps another shown tile, so that
+ * it cannot be drawn alone without breaking the stacking order */
+static bool mosaic_DirtyOverlaps( const mosaic_compositor_t *p_comp )
+{
+    for( int i = 0; i < p_comp->i_tiles; i++ )
+    {
+        const mosaic_tile_t *p_tile = &p_comp->p_tiles[i];
+        if( p_tile->p_scaled == NULL || !p_tile->b_placed )
+            continue;
+
+        for( int j = 0; j < p_comp->i_tiles; j++ )
+        {
+            const mosaic_tile_t *p_other = &p_comp->p_tiles[j];
+            if( j != i && p_other->b_placed &&
+                ( p_other->p_shown != NULL || p_other->p_scaled != NULL ) &&
+                mosaic_TilesOverlap( p_comp, p_tile, p_other ) )
+                return true;
+        }
+    }
+    return false;
+}
+
+/* Queues a picture to be drawn on the canvas */
+static void mosaic_QueueBlit( mosaic_compositor_t *p_comp, int *pi_blits,
+                              picture_t *p_pic, const mosaic_tile_t *p_tile,
+                              bool b_blend )
+{
+    mosaic_blit_t *p_blit = &p_comp->p_blits[(*pi_blits)++];
+    int i_x, i_y;
+
+    mosaic_RegionPlace( p_comp, p_tile, &i_x, &i_y );
+    p_blit->p_pic = picture_Hold( p_pic );
+    p_blit->i_x = i_x - p_comp->span_x.i_lo;
+    p_blit->i_y = i_y - p_comp->span_y.i_lo;
+    p_blit->i_alpha = p_tile->i_alpha;
+    p_blit->b_blend = b_blend;
+}
+
+/**
+ * Picks the tiles which changed and queues their pictures in p_blits, so
+ * that they can be drawn without the compositor lock. It is called with
+ * the compositor lock held. It also lays the canvas out for the tiles to
+ * show. Returns the number of pictures queued, or -1 if nothing can be
+ * drawn, and sets *pb_clear if the canvas has to be cleared first and
+ * *pi_shown to the number of tiles shown.
+ */
+static int mosaic_Prepare( filter_t *p_filter, mosaic_compositor_t *p_comp,
+                           bool *pb_clear, int *pi_shown )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+    const mtime_t i_now = mdate();
+    int i_blits = 0;
+
+    *pb_clear = false;
+    *pi_shown = 0;
+
+    /* The canvas covers the tiles which will be shown */
+    if( p_sys->i_align != p_comp->i_align ||
+        p_sys->i_width != p_comp->i_width ||
+        p_sys->i_height != p_comp->i_height )
+    {
+        p_comp->i_align = p_sys->i_align;
+        p_comp->i_width = p_sys->i_width;
+        p_comp->i_height = p_sys->i_height;
+        p_comp->b_redraw = true;
+    }
+
+    mosaic_span_t span_x = { INT_MAX, INT_MIN };
+    mosaic_span_t span_y = { INT_MAX, INT_MIN };
+    for( int i = 0; i < p_comp->i_tiles; i++ )
+    {
+        const mosaic_tile_t *p_tile = &p_comp->p_tiles[i];
+        if( !p_tile->b_placed ||
+            ( p_tile->p_scaled == NULL && !mosaic_TileFits( p_tile ) ) )
+            continue;
+        int i_x, i_y;
+        mosaic_RegionPlace( p_comp, p_tile, &i_x, &i_y );
+        mosaic_SpanAdd( &span_x, i_x, p_tile->i_width );
+        mosaic_SpanAdd( &span_y, i_y, p_tile->i_height );
+    }
+    if( span_x.i_lo > span_x.i_hi )
+        span_x = span_y = (mosaic_span_t){ 0, 0 };
+
+    if( !mosaic_SpanEqual( &span_x, &p_comp->span_x ) ||
+        !mosaic_SpanEqual( &span_y, &p_comp->span_y ) )
+    {
+        p_comp->span_x = span_x;
+        p_comp->span_y = span_y;
+        p_comp->b_redraw = true;
+    }
+    if( !mosaic_CanvasFits( p_comp, span_x.i_hi - span_x.i_lo,
+                            span_y.i_hi - span_y.i_lo ) )
+        p_comp->b_redraw = true;
+
+    /* Each tile is queued at most once */
+    if( p_comp->i_tiles > p_comp->i_blits_max )
+    {
+        mosaic_blit_t *p_blits = realloc( p_comp->p_blits,
+                                          p_comp->i_tiles * sizeof(*p_blits) );
+        if( p_blits == NULL )
+            return -1;
+        p_comp->p_blits = p_blits;
+        p_comp->i_blits_max = p_comp->i_tiles;
+    }
+
+    /* A tile stacked with others is drawn again with all of them */
+    if( !p_comp->b_redraw && mosaic_DirtyOverlaps( p_comp ) )
+        p_comp->b_redraw = true;
+
+    const bool b_redraw = p_comp->b_redraw;
+    if( b_redraw )
+    {
+        *pb_clear = true;
+        for( int i = 0; i < p_comp->i_tiles; i++ )
+        {
+            mosaic_tile_t *p_tile = &p_comp->p_tiles[i];
+            if( p_tile->p_shown == NULL || p_tile->p_scaled != NULL )
+                continue;
+            if( !p_tile->b_placed || !mosaic_TileFits( p_tile ) )
+            {
+                /* Wait for the picture at its new size */
+                picture_Release( p_tile->p_shown );
+                p_tile->p_shown = NULL;
+            }
+        }
+        p_comp->b_redraw = false;
+    }
+
+    /* In the order of the elements, which is the stacking order of the
+     * classic regions. On a cleared canvas, every tile is blended over the
+     * previous ones; otherwise the dirty tiles overlap nothing shown and
+     * replace their own area. */
+    for( int i = 0; i < p_comp->i_tiles; i++ )
+    {
+        mosaic_tile_t *p_tile = &p_comp->p_tiles[i];
+        if( p_tile->p_scaled != NULL && p_tile->b_placed )
+        {
+            mosaic_QueueBlit( p_comp, &i_blits, p_tile->p_scaled, p_tile,
+                              b_redraw );
+            if( p_tile->p_shown )
+                picture_Release( p_tile->p_shown );
+            p_tile->p_shown = p_tile->p_scaled;
+            p_tile->p_scaled = NULL;
+
+            const mtime_t i_latency = i_now - p_tile->i_scaled_arrival;
+            p_tile->i_frames++;
+            p_tile->i_latency_total += i_latency;
+            p_tile->i_latency_max = __MAX( p_tile->i_latency_max, i_latency );
+        }
+        else if( b_redraw && p_tile->p_shown != NULL && p_tile->p_scaled == NULL )
+            mosaic_QueueBlit( p_comp, &i_blits, p_tile->p_shown, p_tile, true );
+        if( p_tile->p_shown )
+            (*pi_shown)++;
+    }
+
+    if( p_comp->i_stats_date + STATS_PERIOD < i_now )
+    {
+        for( int i = 0; i < p_comp->i_tiles; i++ )
+            mosaic_TileStats( p_filter, &p_comp->p_tiles[i], VLC_MSG_DBG );
+        p_comp->i_stats_date = i_now;
+    }
+    return i_blits;
+}
+
+static subpicture_t *CompositorFilter( filter_t *p_filter,
+                                       subpicture_t *p_spu )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+    mosaic_compositor_t *p_comp = p_sys->p_compositor;
+
+    vlc_mutex_lock( &p_sys->lock );
+    vlc_global_lock( VLC_MOSAIC_MUTEX );
+
+    bridge_t *p_bridge = GetBridge( p_filter );
+    if( p_bridge != NULL )
+    {
+        if( p_bridge->pf_notify == NULL )
+        {
+            p_bridge->pf_notify = mosaic_Notify;
+            p_bridge->p_notify_data = p_filter;
+        }
+        else if( p_bridge->p_notify_data != p_filter && !p_comp->b_notified )
+            msg_Warn( p_filter, "another mosaic is notified by the bridge, "
+                      "pictures will only be resized after being displayed" );
+        p_comp->b_notified = true;
+        mosaic_UpdateGrid( p_filter, p_sys, p_bridge );
+    }
+
+    vlc_mutex_lock( &p_comp->lock );
+    mosaic_Collect( p_filter, p_comp, p_bridge );
+    mosaic_Place( p_filter, p_comp );
+    vlc_global_unlock( VLC_MOSAIC_MUTEX );
+
+    bool b_clear;
+    int i_shown;
+    const int i_blits = mosaic_Prepare( p_filter, p_comp, &b_clear, &i_shown );
+    vlc_mutex_unlock( &p_comp->lock );
+
+    /* The canvas is only touched from here, so the decoders and the workers
+     * can push new pictures while it is drawn. */
+    mosaic_CanvasUpdate( p_comp, p_comp->span_x.i_hi - p_comp->span_x.i_lo,
+                         p_comp->span_y.i_hi - p_comp->span_y.i_lo );
+    if( b_clear && p_comp->p_canvas )
+        mosaic_CanvasClear( p_comp->p_canvas );
+    for( int i = 0; i < i_blits; i++ )
+    {
+        mosaic_blit_t *p_blit = &p_comp->p_blits[i];
+        if( p_comp->p_canvas )
+            mosaic_CanvasBlit( p_comp->p_canvas, p_blit->p_pic,
+                               p_blit->i_x, p_blit->i_y, p_blit->i_alpha,
+                               p_blit->b_blend );
+        picture_Release( p_blit->p_pic );
+    }
+
+    if( i_shown > 0 && p_comp->p_canvas )
+    {
+        /* The canvas is shared with the region instead of being copied;
+         * the next call draws on a copy if the region still holds it. */
+        video_format_t fmt = p_comp->p_canvas->format;
+        fmt.i_chroma = VLC_CODEC_TEXT;
+        subpicture_region_t *p_region = subpicture_region_New( &fmt );
+        if( p_region != NULL )
+        {
+            p_region->fmt.i_chroma = VLC_CODEC_YUVA;
+            p_region->p_picture = picture_Hold( p_comp->p_canvas );
+            p_region->i_x = p_comp->span_x.i_lo;
+            p_region->i_y = p_comp->span_y.i_lo;
+            p_region->i_align = SUBPICTURE_ALIGN_LEFT | SUBPICTURE_ALIGN_TOP;
+            p_spu->p_region = p_region;
+        }
+        else
+            msg_Err( p_filter, "cannot allocate SPU region" );
+    }
+
+    vlc_mutex_unlock( &p_sys->lock );
+    return p_spu;
+}
+
+static int CompositorNew( filter_t *p_filter )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+
+    int i_threads = var_CreateGetInteger( p_filter, CFG_PREFIX "threads" );
+    if( i_threads <= 0 )
+        i_threads = vlc_GetCPUCount();
+
+    mosaic_compositor_t *p_comp = calloc( 1, sizeof( *p_comp ) );
+    if( p_comp == NULL )
+        return VLC_ENOMEM;
+    p_comp->p_threads = calloc( i_threads, sizeof( *p_comp->p_threads ) );
+    if( p_comp->p_threads == NULL )
+    {
+        free( p_comp );
+        return VLC_ENOMEM;
+    }
+
+    vlc_mutex_init( &p_comp->lock );
+    vlc_cond_init( &p_comp->wait );
+    p_comp->b_abort = false;
+    p_comp->b_keep = p_sys->b_keep;
+    p_comp->i_stats_date = mdate();
+    p_sys->p_compositor = p_comp;
+
+    for( ; p_comp->i_threads < i_threads; p_comp->i_threads++ )
+    {
+        if( vlc_clone( &p_comp->p_threads[p_comp->i_threads], mosaic_Worker,
+                       p_filter, VLC_THREAD_PRIORITY_VIDEO ) )
+            break;
+    }
+    if( p_comp->i_threads == 0 )
+    {
+        vlc_cond_destroy( &p_comp->wait );
+        vlc_mutex_destroy( &p_comp->lock );
+        free( p_comp->p_threads );
+        free( p_comp );
+        p_sys->p_compositor = NULL;
+        return VLC_EGENERIC;
+    }
+
+    msg_Dbg( p_filter, "compositor mode with %d worker threads",
+             p_comp->i_threads );
+    return VLC_SUCCESS;
+}
+
+static void CompositorDelete( filter_t *p_filter )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+    mosaic_compositor_t *p_comp = p_sys->p_compositor;
+
+    vlc_global_lock( VLC_MOSAIC_MUTEX );
+    bridge_t *p_bridge = GetBridge( p_filter );
+    if( p_bridge != NULL && p_bridge->p_notify_data == p_filter )
+    {
+        p_bridge->pf_notify = NULL;
+        p_bridge->p_notify_data = NULL;
+    }
+    vlc_global_unlock( VLC_MOSAIC_MUTEX );
+
+    vlc_mutex_lock( &p_comp->lock );
+    p_comp->b_abort = true;
+    vlc_cond_broadcast( &p_comp->wait );
+    vlc_mutex_unlock( &p_comp->lock );
+
+    for( int i = 0; i < p_comp->i_threads; i++ )
+        vlc_join( p_comp->p_threads[i], NULL );
+
+    for( int i = 0; i < p_comp->i_tiles; i++ )
+    {
+        mosaic_tile_t *p_tile = &p_comp->p_tiles[i];
+        mosaic_TileStats( p_filter, p_tile, VLC_MSG_INFO );
+        mosaic_TileClear( p_comp, p_tile );
+        free( p_tile->psz_id );
+    }
+    if( p_comp->p_canvas )
+        picture_Release( p_comp->p_canvas );
+    free( p_comp->p_blits );
+
+    vlc_cond_destroy( &p_comp->wait );
+    vlc_mutex_destroy( &p_comp->lock );
+    free( p_comp->p_tiles );
+    free( p_comp->p_threads );
+    free( p_comp );
+}
+
+/*****************************************************************************
+ * Filter
+ *****************************************************************************/
+static subpicture_t *Filter( filter_t *p_filter, mtime_t date )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+    bridge_t *p_bridge;
+
+    int i_index, i_real_index;
+    int i_greatest_real_index_used = p_sys->i_order_length - 1;
+
+    unsigned int col_inner_width, row_inner_height;
+
+    subpicture_region_t *p_region;
+    subpicture_region_t *p_region_prev = NULL;
+
+    /* Allocate the subpicture internal data. */
+    subpicture_t *p_spu = filter_NewSubpicture( p_filter );
+    if( !p_spu )
+        return NULL;
+
+    /* Initialize subpicture */
+    p_spu->i_channel = 0;
+    p_spu->i_start  = date;
+    p_spu->i_stop = 0;
+    p_spu->b_ephemer = true;
+    p_spu->i_alpha = p_sys->i_alpha;
+    p_spu->b_absolute = false;
+
+    p_spu->i_original_picture_width = p_sys->i_width;
+    p_spu->i_original_picture_height = p_sys->i_height;
+
+    if( p_sys->p_compositor )
+        return CompositorFilter( p_filter, p_spu );
+
+    vlc_mutex_lock( &p_sys->lock );
+    vlc_global_lock( VLC_MOSAIC_MUTEX );
+
+    p_bridge = GetBridge( p_filter );
+    if ( p_bridge == NULL )
+    {
+        vlc_global_unlock( VLC_MOSAIC_MUTEX );
+        vlc_mutex_unlock( &p_sys->lock );
+        return p_spu;
+    }
+
+    mosaic_UpdateGrid( p_filter, p_sys, p_bridge );
 
     col_inner_width  = ( ( p_sys->i_width - ( p_sys->i_cols - 1 )
                        * p_sys->i_borderw ) / p_sys->i_cols );
@@ -564,27 +1677,8 @@ static subpicture_t *Filter( filter_t *p_filter, mtime_t date )
         if ( p_es->p_picture == NULL )
             continue;
 
-        if ( p_sys->i_order_length == 0 )
-        {
-            i_real_index++;
-        }
-        else
-        {
-            int i;
-            for ( i = 0; i <= p_sys->i_order_length; i++ )
-            {
-                if ( i == p_sys->i_order_length ) break;
-                if ( strcmp( p_es->psz_id, p_sys->ppsz_order[i] ) == 0 )
-                {
-                    i_real_index = i;
-                    break;
-                }
-            }
-            if ( i == p_sys->i_order_length )
-                i_real_index = ++i_greatest_real_index_used;
-        }
-        i_row = ( i_real_index / p_sys->i_cols ) % p_sys->i_rows;
-        i_col = i_real_index % p_sys->i_cols ;
+        const int i_slot = mosaic_GetRealIndex( p_sys, p_es, &i_real_index,
+                                                &i_greatest_real_index_used );
 
         if ( !p_sys->b_keep )
         {
@@ -598,23 +1692,9 @@ static subpicture_t *Filter( filter_t *p_filter, mtime_t date )
                 fmt_out.i_chroma = VLC_CODEC_YUVA;
             else
                 fmt_out.i_chroma = VLC_CODEC_I420;
-            fmt_out.i_width = col_inner_width;
-            fmt_out.i_height = row_inner_height;
-
-            if( p_sys->b_ar ) /* keep aspect ratio */
-            {
-                if( (float)fmt_out.i_width / (float)fmt_out.i_height
-                      > (float)fmt_in.i_width / (float)fmt_in.i_height )
-                {
-                    fmt_out.i_width = ( fmt_out.i_height * fmt_in.i_width )
-                                         / fmt_in.i_height;
-                }
-                else
-                {
-                    fmt_out.i_height = ( fmt_out.i_width * fmt_in.i_height )
-                                        / fmt_in.i_width;
-                }
-             }
+            mosaic_GetSize( p_sys, fmt_in.i_width, fmt_in.i_height,
+                            col_inner_width, row_inner_height,
+                            &fmt_out.i_width, &fmt_out.i_height );
 
             fmt_out.i_visible_width = fmt_out.i_width;
             fmt_out.i_visible_height = fmt_out.i_height;
@@ -654,54 +1734,10 @@ static subpicture_t *Filter( filter_t *p_filter, mtime_t date )
             return NULL;
         }
 
-        if( p_es->i_x >= 0 && p_es->i_y >= 0 )
-        {
-            p_region->i_x = p_es->i_x;
-            p_region->i_y = p_es->i_y;
-        }
-        else if( p_sys->i_position == position_offsets )
-        {
-            p_region->i_x = p_sys->pi_x_offsets[i_real_index];
-            p_region->i_y = p_sys->pi_y_offsets[i_real_index];
-        }
-        else
-        {
-            if( fmt_out.i_width > col_inner_width ||
-                p_sys->b_ar || p_sys->b_keep )
-            {
-                /* we don't have to center the video since it takes the
-                whole rectangle area or it's larger than the rectangle */
-                p_region->i_x = p_sys->i_xoffset
-                            + i_col * ( p_sys->i_width / p_sys->i_cols )
-                            + ( i_col * p_sys->i_borderw ) / p_sys->i_cols;
-            }
-            else
-            {
-                /* center the video in the dedicated rectangle */
-                p_region->i_x = p_sys->i_xoffset
-                        + i_col * ( p_sys->i_width / p_sys->i_cols )
-                        + ( i_col * p_sys->i_borderw ) / p_sys->i_cols
-                        + ( col_inner_width - fmt_out.i_width ) / 2;
-            }
-
-            if( fmt_out.i_height > row_inner_height
-                || p_sys->b_ar || p_sys->b_keep )
-            {
-                /* we don't have to center the video since it takes the
-                whole rectangle area or it's taller than the rectangle */
-                p_region->i_y = p_sys->i_yoffset
-                        + i_row * ( p_sys->i_height / p_sys->i_rows )
-                        + ( i_row * p_sys->i_borderh ) / p_sys->i_rows;
-            }
-            else
-            {
-                /* center the video in the dedicated rectangle */
-                p_region->i_y = p_sys->i_yoffset
-                        + i_row * ( p_sys->i_height / p_sys->i_rows )
-                        + ( i_row * p_sys->i_borderh ) / p_sys->i_rows
-                        + ( row_inner_height - fmt_out.i_height ) / 2;
-            }
-        }
+        mosaic_GetPosition( p_sys, p_es, i_slot,
+                            col_inner_width, row_inner_height,
+                            fmt_out.i_width, fmt_out.i_height,
+                            &p_region->i_x, &p_region->i_y );
         p_region->i_align = p_sys->i_align;
         p_region->i_alpha = p_es->i_alpha;
 
@@ -723,6 +1759,7 @@ static subpicture_t *Filter( filter_t *p_filter, mtime_t date )
     return p_spu;
 }
 
+
 /*****************************************************************************
 * Callback to update params on the fly
 *****************************************************************************/
@@ -39,6 +39,11 @@ typedef struct bridge_t
 {
     bridged_es_t **pp_es;
     int i_es_num;
+
+    /* Called with VLC_MOSAIC_MUTEX held whenever a picture is pushed, so that
+     * a mosaic compositor can start working on it right away */
+    void (*pf_notify)( void *, struct bridge_t * );
+    void *p_notify_data;
 } bridge_t;
 
 static bridge_t *GetBridge( vlc_object_t *p_object )
@@ -90,8 +90,17 @@ struct filter_sys_t
 {
     vlc_mutex_t lock;
     int tab_precalc[512];
+    filter_slices_t *p_slices;
 };
 
+/* Picture being sharpened, shared by the slices */
+typedef struct
+{
+    picture_t *p_pic;
+    picture_t *p_outpic;
+    int sigma;
+} sharpen_job_t;
+
 /*****************************************************************************
  * clip: avoid negative value and value > 255
  *****************************************************************************/
@@ -137,6 +146,8 @@ static int Create( vlc_object_t *p_this )
     float sigma = var_CreateGetFloatCommand( p_filter, FILTER_PREFIX "sigma" );
     init_precalc_table(p_filter->p_sys, sigma);
 
+    p_filter->p_sys->p_slices = filter_NewSlices( p_filter );
+
     vlc_mutex_init( &p_filter->p_sys->lock );
     var_AddCallback( p_filter, FILTER_PREFIX "sigma",
                      SharpenCallback, p_filter->p_sys );
@@ -156,20 +167,21 @@ static void Destroy( vlc_object_t *p_this )
     filter_sys_t *p_sys = p_filter->p_sys;
 
     var_DelCallback( p_filter, FILTER_PREFIX "sigma", SharpenCallback, p_sys );
+    filter_DeleteSlices( p_sys->p_slices );
     vlc_mutex_destroy( &p_sys->lock );
     free( p_sys );
 }
 
 /*****************************************************************************
- * Render: displays previously rendered output
+ * Slice: sharpens a band of the picture
  *****************************************************************************
- * This function send the currently rendered image to Invert image, waits
- * until it is displayed and switch the two rendering buffers, preparing next
- * frame.
+ * Each band reads one more line above and below the lines it writes.
  *****************************************************************************/
-static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
+static void Slice( void *p_data, unsigned i_slice, unsigned i_slices )
 {
-    picture_t *p_outpic;
+    const sharpen_job_t *p_job = p_data;
+    picture_t *p_pic = p_job->p_pic;
+    picture_t *p_outpic = p_job->p_outpic;
     int i, j;
     uint8_t *restrict p_src = NULL;
     uint8_t *restrict p_out = NULL;
@@ -180,16 +192,10 @@ static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
     const int v2 = 3; /* 2^3 = 8 */
     const unsigned i_visible_lines = p_pic->p[Y_PLANE].i_visible_lines;
     const unsigned i_visible_pitch = p_pic->p[Y_PLANE].i_visible_pitch;
-    const int sigma = var_GetFloat( p_filter, FILTER_PREFIX "sigma" ) * (1 << 20);
+    const int sigma = p_job->sigma;
+    filter_slice_t slice;
 
-    if( !p_pic ) return NULL;
-
-    p_outpic = filter_NewPicture( p_filter );
-    if( !p_outpic )
-    {
-        picture_Release( p_pic );
-        return NULL;
-    }
+    filter_GetSlice( &slice, i_visible_lines, i_slice, i_slices, 4, 1 );
 
     /* process the Y plane */
     p_src = p_pic->p[Y_PLANE].p_pixels;
@@ -198,11 +204,11 @@ static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
     i_out_pitch = p_outpic->p[Y_PLANE].i_pitch;
 
     /* perform convolution only on Y plane. Avoid border line. */
-    vlc_mutex_lock( &p_filter->p_sys->lock );
-
-    memcpy(p_out, p_src, i_visible_pitch);
+    if( slice.i_first == 0 && slice.i_end > 0 )
+        memcpy(p_out, p_src, i_visible_pitch);
 
-    for( i = 1; i < i_visible_lines - 1; i++ )
+    for( i = __MAX( slice.i_first, 1 );
+         i < __MIN( slice.i_end, (int)i_visible_lines - 1 ); i++ )
     {
         p_out[i * i_out_pitch] = p_src[i * i_src_pitch];
 
@@ -226,13 +232,45 @@ static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
         p_out[i * i_out_pitch + i_visible_pitch - 1] =
             p_src[i * i_src_pitch + i_visible_pitch - 1];
     }
-    memcpy(&p_out[(i_visible_lines - 1) * i_out_pitch],
-           &p_src[(i_visible_lines - 1) * i_src_pitch], i_visible_pitch);
+    if( slice.i_end == (int)i_visible_lines && slice.i_end > 1 )
+        memcpy(&p_out[(i_visible_lines - 1) * i_out_pitch],
+               &p_src[(i_visible_lines - 1) * i_src_pitch], i_visible_pitch);
+
+    /* copy the matching band of the U and V planes */
+    picture_t pic, outpic;
+    filter_SlicePicture( &pic, p_pic, i_slice, i_slices, 4 );
+    filter_SlicePicture( &outpic, p_outpic, i_slice, i_slices, 4 );
+    plane_CopyPixels( &outpic.p[U_PLANE], &pic.p[U_PLANE] );
+    plane_CopyPixels( &outpic.p[V_PLANE], &pic.p[V_PLANE] );
+}
 
-    vlc_mutex_unlock( &p_filter->p_sys->lock );
+/*****************************************************************************
+ * Render: displays previously rendered output
+ *****************************************************************************
+ * This function send the currently rendered image to Invert image, waits
+ * until it is displayed and switch the two rendering buffers, preparing next
+ * frame.
+ *****************************************************************************/
+static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
+{
+    picture_t *p_outpic;
+    const int sigma = var_GetFloat( p_filter, FILTER_PREFIX "sigma" ) * (1 << 20);
 
-    plane_CopyPixels( &p_outpic->p[U_PLANE], &p_pic->p[U_PLANE] );
-    plane_CopyPixels( &p_outpic->p[V_PLANE], &p_pic->p[V_PLANE] );
+    if( !p_pic ) return NULL;
+
+    p_outpic = filter_NewPicture( p_filter );
+    if( !p_outpic )
+    {
+        picture_Release( p_pic );
+        return NULL;
+    }
+
+    sharpen_job_t job = { .p_pic = p_pic, .p_outpic = p_outpic,
+                          .sigma = sigma };
+
+    vlc_mutex_lock( &p_filter->p_sys->lock );
+    filter_RunSlices( p_filter->p_sys->p_slices, Slice, &job );
+    vlc_mutex_unlock( &p_filter->p_sys->lock );
 
     return CopyInfoAndRelease( p_outpic, p_pic );
 }
@@ -66,6 +66,9 @@ static void       DecoderSignalWait( decoder_t *, bool );
 
 static void       DecoderUnsupportedCodec( decoder_t *, vlc_fourcc_t );
 
+static int        DecoderPipelineStart( decoder_t *, int );
+static void       DecoderPipelineStop( decoder_t * );
+
 /* Buffers allocation callbacks for the decoders */
 static picture_t *vout_new_buffer( decoder_t * );
 static void vout_del_buffer( decoder_t *, picture_t * );
@@ -75,6 +78,50 @@ static int aout_update_format( decoder_t * );
 static subpicture_t *spu_new_buffer( decoder_t *, const subpicture_updater_t * );
 static void spu_del_buffer( decoder_t *, subpicture_t * );
 
+/* Items exchanged between the stages of the decoupled pipeline */
+enum
+{
+    DECODER_ITEM_BLOCK,     /* packetized block, or decoded audio buffer */
+    DECODER_ITEM_PICTURE,   /* decoded picture */
+    DECODER_ITEM_DRAIN,     /* end of stream: drain buffered frames */
+    DECODER_ITEM_FORMAT,    /* new packetizer output format */
+    DECODER_ITEM_RESET,     /* flush the audio or video output */
+    DECODER_ITEM_FLUSH,     /* flush the output, then acknowledge the flush */
+    DECODER_ITEM_ACK,       /* acknowledge the flush */
+};
+
+typedef struct
+{
+    int      i_type;
+    void    *p_data;
+    int64_t  i_preroll_end;
+    mtime_t  i_date;
+} decoder_item_t;
+
+/* Bounded queue between two stages */
+typedef struct
+{
+    vlc_mutex_t     lock;
+    vlc_cond_t      wait_space;
+    vlc_cond_t      wait_data;
+
+    decoder_item_t *p_items;
+    unsigned        i_size;
+    unsigned        i_first;
+    unsigned        i_count;
+    bool            b_busy;
+    bool            b_abort;
+
+    /* Statistics, published as variables of the decoder object */
+    const char     *psz_wait;
+    const char     *psz_depth;
+    mtime_t         i_wait;
+    unsigned        i_max_count;
+} decoder_queue_t;
+
+static void DecoderQueueAbort( decoder_queue_t * );
+static bool DecoderQueueIsEmpty( decoder_queue_t * );
+
 struct decoder_owner_sys_t
 {
     int64_t         i_preroll_end;
@@ -149,6 +196,31 @@ struct decoder_owner_sys_t
 
     /* Delay */
     mtime_t i_ts_delay;
+
+    /* Decoupled pipeline: the decoder thread only packetizes, decoding and
+     * output run on their own threads */
+    struct
+    {
+        bool            b_enabled;
+        vlc_thread_t    decode_thread;
+        vlc_thread_t    output_thread;
+        decoder_queue_t decode;
+        decoder_queue_t output;
+
+        /* Owned by the decoder thread */
+        int64_t         i_preroll_end;
+        bool            b_extra;
+        unsigned        i_sar_num;
+        unsigned        i_sar_den;
+        mtime_t         i_packetize_time;
+
+        /* Owned by the decode thread */
+        int64_t         i_preroll_seen;
+        mtime_t         i_decode_time;
+
+        /* Owned by the output thread */
+        mtime_t         i_output_time;
+    } pipeline;
 };
 
 /* Pictures which are DECODER_BOGUS_VIDEO_DELAY or more in advance probably have
@@ -280,10 +352,19 @@ static decoder_t *decoder_New( vlc_object_t *p_parent, input_thread_t *p_input,
     else
         i_priority = VLC_THREAD_PRIORITY_VIDEO;
 
+    /* Optionally split decoding from packetizing and output */
+    if( !p_dec->p_owner->b_packetizer &&
+        ( p_dec->fmt_out.i_cat == AUDIO_ES || p_dec->fmt_out.i_cat == VIDEO_ES ) &&
+        var_InheritBool( p_dec, "decoder-pipeline" ) &&
+        DecoderPipelineStart( p_dec, i_priority ) )
+        msg_Warn( p_dec, "cannot start the decoder pipeline, "
+                  "decoding in a single thread" );
+
     /* Spawn the decoder thread */
     if( vlc_clone( &p_dec->p_owner->thread, DecoderThread, p_dec, i_priority ) )
     {
         msg_Err( p_dec, "cannot spawn decoder thread" );
+        DecoderPipelineStop( p_dec );
         module_unneed( p_dec, p_dec->p_module );
         DeleteDecoder( p_dec );
         return NULL;
@@ -341,7 +422,15 @@ void input_DecoderDelete( decoder_t *p_dec )
     vlc_cond_signal( &p_owner->wait_request );
     vlc_mutex_unlock( &p_owner->lock );
 
+    /* Unblock the decoder thread if it waits on a full pipeline queue */
+    if( p_owner->pipeline.b_enabled )
+    {
+        DecoderQueueAbort( &p_owner->pipeline.decode );
+        DecoderQueueAbort( &p_owner->pipeline.output );
+    }
+
     vlc_join( p_owner->thread, NULL );
+    DecoderPipelineStop( p_dec );
     p_owner->b_paused = b_was_paused;
 
     module_unneed( p_dec, p_dec->p_module );
@@ -401,6 +490,10 @@ bool input_DecoderIsEmpty( decoder_t * p_dec )
 
     bool b_empty = block_FifoCount( p_dec->p_owner->p_fifo ) <= 0;
 
+    if( b_empty && p_owner->pipeline.b_enabled )
+        b_empty = DecoderQueueIsEmpty( &p_owner->pipeline.decode ) &&
+                  DecoderQueueIsEmpty( &p_owner->pipeline.output );
+
     if( b_empty )
     {
         vlc_mutex_lock( &p_owner->lock );
@@ -758,6 +851,15 @@ static decoder_t * CreateDecoder( vlc_object_t *p_parent,
     p_owner->p_sout_input = NULL;
     p_owner->p_packetizer = NULL;
     p_owner->b_packetizer = b_packetizer;
+    p_owner->pipeline.b_enabled = false;
+    p_owner->pipeline.i_preroll_end = VLC_TS_INVALID;
+    p_owner->pipeline.i_preroll_seen = VLC_TS_INVALID;
+    p_owner->pipeline.b_extra = false;
+    p_owner->pipeline.i_sar_num = 0;
+    p_owner->pipeline.i_sar_den = 0;
+    p_owner->pipeline.i_packetize_time = 0;
+    p_owner->pipeline.i_decode_time = 0;
+    p_owner->pipeline.i_output_time = 0;
 
     /* decoder fifo */
     p_owner->p_fifo = block_FifoNew();
@@ -872,6 +974,202 @@ static decoder_t * CreateDecoder( vlc_object_t *p_parent,
     return p_dec;
 }
 
+/*****************************************************************************
+ * Queues between the stages of the decoupled pipeline
+ *****************************************************************************/
+static int DecoderQueueInit( decoder_queue_t *p_queue, unsigned i_size,
+                             const char *psz_wait, const char *psz_depth )
+{
+    p_queue->p_items = malloc( i_size * sizeof(*p_queue->p_items) );
+    if( unlikely(p_queue->p_items == NULL) )
+        return VLC_ENOMEM;
+
+    vlc_mutex_init( &p_queue->lock );
+    vlc_cond_init( &p_queue->wait_space );
+    vlc_cond_init( &p_queue->wait_data );
+    p_queue->i_size = i_size;
+    p_queue->i_first = 0;
+    p_queue->i_count = 0;
+    p_queue->b_busy = false;
+    p_queue->b_abort = false;
+    p_queue->psz_wait = psz_wait;
+    p_queue->psz_depth = psz_depth;
+    p_queue->i_wait = 0;
+    p_queue->i_max_count = 0;
+    return VLC_SUCCESS;
+}
+
+static void DecoderItemRelease( decoder_t *p_dec, decoder_item_t *p_item )
+{
+    switch( p_item->i_type )
+    {
+        case DECODER_ITEM_BLOCK:
+            block_Release( p_item->p_data );
+            break;
+        case DECODER_ITEM_PICTURE:
+            vout_ReleasePicture( p_dec->p_owner->p_vout, p_item->p_data );
+            break;
+        case DECODER_ITEM_FORMAT:
+            es_format_Clean( p_item->p_data );
+            free( p_item->p_data );
+            break;
+        default:
+            break;
+    }
+}
+
+static void DecoderQueueClean( decoder_t *p_dec, decoder_queue_t *p_queue )
+{
+    for( unsigned i = 0; i < p_queue->i_count; i++ )
+        DecoderItemRelease( p_dec, &p_queue->p_items[(p_queue->i_first + i)
+                                                     % p_queue->i_size] );
+    free( p_queue->p_items );
+    vlc_cond_destroy( &p_queue->wait_data );
+    vlc_cond_destroy( &p_queue->wait_space );
+    vlc_mutex_destroy( &p_queue->lock );
+}
+
+/**
+ * Appends an item, waiting for room if the queue is full. Once the queue is
+ * aborted, the item is released instead.
+ */
+static void DecoderQueuePut( decoder_t *p_dec, decoder_queue_t *p_queue,
+                             int i_type, void *p_data, int64_t i_preroll_end )
+{
+    decoder_item_t item = {
+        .i_type = i_type,
+        .p_data = p_data,
+        .i_preroll_end = i_preroll_end,
+    };
+
+    vlc_mutex_lock( &p_queue->lock );
+    while( p_queue->i_count >= p_queue->i_size && !p_queue->b_abort )
+        vlc_cond_wait( &p_queue->wait_space, &p_queue->lock );
+
+    if( p_queue->b_abort )
+    {
+        vlc_mutex_unlock( &p_queue->lock );
+        DecoderItemRelease( p_dec, &item );
+        return;
+    }
+
+    item.i_date = mdate();
+    p_queue->p_items[(p_queue->i_first + p_queue->i_count) % p_queue->i_size] = item;
+    p_queue->i_count++;
+    if( p_queue->i_count > p_queue->i_max_count )
+        p_queue->i_max_count = p_queue->i_count;
+
+    vlc_cond_signal( &p_queue->wait_data );
+    vlc_mutex_unlock( &p_queue->lock );
+}
+
+/**
+ * Takes the oldest item, waiting for one if needed. The previous item is
+ * considered done. Returns false once the queue is aborted.
+ */
+static bool DecoderQueueGet( decoder_t *p_dec, decoder_queue_t *p_queue,
+                             decoder_item_t *p_item )
+{
+    vlc_mutex_lock( &p_queue->lock );
+    p_queue->b_busy = false;
+    vlc_cond_signal( &p_queue->wait_space );
+
+    while( p_queue->i_count == 0 && !p_queue->b_abort )
+        vlc_cond_wait( &p_queue->wait_data, &p_queue->lock );
+
+    if( p_queue->b_abort )
+    {
+        vlc_mutex_unlock( &p_queue->lock );
+        return false;
+    }
+
+    const unsigned i_depth = p_queue->i_count;
+
+    *p_item = p_queue->p_items[p_queue->i_first];
+    p_queue->i_first = (p_queue->i_first + 1) % p_queue->i_size;
+    p_queue->i_count--;
+    p_queue->b_busy = true;
+    p_queue->i_wait += (mdate() - p_item->i_date - p_queue->i_wait) / 8;
+
+    const mtime_t i_wait = p_queue->i_wait;
+
+    vlc_cond_signal( &p_queue->wait_space );
+    vlc_mutex_unlock( &p_queue->lock );
+
+    var_SetInteger( p_dec, p_queue->psz_wait, i_wait );
+    var_SetInteger( p_dec, p_queue->psz_depth, i_depth );
+    return true;
+}
+
+/**
+ * Waits until the consumer has handled every queued item.
+ */
+static void DecoderQueueDrain( decoder_queue_t *p_queue )
+{
+    vlc_mutex_lock( &p_queue->lock );
+    while( (p_queue->i_count > 0 || p_queue->b_busy) && !p_queue->b_abort )
+        vlc_cond_wait( &p_queue->wait_space, &p_queue->lock );
+    vlc_mutex_unlock( &p_queue->lock );
+}
+
+static bool DecoderQueueIsEmpty( decoder_queue_t *p_queue )
+{
+    vlc_mutex_lock( &p_queue->lock );
+    bool b_empty = p_queue->i_count == 0 && !p_queue->b_busy;
+    vlc_mutex_unlock( &p_queue->lock );
+
+    return b_empty;
+}
+
+/**
+ * Drops queued data but keeps format changes and flush requests.
+ */
+static void DecoderQueueFlush( decoder_t *p_dec, decoder_queue_t *p_queue )
+{
+    unsigned i_count = 0;
+
+    vlc_mutex_lock( &p_queue->lock );
+    for( unsigned i = 0; i < p_queue->i_count; i++ )
+    {
+        decoder_item_t *p_item =
+            &p_queue->p_items[(p_queue->i_first + i) % p_queue->i_size];
+
+        switch( p_item->i_type )
+        {
+            case DECODER_ITEM_BLOCK:
+            case DECODER_ITEM_PICTURE:
+            case DECODER_ITEM_DRAIN:
+                DecoderItemRelease( p_dec, p_item );
+                break;
+            default:
+                p_queue->p_items[(p_queue->i_first + i_count++)
+                                 % p_queue->i_size] = *p_item;
+                break;
+        }
+    }
+    p_queue->i_count = i_count;
+
+    vlc_cond_signal( &p_queue->wait_space );
+    vlc_mutex_unlock( &p_queue->lock );
+}
+
+static void DecoderQueueAbort( decoder_queue_t *p_queue )
+{
+    vlc_mutex_lock( &p_queue->lock );
+    p_queue->b_abort = true;
+    vlc_cond_broadcast( &p_queue->wait_space );
+    vlc_cond_broadcast( &p_queue->wait_data );
+    vlc_mutex_unlock( &p_queue->lock );
+}
+
+/* Smoothed time a stage spends on one item */
+static void DecoderStageTime( decoder_t *p_dec, const char *psz_var,
+                              mtime_t *pi_time, mtime_t i_start )
+{
+    *pi_time += (mdate() - i_start - *pi_time) / 8;
+    var_SetInteger( p_dec, psz_var, *pi_time );
+}
+
 /**
  * The decoding main loop
  *
@@ -906,7 +1204,13 @@ static void *DecoderThread( void *p_data )
                 p_block = NULL;
             }
 
+            const mtime_t i_start = mdate();
+
             DecoderProcess( p_dec, p_block );
+            if( p_owner->pipeline.b_enabled )
+                DecoderStageTime( p_dec, "pipeline-packetize-time",
+                                  &p_owner->pipeline.i_packetize_time,
+                                  i_start );
 
             vlc_restorecancel( canc );
         }
@@ -936,6 +1240,11 @@ static void DecoderFlush( decoder_t *p_dec )
 
     /* Empty the fifo */
     block_FifoEmpty( p_owner->p_fifo );
+    if( p_owner->pipeline.b_enabled )
+    {
+        DecoderQueueFlush( p_dec, &p_owner->pipeline.decode );
+        DecoderQueueFlush( p_dec, &p_owner->pipeline.output );
+    }
 
     p_owner->b_waiting = false;
     /* Monitor for flush end */
@@ -1202,6 +1511,35 @@ static void DecoderPlayAudio( decoder_t *p_dec, block_t *p_audio,
     vlc_mutex_unlock( &p_owner->lock );
 }
 
+/* Hands decoded audio over to the output thread, or plays it right away */
+static void DecoderOutputAudio( decoder_t *p_dec, block_t *p_audio,
+                                int *pi_played_sum, int *pi_lost_sum )
+{
+    decoder_owner_sys_t *p_owner = p_dec->p_owner;
+
+    if( p_owner->pipeline.b_enabled )
+        DecoderQueuePut( p_dec, &p_owner->pipeline.output,
+                         p_audio ? DECODER_ITEM_BLOCK : DECODER_ITEM_DRAIN,
+                         p_audio, VLC_TS_INVALID );
+    else
+        DecoderPlayAudio( p_dec, p_audio, pi_played_sum, pi_lost_sum );
+}
+
+static void DecoderUpdateStatAudio( decoder_owner_sys_t *p_owner,
+                                    int i_decoded, int i_lost, int i_played )
+{
+    input_thread_t  *p_input = p_owner->p_input;
+
+    if( p_input != NULL && (i_decoded > 0 || i_lost > 0 || i_played > 0) )
+    {
+        vlc_mutex_lock( &p_input->p->counters.counters_lock);
+        stats_Update( p_input->p->counters.p_lost_abuffers, i_lost, NULL );
+        stats_Update( p_input->p->counters.p_played_abuffers, i_played, NULL );
+        stats_Update( p_input->p->counters.p_decoded_audio, i_decoded, NULL );
+        vlc_mutex_unlock( &p_input->p->counters.counters_lock);
+    }
+}
+
 static void DecoderDecodeAudio( decoder_t *p_dec, block_t *p_block )
 {
     decoder_owner_sys_t *p_owner = p_dec->p_owner;
@@ -1212,7 +1550,7 @@ static void DecoderDecodeAudio( decoder_t *p_dec, block_t *p_block )
 
     if (!p_block) {
         /* Play a NULL block to output buffered frames */
-        DecoderPlayAudio( p_dec, NULL, &i_played, &i_lost );
+        DecoderOutputAudio( p_dec, NULL, &i_played, &i_lost );
     }
     else while( (p_aout_buf = p_dec->pf_decode_audio( p_dec, &p_block )) )
     {
@@ -1236,26 +1574,20 @@ static void DecoderDecodeAudio( decoder_t *p_dec, block_t *p_block )
         if( p_owner->i_preroll_end > VLC_TS_INVALID )
         {
             msg_Dbg( p_dec, "End of audio preroll" );
-            if( p_owner->p_aout )
+            if( p_owner->pipeline.b_enabled )
+                DecoderQueuePut( p_dec, &p_owner->pipeline.output,
+                                 DECODER_ITEM_RESET, NULL, VLC_TS_INVALID );
+            else if( p_owner->p_aout )
                 aout_DecFlush( p_owner->p_aout );
             /* */
             p_owner->i_preroll_end = VLC_TS_INVALID;
         }
 
-        DecoderPlayAudio( p_dec, p_aout_buf, &i_played, &i_lost );
+        DecoderOutputAudio( p_dec, p_aout_buf, &i_played, &i_lost );
     }
 
     /* Update ugly stat */
-    input_thread_t  *p_input = p_owner->p_input;
-
-    if( p_input != NULL && (i_decoded > 0 || i_lost > 0 || i_played > 0) )
-    {
-        vlc_mutex_lock( &p_input->p->counters.counters_lock);
-        stats_Update( p_input->p->counters.p_lost_abuffers, i_lost, NULL );
-        stats_Update( p_input->p->counters.p_played_abuffers, i_played, NULL );
-        stats_Update( p_input->p->counters.p_decoded_audio, i_decoded, NULL );
-        vlc_mutex_unlock( &p_input->p->counters.counters_lock);
-    }
+    DecoderUpdateStatAudio( p_owner, i_decoded, i_lost, i_played );
 }
 static void DecoderGetCc( decoder_t *p_dec, decoder_t *p_dec_cc )
 {
@@ -1374,6 +1706,35 @@ static void DecoderPlayVideo( decoder_t *p_dec, picture_t *p_picture,
     *pi_lost_sum += i_tmp_lost;
 }
 
+/* Hands a decoded picture over to the output thread, or displays it now */
+static void DecoderOutputVideo( decoder_t *p_dec, picture_t *p_picture,
+                                int *pi_played_sum, int *pi_lost_sum )
+{
+    decoder_owner_sys_t *p_owner = p_dec->p_owner;
+
+    if( p_owner->pipeline.b_enabled )
+        DecoderQueuePut( p_dec, &p_owner->pipeline.output,
+                         DECODER_ITEM_PICTURE, p_picture, VLC_TS_INVALID );
+    else
+        DecoderPlayVideo( p_dec, p_picture, pi_played_sum, pi_lost_sum );
+}
+
+static void DecoderUpdateStatVideo( decoder_owner_sys_t *p_owner,
+                                    int i_decoded, int i_lost, int i_displayed )
+{
+    input_thread_t *p_input = p_owner->p_input;
+
+    if( p_input != NULL && (i_decoded > 0 || i_lost > 0 || i_displayed > 0) )
+    {
+        vlc_mutex_lock( &p_input->p->counters.counters_lock );
+        stats_Update( p_input->p->counters.p_decoded_video, i_decoded, NULL );
+        stats_Update( p_input->p->counters.p_lost_pictures, i_lost , NULL);
+        stats_Update( p_input->p->counters.p_displayed_pictures,
+                      i_displayed, NULL);
+        vlc_mutex_unlock( &p_input->p->counters.counters_lock );
+    }
+}
+
 static void DecoderDecodeVideo( decoder_t *p_dec, block_t *p_block )
 {
     decoder_owner_sys_t *p_owner = p_dec->p_owner;
@@ -1405,7 +1766,10 @@ static void DecoderDecodeVideo( decoder_t *p_dec, block_t *p_block )
         if( p_owner->i_preroll_end > VLC_TS_INVALID )
         {
             msg_Dbg( p_dec, "End of video preroll" );
-            if( p_vout )
+            if( p_owner->pipeline.b_enabled )
+                DecoderQueuePut( p_dec, &p_owner->pipeline.output,
+                                 DECODER_ITEM_RESET, NULL, VLC_TS_INVALID );
+            else if( p_vout )
                 vout_Flush( p_vout, VLC_TS_INVALID+1 );
             /* */
             p_owner->i_preroll_end = VLC_TS_INVALID;
@@ -1415,21 +1779,11 @@ static void DecoderDecodeVideo( decoder_t *p_dec, block_t *p_block )
             ( !p_owner->p_packetizer || !p_owner->p_packetizer->pf_get_cc ) )
             DecoderGetCc( p_dec, p_dec );
 
-        DecoderPlayVideo( p_dec, p_pic, &i_displayed, &i_lost );
+        DecoderOutputVideo( p_dec, p_pic, &i_displayed, &i_lost );
     }
 
     /* Update ugly stat */
-    input_thread_t *p_input = p_owner->p_input;
-
-    if( p_input != NULL && (i_decoded > 0 || i_lost > 0 || i_displayed > 0) )
-    {
-        vlc_mutex_lock( &p_input->p->counters.counters_lock );
-        stats_Update( p_input->p->counters.p_decoded_video, i_decoded, NULL );
-        stats_Update( p_input->p->counters.p_lost_pictures, i_lost , NULL);
-        stats_Update( p_input->p->counters.p_displayed_pictures,
-                      i_displayed, NULL);
-        vlc_mutex_unlock( &p_input->p->counters.counters_lock );
-    }
+    DecoderUpdateStatVideo( p_owner, i_decoded, i_lost, i_displayed );
 }
 
 static void DecoderPlaySpu( decoder_t *p_dec, subpicture_t *p_subpic )
@@ -1570,6 +1924,98 @@ static void DecoderProcessSout( decoder_t *p_dec, block_t *p_block )
 }
 #endif
 
+/* Applies what the packetizer found out about the stream to the decoder input
+ */
+static void DecoderUpdatePacketizedFormat( decoder_t *p_dec,
+                                           const es_format_t *p_fmt )
+{
+    if( p_fmt->i_extra && !p_dec->fmt_in.i_extra )
+    {
+        es_format_Clean( &p_dec->fmt_in );
+        es_format_Copy( &p_dec->fmt_in, p_fmt );
+    }
+
+    /* If the packetizer provides aspect ratio information, pass it
+     * to the decoder as a hint if the decoder itself can't provide
+     * it. Copy it regardless of the current value of the decoder input
+     * format aspect ratio, to properly propagate changes in aspect
+     * ratio. */
+    if( p_fmt->i_cat == VIDEO_ES &&
+        p_fmt->video.i_sar_num > 0 && p_fmt->video.i_sar_den > 0)
+    {
+        p_dec->fmt_in.video.i_sar_num = p_fmt->video.i_sar_num;
+        p_dec->fmt_in.video.i_sar_den = p_fmt->video.i_sar_den;
+    }
+}
+
+/* Passes the packetizer output format on to the decoder. The decode thread
+ * owns the decoder input format, so it only gets a copy when something it
+ * would use has changed.
+ */
+static void DecoderSendPacketizedFormat( decoder_t *p_dec,
+                                         const es_format_t *p_fmt )
+{
+    decoder_owner_sys_t *p_owner = p_dec->p_owner;
+
+    if( !p_owner->pipeline.b_enabled )
+    {
+        DecoderUpdatePacketizedFormat( p_dec, p_fmt );
+        return;
+    }
+
+    const bool b_extra = p_fmt->i_extra > 0 && !p_owner->pipeline.b_extra;
+    const bool b_sar = p_fmt->i_cat == VIDEO_ES &&
+                       p_fmt->video.i_sar_num > 0 &&
+                       p_fmt->video.i_sar_den > 0 &&
+                       ( p_fmt->video.i_sar_num != p_owner->pipeline.i_sar_num ||
+                         p_fmt->video.i_sar_den != p_owner->pipeline.i_sar_den );
+    if( !b_extra && !b_sar )
+        return;
+
+    es_format_t *p_copy = malloc( sizeof(*p_copy) );
+    if( unlikely(p_copy == NULL) )
+        return;
+    es_format_Copy( p_copy, p_fmt );
+
+    if( b_extra )
+        p_owner->pipeline.b_extra = true;
+    if( b_sar )
+    {
+        p_owner->pipeline.i_sar_num = p_fmt->video.i_sar_num;
+        p_owner->pipeline.i_sar_den = p_fmt->video.i_sar_den;
+    }
+    DecoderQueuePut( p_dec, &p_owner->pipeline.decode, DECODER_ITEM_FORMAT,
+                     p_copy, VLC_TS_INVALID );
+}
+
+/* Hands a packetized block over to the decode thread, or decodes it now
+ */
+static void DecoderQueueDecode( decoder_t *p_dec, block_t *p_block )
+{
+    decoder_owner_sys_t *p_owner = p_dec->p_owner;
+
+    if( p_owner->pipeline.b_enabled )
+        DecoderQueuePut( p_dec, &p_owner->pipeline.decode,
+                         p_block ? DECODER_ITEM_BLOCK : DECODER_ITEM_DRAIN,
+                         p_block, p_owner->pipeline.i_preroll_end );
+    else if( p_dec->fmt_out.i_cat == AUDIO_ES )
+        DecoderDecodeAudio( p_dec, p_block );
+    else
+        DecoderDecodeVideo( p_dec, p_block );
+}
+
+/* Flushes whatever the audio or video output still has queued
+ */
+static void DecoderFlushOutput( decoder_t *p_dec )
+{
+    decoder_owner_sys_t *p_owner = p_dec->p_owner;
+
+    if( p_dec->fmt_out.i_cat == VIDEO_ES && p_owner->p_vout )
+        vout_Flush( p_owner->p_vout, VLC_TS_INVALID+1 );
+    else if( p_dec->fmt_out.i_cat == AUDIO_ES && p_owner->p_aout )
+        aout_DecFlush( p_owner->p_aout );
+}
+
 /* This function process a video block
  */
 static void DecoderProcessVideo( decoder_t *p_dec, block_t *p_block, bool b_flush )
@@ -1584,25 +2030,7 @@ static void DecoderProcessVideo( decoder_t *p_dec, block_t *p_block, bool b_flus
         while( (p_packetized_block =
                 p_packetizer->pf_packetize( p_packetizer, p_block ? &p_block : NULL )) )
         {
-            if( p_packetizer->fmt_out.i_extra && !p_dec->fmt_in.i_extra )
-            {
-                es_format_Clean( &p_dec->fmt_in );
-                es_format_Copy( &p_dec->fmt_in, &p_packetizer->fmt_out );
-            }
-
-            /* If the packetizer provides aspect ratio information, pass it
-             * to the decoder as a hint if the decoder itself can't provide
-             * it. Copy it regardless of the current value of the decoder input
-             * format aspect ratio, to properly propagate changes in aspect
-             * ratio. */
-            if( p_packetizer->fmt_out.video.i_sar_num > 0 &&
-                    p_packetizer->fmt_out.video.i_sar_den > 0)
-            {
-                p_dec->fmt_in.video.i_sar_num =
-                    p_packetizer->fmt_out.video.i_sar_num;
-                p_dec->fmt_in.video.i_sar_den=
-                    p_packetizer->fmt_out.video.i_sar_den;
-            }
+            DecoderSendPacketizedFormat( p_dec, &p_packetizer->fmt_out );
 
             if( p_packetizer->pf_get_cc )
                 DecoderGetCc( p_dec, p_packetizer );
@@ -1612,7 +2040,7 @@ static void DecoderProcessVideo( decoder_t *p_dec, block_t *p_block, bool b_flus
                 block_t *p_next = p_packetized_block->p_next;
                 p_packetized_block->p_next = NULL;
 
-                DecoderDecodeVideo( p_dec, p_packetized_block );
+                DecoderQueueDecode( p_dec, p_packetized_block );
 
                 p_packetized_block = p_next;
             }
@@ -1623,16 +2051,17 @@ static void DecoderProcessVideo( decoder_t *p_dec, block_t *p_block, bool b_flus
         {
             block_t *p_null = DecoderBlockFlushNew();
             if( p_null )
-                DecoderDecodeVideo( p_dec, p_null );
+                DecoderQueueDecode( p_dec, p_null );
         }
     }
     else
     {
-        DecoderDecodeVideo( p_dec, p_block );
+        DecoderQueueDecode( p_dec, p_block );
     }
 
-    if( b_flush && p_owner->p_vout )
-        vout_Flush( p_owner->p_vout, VLC_TS_INVALID+1 );
+    /* The output thread flushes once it reaches the flush request */
+    if( b_flush && !p_owner->pipeline.b_enabled )
+        DecoderFlushOutput( p_dec );
 }
 
 /* This function process a audio block
@@ -1649,18 +2078,14 @@ static void DecoderProcessAudio( decoder_t *p_dec, block_t *p_block, bool b_flus
         while( (p_packetized_block =
                 p_packetizer->pf_packetize( p_packetizer, p_block ? &p_block : NULL )) )
         {
-            if( p_packetizer->fmt_out.i_extra && !p_dec->fmt_in.i_extra )
-            {
-                es_format_Clean( &p_dec->fmt_in );
-                es_format_Copy( &p_dec->fmt_in, &p_packetizer->fmt_out );
-            }
+            DecoderSendPacketizedFormat( p_dec, &p_packetizer->fmt_out );
 
             while( p_packetized_block )
             {
                 block_t *p_next = p_packetized_block->p_next;
                 p_packetized_block->p_next = NULL;
 
-                DecoderDecodeAudio( p_dec, p_packetized_block );
+                DecoderQueueDecode( p_dec, p_packetized_block );
 
                 p_packetized_block = p_next;
             }
@@ -1671,16 +2096,17 @@ static void DecoderProcessAudio( decoder_t *p_dec, block_t *p_block, bool b_flus
         {
             block_t *p_null = DecoderBlockFlushNew();
             if( p_null )
-                DecoderDecodeAudio( p_dec, p_null );
+                DecoderQueueDecode( p_dec, p_null );
         }
     }
     else
     {
-        DecoderDecodeAudio( p_dec, p_block );
+        DecoderQueueDecode( p_dec, p_block );
     }
 
-    if( b_flush && p_owner->p_aout )
-        aout_DecFlush( p_owner->p_aout );
+    /* The output thread flushes once it reaches the flush request */
+    if( b_flush && !p_owner->pipeline.b_enabled )
+        DecoderFlushOutput( p_dec );
 }
 
 /* This function process a subtitle block
@@ -1763,6 +2189,7 @@ static void DecoderProcess( decoder_t *p_dec, block_t *p_block )
 {
     decoder_owner_sys_t *p_owner = (decoder_owner_sys_t *)p_dec->p_owner;
     const bool b_flush_request = p_block && (p_block->i_flags & BLOCK_FLAG_CORE_FLUSH);
+    bool b_flush = false;
 
     if( p_dec->b_error )
     {
@@ -1789,12 +2216,16 @@ static void DecoderProcess( decoder_t *p_dec, block_t *p_block )
     else
 #endif
     {
-        bool b_flush = false;
+        /* With the pipeline, the decode thread picks the preroll up from
+         * the blocks it is handed */
+        int64_t *pi_preroll_end = p_owner->pipeline.b_enabled
+                                ? &p_owner->pipeline.i_preroll_end
+                                : &p_owner->i_preroll_end;
 
         if( p_block )
         {
-            const bool b_flushing = p_owner->i_preroll_end == INT64_MAX;
-            DecoderUpdatePreroll( &p_owner->i_preroll_end, p_block );
+            const bool b_flushing = *pi_preroll_end == INT64_MAX;
+            DecoderUpdatePreroll( pi_preroll_end, p_block );
 
             b_flush = !b_flushing && b_flush_request;
 
@@ -1823,7 +2254,194 @@ static void DecoderProcess( decoder_t *p_dec, block_t *p_block )
     /* */
 flush:
     if( b_flush_request )
-        DecoderProcessOnFlush( p_dec );
+    {
+        if( p_owner->pipeline.b_enabled )
+            DecoderQueuePut( p_dec, &p_owner->pipeline.decode,
+                             b_flush ? DECODER_ITEM_FLUSH : DECODER_ITEM_ACK,
+                             NULL, VLC_TS_INVALID );
+        else
+            DecoderProcessOnFlush( p_dec );
+    }
+}
+
+/*****************************************************************************
+ * Decoupled pipeline: the decoder thread packetizes, a decode thread runs
+ * the decoder and an output thread waits on the audio/video output.
+ *****************************************************************************/
+static void *DecoderDecodeThread( void *p_data )
+{
+    decoder_t *p_dec = p_data;
+    decoder_owner_sys_t *p_owner = p_dec->p_owner;
+    decoder_item_t item;
+
+    /* Only DecoderQueueAbort() stops this thread */
+    int canc = vlc_savecancel();
+
+    while( DecoderQueueGet( p_dec, &p_owner->pipeline.decode, &item ) )
+    {
+        const mtime_t i_start = mdate();
+
+        switch( item.i_type )
+        {
+            case DECODER_ITEM_FORMAT:
+                DecoderUpdatePacketizedFormat( p_dec, item.p_data );
+                DecoderItemRelease( p_dec, &item );
+                break;
+
+            case DECODER_ITEM_BLOCK:
+            case DECODER_ITEM_DRAIN:
+                /* Follow the preroll as the decoder thread saw it. As with
+                 * DecoderUpdatePreroll(), only a new preroll request restarts
+                 * one that already ended. */
+                if( item.i_preroll_end != p_owner->pipeline.i_preroll_seen )
+                {
+                    p_owner->pipeline.i_preroll_seen = item.i_preroll_end;
+                    if( item.i_preroll_end == INT64_MAX ||
+                        p_owner->i_preroll_end > VLC_TS_INVALID )
+                        p_owner->i_preroll_end = item.i_preroll_end;
+                }
+                if( p_dec->fmt_out.i_cat == AUDIO_ES )
+                    DecoderDecodeAudio( p_dec, item.p_data );
+                else
+                    DecoderDecodeVideo( p_dec, item.p_data );
+                break;
+
+            default:
+                DecoderQueuePut( p_dec, &p_owner->pipeline.output,
+                                 item.i_type, NULL, VLC_TS_INVALID );
+                break;
+        }
+
+        DecoderStageTime( p_dec, "pipeline-decode-time",
+                          &p_owner->pipeline.i_decode_time, i_start );
+    }
+
+    vlc_restorecancel( canc );
+    return NULL;
+}
+
+static void *DecoderOutputThread( void *p_data )
+{
+    decoder_t *p_dec = p_data;
+    decoder_owner_sys_t *p_owner = p_dec->p_owner;
+    decoder_item_t item;
+
+    int canc = vlc_savecancel();
+
+    while( DecoderQueueGet( p_dec, &p_owner->pipeline.output, &item ) )
+    {
+        const mtime_t i_start = mdate();
+        int i_played = 0;
+        int i_lost = 0;
+
+        switch( item.i_type )
+        {
+            case DECODER_ITEM_PICTURE:
+                DecoderPlayVideo( p_dec, item.p_data, &i_played, &i_lost );
+                DecoderUpdateStatVideo( p_owner, 0, i_lost, i_played );
+                break;
+
+            case DECODER_ITEM_BLOCK:
+            case DECODER_ITEM_DRAIN:
+                DecoderPlayAudio( p_dec, item.p_data, &i_played, &i_lost );
+                DecoderUpdateStatAudio( p_owner, 0, i_lost, i_played );
+                break;
+
+            case DECODER_ITEM_RESET:
+                DecoderFlushOutput( p_dec );
+                break;
+
+            case DECODER_ITEM_FLUSH:
+                DecoderFlushOutput( p_dec );
+                /* fall through */
+            case DECODER_ITEM_ACK:
+                DecoderProcessOnFlush( p_dec );
+                break;
+        }
+
+        DecoderStageTime( p_dec, "pipeline-output-time",
+                          &p_owner->pipeline.i_output_time, i_start );
+    }
+
+    vlc_restorecancel( canc );
+    return NULL;
+}
+
+static int DecoderPipelineStart( decoder_t *p_dec, int i_priority )
+{
+    decoder_owner_sys_t *p_owner = p_dec->p_owner;
+    int i_depth = var_InheritInteger( p_dec, "decoder-pipeline-depth" );
+
+    if( i_depth < 1 )
+        i_depth = 1;
+
+    if( DecoderQueueInit( &p_owner->pipeline.decode, i_depth,
+                          "pipeline-decode-wait", "pipeline-decode-depth" ) )
+        return VLC_ENOMEM;
+    if( DecoderQueueInit( &p_owner->pipeline.output, i_depth,
+                          "pipeline-output-wait", "pipeline-output-depth" ) )
+    {
+        DecoderQueueClean( p_dec, &p_owner->pipeline.decode );
+        return VLC_ENOMEM;
+    }
+
+    /* Smoothed per item processing and queueing times (us), queue depths */
+    var_Create( p_dec, "pipeline-packetize-time", VLC_VAR_INTEGER );
+    var_Create( p_dec, "pipeline-decode-time", VLC_VAR_INTEGER );
+    var_Create( p_dec, "pipeline-output-time", VLC_VAR_INTEGER );
+    var_Create( p_dec, "pipeline-decode-wait", VLC_VAR_INTEGER );
+    var_Create( p_dec, "pipeline-decode-depth", VLC_VAR_INTEGER );
+    var_Create( p_dec, "pipeline-output-wait", VLC_VAR_INTEGER );
+    var_Create( p_dec, "pipeline-output-depth", VLC_VAR_INTEGER );
+
+    /* Set before the threads run: DecoderOutputVideo() and friends check it */
+    p_owner->pipeline.b_enabled = true;
+
+    if( vlc_clone( &p_owner->pipeline.decode_thread, DecoderDecodeThread,
+                   p_dec, i_priority ) )
+        goto error;
+    if( vlc_clone( &p_owner->pipeline.output_thread, DecoderOutputThread,
+                   p_dec, i_priority ) )
+    {
+        DecoderQueueAbort( &p_owner->pipeline.decode );
+        vlc_join( p_owner->pipeline.decode_thread, NULL );
+        goto error;
+    }
+
+    msg_Dbg( p_dec, "decoding in a %d deep pipeline", i_depth );
+    return VLC_SUCCESS;
+
+error:
+    p_owner->pipeline.b_enabled = false;
+    DecoderQueueClean( p_dec, &p_owner->pipeline.output );
+    DecoderQueueClean( p_dec, &p_owner->pipeline.decode );
+    return VLC_EGENERIC;
+}
+
+/* The decoder thread must have been joined already */
+static void DecoderPipelineStop( decoder_t *p_dec )
+{
+    decoder_owner_sys_t *p_owner = p_dec->p_owner;
+
+    if( !p_owner->pipeline.b_enabled )
+        return;
+
+    DecoderQueueAbort( &p_owner->pipeline.decode );
+    DecoderQueueAbort( &p_owner->pipeline.output );
+    vlc_join( p_owner->pipeline.decode_thread, NULL );
+    vlc_join( p_owner->pipeline.output_thread, NULL );
+
+    msg_Dbg( p_dec, "pipeline: packetize %"PRId64" us, decode %"PRId64
+             " us (queue peak %u), output %"PRId64" us (queue peak %u)",
+             p_owner->pipeline.i_packetize_time,
+             p_owner->pipeline.i_decode_time,
+             p_owner->pipeline.decode.i_max_count,
+             p_owner->pipeline.i_output_time,
+             p_owner->pipeline.output.i_max_count );
+
+    DecoderQueueClean( p_dec, &p_owner->pipeline.decode );
+    DecoderQueueClean( p_dec, &p_owner->pipeline.output );
+    p_owner->pipeline.b_enabled = false;
 }
 
 /**
@@ -1960,6 +2578,10 @@ static int aout_update_format( decoder_t *p_dec )
     {
         audio_output_t *p_aout = p_owner->p_aout;
 
+        /* Let the output thread play what was decoded in the old format */
+        if( p_owner->pipeline.b_enabled )
+            DecoderQueueDrain( &p_owner->pipeline.output );
+
         /* Parameters changed, restart the aout */
         vlc_mutex_lock( &p_owner->lock );
 
@@ -2122,6 +2744,10 @@ static picture_t *vout_new_buffer( decoder_t *p_dec )
         vlc_ureduce( &fmt.i_sar_num, &fmt.i_sar_den,
                      fmt.i_sar_num, fmt.i_sar_den, 50000 );
 
+        /* Pictures still queued for output belong to the old vout */
+        if( p_owner->pipeline.b_enabled )
+            DecoderQueueDrain( &p_owner->pipeline.output );
+
         vlc_mutex_lock( &p_owner->lock );
 
         p_vout = p_owner->p_vout;
@@ -2149,7 +2775,9 @@ static picture_t *vout_new_buffer( decoder_t *p_dec )
         p_vout = input_resource_RequestVout( p_owner->p_resource,
                                              p_vout, &fmt,
                                              dpb_size +
-                                             p_dec->i_extra_picture_buffers + 1,
+                                             p_dec->i_extra_picture_buffers + 1 +
+                                             ( p_owner->pipeline.b_enabled ?
+                                               p_owner->pipeline.output.i_size : 0 ),
                                              true );
         vlc_mutex_lock( &p_owner->lock );
         p_owner->p_vout = p_vout;
@@ -384,6 +384,11 @@ static const char *const ppsz_pos_descriptions[] =
     "picture quality, for instance deinterlacing, or distort " \
     "the video.")
 
+#define FILTER_THREADS_TEXT N_("Video filter threads")
+#define FILTER_THREADS_LONGTEXT N_( \
+    "Number of threads each slice threaded video filter uses to process " \
+    "a picture (0 for one per CPU, 1 to disable slice threading).")
+
 #define SNAP_PATH_TEXT N_("Video snapshot directory (or filename)")
 #define SNAP_PATH_LONGTEXT N_( \
     "Directory where the video snapshots will be stored.")
@@ -813,6 +818,11 @@ static const char *const ppsz_prefres[] = {
     "However allocation of port numbers below 1025 is usually restricted " \
     "by the operating system." )
 
+#define HTTP_THREADS_TEXT N_( "HTTP server threads" )
+#define HTTP_THREADS_LONGTEXT N_( \
+    "Number of threads serving the HTTP clients with epoll. " \
+    "0 keeps the single poll() thread." )
+
 #define HTTPS_PORT_TEXT N_( "HTTPS server port" )
 #define HTTPS_PORT_LONGTEXT N_( \
     "The HTTPS server will listen on this TCP port. " \
@@ -909,6 +919,17 @@ static const char *const ppsz_prefres[] = {
     "This allows you to select a list of encoders that VLC will use in " \
     "priority.")
 
+#define DEC_PIPELINE_TEXT N_("Decoder pipeline")
+#define DEC_PIPELINE_LONGTEXT N_( \
+    "Run packetizing, decoding and output of each audio and video " \
+    "elementary stream in separate threads, so that they overlap.")
+
+#define DEC_PIPELINE_DEPTH_TEXT N_("Decoder pipeline depth")
+#define DEC_PIPELINE_DEPTH_LONGTEXT N_( \
+    "Number of blocks or pictures each stage of the decoder pipeline can " \
+    "queue for the next one. Deeper queues absorb more jitter but use " \
+    "more memory and video output buffers.")
+
 /*****************************************************************************
  * Sout
  ****************************************************************************/
@@ -1611,6 +1632,9 @@ vlc_module_begin ()
                 VIDEO_FILTER_TEXT, VIDEO_FILTER_LONGTEXT, false )
     add_module_list( "video-splitter", "video splitter", NULL,
                      VIDEO_SPLITTER_TEXT, VIDEO_SPLITTER_LONGTEXT, false )
+    add_integer_with_range( "filter-threads", 1, 0, 64,
+                            FILTER_THREADS_TEXT, FILTER_THREADS_LONGTEXT,
+                            true )
     add_obsolete_string( "vout-filter" ) /* since 2.0.0 */
 #if 0
     add_string( "pixel-ratio", "1", PIXEL_RATIO_TEXT, PIXEL_RATIO_TEXT )
@@ -1738,6 +1762,9 @@ vlc_module_begin ()
     add_string( "http-host", NULL, HTTP_HOST_TEXT, HOST_LONGTEXT, true )
     add_integer( "http-port", 8080, HTTP_PORT_TEXT, HTTP_PORT_LONGTEXT, true )
         change_integer_range( 1, 65535 )
+    add_integer( "http-threads", 0, HTTP_THREADS_TEXT, HTTP_THREADS_LONGTEXT,
+                 true )
+        change_integer_range( 0, 64 )
     add_integer( "https-port", 8443, HTTPS_PORT_TEXT, HTTPS_PORT_LONGTEXT, true )
         change_integer_range( 1, 65535 )
     add_string( "rtsp-host", NULL, RTSP_HOST_TEXT, RTSP_HOST_LONGTEXT, true )
@@ -1866,6 +1893,11 @@ vlc_module_begin ()
                 CODEC_LONGTEXT, true )
     add_string( "encoder",  NULL, ENCODER_TEXT,
                 ENCODER_LONGTEXT, true )
+    add_bool( "decoder-pipeline", false, DEC_PIPELINE_TEXT,
+              DEC_PIPELINE_LONGTEXT, true )
+    add_integer_with_range( "decoder-pipeline-depth", 4, 1, 256,
+                            DEC_PIPELINE_DEPTH_TEXT,
+                            DEC_PIPELINE_DEPTH_LONGTEXT, true )
 
     set_subcategory( SUBCAT_INPUT_ACCESS )
     add_category_hint( N_("Input"), INPUT_CAT_LONGTEXT , false )
@@ -37,6 +37,7 @@
 #include <vlc_common.h>
 #include <vlc_block.h>
 #include <vlc_fs.h>
+#include <vlc_atomic.h>
 
 /**
  * @section Block handling functions.
@@ -97,14 +98,6 @@ void block_Init( block_t *restrict b, void *buf, size_t size )
 #endif
 }
 
-static void block_generic_Release (block_t *block)
-{
-    /* That is always true for blocks allocated with block_Alloc(). */
-    assert (block->p_start == (unsigned char *)(block + 1));
-    block_Invalidate (block);
-    free (block);
-}
-
 static void BlockMetaCopy( block_t *restrict out, const block_t *in )
 {
     out->p_next    = in->p_next;
@@ -126,19 +119,394 @@ static void BlockMetaCopy( block_t *restrict out, const block_t *in )
 /* Maximum size of reserved footer before shrinking with realloc(). */
 #define BLOCK_WASTE_SIZE   2048
 
+/**
+ * @section Block allocation cache
+ *
+ * block_Alloc() rounds its allocations up to size classes of 512 bytes to
+ * 256 KiB, in steps alternating between x1.5 and x1.33. Released buffers go
+ * to a magazine of the releasing thread, which exchanges half magazines
+ * with a shared depot when it gets empty or full. Most allocations thus
+ * take neither malloc() nor a lock, even when blocks are allocated and
+ * released by different threads.
+ *
+ * The idle buffers of the depot and of all the magazines add up to at most
+ * VLC_BLOCK_CACHE MiB (environment variable, 32 by default, 0 disables the
+ * cache), give or take what threads have not published yet. The magazines
+ * of one thread hold at most an eighth of that, and 1 MiB. See
+ * block_CacheStats().
+ */
+
+/* Allocation header, in front of the block_t, storing the size class */
+#define BLOCK_HEADER       BLOCK_ALIGN
+
+#define BLOCK_CLASSES      19
+#define BLOCK_CLASS_MIN    512
+
+/* Idle bytes per magazine, per size class */
+#define BLOCK_MAGAZINE     (256 << 10)
+
+/* Idle bytes per thread, all size classes together */
+#define BLOCK_THREAD       (1 << 20)
+
+/* Default cache size limit (MiB) */
+#define BLOCK_DEPOT        32
+
+enum
+{
+    BLOCK_CACHE_UNINIT,
+    BLOCK_CACHE_READY,
+    BLOCK_CACHE_DISABLED,
+};
+
+typedef struct block_idle_t
+{
+    struct block_idle_t *next;
+} block_idle_t;
+
+/* Per-thread magazines */
+typedef struct
+{
+    block_idle_t *first[BLOCK_CLASSES];
+    unsigned      count[BLOCK_CLASSES];
+    size_t        bytes;    /**< Idle bytes in the magazines */
+    size_t        reported; /**< Idle bytes accounted in the depot */
+    uint64_t      hits;
+    uint64_t      misses;
+    uint64_t      overflows;
+    unsigned      ops;
+} block_cache_t;
+
+static struct
+{
+    vlc_mutex_t     lock;
+    block_idle_t   *first[BLOCK_CLASSES];
+    size_t          bytes;           /**< Idle bytes in the depot */
+    size_t          limit;
+    size_t          thread_limit;    /**< Idle bytes limit per thread */
+    size_t          magazine_bytes;  /**< Idle bytes in all magazines */
+    uint64_t        hits;
+    uint64_t        misses;
+    uint64_t        overflows;
+    vlc_threadvar_t key;
+} depot = { .lock = VLC_STATIC_MUTEX, };
+
+static atomic_uint depot_state = ATOMIC_VAR_INIT(BLOCK_CACHE_UNINIT);
+
+static size_t BlockClassSize (unsigned i)
+{
+    return (size_t)((i & 1) ? 768 : 512) << (i >> 1);
+}
+
+/* Returns the smallest class of at least n bytes, or BLOCK_CLASSES */
+static unsigned BlockClass (size_t n)
+{
+    if (n <= BLOCK_CLASS_MIN)
+        return 0;
+    if (n > BlockClassSize (BLOCK_CLASSES - 1))
+        return BLOCK_CLASSES;
+
+    unsigned b = (sizeof (unsigned) * 8 - 1) - clz (n - 1); /* 2^b < n */
+    if (n <= (3u << (b - 1)))
+        return 2 * (b - 9) + 1;
+    return 2 * (b - 8);
+}
+
+/* Maximum number of idle buffers in a magazine */
+static unsigned BlockMagazineSize (unsigned i)
+{
+    size_t n = BLOCK_MAGAZINE / BlockClassSize (i);
+    return (n < 4) ? 4 : (n > 64) ? 64 : n;
+}
+
+/* Publishes the statistics of a thread (with the depot lock held) */
+static void BlockCacheFold (block_cache_t *c)
+{
+    depot.hits += c->hits;
+    depot.misses += c->misses;
+    depot.overflows += c->overflows;
+    depot.magazine_bytes += c->bytes - c->reported;
+    c->hits = c->misses = c->overflows = 0;
+    c->reported = c->bytes;
+}
+
+/* Moves n buffers of class i from a magazine to the depot, or frees them
+ * if the depot and the magazines together hold the cache limit */
+static void BlockCacheFlush (block_cache_t *c, unsigned i, unsigned n)
+{
+    const size_t size = BlockClassSize (i);
+    block_idle_t *freed = NULL;
+
+    vlc_mutex_lock (&depot.lock);
+    while (n-- > 0)
+    {
+        block_idle_t *idle = c->first[i];
+
+        c->first[i] = idle->next;
+        c->count[i]--;
+        c->bytes -= size;
+        BlockCacheFold (c);
+
+        if (depot.bytes + depot.magazine_bytes + size <= depot.limit)
+        {
+            idle->next = depot.first[i];
+            depot.first[i] = idle;
+            depot.bytes += size;
+        }
+        else
+        {
+            idle->next = freed;
+            freed = idle;
+            c->overflows++;
+        }
+    }
+    BlockCacheFold (c);
+    vlc_mutex_unlock (&depot.lock);
+
+    while (freed != NULL)
+    {
+        block_idle_t *next = freed->next;
+        free (freed);
+        freed = next;
+    }
+}
+
+/* Moves up to half a magazine of class i buffers from the depot */
+static void BlockCacheRefill (block_cache_t *c, unsigned i)
+{
+    const size_t size = BlockClassSize (i);
+    unsigned n = BlockMagazineSize (i) / 2;
+
+    vlc_mutex_lock (&depot.lock);
+    while (n-- > 0 && depot.first[i] != NULL)
+    {
+        block_idle_t *idle = depot.first[i];
+
+        depot.first[i] = idle->next;
+        depot.bytes -= size;
+        idle->next = c->first[i];
+        c->first[i] = idle;
+        c->count[i]++;
+        c->bytes += size;
+    }
+    BlockCacheFold (c);
+    vlc_mutex_unlock (&depot.lock);
+}
+
+/* Thread exit: gives all the buffers of the thread back to the depot */
+static void BlockCacheRelease (void *data)
+{
+    block_cache_t *c = data;
+
+    for (unsigned i = 0; i < BLOCK_CLASSES; i++)
+        if (c->count[i] > 0)
+            BlockCacheFlush (c, i, c->count[i]);
+
+    vlc_mutex_lock (&depot.lock);
+    BlockCacheFold (c);
+    vlc_mutex_unlock (&depot.lock);
+    free (c);
+}
+
+static unsigned BlockCacheSetup (void)
+{
+    unsigned state;
+
+    vlc_mutex_lock (&depot.lock);
+    state = atomic_load (&depot_state);
+    if (state == BLOCK_CACHE_UNINIT)
+    {
+        const char *env = getenv ("VLC_BLOCK_CACHE");
+
+        depot.limit = (size_t)((env != NULL) ? strtoul (env, NULL, 10)
+                                             : BLOCK_DEPOT) << 20;
+        depot.thread_limit = __MIN(depot.limit / 8, BLOCK_THREAD);
+        if (depot.limit > 0
+         && vlc_threadvar_create (&depot.key, BlockCacheRelease) == 0)
+            state = BLOCK_CACHE_READY;
+        else
+            state = BLOCK_CACHE_DISABLED;
+        atomic_store (&depot_state, state);
+    }
+    vlc_mutex_unlock (&depot.lock);
+    return state;
+}
+
+/* Returns the magazines of the calling thread, or NULL if disabled */
+static block_cache_t *BlockCacheSelf (void)
+{
+    unsigned state = atomic_load_explicit (&depot_state, memory_order_acquire);
+
+    if (unlikely(state == BLOCK_CACHE_UNINIT))
+        state = BlockCacheSetup ();
+    if (state != BLOCK_CACHE_READY)
+        return NULL;
+
+    block_cache_t *c = vlc_threadvar_get (depot.key);
+    if (unlikely(c == NULL))
+    {
+        c = calloc (1, sizeof (*c));
+        if (unlikely(c == NULL))
+            return NULL;
+        if (vlc_threadvar_set (depot.key, c))
+        {
+            free (c);
+            return NULL;
+        }
+    }
+
+    /* Keep the published statistics reasonably fresh */
+    if ((++c->ops & 1023) == 0)
+    {
+        vlc_mutex_lock (&depot.lock);
+        BlockCacheFold (c);
+        vlc_mutex_unlock (&depot.lock);
+    }
+    return c;
+}
+
+static void *BlockCacheGet (unsigned i)
+{
+    block_cache_t *c = BlockCacheSelf ();
+
+    if (c != NULL)
+    {
+        if (c->count[i] == 0)
+            BlockCacheRefill (c, i);
+
+        block_idle_t *idle = c->first[i];
+        if (idle != NULL)
+        {
+            c->first[i] = idle->next;
+            c->count[i]--;
+            c->bytes -= BlockClassSize (i);
+            c->hits++;
+            return idle;
+        }
+        c->misses++;
+    }
+    return malloc (BlockClassSize (i));
+}
+
+static void BlockCachePut (void *base, unsigned i)
+{
+    block_cache_t *c = BlockCacheSelf ();
+
+    if (c == NULL)
+    {
+        free (base);
+        return;
+    }
+
+    block_idle_t *idle = base;
+
+    idle->next = c->first[i];
+    c->first[i] = idle;
+    c->count[i]++;
+    c->bytes += BlockClassSize (i);
+    if (c->count[i] > BlockMagazineSize (i))
+        BlockCacheFlush (c, i, c->count[i] / 2);
+
+    /* Over the thread limit, give this class back, then the others */
+    for (unsigned j = 0; c->bytes > depot.thread_limit && j <= BLOCK_CLASSES;
+         j++)
+    {
+        unsigned k = (j == 0) ? i : j - 1;
+        if (c->count[k] > 0)
+            BlockCacheFlush (c, k, c->count[k]);
+    }
+}
+
+/* Library unload: frees the depot and the magazines of the calling thread.
+ * Those of other threads are leaked, their destructor cannot run anymore. */
+__attribute__((destructor))
+static void BlockCacheUnload (void)
+{
+    if (atomic_load (&depot_state) != BLOCK_CACHE_READY)
+        return;
+
+    block_cache_t *c = vlc_threadvar_get (depot.key);
+    block_idle_t *freed = NULL;
+
+    vlc_mutex_lock (&depot.lock);
+    atomic_store (&depot_state, BLOCK_CACHE_DISABLED);
+    depot.limit = 0;
+    for (unsigned i = 0; i < BLOCK_CLASSES; i++)
+        while (depot.first[i] != NULL)
+        {
+            block_idle_t *idle = depot.first[i];
+
+            depot.first[i] = idle->next;
+            idle->next = freed;
+            freed = idle;
+        }
+    depot.bytes = 0;
+    vlc_mutex_unlock (&depot.lock);
+
+    if (c != NULL)
+    {
+        vlc_threadvar_set (depot.key, NULL);
+        BlockCacheRelease (c);
+    }
+    vlc_threadvar_delete (&depot.key);
+
+    while (freed != NULL)
+    {
+        block_idle_t *next = freed->next;
+        free (freed);
+        freed = next;
+    }
+}
+
+/**
+ * Reports the statistics of the block_Alloc() cache.
+ * The counters of each thread are published every few hundred
+ * allocations, so they lag slightly behind.
+ */
+void block_CacheStats (block_cache_stats_t *st)
+{
+    vlc_mutex_lock (&depot.lock);
+    st->i_hits = depot.hits;
+    st->i_misses = depot.misses;
+    st->i_overflows = depot.overflows;
+    st->i_resident = depot.bytes + depot.magazine_bytes;
+    st->i_limit = depot.limit;
+    vlc_mutex_unlock (&depot.lock);
+}
+
+static void block_generic_Release (block_t *block)
+{
+    /* That is always true for blocks allocated with block_Alloc(). */
+    assert (block->p_start == (unsigned char *)(block + 1));
+    block_Invalidate (block);
+
+    unsigned char *base = ((unsigned char *)block) - BLOCK_HEADER;
+    unsigned i_class;
+
+    memcpy (&i_class, base, sizeof (i_class));
+    if (i_class < BLOCK_CLASSES)
+        BlockCachePut (base, i_class);
+    else
+        free (base);
+}
+
 block_t *block_Alloc (size_t size)
 {
     /* 2 * BLOCK_PADDING: pre + post padding */
-    const size_t alloc = sizeof (block_t) + BLOCK_ALIGN + (2 * BLOCK_PADDING)
-                       + size;
+    const size_t alloc = BLOCK_HEADER + sizeof (block_t) + BLOCK_ALIGN
+                       + (2 * BLOCK_PADDING) + size;
     if (unlikely(alloc <= size))
         return NULL;
 
-    block_t *b = malloc (alloc);
-    if (unlikely(b == NULL))
+    unsigned i_class = BlockClass (alloc);
+    unsigned char *base = (i_class < BLOCK_CLASSES) ? BlockCacheGet (i_class)
+                                                    : malloc (alloc);
+    if (unlikely(base == NULL))
         return NULL;
+    memcpy (base, &i_class, sizeof (i_class));
+
+    block_t *b = (block_t *)(base + BLOCK_HEADER);
 
-    block_Init (b, b + 1, alloc - sizeof (*b));
+    block_Init (b, b + 1, alloc - BLOCK_HEADER - sizeof (*b));
     static_assert ((BLOCK_PADDING % BLOCK_ALIGN) == 0,
                    "BLOCK_PADDING must be a multiple of BLOCK_ALIGN");
     b->p_buffer += BLOCK_PADDING + BLOCK_ALIGN - 1;
@@ -506,6 +874,23 @@ block_t *block_FilePath (const char *path)
  * @section Thread-safe block queue functions
  */
 
+#define FIFO_SEGMENT_SLOTS 254
+
+/**
+ * Ring segment of a single producer, single consumer queue. Each slot holds
+ * the block list queued by one block_FifoPut() call. The producer fills the
+ * slots in order and publishes them through the written counter; once the
+ * segment is full, it chains a new one and never touches the old one again,
+ * so that the consumer can free it after reading it entirely.
+ */
+typedef struct block_fifo_segment_t
+{
+    atomic_uintptr_t next;     /**< Next segment (set by the producer) */
+    atomic_uint      written;  /**< Published slots (set by the producer) */
+    unsigned         read;     /**< Consumed slots (consumer only) */
+    block_t         *slots[FIFO_SEGMENT_SLOTS];
+} block_fifo_segment_t;
+
 /**
  * Internal state for block queues
  */
@@ -520,14 +905,53 @@ struct block_fifo_t
     size_t              i_depth;
     size_t              i_size;
     bool          b_force_wake;
+
+    /* Lock-free single producer, single consumer variant: the lock and
+     * condition variables are only used to sleep and to wake sleepers. */
+    bool                 b_spsc;
+    block_fifo_segment_t *p_head;  /**< Written segment (producer only) */
+    block_fifo_segment_t *p_tail;  /**< Read segment (consumer only) */
+    atomic_size_t        depth;
+    atomic_size_t        size;
+    atomic_bool          waiting;      /**< Consumer sleeps on wait */
+    atomic_bool          waiting_room; /**< Producer sleeps on wait_room */
+    atomic_bool          force_wake;
 };
 
-block_fifo_t *block_FifoNew( void )
+static block_fifo_segment_t *FifoSegmentNew( void )
+{
+    block_fifo_segment_t *seg = malloc( sizeof( *seg ) );
+    if( unlikely(seg == NULL) )
+        return NULL;
+
+    atomic_init( &seg->next, (uintptr_t)NULL );
+    atomic_init( &seg->written, 0 );
+    seg->read = 0;
+    return seg;
+}
+
+static block_fifo_t *FifoNew( bool b_spsc )
 {
     block_fifo_t *p_fifo = malloc( sizeof( block_fifo_t ) );
     if( !p_fifo )
         return NULL;
 
+    p_fifo->b_spsc = b_spsc;
+    if( b_spsc )
+    {
+        p_fifo->p_head = p_fifo->p_tail = FifoSegmentNew();
+        if( unlikely(p_fifo->p_head == NULL) )
+        {
+            free( p_fifo );
+            return NULL;
+        }
+        atomic_init( &p_fifo->depth, 0 );
+        atomic_init( &p_fifo->size, 0 );
+        atomic_init( &p_fifo->waiting, false );
+        atomic_init( &p_fifo->waiting_room, false );
+        atomic_init( &p_fifo->force_wake, false );
+    }
+
     vlc_mutex_init( &p_fifo->lock );
     vlc_cond_init( &p_fifo->wait );
     vlc_cond_init( &p_fifo->wait_room );
@@ -539,9 +963,81 @@ block_fifo_t *block_FifoNew( void )
     return p_fifo;
 }
 
+block_fifo_t *block_FifoNew( void )
+{
+    return FifoNew( false );
+}
+
+/**
+ * Creates a block queue for exactly one producer thread and one consumer
+ * thread. It has the same semantics as a queue from block_FifoNew(), but
+ * queuing and dequeuing do not take any lock unless the other side sleeps.
+ *
+ * block_FifoPut(), block_FifoPace() and block_FifoWake() must only be
+ * called from the producer thread; block_FifoGet(), block_FifoShow() and
+ * block_FifoEmpty() only from the consumer thread. block_FifoRelease()
+ * requires that both threads are done with the queue.
+ */
+block_fifo_t *block_FifoNewSPSC( void )
+{
+    return FifoNew( true );
+}
+
+/* Returns the first queued block, or NULL if none is visible yet
+ * (consumer side) */
+static block_t *FifoSPSCPeek( block_fifo_t *p_fifo )
+{
+    block_fifo_segment_t *seg = p_fifo->p_tail;
+
+    for( ;; )
+    {
+        if( seg->read < atomic_load( &seg->written ) )
+            return seg->slots[seg->read];
+        if( seg->read < FIFO_SEGMENT_SLOTS )
+            return NULL;
+
+        /* Segment exhausted: the producer has moved on, if at all */
+        block_fifo_segment_t *next =
+            (block_fifo_segment_t *)atomic_load( &seg->next );
+        if( next == NULL )
+            return NULL;
+        p_fifo->p_tail = next;
+        free( seg );
+        seg = next;
+    }
+}
+
+/* Dequeues the block returned by FifoSPSCPeek() (consumer side) */
+static void FifoSPSCTake( block_fifo_t *p_fifo, block_t *b )
+{
+    block_fifo_segment_t *seg = p_fifo->p_tail;
+
+    if( b->p_next != NULL )
+        seg->slots[seg->read] = b->p_next;
+    else
+        seg->read++;
+    b->p_next = NULL;
+
+    atomic_fetch_sub( &p_fifo->depth, 1 );
+    atomic_fetch_sub( &p_fifo->size, b->i_buffer );
+}
+
+/* Wakes the producer up if it waits in block_FifoPace() (consumer side) */
+static void FifoSPSCSignalRoom( block_fifo_t *p_fifo )
+{
+    if( atomic_load( &p_fifo->waiting_room ) )
+    {
+        vlc_mutex_lock( &p_fifo->lock );
+        vlc_cond_broadcast( &p_fifo->wait_room );
+        vlc_mutex_unlock( &p_fifo->lock );
+    }
+}
+
 void block_FifoRelease( block_fifo_t *p_fifo )
 {
     block_FifoEmpty( p_fifo );
+    if( p_fifo->b_spsc )
+        free( p_fifo->p_tail );
     vlc_cond_destroy( &p_fifo->wait_room );
     vlc_cond_destroy( &p_fifo->wait );
     vlc_mutex_destroy( &p_fifo->lock );
@@ -552,6 +1048,17 @@ void block_FifoEmpty( block_fifo_t *p_fifo )
 {
     block_t *block;
 
+    if( p_fifo->b_spsc )
+    {
+        while( (block = FifoSPSCPeek( p_fifo )) != NULL )
+        {
+            FifoSPSCTake( p_fifo, block );
+            block_Release( block );
+        }
+        FifoSPSCSignalRoom( p_fifo );
+        return;
+    }
+
     vlc_mutex_lock( &p_fifo->lock );
     block = p_fifo->p_first;
     if (block != NULL)
@@ -594,6 +1101,26 @@ void block_FifoPace (block_fifo_t *fifo, size_t max_depth, size_t max_size)
 {
     vlc_testcancel ();
 
+    if (fifo->b_spsc)
+    {
+        if (atomic_load (&fifo->depth) <= max_depth
+         && atomic_load (&fifo->size) <= max_size)
+            return;
+
+        vlc_mutex_lock (&fifo->lock);
+        atomic_store (&fifo->waiting_room, true);
+        while ((atomic_load (&fifo->depth) > max_depth)
+            || (atomic_load (&fifo->size) > max_size))
+        {
+             mutex_cleanup_push (&fifo->lock);
+             vlc_cond_wait (&fifo->wait_room, &fifo->lock);
+             vlc_cleanup_pop ();
+        }
+        atomic_store (&fifo->waiting_room, false);
+        vlc_mutex_unlock (&fifo->lock);
+        return;
+    }
+
     vlc_mutex_lock (&fifo->lock);
     while ((fifo->i_depth > max_depth) || (fifo->i_size > max_size))
     {
@@ -625,6 +1152,40 @@ size_t block_FifoPut( block_fifo_t *p_fifo, block_t *p_block )
             break;
     }
 
+    if (p_fifo->b_spsc)
+    {
+        block_fifo_segment_t *seg = p_fifo->p_head;
+        unsigned i_slot = atomic_load (&seg->written);
+
+        if (i_slot == FIFO_SEGMENT_SLOTS)
+        {
+            block_fifo_segment_t *next = FifoSegmentNew ();
+            if (unlikely(next == NULL))
+            {
+                block_ChainRelease (p_block);
+                return 0;
+            }
+            /* The consumer owns (and frees) the full segment from now on */
+            atomic_store (&seg->next, (uintptr_t)next);
+            p_fifo->p_head = seg = next;
+            i_slot = 0;
+        }
+
+        /* Account first, so that the counters never go below zero */
+        atomic_fetch_add (&p_fifo->depth, i_depth);
+        atomic_fetch_add (&p_fifo->size, i_size);
+        seg->slots[i_slot] = p_block;
+        atomic_store (&seg->written, i_slot + 1);
+
+        if (atomic_load (&p_fifo->waiting))
+        {
+            vlc_mutex_lock (&p_fifo->lock);
+            vlc_cond_signal (&p_fifo->wait);
+            vlc_mutex_unlock (&p_fifo->lock);
+        }
+        return i_size;
+    }
+
     vlc_mutex_lock (&p_fifo->lock);
     *p_fifo->pp_last = p_block;
     p_fifo->pp_last = &p_last->p_next;
@@ -640,7 +1201,12 @@ size_t block_FifoPut( block_fifo_t *p_fifo, block_t *p_block )
 void block_FifoWake( block_fifo_t *p_fifo )
 {
     vlc_mutex_lock( &p_fifo->lock );
-    if( p_fifo->p_first == NULL )
+    if( p_fifo->b_spsc )
+    {
+        if( atomic_load( &p_fifo->depth ) == 0 )
+            atomic_store( &p_fifo->force_wake, true );
+    }
+    else if( p_fifo->p_first == NULL )
         p_fifo->b_force_wake = true;
     vlc_cond_broadcast( &p_fifo->wait );
     vlc_mutex_unlock( &p_fifo->lock );
@@ -658,6 +1224,31 @@ block_t *block_FifoGet( block_fifo_t *p_fifo )
 
     vlc_testcancel( );
 
+    if( p_fifo->b_spsc )
+    {
+        b = FifoSPSCPeek( p_fifo );
+        if( b == NULL )
+        {
+            vlc_mutex_lock( &p_fifo->lock );
+            mutex_cleanup_push( &p_fifo->lock );
+            atomic_store( &p_fifo->waiting, true );
+            while( (b = FifoSPSCPeek( p_fifo )) == NULL
+                && !atomic_load( &p_fifo->force_wake ) )
+                vlc_cond_wait( &p_fifo->wait, &p_fifo->lock );
+            atomic_store( &p_fifo->waiting, false );
+            vlc_cleanup_run( );
+        }
+
+        if( atomic_load( &p_fifo->force_wake ) )
+            atomic_store( &p_fifo->force_wake, false );
+        if( b == NULL )
+            return NULL; /* Forced wakeup */
+
+        FifoSPSCTake( p_fifo, b );
+        FifoSPSCSignalRoom( p_fifo );
+        return b;
+    }
+
     vlc_mutex_lock( &p_fifo->lock );
     mutex_cleanup_push( &p_fifo->lock );
 
@@ -711,6 +1302,22 @@ block_t *block_FifoShow( block_fifo_t *p_fifo )
 
     vlc_testcancel( );
 
+    if( p_fifo->b_spsc )
+    {
+        b = FifoSPSCPeek( p_fifo );
+        if( b == NULL )
+        {
+            vlc_mutex_lock( &p_fifo->lock );
+            mutex_cleanup_push( &p_fifo->lock );
+            atomic_store( &p_fifo->waiting, true );
+            while( (b = FifoSPSCPeek( p_fifo )) == NULL )
+                vlc_cond_wait( &p_fifo->wait, &p_fifo->lock );
+            atomic_store( &p_fifo->waiting, false );
+            vlc_cleanup_run( );
+        }
+        return b;
+    }
+
     vlc_mutex_lock( &p_fifo->lock );
     mutex_cleanup_push( &p_fifo->lock );
 
@@ -726,11 +1333,15 @@ block_t *block_FifoShow( block_fifo_t *p_fifo )
 /* FIXME: not thread-safe */
 size_t block_FifoSize( const block_fifo_t *p_fifo )
 {
+    if( p_fifo->b_spsc )
+        return atomic_load( &((block_fifo_t *)p_fifo)->size );
     return p_fifo->i_size;
 }
 
 /* FIXME: not thread-safe */
 size_t block_FifoCount( const block_fifo_t *p_fifo )
 {
+    if( p_fifo->b_spsc )
+        return atomic_load( &((block_fifo_t *)p_fifo)->depth );
     return p_fifo->i_depth;
 }
@@ -25,6 +25,8 @@
 # include "config.h"
 #endif
 
+#include <assert.h>
+
 #include <vlc_common.h>
 #include <libvlc.h>
 #include <vlc_filter.h>
@@ -111,6 +113,157 @@ void filter_DeleteBlend( filter_t *p_blend )
     vlc_object_release( p_blend );
 }
 
+/* */
+struct filter_slices_t
+{
+    vlc_mutex_t lock;
+    vlc_cond_t  wait;       /* Signaled when slices are queued */
+    vlc_cond_t  done;       /* Signaled when the last slice completes */
+    bool        b_abort;
+
+    /* Current job */
+    filter_slice_cb_t pf_slice;
+    void        *p_data;
+    unsigned    i_next;     /* Next slice to run */
+    unsigned    i_slices;   /* Number of slices queued, 0 if idle */
+    unsigned    i_pending;  /* Slices not completed yet */
+
+    unsigned    i_threads;
+    vlc_thread_t threads[];
+};
+
+/* Runs the queued slices until there are none left. The lock must be held. */
+static void SlicesProcess( filter_slices_t *p_slices )
+{
+    while( p_slices->i_next < p_slices->i_slices )
+    {
+        const unsigned i_slice = p_slices->i_next++;
+        const unsigned i_slices = p_slices->i_slices;
+        filter_slice_cb_t pf_slice = p_slices->pf_slice;
+        void *p_data = p_slices->p_data;
+
+        vlc_mutex_unlock( &p_slices->lock );
+        pf_slice( p_data, i_slice, i_slices );
+        vlc_mutex_lock( &p_slices->lock );
+
+        if( --p_slices->i_pending == 0 )
+            vlc_cond_signal( &p_slices->done );
+    }
+}
+
+static void *SlicesThread( void *p_data )
+{
+    filter_slices_t *p_slices = p_data;
+    int canc = vlc_savecancel();
+
+    vlc_mutex_lock( &p_slices->lock );
+    while( !p_slices->b_abort )
+    {
+        if( p_slices->i_next < p_slices->i_slices )
+            SlicesProcess( p_slices );
+        else
+            vlc_cond_wait( &p_slices->wait, &p_slices->lock );
+    }
+    vlc_mutex_unlock( &p_slices->lock );
+
+    vlc_restorecancel( canc );
+    return NULL;
+}
+
+#undef filter_NewSlices
+filter_slices_t *filter_NewSlices( vlc_object_t *p_this )
+{
+    int i_count = var_InheritInteger( p_this, "filter-threads" );
+    if( i_count <= 0 )
+        i_count = vlc_GetCPUCount();
+    if( i_count <= 1 )
+        return NULL;
+
+    /* The calling thread runs one of the slices */
+    const unsigned i_threads = i_count - 1;
+    filter_slices_t *p_slices = malloc( sizeof( *p_slices )
+                                        + i_threads * sizeof( vlc_thread_t ) );
+    if( !p_slices )
+        return NULL;
+
+    vlc_mutex_init( &p_slices->lock );
+    vlc_cond_init( &p_slices->wait );
+    vlc_cond_init( &p_slices->done );
+    p_slices->b_abort = false;
+    p_slices->pf_slice = NULL;
+    p_slices->p_data = NULL;
+    p_slices->i_next = 0;
+    p_slices->i_slices = 0;
+    p_slices->i_pending = 0;
+
+    for( p_slices->i_threads = 0; p_slices->i_threads < i_threads;
+         p_slices->i_threads++ )
+    {
+        if( vlc_clone( &p_slices->threads[p_slices->i_threads], SlicesThread,
+                       p_slices, VLC_THREAD_PRIORITY_VIDEO ) )
+            break;
+    }
+    if( p_slices->i_threads == 0 )
+    {
+        filter_DeleteSlices( p_slices );
+        return NULL;
+    }
+
+    msg_Dbg( p_this, "using %u slice threads", p_slices->i_threads + 1 );
+    return p_slices;
+}
+
+unsigned filter_CountSlices( const filter_slices_t *p_slices )
+{
+    return p_slices ? p_slices->i_threads + 1 : 1;
+}
+
+void filter_RunSlices( filter_slices_t *p_slices, filter_slice_cb_t pf_slice,
+                       void *p_data )
+{
+    if( !p_slices )
+    {
+        pf_slice( p_data, 0, 1 );
+        return;
+    }
+
+    vlc_mutex_lock( &p_slices->lock );
+    assert( p_slices->i_pending == 0 );
+    p_slices->pf_slice = pf_slice;
+    p_slices->p_data = p_data;
+    p_slices->i_next = 0;
+    p_slices->i_slices =
+    p_slices->i_pending = p_slices->i_threads + 1;
+    vlc_cond_broadcast( &p_slices->wait );
+
+    SlicesProcess( p_slices );
+    while( p_slices->i_pending > 0 )
+        vlc_cond_wait( &p_slices->done, &p_slices->lock );
+
+    p_slices->i_slices = 0;
+    p_slices->i_next = 0;
+    vlc_mutex_unlock( &p_slices->lock );
+}
+
+void filter_DeleteSlices( filter_slices_t *p_slices )
+{
+    if( !p_slices )
+        return;
+
+    vlc_mutex_lock( &p_slices->lock );
+    p_slices->b_abort = true;
+    vlc_cond_broadcast( &p_slices->wait );
+    vlc_mutex_unlock( &p_slices->lock );
+
+    for( unsigned i = 0; i < p_slices->i_threads; i++ )
+        vlc_join( p_slices->threads[i], NULL );
+
+    vlc_cond_destroy( &p_slices->done );
+    vlc_cond_destroy( &p_slices->wait );
+    vlc_mutex_destroy( &p_slices->lock );
+    free( p_slices );
+}
+
 /* */
 #include <vlc_video_splitter.h>
 
@@ -40,6 +40,7 @@
 #include <vlc_url.h>
 #include <vlc_mime.h>
 #include <vlc_block.h>
+#include <vlc_atomic.h>
 #include "../libvlc.h"
 
 #include <string.h>
@@ -49,11 +50,17 @@
 #ifdef HAVE_POLL
 # include <poll.h>
 #endif
+#ifdef HAVE_EPOLL_CREATE1
+# include <fcntl.h>
+# include <sys/epoll.h>
+# include <sys/eventfd.h>
+#endif
 
 #if defined(_WIN32)
 #   include <winsock2.h>
 #else
 #   include <sys/socket.h>
+#   include <sys/uio.h>
 #endif
 
 #if defined(_WIN32)
@@ -63,8 +70,12 @@
 #define HTTPD_CL_BUFSIZE 10000
 #endif
 
+/* maximum number of stream chunks a client sends at once */
+#define HTTPD_CL_CHUNKS 32
+
 static void httpd_ClientClean(httpd_client_t *cl);
-static void httpd_AppendData(httpd_stream_t *stream, uint8_t *p_data, int i_data);
+
+typedef struct httpd_worker_t httpd_worker_t;
 
 /* each host run in his own thread */
 struct httpd_host_t
@@ -93,6 +104,10 @@ struct httpd_host_t
     int            i_client;
     httpd_client_t **client;
 
+    /* epoll threads (instead of the polling thread and client table) */
+    unsigned       i_workers;
+    httpd_worker_t *workers;
+
     /* TLS data */
     vlc_tls_creds_t *p_tls;
 };
@@ -113,6 +128,8 @@ struct httpd_url_t
         httpd_callback_t     cb;
         httpd_callback_sys_t *p_sys;
     } catch[HTTPD_MSG_MAX];
+
+    atomic_uint i_wake; /* bumped when new stream data is available */
 };
 
 /* status */
@@ -169,10 +186,46 @@ struct httpd_client_t
     httpd_message_t query;  /* client -> httpd */
     httpd_message_t answer; /* httpd -> client */
 
+    /* stream data being sent, shared with the other clients of the stream */
+    block_t *pp_chunk[HTTPD_CL_CHUNKS];
+    unsigned i_chunks;
+    size_t   i_chunk_offset;    /* bytes already sent from the first chunk */
+
     /* TLS data */
     vlc_tls_t *p_tls;
+
+    /* epoll thread serving the client, and its list of clients */
+    httpd_client_t *prev, *next;
+    bool     b_waiting;
+    uint32_t i_events;
+    unsigned i_wake;    /* url i_wake value when last checked for data */
 };
 
+#ifdef HAVE_EPOLL_CREATE1
+/* Each epoll thread accepts connections from the shared listening sockets,
+ * and then serves them on its own. Client I/O is done without any lock.
+ * The worker lock is taken to change the client lists and to use the url
+ * of a client. The host lock is only taken on top of it to look up the url
+ * of a new request and to call its callbacks. Clients waiting for stream
+ * data are woken through the eventfd when the stream gets new data. */
+struct httpd_worker_t
+{
+    httpd_host_t   *host;
+    vlc_thread_t    thread;
+    vlc_mutex_t     lock;
+    int             epfd;
+    int             wakefd;
+    atomic_bool     b_wake;  /* a wake up is pending on wakefd */
+
+    httpd_client_t *active;  /* receiving, sending or TLS handshaking */
+    httpd_client_t *waiting; /* waiting for more stream data */
+    mtime_t         i_sweep; /* next check of the client timeouts */
+};
+
+static void httpd_WorkerDetachUrl(httpd_worker_t *, httpd_url_t *);
+static void httpd_WorkersWake(httpd_host_t *);
+#endif
+
 
 /*****************************************************************************
  * Various functions
@@ -611,17 +664,82 @@ struct httpd_stream_t
     bool        b_has_keyframes;
     int64_t     i_last_keyframe_seen_pos;
 
-    /* circular buffer */
-    int         i_buffer_size;      /* buffer size, can't be reallocated smaller */
-    uint8_t     *p_buffer;          /* buffer */
+    /* circular buffer of the last chunks, oldest first. Clients hold
+     * references to the chunks they send, so they are never copied. */
+    int         i_buffer_size;      /* maximum size of the chunks in bytes */
     int64_t     i_buffer_pos;       /* absolute position from begining */
     int64_t     i_buffer_last_pos;  /* a new connection will start with that */
+    block_t     **pp_chunk;
+    unsigned    i_chunk_max;        /* allocated slots, power of two */
+    unsigned    i_chunk_first;
+    unsigned    i_chunks;
+    int64_t     i_chunk_bytes;
 
     /* custom headers */
     size_t        i_http_headers;
     httpd_header * p_http_headers;
 };
 
+/* Stream data chunk, with the data right after it */
+typedef struct
+{
+    block_t     self;
+    atomic_uint refs;
+    int64_t     i_pos;  /* absolute stream position of the first byte */
+} httpd_chunk_t;
+
+static void httpd_ChunkRelease(block_t *block)
+{
+    httpd_chunk_t *chunk = (httpd_chunk_t *)block;
+
+    if (atomic_fetch_sub(&chunk->refs, 1) == 1)
+        free(chunk);
+}
+
+static block_t *httpd_ChunkHold(block_t *block)
+{
+    atomic_fetch_add(&((httpd_chunk_t *)block)->refs, 1);
+    return block;
+}
+
+static block_t *httpd_ChunkNew(const block_t *p_block, int64_t i_pos)
+{
+    httpd_chunk_t *chunk = malloc(sizeof (*chunk) + p_block->i_buffer);
+    if (unlikely(chunk == NULL))
+        return NULL;
+
+    block_Init(&chunk->self, chunk + 1, p_block->i_buffer);
+    chunk->self.pf_release = httpd_ChunkRelease;
+    atomic_init(&chunk->refs, 1);
+    chunk->i_pos = i_pos;
+    memcpy(chunk->self.p_buffer, p_block->p_buffer, p_block->i_buffer);
+    return &chunk->self;
+}
+
+static inline httpd_chunk_t *httpd_StreamChunk(const httpd_stream_t *stream,
+                                               unsigned i)
+{
+    i = (stream->i_chunk_first + i) & (stream->i_chunk_max - 1);
+    return (httpd_chunk_t *)stream->pp_chunk[i];
+}
+
+/* Finds the chunk containing the given stream position (stream lock held) */
+static unsigned httpd_StreamFindChunk(const httpd_stream_t *stream,
+                                      int64_t i_pos)
+{
+    unsigned lo = 0, hi = stream->i_chunks;
+
+    while (hi - lo > 1) {
+        unsigned mid = (lo + hi) / 2;
+
+        if (httpd_StreamChunk(stream, mid)->i_pos <= i_pos)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
 static int httpd_StreamCallBack(httpd_callback_sys_t *p_sys,
                                  httpd_client_t *cl, httpd_message_t *answer,
                                  const httpd_message_t *query)
@@ -632,46 +750,46 @@ static int httpd_StreamCallBack(httpd_callback_sys_t *p_sys,
         return VLC_SUCCESS;
 
     if (answer->i_body_offset > 0) {
-        int     i_pos;
-
-        if (answer->i_body_offset >= stream->i_buffer_pos)
+        vlc_mutex_lock(&stream->lock);
+        if (answer->i_body_offset >= stream->i_buffer_pos) {
+            vlc_mutex_unlock(&stream->lock);
             return VLC_EGENERIC;    /* wait, no data available */
+        }
 
         if (cl->i_keyframe_wait_to_pass >= 0) {
-            if (stream->i_last_keyframe_seen_pos <= cl->i_keyframe_wait_to_pass)
+            if (stream->i_last_keyframe_seen_pos <= cl->i_keyframe_wait_to_pass) {
                 /* still waiting for the next keyframe */
+                vlc_mutex_unlock(&stream->lock);
                 return VLC_EGENERIC;
+            }
 
             /* seek to the new keyframe */
             answer->i_body_offset = stream->i_last_keyframe_seen_pos;
             cl->i_keyframe_wait_to_pass = -1;
         }
 
-        if (answer->i_body_offset + stream->i_buffer_size < stream->i_buffer_pos)
+        if (answer->i_body_offset < httpd_StreamChunk(stream, 0)->i_pos)
             answer->i_body_offset = stream->i_buffer_last_pos; /* this client isn't fast enough */
 
-        i_pos   = answer->i_body_offset % stream->i_buffer_size;
-        int64_t i_write = stream->i_buffer_pos - answer->i_body_offset;
+        /* Hand out references to the chunks, the data is sent from there */
+        unsigned i = httpd_StreamFindChunk(stream, answer->i_body_offset);
 
-        if (i_write > HTTPD_CL_BUFSIZE)
-            i_write = HTTPD_CL_BUFSIZE;
-        else if (i_write <= 0)
-            return VLC_EGENERIC;    /* wait, no data available */
+        assert(cl->i_chunks == 0);
+        cl->i_chunk_offset = answer->i_body_offset
+                           - httpd_StreamChunk(stream, i)->i_pos;
+        while (i < stream->i_chunks && cl->i_chunks < HTTPD_CL_CHUNKS) {
+            httpd_chunk_t *chunk = httpd_StreamChunk(stream, i++);
 
-        /* Don't go past the end of the circular buffer */
-        i_write = __MIN(i_write, stream->i_buffer_size - i_pos);
+            cl->pp_chunk[cl->i_chunks++] = httpd_ChunkHold(&chunk->self);
+            answer->i_body_offset = chunk->i_pos + chunk->self.i_buffer;
+        }
+        vlc_mutex_unlock(&stream->lock);
 
         /* using HTTPD_MSG_ANSWER -> data available */
         answer->i_proto  = HTTPD_PROTO_HTTP;
         answer->i_version= 0;
         answer->i_type   = HTTPD_MSG_ANSWER;
 
-        answer->i_body = i_write;
-        answer->p_body = xmalloc(i_write);
-        memcpy(answer->p_body, &stream->p_buffer[i_pos], i_write);
-
-        answer->i_body_offset += i_write;
-
         return VLC_SUCCESS;
     } else {
         answer->i_proto  = HTTPD_PROTO_HTTP;
@@ -766,7 +884,11 @@ httpd_stream_t *httpd_StreamNew(httpd_host_t *host,
     stream->i_header = 0;
     stream->p_header = NULL;
     stream->i_buffer_size = 5000000;    /* 5 Mo per stream */
-    stream->p_buffer = xmalloc(stream->i_buffer_size);
+    stream->i_chunk_max = 256;
+    stream->pp_chunk = xmalloc(stream->i_chunk_max * sizeof (block_t *));
+    stream->i_chunk_first = 0;
+    stream->i_chunks = 0;
+    stream->i_chunk_bytes = 0;
     /* We set to 1 to make life simpler
      * (this way i_body_offset can never be 0) */
     stream->i_buffer_pos = 1;
@@ -802,31 +924,50 @@ int httpd_StreamHeader(httpd_stream_t *stream, uint8_t *p_data, int i_data)
     return VLC_SUCCESS;
 }
 
-static void httpd_AppendData(httpd_stream_t *stream, uint8_t *p_data, int i_data)
+static void httpd_AppendChunk(httpd_stream_t *stream, block_t *chunk)
 {
-    int i_pos = stream->i_buffer_pos % stream->i_buffer_size;
-    int i_count = i_data;
-    while (i_count > 0) {
-        int i_copy = __MIN(i_count, stream->i_buffer_size - i_pos);
+    /* drop the oldest chunks, the clients still using them hold them */
+    while (stream->i_chunks > 0
+        && stream->i_chunk_bytes + chunk->i_buffer > (size_t)stream->i_buffer_size) {
+        block_t *old = &httpd_StreamChunk(stream, 0)->self;
+
+        stream->i_chunk_bytes -= old->i_buffer;
+        stream->i_chunk_first = (stream->i_chunk_first + 1)
+                              & (stream->i_chunk_max - 1);
+        stream->i_chunks--;
+        block_Release(old);
+    }
 
-        /* Ok, we can't go past the end of our buffer */
-        memcpy(&stream->p_buffer[i_pos], p_data, i_copy);
+    if (stream->i_chunks == stream->i_chunk_max) {
+        block_t **pp_chunk = xmalloc(2 * stream->i_chunk_max * sizeof (block_t *));
 
-        i_pos = (i_pos + i_copy) % stream->i_buffer_size;
-        i_count -= i_copy;
-        p_data  += i_copy;
+        for (unsigned i = 0; i < stream->i_chunks; i++)
+            pp_chunk[i] = &httpd_StreamChunk(stream, i)->self;
+        free(stream->pp_chunk);
+        stream->pp_chunk = pp_chunk;
+        stream->i_chunk_max *= 2;
+        stream->i_chunk_first = 0;
     }
 
-    stream->i_buffer_pos += i_data;
+    stream->pp_chunk[(stream->i_chunk_first + stream->i_chunks++)
+                     & (stream->i_chunk_max - 1)] = chunk;
+    stream->i_chunk_bytes += chunk->i_buffer;
+    stream->i_buffer_pos += chunk->i_buffer;
 }
 
 int httpd_StreamSend(httpd_stream_t *stream, const block_t *p_block)
 {
-    if (!p_block || !p_block->p_buffer)
+    if (!p_block || !p_block->p_buffer || p_block->i_buffer == 0)
         return VLC_SUCCESS;
 
     vlc_mutex_lock(&stream->lock);
 
+    block_t *chunk = httpd_ChunkNew(p_block, stream->i_buffer_pos);
+    if (unlikely(chunk == NULL)) {
+        vlc_mutex_unlock(&stream->lock);
+        return VLC_ENOMEM;
+    }
+
     /* save this pointer (to be used by new connection) */
     stream->i_buffer_last_pos = stream->i_buffer_pos;
 
@@ -835,9 +976,15 @@ int httpd_StreamSend(httpd_stream_t *stream, const block_t *p_block)
         stream->i_last_keyframe_seen_pos = stream->i_buffer_pos;
     }
 
-    httpd_AppendData(stream, p_block->p_buffer, p_block->i_buffer);
+    httpd_AppendChunk(stream, chunk);
 
     vlc_mutex_unlock(&stream->lock);
+
+#ifdef HAVE_EPOLL_CREATE1
+    /* wake the clients waiting for data */
+    atomic_fetch_add(&stream->url->i_wake, 1);
+    httpd_WorkersWake(stream->url->host);
+#endif
     return VLC_SUCCESS;
 }
 
@@ -852,7 +999,9 @@ void httpd_StreamDelete(httpd_stream_t *stream)
     vlc_mutex_destroy(&stream->lock);
     free(stream->psz_mime);
     free(stream->p_header);
-    free(stream->p_buffer);
+    for (unsigned i = 0; i < stream->i_chunks; i++)
+        block_Release(&httpd_StreamChunk(stream, i)->self);
+    free(stream->pp_chunk);
     free(stream);
 }
 
@@ -862,6 +1011,10 @@ void httpd_StreamDelete(httpd_stream_t *stream)
 static void* httpd_HostThread(void *);
 static httpd_host_t *httpd_HostCreate(vlc_object_t *, const char *,
                                        const char *, vlc_tls_creds_t *);
+#ifdef HAVE_EPOLL_CREATE1
+static int  httpd_WorkersStart(httpd_host_t *, unsigned);
+static void httpd_WorkersStop(httpd_host_t *);
+#endif
 
 /* create a new host */
 httpd_host_t *vlc_http_HostNew(vlc_object_t *p_this)
@@ -1001,9 +1154,20 @@ static httpd_host_t *httpd_HostCreate(vlc_object_t *p_this,
     host->url      = NULL;
     host->i_client = 0;
     host->client   = NULL;
+    host->i_workers = 0;
+    host->workers  = NULL;
     host->p_tls    = p_tls;
 
-    /* create the thread */
+    /* create the thread(s) */
+#ifdef HAVE_EPOLL_CREATE1
+    unsigned threads = var_InheritInteger(p_this, "http-threads");
+    if (threads > 0) {
+        if (httpd_WorkersStart(host, threads)) {
+            msg_Err(p_this, "cannot spawn http host threads");
+            goto error;
+        }
+    } else
+#endif
     if (vlc_clone(&host->thread, httpd_HostThread, host,
                    VLC_THREAD_PRIORITY_LOW)) {
         msg_Err(p_this, "cannot spawn http host thread");
@@ -1053,8 +1217,15 @@ void httpd_HostDelete(httpd_host_t *host)
     }
     TAB_REMOVE(httpd.i_host, httpd.host, host);
 
-    vlc_cancel(host->thread);
-    vlc_join(host->thread, NULL);
+#ifdef HAVE_EPOLL_CREATE1
+    if (host->i_workers > 0)
+        httpd_WorkersStop(host);
+    else
+#endif
+    {
+        vlc_cancel(host->thread);
+        vlc_join(host->thread, NULL);
+    }
 
     msg_Dbg(host, "HTTP host removed");
 
@@ -1106,6 +1277,7 @@ httpd_url_t *httpd_UrlNew(httpd_host_t *host, const char *psz_url,
         url->catch[i].cb = NULL;
         url->catch[i].p_sys = NULL;
     }
+    atomic_init(&url->i_wake, 0);
 
     TAB_APPEND(host->i_url, host->url, url);
     vlc_cond_signal(&host->wait);
@@ -1152,6 +1324,12 @@ void httpd_UrlDelete(httpd_url_t *url)
         free(client);
         i--;
     }
+#ifdef HAVE_EPOLL_CREATE1
+    /* The epoll threads may be doing I/O on their clients without the
+     * lock: only detach them, they are closed when they need the url. */
+    for (unsigned i = 0; i < host->i_workers; i++)
+        httpd_WorkerDetachUrl(&host->workers[i], url);
+#endif
     free(url);
     vlc_mutex_unlock(&host->lock);
 }
@@ -1235,6 +1413,8 @@ static void httpd_ClientInit(httpd_client_t *cl, mtime_t now)
     cl->p_buffer = xmalloc(cl->i_buffer_size);
     cl->i_keyframe_wait_to_pass = -1;
     cl->b_stream_mode = false;
+    cl->i_chunks = 0;
+    cl->i_chunk_offset = 0;
 
     httpd_MsgInit(&cl->query);
     httpd_MsgInit(&cl->answer);
@@ -1262,6 +1442,10 @@ static void httpd_ClientClean(httpd_client_t *cl)
     httpd_MsgClean(&cl->answer);
     httpd_MsgClean(&cl->query);
 
+    for (unsigned i = 0; i < cl->i_chunks; i++)
+        block_Release(cl->pp_chunk[i]);
+    cl->i_chunks = 0;
+
     free(cl->p_buffer);
     cl->p_buffer = NULL;
 }
@@ -1618,7 +1802,55 @@ static void httpd_ClientRecv(httpd_client_t *cl)
         cl->i_activity_timeout = 0;
 }
 
-static void httpd_ClientSend(httpd_client_t *cl)
+/* Sends the stream chunks held by the client, gathering them in one call
+ * where possible */
+static ssize_t httpd_ClientSendChunks(httpd_client_t *cl)
+{
+    const block_t *first = cl->pp_chunk[0];
+    ssize_t val;
+
+#ifndef _WIN32
+    if (cl->p_tls == NULL) {
+        struct iovec iov[HTTPD_CL_CHUNKS];
+
+        for (unsigned i = 0; i < cl->i_chunks; i++) {
+            iov[i].iov_base = cl->pp_chunk[i]->p_buffer;
+            iov[i].iov_len = cl->pp_chunk[i]->i_buffer;
+        }
+        iov[0].iov_base = first->p_buffer + cl->i_chunk_offset;
+        iov[0].iov_len -= cl->i_chunk_offset;
+
+        struct msghdr hdr = {
+            .msg_iov = iov,
+            .msg_iovlen = cl->i_chunks,
+        };
+
+        do
+            val = sendmsg(cl->fd, &hdr, 0);
+        while (val == -1 && errno == EINTR);
+    } else
+#endif
+        val = httpd_NetSend(cl, first->p_buffer + cl->i_chunk_offset,
+                            first->i_buffer - cl->i_chunk_offset);
+    if (val <= 0)
+        return val;
+
+    /* release the chunks that were fully sent */
+    size_t i_sent = cl->i_chunk_offset + val;
+    unsigned i = 0;
+
+    while (i < cl->i_chunks && i_sent >= cl->pp_chunk[i]->i_buffer) {
+        i_sent -= cl->pp_chunk[i]->i_buffer;
+        block_Release(cl->pp_chunk[i++]);
+    }
+    cl->i_chunks -= i;
+    memmove(cl->pp_chunk, cl->pp_chunk + i, cl->i_chunks * sizeof (block_t *));
+    cl->i_chunk_offset = i_sent;
+    return val;
+}
+
+/* Sends as much of the buffer as possible, returns true once it is done */
+static bool httpd_ClientSendData(httpd_client_t *cl)
 {
     int i_len;
 
@@ -1653,47 +1885,71 @@ static void httpd_ClientSend(httpd_client_t *cl)
         cl->i_buffer_size = (uint8_t*)p - cl->p_buffer;
     }
 
-    i_len = httpd_NetSend(cl, &cl->p_buffer[cl->i_buffer],
-                           cl->i_buffer_size - cl->i_buffer);
-    if (i_len >= 0) {
-        cl->i_buffer += i_len;
-
-        if (cl->i_buffer >= cl->i_buffer_size) {
-            if (cl->answer.i_body == 0  && cl->answer.i_body_offset > 0) {
-                /* catch more body data */
-                int     i_msg = cl->query.i_type;
-                int64_t i_offset = cl->answer.i_body_offset;
-
-                httpd_MsgClean(&cl->answer);
-                cl->answer.i_body_offset = i_offset;
-
-                cl->url->catch[i_msg].cb(cl->url->catch[i_msg].p_sys, cl,
-                                          &cl->answer, &cl->query);
-            }
-
-            if (cl->answer.i_body > 0) {
-                /* send the body data */
-                free(cl->p_buffer);
-                cl->p_buffer = cl->answer.p_body;
-                cl->i_buffer_size = cl->answer.i_body;
-                cl->i_buffer = 0;
-
-                cl->answer.i_body = 0;
-                cl->answer.p_body = NULL;
-            } else /* send finished */
-                cl->i_state = HTTPD_CLIENT_SEND_DONE;
-        }
+    if (cl->i_buffer >= cl->i_buffer_size && cl->i_chunks > 0) {
+        i_len = httpd_ClientSendChunks(cl);
+        if (i_len >= 0)
+            return cl->i_chunks == 0;
     } else {
+        i_len = httpd_NetSend(cl, &cl->p_buffer[cl->i_buffer],
+                               cl->i_buffer_size - cl->i_buffer);
+        if (i_len >= 0) {
+            cl->i_buffer += i_len;
+            return cl->i_buffer >= cl->i_buffer_size && cl->i_chunks == 0;
+        }
+    }
+
 #if defined(_WIN32)
-        if ((i_len < 0 && WSAGetLastError() != WSAEWOULDBLOCK) || (i_len == 0))
+    if (WSAGetLastError() != WSAEWOULDBLOCK)
 #else
-        if ((i_len < 0 && errno != EAGAIN) || (i_len == 0))
+    if (errno != EAGAIN)
 #endif
-        {
-            /* error */
+        cl->i_state = HTTPD_CLIENT_DEAD; /* error */
+    return false;
+}
+
+/* Moves on to the next body data once the buffer has been sent
+ * (with the host lock or the epoll thread lock held, as it may call the url
+ * callback) */
+static void httpd_ClientSendNext(httpd_client_t *cl)
+{
+    if (cl->answer.i_body == 0  && cl->answer.i_body_offset > 0) {
+        if (cl->url == NULL) {
+            /* the url was deleted under our feet */
             cl->i_state = HTTPD_CLIENT_DEAD;
+            return;
         }
+
+        /* catch more body data */
+        int     i_msg = cl->query.i_type;
+        int64_t i_offset = cl->answer.i_body_offset;
+
+        httpd_MsgClean(&cl->answer);
+        cl->answer.i_body_offset = i_offset;
+
+        cl->url->catch[i_msg].cb(cl->url->catch[i_msg].p_sys, cl,
+                                  &cl->answer, &cl->query);
     }
+
+    if (cl->answer.i_body > 0) {
+        /* send the body data */
+        free(cl->p_buffer);
+        cl->p_buffer = cl->answer.p_body;
+        cl->i_buffer_size = cl->answer.i_body;
+        cl->i_buffer = 0;
+
+        cl->answer.i_body = 0;
+        cl->answer.p_body = NULL;
+    } else if (cl->i_chunks > 0) {
+        /* send the stream chunks */
+        cl->i_buffer = cl->i_buffer_size;
+    } else /* send finished */
+        cl->i_state = HTTPD_CLIENT_SEND_DONE;
+}
+
+static void httpd_ClientSend(httpd_client_t *cl)
+{
+    if (httpd_ClientSendData(cl))
+        httpd_ClientSendNext(cl);
 }
 
 static void httpd_ClientTlsHandshake(httpd_client_t *cl)
@@ -1746,6 +2002,227 @@ auth_failed:
     return false;
 }
 
+/* Handles a client between two I/O steps (with the host lock held, or the
+ * epoll thread lock, plus the host lock for a received request) */
+static void httpd_ClientProcess(httpd_host_t *host, httpd_client_t *cl)
+{
+    int64_t i_offset;
+
+    switch (cl->i_state) {
+        case HTTPD_CLIENT_RECEIVE_DONE: {
+            httpd_message_t *answer = &cl->answer;
+            httpd_message_t *query  = &cl->query;
+
+            httpd_MsgInit(answer);
+
+            /* Handle what we received */
+            switch (query->i_type) {
+                case HTTPD_MSG_ANSWER:
+                    cl->url     = NULL;
+                    cl->i_state = HTTPD_CLIENT_DEAD;
+                    break;
+
+                case HTTPD_MSG_OPTIONS:
+                    answer->i_type   = HTTPD_MSG_ANSWER;
+                    answer->i_proto  = query->i_proto;
+                    answer->i_status = 200;
+                    answer->i_body = 0;
+                    answer->p_body = NULL;
+
+                    httpd_MsgAdd(answer, "Server", "VLC/%s", VERSION);
+                    httpd_MsgAdd(answer, "Content-Length", "0");
+
+                    switch(query->i_proto) {
+                    case HTTPD_PROTO_HTTP:
+                        answer->i_version = 1;
+                        httpd_MsgAdd(answer, "Allow", "GET,HEAD,POST,OPTIONS");
+                        break;
+
+                    case HTTPD_PROTO_RTSP:
+                        answer->i_version = 0;
+
+                        const char *p = httpd_MsgGet(query, "Cseq");
+                        if (p)
+                            httpd_MsgAdd(answer, "Cseq", "%s", p);
+                        p = httpd_MsgGet(query, "Timestamp");
+                        if (p)
+                            httpd_MsgAdd(answer, "Timestamp", "%s", p);
+
+                        p = httpd_MsgGet(query, "Require");
+                        if (p) {
+                            answer->i_status = 551;
+                            httpd_MsgAdd(query, "Unsupported", "%s", p);
+                        }
+
+                        httpd_MsgAdd(answer, "Public", "DESCRIBE,SETUP,"
+                                "TEARDOWN,PLAY,PAUSE,GET_PARAMETER");
+                        break;
+                    }
+
+                    cl->i_buffer = -1;  /* Force the creation of the answer in
+                                         * httpd_ClientSend */
+                    cl->i_state = HTTPD_CLIENT_SENDING;
+                    break;
+
+                case HTTPD_MSG_NONE:
+                    if (query->i_proto == HTTPD_PROTO_NONE) {
+                        cl->url = NULL;
+                        cl->i_state = HTTPD_CLIENT_DEAD;
+                    } else {
+                        /* unimplemented */
+                        answer->i_proto  = query->i_proto ;
+                        answer->i_type   = HTTPD_MSG_ANSWER;
+                        answer->i_version= 0;
+                        answer->i_status = 501;
+
+                        char *p;
+                        answer->i_body = httpd_HtmlError (&p, 501, NULL);
+                        answer->p_body = (uint8_t *)p;
+                        httpd_MsgAdd(answer, "Content-Length", "%d", answer->i_body);
+
+                        cl->i_buffer = -1;  /* Force the creation of the answer in httpd_ClientSend */
+                        cl->i_state = HTTPD_CLIENT_SENDING;
+                    }
+                    break;
+
+                default: {
+                    int i_msg = query->i_type;
+                    bool b_auth_failed = false;
+
+                    /* Search the url and trigger callbacks */
+                    for (int i = 0; i < host->i_url; i++) {
+                        httpd_url_t *url = host->url[i];
+
+                        if (strcmp(url->psz_url, query->psz_url))
+                            continue;
+                        if (!url->catch[i_msg].cb)
+                            continue;
+
+                        if (answer) {
+                            b_auth_failed = !httpdAuthOk(url->psz_user,
+                               url->psz_password,
+                               httpd_MsgGet(query, "Authorization")); /* BASIC id */
+                            if (b_auth_failed)
+                               break;
+                        }
+
+                        if (url->catch[i_msg].cb(url->catch[i_msg].p_sys, cl, answer, query))
+                            continue;
+
+                        if (answer->i_proto == HTTPD_PROTO_NONE)
+                            cl->i_buffer = cl->i_buffer_size; /* Raw answer from a CGI */
+                        else
+                            cl->i_buffer = -1;
+
+                        /* only one url can answer */
+                        answer = NULL;
+                        if (!cl->url)
+                            cl->url = url;
+                    }
+
+                    if (answer) {
+                        answer->i_proto  = query->i_proto;
+                        answer->i_type   = HTTPD_MSG_ANSWER;
+                        answer->i_version= 0;
+
+                       if (b_auth_failed) {
+                            httpd_MsgAdd(answer, "WWW-Authenticate",
+                                    "Basic realm=\"VLC stream\"");
+                            answer->i_status = 401;
+                        } else
+                            answer->i_status = 404; /* no url registered */
+
+                        char *p;
+                        answer->i_body = httpd_HtmlError (&p, answer->i_status,
+                                query->psz_url);
+                        answer->p_body = (uint8_t *)p;
+
+                        cl->i_buffer = -1;  /* Force the creation of the answer in httpd_ClientSend */
+                        httpd_MsgAdd(answer, "Content-Length", "%d", answer->i_body);
+                        httpd_MsgAdd(answer, "Content-Type", "%s", "text/html");
+                    }
+
+                    cl->i_state = HTTPD_CLIENT_SENDING;
+                }
+            }
+            break;
+        }
+
+        case HTTPD_CLIENT_SEND_DONE:
+            if (!cl->b_stream_mode || cl->answer.i_body_offset == 0) {
+                const char *psz_connection = httpd_MsgGet(&cl->answer, "Connection");
+                const char *psz_query = httpd_MsgGet(&cl->query, "Connection");
+                bool b_connection = false;
+                bool b_keepalive = false;
+                bool b_query = false;
+
+                cl->url = NULL;
+                if (psz_connection) {
+                    b_connection = (strcasecmp(psz_connection, "Close") == 0);
+                    b_keepalive = (strcasecmp(psz_connection, "Keep-Alive") == 0);
+                }
+
+                if (psz_query)
+                    b_query = (strcasecmp(psz_query, "Close") == 0);
+
+                if (((cl->query.i_proto == HTTPD_PROTO_HTTP) &&
+                            ((cl->query.i_version == 0 && b_keepalive) ||
+                              (cl->query.i_version == 1 && !b_connection))) ||
+                        ((cl->query.i_proto == HTTPD_PROTO_RTSP) &&
+                          !b_query && !b_connection)) {
+                    httpd_MsgClean(&cl->query);
+                    httpd_MsgInit(&cl->query);
+
+                    cl->i_buffer = 0;
+                    cl->i_buffer_size = 1000;
+                    free(cl->p_buffer);
+                    cl->p_buffer = xmalloc(cl->i_buffer_size);
+                    cl->i_state = HTTPD_CLIENT_RECEIVING;
+                } else
+                    cl->i_state = HTTPD_CLIENT_DEAD;
+                httpd_MsgClean(&cl->answer);
+            } else {
+                i_offset = cl->answer.i_body_offset;
+                httpd_MsgClean(&cl->answer);
+
+                cl->answer.i_body_offset = i_offset;
+                free(cl->p_buffer);
+                cl->p_buffer = NULL;
+                cl->i_buffer = 0;
+                cl->i_buffer_size = 0;
+
+                cl->i_state = HTTPD_CLIENT_WAITING;
+            }
+            break;
+
+        case HTTPD_CLIENT_WAITING:
+            if (cl->url == NULL) {
+                /* the url was deleted under our feet */
+                cl->i_state = HTTPD_CLIENT_DEAD;
+                break;
+            }
+
+            i_offset = cl->answer.i_body_offset;
+            int i_msg = cl->query.i_type;
+
+            httpd_MsgInit(&cl->answer);
+            cl->answer.i_body_offset = i_offset;
+
+            cl->url->catch[i_msg].cb(cl->url->catch[i_msg].p_sys, cl,
+                    &cl->answer, &cl->query);
+            if (cl->answer.i_type != HTTPD_MSG_NONE) {
+                /* we have new data, so re-enter send mode */
+                cl->i_buffer      = 0;
+                cl->p_buffer      = cl->answer.p_body;
+                cl->i_buffer_size = cl->answer.i_body;
+                cl->answer.p_body = NULL;
+                cl->answer.i_body = 0;
+                cl->i_state = HTTPD_CLIENT_SENDING;
+            }
+            break;
+    }
+}
+
 static void httpdLoop(httpd_host_t *host)
 {
     struct pollfd ufd[host->nfd + host->i_client];
@@ -1768,7 +2245,6 @@ static void httpdLoop(httpd_host_t *host)
 
     int canc = vlc_savecancel();
     for (int i_client = 0; i_client < host->i_client; i_client++) {
-        int64_t i_offset;
         httpd_client_t *cl = host->client[i_client];
         if (cl->i_ref < 0 || (cl->i_ref == 0 &&
                     (cl->i_state == HTTPD_CLIENT_DEAD ||
@@ -1798,210 +2274,9 @@ static void httpdLoop(httpd_host_t *host)
                 pufd->events = POLLOUT;
                 break;
 
-            case HTTPD_CLIENT_RECEIVE_DONE: {
-                httpd_message_t *answer = &cl->answer;
-                httpd_message_t *query  = &cl->query;
-
-                httpd_MsgInit(answer);
-
-                /* Handle what we received */
-                switch (query->i_type) {
-                    case HTTPD_MSG_ANSWER:
-                        cl->url     = NULL;
-                        cl->i_state = HTTPD_CLIENT_DEAD;
-                        break;
-
-                    case HTTPD_MSG_OPTIONS:
-                        answer->i_type   = HTTPD_MSG_ANSWER;
-                        answer->i_proto  = query->i_proto;
-                        answer->i_status = 200;
-                        answer->i_body = 0;
-                        answer->p_body = NULL;
-
-                        httpd_MsgAdd(answer, "Server", "VLC/%s", VERSION);
-                        httpd_MsgAdd(answer, "Content-Length", "0");
-
-                        switch(query->i_proto) {
-                        case HTTPD_PROTO_HTTP:
-                            answer->i_version = 1;
-                            httpd_MsgAdd(answer, "Allow", "GET,HEAD,POST,OPTIONS");
-                            break;
-
-                        case HTTPD_PROTO_RTSP:
-                            answer->i_version = 0;
-
-                            const char *p = httpd_MsgGet(query, "Cseq");
-                            if (p)
-                                httpd_MsgAdd(answer, "Cseq", "%s", p);
-                            p = httpd_MsgGet(query, "Timestamp");
-                            if (p)
-                                httpd_MsgAdd(answer, "Timestamp", "%s", p);
-
-                            p = httpd_MsgGet(query, "Require");
-                            if (p) {
-                                answer->i_status = 551;
-                                httpd_MsgAdd(query, "Unsupported", "%s", p);
-                            }
-
-                            httpd_MsgAdd(answer, "Public", "DESCRIBE,SETUP,"
-                                    "TEARDOWN,PLAY,PAUSE,GET_PARAMETER");
-                            break;
-                        }
-
-                        cl->i_buffer = -1;  /* Force the creation of the answer in
-                                             * httpd_ClientSend */
-                        cl->i_state = HTTPD_CLIENT_SENDING;
-                        break;
-
-                    case HTTPD_MSG_NONE:
-                        if (query->i_proto == HTTPD_PROTO_NONE) {
-                            cl->url = NULL;
-                            cl->i_state = HTTPD_CLIENT_DEAD;
-                        } else {
-                            /* unimplemented */
-                            answer->i_proto  = query->i_proto ;
-                            answer->i_type   = HTTPD_MSG_ANSWER;
-                            answer->i_version= 0;
-                            answer->i_status = 501;
-
-                            char *p;
-                            answer->i_body = httpd_HtmlError (&p, 501, NULL);
-                            answer->p_body = (uint8_t *)p;
-                            httpd_MsgAdd(answer, "Content-Length", "%d", answer->i_body);
-
-                            cl->i_buffer = -1;  /* Force the creation of the answer in httpd_ClientSend */
-                            cl->i_state = HTTPD_CLIENT_SENDING;
-                        }
-                        break;
-
-                    default: {
-                        int i_msg = query->i_type;
-                        bool b_auth_failed = false;
-
-                        /* Search the url and trigger callbacks */
-                        for (int i = 0; i < host->i_url; i++) {
-                            httpd_url_t *url = host->url[i];
-
-                            if (strcmp(url->psz_url, query->psz_url))
-                                continue;
-                            if (!url->catch[i_msg].cb)
-                                continue;
-
-                            if (answer) {
-                                b_auth_failed = !httpdAuthOk(url->psz_user,
-                                   url->psz_password,
-                                   httpd_MsgGet(query, "Authorization")); /* BASIC id */
-                                if (b_auth_failed)
-                                   break;
-                            }
-
-                            if (url->catch[i_msg].cb(url->catch[i_msg].p_sys, cl, answer, query))
-                                continue;
-
-                            if (answer->i_proto == HTTPD_PROTO_NONE)
-                                cl->i_buffer = cl->i_buffer_size; /* Raw answer from a CGI */
-                            else
-                                cl->i_buffer = -1;
-
-                            /* only one url can answer */
-                            answer = NULL;
-                            if (!cl->url)
-                                cl->url = url;
-                        }
-
-                        if (answer) {
-                            answer->i_proto  = query->i_proto;
-                            answer->i_type   = HTTPD_MSG_ANSWER;
-                            answer->i_version= 0;
-
-                           if (b_auth_failed) {
-                                httpd_MsgAdd(answer, "WWW-Authenticate",
-                                        "Basic realm=\"VLC stream\"");
-                                answer->i_status = 401;
-                            } else
-                                answer->i_status = 404; /* no url registered */
-
-                            char *p;
-                            answer->i_body = httpd_HtmlError (&p, answer->i_status,
-                                    query->psz_url);
-                            answer->p_body = (uint8_t *)p;
-
-                            cl->i_buffer = -1;  /* Force the creation of the answer in httpd_ClientSend */
-                            httpd_MsgAdd(answer, "Content-Length", "%d", answer->i_body);
-                            httpd_MsgAdd(answer, "Content-Type", "%s", "text/html");
-                        }
-
-                        cl->i_state = HTTPD_CLIENT_SENDING;
-                    }
-                }
+            default:
+                httpd_ClientProcess(host, cl);
                 break;
-            }
-
-            case HTTPD_CLIENT_SEND_DONE:
-                if (!cl->b_stream_mode || cl->answer.i_body_offset == 0) {
-                    const char *psz_connection = httpd_MsgGet(&cl->answer, "Connection");
-                    const char *psz_query = httpd_MsgGet(&cl->query, "Connection");
-                    bool b_connection = false;
-                    bool b_keepalive = false;
-                    bool b_query = false;
-
-                    cl->url = NULL;
-                    if (psz_connection) {
-                        b_connection = (strcasecmp(psz_connection, "Close") == 0);
-                        b_keepalive = (strcasecmp(psz_connection, "Keep-Alive") == 0);
-                    }
-
-                    if (psz_query)
-                        b_query = (strcasecmp(psz_query, "Close") == 0);
-
-                    if (((cl->query.i_proto == HTTPD_PROTO_HTTP) &&
-                                ((cl->query.i_version == 0 && b_keepalive) ||
-                                  (cl->query.i_version == 1 && !b_connection))) ||
-                            ((cl->query.i_proto == HTTPD_PROTO_RTSP) &&
-                              !b_query && !b_connection)) {
-                        httpd_MsgClean(&cl->query);
-                        httpd_MsgInit(&cl->query);
-
-                        cl->i_buffer = 0;
-                        cl->i_buffer_size = 1000;
-                        free(cl->p_buffer);
-                        cl->p_buffer = xmalloc(cl->i_buffer_size);
-                        cl->i_state = HTTPD_CLIENT_RECEIVING;
-                    } else
-                        cl->i_state = HTTPD_CLIENT_DEAD;
-                    httpd_MsgClean(&cl->answer);
-                } else {
-                    i_offset = cl->answer.i_body_offset;
-                    httpd_MsgClean(&cl->answer);
-
-                    cl->answer.i_body_offset = i_offset;
-                    free(cl->p_buffer);
-                    cl->p_buffer = NULL;
-                    cl->i_buffer = 0;
-                    cl->i_buffer_size = 0;
-
-                    cl->i_state = HTTPD_CLIENT_WAITING;
-                }
-                break;
-
-            case HTTPD_CLIENT_WAITING:
-                i_offset = cl->answer.i_body_offset;
-                int i_msg = cl->query.i_type;
-
-                httpd_MsgInit(&cl->answer);
-                cl->answer.i_body_offset = i_offset;
-
-                cl->url->catch[i_msg].cb(cl->url->catch[i_msg].p_sys, cl,
-                        &cl->answer, &cl->query);
-                if (cl->answer.i_type != HTTPD_MSG_NONE) {
-                    /* we have new data, so re-enter send mode */
-                    cl->i_buffer      = 0;
-                    cl->p_buffer      = cl->answer.p_body;
-                    cl->i_buffer_size = cl->answer.i_body;
-                    cl->answer.p_body = NULL;
-                    cl->answer.i_body = 0;
-                    cl->i_state = HTTPD_CLIENT_SENDING;
-                }
         }
 
         if (pufd->events != 0)
@@ -2087,6 +2362,394 @@ static void httpdLoop(httpd_host_t *host)
     vlc_restorecancel(canc);
 }
 
+#ifdef HAVE_EPOLL_CREATE1
+/*****************************************************************************
+ * epoll threads
+ *****************************************************************************/
+#define HTTPD_EPOLL_EVENTS 64
+#define HTTPD_ACCEPT_MAX   16
+
+static void httpd_ClientLink(httpd_client_t **list, httpd_client_t *cl)
+{
+    cl->prev = NULL;
+    cl->next = *list;
+    if (*list != NULL)
+        (*list)->prev = cl;
+    *list = cl;
+}
+
+static void httpd_ClientUnlink(httpd_client_t **list, httpd_client_t *cl)
+{
+    if (cl->prev != NULL)
+        cl->prev->next = cl->next;
+    else
+        *list = cl->next;
+    if (cl->next != NULL)
+        cl->next->prev = cl->prev;
+}
+
+static void httpd_WorkerDrop(httpd_worker_t *w, httpd_client_t *cl)
+{
+    httpd_ClientUnlink(cl->b_waiting ? &w->waiting : &w->active, cl);
+    epoll_ctl(w->epfd, EPOLL_CTL_DEL, cl->fd, NULL);
+    httpd_ClientClean(cl);
+    free(cl);
+}
+
+static void httpd_WorkerWake(httpd_worker_t *w)
+{
+    if (!atomic_exchange(&w->b_wake, true)) {
+        uint64_t val = 1;
+
+        if (write(w->wakefd, &val, sizeof (val)) != sizeof (val))
+            atomic_store(&w->b_wake, false);
+    }
+}
+
+static void httpd_WorkersWake(httpd_host_t *host)
+{
+    for (unsigned i = 0; i < host->i_workers; i++)
+        httpd_WorkerWake(&host->workers[i]);
+}
+
+/* Closes the clients of a deleted url (host lock held). The waiting clients
+ * are marked dead, the others are shut down: their thread may be doing I/O
+ * on them, it drops them on the resulting error. */
+static void httpd_WorkerDetachUrl(httpd_worker_t *w, httpd_url_t *url)
+{
+    bool b_wake = false;
+
+    vlc_mutex_lock(&w->lock);
+    for (httpd_client_t *cl = w->active; cl != NULL; cl = cl->next)
+        if (cl->url == url) {
+            msg_Warn(w->host, "force closing connections");
+            cl->url = NULL;
+            shutdown(cl->fd, SHUT_RDWR);
+        }
+    for (httpd_client_t *cl = w->waiting; cl != NULL; cl = cl->next)
+        if (cl->url == url) {
+            msg_Warn(w->host, "force closing connections");
+            cl->url = NULL;
+            cl->i_state = HTTPD_CLIENT_DEAD;
+            b_wake = true;
+        }
+    vlc_mutex_unlock(&w->lock);
+
+    if (b_wake)
+        httpd_WorkerWake(w);
+}
+
+/* Runs the client state machine up to the next I/O, then updates the list
+ * and the polled events of the client, or frees it (worker lock held, and
+ * host lock held too if a request was received) */
+static void httpd_WorkerProcess(httpd_worker_t *w, httpd_client_t *cl)
+{
+    while (cl->i_state == HTTPD_CLIENT_RECEIVE_DONE
+        || cl->i_state == HTTPD_CLIENT_SEND_DONE)
+        httpd_ClientProcess(w->host, cl);
+    if (cl->i_state == HTTPD_CLIENT_WAITING && cl->url != NULL) {
+        /* data that comes after this check will wake the client up */
+        cl->i_wake = atomic_load(&cl->url->i_wake);
+        httpd_ClientProcess(w->host, cl);
+    } else if (cl->i_state == HTTPD_CLIENT_WAITING)
+        httpd_ClientProcess(w->host, cl);
+
+    uint32_t events = 0;
+    switch (cl->i_state) {
+        case HTTPD_CLIENT_RECEIVING:
+        case HTTPD_CLIENT_TLS_HS_IN:
+            events = EPOLLIN;
+            break;
+        case HTTPD_CLIENT_SENDING:
+        case HTTPD_CLIENT_TLS_HS_OUT:
+            events = EPOLLOUT;
+            break;
+        case HTTPD_CLIENT_DEAD:
+            httpd_WorkerDrop(w, cl);
+            return;
+    }
+
+    bool b_waiting = cl->i_state == HTTPD_CLIENT_WAITING;
+    if (b_waiting != cl->b_waiting) {
+        httpd_ClientUnlink(cl->b_waiting ? &w->waiting : &w->active, cl);
+        httpd_ClientLink(b_waiting ? &w->waiting : &w->active, cl);
+        cl->b_waiting = b_waiting;
+    }
+
+    if (events != cl->i_events) {
+        struct epoll_event ev = { .events = events, .data.ptr = cl };
+
+        if (epoll_ctl(w->epfd, EPOLL_CTL_MOD, cl->fd, &ev))
+            msg_Err(w->host, "cannot poll client: %s", vlc_strerror_c(errno));
+        cl->i_events = events;
+    }
+}
+
+static void httpd_WorkerAccept(httpd_worker_t *w, int lfd, mtime_t now)
+{
+    httpd_host_t *host = w->host;
+
+    for (unsigned i = 0; i < HTTPD_ACCEPT_MAX; i++) {
+        int fd = vlc_accept(lfd, NULL, NULL, true);
+        if (fd == -1)
+            break; /* another thread was faster, or nothing left */
+        setsockopt (fd, SOL_SOCKET, SO_REUSEADDR,
+                &(int){ 1 }, sizeof(int));
+
+        vlc_tls_t *p_tls;
+
+        if (host->p_tls)
+            p_tls = vlc_tls_SessionCreate(host->p_tls, fd, NULL);
+        else
+            p_tls = NULL;
+
+        httpd_client_t *cl = httpd_ClientNew(fd, p_tls, now);
+        if (unlikely(cl == NULL)) {
+            if (p_tls)
+                vlc_tls_SessionDelete(p_tls);
+            net_Close(fd);
+            break;
+        }
+
+        cl->b_waiting = false;
+        cl->i_events = (cl->i_state == HTTPD_CLIENT_TLS_HS_OUT) ? EPOLLOUT
+                                                                : EPOLLIN;
+
+        vlc_mutex_lock(&w->lock);
+        httpd_ClientLink(&w->active, cl);
+
+        struct epoll_event ev = { .events = cl->i_events, .data.ptr = cl };
+        if (epoll_ctl(w->epfd, EPOLL_CTL_ADD, fd, &ev)) {
+            msg_Err(host, "cannot poll client: %s", vlc_strerror_c(errno));
+            httpd_WorkerDrop(w, cl);
+        }
+        vlc_mutex_unlock(&w->lock);
+    }
+}
+
+static void httpd_WorkerSweep(httpd_worker_t *w, mtime_t now)
+{
+    httpd_client_t *lists[2] = { w->active, w->waiting };
+
+    for (unsigned i = 0; i < 2; i++)
+        for (httpd_client_t *cl = lists[i], *next; cl != NULL; cl = next) {
+            next = cl->next;
+            if (cl->i_activity_timeout > 0 &&
+                cl->i_activity_date + cl->i_activity_timeout < now)
+                httpd_WorkerDrop(w, cl);
+        }
+    w->i_sweep = now + CLOCK_FREQ;
+}
+
+/* Checks the waiting clients whose stream got new data, and drops those
+ * whose url was deleted (worker lock held) */
+static void httpd_WorkerWakeUp(httpd_worker_t *w)
+{
+    for (httpd_client_t *cl = w->waiting, *next; cl != NULL; cl = next) {
+        next = cl->next;
+        if (cl->url == NULL || cl->i_state != HTTPD_CLIENT_WAITING
+         || atomic_load(&cl->url->i_wake) != cl->i_wake)
+            httpd_WorkerProcess(w, cl);
+    }
+}
+
+static void *httpd_WorkerThread(void *data)
+{
+    httpd_worker_t *w = data;
+    httpd_host_t *host = w->host;
+    struct epoll_event ev[HTTPD_EPOLL_EVENTS];
+    int timeout = -1;
+
+    for (;;) {
+        /* The client lists are only changed by this thread */
+        int n = epoll_wait(w->epfd, ev, HTTPD_EPOLL_EVENTS, timeout);
+        int canc = vlc_savecancel();
+        mtime_t now = mdate();
+        bool b_wake = false;
+
+        if (n == -1) {
+            if (errno != EINTR) {
+                /* Kernel on low memory or a bug: pace, unless events come */
+                struct pollfd ufd = { .fd = w->epfd, .events = POLLIN };
+
+                msg_Err(host, "polling error: %s", vlc_strerror_c(errno));
+                vlc_restorecancel(canc);
+                poll(&ufd, 1, 100);
+                continue;
+            }
+            n = 0;
+        }
+
+        for (int i = 0; i < n; i++) {
+            const int *lfd = ev[i].data.ptr;
+
+            if (ev[i].data.ptr == w) {
+                uint64_t val;
+
+                atomic_store(&w->b_wake, false);
+                if (read(w->wakefd, &val, sizeof (val)) < 0)
+                    msg_Err(host, "cannot read wake up: %s",
+                            vlc_strerror_c(errno));
+                b_wake = true;
+                continue;
+            }
+
+            if ((uintptr_t)lfd >= (uintptr_t)host->fds
+             && (uintptr_t)lfd < (uintptr_t)(host->fds + host->nfd)) {
+                httpd_WorkerAccept(w, *lfd, now);
+                continue;
+            }
+
+            httpd_client_t *cl = ev[i].data.ptr;
+            int i_state = cl->i_state;
+            bool b_next = false;
+
+            cl->i_activity_date = now;
+
+            switch (i_state) {
+                case HTTPD_CLIENT_RECEIVING: httpd_ClientRecv(cl); break;
+                case HTTPD_CLIENT_SENDING:
+                    b_next = httpd_ClientSendData(cl);
+                    break;
+                case HTTPD_CLIENT_TLS_HS_IN:
+                case HTTPD_CLIENT_TLS_HS_OUT: httpd_ClientTlsHandshake(cl); break;
+                default: /* error or hang-up while waiting */
+                    vlc_mutex_lock(&w->lock);
+                    cl->i_state = HTTPD_CLIENT_DEAD;
+                    vlc_mutex_unlock(&w->lock);
+            }
+
+            if (!b_next && cl->i_state == i_state)
+                continue; /* more I/O to do, nothing else to change */
+
+            /* only a new request needs the url table and its callbacks */
+            bool b_host = cl->i_state == HTTPD_CLIENT_RECEIVE_DONE;
+
+            if (b_host)
+                vlc_mutex_lock(&host->lock);
+            vlc_mutex_lock(&w->lock);
+            if (b_next && cl->i_state == HTTPD_CLIENT_SENDING)
+                httpd_ClientSendNext(cl);
+            httpd_WorkerProcess(w, cl);
+            vlc_mutex_unlock(&w->lock);
+            if (b_host)
+                vlc_mutex_unlock(&host->lock);
+        }
+
+        if (b_wake || now >= w->i_sweep) {
+            vlc_mutex_lock(&w->lock);
+            if (b_wake)
+                httpd_WorkerWakeUp(w);
+            if (now >= w->i_sweep)
+                httpd_WorkerSweep(w, now);
+            vlc_mutex_unlock(&w->lock);
+        }
+
+        timeout = (w->i_sweep - now + 999) / 1000;
+        vlc_restorecancel(canc);
+    }
+    return NULL;
+}
+
+static int httpd_WorkersStart(httpd_host_t *host, unsigned count)
+{
+    host->workers = malloc(count * sizeof (*host->workers));
+    if (unlikely(host->workers == NULL))
+        return VLC_ENOMEM;
+
+    /* Several threads may race to accept the same connection */
+    for (unsigned i = 0; i < host->nfd; i++)
+        fcntl(host->fds[i], F_SETFL,
+              fcntl(host->fds[i], F_GETFL) | O_NONBLOCK);
+
+    for (host->i_workers = 0; host->i_workers < count; host->i_workers++) {
+        httpd_worker_t *w = &host->workers[host->i_workers];
+
+        w->host = host;
+        w->active = NULL;
+        w->waiting = NULL;
+        w->i_sweep = mdate() + CLOCK_FREQ;
+        atomic_init(&w->b_wake, false);
+        w->epfd = epoll_create1(EPOLL_CLOEXEC);
+        if (w->epfd == -1) {
+            msg_Err(host, "cannot create epoll instance: %s",
+                    vlc_strerror_c(errno));
+            goto error;
+        }
+
+        w->wakefd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (w->wakefd == -1) {
+            msg_Err(host, "cannot create wake up event: %s",
+                    vlc_strerror_c(errno));
+            close(w->epfd);
+            goto error;
+        }
+
+        struct epoll_event wev = { .events = EPOLLIN, .data.ptr = w };
+        if (epoll_ctl(w->epfd, EPOLL_CTL_ADD, w->wakefd, &wev)) {
+            msg_Err(host, "cannot poll wake up event: %s",
+                    vlc_strerror_c(errno));
+            goto error_fd;
+        }
+
+        for (unsigned j = 0; j < host->nfd; j++) {
+            /* wake only one thread per incoming connection if possible */
+            struct epoll_event ev = { .events = EPOLLIN,
+                                      .data.ptr = &host->fds[j] };
+#ifdef EPOLLEXCLUSIVE
+            ev.events |= EPOLLEXCLUSIVE;
+            if (epoll_ctl(w->epfd, EPOLL_CTL_ADD, host->fds[j], &ev) == 0)
+                continue;
+            ev.events &= ~EPOLLEXCLUSIVE;
+#endif
+            if (epoll_ctl(w->epfd, EPOLL_CTL_ADD, host->fds[j], &ev)) {
+                msg_Err(host, "cannot poll socket: %s",
+                        vlc_strerror_c(errno));
+                goto error_fd;
+            }
+        }
+
+        vlc_mutex_init(&w->lock);
+        if (vlc_clone(&w->thread, httpd_WorkerThread, w,
+                      VLC_THREAD_PRIORITY_LOW)) {
+            vlc_mutex_destroy(&w->lock);
+            goto error_fd;
+        }
+    }
+    msg_Dbg(host, "serving clients with %u threads", host->i_workers);
+    return VLC_SUCCESS;
+
+error_fd:
+    close(host->workers[host->i_workers].wakefd);
+    close(host->workers[host->i_workers].epfd);
+error:
+    httpd_WorkersStop(host);
+    return VLC_EGENERIC;
+}
+
+static void httpd_WorkersStop(httpd_host_t *host)
+{
+    for (unsigned i = 0; i < host->i_workers; i++)
+        vlc_cancel(host->workers[i].thread);
+
+    for (unsigned i = 0; i < host->i_workers; i++) {
+        httpd_worker_t *w = &host->workers[i];
+
+        vlc_join(w->thread, NULL);
+        while (w->active != NULL || w->waiting != NULL) {
+            msg_Warn(host, "client still connected");
+            httpd_WorkerDrop(w, w->active != NULL ? w->active : w->waiting);
+        }
+        vlc_mutex_destroy(&w->lock);
+        close(w->wakefd);
+        close(w->epfd);
+    }
+    free(host->workers);
+    host->workers = NULL;
+    host->i_workers = 0;
+}
+#endif
+
 static void* httpd_HostThread(void *data)
 {
     httpd_host_t *host = data;
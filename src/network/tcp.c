@@ -89,7 +89,10 @@ int net_Connect( vlc_object_t *p_this, const char *psz_host, int i_port,
     if (evfd == -1)
         return -1;
    // vvv wenfeng
-   psz_parser = strchr( p_access->psz_filepath, '=' );   //bindport=***;
+   /* only accesses with a local path carry a bind port */
+   if( !strcmp( p_this->psz_object_type, "access" )
+    && p_access->psz_filepath != NULL )
+       psz_parser = strchr( p_access->psz_filepath, '=' );   //bindport=***;
    if( psz_parser != NULL )
    {
        psz_parser+=1;
@@ -84,10 +84,100 @@ static void test_block (void)
     //assert (block == NULL);
 }
 
+static void test_block_cache (void)
+{
+    block_cache_stats_t before, after;
+    block_t *tab[16];
+
+    block_CacheStats (&before);
+    for (unsigned i = 0; i < 4096; i++)
+    {
+        /* Churn a few sizes, including one too large to be cached */
+        for (unsigned j = 0; j < 16; j++)
+        {
+            static const size_t sizes[] = { 0, 188, 1316, 1500, 12032,
+                                            65536, 1 << 20 };
+            size_t size = sizes[(i + j) % (sizeof (sizes) / sizeof (*sizes))];
+
+            tab[j] = block_Alloc (size);
+            assert (tab[j] != NULL);
+            assert (tab[j]->i_buffer == size);
+            assert (((uintptr_t)tab[j]->p_buffer % 32) == 0);
+            memset (tab[j]->p_buffer, j, size);
+        }
+        for (unsigned j = 0; j < 16; j++)
+            block_Release (tab[j]);
+    }
+    block_CacheStats (&after);
+
+    if (after.i_limit > 0) /* unless disabled with VLC_BLOCK_CACHE=0 */
+    {
+        assert (after.i_hits - before.i_hits > after.i_misses - before.i_misses);
+        assert (after.i_resident > 0);
+    }
+}
+
+#define FIFO_BLOCKS 100000
+
+static void *test_fifo_producer (void *data)
+{
+    block_fifo_t *fifo = data;
+
+    for (unsigned i = 0; i < FIFO_BLOCKS;)
+    {
+        block_t *chain = NULL, **pp = &chain;
+
+        /* Queue lists of one to three blocks */
+        for (unsigned n = 1 + (i % 3); n > 0 && i < FIFO_BLOCKS; n--, i++)
+        {
+            block_t *block = block_Alloc (i % 100);
+            assert (block != NULL);
+            block->i_dts = i;
+            *pp = block;
+            pp = &block->p_next;
+        }
+        block_FifoPut (fifo, chain);
+        block_FifoPace (fifo, 64, SIZE_MAX);
+    }
+
+    block_FifoPace (fifo, 0, SIZE_MAX);
+    assert (block_FifoCount (fifo) == 0);
+    block_FifoWake (fifo);
+    return NULL;
+}
+
+static void test_block_fifo (block_fifo_t *fifo)
+{
+    vlc_thread_t th;
+    block_t *block;
+    unsigned i = 0;
+
+    assert (fifo != NULL);
+    if (vlc_clone (&th, test_fifo_producer, fifo, VLC_THREAD_PRIORITY_LOW))
+        abort ();
+
+    while ((block = block_FifoGet (fifo)) != NULL)
+    {
+        assert (block->i_dts == i);
+        assert (block->i_buffer == i % 100);
+        assert (block->p_next == NULL);
+        block_Release (block);
+        i++;
+    }
+    assert (i == FIFO_BLOCKS);
+
+    vlc_join (th, NULL);
+    assert (block_FifoCount (fifo) == 0);
+    block_FifoRelease (fifo);
+}
+
 int main (void)
 {
     test_block_File ();
     test_block ();
+    test_block_cache ();
+    test_block_fifo (block_FifoNew ());
+    test_block_fifo (block_FifoNewSPSC ());
     return 0;
 }
 